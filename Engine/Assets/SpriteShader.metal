@@ -40,3 +40,20 @@ fragment half4 sprite_fragment(ColorInOut in [[stage_in]],
     half4 sampledColor = half4( texture.sample( s, in.texCoords ) ) * in.color;
     return half4( sampledColor );
 }
+
+struct ShadowCacheOut
+{
+    float4 moments [[color(0)]];
+    float depth [[depth(any)]];
+};
+
+// Copies a cached shadow map that has the same size as the target. The first moment is the depth that the caster
+// had, so it is written back into the depth buffer and casters drawn after this are depth tested against it.
+fragment ShadowCacheOut shadow_cache_fragment( ColorInOut in [[stage_in]],
+                                               texture2d<float, access::read> texture [[texture(0)]] )
+{
+    ShadowCacheOut out;
+    out.moments = texture.read( uint2( in.position.xy ) );
+    out.depth = out.moments.x;
+    return out;
+}
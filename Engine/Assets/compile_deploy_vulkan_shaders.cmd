@@ -9,6 +9,7 @@
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E main -all-resources-bound -T vs_6_0 hlsl\moments_skin_vert.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\moments_skin_vert.spv
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E main -all-resources-bound -T ps_6_0 hlsl\moments_frag.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\moments_frag.spv
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E main -all-resources-bound -T ps_6_0 hlsl\moments_alphatest_frag.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\moments_alphatest_frag.spv
+%VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E main -all-resources-bound -T ps_6_0 hlsl\shadow_cache_frag.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\shadow_cache_frag.spv
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E main -all-resources-bound -T vs_6_0 hlsl\skybox_vert.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\skybox_vert.spv
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E main -all-resources-bound -T ps_6_0 hlsl\skybox_frag.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\skybox_frag.spv
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E main -all-resources-bound -T vs_6_0 hlsl\depthnormals_vert.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\depthnormals_vert.spv
@@ -9,6 +9,7 @@ struct PS_INPUT
     float3 bitangentVS : BINORMAL;
     float3 normalVS : NORMAL;
     float4 projCoord : TEXCOORD2;
+    nointerpolation uint instanceId : TEXCOORD3;
 };
 
 #define TILE_RES 16
@@ -139,6 +140,8 @@ float4 main( PS_INPUT input ) : SV_Target
     const float4 albedo = tex.Sample( sLinear, float2( input.positionVS_u.w, input.positionWS_v.w ) );
     const float4 normalTS = float4( normalTex.Sample( sLinear, float2(input.positionVS_u.w, input.positionWS_v.w) ).xyz * 2 - 1, 0 );
 
+    const matrix instanceLocalToView = GetInstanceData( input.instanceId ).localToView;
+
     const uint tileIndex = GetTileIndex( input.pos.xy );
     uint index = maxNumLightsPerTile * tileIndex;
     uint nextLightIndex = perTileLightIndexBuffer[ index ];
@@ -181,7 +184,7 @@ float4 main( PS_INPUT input ) : SV_Target
         const float4 centerAndRadius = pointLightBufferCenterAndRadius[ lightIndex ];
         const float radius = centerAndRadius.w;
 
-        const float3 vecToLightVS = (mul( localToView, float4( centerAndRadius.xyz, 1.0f ) ) ).xyz - input.positionVS_u.xyz;
+        const float3 vecToLightVS = (mul( instanceLocalToView, float4( centerAndRadius.xyz, 1.0f ) ) ).xyz - input.positionVS_u.xyz;
         const float3 vecToLightWS = centerAndRadius.xyz - input.positionWS_v.xyz;
         const float3 lightDirVS = normalize( vecToLightVS );
 
@@ -231,7 +234,7 @@ float4 main( PS_INPUT input ) : SV_Target
         const float spotAngle = dot( -spotLightDir.xyz, vecToLight );
         const float cosineOfConeAngle = abs( spotParams.w );
 
-        const float3 vecToLightVS = (mul( localToView, float4( vecToLight, 1.0f ) ) ).xyz;
+        const float3 vecToLightVS = (mul( instanceLocalToView, float4( vecToLight, 1.0f ) ) ).xyz;
         const float3 lightDirVS = normalize( vecToLightVS );
 
         const float3 L = normalize( vecToLightVS );
@@ -20,6 +20,7 @@ struct PS_INPUT
     float3 bitangentVS : BINORMAL;
     float3 normalVS : NORMAL;
     float4 projCoord : TEXCOORD2;
+    nointerpolation uint instanceId : TEXCOORD3; // Always 0, skinned meshes aren't instanced.
 };
 
 PS_INPUT main( VS_INPUT input )
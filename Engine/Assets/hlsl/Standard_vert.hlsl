@@ -18,24 +18,27 @@ struct PS_INPUT
     float3 bitangentVS : BINORMAL;
     float3 normalVS : NORMAL;
     float4 projCoord : TEXCOORD2;
+    nointerpolation uint instanceId : TEXCOORD3;
 };
 
-PS_INPUT main( VS_INPUT input )
+PS_INPUT main( VS_INPUT input, uint instanceId : SV_InstanceID )
 {
     PS_INPUT output = (PS_INPUT)0;
     float4 position = float4( input.pos, 1.0f );
+    const InstanceData instance = GetInstanceData( instanceId );
 
-    output.pos = mul( localToClip, position );
-    output.positionVS_u = float4( mul( localToView, position ).xyz, input.uv.x );
-    output.positionWS_v = float4( mul( localToWorld, position ).xyz, input.uv.y );
-    output.normalVS = mul( localToView, float4(input.normal, 0) ).xyz;
-    output.tangentVS = mul( localToView, float4(input.tangent.xyz, 0) ).xyz;
-    output.projCoord = mul( localToShadowClip, float4( input.pos, 1.0 ) );
+    output.pos = mul( instance.localToClip, position );
+    output.positionVS_u = float4( mul( instance.localToView, position ).xyz, input.uv.x );
+    output.positionWS_v = float4( mul( instance.localToWorld, position ).xyz, input.uv.y );
+    output.normalVS = mul( instance.localToView, float4(input.normal, 0) ).xyz;
+    output.tangentVS = mul( instance.localToView, float4(input.tangent.xyz, 0) ).xyz;
+    output.projCoord = mul( instance.localToShadowClip, float4( input.pos, 1.0 ) );
+    output.instanceId = instanceId;
     //float3 ct = cross( input.normal, input.tangent.xyz ) * input.tangent.w;
     // FIXME: This is not what MikkTSpace does, it does the above version! But the renderer is not yet
     //        fully MikkTSpace compatible, and this is needed to get light direction working correctly.
     float3 ct = cross( input.tangent.xyz, input.normal ) * input.tangent.w;
-    output.bitangentVS.xyz = mul( localToView, float4( ct, 0 ) ).xyz;
+    output.bitangentVS.xyz = mul( instance.localToView, float4( ct, 0 ) ).xyz;
 
     return output;
 }
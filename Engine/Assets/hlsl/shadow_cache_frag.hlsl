@@ -0,0 +1,24 @@
+struct VSOutput
+{
+    float4 pos : SV_Position;
+    float2 uv : TEXCOORD;
+    float4 color : COLOR;
+};
+
+struct PSOutput
+{
+    float4 moments : SV_Target;
+    float depth : SV_Depth;
+};
+
+#include "ubo.h"
+
+// Copies a cached shadow map that has the same size as the target. The first moment is the depth that the caster
+// had, so it is written back into the depth buffer and casters drawn after this are depth tested against it.
+PSOutput main( VSOutput vsOut )
+{
+    PSOutput psOut;
+    psOut.moments = tex.Load( int3( vsOut.pos.xy, 0 ) );
+    psOut.depth = psOut.moments.x;
+    return psOut;
+}
@@ -7,6 +7,15 @@ struct Particle
     float4 lifeTimeSecs;
 };
 
+// Must be kept in sync with GfxDevice::InstanceData.
+struct InstanceData
+{
+    matrix localToClip;
+    matrix localToView;
+    matrix localToWorld;
+    matrix localToShadowClip;
+};
+
 #if !VULKAN
 Texture2D tex : register(t0);
 Texture2D normalTex : register(t1);
@@ -48,6 +57,7 @@ cbuffer cbPerFrame : register(b0)
     float timeStamp; // In seconds
     float roughness;
     float alphaThreshold;
+    int isInstanced;
 };
 Buffer<float4> pointLightBufferCenterAndRadius : register(t5);
 RWBuffer<uint> perTileLightIndexBuffer : register(u0);
@@ -59,6 +69,17 @@ RWTexture2D<float4> rwTexture : register(u1);
 RWStructuredBuffer< Particle > particles : register(u2);
 RWBuffer<uint> perTileParticleIndexBuffer : register(u3);
 
+// Instanced draws are only supported on Vulkan.
+InstanceData GetInstanceData( uint instanceId )
+{
+    InstanceData data;
+    data.localToClip = localToClip;
+    data.localToView = localToView;
+    data.localToWorld = localToWorld;
+    data.localToShadowClip = localToShadowClip;
+    return data;
+}
+
 #else
 
 [[vk::binding( 0 )]] Texture2D tex;
@@ -68,12 +89,28 @@ RWBuffer<uint> perTileParticleIndexBuffer : register(u3);
 [[vk::binding( 4 )]] TextureCube<float4> texCube;
 [[vk::binding( 5 )]] SamplerState sLinear;
 [[vk::binding( 6 )]] SamplerState sampler1;
-[[vk::binding( 7 )]] cbuffer cbPerFrame
+// Split by update frequency, so a draw usually uploads only cbPerDraw. Layouts must match the structs in GfxDeviceVulkan.cpp.
+[[vk::binding( 7 )]] cbuffer cbPerDraw
 {
     matrix localToClip;
     matrix localToView;
     matrix localToWorld;
     matrix localToShadowClip;
+    float4 tex0scaleOffset;
+    int isInstanced;
+};
+[[vk::binding( 8 )]] Buffer<float4> pointLightBufferCenterAndRadius;
+[[vk::binding( 9 )]] RWBuffer<uint> perTileLightIndexBuffer;
+[[vk::binding( 10 )]] Buffer<float4> pointLightColors;
+[[vk::binding( 11 )]] Buffer<float4> spotLightBufferCenterAndRadius;
+[[vk::binding( 12 )]] Buffer<float4> spotLightParams;
+[[vk::binding( 13 )]] Buffer<float4> spotLightColors;
+[[vk::binding( 14 )]] RWTexture2D<float4> rwTexture;
+[[vk::binding( 15 )]] RWStructuredBuffer< Particle > particles;
+[[vk::binding( 16 )]] RWBuffer<uint> perTileParticleIndexBuffer;
+[[vk::binding( 17 )]] StructuredBuffer< InstanceData > instances;
+[[vk::binding( 18 )]] cbuffer cbPerFrame
+{
     matrix clipToView;
     matrix viewToClip;
     float4 lightPosition;
@@ -86,29 +123,41 @@ RWBuffer<uint> perTileParticleIndexBuffer : register(u3);
     uint windowWidth;
     uint windowHeight;
     uint numLights; // 16 bits for point light count, 16 for spot light count
-    float f0;
-    float4 tex0scaleOffset;
+    int particleCount;
     float4 tilesXY;
-    matrix boneMatrices[ 80 ];
+    float4 cameraParams; // .x: fov (radians), .y: aspect, .z: near, .w: far
+    float4 particleColor;
     int isVR;
     int kernelSize;
     float2 bloomParams;
-    float4 kernelOffsets[ 16 ];
-    float4 cameraParams; // .x: fov (radians), .y: aspect, .z: near, .w: far
-    float4 particleColor;
-    int particleCount;
     int particleReset;
     float timeStamp; // In seconds.
+    float4 kernelOffsets[ 16 ];
+};
+[[vk::binding( 19 )]] cbuffer cbMaterial
+{
+    float f0;
     float roughness;
     float alphaThreshold;
 };
-[[vk::binding( 8 )]] Buffer<float4> pointLightBufferCenterAndRadius;
-[[vk::binding( 9 )]] RWBuffer<uint> perTileLightIndexBuffer;
-[[vk::binding( 10 )]] Buffer<float4> pointLightColors;
-[[vk::binding( 11 )]] Buffer<float4> spotLightBufferCenterAndRadius;
-[[vk::binding( 12 )]] Buffer<float4> spotLightParams;
-[[vk::binding( 13 )]] Buffer<float4> spotLightColors;
-[[vk::binding( 14 )]] RWTexture2D<float4> rwTexture;
-[[vk::binding( 15 )]] RWStructuredBuffer< Particle > particles;
-[[vk::binding( 16 )]] RWBuffer<uint> perTileParticleIndexBuffer;
+[[vk::binding( 20 )]] cbuffer cbSkinning
+{
+    matrix boneMatrices[ 80 ];
+};
+
+// Returns the matrices of an instanced draw's instance, or cbPerDraw's matrices in other draws.
+InstanceData GetInstanceData( uint instanceId )
+{
+    if (isInstanced == 1)
+    {
+        return instances[ instanceId ];
+    }
+
+    InstanceData data;
+    data.localToClip = localToClip;
+    data.localToView = localToView;
+    data.localToWorld = localToWorld;
+    data.localToShadowClip = localToShadowClip;
+    return data;
+}
 #endif
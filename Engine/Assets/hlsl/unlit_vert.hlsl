@@ -8,10 +8,11 @@ struct VSOutput
     
 #include "ubo.h"
 
-VSOutput main( float3 pos : POSITION, float2 uv : TEXCOORD, float4 color : COLOR )
+VSOutput main( float3 pos : POSITION, float2 uv : TEXCOORD, float4 color : COLOR, uint instanceId : SV_InstanceID )
 {
+    const InstanceData instance = GetInstanceData( instanceId );
     VSOutput vsOut;
-    vsOut.pos = mul( localToClip, float4( pos, 1.0 ) );
+    vsOut.pos = mul( instance.localToClip, float4( pos, 1.0 ) );
     
     if (isVR == 1)
     {
@@ -20,6 +21,6 @@ VSOutput main( float3 pos : POSITION, float2 uv : TEXCOORD, float4 color : COLOR
 
     vsOut.uv = uv;
     vsOut.color = color;
-    vsOut.projCoord = mul( localToShadowClip, float4( pos, 1.0 ) );
+    vsOut.projCoord = mul( instance.localToShadowClip, float4( pos, 1.0 ) );
     return vsOut;
 }
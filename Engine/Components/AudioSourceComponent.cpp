@@ -1,25 +1,23 @@
 #include "AudioSourceComponent.hpp"
 #include "AudioSystem.hpp"
+#include "ComponentPool.hpp"
 #include <string>
 
-static constexpr int MaxComponents = 30;
-
-ae3d::AudioSourceComponent audioSourceComponents[ MaxComponents ];
-unsigned nextFreeAudioSourceComponent = 0;
+ae3d::ComponentPool< ae3d::AudioSourceComponent > audioSourceComponents;
 
 unsigned ae3d::AudioSourceComponent::New()
 {
-    if (nextFreeAudioSourceComponent == MaxComponents - 1)
-    {
-        return nextFreeAudioSourceComponent;
-    }
-    
-    return nextFreeAudioSourceComponent++;
+    return audioSourceComponents.New();
+}
+
+ae3d::AudioSourceComponent* ae3d::AudioSourceComponent::Get( unsigned handle )
+{
+    return audioSourceComponents.Get( handle );
 }
 
-ae3d::AudioSourceComponent* ae3d::AudioSourceComponent::Get( unsigned index )
+void ae3d::AudioSourceComponent::Delete( unsigned handle )
 {
-    return &audioSourceComponents[ index ];
+    audioSourceComponents.Delete( handle );
 }
 
 void ae3d::AudioSourceComponent::SetClipId( unsigned audioClipId )
@@ -1,32 +1,33 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "CameraComponent.hpp"
+#include "ComponentPool.hpp"
 #include "GfxDevice.hpp"
 #include <locale>
 #include <sstream>
 
-static constexpr int MaxComponents = 20;
-ae3d::CameraComponent cameraComponents[ MaxComponents ];
-unsigned nextFreeCameraComponent = 0;
+ae3d::ComponentPool< ae3d::CameraComponent > cameraComponents;
 
 unsigned ae3d::CameraComponent::New()
 {
-    if (nextFreeCameraComponent == MaxComponents - 1)
-    {
-        return nextFreeCameraComponent;
-    }
-
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 0 ] = 0;
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 1 ] = 0;
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 2 ] = GfxDevice::backBufferWidth;
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 3 ] = GfxDevice::backBufferHeight;
+    const unsigned handle = cameraComponents.New();
+    CameraComponent* component = cameraComponents.Get( handle );
+    component->viewport[ 0 ] = 0;
+    component->viewport[ 1 ] = 0;
+    component->viewport[ 2 ] = GfxDevice::backBufferWidth;
+    component->viewport[ 3 ] = GfxDevice::backBufferHeight;
+
+    return handle;
+}
 
-    return nextFreeCameraComponent++;
+ae3d::CameraComponent* ae3d::CameraComponent::Get( unsigned handle )
+{
+    return cameraComponents.Get( handle );
 }
 
-ae3d::CameraComponent* ae3d::CameraComponent::Get( unsigned index )
+void ae3d::CameraComponent::Delete( unsigned handle )
 {
-    return &cameraComponents[ index ];
+    cameraComponents.Delete( handle );
 }
 
 ae3d::Vec3 ae3d::CameraComponent::GetScreenPoint( const ae3d::Vec3 &worldPoint, float viewWidth, float viewHeight ) const
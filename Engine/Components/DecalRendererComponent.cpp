@@ -1,4 +1,5 @@
 #include "DecalRendererComponent.hpp"
+#include "ComponentPool.hpp"
 #include "System.hpp"
 #include <string>
 
@@ -7,24 +8,21 @@ ae3d::DecalRendererComponent::DecalRendererComponent()
 
 }
 
-static constexpr int MaxComponents = 30;
-
-ae3d::DecalRendererComponent decalRendererComponents[ MaxComponents ];
-unsigned nextFreeDecalRendererComponent = 0;
+ae3d::ComponentPool< ae3d::DecalRendererComponent > decalRendererComponents;
 
 unsigned ae3d::DecalRendererComponent::New()
 {
-    if (nextFreeDecalRendererComponent == MaxComponents - 1)
-    {
-        return nextFreeDecalRendererComponent;
-    }
-    
-    return nextFreeDecalRendererComponent++;
+    return decalRendererComponents.New();
+}
+
+ae3d::DecalRendererComponent* ae3d::DecalRendererComponent::Get( unsigned handle )
+{
+    return decalRendererComponents.Get( handle );
 }
 
-ae3d::DecalRendererComponent* ae3d::DecalRendererComponent::Get( unsigned index )
+void ae3d::DecalRendererComponent::Delete( unsigned handle )
 {
-    return &decalRendererComponents[ index ];
+    decalRendererComponents.Delete( handle );
 }
 
 std::string GetSerialized( ae3d::DecalRendererComponent* component )
@@ -32,6 +30,7 @@ std::string GetSerialized( ae3d::DecalRendererComponent* component )
     std::string outStr = "decalrenderer\n";
     outStr += "decalrenderer_enabled ";
     outStr += std::to_string( component->IsEnabled() ? 1 : 0 );
+    outStr += "\n\n";
     return outStr;
 }
 
@@ -1,26 +1,26 @@
 #include "DirectionalLightComponent.hpp"
+#include "ComponentPool.hpp"
 #include <locale>
 #include <vector>
 #include <sstream>
 #include <string>
 
-std::vector< ae3d::DirectionalLightComponent > directionalLightComponents;
-unsigned nextFreeDirectionalLightComponent = 0;
+ae3d::ComponentPool< ae3d::DirectionalLightComponent > directionalLightComponents;
 extern bool someLightCastsShadow;
 
 unsigned ae3d::DirectionalLightComponent::New()
 {
-    if (nextFreeDirectionalLightComponent == directionalLightComponents.size())
-    {
-        directionalLightComponents.resize( directionalLightComponents.size() + 10 );
-    }
+    return directionalLightComponents.New();
+}
 
-    return nextFreeDirectionalLightComponent++;
+ae3d::DirectionalLightComponent* ae3d::DirectionalLightComponent::Get( unsigned handle )
+{
+    return directionalLightComponents.Get( handle );
 }
 
-ae3d::DirectionalLightComponent* ae3d::DirectionalLightComponent::Get( unsigned index )
+void ae3d::DirectionalLightComponent::Delete( unsigned handle )
 {
-    return &directionalLightComponents[ index ];
+    directionalLightComponents.Delete( handle );
 }
 
 void ae3d::DirectionalLightComponent::SetCastShadow( bool enable, int shadowMapSize )
@@ -11,16 +11,12 @@
 #include "PointLightComponent.hpp"
 #include "SpriteRendererComponent.hpp"
 #include "SpotLightComponent.hpp"
+#include "System.hpp"
 #include "TransformComponent.hpp"
 #include "TextRendererComponent.hpp"
 
 using namespace ae3d;
 
-unsigned ae3d::GameObject::GetNextComponentIndex()
-{
-    return nextFreeComponentIndex >= MaxComponents ? InvalidComponentIndex : nextFreeComponentIndex++;
-}
-
 ae3d::GameObject::GameObject( const GameObject& other )
 {
     *this = other;
@@ -34,11 +30,16 @@ ae3d::GameObject::~GameObject()
     }
 }
 
+void ae3d::GameObject::WarnDuplicateComponent( int type ) const
+{
+    System::Print( "Game object \"%s\" already has a component of type %d, keeping the existing one.\n", name.c_str(), type );
+}
+
 GameObject& ae3d::GameObject::operator=( const GameObject& go )
 {
     name = go.name;
     
-    for (unsigned i = 0; i < MaxComponents; ++i)
+    for (unsigned i = 0; i < MaxComponentTypes; ++i)
     {
         components[ i ].type = -1;
         components[ i ].handle = InvalidComponentIndex;
@@ -1,4 +1,5 @@
 #include "LineRendererComponent.hpp"
+#include "ComponentPool.hpp"
 #include "System.hpp"
 
 ae3d::LineRendererComponent::LineRendererComponent()
@@ -6,22 +7,19 @@ ae3d::LineRendererComponent::LineRendererComponent()
 
 }
 
-static constexpr int MaxComponents = 30;
-
-ae3d::LineRendererComponent lineRendererComponents[ MaxComponents ];
-unsigned nextFreeLineRendererComponent = 0;
+ae3d::ComponentPool< ae3d::LineRendererComponent > lineRendererComponents;
 
 unsigned ae3d::LineRendererComponent::New()
 {
-    if (nextFreeLineRendererComponent == MaxComponents - 1)
-    {
-        return nextFreeLineRendererComponent;
-    }
-    
-    return nextFreeLineRendererComponent++;
+    return lineRendererComponents.New();
+}
+
+ae3d::LineRendererComponent* ae3d::LineRendererComponent::Get( unsigned handle )
+{
+    return lineRendererComponents.Get( handle );
 }
 
-ae3d::LineRendererComponent* ae3d::LineRendererComponent::Get( unsigned index )
+void ae3d::LineRendererComponent::Delete( unsigned handle )
 {
-    return &lineRendererComponents[ index ];
+    lineRendererComponents.Delete( handle );
 }
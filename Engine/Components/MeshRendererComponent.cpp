@@ -1,15 +1,17 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "MeshRendererComponent.hpp"
+#include <algorithm>
 #include <string>
 #include <vector>
+#include "ComponentPool.hpp"
 #include "Frustum.hpp"
 #include "GfxDevice.hpp"
 #include "Matrix.hpp"
 #include "Mesh.hpp"
 #include "Material.hpp"
+#include "OcclusionCuller.hpp"
 #include "Shader.hpp"
-#include "Statistics.hpp"
 #include "System.hpp"
 #include "SubMesh.hpp"
 #include "VertexBuffer.hpp"
@@ -26,19 +28,54 @@ namespace MathUtil
 {
     void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax );
     void GetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] );
+    void GetTransformedCenterAndExtent( const Vec3& min, const Vec3& max, const Matrix44& matrix, Vec3& outCenter, Vec3& outExtent );
+    float GetScreenSize( const Vec3& centerView, float radius, const Matrix44& projection );
+    unsigned SelectLod( float screenSize, const float* screenSizes, unsigned count, unsigned currentLod, float hysteresis );
 }
 
-std::vector< ae3d::MeshRendererComponent > meshRendererComponents;
-unsigned nextFreeMeshRendererComponent = 0;
+ae3d::ComponentPool< ae3d::MeshRendererComponent > meshRendererComponents;
 
-unsigned ae3d::MeshRendererComponent::New()
+namespace
 {
-    if (nextFreeMeshRendererComponent == meshRendererComponents.size())
+    bool IsOccludingSubMesh( const SubMesh& subMesh, const Material* material )
     {
-        meshRendererComponents.resize( meshRendererComponents.size() + 10 );
+        // Skinned submeshes are animated, blended and alpha-tested ones can be seen through.
+        return material != nullptr && material->IsValidShader() && material->GetBlendingMode() == Material::BlendingMode::Off && !material->IsAlphaTested() &&
+               subMesh.vertices != nullptr && subMesh.indices != nullptr &&
+               (subMesh.vertexFormat == VertexBuffer::VertexFormat::PTNTC || subMesh.vertexFormat == VertexBuffer::VertexFormat::PTN);
+    }
+
+    Matrix44 GetLocalToShadowClip( const Matrix44& localToWorld, const Matrix44& shadowView, const Matrix44& shadowProjection )
+    {
+        Matrix44 localToShadowClip;
+
+        Matrix44::Multiply( localToWorld, shadowView, localToShadowClip );
+        Matrix44::Multiply( localToShadowClip, shadowProjection, localToShadowClip );
+#ifndef RENDERER_METAL
+        Matrix44::Multiply( localToShadowClip, Matrix44::bias, localToShadowClip );
+#endif
+        return localToShadowClip;
+    }
+
+    GfxDevice::DepthFunc GetDepthFunc( const Material& material )
+    {
+        if (material.GetDepthFunction() == Material::DepthFunction::LessOrEqualWriteOn)
+        {
+            return GfxDevice::DepthFunc::LessOrEqualWriteOn;
+        }
+        else if (material.GetDepthFunction() == Material::DepthFunction::NoneWriteOff)
+        {
+            return GfxDevice::DepthFunc::NoneWriteOff;
+        }
+
+        System::Assert( false, "material has unhandled depth function" );
+        return GfxDevice::DepthFunc::NoneWriteOff;
     }
-    
-    return nextFreeMeshRendererComponent++;
+}
+
+unsigned ae3d::MeshRendererComponent::New()
+{
+    return meshRendererComponents.New();
 }
 
 Material* ae3d::MeshRendererComponent::GetMaterial( int subMeshIndex )
@@ -46,9 +83,14 @@ Material* ae3d::MeshRendererComponent::GetMaterial( int subMeshIndex )
     return subMeshIndex < (int)materials.count ? materials[ subMeshIndex ] : nullptr;
 }
 
-ae3d::MeshRendererComponent* ae3d::MeshRendererComponent::Get( unsigned index )
+ae3d::MeshRendererComponent* ae3d::MeshRendererComponent::Get( unsigned handle )
+{
+    return meshRendererComponents.Get( handle );
+}
+
+void ae3d::MeshRendererComponent::Delete( unsigned handle )
 {
-    return &meshRendererComponents[ index ];
+    meshRendererComponents.Delete( handle );
 }
 
 std::string GetSerialized( ae3d::MeshRendererComponent* component )
@@ -68,80 +110,190 @@ std::string GetSerialized( ae3d::MeshRendererComponent* component )
     outStr += component->CastsShadow() ? "1" : "0";
     outStr += "\nmeshrenderer_enabled ";
     outStr += component->IsEnabled() ? "1" : "0";
+
+    for (unsigned i = 0; i < component->GetLodCount(); ++i)
+    {
+        outStr += "\nmeshrenderer_lod ";
+        outStr += component->GetLodMesh( i ) ? component->GetLodMesh( i )->GetPath() : "none";
+        outStr += " " + std::to_string( component->GetLodScreenSize( i ) );
+    }
+
+    if (component->GetLodCount() > 0)
+    {
+        outStr += "\nmeshrenderer_lod_hysteresis " + std::to_string( component->GetLodHysteresis() );
+    }
+
     outStr += "\n\n";
     
     return outStr;
 }
 
-void ae3d::MeshRendererComponent::Cull( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld )
+void ae3d::MeshRendererComponent::SelectLod( const Matrix44& localToView, const Matrix44& projection, float lodBias, const CameraComponent* camera )
 {
-    if (!mesh)
+    lodMesh = mesh;
+    currentLod = 0;
+
+    if (mesh == nullptr || lodMeshes.count == 0)
     {
         return;
     }
 
-    System::BeginTimer();
+    CameraLod* cameraLod = nullptr;
 
-    isCulled = false;
-    
-    Vec3 aabbWorld[ 8 ];
-    MathUtil::GetCorners( mesh->GetAABBMin(), mesh->GetAABBMax(), aabbWorld );
-    
-    for (std::size_t v = 0; v < 8; ++v)
+    for (auto& candidate : cameraLods)
     {
-        Matrix44::TransformPoint( aabbWorld[ v ], localToWorld, &aabbWorld[ v ] );
+        if (candidate.camera == camera)
+        {
+            cameraLod = &candidate;
+        }
     }
-    
-    Vec3 aabbMinWorld;
-    Vec3 aabbMaxWorld;
-    MathUtil::GetMinMax( aabbWorld, 8, aabbMinWorld, aabbMaxWorld );
-    
-    if (!cameraFrustum.BoxInFrustum( aabbMinWorld, aabbMaxWorld ))
+
+    if (cameraLod == nullptr)
     {
-        isCulled = true;
-        Statistics::IncFrustumCullTime( System::EndTimer() );
-        return;
+        cameraLod = &cameraLods[ nextCameraLod ];
+        cameraLod->camera = camera;
+        cameraLod->lod = 0;
+        nextCameraLod = (nextCameraLod + 1) % (sizeof( cameraLods ) / sizeof( cameraLods[ 0 ] ));
     }
 
-    int subMeshCount = 0;
-    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount);
+    // The sphere encloses LOD 0's AABB. Its radius is scaled by the largest axis scale, so rotating doesn't change the LOD.
+    const Vec3 localCenter = (mesh->GetAABBMin() + mesh->GetAABBMax()) * 0.5f;
+    Vec3 centerView;
+    Matrix44::TransformPoint( localCenter, localToView, &centerView );
+
+    const float* m = localToView.m;
+    const float scaleX = Vec3( m[ 0 ], m[ 1 ], m[ 2 ] ).Length();
+    const float scaleY = Vec3( m[ 4 ], m[ 5 ], m[ 6 ] ).Length();
+    const float scaleZ = Vec3( m[ 8 ], m[ 9 ], m[ 10 ] ).Length();
+    const float scale = std::max( scaleX, std::max( scaleY, scaleZ ) );
+    const float radius = (mesh->GetAABBMax() - localCenter).Length() * scale;
+
+    const float screenSize = MathUtil::GetScreenSize( centerView, radius, projection ) * lodBias;
+    cameraLod->lod = MathUtil::SelectLod( screenSize, &lodScreenSizes[ 0 ], lodScreenSizes.count, cameraLod->lod, lodHysteresis );
+    currentLod = cameraLod->lod;
 
-    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    if (currentLod > 0 && lodMeshes[ currentLod - 1 ] != nullptr)
     {
-        isSubMeshCulled[ subMeshIndex ] = false;
+        lodMesh = lodMeshes[ currentLod - 1 ];
+    }
+}
 
-        if (materials[ subMeshIndex ] == nullptr || !materials[ subMeshIndex ]->IsValidShader())
+void ae3d::MeshRendererComponent::UseLod( unsigned lod )
+{
+    currentLod = lod;
+    lodMesh = (lod > 0 && lod <= lodMeshes.count && lodMeshes[ lod - 1 ] != nullptr) ? lodMeshes[ lod - 1 ] : mesh;
+}
+
+bool ae3d::MeshRendererComponent::CullSubMeshes( const Mesh* aLodMesh, const Frustum& cameraFrustum, const Matrix44& localToWorld, unsigned* outVisibleMasks ) const
+{
+    const int subMeshCount = static_cast< int >( aLodMesh->GetSubMeshCount() );
+
+    Vec3 centerWorld;
+    Vec3 extentWorld;
+    MathUtil::GetTransformedCenterAndExtent( aLodMesh->GetAABBMin(), aLodMesh->GetAABBMax(), localToWorld, centerWorld, extentWorld );
+
+    if (!cameraFrustum.BoxInFrustum( centerWorld - extentWorld, centerWorld + extentWorld ))
+    {
+        for (int i = 0; i < (subMeshCount + 31) / 32; ++i)
         {
-            isSubMeshCulled[ subMeshIndex ] = true;
-            continue;
+            outVisibleMasks[ i ] = 0;
         }
-        
-        Vec3 meshAabbMinWorld = subMeshes[ subMeshIndex ].aabbMin;
-        Vec3 meshAabbMaxWorld = subMeshes[ subMeshIndex ].aabbMax;
-        
-        Vec3 meshAabbWorld[ 8 ];
-        MathUtil::GetCorners( meshAabbMinWorld, meshAabbMaxWorld, meshAabbWorld );
-        
-        for (std::size_t v = 0; v < 8; ++v)
+
+        return false;
+    }
+
+    // Submesh bounds are tested in batches that fit on the stack.
+    const int BatchSize = 32;
+    float bounds[ 6 ][ BatchSize ];
+    Frustum::BoxArrays boxes;
+    boxes.centerX = bounds[ 0 ];
+    boxes.centerY = bounds[ 1 ];
+    boxes.centerZ = bounds[ 2 ];
+    boxes.extentX = bounds[ 3 ];
+    boxes.extentY = bounds[ 4 ];
+    boxes.extentZ = bounds[ 5 ];
+    unsigned isAnyVisible = 0;
+
+    for (int firstIndex = 0; firstIndex < subMeshCount; firstIndex += BatchSize)
+    {
+        boxes.count = static_cast< unsigned >( std::min( BatchSize, subMeshCount - firstIndex ) );
+
+        for (unsigned i = 0; i < boxes.count; ++i)
         {
-            Matrix44::TransformPoint( meshAabbWorld[ v ], localToWorld, &meshAabbWorld[ v ] );
+            const unsigned subMeshIndex = static_cast< unsigned >( firstIndex ) + i;
+            MathUtil::GetTransformedCenterAndExtent( aLodMesh->GetSubMeshAABBMin( subMeshIndex ), aLodMesh->GetSubMeshAABBMax( subMeshIndex ), localToWorld, centerWorld, extentWorld );
+            bounds[ 0 ][ i ] = centerWorld.x;
+            bounds[ 1 ][ i ] = centerWorld.y;
+            bounds[ 2 ][ i ] = centerWorld.z;
+            bounds[ 3 ][ i ] = extentWorld.x;
+            bounds[ 4 ][ i ] = extentWorld.y;
+            bounds[ 5 ][ i ] = extentWorld.z;
         }
-        
-        MathUtil::GetMinMax( meshAabbWorld, 8, meshAabbMinWorld, meshAabbMaxWorld );
-        
-        if (!cameraFrustum.BoxInFrustum( meshAabbMinWorld, meshAabbMaxWorld ))
+
+        unsigned visibleMask = 0;
+        cameraFrustum.CullBoxes( boxes, &visibleMask );
+
+        for (unsigned i = 0; i < boxes.count; ++i)
         {
-            isSubMeshCulled[ subMeshIndex ] = true;
+            const int subMeshIndex = firstIndex + static_cast< int >( i );
+            const bool hasValidMaterial = materials[ subMeshIndex ] != nullptr && materials[ subMeshIndex ]->IsValidShader();
+
+            if (!hasValidMaterial)
+            {
+                visibleMask &= ~(1u << i);
+            }
         }
+
+        outVisibleMasks[ firstIndex / BatchSize ] = visibleMask;
+        isAnyVisible |= visibleMask;
     }
-    
-    Statistics::IncFrustumCullTime( System::EndTimer() );
+
+    return isAnyVisible != 0;
 }
 
-void ae3d::MeshRendererComponent::ApplySkin( unsigned subMeshIndex )
+unsigned ae3d::MeshRendererComponent::RasterizeOccluder( OcclusionCuller& culler, const Matrix44& localToWorld, unsigned maxTriangles ) const
 {
+    if (!mesh || !isEnabled || !isOccluder || isWireframe)
+    {
+        return 0;
+    }
+
     int subMeshCount = 0;
     SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+    unsigned triangleCount = 0;
+
+    for (int subMeshIndex = 0; subMeshIndex < subMeshCount && subMeshIndex < (int)materials.count; ++subMeshIndex)
+    {
+        if (IsOccludingSubMesh( subMeshes[ subMeshIndex ], materials[ subMeshIndex ] ))
+        {
+            triangleCount += subMeshes[ subMeshIndex ].faceCount;
+        }
+    }
+
+    if (triangleCount > maxTriangles)
+    {
+        return 0;
+    }
+
+    for (int subMeshIndex = 0; subMeshIndex < subMeshCount && subMeshIndex < (int)materials.count; ++subMeshIndex)
+    {
+        const SubMesh& subMesh = subMeshes[ subMeshIndex ];
+
+        if (IsOccludingSubMesh( subMesh, materials[ subMeshIndex ] ))
+        {
+            const unsigned vertexStride = subMesh.vertexFormat == VertexBuffer::VertexFormat::PTN ? sizeof( VertexBuffer::VertexPTN ) : sizeof( VertexBuffer::VertexPTNTC );
+            const unsigned indexSize = subMesh.indexType == VertexBuffer::IndexType::UInt32 ? 4 : 2;
+            culler.RasterizeTriangles( subMesh.vertices, vertexStride, subMesh.vertexCount, subMesh.indices, indexSize, subMesh.faceCount, localToWorld );
+        }
+    }
+
+    return triangleCount;
+}
+
+void ae3d::MeshRendererComponent::ApplySkin( unsigned subMeshIndex )
+{
+    int subMeshCount = 0;
+    SubMesh* subMeshes = lodMesh->GetSubMeshes( subMeshCount );
 
     if (!subMeshes[ subMeshIndex ].joints.empty())
     {
@@ -161,159 +313,156 @@ void ae3d::MeshRendererComponent::ApplySkin( unsigned subMeshIndex )
 
 }
 
-void ae3d::MeshRendererComponent::Render( const Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
-                                          const Matrix44& shadowView, const Matrix44& shadowProjection, Shader* overrideShader,
-                                          Shader* overrideSkinShader, Shader* overrideAlphaTestShader, RenderType renderType )
+void ae3d::MeshRendererComponent::RenderSubMesh( int subMeshIndex, const Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
+                                                 const Matrix44& shadowView, const Matrix44& shadowProjection, Shader* overrideShader,
+                                                 Shader* overrideSkinShader, Shader* overrideAlphaTestShader )
 {
-    if (isCulled || !mesh || !isEnabled)
+    int subMeshCount = 0;
+    SubMesh* subMeshes = lodMesh->GetSubMeshes( subMeshCount );
+    System::Assert( subMeshIndex < subMeshCount, "invalid submesh index" );
+
+    Shader* shader = overrideShader ? overrideShader : materials[ subMeshIndex ]->GetShader();
+    
+    if (overrideSkinShader && !subMeshes[ subMeshIndex ].joints.empty())
     {
-        return;
+        shader = overrideSkinShader;
     }
     
-	int subMeshCount = 0;
-    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+    if (overrideAlphaTestShader && materials[ subMeshIndex ]->IsAlphaTested())
+    {
+        shader = overrideAlphaTestShader;
+    }
+
+    GfxDevice::CullMode cullMode = GfxDevice::CullMode::Back;
+    GfxDevice::BlendMode blendMode = GfxDevice::BlendMode::Off;
+
+#if AE3D_OPENVR
+    GfxDeviceGlobal::perObjectUboStruct.isVR = 1;
+#endif
+
+    GfxDeviceGlobal::perObjectUboStruct.alphaThreshold = materials[ subMeshIndex ]->GetAlphaThreshold();
 
-    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    if (overrideShader)
     {
-        if (isSubMeshCulled[ subMeshIndex ])
-        {
-            continue;
-        }
-        
-        if (materials[ subMeshIndex ]->GetBlendingMode() != Material::BlendingMode::Off && renderType == RenderType::Opaque)
-        {
-            continue;
-        }
+        materials[ subMeshIndex ]->Apply();
 
-        if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Off && renderType == RenderType::Transparent)
-        {
-            continue;
-        }
+        GfxDeviceGlobal::perObjectUboStruct.localToClip = localToClip;
+        GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
+        ApplySkin( subMeshIndex );
+    }
+    else
+    {
+        materials[ subMeshIndex ]->Apply();
+        
+        GfxDeviceGlobal::perObjectUboStruct.localToClip = localToClip;
+        GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
+        GfxDeviceGlobal::perObjectUboStruct.localToWorld = localToWorld;
+        GfxDeviceGlobal::perObjectUboStruct.localToShadowClip = GetLocalToShadowClip( localToWorld, shadowView, shadowProjection );
 
-        Shader* shader = overrideShader ? overrideShader : materials[ subMeshIndex ]->GetShader();
+        ApplySkin( subMeshIndex );
         
-        if (overrideSkinShader && !subMeshes[ subMeshIndex ].joints.empty())
+        if (!materials[ subMeshIndex ]->IsBackFaceCulled())
         {
-            shader = overrideSkinShader;
+            cullMode = GfxDevice::CullMode::Off;
         }
         
-        if (overrideAlphaTestShader && materials[ subMeshIndex ]->IsAlphaTested())
+        if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Alpha)
         {
-            shader = overrideAlphaTestShader;
+            blendMode = GfxDevice::BlendMode::AlphaBlend;
         }
+    }
+    
+    const GfxDevice::DepthFunc depthFunc = GetDepthFunc( *materials[ subMeshIndex ] );
+    
+    GfxDevice::Draw( subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3,
+                     *shader, blendMode, depthFunc, cullMode, isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
 
-        GfxDevice::CullMode cullMode = GfxDevice::CullMode::Back;
-        GfxDevice::BlendMode blendMode = GfxDevice::BlendMode::Off;
-
-#if AE3D_OPENVR
-        GfxDeviceGlobal::perObjectUboStruct.isVR = 1;
-#endif
+    if (isAabbDrawingEnabled)
+    {
+        Vec3 aabb[ 8 ];
+        MathUtil::GetCorners( lodMesh->GetAABBMin(), lodMesh->GetAABBMax(), aabb );
 
-        GfxDeviceGlobal::perObjectUboStruct.alphaThreshold = materials[ subMeshIndex ]->GetAlphaThreshold();
+        Vec3 aabbMin, aabbMax;
+        MathUtil::GetMinMax( aabb, 8, aabbMin, aabbMax );
 
-        if (overrideShader)
+        const int lineCount = 24;
+        Vec3 lines[ lineCount ] =
         {
-            materials[ subMeshIndex ]->Apply();
+            Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
+            Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
+
+            Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
+            Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
+
+            Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
+
+            Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
+
+            Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
+
+            Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
+            Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
+            Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
+        };
+
+        GfxDevice::UpdateLineBuffer( aabbLineHandle, lines, lineCount, Vec3( 1, 0, 0 ) );
+        GfxDevice::DrawLines( aabbLineHandle, *shader );
+    }
+}
 
-            GfxDeviceGlobal::perObjectUboStruct.localToClip = localToClip;
-            GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
-            ApplySkin( subMeshIndex );
-        }
-        else
-        {
-            Matrix44 localToShadowClip;
-            
-            Matrix44::Multiply( localToWorld, shadowView, localToShadowClip );
-            Matrix44::Multiply( localToShadowClip, shadowProjection, localToShadowClip );
-#ifndef RENDERER_METAL
-            Matrix44::Multiply( localToShadowClip, Matrix44::bias, localToShadowClip );
-#endif
-            materials[ subMeshIndex ]->Apply();
-            
-            GfxDeviceGlobal::perObjectUboStruct.localToClip = localToClip;
-            GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
-            GfxDeviceGlobal::perObjectUboStruct.localToWorld = localToWorld;
-            GfxDeviceGlobal::perObjectUboStruct.localToShadowClip = localToShadowClip;
+#if RENDERER_VULKAN
+bool ae3d::MeshRendererComponent::IsSubMeshInstanceable( int subMeshIndex ) const
+{
+    int subMeshCount = 0;
+    const SubMesh* subMeshes = lodMesh->GetSubMeshes( subMeshCount );
+    Material* material = materials[ subMeshIndex ];
 
-            ApplySkin( subMeshIndex );
-            
-            if (!materials[ subMeshIndex ]->IsBackFaceCulled())
-            {
-                cullMode = GfxDevice::CullMode::Off;
-            }
-            
-            if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Alpha)
-            {
-                blendMode = GfxDevice::BlendMode::AlphaBlend;
-            }
-        }
-        
-        GfxDevice::DepthFunc depthFunc;
-        
-        if (materials[ subMeshIndex ]->GetDepthFunction() == Material::DepthFunction::LessOrEqualWriteOn)
-        {
-            depthFunc = GfxDevice::DepthFunc::LessOrEqualWriteOn;
-        }
-        else if (materials[ subMeshIndex ]->GetDepthFunction() == Material::DepthFunction::NoneWriteOff)
-        {
-            depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
-        }
-        else
-        {
-            System::Assert( false, "material has unhandled depth function" );
-            depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
-        }
-        
-        GfxDevice::Draw( subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3,
-                         *shader, blendMode, depthFunc, cullMode, isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
+    // Bounding boxes are drawn per renderer and wireframe is a pipeline state, so those renderers are drawn alone.
+    return subMeshes[ subMeshIndex ].joints.empty() && !isWireframe && !isAabbDrawingEnabled && material != nullptr &&
+           material->GetShader() != nullptr && material->GetShader()->IsInstancingSupported() && material->GetBlendingMode() == Material::BlendingMode::Off;
+}
 
-        if (isAabbDrawingEnabled)
-        {
-            Vec3 aabb[ 8 ];
-            MathUtil::GetCorners( mesh->GetAABBMin(), mesh->GetAABBMax(), aabb );
-    
-            Vec3 aabbMin, aabbMax;
-            MathUtil::GetMinMax( aabb, 8, aabbMin, aabbMax );
+void ae3d::MeshRendererComponent::RenderSubMeshInstances( int subMeshIndex, GfxDevice::InstanceData* instances, unsigned instanceCount,
+                                                          const Matrix44& shadowView, const Matrix44& shadowProjection )
+{
+    int subMeshCount = 0;
+    SubMesh* subMeshes = lodMesh->GetSubMeshes( subMeshCount );
+    System::Assert( subMeshIndex < subMeshCount, "invalid submesh index" );
+    System::Assert( IsSubMeshInstanceable( subMeshIndex ), "submesh can't be instanced" );
 
-            const int lineCount = 24;
-            Vec3 lines[ lineCount ] =
-            {
-                Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
-            };
-
-            GfxDevice::UpdateLineBuffer( aabbLineHandle, lines, lineCount, Vec3( 1, 0, 0 ) );
-            GfxDevice::DrawLines( aabbLineHandle, *shader );
-        }
+    Material* material = materials[ subMeshIndex ];
+
+    for (unsigned i = 0; i < instanceCount; ++i)
+    {
+        instances[ i ].localToShadowClip = GetLocalToShadowClip( instances[ i ].localToWorld, shadowView, shadowProjection );
     }
+
+#if AE3D_OPENVR
+    GfxDeviceGlobal::perObjectUboStruct.isVR = 1;
+#endif
+
+    GfxDeviceGlobal::perObjectUboStruct.alphaThreshold = material->GetAlphaThreshold();
+    material->Apply();
+
+    GfxDevice::DrawInstanced( subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3, *material->GetShader(),
+                              GfxDevice::BlendMode::Off, GetDepthFunc( *material ), material->IsBackFaceCulled() ? GfxDevice::CullMode::Back : GfxDevice::CullMode::Off,
+                              GfxDevice::FillMode::Solid, instances, instanceCount );
 }
+#endif
 
 void ae3d::MeshRendererComponent::SetMaterial( Material* material, unsigned subMeshIndex )
 {
@@ -347,15 +496,41 @@ bool ae3d::MeshRendererComponent::IsBoundingBoxDrawingEnabled() const
     return isAabbDrawingEnabled;
 }
 
+void ae3d::MeshRendererComponent::AddLod( Mesh* aLodMesh, float screenSize )
+{
+    System::Assert( mesh != nullptr, "LODs must be added after the mesh is set" );
+    System::Assert( aLodMesh != nullptr, "LOD mesh is null" );
+
+    if (mesh == nullptr || aLodMesh == nullptr)
+    {
+        return;
+    }
+
+    System::Assert( aLodMesh->GetSubMeshCount() <= mesh->GetSubMeshCount(), "LOD has more submeshes than LOD 0" );
+    System::Assert( lodScreenSizes.count == 0 || screenSize < lodScreenSizes[ lodScreenSizes.count - 1 ], "LOD screen sizes must decrease" );
+
+    lodMeshes.Add( aLodMesh );
+    lodScreenSizes.Add( screenSize );
+}
+
+void ae3d::MeshRendererComponent::ClearLods()
+{
+    lodMeshes.Allocate( 0 );
+    lodScreenSizes.Allocate( 0 );
+    lodMesh = mesh;
+    currentLod = 0;
+}
+
 void ae3d::MeshRendererComponent::SetMesh( Mesh* aMesh )
 {
     mesh = aMesh;
+    lodMesh = aMesh;
+    currentLod = 0;
 
     if (mesh != nullptr)
     {
         int subMeshCount = 0;
         mesh->GetSubMeshes( subMeshCount );
         materials.Allocate( subMeshCount );
-        isSubMeshCulled.Allocate( subMeshCount );
     }
 }
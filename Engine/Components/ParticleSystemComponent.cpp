@@ -1,5 +1,5 @@
 #include "ParticleSystemComponent.hpp"
-#include "Array.hpp"
+#include "ComponentPool.hpp"
 #include "ComputeShader.hpp"
 #include "GfxDevice.hpp"
 #include "RenderTexture.hpp"
@@ -44,29 +44,28 @@ extern VkBuffer particleTileBuffer;
 
 #endif
 
-Array< ae3d::ParticleSystemComponent > particleSystemComponents;
-unsigned nextFreeParticleSystemComponent = 0;
+ae3d::ComponentPool< ae3d::ParticleSystemComponent > particleSystemComponents;
 
 unsigned ae3d::ParticleSystemComponent::New()
 {
-    if (nextFreeParticleSystemComponent == particleSystemComponents.count)
-    {
-        particleSystemComponents.Add( {} );
-    }
-    
-    return nextFreeParticleSystemComponent++;
+    return particleSystemComponents.New();
+}
+
+ae3d::ParticleSystemComponent* ae3d::ParticleSystemComponent::Get( unsigned handle )
+{
+    return particleSystemComponents.Get( handle );
 }
 
-ae3d::ParticleSystemComponent* ae3d::ParticleSystemComponent::Get( unsigned index )
+void ae3d::ParticleSystemComponent::Delete( unsigned handle )
 {
-    return &particleSystemComponents[ index ];
+    particleSystemComponents.Delete( handle );
 }
 
 bool ae3d::ParticleSystemComponent::IsAnyAlive()
 {
-    for (unsigned i = 0; i < particleSystemComponents.count; ++i)
+    for (unsigned i = 0; i < particleSystemComponents.GetSlotCount(); ++i)
     {
-        if (particleSystemComponents[ i ].gameObject != nullptr)
+        if (particleSystemComponents.IsAlive( i ) && particleSystemComponents[ i ].gameObject != nullptr)
         {
             return true;
         }
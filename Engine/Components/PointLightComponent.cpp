@@ -1,26 +1,26 @@
 #include "PointLightComponent.hpp"
+#include "ComponentPool.hpp"
 #include <locale>
 #include <vector>
 #include <string>
 #include <sstream>
 
 extern bool someLightCastsShadow;
-std::vector< ae3d::PointLightComponent > pointLightComponents;
-unsigned nextFreePointLightComponent = 0;
+ae3d::ComponentPool< ae3d::PointLightComponent > pointLightComponents;
 
 unsigned ae3d::PointLightComponent::New()
 {
-    if (nextFreePointLightComponent == pointLightComponents.size())
-    {
-        pointLightComponents.resize( pointLightComponents.size() + 10 );
-    }
-    
-    return nextFreePointLightComponent++;
+    return pointLightComponents.New();
+}
+
+ae3d::PointLightComponent* ae3d::PointLightComponent::Get( unsigned handle )
+{
+    return pointLightComponents.Get( handle );
 }
 
-ae3d::PointLightComponent* ae3d::PointLightComponent::Get( unsigned index )
+void ae3d::PointLightComponent::Delete( unsigned handle )
 {
-    return &pointLightComponents[ index ];
+    pointLightComponents.Delete( handle );
 }
 
 void ae3d::PointLightComponent::SetCastShadow( bool enable, int shadowMapSize )
@@ -1,27 +1,24 @@
 #include "SpotLightComponent.hpp"
+#include "ComponentPool.hpp"
 #include "System.hpp"
 #include <string>
 
 extern bool someLightCastsShadow;
-static constexpr int MaxComponents = 100;
-ae3d::SpotLightComponent spotLightComponents[ MaxComponents ];
-unsigned nextFreeSpotlLightComponent = 0;
+ae3d::ComponentPool< ae3d::SpotLightComponent > spotLightComponents;
 
 unsigned ae3d::SpotLightComponent::New()
 {
-    System::Assert( nextFreeSpotlLightComponent < MaxComponents, "Too many spot light components!" );
-    
-    if (nextFreeSpotlLightComponent == MaxComponents - 1)
-    {
-        return nextFreeSpotlLightComponent;
-    }
-    
-    return nextFreeSpotlLightComponent++;
+    return spotLightComponents.New();
+}
+
+ae3d::SpotLightComponent* ae3d::SpotLightComponent::Get( unsigned handle )
+{
+    return spotLightComponents.Get( handle );
 }
 
-ae3d::SpotLightComponent* ae3d::SpotLightComponent::Get( unsigned index )
+void ae3d::SpotLightComponent::Delete( unsigned handle )
 {
-    return &spotLightComponents[ index ];
+    spotLightComponents.Delete( handle );
 }
 
 void ae3d::SpotLightComponent::SetCastShadow( bool enable, int shadowMapSize )
@@ -51,7 +48,7 @@ std::string GetSerialized( const ae3d::SpotLightComponent* component )
 {
     std::string outStr = "spotlight\nshadow ";
     outStr += std::to_string( component->CastsShadow() ? 1 : 0 );
-    outStr += "\nconeAngle ";
+    outStr += "\nconeangle ";
     outStr += std::to_string( component->GetConeAngle() );
     outStr += "\nspotlight_enabled ";
     outStr += std::to_string( component->IsEnabled() ? 1 : 0 );
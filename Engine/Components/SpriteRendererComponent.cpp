@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <sstream>
 #include <vector>
+#include "ComponentPool.hpp"
 #include "GfxDevice.hpp"
 #include "Renderer.hpp"
 #include "RenderTexture.hpp"
@@ -15,8 +16,7 @@
 
 extern ae3d::Renderer renderer;
 
-std::vector<ae3d::SpriteRendererComponent> spriteRendererComponents;
-unsigned nextFreeSpriteComponent = 0;
+ae3d::ComponentPool< ae3d::SpriteRendererComponent > spriteRendererComponents;
 
 namespace GfxDeviceGlobal
 {
@@ -204,17 +204,12 @@ struct ae3d::SpriteRendererComponent::Impl
 
 unsigned ae3d::SpriteRendererComponent::New()
 {
-    if (nextFreeSpriteComponent == spriteRendererComponents.size())
-    {
-        spriteRendererComponents.resize( spriteRendererComponents.size() + 10 );
-    }
-
-    return nextFreeSpriteComponent++;
+    return spriteRendererComponents.New();
 }
 
 ae3d::SpriteInfo ae3d::SpriteRendererComponent::GetSpriteInfo( int index ) const
 {
-    if (index > 0 && index < static_cast< int >( m().spriteInfos.size() ))
+    if (index >= 0 && index < static_cast< int >( m().spriteInfos.size() ))
     {
         return m().spriteInfos[ index ];
     }
@@ -222,15 +217,19 @@ ae3d::SpriteInfo ae3d::SpriteRendererComponent::GetSpriteInfo( int index ) const
     return SpriteInfo{ "", 0, 0, 0, 0, false };
 }
 
-ae3d::SpriteRendererComponent* ae3d::SpriteRendererComponent::Get( unsigned index )
+unsigned ae3d::SpriteRendererComponent::GetSpriteCount() const
 {
-    if (index >= spriteRendererComponents.size())
-    {
-        System::Print( "SpriteRendererComponent: invalid index: %u\n", index );
-    }
-    
-    System::Assert( index < spriteRendererComponents.size(), "Tried to get a too high index for spriteRendererComponents." );
-    return &spriteRendererComponents[ index ];
+    return static_cast< unsigned >( m().spriteInfos.size() );
+}
+
+ae3d::SpriteRendererComponent* ae3d::SpriteRendererComponent::Get( unsigned handle )
+{
+    return spriteRendererComponents.Get( handle );
+}
+
+void ae3d::SpriteRendererComponent::Delete( unsigned handle )
+{
+    spriteRendererComponents.Delete( handle );
 }
 
 ae3d::SpriteRendererComponent::SpriteRendererComponent()
@@ -2,6 +2,7 @@
 #include <locale>
 #include <vector>
 #include <sstream>
+#include "ComponentPool.hpp"
 #include "Font.hpp"
 #include "GfxDevice.hpp"
 #include "Renderer.hpp"
@@ -11,8 +12,7 @@
 
 extern ae3d::Renderer renderer;
 
-std::vector< ae3d::TextRendererComponent > textComponents;
-unsigned nextFreeTextComponent = 0;
+ae3d::ComponentPool< ae3d::TextRendererComponent > textComponents;
 
 namespace GfxDeviceGlobal
 {
@@ -21,17 +21,17 @@ namespace GfxDeviceGlobal
 
 unsigned ae3d::TextRendererComponent::New()
 {
-    if (nextFreeTextComponent == textComponents.size())
-    {
-        textComponents.resize( textComponents.size() + 10 );
-    }
-    
-    return nextFreeTextComponent++;
+    return textComponents.New();
+}
+
+ae3d::TextRendererComponent* ae3d::TextRendererComponent::Get( unsigned handle )
+{
+    return textComponents.Get( handle );
 }
 
-ae3d::TextRendererComponent* ae3d::TextRendererComponent::Get( unsigned index )
+void ae3d::TextRendererComponent::Delete( unsigned handle )
 {
-    return &textComponents[ index ];
+    textComponents.Delete( handle );
 }
 
 struct ae3d::TextRendererComponent::Impl
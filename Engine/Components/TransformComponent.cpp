@@ -1,10 +1,13 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "TransformComponent.hpp"
+#include <cstring>
 #include <locale>
 #include <vector>
 #include <string>
 #include <sstream>
+#include "ComponentPool.hpp"
+#include "JobSystem.hpp"
 #include "Matrix.hpp"
 #include "System.hpp"
 
@@ -15,29 +18,58 @@ namespace
         return fabsf( f1 - f2 ) < 0.0001f;
     }
 
-    std::vector< ae3d::TransformComponent > transformComponents;
-    unsigned nextFreeTransformComponent = 0;
+    bool IsSameMatrix( const ae3d::Matrix44& m1, const ae3d::Matrix44& m2 )
+    {
+        return std::memcmp( m1.m, m2.m, sizeof( m1.m ) ) == 0;
+    }
+
+    ae3d::ComponentPool< ae3d::TransformComponent > transformComponents;
+
+    // Transform indices in depth-first order, so parents come before children and each hierarchy is contiguous.
+    std::vector< unsigned > sortedTransforms;
+    // Offsets into sortedTransforms. Chunks contain whole hierarchies, so they can be updated in parallel.
+    std::vector< unsigned > chunkOffsets;
+    bool isHierarchyDirty = true;
+    const unsigned TransformsPerChunk = 256;
 }
 
 unsigned ae3d::TransformComponent::New()
 {
-    if (nextFreeTransformComponent == transformComponents.size())
-    {
-        transformComponents.resize( transformComponents.size() + 10 );
-    }
+    isHierarchyDirty = true;
 
-    return nextFreeTransformComponent++;
+    return transformComponents.New();
 }
 
-ae3d::TransformComponent* ae3d::TransformComponent::Get( unsigned index )
+ae3d::TransformComponent* ae3d::TransformComponent::Get( unsigned handle )
 {
-    System::Assert( index < static_cast< unsigned >( transformComponents.size() ), "invalid transform index" );
-    return &transformComponents[ index ];
+    return transformComponents.Get( handle );
+}
+
+void ae3d::TransformComponent::Delete( unsigned handle )
+{
+    if (transformComponents.Get( handle ) == nullptr)
+    {
+        return;
+    }
+
+    const int index = static_cast< int >( ComponentPool< TransformComponent >::GetIndex( handle ) );
+
+    for (unsigned componentIndex = 0; componentIndex < transformComponents.GetSlotCount(); ++componentIndex)
+    {
+        if (transformComponents[ componentIndex ].parent == index)
+        {
+            transformComponents[ componentIndex ].parent = -1;
+            transformComponents[ componentIndex ].isDirty = true;
+        }
+    }
+
+    transformComponents.Delete( handle );
+    isHierarchyDirty = true;
 }
 
 ae3d::TransformComponent* ae3d::TransformComponent::GetParent() const
 {
-    System::Assert( parent < static_cast< int >( transformComponents.size() ), "invalid parent transform index" );
+    System::Assert( parent < static_cast< int >( transformComponents.GetSlotCount() ), "invalid parent transform index" );
     return parent == -1 ? nullptr : &transformComponents[ parent ];
 }
 
@@ -47,6 +79,7 @@ void ae3d::TransformComponent::LookAt( const Vec3& aLocalPosition, const Vec3& c
     lookAt.MakeLookAt( aLocalPosition, center, up );
     localRotation.FromMatrix( lookAt );
     localPosition = aLocalPosition;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::MoveForward( float amount )
@@ -54,6 +87,7 @@ void ae3d::TransformComponent::MoveForward( float amount )
     if (!IsAlmost( amount, 0 ))
     {
         localPosition += localRotation * Vec3( 0, 0, amount );
+        isDirty = true;
     }
 }
 
@@ -64,6 +98,7 @@ void ae3d::TransformComponent::MoveForwardXZ( float amount )
         float y = localPosition.y;
         localPosition += localRotation * Vec3( 0, 0, amount );
         localPosition.y = y;
+        isDirty = true;
     }
 }
 
@@ -72,12 +107,14 @@ void ae3d::TransformComponent::MoveRight( float amount )
     if (!IsAlmost( amount, 0 ))
     {
         localPosition += localRotation * Vec3( amount, 0, 0 );
+        isDirty = true;
     }
 }
 
 void ae3d::TransformComponent::MoveUp( float amount )
 {
     localPosition.y += amount;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::OffsetRotate( const Vec3& axis, float angleDeg )
@@ -105,6 +142,7 @@ void ae3d::TransformComponent::OffsetRotate( const Vec3& axis, float angleDeg )
     }
 
     localRotation = newRotation;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::UpdateLocalAndGlobalMatrix()
@@ -113,12 +151,16 @@ void ae3d::TransformComponent::UpdateLocalAndGlobalMatrix()
 
     Matrix44 transform = localMatrix;
     Quaternion worldRotation = localRotation;
-        
-    while (parent != -1)
+
+    if (parent != -1)
     {
-        Matrix44::Multiply( transform, transformComponents[ parent ].GetLocalMatrix(), transform );
-        worldRotation = worldRotation * transformComponents[ parent ].localRotation;
-        parent = transformComponents[ parent ].parent;
+        Matrix44::Multiply( transform, transformComponents[ parent ].localToWorldMatrix, transform );
+        worldRotation = worldRotation * transformComponents[ parent ].globalRotation;
+    }
+
+    if (!IsSameMatrix( localToWorldMatrix, transform ))
+    {
+        ++version;
     }
 
     localToWorldMatrix = transform;
@@ -126,32 +168,115 @@ void ae3d::TransformComponent::UpdateLocalAndGlobalMatrix()
     globalRotation = worldRotation;
 }
 
-void ae3d::TransformComponent::UpdateLocalMatrices()
+void ae3d::TransformComponent::SortHierarchy()
 {
-    for (unsigned componentIndex = 0; componentIndex < nextFreeTransformComponent; ++componentIndex)
+    // Children are stored as linked lists to avoid a vector per transform.
+    const unsigned slotCount = transformComponents.GetSlotCount();
+    std::vector< int > firstChild( slotCount, -1 );
+    std::vector< int > nextSibling( slotCount, -1 );
+
+    for (unsigned componentIndex = slotCount; componentIndex-- > 0;)
     {
-        transformComponents[ componentIndex ].SolveLocalMatrix();
+        const int parentIndex = transformComponents[ componentIndex ].parent;
+
+        if (parentIndex != -1)
+        {
+            nextSibling[ componentIndex ] = firstChild[ parentIndex ];
+            firstChild[ parentIndex ] = static_cast< int >( componentIndex );
+        }
     }
 
-    for (unsigned componentIndex = 0; componentIndex < nextFreeTransformComponent; ++componentIndex)
+    sortedTransforms.clear();
+    chunkOffsets.clear();
+    chunkOffsets.push_back( 0 );
+
+    std::vector< int > stack;
+
+    for (unsigned rootIndex = 0; rootIndex < slotCount; ++rootIndex)
     {
-        int parent = transformComponents[ componentIndex ].parent;
+        if (transformComponents[ rootIndex ].parent != -1 || !transformComponents.IsAlive( rootIndex ))
+        {
+            continue;
+        }
 
-        Matrix44 transform = transformComponents[ componentIndex ].localMatrix;
+        stack.push_back( static_cast< int >( rootIndex ) );
 
-        Quaternion worldRotation = transformComponents[ componentIndex ].localRotation;
-        
-        while (parent != -1)
+        while (!stack.empty())
         {
-            Matrix44::Multiply( transform, transformComponents[ parent ].GetLocalMatrix(), transform );
-            worldRotation = worldRotation * transformComponents[ parent ].localRotation;
-            parent = transformComponents[ parent ].parent;
+            const int componentIndex = stack.back();
+            stack.pop_back();
+            sortedTransforms.push_back( static_cast< unsigned >( componentIndex ) );
+
+            for (int child = firstChild[ componentIndex ]; child != -1; child = nextSibling[ child ])
+            {
+                stack.push_back( child );
+            }
         }
 
-        transformComponents[ componentIndex ].localToWorldMatrix = transform;
-        Matrix44::TransformPoint( Vec3( 0, 0, 0 ), transform, &transformComponents[ componentIndex ].globalPosition );
-        transformComponents[ componentIndex ].globalRotation = worldRotation;
+        if (sortedTransforms.size() - chunkOffsets.back() >= TransformsPerChunk)
+        {
+            chunkOffsets.push_back( static_cast< unsigned >( sortedTransforms.size() ) );
+        }
     }
+
+    if (chunkOffsets.back() != sortedTransforms.size())
+    {
+        chunkOffsets.push_back( static_cast< unsigned >( sortedTransforms.size() ) );
+    }
+
+    isHierarchyDirty = false;
+}
+
+void ae3d::TransformComponent::UpdateLocalMatrices()
+{
+    if (isHierarchyDirty)
+    {
+        SortHierarchy();
+    }
+
+    const unsigned chunkCount = static_cast< unsigned >( chunkOffsets.size() ) - 1;
+
+    JobSystem::ParallelFor( chunkCount, 1, []( unsigned firstChunk, unsigned lastChunk )
+    {
+        for (unsigned i = chunkOffsets[ firstChunk ]; i < chunkOffsets[ lastChunk ]; ++i)
+        {
+            TransformComponent& component = transformComponents[ sortedTransforms[ i ] ];
+            const TransformComponent* parentComponent = component.parent == -1 ? nullptr : &transformComponents[ component.parent ];
+
+            if (!component.isDirty && (parentComponent == nullptr || !parentComponent->hasWorldChanged))
+            {
+                component.hasWorldChanged = false;
+                continue;
+            }
+
+            if (component.isDirty)
+            {
+                component.SolveLocalMatrix();
+                component.isDirty = false;
+            }
+
+            Matrix44 transform = component.localMatrix;
+            Quaternion worldRotation = component.localRotation;
+
+            if (parentComponent != nullptr)
+            {
+                Matrix44::Multiply( transform, parentComponent->localToWorldMatrix, transform );
+                worldRotation = worldRotation * parentComponent->globalRotation;
+            }
+
+            // UpdateLocalAndGlobalMatrix could have already set the matrix, so children are updated even if it's the same.
+            component.hasWorldChanged = true;
+
+            if (!IsSameMatrix( component.localToWorldMatrix, transform ))
+            {
+                ++component.version;
+            }
+
+            component.localToWorldMatrix = transform;
+            Matrix44::TransformPoint( Vec3( 0, 0, 0 ), transform, &component.globalPosition );
+            component.globalRotation = worldRotation;
+        }
+    } );
 }
 
 const ae3d::Matrix44& ae3d::TransformComponent::GetLocalMatrix()
@@ -162,16 +287,19 @@ const ae3d::Matrix44& ae3d::TransformComponent::GetLocalMatrix()
 void ae3d::TransformComponent::SetLocalPosition( const Vec3& localPos )
 {
     localPosition = localPos;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::SetLocalRotation( const Quaternion& localRot )
 {
     localRotation = localRot;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::SetLocalScale( float aLocalScale )
 {
     localScale = aLocalScale;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::SolveLocalMatrix()
@@ -210,13 +338,21 @@ void ae3d::TransformComponent::SetParent( TransformComponent* aParent )
         testComponent = testComponent->parent == -1 ? nullptr : &transformComponents[ testComponent->parent ];
     }
 
-    for (std::size_t componentIndex = 0; componentIndex < transformComponents.size(); ++componentIndex)
+    if (aParent == nullptr)
     {
-        if (&transformComponents[ componentIndex ] == aParent)
-        {
-            parent = static_cast< int >( componentIndex );
-            return;
-        }
+        parent = -1;
+        isDirty = true;
+        isHierarchyDirty = true;
+        return;
+    }
+
+    const unsigned parentIndex = transformComponents.FindIndex( aParent );
+
+    if (parentIndex != ComponentPool< TransformComponent >::InvalidIndex)
+    {
+        parent = static_cast< int >( parentIndex );
+        isDirty = true;
+        isHierarchyDirty = true;
     }
 }
 
@@ -0,0 +1,636 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "AABBTree.hpp"
+#include <algorithm>
+#include <cmath>
+#include "FrameArena.hpp"
+#include "Frustum.hpp"
+#include "System.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    // Tree height is kept logarithmic, so this is enough for any realistic leaf count.
+    const int StackSize = 256;
+
+    // Leaves' boxes are enlarged by this fraction of their size in each direction.
+    const float FatMarginFactor = 0.1f;
+    const float FatMarginMin = 0.01f;
+
+    float SurfaceArea( const Vec3& aabbMin, const Vec3& aabbMax )
+    {
+        const Vec3 d = aabbMax - aabbMin;
+        return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool Contains( const Vec3& outerMin, const Vec3& outerMax, const Vec3& innerMin, const Vec3& innerMax )
+    {
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+               outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+    }
+
+    bool Overlaps( const Vec3& min1, const Vec3& max1, const Vec3& min2, const Vec3& max2 )
+    {
+        return min1.x <= max2.x && max1.x >= min2.x &&
+               min1.y <= max2.y && max1.y >= min2.y &&
+               min1.z <= max2.z && max1.z >= min2.z;
+    }
+
+    void Fatten( const Vec3& aabbMin, const Vec3& aabbMax, Vec3& outMin, Vec3& outMax )
+    {
+        const Vec3 size = aabbMax - aabbMin;
+        const Vec3 margin = Vec3::Max2( size * FatMarginFactor, Vec3( FatMarginMin, FatMarginMin, FatMarginMin ) );
+        outMin = aabbMin - margin;
+        outMax = aabbMax + margin;
+    }
+
+    int MaxInt( int a, int b )
+    {
+        return a > b ? a : b;
+    }
+
+    float GetSquaredDistance( const Vec3& point, const Vec3& aabbMin, const Vec3& aabbMax )
+    {
+        const Vec3 closest = Vec3::Min2( Vec3::Max2( point, aabbMin ), aabbMax );
+        const Vec3 d = point - closest;
+        return Vec3::Dot( d, d );
+    }
+
+    // Slab test. inverseDirection's components are finite, see QueryRay.
+    bool IntersectsRay( const Vec3& aabbMin, const Vec3& aabbMax, const Vec3& origin, const Vec3& inverseDirection, float maxDistance )
+    {
+        const float tx1 = (aabbMin.x - origin.x) * inverseDirection.x;
+        const float tx2 = (aabbMax.x - origin.x) * inverseDirection.x;
+        const float ty1 = (aabbMin.y - origin.y) * inverseDirection.y;
+        const float ty2 = (aabbMax.y - origin.y) * inverseDirection.y;
+        const float tz1 = (aabbMin.z - origin.z) * inverseDirection.z;
+        const float tz2 = (aabbMax.z - origin.z) * inverseDirection.z;
+
+        const float tMin = std::max( std::max( std::min( tx1, tx2 ), std::min( ty1, ty2 ) ), std::max( std::min( tz1, tz2 ), 0.0f ) );
+        const float tMax = std::min( std::min( std::max( tx1, tx2 ), std::max( ty1, ty2 ) ), std::min( std::max( tz1, tz2 ), maxDistance ) );
+
+        return tMin <= tMax;
+    }
+}
+
+int AABBTree::AllocateNode()
+{
+    if (freeList == NullNode)
+    {
+        nodes.push_back( Node() );
+        return static_cast< int >( nodes.size() ) - 1;
+    }
+
+    const int node = freeList;
+    freeList = nodes[ node ].parent;
+    nodes[ node ] = Node();
+    return node;
+}
+
+void AABBTree::FreeNode( int node )
+{
+    nodes[ node ].parent = freeList;
+    nodes[ node ].height = -1;
+    freeList = node;
+}
+
+int AABBTree::Insert( const Vec3& aabbMin, const Vec3& aabbMax, unsigned userData )
+{
+    const int proxy = AllocateNode();
+    Fatten( aabbMin, aabbMax, nodes[ proxy ].aabbMin, nodes[ proxy ].aabbMax );
+    nodes[ proxy ].userData = userData;
+    nodes[ proxy ].height = 0;
+    InsertLeaf( proxy );
+
+    return proxy;
+}
+
+void AABBTree::Remove( int proxy )
+{
+    System::Assert( proxy >= 0 && proxy < static_cast< int >( nodes.size() ) && nodes[ proxy ].IsLeaf(), "invalid AABBTree proxy" );
+
+    RemoveLeaf( proxy );
+    FreeNode( proxy );
+}
+
+bool AABBTree::Move( int proxy, const Vec3& aabbMin, const Vec3& aabbMax )
+{
+    System::Assert( proxy >= 0 && proxy < static_cast< int >( nodes.size() ) && nodes[ proxy ].IsLeaf(), "invalid AABBTree proxy" );
+
+    Vec3 fatMin, fatMax;
+    Fatten( aabbMin, aabbMax, fatMin, fatMax );
+
+    const Node& leaf = nodes[ proxy ];
+
+    // Also reinserts when the object has shrunk a lot, so culling doesn't use a needlessly big box.
+    if (Contains( leaf.aabbMin, leaf.aabbMax, aabbMin, aabbMax ) &&
+        SurfaceArea( leaf.aabbMin, leaf.aabbMax ) <= 4 * SurfaceArea( fatMin, fatMax ))
+    {
+        return false;
+    }
+
+    RemoveLeaf( proxy );
+    nodes[ proxy ].aabbMin = fatMin;
+    nodes[ proxy ].aabbMax = fatMax;
+    InsertLeaf( proxy );
+
+    return true;
+}
+
+unsigned AABBTree::GetUserData( int proxy ) const
+{
+    return nodes[ proxy ].userData;
+}
+
+void AABBTree::SetUserData( int proxy, unsigned userData )
+{
+    nodes[ proxy ].userData = userData;
+}
+
+int AABBTree::GetHeight() const
+{
+    return root == NullNode ? 0 : nodes[ root ].height;
+}
+
+void AABBTree::Clear()
+{
+    nodes.clear();
+    root = NullNode;
+    freeList = NullNode;
+}
+
+void AABBTree::InsertLeaf( int leaf )
+{
+    if (root == NullNode)
+    {
+        root = leaf;
+        nodes[ root ].parent = NullNode;
+        return;
+    }
+
+    const Vec3 leafMin = nodes[ leaf ].aabbMin;
+    const Vec3 leafMax = nodes[ leaf ].aabbMax;
+
+    // Finds the best sibling using surface area heuristic.
+    int index = root;
+
+    while (!nodes[ index ].IsLeaf())
+    {
+        const Node& node = nodes[ index ];
+        const float area = SurfaceArea( node.aabbMin, node.aabbMax );
+        const float combinedArea = SurfaceArea( Vec3::Min2( node.aabbMin, leafMin ), Vec3::Max2( node.aabbMax, leafMax ) );
+
+        // Cost of creating a new parent for this node and the new leaf.
+        const float cost = 2 * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree.
+        const float inheritanceCost = 2 * (combinedArea - area);
+
+        float childCosts[ 2 ];
+        const int children[ 2 ] = { node.child1, node.child2 };
+
+        for (int c = 0; c < 2; ++c)
+        {
+            const Node& child = nodes[ children[ c ] ];
+            const float unionArea = SurfaceArea( Vec3::Min2( child.aabbMin, leafMin ), Vec3::Max2( child.aabbMax, leafMax ) );
+            childCosts[ c ] = (child.IsLeaf() ? unionArea : unionArea - SurfaceArea( child.aabbMin, child.aabbMax )) + inheritanceCost;
+        }
+
+        if (cost < childCosts[ 0 ] && cost < childCosts[ 1 ])
+        {
+            break;
+        }
+
+        index = childCosts[ 0 ] < childCosts[ 1 ] ? children[ 0 ] : children[ 1 ];
+    }
+
+    const int sibling = index;
+    const int oldParent = nodes[ sibling ].parent;
+    const int newParent = AllocateNode();
+
+    nodes[ newParent ].parent = oldParent;
+    nodes[ newParent ].aabbMin = Vec3::Min2( nodes[ sibling ].aabbMin, leafMin );
+    nodes[ newParent ].aabbMax = Vec3::Max2( nodes[ sibling ].aabbMax, leafMax );
+    nodes[ newParent ].height = nodes[ sibling ].height + 1;
+    nodes[ newParent ].child1 = sibling;
+    nodes[ newParent ].child2 = leaf;
+    nodes[ sibling ].parent = newParent;
+    nodes[ leaf ].parent = newParent;
+
+    if (oldParent != NullNode)
+    {
+        if (nodes[ oldParent ].child1 == sibling)
+        {
+            nodes[ oldParent ].child1 = newParent;
+        }
+        else
+        {
+            nodes[ oldParent ].child2 = newParent;
+        }
+    }
+    else
+    {
+        root = newParent;
+    }
+
+    FixUpwards( newParent );
+}
+
+void AABBTree::RemoveLeaf( int leaf )
+{
+    if (leaf == root)
+    {
+        root = NullNode;
+        return;
+    }
+
+    const int parent = nodes[ leaf ].parent;
+    const int grandParent = nodes[ parent ].parent;
+    const int sibling = nodes[ parent ].child1 == leaf ? nodes[ parent ].child2 : nodes[ parent ].child1;
+
+    if (grandParent != NullNode)
+    {
+        if (nodes[ grandParent ].child1 == parent)
+        {
+            nodes[ grandParent ].child1 = sibling;
+        }
+        else
+        {
+            nodes[ grandParent ].child2 = sibling;
+        }
+
+        nodes[ sibling ].parent = grandParent;
+        FreeNode( parent );
+        FixUpwards( grandParent );
+    }
+    else
+    {
+        root = sibling;
+        nodes[ sibling ].parent = NullNode;
+        FreeNode( parent );
+    }
+}
+
+void AABBTree::FixUpwards( int node )
+{
+    int index = node;
+
+    while (index != NullNode)
+    {
+        index = Balance( index );
+
+        Node& n = nodes[ index ];
+        const Node& child1 = nodes[ n.child1 ];
+        const Node& child2 = nodes[ n.child2 ];
+
+        n.height = 1 + MaxInt( child1.height, child2.height );
+        n.aabbMin = Vec3::Min2( child1.aabbMin, child2.aabbMin );
+        n.aabbMax = Vec3::Max2( child1.aabbMax, child2.aabbMax );
+
+        index = n.parent;
+    }
+}
+
+int AABBTree::Balance( int iA )
+{
+    Node& A = nodes[ iA ];
+
+    if (A.IsLeaf() || A.height < 2)
+    {
+        return iA;
+    }
+
+    const int iB = A.child1;
+    const int iC = A.child2;
+    Node& B = nodes[ iB ];
+    Node& C = nodes[ iC ];
+
+    const int balance = C.height - B.height;
+
+    // Rotates C up.
+    if (balance > 1)
+    {
+        const int iF = C.child1;
+        const int iG = C.child2;
+        Node& F = nodes[ iF ];
+        Node& G = nodes[ iG ];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if (C.parent != NullNode)
+        {
+            if (nodes[ C.parent ].child1 == iA)
+            {
+                nodes[ C.parent ].child1 = iC;
+            }
+            else
+            {
+                nodes[ C.parent ].child2 = iC;
+            }
+        }
+        else
+        {
+            root = iC;
+        }
+
+        if (F.height > G.height)
+        {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.aabbMin = Vec3::Min2( B.aabbMin, G.aabbMin );
+            A.aabbMax = Vec3::Max2( B.aabbMax, G.aabbMax );
+            C.aabbMin = Vec3::Min2( A.aabbMin, F.aabbMin );
+            C.aabbMax = Vec3::Max2( A.aabbMax, F.aabbMax );
+            A.height = 1 + MaxInt( B.height, G.height );
+            C.height = 1 + MaxInt( A.height, F.height );
+        }
+        else
+        {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.aabbMin = Vec3::Min2( B.aabbMin, F.aabbMin );
+            A.aabbMax = Vec3::Max2( B.aabbMax, F.aabbMax );
+            C.aabbMin = Vec3::Min2( A.aabbMin, G.aabbMin );
+            C.aabbMax = Vec3::Max2( A.aabbMax, G.aabbMax );
+            A.height = 1 + MaxInt( B.height, F.height );
+            C.height = 1 + MaxInt( A.height, G.height );
+        }
+
+        return iC;
+    }
+
+    // Rotates B up.
+    if (balance < -1)
+    {
+        const int iD = B.child1;
+        const int iE = B.child2;
+        Node& D = nodes[ iD ];
+        Node& E = nodes[ iE ];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if (B.parent != NullNode)
+        {
+            if (nodes[ B.parent ].child1 == iA)
+            {
+                nodes[ B.parent ].child1 = iB;
+            }
+            else
+            {
+                nodes[ B.parent ].child2 = iB;
+            }
+        }
+        else
+        {
+            root = iB;
+        }
+
+        if (D.height > E.height)
+        {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.aabbMin = Vec3::Min2( C.aabbMin, E.aabbMin );
+            A.aabbMax = Vec3::Max2( C.aabbMax, E.aabbMax );
+            B.aabbMin = Vec3::Min2( A.aabbMin, D.aabbMin );
+            B.aabbMax = Vec3::Max2( A.aabbMax, D.aabbMax );
+            A.height = 1 + MaxInt( C.height, E.height );
+            B.height = 1 + MaxInt( A.height, D.height );
+        }
+        else
+        {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.aabbMin = Vec3::Min2( C.aabbMin, D.aabbMin );
+            A.aabbMax = Vec3::Max2( C.aabbMax, D.aabbMax );
+            B.aabbMin = Vec3::Min2( A.aabbMin, E.aabbMin );
+            B.aabbMax = Vec3::Max2( A.aabbMax, E.aabbMax );
+            A.height = 1 + MaxInt( C.height, D.height );
+            B.height = 1 + MaxInt( A.height, E.height );
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+template< typename Vector > void AABBTree::QueryFrustum( const Frustum& frustum, Vector& outUserData ) const
+{
+    if (root == NullNode)
+    {
+        return;
+    }
+
+    int stack[ StackSize ];
+    int stackCount = 0;
+    stack[ stackCount++ ] = root;
+
+    while (stackCount > 0)
+    {
+        const Node& node = nodes[ stack[ --stackCount ] ];
+
+        if (!frustum.BoxInFrustum( node.aabbMin, node.aabbMax ))
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            outUserData.push_back( node.userData );
+        }
+        else
+        {
+            System::Assert( stackCount + 2 <= StackSize, "AABBTree query stack overflow" );
+            stack[ stackCount++ ] = node.child1;
+            stack[ stackCount++ ] = node.child2;
+        }
+    }
+}
+
+void AABBTree::Query( const Frustum& frustum, std::vector< unsigned >& outUserData ) const
+{
+    QueryFrustum( frustum, outUserData );
+}
+
+void AABBTree::Query( const Frustum& frustum, FrameVector< unsigned >& outUserData ) const
+{
+    QueryFrustum( frustum, outUserData );
+}
+
+void AABBTree::Query( const Vec3& aabbMin, const Vec3& aabbMax, std::vector< unsigned >& outUserData ) const
+{
+    if (root == NullNode)
+    {
+        return;
+    }
+
+    int stack[ StackSize ];
+    int stackCount = 0;
+    stack[ stackCount++ ] = root;
+
+    while (stackCount > 0)
+    {
+        const Node& node = nodes[ stack[ --stackCount ] ];
+
+        if (!Overlaps( node.aabbMin, node.aabbMax, aabbMin, aabbMax ))
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            outUserData.push_back( node.userData );
+        }
+        else
+        {
+            System::Assert( stackCount + 2 <= StackSize, "AABBTree query stack overflow" );
+            stack[ stackCount++ ] = node.child1;
+            stack[ stackCount++ ] = node.child2;
+        }
+    }
+}
+
+void AABBTree::QueryRay( const Vec3& origin, const Vec3& direction, float maxDistance, std::vector< unsigned >& outUserData ) const
+{
+    if (root == NullNode)
+    {
+        return;
+    }
+
+    // Zero components are replaced with tiny ones, so the slab test doesn't compute 0 * infinity.
+    const float MinComponent = 1e-20f;
+    const Vec3 inverseDirection( 1.0f / (std::fabs( direction.x ) > MinComponent ? direction.x : std::copysign( MinComponent, direction.x )),
+                                 1.0f / (std::fabs( direction.y ) > MinComponent ? direction.y : std::copysign( MinComponent, direction.y )),
+                                 1.0f / (std::fabs( direction.z ) > MinComponent ? direction.z : std::copysign( MinComponent, direction.z )) );
+
+    int stack[ StackSize ];
+    int stackCount = 0;
+    stack[ stackCount++ ] = root;
+
+    while (stackCount > 0)
+    {
+        const Node& node = nodes[ stack[ --stackCount ] ];
+
+        if (!IntersectsRay( node.aabbMin, node.aabbMax, origin, inverseDirection, maxDistance ))
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            outUserData.push_back( node.userData );
+        }
+        else
+        {
+            System::Assert( stackCount + 2 <= StackSize, "AABBTree query stack overflow" );
+            stack[ stackCount++ ] = node.child1;
+            stack[ stackCount++ ] = node.child2;
+        }
+    }
+}
+
+void AABBTree::QuerySphere( const Vec3& center, float radius, std::vector< unsigned >& outUserData ) const
+{
+    if (root == NullNode)
+    {
+        return;
+    }
+
+    int stack[ StackSize ];
+    int stackCount = 0;
+    stack[ stackCount++ ] = root;
+
+    while (stackCount > 0)
+    {
+        const Node& node = nodes[ stack[ --stackCount ] ];
+
+        if (GetSquaredDistance( center, node.aabbMin, node.aabbMax ) > radius * radius)
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            outUserData.push_back( node.userData );
+        }
+        else
+        {
+            System::Assert( stackCount + 2 <= StackSize, "AABBTree query stack overflow" );
+            stack[ stackCount++ ] = node.child1;
+            stack[ stackCount++ ] = node.child2;
+        }
+    }
+}
+
+void AABBTree::QueryNearest( const Vec3& point, unsigned count, float maxDistance, const std::function< float( unsigned userData ) >& leafDistance,
+                             std::vector< std::pair< float, unsigned > >& outLeaves ) const
+{
+    outLeaves.clear();
+
+    if (root == NullNode || count == 0)
+    {
+        return;
+    }
+
+    // Min-heap of nodes by the distance to their box. Measured leaves are pushed back with their exact distance and
+    // a negated index, so a leaf is output when nothing that is unvisited can be nearer.
+    struct Entry
+    {
+        float distance;
+        int node;
+
+        bool operator<( const Entry& other ) const { return distance > other.distance; }
+    };
+
+    std::vector< Entry > heap;
+    heap.reserve( 64 );
+    heap.push_back( { std::sqrt( GetSquaredDistance( point, nodes[ root ].aabbMin, nodes[ root ].aabbMax ) ), root } );
+
+    while (!heap.empty() && outLeaves.size() < count)
+    {
+        std::pop_heap( std::begin( heap ), std::end( heap ) );
+        const Entry entry = heap.back();
+        heap.pop_back();
+
+        if (entry.distance > maxDistance)
+        {
+            break;
+        }
+
+        if (entry.node < 0)
+        {
+            outLeaves.push_back( std::make_pair( entry.distance, nodes[ -entry.node - 1 ].userData ) );
+            continue;
+        }
+
+        const Node& node = nodes[ entry.node ];
+
+        if (node.IsLeaf())
+        {
+            const float distance = leafDistance( node.userData );
+
+            if (distance >= 0)
+            {
+                heap.push_back( { distance, -entry.node - 1 } );
+                std::push_heap( std::begin( heap ), std::end( heap ) );
+            }
+
+            continue;
+        }
+
+        for (int child : { node.child1, node.child2 })
+        {
+            heap.push_back( { std::sqrt( GetSquaredDistance( point, nodes[ child ].aabbMin, nodes[ child ].aabbMax ) ), child } );
+            std::push_heap( std::begin( heap ), std::end( heap ) );
+        }
+    }
+}
@@ -0,0 +1,367 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "AssetLoader.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AudioClip.hpp"
+#include "AudioSystem.hpp"
+#include "FileSystem.hpp"
+#include "Font.hpp"
+#include "JobSystem.hpp"
+#include "Mesh.hpp"
+#include "Texture2D.hpp"
+
+using namespace ae3d;
+
+struct ae3d::AssetLoader::LoadRequest
+{
+    enum class Type { Texture2D, Mesh, AudioClip, Font };
+
+    Type type = Type::Texture2D;
+    std::string path;
+    std::atomic< LoadState > state;
+    CompletionCallback callback;
+
+    Texture2D* texture = nullptr;
+    TextureWrap wrap = TextureWrap::Repeat;
+    TextureFilter filter = TextureFilter::Linear;
+    Mipmaps mipmaps = Mipmaps::None;
+    ColorSpace colorSpace = ColorSpace::SRGB;
+    Anisotropy anisotropy = Anisotropy::k1;
+    Mesh* mesh = nullptr;
+    AudioClip* audioClip = nullptr;
+    Font* font = nullptr;
+    Texture2D* fontTexture = nullptr;
+
+    // Written by a loader thread, read by Update() after the request has been moved to decodedRequests.
+    bool isDecoded = false;
+    FileSystem::FileContentsData fileData;
+    Texture2D::DecodedImage image;
+    Mesh decodedMesh;
+    AudioSystem::DecodedClip decodedClip;
+};
+
+namespace
+{
+    // Decoding is mostly waiting for I/O, so a few threads are enough. Compressed .pak entries are decompressed on JobSystem.
+    const unsigned LoaderThreadCount = 2;
+
+    std::vector< std::thread > loaderThreads;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable decodingDone;
+    std::deque< std::shared_ptr< AssetLoader::LoadRequest > > queuedRequests;
+    std::deque< std::shared_ptr< AssetLoader::LoadRequest > > decodedRequests;
+    unsigned decodingCount = 0;
+    bool isQuitting = false;
+
+    // Only accessed on the main thread.
+    std::vector< std::shared_ptr< AssetLoader::LoadRequest > > pendingRequests;
+    unsigned startedCount = 0;
+    unsigned finishedCount = 0;
+
+    void Decode( AssetLoader::LoadRequest& request )
+    {
+        if (request.type == AssetLoader::LoadRequest::Type::Mesh)
+        {
+            // Maps the file, so vertices and indices don't have to be copied.
+            request.isDecoded = request.decodedMesh.Decode( request.path.c_str() ) == Mesh::LoadResult::Success;
+            return;
+        }
+
+        request.fileData = FileSystem::FileContents( request.path.c_str() );
+        request.isDecoded = request.fileData.isLoaded;
+
+        if (!request.isDecoded)
+        {
+            return;
+        }
+
+        switch (request.type)
+        {
+            case AssetLoader::LoadRequest::Type::Texture2D:
+                // Formats that are not decoded here are parsed by LoadDecoded().
+                Texture2D::Decode( request.fileData, request.image );
+                break;
+            case AssetLoader::LoadRequest::Type::Mesh:
+                break;
+            case AssetLoader::LoadRequest::Type::AudioClip:
+                request.isDecoded = AudioSystem::DecodeClip( request.fileData, request.decodedClip );
+                request.fileData.data = std::vector< unsigned char >();
+                break;
+            case AssetLoader::LoadRequest::Type::Font:
+                // BMFont metadata is small, so it's parsed in Upload().
+                break;
+        }
+    }
+
+    bool Upload( AssetLoader::LoadRequest& request )
+    {
+        switch (request.type)
+        {
+            case AssetLoader::LoadRequest::Type::Texture2D:
+                request.texture->LoadDecoded( request.fileData, request.image, request.wrap, request.filter, request.mipmaps, request.colorSpace, request.anisotropy );
+                return true;
+            case AssetLoader::LoadRequest::Type::Mesh:
+                return request.mesh->LoadDecoded( request.decodedMesh ) == Mesh::LoadResult::Success;
+            case AssetLoader::LoadRequest::Type::AudioClip:
+                request.audioClip->LoadDecoded( request.decodedClip );
+                return true;
+            case AssetLoader::LoadRequest::Type::Font:
+                request.font->LoadBMFont( request.fontTexture, request.fileData );
+                return true;
+        }
+
+        return false;
+    }
+
+    // Frees decoded data, because handles can keep the request alive.
+    void ReleaseData( AssetLoader::LoadRequest& request )
+    {
+        request.fileData = FileSystem::FileContentsData();
+        request.image = Texture2D::DecodedImage();
+        request.decodedMesh = Mesh();
+        request.decodedClip = AudioSystem::DecodedClip();
+        request.callback = AssetLoader::CompletionCallback();
+    }
+
+    void LoaderThreadMain()
+    {
+        while (true)
+        {
+            std::shared_ptr< AssetLoader::LoadRequest > request;
+
+            {
+                std::unique_lock< std::mutex > lock( mutex );
+                wakeUp.wait( lock, []{ return isQuitting || !queuedRequests.empty(); } );
+
+                if (isQuitting)
+                {
+                    return;
+                }
+
+                request = queuedRequests.front();
+                queuedRequests.pop_front();
+                ++decodingCount;
+            }
+
+            // State changes are compare-exchanges, because the main thread can cancel the request at any time.
+            AssetLoader::LoadState expected = AssetLoader::LoadState::Queued;
+
+            if (request->state.compare_exchange_strong( expected, AssetLoader::LoadState::Decoding ))
+            {
+                Decode( *request );
+                expected = AssetLoader::LoadState::Decoding;
+                request->state.compare_exchange_strong( expected, AssetLoader::LoadState::Decoded );
+            }
+
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                decodedRequests.push_back( request );
+                --decodingCount;
+            }
+
+            decodingDone.notify_all();
+        }
+    }
+
+    AssetLoader::LoadHandle Enqueue( const std::shared_ptr< AssetLoader::LoadRequest >& request )
+    {
+        if (loaderThreads.empty())
+        {
+            // Pak decompression uses JobSystem, which must be started on the main thread.
+            JobSystem::Init();
+
+            for (unsigned i = 0; i < LoaderThreadCount; ++i)
+            {
+                loaderThreads.emplace_back( LoaderThreadMain );
+            }
+        }
+
+        if (pendingRequests.empty())
+        {
+            startedCount = 0;
+            finishedCount = 0;
+        }
+
+        ++startedCount;
+        pendingRequests.push_back( request );
+
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            queuedRequests.push_back( request );
+        }
+
+        wakeUp.notify_one();
+
+        return AssetLoader::LoadHandle( request );
+    }
+
+    std::shared_ptr< AssetLoader::LoadRequest > CreateRequest( AssetLoader::LoadRequest::Type type, const char* path, const AssetLoader::CompletionCallback& callback )
+    {
+        std::shared_ptr< AssetLoader::LoadRequest > request = std::make_shared< AssetLoader::LoadRequest >();
+        request->type = type;
+        request->path = path == nullptr ? "" : path;
+        request->state = AssetLoader::LoadState::Queued;
+        request->callback = callback;
+        return request;
+    }
+}
+
+ae3d::AssetLoader::LoadState ae3d::AssetLoader::LoadHandle::GetState() const
+{
+    return request ? request->state.load() : LoadState::Cancelled;
+}
+
+bool ae3d::AssetLoader::LoadHandle::IsDone() const
+{
+    const LoadState state = GetState();
+    return state == LoadState::Finished || state == LoadState::Failed || state == LoadState::Cancelled;
+}
+
+void ae3d::AssetLoader::LoadHandle::Cancel()
+{
+    if (!request)
+    {
+        return;
+    }
+
+    LoadState state = request->state.load();
+
+    // Retries if a loader thread changed the state in between.
+    while (state != LoadState::Finished && state != LoadState::Failed && state != LoadState::Cancelled &&
+           !request->state.compare_exchange_weak( state, LoadState::Cancelled ))
+    {
+    }
+}
+
+ae3d::AssetLoader::LoadHandle ae3d::AssetLoader::LoadTexture2D( Texture2D* texture, const char* path, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps,
+                                                                ColorSpace colorSpace, Anisotropy anisotropy, const CompletionCallback& callback )
+{
+    std::shared_ptr< LoadRequest > request = CreateRequest( LoadRequest::Type::Texture2D, path, callback );
+    request->texture = texture;
+    request->wrap = wrap;
+    request->filter = filter;
+    request->mipmaps = mipmaps;
+    request->colorSpace = colorSpace;
+    request->anisotropy = anisotropy;
+    return Enqueue( request );
+}
+
+ae3d::AssetLoader::LoadHandle ae3d::AssetLoader::LoadMesh( Mesh* mesh, const char* path, const CompletionCallback& callback )
+{
+    std::shared_ptr< LoadRequest > request = CreateRequest( LoadRequest::Type::Mesh, path, callback );
+    request->mesh = mesh;
+    return Enqueue( request );
+}
+
+ae3d::AssetLoader::LoadHandle ae3d::AssetLoader::LoadAudioClip( AudioClip* audioClip, const char* path, const CompletionCallback& callback )
+{
+    std::shared_ptr< LoadRequest > request = CreateRequest( LoadRequest::Type::AudioClip, path, callback );
+    request->audioClip = audioClip;
+    return Enqueue( request );
+}
+
+ae3d::AssetLoader::LoadHandle ae3d::AssetLoader::LoadBMFont( Font* font, Texture2D* fontTexture, const char* metaPath, const CompletionCallback& callback )
+{
+    std::shared_ptr< LoadRequest > request = CreateRequest( LoadRequest::Type::Font, metaPath, callback );
+    request->font = font;
+    request->fontTexture = fontTexture;
+    return Enqueue( request );
+}
+
+void ae3d::AssetLoader::Update( unsigned maxFinishCount )
+{
+    std::vector< std::shared_ptr< LoadRequest > > finishing;
+
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+
+        while (!decodedRequests.empty() && finishing.size() < maxFinishCount)
+        {
+            finishing.push_back( decodedRequests.front() );
+            decodedRequests.pop_front();
+        }
+    }
+
+    for (auto& request : finishing)
+    {
+        // Loader threads are done with the request, so only Cancel() can change the state.
+        if (request->state == LoadState::Decoded)
+        {
+            request->state = (request->isDecoded && Upload( *request )) ? LoadState::Finished : LoadState::Failed;
+        }
+
+        pendingRequests.erase( std::find( std::begin( pendingRequests ), std::end( pendingRequests ), request ) );
+        ++finishedCount;
+
+        const CompletionCallback callback = request->callback;
+        ReleaseData( *request );
+
+        if (callback)
+        {
+            callback( request->state );
+        }
+    }
+}
+
+float ae3d::AssetLoader::GetProgress()
+{
+    return startedCount == 0 ? 1.0f : finishedCount / static_cast< float >( startedCount );
+}
+
+unsigned ae3d::AssetLoader::GetPendingCount()
+{
+    return static_cast< unsigned >( pendingRequests.size() );
+}
+
+void ae3d::AssetLoader::CancelAll()
+{
+    for (auto& request : pendingRequests)
+    {
+        LoadHandle( request ).Cancel();
+    }
+}
+
+void ae3d::AssetLoader::WaitForDecoding()
+{
+    std::unique_lock< std::mutex > lock( mutex );
+    decodingDone.wait( lock, []{ return loaderThreads.empty() || (queuedRequests.empty() && decodingCount == 0); } );
+}
+
+void ae3d::AssetLoader::Deinit()
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        isQuitting = true;
+    }
+
+    wakeUp.notify_all();
+
+    for (auto& thread : loaderThreads)
+    {
+        thread.join();
+    }
+
+    loaderThreads.clear();
+    queuedRequests.clear();
+    decodedRequests.clear();
+    decodingCount = 0;
+    isQuitting = false;
+
+    for (auto& request : pendingRequests)
+    {
+        request->state = LoadState::Cancelled;
+        ReleaseData( *request );
+    }
+
+    pendingRequests.clear();
+    startedCount = 0;
+    finishedCount = 0;
+}
@@ -6,3 +6,9 @@ void ae3d::AudioClip::Load( const FileSystem::FileContentsData& clipData )
     handle = AudioSystem::GetClipIdForData( clipData );
     length = AudioSystem::GetClipLengthForId( handle );
 }
+
+void ae3d::AudioClip::LoadDecoded( const AudioSystem::DecodedClip& clip )
+{
+    handle = AudioSystem::GetClipIdForDecodedClip( clip );
+    length = AudioSystem::GetClipLengthForId( handle );
+}
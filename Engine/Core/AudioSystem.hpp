@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 namespace ae3d
 {
     namespace FileSystem
@@ -15,6 +18,40 @@ namespace ae3d
         /// Releases all allocated handles and shuts down the audio system.
         void Deinit();
         
+        /// Clip data decoded into PCM samples, but not uploaded to the audio device.
+        struct DecodedClip
+        {
+            /// Path of the source file. Identifies the clip in the clip cache.
+            std::string path;
+            /// Interleaved PCM samples. On backends that decode while uploading, contains the source file instead.
+            std::vector< unsigned char > samples;
+            /// Channel count.
+            unsigned channelCount = 0;
+            /// Bits per sample.
+            unsigned bitsPerSample = 0;
+            /// Sample rate in Hz.
+            unsigned sampleRate = 0;
+            /// Length in seconds.
+            float lengthInSeconds = 0;
+        };
+
+        /**
+          Decodes clip data without touching the audio device, so it can be called from any thread.
+
+          \param clipData .wav or Ogg Vorbis audio data.
+          \param outClip Receives the decoded clip.
+          \return True, if the clip could be decoded.
+         */
+        bool DecodeClip( const FileSystem::FileContentsData& clipData, DecodedClip& outClip );
+
+        /**
+          Uploads a clip decoded by DecodeClip and returns its handle. Must be called from the main thread.
+
+          \param clip Decoded clip.
+          \return Clip handle that can be passed to Play.
+         */
+        unsigned GetClipIdForDecodedClip( const DecodedClip& clip );
+
         /*
           Loads a clip data and returns its handle that can be used to play the clip.
          
@@ -23,6 +60,7 @@ namespace ae3d
          */
         unsigned GetClipIdForData( const FileSystem::FileContentsData& clipData );
         
+        /// \param handle Clip handle from GetClipIdForData.
         /// \return Length in seconds.
         float GetClipLengthForId( unsigned handle );
         
@@ -64,7 +64,7 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
     {
         if (AudioGlobal::clips[ i ].path == clipData.path)
         {
-            return i;
+            return i + 1;
         }
     }
     
@@ -145,9 +145,28 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
     return clipId;
 }
 
+bool ae3d::AudioSystem::DecodeClip( const FileSystem::FileContentsData& clipData, DecodedClip& outClip )
+{
+    // AVAudioFile decodes while reading into the buffer, so only the source file is kept here.
+    outClip = DecodedClip();
+    outClip.path = clipData.path;
+    outClip.samples = clipData.data;
+    return clipData.isLoaded;
+}
+
+unsigned ae3d::AudioSystem::GetClipIdForDecodedClip( const DecodedClip& clip )
+{
+    FileSystem::FileContentsData clipData;
+    clipData.data = clip.samples;
+    clipData.path = clip.path;
+    clipData.pathWithoutBundle = clip.path;
+    clipData.isLoaded = true;
+    return GetClipIdForData( clipData );
+}
+
 float ae3d::AudioSystem::GetClipLengthForId( unsigned handle )
 {
-    return handle < AudioGlobal::clips.count ? AudioGlobal::clips[ handle ].lengthInSeconds : 1;
+    return (handle > 0 && handle <= AudioGlobal::clips.count) ? AudioGlobal::clips[ handle - 1 ].lengthInSeconds : 1;
 }
 
 void ae3d::AudioSystem::Play( unsigned clipId, bool isLooping )
@@ -1,4 +1,5 @@
 #include "AudioSystem.hpp"
+#include <cstdlib>
 #include <sstream>
 #include <string>
 #include <cstdint>
@@ -77,44 +78,34 @@ void CheckOpenALError( const char* info )
     }
 }
 
-void LoadOgg( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
+bool DecodeOgg( const ae3d::FileSystem::FileContentsData& clipData, ae3d::AudioSystem::DecodedClip& outClip )
 {
-    if (AudioGlobal::device == nullptr)
-    {
-        return;
-    }
-
     short* decoded = nullptr;
     int channels = 0;
     int samplerate = 0;
-    const int len = stb_vorbis_decode_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &channels, &samplerate, &decoded );
+    const int sampleCount = stb_vorbis_decode_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &channels, &samplerate, &decoded );
     
-    if (len == 0)
+    if (sampleCount <= 0 || channels <= 0 || samplerate <= 0)
     {
         ae3d::System::Print( "AudioSystem: Could not open %s\n", clipData.path.c_str() );
-        return;
+        free( decoded );
+        return false;
     }
 
-    int error;
-    stb_vorbis* vorbis = stb_vorbis_open_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &error, nullptr );
-    const stb_vorbis_info vinfo = stb_vorbis_get_info( vorbis );
-    
-    const ALenum format = vinfo.channels == 2 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
-    
-    alBufferData( info.bufID, format, &decoded[0], len, vinfo.sample_rate );
-
-    info.lengthInSeconds = stb_vorbis_stream_length_in_seconds( vorbis );
+    // sampleCount is per channel.
+    const std::size_t dataSize = static_cast< std::size_t >( sampleCount ) * channels * sizeof( short );
+    outClip.samples.assign( reinterpret_cast< const unsigned char* >( decoded ), reinterpret_cast< const unsigned char* >( decoded ) + dataSize );
+    outClip.channelCount = static_cast< unsigned >( channels );
+    outClip.bitsPerSample = 16;
+    outClip.sampleRate = static_cast< unsigned >( samplerate );
+    outClip.lengthInSeconds = sampleCount / static_cast< float >( samplerate );
+    free( decoded );
 
-    CheckOpenALError("Loading ogg");
+    return true;
 }
 
-void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
+bool DecodeWav( const ae3d::FileSystem::FileContentsData& clipData, ae3d::AudioSystem::DecodedClip& outClip )
 {
-    if (AudioGlobal::device == nullptr)
-    {
-        return;
-    }
-
     std::istringstream ifs( std::string( clipData.data.begin(), clipData.data.end() ) );
 
     WAVE wav = {};
@@ -124,7 +115,7 @@ void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
         wav.chunkID[2] != 'F' && wav.chunkID[3] != 'F')
     {
         ae3d::System::Print( "LoadWav: %s is not a valid .wav file!\n", clipData.path.c_str() );
-        return;
+        return false;
     }
     
     ifs.read( (char*)&wav.chunkSize, 4 );
@@ -134,7 +125,7 @@ void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
         wav.format[2] != 'V' && wav.format[3] != 'E')
     {
         ae3d::System::Print( "%s is not a valid .wav file!\n", clipData.path.c_str() );
-        return;
+        return false;
     }
     
     ifs.read( (char*)&wav.subchunk1ID, 4 );
@@ -142,32 +133,32 @@ void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
         wav.subchunk1ID[2] != 't' && wav.subchunk1ID[3] != ' ')
     {
         ae3d::System::Print( "%s is not a valid .wav file!\n", clipData.path.c_str() );
-        return;
+        return false;
     }
     
     ifs.read( (char*)&wav.subchunk1Size, 4 );
     if (wav.subchunk1Size == 18)
     {
         ae3d::System::Print( "%s is a non-PCM wave format, not supported!!\n", clipData.path.c_str() );
-        return;
+        return false;
     }
     else if (wav.subchunk1Size == 40)
     {
         ae3d::System::Print( "%s is an extensible wave format, not supported!!\n", clipData.path.c_str() );
-        return;
+        return false;
     }
     
     if (wav.subchunk1Size != 16)
     {
         ae3d::System::Print( "%s does not contain PCM audio data!\n", clipData.path.c_str() );
-        return;
+        return false;
     }
     
     ifs.read( (char*)&wav.audioFormat, 2 );
     if (wav.audioFormat != 1)
     {
         ae3d::System::Print( "%s does not contain uncompressed PCM audio data!\n", clipData.path.c_str() );
-        return;
+        return false;
     }
     
     ifs.read( (char*)&wav.numChannels,   2 );
@@ -182,7 +173,7 @@ void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
         wav.subchunk2ID[2] != 't' && wav.subchunk2ID[3] != 'a')
     {
         ae3d::System::Print( "%s does not contain data chunk!\n", clipData.path.c_str() );
-        return;
+        return false;
     }
     
     ifs.read( (char*)&wav.subchunk2Size, 4 );
@@ -195,42 +186,63 @@ void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
     ifs.seekg( 0, std::ios::end );
     const std::streampos fileSize = ifs.tellg();
     const ALsizei dataSize = (ALsizei)fileSize - 44; // Header is 44 bytes.
+
+    if (dataSize <= 0 || wav.bytesPerSecond == 0)
+    {
+        ae3d::System::Print( "%s does not contain audio data!\n", clipData.path.c_str() );
+        return false;
+    }
     
     ifs.seekg( dataPos );
     
-    wav.data.resize( dataSize );
+    outClip.samples.resize( dataSize );
     
-    ifs.read( (char*)wav.data.data(), dataSize );
+    ifs.read( (char*)outClip.samples.data(), dataSize );
     
+    outClip.channelCount = wav.numChannels;
+    outClip.bitsPerSample = wav.bitsPerSample;
+    outClip.sampleRate = wav.sampleRate;
+    outClip.lengthInSeconds = dataSize / static_cast< float >(wav.bytesPerSecond);
+
+    return true;
+}
+
+void UploadClip( const ae3d::AudioSystem::DecodedClip& clip, ClipInfo& info )
+{
+    if (AudioGlobal::device == nullptr || clip.samples.empty())
+    {
+        return;
+    }
+
     ALenum format = AL_FORMAT_MONO8;
     
-    if (wav.numChannels == 1 && wav.bitsPerSample == 8)
+    if (clip.channelCount == 1 && clip.bitsPerSample == 8)
     {
         format = AL_FORMAT_MONO8;
     }
-    else if (wav.numChannels == 2 && wav.bitsPerSample == 8)
+    else if (clip.channelCount == 2 && clip.bitsPerSample == 8)
     {
         format = AL_FORMAT_STEREO8;
     }
-    else if (wav.numChannels == 1 && wav.bitsPerSample == 16)
+    else if (clip.channelCount == 1 && clip.bitsPerSample == 16)
     {
         format = AL_FORMAT_MONO16;
     }
-    else if (wav.numChannels == 2 && wav.bitsPerSample == 16)
+    else if (clip.channelCount == 2 && clip.bitsPerSample == 16)
     {
         format = AL_FORMAT_STEREO16;
     }
     else
     {
-        ae3d::System::Print( "Audio: Unknown format in file %s\n", clipData.path.c_str() );
+        ae3d::System::Print( "Audio: Unknown format in file %s\n", clip.path.c_str() );
     }
 
     alSourcei( info.srcID, AL_BUFFER, 0 );
-    alBufferData( info.bufID, format, wav.data.data(), dataSize, wav.sampleRate );
+    alBufferData( info.bufID, format, clip.samples.data(), static_cast< ALsizei >( clip.samples.size() ), static_cast< ALsizei >( clip.sampleRate ) );
     alSourcei( info.srcID, AL_BUFFER, info.bufID );
-    CheckOpenALError( "Loading .wav data." );
+    CheckOpenALError( "Loading audio data." );
     
-    info.lengthInSeconds = dataSize / static_cast< float >(wav.bytesPerSecond);
+    info.lengthInSeconds = clip.lengthInSeconds;
 }
 }
 
@@ -240,19 +252,11 @@ void AudioReload( const std::string& path )
     {
         if (path == it->path)
         {
-            const std::string extension = path.substr( path.length() - 3, path.length() );
-            
-            if (extension == "wav" || extension == "WAV")
-            {
-                LoadWav( ae3d::FileSystem::FileContents( path.c_str() ), *it );
-            }
-            else if (extension == "ogg" || extension == "OGG")
-            {
-                LoadOgg( ae3d::FileSystem::FileContents( path.c_str() ), *it );
-            }
-            else
+            ae3d::AudioSystem::DecodedClip clip;
+
+            if (ae3d::AudioSystem::DecodeClip( ae3d::FileSystem::FileContents( path.c_str() ), clip ))
             {
-                ae3d::System::Print( "Unhandled file format %s\n", extension.c_str() );
+                UploadClip( clip, *it );
             }
         }
     }
@@ -295,6 +299,32 @@ void ae3d::AudioSystem::Deinit()
     }
 }
 
+bool ae3d::AudioSystem::DecodeClip( const FileSystem::FileContentsData& clipData, DecodedClip& outClip )
+{
+    outClip = DecodedClip();
+    outClip.path = clipData.path;
+
+    if (!clipData.isLoaded)
+    {
+        System::Print( "AudioSystem: File data %s not loaded!\n", clipData.path.c_str() );
+        return false;
+    }
+
+    const std::string extension = clipData.path.length() >= 3 ? clipData.path.substr( clipData.path.length() - 3 ) : "";
+    
+    if (extension == "wav" || extension == "WAV")
+    {
+        return DecodeWav( clipData, outClip );
+    }
+    else if (extension == "ogg" || extension == "OGG")
+    {
+        return DecodeOgg( clipData, outClip );
+    }
+
+    System::Print( "Unsupported audio file extension in %s. Must be .wav or .ogg.\n", clipData.path.c_str() );
+    return false;
+}
+
 unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData& clipData )
 {
     // Checks cache for an already loaded clip from the same path.
@@ -302,7 +332,7 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
     {
         if (AudioGlobal::clips[ i ].path == clipData.path)
         {
-            return i;
+            return i + 1;
         }
     }
     
@@ -312,43 +342,46 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
         return 0;
     }
 
-    const unsigned clipId = AudioGlobal::clips.count + 1;
+    DecodedClip clip;
+    DecodeClip( clipData, clip );
+
+    return GetClipIdForDecodedClip( clip );
+}
+
+unsigned ae3d::AudioSystem::GetClipIdForDecodedClip( const DecodedClip& clip )
+{
+    // Checks cache for an already loaded clip from the same path.
+    for (unsigned i = 0; i < AudioGlobal::clips.count; ++i)
+    {
+        if (AudioGlobal::clips[ i ].path == clip.path)
+        {
+            return i + 1;
+        }
+    }
 
     ClipInfo info;
-    info.path = clipData.path;
+    info.path = clip.path;
     alGenBuffers( 1, &info.bufID );
     alGenSources( 1, &info.srcID );
 
     AudioGlobal::clips.Add( info );
+    const unsigned clipId = AudioGlobal::clips.count;
 
-    const std::string extension = clipData.path.substr( clipData.path.length() - 3, clipData.path.length() );
-    
-    if (extension == "wav" || extension == "WAV")
-    {
-        LoadWav( clipData, info );
-    }
-    else if (extension == "ogg" || extension == "OGG")
-    {
-        LoadOgg( clipData, info );
-    }
-    else
-    {
-        System::Print( "Unsupported audio file extension in %d. Must be .wav or .ogg.\n", clipData.path.c_str() );
-    }
+    UploadClip( clip, AudioGlobal::clips[ clipId - 1 ] );
     
     alListener3f( AL_POSITION, 0.0f, 0.0f, 0.0f );
     alSource3f( info.srcID, AL_POSITION, 0.0f, 0.0f, 0.0f );
     alSourcei( info.srcID, AL_BUFFER, info.bufID );
     alSourcef( info.srcID, AL_GAIN, 1.0f );
 
-    fileWatcher.AddFile( clipData.path, AudioReload );
+    fileWatcher.AddFile( clip.path, AudioReload );
 
     return clipId;
 }
 
 float ae3d::AudioSystem::GetClipLengthForId( unsigned handle )
 {
-    return handle < AudioGlobal::clips.count ? AudioGlobal::clips[ handle ].lengthInSeconds : 1;
+    return (handle > 0 && handle <= AudioGlobal::clips.count) ? AudioGlobal::clips[ handle - 1 ].lengthInSeconds : 1;
 }
 
 void ae3d::AudioSystem::Play( unsigned clipId, bool isLooping )
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <vector>
+#include "System.hpp"
+
+namespace ae3d
+{
+    /**
+      Storage for components of one type.
+
+      Components are allocated in fixed-size pages, so their addresses don't change when the pool grows.
+      A handle contains a slot index and the slot's generation. The generation is incremented when a component
+      is deleted, so Get returns null for handles to deleted components even after the slot has been reused.
+      Per-slot bookkeeping is stored in separate arrays so that iterating over the slots doesn't touch the components.
+     */
+    template< class T >
+    class ComponentPool
+    {
+    public:
+        /// \return Handle of a new default-constructed component.
+        unsigned New()
+        {
+            unsigned index;
+
+            if (!freeSlots.empty())
+            {
+                index = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else
+            {
+                System::Assert( slotCount <= IndexMask, "Too many components!" );
+
+                if (slotCount == pages.size() * PageSize)
+                {
+                    pages.emplace_back( new T[ PageSize ] );
+                }
+
+                index = slotCount++;
+                generations.push_back( 0 );
+                isAlive.push_back( 0 );
+            }
+
+            isAlive[ index ] = 1;
+            return (generations[ index ] << IndexBits) | index;
+        }
+
+        /// Destroys the component and invalidates its handle. Does nothing if the handle is invalid.
+        /// \param handle Handle returned by New.
+        void Delete( unsigned handle )
+        {
+            T* component = Get( handle );
+
+            if (component == nullptr)
+            {
+                return;
+            }
+
+            const unsigned index = GetIndex( handle );
+            component->~T();
+            new (component) T();
+            isAlive[ index ] = 0;
+            generations[ index ] = (generations[ index ] + 1) & GenerationMask;
+            freeSlots.push_back( index );
+        }
+
+        /// \param handle Handle returned by New.
+        /// \return Component or null if the handle is invalid or the component has been deleted.
+        T* Get( unsigned handle )
+        {
+            const unsigned index = GetIndex( handle );
+
+            if (index >= slotCount || !isAlive[ index ] || generations[ index ] != (handle >> IndexBits))
+            {
+                return nullptr;
+            }
+
+            return &(*this)[ index ];
+        }
+
+        /// \param index Slot index in range [0, GetSlotCount()). The slot can be free.
+        /// \return Component in the slot.
+        T& operator[]( unsigned index )
+        {
+            return pages[ index / PageSize ][ index % PageSize ];
+        }
+
+        /// \param index Slot index in range [0, GetSlotCount()).
+        /// \return True, if the slot contains a component that has not been deleted.
+        bool IsAlive( unsigned index ) const { return isAlive[ index ] != 0; }
+
+        /// \return Number of slots, including free slots.
+        unsigned GetSlotCount() const { return slotCount; }
+
+        /// \param component Component in this pool.
+        /// \return Slot index of the component or InvalidIndex if the component is not in this pool.
+        unsigned FindIndex( const T* component ) const
+        {
+            for (std::size_t pageIndex = 0; pageIndex < pages.size(); ++pageIndex)
+            {
+                const T* page = pages[ pageIndex ].get();
+
+                if (component >= page && component < page + PageSize)
+                {
+                    return static_cast< unsigned >( pageIndex * PageSize + (component - page) );
+                }
+            }
+
+            return InvalidIndex;
+        }
+
+        /// \param handle Handle returned by New.
+        /// \return Slot index of the handle.
+        static unsigned GetIndex( unsigned handle ) { return handle & IndexMask; }
+
+        /// Invalid slot index.
+        static const unsigned InvalidIndex = ~0u;
+
+    private:
+        static const unsigned PageSize = 128;
+        static const unsigned IndexBits = 20;
+        static const unsigned IndexMask = (1u << IndexBits) - 1;
+        static const unsigned GenerationMask = (1u << (32 - IndexBits)) - 1;
+
+        std::vector< std::unique_ptr< T[] > > pages;
+        std::vector< unsigned > generations;
+        std::vector< unsigned char > isAlive;
+        std::vector< unsigned > freeSlots;
+        unsigned slotCount = 0;
+    };
+}
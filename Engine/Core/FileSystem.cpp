@@ -1,14 +1,28 @@
 #include "FileSystem.hpp"
+#include "JobSystem.hpp"
+#include "Lz4.hpp"
+#include "PakFormat.hpp"
 #include "System.hpp"
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <vector>
 #if VK_USE_PLATFORM_ANDROID_KHR
 #include <android/asset_manager.h>
+#elif _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #if RENDERER_METAL
-const char* GetFullPath( const char* fileName )
+std::string ae3d::FileSystem::GetFullPath( const char* fileName )
 {
     if (fileName && fileName[ 0 ] == '/')
     {
@@ -26,31 +40,152 @@ const char* GetFullPath( const char* fileName )
     return [dir fileSystemRepresentation];
 }
 #else
-const char* GetFullPath( const char* fileName )
+std::string ae3d::FileSystem::GetFullPath( const char* fileName )
 {
-    static std::string fName;
-    fName = fileName;
+    // Not static, because files are also read on AssetLoader threads.
+    std::string fName( fileName );
     std::replace( std::begin( fName ), std::end( fName ), '\\', '/' );
-    return fName.c_str();
+    return fName;
 }
 #endif
 
+// Loaded .pak file. Entries are used in place from the mapping.
 struct PakFile
 {
-    struct FileEntry
-    {
-        std::string path;
-        std::vector< unsigned char > contents;
-    };
-
-    std::vector< FileEntry > entries;
     std::string path;
+    std::shared_ptr< ae3d::FileSystem::MappedFileData > mapping; // Shared with MapFile views into the .pak file, which can outlive it.
+    const ae3d::PakFormat::Entry* entries = nullptr;
+    const std::uint32_t* buckets = nullptr;
+    const char* paths = nullptr;
+    std::uint32_t entryCount = 0;
+    std::uint32_t bucketCount = 0;
 };
 
 namespace Global
 {
-    PakFile pakFiles[ 5 ];
-	unsigned packFileCount = 0;
+    std::vector< PakFile > pakFiles; // In load order. Earlier .pak files have precedence.
+}
+
+namespace
+{
+    const ae3d::PakFormat::Entry* FindEntry( const PakFile& pakFile, const std::string& path )
+    {
+        const std::uint64_t hash = ae3d::PakFormat::HashPath( path.c_str(), path.size() );
+        const std::uint32_t bucketMask = pakFile.bucketCount - 1;
+
+        // LoadPakFile has checked that there's at least one empty bucket. Probes are also capped, so a lookup terminates even if it didn't.
+        std::uint32_t bucket = static_cast< std::uint32_t >( hash ) & bucketMask;
+
+        for (std::uint32_t probe = 0; probe < pakFile.bucketCount; ++probe, bucket = (bucket + 1) & bucketMask)
+        {
+            const std::uint32_t entryIndex = pakFile.buckets[ bucket ];
+
+            if (entryIndex == 0 || entryIndex > pakFile.entryCount)
+            {
+                return nullptr;
+            }
+
+            const ae3d::PakFormat::Entry& entry = pakFile.entries[ entryIndex - 1 ];
+
+            if (entry.pathHash == hash && entry.pathLength == path.size() && std::memcmp( pakFile.paths + entry.pathOffset, path.c_str(), path.size() ) == 0)
+            {
+                return &entry;
+            }
+        }
+
+        return nullptr;
+    }
+
+    bool FindInPakFiles( const std::string& path, const PakFile*& outPakFile, const ae3d::PakFormat::Entry*& outEntry )
+    {
+        for (const auto& pakFile : Global::pakFiles)
+        {
+            outEntry = FindEntry( pakFile, path );
+
+            if (outEntry != nullptr)
+            {
+                outPakFile = &pakFile;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Large entries have many blocks that are decompressed in parallel.
+    bool DecompressEntry( const PakFile& pakFile, const ae3d::PakFormat::Entry& entry, unsigned char* destination )
+    {
+        using namespace ae3d;
+
+        const unsigned char* const data = pakFile.mapping->data + entry.dataOffset;
+        const std::uint64_t blockCount = (entry.uncompressedSize + PakFormat::CompressionBlockSize - 1) / PakFormat::CompressionBlockSize;
+
+        if (blockCount > entry.dataSize / sizeof( std::uint32_t ))
+        {
+            return false;
+        }
+
+        std::vector< std::uint64_t > blockOffsets( blockCount + 1 );
+        blockOffsets[ 0 ] = blockCount * sizeof( std::uint32_t );
+
+        for (std::size_t b = 0; b < blockCount; ++b)
+        {
+            std::uint32_t blockSize;
+            std::memcpy( &blockSize, data + b * sizeof( std::uint32_t ), sizeof( blockSize ) );
+            blockOffsets[ b + 1 ] = blockOffsets[ b ] + blockSize;
+        }
+
+        if (blockOffsets[ blockCount ] > entry.dataSize)
+        {
+            return false;
+        }
+
+        std::atomic< bool > isValid( true );
+
+        JobSystem::ParallelFor( static_cast< unsigned >( blockCount ), 1, [&]( unsigned first, unsigned last )
+        {
+            for (unsigned b = first; b < last; ++b)
+            {
+                const std::uint64_t uncompressedOffset = b * PakFormat::CompressionBlockSize;
+                const std::size_t uncompressedSize = static_cast< std::size_t >( std::min( PakFormat::CompressionBlockSize, entry.uncompressedSize - uncompressedOffset ) );
+                const std::size_t storedSize = blockOffsets[ b + 1 ] - blockOffsets[ b ];
+                const unsigned char* const block = data + blockOffsets[ b ];
+
+                if (storedSize == uncompressedSize)
+                {
+                    std::memcpy( destination + uncompressedOffset, block, uncompressedSize );
+                }
+                else if (!Lz4::Decompress( block, storedSize, destination + uncompressedOffset, uncompressedSize ))
+                {
+                    isValid = false;
+                }
+            }
+        } );
+
+        return isValid;
+    }
+
+    // \param destination Receives entry.uncompressedSize bytes.
+    bool ReadPakEntry( const PakFile& pakFile, const ae3d::PakFormat::Entry& entry, unsigned char* destination )
+    {
+        if ((entry.flags & ae3d::PakFormat::EntryFlags::Compressed) == 0)
+        {
+            if (entry.dataSize > 0)
+            {
+                std::memcpy( destination, pakFile.mapping->data + entry.dataOffset, static_cast< std::size_t >( entry.dataSize ) );
+            }
+
+            return true;
+        }
+
+        if (!DecompressEntry( pakFile, entry, destination ))
+        {
+            ae3d::System::Print( "FileSystem: Could not decompress %.*s in %s. The .pak file is corrupted.\n", static_cast< int >( entry.pathLength ), pakFile.paths + entry.pathOffset, pakFile.path.c_str() );
+            return false;
+        }
+
+        return true;
+    }
 }
 
 #if VK_USE_PLATFORM_ANDROID_KHR
@@ -59,7 +194,7 @@ extern AAssetManager* assetManager;
 ae3d::FileSystem::FileContentsData ae3d::FileSystem::FileContents( const char* path )
 {
     ae3d::FileSystem::FileContentsData outData;
-    outData.path = outData.path = path == nullptr ? "" : std::string( GetFullPath( path ) );
+    outData.path = outData.path = path == nullptr ? "" : GetFullPath( path );
 
     AAsset* file = AAssetManager_open( assetManager, path, AASSET_MODE_BUFFER );
 
@@ -77,22 +212,25 @@ ae3d::FileSystem::FileContentsData ae3d::FileSystem::FileContents( const char* p
 ae3d::FileSystem::FileContentsData ae3d::FileSystem::FileContents( const char* path )
 {
     ae3d::FileSystem::FileContentsData outData;
-    outData.path = path == nullptr ? "" : std::string( GetFullPath( path ) );
+    outData.path = path == nullptr ? "" : GetFullPath( path );
 #if defined __APPLE__
         outData.pathWithoutBundle = path;
 #endif
 
-    for (const auto& pakFile : Global::pakFiles)
+    const PakFile* pakFile = nullptr;
+    const PakFormat::Entry* pakEntry = nullptr;
+
+    if (FindInPakFiles( outData.path, pakFile, pakEntry ))
     {
-        for (const auto& entry : pakFile.entries)
+        outData.data.resize( static_cast< std::size_t >( pakEntry->uncompressedSize ) );
+        outData.isLoaded = ReadPakEntry( *pakFile, *pakEntry, outData.data.data() );
+
+        if (!outData.isLoaded)
         {
-            if (entry.path == outData.path)
-            {
-                outData.data = entry.contents;
-                outData.isLoaded = true;
-                return outData;
-            }
+            outData.data.clear();
         }
+
+        return outData;
     }
 
     std::ifstream in( outData.path.c_str(), std::ifstream::ate | std::ifstream::binary );
@@ -113,6 +251,119 @@ ae3d::FileSystem::FileContentsData ae3d::FileSystem::FileContents( const char* p
 }
 #endif
 
+ae3d::FileSystem::MappedFileData ae3d::FileSystem::MapFile( const char* path )
+{
+    MappedFileData outFile;
+    outFile.path = path == nullptr ? "" : GetFullPath( path );
+
+    const PakFile* pakFile = nullptr;
+    const PakFormat::Entry* pakEntry = nullptr;
+
+    if (FindInPakFiles( outFile.path, pakFile, pakEntry ))
+    {
+        if ((pakEntry->flags & PakFormat::EntryFlags::Compressed) == 0)
+        {
+            outFile.data = pakFile->mapping->data + pakEntry->dataOffset;
+            outFile.size = static_cast< std::size_t >( pakEntry->dataSize );
+            outFile.owner = pakFile->mapping;
+            return outFile;
+        }
+
+        auto decompressed = std::make_shared< std::vector< unsigned char > >( static_cast< std::size_t >( pakEntry->uncompressedSize ) );
+
+        if (ReadPakEntry( *pakFile, *pakEntry, decompressed->data() ))
+        {
+            outFile.owner = decompressed;
+            outFile.data = decompressed->data();
+            outFile.size = decompressed->size();
+        }
+
+        return outFile;
+    }
+
+#if VK_USE_PLATFORM_ANDROID_KHR
+    AAsset* asset = AAssetManager_open( assetManager, path, AASSET_MODE_BUFFER );
+
+    if (asset != nullptr)
+    {
+        outFile.data = static_cast< const unsigned char* >( AAsset_getBuffer( asset ) );
+        outFile.size = AAsset_getLength( asset );
+        outFile.handle = asset;
+    }
+#elif _WIN32
+    HANDLE file = CreateFileA( outFile.path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER size;
+
+        if (GetFileSizeEx( file, &size ) && size.QuadPart > 0)
+        {
+            HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+
+            if (mapping != nullptr)
+            {
+                outFile.data = static_cast< const unsigned char* >( MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+                outFile.size = outFile.data ? static_cast< std::size_t >( size.QuadPart ) : 0;
+                outFile.handle = mapping;
+            }
+        }
+
+        // The mapping keeps the file open.
+        CloseHandle( file );
+    }
+#else
+    const int file = open( outFile.path.c_str(), O_RDONLY );
+
+    if (file != -1)
+    {
+        struct stat fileStat;
+
+        if (fstat( file, &fileStat ) == 0 && fileStat.st_size > 0)
+        {
+            void* address = mmap( nullptr, static_cast< std::size_t >( fileStat.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+
+            if (address != MAP_FAILED)
+            {
+                outFile.data = static_cast< const unsigned char* >( address );
+                outFile.size = static_cast< std::size_t >( fileStat.st_size );
+                outFile.handle = address;
+            }
+        }
+
+        // The mapping keeps the file open.
+        close( file );
+    }
+#endif
+
+    if (outFile.data == nullptr)
+    {
+        System::Print( "FileSystem: Could not map %s.\n", outFile.path.c_str() );
+    }
+
+    return outFile;
+}
+
+void ae3d::FileSystem::UnmapFile( MappedFileData& file )
+{
+    if (file.handle != nullptr)
+    {
+#if VK_USE_PLATFORM_ANDROID_KHR
+        AAsset_close( static_cast< AAsset* >( file.handle ) );
+#elif _WIN32
+        UnmapViewOfFile( file.data );
+        CloseHandle( file.handle );
+#else
+        munmap( file.handle, file.size );
+#endif
+    }
+
+    file.data = nullptr;
+    file.size = 0;
+    file.handle = nullptr;
+    file.owner.reset();
+}
+
 void ae3d::FileSystem::LoadPakFile( const char* path )
 {
     if (path == nullptr)
@@ -121,45 +372,119 @@ void ae3d::FileSystem::LoadPakFile( const char* path )
         return;
     }
 
-    unsigned entryCount = 0;
-    std::ifstream ifs( path );
-    if (!ifs.is_open())
+    for (const auto& loadedPakFile : Global::pakFiles)
+    {
+        if (loadedPakFile.path == path)
+        {
+            return;
+        }
+    }
+
+    PakFile pakFile;
+    pakFile.path = path;
+    pakFile.mapping.reset( new MappedFileData( MapFile( path ) ), []( MappedFileData* mapping )
+    {
+        UnmapFile( *mapping );
+        delete mapping;
+    } );
+
+    if (pakFile.mapping->data == nullptr)
     {
         System::Print( "LoadPakFile: Could not open %s\n", path );
         return;
     }
 
-    ifs.read( (char*)&entryCount, 4 );
-    auto& pakFile = Global::pakFiles[ Global::packFileCount ];
-	++Global::packFileCount;
-    pakFile.entries.resize( entryCount );
-    pakFile.path = path;
+    const unsigned char* const data = pakFile.mapping->data;
+    const std::uint64_t size = pakFile.mapping->size;
+    PakFormat::Header header;
+
+    if (size < sizeof( header ) || std::memcmp( data, PakFormat::Magic, sizeof( PakFormat::Magic ) ) != 0)
+    {
+        System::Print( "LoadPakFile: %s is not a .pak file or it's from an old version of CombineFiles. Rebuild it with CombineFiles.\n", path );
+        return;
+    }
+
+    std::memcpy( &header, data, sizeof( header ) );
+
+    if (header.version != PakFormat::Version)
+    {
+        System::Print( "LoadPakFile: %s has version %u but version %u is needed. Rebuild it with CombineFiles.\n", path, header.version, PakFormat::Version );
+        return;
+    }
+
+    const bool isValid =
+        header.bucketCount > header.entryCount && (header.bucketCount & (header.bucketCount - 1)) == 0 &&
+        header.entriesOffset % alignof( PakFormat::Entry ) == 0 && header.bucketsOffset % alignof( std::uint32_t ) == 0 &&
+        header.entriesOffset <= size && header.entryCount <= (size - header.entriesOffset) / sizeof( PakFormat::Entry ) &&
+        header.bucketsOffset <= size && header.bucketCount <= (size - header.bucketsOffset) / sizeof( std::uint32_t ) &&
+        header.pathsOffset <= size && header.pathsSize <= size - header.pathsOffset &&
+        reinterpret_cast< std::uintptr_t >( data ) % alignof( PakFormat::Entry ) == 0;
+
+    if (!isValid)
+    {
+        System::Print( "LoadPakFile: %s has a corrupted header.\n", path );
+        return;
+    }
+
+    pakFile.entries = reinterpret_cast< const PakFormat::Entry* >( data + header.entriesOffset );
+    pakFile.buckets = reinterpret_cast< const std::uint32_t* >( data + header.bucketsOffset );
+    pakFile.paths = reinterpret_cast< const char* >( data + header.pathsOffset );
+    pakFile.entryCount = header.entryCount;
+    pakFile.bucketCount = header.bucketCount;
+
+    // Checking the entries here means that lookups don't need to.
+    for (std::uint32_t i = 0; i < header.entryCount; ++i)
+    {
+        const PakFormat::Entry& entry = pakFile.entries[ i ];
+
+        const bool isCompressed = (entry.flags & PakFormat::EntryFlags::Compressed) != 0;
 
-    for (unsigned i = 0; i < entryCount; ++i)
+        if (entry.dataOffset > size || entry.dataSize > size - entry.dataOffset ||
+            entry.pathOffset > header.pathsSize || entry.pathLength > header.pathsSize - entry.pathOffset ||
+            (entry.flags & ~PakFormat::EntryFlags::Compressed) != 0 || (!isCompressed && entry.uncompressedSize != entry.dataSize))
+        {
+            System::Print( "LoadPakFile: %s has a corrupted entry %u.\n", path, i );
+            return;
+        }
+    }
+
+    // Lookups stop at an empty bucket, so the table must have one.
+    bool hasEmptyBucket = false;
+
+    for (std::uint32_t i = 0; i < header.bucketCount; ++i)
     {
-        auto& entry = pakFile.entries[i];
-        char entryPath[ 128 ];
-        ifs.read( &entryPath[ 0 ], 128 );
-        entry.path = entryPath;
-        unsigned entrySize = 0;
-        ifs.read( (char*)&entrySize, 4 );
-        entry.contents.resize( entrySize );
-        ifs.read( (char*)entry.contents.data(), entrySize );
+        if (pakFile.buckets[ i ] > header.entryCount)
+        {
+            System::Print( "LoadPakFile: %s has a corrupted bucket %u.\n", path, i );
+            return;
+        }
+
+        hasEmptyBucket |= pakFile.buckets[ i ] == 0;
+    }
+
+    if (!hasEmptyBucket)
+    {
+        System::Print( "LoadPakFile: %s has no empty buckets.\n", path );
+        return;
     }
+
+    Global::pakFiles.push_back( pakFile );
 }
 
 void ae3d::FileSystem::UnloadPakFile( const char* path )
 {
-    int i = 0;
+    if (path == nullptr)
+    {
+        return;
+    }
 
-    for (const PakFile& pakFile : Global::pakFiles)
+    for (auto it = std::begin( Global::pakFiles ); it != std::end( Global::pakFiles ); ++it)
     {
-        if (pakFile.path == std::string( path ))
+        if (it->path == path)
         {
-			// FIXME: Do something here.
-            //Global::pakFiles.erase( std::begin( Global::pakFiles ) + i );
+            // Unmapped when views from MapFile have also been unmapped.
+            Global::pakFiles.erase( it );
             return;
         }
-        ++i;
     }
 }
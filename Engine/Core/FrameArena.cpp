@@ -0,0 +1,115 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "FrameArena.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    const std::size_t MinBlockSize = 64 * 1024;
+
+    struct Block
+    {
+        std::unique_ptr< unsigned char[] > memory;
+        std::size_t size = 0;
+    };
+
+    // Allocations are made from the last block. Blocks before it are full.
+    struct Arena
+    {
+        std::vector< Block > blocks;
+        std::size_t offset = 0; // In the last block.
+    };
+
+    std::mutex arenasMutex;
+    std::vector< std::unique_ptr< Arena > > arenas; // Kept after their thread exits, threads are long-lived.
+    thread_local Arena* threadArena = nullptr;
+    std::atomic< unsigned > heapAllocationCount( 0 );
+
+    void AddBlock( Arena& arena, std::size_t size )
+    {
+        Block block;
+        block.memory.reset( new unsigned char[ size ] );
+        block.size = size;
+        arena.blocks.push_back( std::move( block ) );
+        arena.offset = 0;
+        ++heapAllocationCount;
+    }
+}
+
+void* ae3d::FrameArena::Allocate( std::size_t size, std::size_t alignment )
+{
+    if (threadArena == nullptr)
+    {
+        std::lock_guard< std::mutex > lock( arenasMutex );
+        arenas.emplace_back( new Arena() );
+        threadArena = arenas.back().get();
+    }
+
+    Arena& arena = *threadArena;
+
+    if (!arena.blocks.empty())
+    {
+        Block& block = arena.blocks.back();
+        const std::uintptr_t address = reinterpret_cast< std::uintptr_t >( block.memory.get() ) + arena.offset;
+        const std::size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+
+        if (arena.offset + padding + size <= block.size)
+        {
+            arena.offset += padding + size;
+            return block.memory.get() + arena.offset - size;
+        }
+    }
+
+    // new[] aligns to at least alignof( std::max_align_t ), larger alignments get padding.
+    const std::size_t lastSize = arena.blocks.empty() ? 0 : arena.blocks.back().size;
+    const std::size_t neededSize = size + alignment;
+    AddBlock( arena, neededSize > lastSize * 2 ? (neededSize > MinBlockSize ? neededSize : MinBlockSize) : lastSize * 2 );
+    return Allocate( size, alignment );
+}
+
+void ae3d::FrameArena::Free( void* memory, std::size_t size )
+{
+    if (threadArena == nullptr || threadArena->blocks.empty() || memory == nullptr)
+    {
+        return;
+    }
+
+    Arena& arena = *threadArena;
+    unsigned char* top = arena.blocks.back().memory.get() + arena.offset;
+
+    if (static_cast< unsigned char* >( memory ) + size == top)
+    {
+        arena.offset -= size;
+    }
+}
+
+void ae3d::FrameArena::Reset()
+{
+    std::lock_guard< std::mutex > lock( arenasMutex );
+
+    for (auto& arena : arenas)
+    {
+        if (arena->blocks.size() > 1)
+        {
+            std::size_t totalSize = 0;
+
+            for (const auto& block : arena->blocks)
+            {
+                totalSize += block.size;
+            }
+
+            arena->blocks.clear();
+            AddBlock( *arena, totalSize );
+        }
+
+        arena->offset = 0;
+    }
+}
+
+unsigned ae3d::FrameArena::GetHeapAllocationCount()
+{
+    return heapAllocationCount;
+}
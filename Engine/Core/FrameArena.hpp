@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace ae3d
+{
+    /**
+      Linear allocator for scratch data that is only needed during a frame, like per-camera arrays in the render loop.
+
+      Each thread allocates from its own arena, so workers don't need locks. Allocations are freed all at once by
+      Reset(), which Scene::EndFrame calls. Freeing the latest allocation early gives its memory back, so scoped
+      scratch can be reused within a frame. An arena that needed more than one block during a frame gets one block of
+      their combined size at the reset, so after the first frames allocating doesn't touch the heap.
+     */
+    namespace FrameArena
+    {
+        /// \param size Size in bytes.
+        /// \param alignment Alignment in bytes. Must be a power of two.
+        /// \return Memory that stays valid until Reset().
+        void* Allocate( std::size_t size, std::size_t alignment );
+
+        /// Gives the memory back if it's the calling thread's latest allocation. Otherwise does nothing, and the memory is freed by Reset().
+        /// \param memory Memory returned by Allocate on the calling thread.
+        /// \param size Size that was given to Allocate.
+        void Free( void* memory, std::size_t size );
+
+        /// Frees all allocations of all threads. Must not be called while other threads allocate.
+        void Reset();
+
+        /// \return Number of blocks that arenas have allocated from the heap since startup. Tests use this to check that frames don't allocate.
+        unsigned GetHeapAllocationCount();
+    }
+
+    /// Array whose elements are in the calling thread's frame arena. Must be destroyed in reverse order of creation to reuse the memory.
+    template< typename T > struct FrameArray
+    {
+        static_assert( std::is_trivially_destructible< T >::value, "Frame arena doesn't call destructors" );
+
+        explicit FrameArray( unsigned elementCount )
+            : elements( static_cast< T* >( FrameArena::Allocate( elementCount * sizeof( T ), alignof( T ) ) ) )
+            , count( elementCount )
+        {
+            for (unsigned i = 0; i < count; ++i)
+            {
+                new( &elements[ i ] )T();
+            }
+        }
+
+        FrameArray( const FrameArray& ) = delete;
+        FrameArray& operator=( const FrameArray& ) = delete;
+
+        ~FrameArray() { FrameArena::Free( elements, count * sizeof( T ) ); }
+
+        T& operator[]( unsigned index ) { return elements[ index ]; }
+        const T& operator[]( unsigned index ) const { return elements[ index ]; }
+
+        T* const elements;
+        const unsigned count;
+    };
+
+    /// Standard library allocator that uses the frame arena, so containers can be used as scratch without heap allocations.
+    template< typename T > struct FrameAllocator
+    {
+        typedef T value_type;
+
+        FrameAllocator() noexcept {}
+        template< typename U > FrameAllocator( const FrameAllocator< U >& ) noexcept {}
+
+        T* allocate( std::size_t n ) { return static_cast< T* >( FrameArena::Allocate( n * sizeof( T ), alignof( T ) ) ); }
+        void deallocate( T* p, std::size_t n ) noexcept { FrameArena::Free( p, n * sizeof( T ) ); }
+
+        template< typename U > bool operator==( const FrameAllocator< U >& ) const noexcept { return true; }
+        template< typename U > bool operator!=( const FrameAllocator< U >& ) const noexcept { return false; }
+    };
+
+    /// Vector for scratch data that lives at most until the end of the frame.
+    template< typename T > using FrameVector = std::vector< T, FrameAllocator< T > >;
+}
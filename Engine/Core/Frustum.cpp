@@ -1,9 +1,47 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Frustum.hpp"
+#include <cmath>
+#if defined( __AVX__ )
+#include <immintrin.h>
+#elif SIMD_SSE3
+#include <pmmintrin.h>
+#elif defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+#include "Matrix.hpp"
 
 using namespace ae3d;
 
+namespace
+{
+    enum FrustumPlane
+    {
+        FARP = 0,
+        NEARP,
+        BOTTOM,
+        TOP,
+        LEFT,
+        RIGHT
+    };
+
+    bool IsBoxInside( const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez,
+                      unsigned i, const float planeValues[ 6 ][ 7 ] )
+    {
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* v = planeValues[ p ];
+
+            if (v[ 0 ] * cx[ i ] + v[ 1 ] * cy[ i ] + v[ 2 ] * cz[ i ] + v[ 3 ] + v[ 4 ] * ex[ i ] + v[ 5 ] * ey[ i ] + v[ 6 ] * ez[ i ] < 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
 void Frustum::UpdateCornersAndCenters( const Vec3& cameraPosition, const Vec3& zAxis )
 {
     const Vec3 up( 0, 1, 0 );
@@ -42,7 +80,7 @@ Vec3 Frustum::Centroid() const
     return (nearCenter + farCenter) * 0.5f;
 }
 
-void Frustum::Plane::CalculateNormal()
+void Frustum::Plane::CalculateNormal( const Vec3& a, const Vec3& b, const Vec3& c )
 {
     const Vec3 v1 = a - b;
     const Vec3 v2 = c - b;
@@ -86,40 +124,31 @@ void Frustum::Update( const Vec3& cameraPosition, const Vec3& cameraDirection )
     const Vec3 zAxis = cameraDirection;
     UpdateCornersAndCenters( cameraPosition, zAxis );
     
-    enum FrustumPlane
-    {
-        FARP = 0,
-        NEARP,
-        BOTTOM,
-        TOP,
-        LEFT,
-        RIGHT
-    };
-    
-    planes[ FrustumPlane::TOP ].a = nearTopRight;
-    planes[ FrustumPlane::TOP ].b = nearTopLeft;
-    planes[ FrustumPlane::TOP ].c = farTopLeft;
-    planes[ FrustumPlane::TOP ].CalculateNormal();
-    
-    planes[ FrustumPlane::BOTTOM ].a = nearBottomLeft;
-    planes[ FrustumPlane::BOTTOM ].b = nearBottomRight;
-    planes[ FrustumPlane::BOTTOM ].c = farBottomRight;
-    planes[ FrustumPlane::BOTTOM ].CalculateNormal();
-    
-    planes[ FrustumPlane::LEFT ].a = nearTopLeft;
-    planes[ FrustumPlane::LEFT ].b = nearBottomLeft;
-    planes[ FrustumPlane::LEFT ].c = farBottomLeft;
-    planes[ FrustumPlane::LEFT ].CalculateNormal();
-    
-    planes[ FrustumPlane::RIGHT ].a = nearBottomRight;
-    planes[ FrustumPlane::RIGHT ].b = nearTopRight;
-    planes[ FrustumPlane::RIGHT ].c = farBottomRight;
-    planes[ FrustumPlane::RIGHT ].CalculateNormal();
-    
+    planes[ FrustumPlane::TOP ].CalculateNormal( nearTopRight, nearTopLeft, farTopLeft );
+    planes[ FrustumPlane::BOTTOM ].CalculateNormal( nearBottomLeft, nearBottomRight, farBottomRight );
+    planes[ FrustumPlane::LEFT ].CalculateNormal( nearTopLeft, nearBottomLeft, farBottomLeft );
+    planes[ FrustumPlane::RIGHT ].CalculateNormal( nearBottomRight, nearTopRight, farBottomRight );
     planes[ FrustumPlane::NEARP ].SetNormalAndPoint( -zAxis, nearCenter );
     planes[ FrustumPlane::FARP  ].SetNormalAndPoint(  zAxis, farCenter  );
 }
 
+void Frustum::SetFromViewProjection( const Matrix44& worldToClip )
+{
+    // Points are row vectors, so clip-space x, y, z and w are dot products with the matrix columns.
+    const float* m = worldToClip.m;
+    const float sign[ 6 ] = { -1, 1, 1, -1, 1, -1 };
+    const int column[ 6 ] = { 2, 2, 1, 1, 0, 0 };
+
+    for (int p = 0; p < 6; ++p)
+    {
+        const int c = column[ p ];
+        const Vec3 normal( m[ 3 ] + sign[ p ] * m[ c ], m[ 7 ] + sign[ p ] * m[ 4 + c ], m[ 11 ] + sign[ p ] * m[ 8 + c ] );
+        const float invLength = 1.0f / normal.Length();
+        planes[ p ].normal = normal * invLength;
+        planes[ p ].d = (m[ 15 ] + sign[ p ] * m[ 12 + c ]) * invLength;
+    }
+}
+
 bool Frustum::BoxInFrustum( const Vec3& min, const Vec3& max ) const
 {
     bool result = true;
@@ -153,6 +182,142 @@ bool Frustum::BoxInFrustum( const Vec3& min, const Vec3& max ) const
     return result;
 }
 
+void Frustum::CullBoxes( const BoxArrays& boxes, unsigned* outVisibleMask ) const
+{
+    const float* cx = boxes.centerX;
+    const float* cy = boxes.centerY;
+    const float* cz = boxes.centerZ;
+    const float* ex = boxes.extentX;
+    const float* ey = boxes.extentY;
+    const float* ez = boxes.extentZ;
+
+    // A box is outside a plane if its center's distance plus its extent projected onto the normal is negative.
+    float planeValues[ 6 ][ 7 ];
+
+    for (int p = 0; p < 6; ++p)
+    {
+        const Vec3& n = planes[ p ].normal;
+        const float values[ 7 ] = { n.x, n.y, n.z, planes[ p ].d, std::fabs( n.x ), std::fabs( n.y ), std::fabs( n.z ) };
+
+        for (int v = 0; v < 7; ++v)
+        {
+            planeValues[ p ][ v ] = values[ v ];
+        }
+    }
+
+    for (unsigned w = 0; w < (boxes.count + 31) / 32; ++w)
+    {
+        outVisibleMask[ w ] = 0;
+    }
+
+    unsigned i = 0;
+
+#if defined( __AVX__ )
+    __m256 planes8[ 6 ][ 7 ];
+
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int v = 0; v < 7; ++v)
+        {
+            planes8[ p ][ v ] = _mm256_set1_ps( planeValues[ p ][ v ] );
+        }
+    }
+
+    for (; i + 8 <= boxes.count; i += 8)
+    {
+        const __m256 centerX = _mm256_loadu_ps( cx + i );
+        const __m256 centerY = _mm256_loadu_ps( cy + i );
+        const __m256 centerZ = _mm256_loadu_ps( cz + i );
+        const __m256 extentX = _mm256_loadu_ps( ex + i );
+        const __m256 extentY = _mm256_loadu_ps( ey + i );
+        const __m256 extentZ = _mm256_loadu_ps( ez + i );
+        __m256 inside = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+
+        for (int p = 0; p < 6; ++p)
+        {
+            const __m256* v = planes8[ p ];
+            const __m256 distance = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( v[ 0 ], centerX ), _mm256_mul_ps( v[ 1 ], centerY ) ),
+                                                   _mm256_add_ps( _mm256_mul_ps( v[ 2 ], centerZ ), v[ 3 ] ) );
+            const __m256 radius = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( v[ 4 ], extentX ), _mm256_mul_ps( v[ 5 ], extentY ) ), _mm256_mul_ps( v[ 6 ], extentZ ) );
+            inside = _mm256_and_ps( inside, _mm256_cmp_ps( _mm256_add_ps( distance, radius ), _mm256_setzero_ps(), _CMP_GE_OQ ) );
+        }
+
+        outVisibleMask[ i / 32 ] |= static_cast< unsigned >( _mm256_movemask_ps( inside ) ) << (i % 32);
+    }
+#endif
+#if defined( __AVX__ ) || SIMD_SSE3
+    __m128 planes4[ 6 ][ 7 ];
+
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int v = 0; v < 7; ++v)
+        {
+            planes4[ p ][ v ] = _mm_set1_ps( planeValues[ p ][ v ] );
+        }
+    }
+
+    for (; i + 4 <= boxes.count; i += 4)
+    {
+        const __m128 centerX = _mm_loadu_ps( cx + i );
+        const __m128 centerY = _mm_loadu_ps( cy + i );
+        const __m128 centerZ = _mm_loadu_ps( cz + i );
+        const __m128 extentX = _mm_loadu_ps( ex + i );
+        const __m128 extentY = _mm_loadu_ps( ey + i );
+        const __m128 extentZ = _mm_loadu_ps( ez + i );
+        __m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+
+        for (int p = 0; p < 6; ++p)
+        {
+            const __m128* v = planes4[ p ];
+            const __m128 distance = _mm_add_ps( _mm_add_ps( _mm_mul_ps( v[ 0 ], centerX ), _mm_mul_ps( v[ 1 ], centerY ) ),
+                                                _mm_add_ps( _mm_mul_ps( v[ 2 ], centerZ ), v[ 3 ] ) );
+            const __m128 radius = _mm_add_ps( _mm_add_ps( _mm_mul_ps( v[ 4 ], extentX ), _mm_mul_ps( v[ 5 ], extentY ) ), _mm_mul_ps( v[ 6 ], extentZ ) );
+            inside = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( distance, radius ), _mm_setzero_ps() ) );
+        }
+
+        outVisibleMask[ i / 32 ] |= static_cast< unsigned >( _mm_movemask_ps( inside ) ) << (i % 32);
+    }
+#elif defined( __ARM_NEON )
+    const uint32x4_t laneBits = { 1, 2, 4, 8 };
+
+    for (; i + 4 <= boxes.count; i += 4)
+    {
+        const float32x4_t centerX = vld1q_f32( cx + i );
+        const float32x4_t centerY = vld1q_f32( cy + i );
+        const float32x4_t centerZ = vld1q_f32( cz + i );
+        const float32x4_t extentX = vld1q_f32( ex + i );
+        const float32x4_t extentY = vld1q_f32( ey + i );
+        const float32x4_t extentZ = vld1q_f32( ez + i );
+        uint32x4_t inside = vdupq_n_u32( ~0u );
+
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* v = planeValues[ p ];
+            float32x4_t sum = vdupq_n_f32( v[ 3 ] );
+            sum = vmlaq_n_f32( sum, centerX, v[ 0 ] );
+            sum = vmlaq_n_f32( sum, centerY, v[ 1 ] );
+            sum = vmlaq_n_f32( sum, centerZ, v[ 2 ] );
+            sum = vmlaq_n_f32( sum, extentX, v[ 4 ] );
+            sum = vmlaq_n_f32( sum, extentY, v[ 5 ] );
+            sum = vmlaq_n_f32( sum, extentZ, v[ 6 ] );
+            inside = vandq_u32( inside, vcgeq_f32( sum, vdupq_n_f32( 0 ) ) );
+        }
+
+        const uint32x4_t bits = vandq_u32( inside, laneBits );
+        const unsigned mask = vgetq_lane_u32( bits, 0 ) | vgetq_lane_u32( bits, 1 ) | vgetq_lane_u32( bits, 2 ) | vgetq_lane_u32( bits, 3 );
+        outVisibleMask[ i / 32 ] |= mask << (i % 32);
+    }
+#endif
+
+    for (; i < boxes.count; ++i)
+    {
+        if (IsBoxInside( cx, cy, cz, ex, ey, ez, i, planeValues ))
+        {
+            outVisibleMask[ i / 32 ] |= 1u << (i % 32);
+        }
+    }
+}
+
 const Vec3& Frustum::NearTopLeft() const { return nearTopLeft; }
 const Vec3& Frustum::NearTopRight() const { return nearTopRight; }
 const Vec3& Frustum::NearBottomLeft() const { return nearBottomLeft; }
@@ -4,6 +4,8 @@
 
 namespace ae3d
 {
+struct Matrix44;
+
 /**
  View Frustum.
  
@@ -36,6 +38,27 @@ public:
      \return False, if the box is not in the frustum.
      */
     bool BoxInFrustum( const Vec3& min, const Vec3& max ) const;
+
+    /// Boxes in structure-of-arrays layout for CullBoxes. Each array has count elements.
+    struct BoxArrays
+    {
+        const float* centerX = nullptr;
+        const float* centerY = nullptr;
+        const float* centerZ = nullptr;
+        const float* extentX = nullptr; ///< Half size.
+        const float* extentY = nullptr;
+        const float* extentZ = nullptr;
+        unsigned count = 0;
+    };
+
+    /**
+     Tests many AABBs against the frustum like BoxInFrustum, 8 boxes at a time with AVX and 4 with SSE3 or NEON.
+
+     \param boxes Boxes in world space.
+     \param outVisibleMask Bit i % 32 of element i / 32 is set if box i is at least partly in the frustum, other bits are cleared.
+                           Must have (boxes.count + 31) / 32 elements.
+     */
+    void CullBoxes( const BoxArrays& boxes, unsigned* outVisibleMask ) const;
     
     /**
      Sets values from which the frustum is calculated.
@@ -69,6 +92,16 @@ public:
      \param cameraDirection Camera's direction
      */
     void Update( const Vec3& cameraPosition, const Vec3& cameraDirection );
+
+    /**
+     Calculates the frustum planes from a view-projection matrix, so they match rendering exactly, also for
+     off-center projections and cameras that look straight up or down. Corners are not changed. The near plane is
+     taken to be at clip z = -w, which is exact for OpenGL-style projections and nearer the camera than the
+     near clip plane for projections with clip z in [0, w], so culling stays conservative.
+
+     \param worldToClip View-projection matrix.
+     */
+    void SetFromViewProjection( const Matrix44& worldToClip );
     
     /// \return Near clip plane.
     float NearClipPlane() const;
@@ -104,7 +137,7 @@ private:
     float farHeight;
     
     /**
-     3 points define a plane. The frustum has 6 planes.
+     The frustum has 6 planes.
      */
     struct Plane
     {
@@ -125,12 +158,9 @@ private:
          */
         void SetNormalAndPoint( const Vec3& aNormal, const Vec3& aPoint );
         
-        /// Calculates plane's normal.
-        void CalculateNormal();
+        /// Calculates plane's normal from 3 points on the plane.
+        void CalculateNormal( const Vec3& a, const Vec3& b, const Vec3& c );
         
-        Vec3 a; // Point a on the plane.
-        Vec3 b; // Point b on the plane.
-        Vec3 c; // Point c on the plane.
         Vec3 normal; // Plane's normal pointing inside the frustum.
         float d;
     } planes[ 6 ]; // Clipping planes.
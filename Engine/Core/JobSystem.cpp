@@ -0,0 +1,248 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct ParallelForTask
+    {
+        void (*job)( const void*, unsigned, unsigned ) = nullptr;
+        const void* context = nullptr;
+        std::atomic< unsigned > unfinishedBatches;
+    };
+
+    struct Batch
+    {
+        ParallelForTask* task;
+        unsigned first;
+        unsigned last;
+    };
+
+    // The owning thread pushes and pops at the back, other threads steal from the front. The batches are a ring buffer
+    // that grows when it's full and is never shrunk, so queuing doesn't allocate after the first frames.
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::vector< Batch > batches; // Size is zero or a power of two.
+        unsigned front = 0;
+        unsigned count = 0;
+    };
+
+    std::vector< std::thread > workers;
+    std::unique_ptr< WorkQueue[] > queues; // Queue 0 is shared by threads that are not workers.
+    unsigned queueCount = 0;
+    std::atomic< unsigned > queuedBatchCount( 0 );
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool isQuitting = false;
+    bool isInitialized = false; // Only accessed on the main thread.
+    thread_local unsigned threadQueueIndex = 0;
+
+    void PushBatch( unsigned queueIndex, const Batch& batch )
+    {
+        WorkQueue& queue = queues[ queueIndex ];
+        std::lock_guard< std::mutex > lock( queue.mutex );
+
+        if (queue.count == queue.batches.size())
+        {
+            std::vector< Batch > grown( queue.batches.empty() ? 64 : queue.batches.size() * 2 );
+
+            for (unsigned i = 0; i < queue.count; ++i)
+            {
+                grown[ i ] = queue.batches[ (queue.front + i) & (queue.batches.size() - 1) ];
+            }
+
+            queue.batches.swap( grown );
+            queue.front = 0;
+        }
+
+        queue.batches[ (queue.front + queue.count) & (queue.batches.size() - 1) ] = batch;
+        ++queue.count;
+        ++queuedBatchCount;
+    }
+
+    bool PopBatch( unsigned queueIndex, Batch& outBatch )
+    {
+        WorkQueue& queue = queues[ queueIndex ];
+        std::lock_guard< std::mutex > lock( queue.mutex );
+
+        if (queue.count == 0)
+        {
+            return false;
+        }
+
+        --queue.count;
+        outBatch = queue.batches[ (queue.front + queue.count) & (queue.batches.size() - 1) ];
+        --queuedBatchCount;
+        return true;
+    }
+
+    bool StealBatch( unsigned thiefQueueIndex, Batch& outBatch )
+    {
+        for (unsigned i = 1; i < queueCount; ++i)
+        {
+            WorkQueue& queue = queues[ (thiefQueueIndex + i) % queueCount ];
+            std::lock_guard< std::mutex > lock( queue.mutex );
+
+            if (queue.count != 0)
+            {
+                outBatch = queue.batches[ queue.front ];
+                queue.front = (queue.front + 1) & (static_cast< unsigned >( queue.batches.size() ) - 1);
+                --queue.count;
+                --queuedBatchCount;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool GetBatch( Batch& outBatch )
+    {
+        return PopBatch( threadQueueIndex, outBatch ) || StealBatch( threadQueueIndex, outBatch );
+    }
+
+    void RunBatch( const Batch& batch )
+    {
+        batch.task->job( batch.task->context, batch.first, batch.last );
+
+        // The task can be destroyed by its waiting thread after this, so it must not be touched.
+        if (--batch.task->unfinishedBatches == 0)
+        {
+            std::lock_guard< std::mutex > lock( sleepMutex );
+            wakeUp.notify_all();
+        }
+    }
+
+    void WorkerMain( unsigned queueIndex )
+    {
+        threadQueueIndex = queueIndex;
+
+        while (true)
+        {
+            Batch batch;
+
+            if (GetBatch( batch ))
+            {
+                RunBatch( batch );
+                continue;
+            }
+
+            std::unique_lock< std::mutex > lock( sleepMutex );
+            wakeUp.wait( lock, []{ return isQuitting || queuedBatchCount > 0; } );
+
+            if (isQuitting)
+            {
+                return;
+            }
+        }
+    }
+}
+
+void ae3d::JobSystem::Init()
+{
+    if (isInitialized)
+    {
+        return;
+    }
+
+    isInitialized = true;
+    const unsigned hardwareThreads = std::thread::hardware_concurrency();
+    const unsigned workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+
+    queueCount = workerCount + 1;
+    queues.reset( new WorkQueue[ queueCount ] );
+
+    for (unsigned i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back( WorkerMain, i + 1 );
+    }
+}
+
+void ae3d::JobSystem::Deinit()
+{
+    {
+        std::lock_guard< std::mutex > lock( sleepMutex );
+        isQuitting = true;
+    }
+
+    wakeUp.notify_all();
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    workers.clear();
+    queues.reset();
+    queueCount = 0;
+    isQuitting = false;
+    isInitialized = false;
+}
+
+unsigned ae3d::JobSystem::GetWorkerCount()
+{
+    return static_cast< unsigned >( workers.size() );
+}
+
+void ae3d::JobSystem::ParallelFor( unsigned count, unsigned batchSize, void (*job)( const void* context, unsigned first, unsigned last ), const void* context )
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    batchSize = std::max( batchSize, 1u );
+
+    // Jobs can size their scratch by batchSize, so batches are kept also when they all run on this thread.
+    if (workers.empty() || count <= batchSize)
+    {
+        for (unsigned first = 0; first < count; first += batchSize)
+        {
+            job( context, first, std::min( count, first + batchSize ) );
+        }
+
+        return;
+    }
+
+    ParallelForTask task;
+    task.job = job;
+    task.context = context;
+    task.unfinishedBatches = (count + batchSize - 1) / batchSize;
+
+    // Batches are spread over all queues so that every worker can start without stealing.
+    unsigned batchIndex = 0;
+
+    for (unsigned first = 0; first < count; first += batchSize)
+    {
+        PushBatch( (threadQueueIndex + batchIndex) % queueCount, { &task, first, std::min( count, first + batchSize ) } );
+        ++batchIndex;
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( sleepMutex );
+        wakeUp.notify_all();
+    }
+
+    // The calling thread helps until the task has finished. It can also run batches of other tasks.
+    while (task.unfinishedBatches > 0)
+    {
+        Batch batch;
+
+        if (GetBatch( batch ))
+        {
+            RunBatch( batch );
+            continue;
+        }
+
+        std::unique_lock< std::mutex > lock( sleepMutex );
+        wakeUp.wait( lock, [ &task ]{ return task.unfinishedBatches == 0 || queuedBatchCount > 0; } );
+    }
+}
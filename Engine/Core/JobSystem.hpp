@@ -0,0 +1,37 @@
+#pragma once
+
+namespace ae3d
+{
+    /// Runs work on a pool of worker threads. Each thread has its own queue and idle threads steal work from other queues.
+    /// Worker threads are started by Init, which System::LoadBuiltinAssets calls.
+    namespace JobSystem
+    {
+        /// Starts worker threads. Does nothing if they are already running. Must be called from the main thread, before other threads call ParallelFor.
+        void Init();
+
+        /// Stops worker threads. Must not be called while ParallelFor is running.
+        void Deinit();
+
+        /// \return Number of worker threads, not counting the calling thread.
+        unsigned GetWorkerCount();
+
+        /**
+          Splits [0, count) into batches and runs job for each batch on worker threads and on the calling thread.
+          Returns when all batches have finished. Can be called from inside a job. Before Init, runs all batches on the calling thread.
+          Doesn't allocate after the queues have grown to the largest number of batches in flight.
+
+          \param count Number of items.
+          \param batchSize Maximum number of items per batch.
+          \param job Called with context and a half-open range [first, last).
+          \param context Passed to job.
+         */
+        void ParallelFor( unsigned count, unsigned batchSize, void (*job)( const void* context, unsigned first, unsigned last ), const void* context );
+
+        /// Like ParallelFor above, but job is a lambda or another callable that is called with a half-open range [first, last).
+        /// It's called through a pointer, so it's not copied into a std::function.
+        template< typename Job > void ParallelFor( unsigned count, unsigned batchSize, const Job& job )
+        {
+            ParallelFor( count, batchSize, []( const void* context, unsigned first, unsigned last ) { (*static_cast< const Job* >( context ))( first, last ); }, &job );
+        }
+    }
+}
@@ -0,0 +1,275 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Lz4.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const std::size_t MinMatch = 4;
+    const std::size_t LastLiterals = 5; // The last 5 bytes are always literals.
+    const std::size_t MatchFindLimit = 12; // The last match must start at least 12 bytes before the end.
+    const std::size_t MaxOffset = 65535;
+    const std::size_t WildCopySize = 16;
+    const unsigned HashBits = 14;
+
+    std::uint32_t Read32( const unsigned char* p )
+    {
+        std::uint32_t value;
+        std::memcpy( &value, p, sizeof( value ) );
+        return value;
+    }
+
+    unsigned Hash( std::uint32_t sequence )
+    {
+        return (sequence * 2654435761u) >> (32 - HashBits);
+    }
+
+    // Writes the part of a length that doesn't fit into the token's 4 bits.
+    unsigned char* WriteLength( unsigned char* out, std::size_t length )
+    {
+        for (; length >= 255; length -= 255)
+        {
+            *out++ = 255;
+        }
+
+        *out++ = static_cast< unsigned char >( length );
+        return out;
+    }
+
+    // Reads the part of a length that doesn't fit into the token's 4 bits.
+    bool ReadLength( const unsigned char*& in, const unsigned char* inEnd, std::size_t& length )
+    {
+        unsigned char value;
+
+        do
+        {
+            if (in == inEnd)
+            {
+                return false;
+            }
+
+            value = *in++;
+            length += value;
+        }
+        while (value == 255);
+
+        return true;
+    }
+}
+
+std::size_t ae3d::Lz4::GetCompressBound( std::size_t size )
+{
+    return size + size / 255 + 16;
+}
+
+std::size_t ae3d::Lz4::Compress( const unsigned char* source, std::size_t sourceSize, unsigned char* destination, std::size_t destinationCapacity )
+{
+    if (destinationCapacity < GetCompressBound( sourceSize ))
+    {
+        return 0;
+    }
+
+    unsigned char* out = destination;
+    const unsigned char* anchor = source; // Start of literals that have not been written.
+    const unsigned char* const sourceEnd = source + sourceSize;
+
+    if (sourceSize > MatchFindLimit)
+    {
+        // Positions are stored + 1 so that 0 means an empty slot.
+        std::vector< std::uint32_t > hashTable( 1u << HashBits, 0 );
+        const unsigned char* const matchLimit = sourceEnd - LastLiterals;
+        const unsigned char* const matchFindEnd = sourceEnd - MatchFindLimit;
+        const unsigned char* in = source;
+
+        while (in < matchFindEnd)
+        {
+            const std::uint32_t sequence = Read32( in );
+            const unsigned hash = Hash( sequence );
+            const std::uint32_t candidatePosition = hashTable[ hash ];
+            hashTable[ hash ] = static_cast< std::uint32_t >( in - source ) + 1;
+
+            if (candidatePosition == 0)
+            {
+                ++in;
+                continue;
+            }
+
+            const unsigned char* match = source + candidatePosition - 1;
+
+            if (static_cast< std::size_t >( in - match ) > MaxOffset || Read32( match ) != sequence)
+            {
+                ++in;
+                continue;
+            }
+
+            // Extends the match backwards over literals that are equal.
+            while (in > anchor && match > source && in[ -1 ] == match[ -1 ])
+            {
+                --in;
+                --match;
+            }
+
+            const unsigned char* matchEnd = in + MinMatch;
+
+            while (matchEnd < matchLimit && *matchEnd == match[ matchEnd - in ])
+            {
+                ++matchEnd;
+            }
+
+            const std::size_t literalLength = static_cast< std::size_t >( in - anchor );
+            const std::size_t matchLength = static_cast< std::size_t >( matchEnd - in ) - MinMatch;
+            const std::size_t offset = static_cast< std::size_t >( in - match );
+
+            unsigned char* token = out++;
+            *token = static_cast< unsigned char >( (literalLength < 15 ? literalLength : 15) << 4 );
+
+            if (literalLength >= 15)
+            {
+                out = WriteLength( out, literalLength - 15 );
+            }
+
+            std::memcpy( out, anchor, literalLength );
+            out += literalLength;
+
+            *out++ = static_cast< unsigned char >( offset & 0xFF );
+            *out++ = static_cast< unsigned char >( offset >> 8 );
+
+            *token |= static_cast< unsigned char >( matchLength < 15 ? matchLength : 15 );
+
+            if (matchLength >= 15)
+            {
+                out = WriteLength( out, matchLength - 15 );
+            }
+
+            // Hashes one position inside the match so that the next match can refer to it.
+            if (matchEnd - 2 > in && matchEnd - 2 < matchFindEnd)
+            {
+                hashTable[ Hash( Read32( matchEnd - 2 ) ) ] = static_cast< std::uint32_t >( matchEnd - 2 - source ) + 1;
+            }
+
+            in = matchEnd;
+            anchor = in;
+        }
+    }
+
+    // Last sequence has only literals.
+    const std::size_t literalLength = static_cast< std::size_t >( sourceEnd - anchor );
+    *out++ = static_cast< unsigned char >( (literalLength < 15 ? literalLength : 15) << 4 );
+
+    if (literalLength >= 15)
+    {
+        out = WriteLength( out, literalLength - 15 );
+    }
+
+    if (literalLength > 0)
+    {
+        std::memcpy( out, anchor, literalLength );
+        out += literalLength;
+    }
+
+    return static_cast< std::size_t >( out - destination );
+}
+
+bool ae3d::Lz4::Decompress( const unsigned char* source, std::size_t sourceSize, unsigned char* destination, std::size_t destinationSize )
+{
+    const unsigned char* in = source;
+    const unsigned char* const inEnd = source + sourceSize;
+    unsigned char* out = destination;
+    unsigned char* const outEnd = destination + destinationSize;
+
+    while (in < inEnd)
+    {
+        const unsigned token = *in++;
+        std::size_t literalLength = token >> 4;
+
+        if (literalLength == 15 && !ReadLength( in, inEnd, literalLength ))
+        {
+            return false;
+        }
+
+        if (literalLength > static_cast< std::size_t >( inEnd - in ) || literalLength > static_cast< std::size_t >( outEnd - out ))
+        {
+            return false;
+        }
+
+        // Short literals are copied with one fixed-size copy when both buffers have room for it.
+        if (literalLength <= WildCopySize && static_cast< std::size_t >( inEnd - in ) >= WildCopySize && static_cast< std::size_t >( outEnd - out ) >= WildCopySize)
+        {
+            std::memcpy( out, in, WildCopySize );
+        }
+        else if (literalLength > 0)
+        {
+            std::memcpy( out, in, literalLength );
+        }
+
+        in += literalLength;
+        out += literalLength;
+
+        // Last sequence has no match.
+        if (in == inEnd)
+        {
+            break;
+        }
+
+        if (inEnd - in < 2)
+        {
+            return false;
+        }
+
+        const std::size_t offset = static_cast< std::size_t >( in[ 0 ] ) | (static_cast< std::size_t >( in[ 1 ] ) << 8);
+        in += 2;
+
+        std::size_t matchLength = token & 15;
+
+        if (matchLength == 15 && !ReadLength( in, inEnd, matchLength ))
+        {
+            return false;
+        }
+
+        matchLength += MinMatch;
+
+        if (offset == 0 || offset > static_cast< std::size_t >( out - destination ) || matchLength > static_cast< std::size_t >( outEnd - out ))
+        {
+            return false;
+        }
+
+        const unsigned char* match = out - offset;
+
+        if (offset >= WildCopySize && static_cast< std::size_t >( outEnd - out ) >= matchLength + WildCopySize)
+        {
+            // Chunks don't overlap their source, and the last chunk may write past the match.
+            for (std::size_t i = 0; i < matchLength; i += WildCopySize)
+            {
+                std::memcpy( out + i, match + i, WildCopySize );
+            }
+
+            out += matchLength;
+        }
+        else if (offset >= 8 && static_cast< std::size_t >( outEnd - out ) >= matchLength + 8)
+        {
+            for (std::size_t i = 0; i < matchLength; i += 8)
+            {
+                std::memcpy( out + i, match + i, 8 );
+            }
+
+            out += matchLength;
+        }
+        else if (offset >= matchLength)
+        {
+            std::memcpy( out, match, matchLength );
+            out += matchLength;
+        }
+        else
+        {
+            // Overlapping copy repeats the last offset bytes.
+            for (std::size_t i = 0; i < matchLength; ++i)
+            {
+                *out++ = *match++;
+            }
+        }
+    }
+
+    return out == outEnd;
+}
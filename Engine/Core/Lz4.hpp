@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ae3d
+{
+    /**
+      Compressor and decompressor for the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md).
+
+      The output is compatible with the reference implementation's LZ4_compress_default and LZ4_decompress_safe,
+      but the compressor is simpler and compresses a bit worse. Decompression is fast enough to be faster than reading
+      uncompressed data from disk. Blocks are independent, so a large buffer can be split into blocks that are
+      compressed and decompressed in parallel.
+     */
+    namespace Lz4
+    {
+        /// \param size Uncompressed size in bytes.
+        /// \return Maximum compressed size for size bytes.
+        std::size_t GetCompressBound( std::size_t size );
+
+        /**
+          \param source Uncompressed data.
+          \param sourceSize Size of source in bytes.
+          \param destination Receives the compressed data.
+          \param destinationCapacity Size of destination in bytes. GetCompressBound( sourceSize ) is always enough.
+          \return Compressed size in bytes, or 0 if destination is too small.
+         */
+        std::size_t Compress( const unsigned char* source, std::size_t sourceSize, unsigned char* destination, std::size_t destinationCapacity );
+
+        /**
+          Validates the input, so it's safe to call with corrupted data.
+
+          \param source Compressed data.
+          \param sourceSize Size of source in bytes.
+          \param destination Receives the uncompressed data.
+          \param destinationSize Uncompressed size in bytes.
+          \return True, if source decompressed into exactly destinationSize bytes.
+         */
+        bool Decompress( const unsigned char* source, std::size_t sourceSize, unsigned char* destination, std::size_t destinationSize );
+    }
+}
@@ -1,8 +1,10 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Vec3.hpp"
+#include <cmath>
 #include <random>
 #include <ctime>
+#include "Matrix.hpp"
 
 using namespace ae3d;
 
@@ -61,6 +63,50 @@ namespace MathUtil
         outCorners[ 7 ] = Vec3( max.x, min.y, max.z );
     }
 
+    // Same box as transforming the 8 corners and taking their min and max, but without the corners.
+    void GetTransformedCenterAndExtent( const Vec3& min, const Vec3& max, const Matrix44& matrix, Vec3& outCenter, Vec3& outExtent )
+    {
+        const Vec3 center = (min + max) * 0.5f;
+        const Vec3 extent = (max - min) * 0.5f;
+        const float* m = matrix.m;
+
+        outCenter.x = m[ 0 ] * center.x + m[ 4 ] * center.y + m[  8 ] * center.z + m[ 12 ];
+        outCenter.y = m[ 1 ] * center.x + m[ 5 ] * center.y + m[  9 ] * center.z + m[ 13 ];
+        outCenter.z = m[ 2 ] * center.x + m[ 6 ] * center.y + m[ 10 ] * center.z + m[ 14 ];
+
+        outExtent.x = std::fabs( m[ 0 ] ) * extent.x + std::fabs( m[ 4 ] ) * extent.y + std::fabs( m[  8 ] ) * extent.z;
+        outExtent.y = std::fabs( m[ 1 ] ) * extent.x + std::fabs( m[ 5 ] ) * extent.y + std::fabs( m[  9 ] ) * extent.z;
+        outExtent.z = std::fabs( m[ 2 ] ) * extent.x + std::fabs( m[ 6 ] ) * extent.y + std::fabs( m[ 10 ] ) * extent.z;
+    }
+
+    // Height of a sphere's projection as a fraction of the viewport height. m[ 5 ] is cot( fov / 2 ) for perspective and 2 / height for orthographic projections.
+    float GetScreenSize( const Vec3& centerView, float radius, const Matrix44& projection )
+    {
+        const float yScale = std::fabs( projection.m[ 5 ] );
+
+        if (projection.m[ 11 ] == 0)
+        {
+            return radius * yScale;
+        }
+
+        const float distance = centerView.Length();
+        return distance > radius ? radius * yScale / distance : 1.0f;
+    }
+
+    // Thresholds are in decreasing order and LOD i + 1 is used below threshold i. Thresholds that the current LOD is
+    // past are moved by the hysteresis fraction, so an object near a threshold doesn't switch LODs back and forth.
+    unsigned SelectLod( float screenSize, const float* screenSizes, unsigned count, unsigned currentLod, float hysteresis )
+    {
+        unsigned lod = 0;
+
+        while (lod < count && screenSize < screenSizes[ lod ] * (lod < currentLod ? 1 + hysteresis : 1 - hysteresis))
+        {
+            ++lod;
+        }
+
+        return lod;
+    }
+
     float Lerp( float start, float end, float amount )
     {
         return (1.0f - amount) * start + amount * end;
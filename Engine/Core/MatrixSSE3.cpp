@@ -37,24 +37,15 @@ void Matrix44::Multiply( const Matrix44& ma, const Matrix44& mb, Matrix44& out )
 
 void Matrix44::TransformPoint( const Vec4& vec, const Matrix44& mat, Vec4* out )
 {
-    Matrix44 transpose;
-    mat.Transpose( transpose );
-    alignas( 16 ) Vec4 v4 = vec;
-
-    __m128 vec4 = _mm_load_ps( &v4.x );
-    __m128 row1 = _mm_load_ps( &transpose.m[  0 ] );
-    __m128 row2 = _mm_load_ps( &transpose.m[  4 ] );
-    __m128 row3 = _mm_load_ps( &transpose.m[  8 ] );
-    __m128 row4 = _mm_load_ps( &transpose.m[ 12 ] );
-
-    __m128 r1 = _mm_mul_ps( row1, vec4 );
-    __m128 r2 = _mm_mul_ps( row2, vec4 );
-    __m128 r3 = _mm_mul_ps( row3, vec4 );
-    __m128 r4 = _mm_mul_ps( row4, vec4 );
-
-    __m128 sum_01 = _mm_hadd_ps( r1, r2 );
-    __m128 sum_23 = _mm_hadd_ps( r3, r4 );
-    __m128 result = _mm_hadd_ps( sum_01, sum_23 );
-    _mm_store_ps( &out->x, result );
+    // The vector is a row vector, so the result is a sum of the matrix rows scaled by its components and the matrix
+    // doesn't need to be transposed.
+    const __m128 row1 = _mm_load_ps( &mat.m[  0 ] );
+    const __m128 row2 = _mm_load_ps( &mat.m[  4 ] );
+    const __m128 row3 = _mm_load_ps( &mat.m[  8 ] );
+    const __m128 row4 = _mm_load_ps( &mat.m[ 12 ] );
+
+    const __m128 sum_01 = _mm_add_ps( _mm_mul_ps( row1, _mm_set1_ps( vec.x ) ), _mm_mul_ps( row2, _mm_set1_ps( vec.y ) ) );
+    const __m128 sum_23 = _mm_add_ps( _mm_mul_ps( row3, _mm_set1_ps( vec.z ) ), _mm_mul_ps( row4, _mm_set1_ps( vec.w ) ) );
+    _mm_storeu_ps( &out->x, _mm_add_ps( sum_01, sum_23 ) );
 }
 #endif
@@ -2,65 +2,92 @@
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 
 #include "Mesh.hpp"
-#include <vector>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
-#include <sstream>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
 #include <string>
+#include <vector>
 #include "FileSystem.hpp"
 #include "FileWatcher.hpp"
 #include "Matrix.hpp"
+#include "MeshFormat.hpp"
 #include "SubMesh.hpp"
 #include "System.hpp"
+#include "TriangleBVH.hpp"
 #include "VertexBuffer.hpp"
 
 using namespace ae3d;
 
 extern ae3d::FileWatcher fileWatcher;
 
+namespace
+{
+    // Contents of a loaded .ae3d file. Shared by the cache and all meshes that have loaded the file.
+    struct MeshData
+    {
+        MeshData() = default;
+        MeshData( const MeshData& ) = delete;
+        MeshData& operator=( const MeshData& ) = delete;
+        ~MeshData()
+        {
+            FileSystem::UnmapFile( mapping );
+
+            for (auto& hierarchy : raycastHierarchies)
+            {
+                delete hierarchy.load();
+            }
+        }
+
+        // Atomics can't be moved, so the hierarchies are created with the submeshes.
+        void ResizeSubMeshes( std::size_t count )
+        {
+            subMeshes.resize( count );
+            raycastHierarchies = std::vector< std::atomic< TriangleBVH* > >( count );
+        }
+
+        std::string path;
+        Vec3 aabbMin;
+        Vec3 aabbMax;
+        std::vector< SubMesh > subMeshes;
+        // Submesh vertices and indices point into mapping or ownedData.
+        FileSystem::MappedFileData mapping;
+        std::vector< unsigned char > ownedData;
+        // Built on first use by Mesh::Raycast. Indexed by submesh. Never replaced once built, so they are read without a lock.
+        std::vector< std::atomic< TriangleBVH* > > raycastHierarchies;
+    };
+
+    std::shared_ptr< MeshData > GetEmptyMeshData()
+    {
+        static const std::shared_ptr< MeshData > emptyData = std::make_shared< MeshData >();
+        return emptyData;
+    }
+}
+
 struct ae3d::Mesh::Impl
 {
-    Impl() noexcept
+    Impl() noexcept : data( GetEmptyMeshData() )
     {
         static_assert( sizeof( ae3d::Mesh::Impl ) <= ae3d::Mesh::StorageSize, "Impl too big!");
         static_assert( ae3d::Mesh::StorageAlign % alignof( ae3d::Mesh::Impl ) == 0, "Impl misaligned!");
     }
     
-    Vec3 aabbMin;
-    Vec3 aabbMax;
-    std::vector< SubMesh > subMeshes;
-    std::string path;
+    std::shared_ptr< MeshData > data;
 };
 
-struct MeshCacheEntry
-{
-    std::string path;
-    Vec3 aabbMin;
-    Vec3 aabbMax;
-    std::vector< SubMesh > subMeshes;    
-};
+static_assert( sizeof( VertexBuffer::VertexPTNTC ) == MeshFormat::VertexSizes[ MeshFormat::VertexFormat::PTNTC ] &&
+               sizeof( VertexBuffer::VertexPTN ) == MeshFormat::VertexSizes[ MeshFormat::VertexFormat::PTN ] &&
+               sizeof( VertexBuffer::VertexPTNTC_Skinned ) == MeshFormat::VertexSizes[ MeshFormat::VertexFormat::PTNTC_Skinned ],
+               "Vertex layout must match .ae3d files" );
+static_assert( sizeof( VertexBuffer::Face ) == 3 * 2 && sizeof( VertexBuffer::Face32 ) == 3 * 4, "Face layout must match .ae3d files" );
 
 namespace
 {
-
-std::vector< MeshCacheEntry > gMeshCache;
+std::vector< std::shared_ptr< MeshData > > gMeshCache;
 std::vector< Mesh* > gMeshInstances;
-
-struct membuf : std::streambuf
-{
-    membuf( char const* base, size_t size )
-    {
-        char* p( const_cast<char*>(base) );
-        this->setg( p, p, p + size );
-    }
-};
-
-struct imemstream : virtual membuf, std::istream
-{
-    imemstream( char const* base, size_t size )
-        : membuf( base, size )
-        , std::istream( static_cast<std::streambuf*>(this) ) {
-    }
-};
 }
 
 void AddUniqueInstance( Mesh* mesh )
@@ -86,7 +113,7 @@ void MeshReload( const std::string& path )
     // Invalidates cache
     for (std::size_t i = 0; i < gMeshCache.size(); ++i)
     {
-        if (gMeshCache[ i ].path == path)
+        if (gMeshCache[ i ]->path == path)
         {
             gMeshCache.erase( std::begin( gMeshCache ) + i );
             break;
@@ -97,6 +124,7 @@ void MeshReload( const std::string& path )
     {
         if (instance->GetPath() == path)
         {
+            // Not mapped, because on Windows the mapping would prevent writing the file again.
             instance->Load( FileSystem::FileContents( path.c_str() ) );
         }
     }
@@ -125,105 +153,545 @@ ae3d::Mesh& ae3d::Mesh::operator=( const Mesh& other )
         return *this;
     }
 
-    new(&_storage)Impl();
     reinterpret_cast<Impl&>(_storage) = reinterpret_cast<Impl const&>(other._storage);
     return *this;
 }
 
 const char* ae3d::Mesh::GetPath() const
 {
-    return m().path.c_str();
+    return m().data->path.c_str();
 }
 
 const Vec3& ae3d::Mesh::GetAABBMin() const
 {
-    return m().aabbMin;
+    return m().data->aabbMin;
 }
 
 const Vec3& ae3d::Mesh::GetAABBMax() const
 {
-    return m().aabbMax;
+    return m().data->aabbMax;
 }
 
 const Vec3& ae3d::Mesh::GetSubMeshAABBMin( unsigned subMeshIndex ) const
 {
-    return m().subMeshes[ subMeshIndex < m().subMeshes.size() ? subMeshIndex : 0 ].aabbMin;
+    const auto& subMeshes = m().data->subMeshes;
+    return subMeshes[ subMeshIndex < subMeshes.size() ? subMeshIndex : 0 ].aabbMin;
 }
 
 const Vec3& ae3d::Mesh::GetSubMeshAABBMax( unsigned subMeshIndex ) const
 {
-    return m().subMeshes[ subMeshIndex < m().subMeshes.size() ? subMeshIndex : 0 ].aabbMax;
+    const auto& subMeshes = m().data->subMeshes;
+    return subMeshes[ subMeshIndex < subMeshes.size() ? subMeshIndex : 0 ].aabbMax;
 }
 
 const char* ae3d::Mesh::GetSubMeshName( unsigned index ) const
 {
-    return m().subMeshes[ index < m().subMeshes.size() ? index : 0 ].name.c_str();
+    const auto& subMeshes = m().data->subMeshes;
+    return subMeshes[ index < subMeshes.size() ? index : 0 ].name.c_str();
 }
 
 ae3d::SubMesh* ae3d::Mesh::GetSubMeshes( int& outCount )
 {
-	outCount = (int)m().subMeshes.size();
-    return m().subMeshes.data();
+	outCount = (int)m().data->subMeshes.size();
+    return m().data->subMeshes.data();
 }
 
 void ae3d::Mesh::GetSubMeshFlattenedTriangles( unsigned subMeshIndex, Array< Vec3 >& outTriangles ) const
 {
-    if (subMeshIndex >= m().subMeshes.size())
+    if (subMeshIndex >= m().data->subMeshes.size())
     {
         System::Print( "Invalid submesh index in GetSubMeshFlattenedTriangles\n" );
         return;
     }
     
-    auto& subMesh = m().subMeshes[ subMeshIndex ];
-    const int faceCount = subMesh.vertexBuffer.GetFaceCount();
-    outTriangles.Allocate( faceCount * 3 );
-    
-    if (!subMesh.verticesPTNTC.empty())
+    const auto& subMesh = m().data->subMeshes[ subMeshIndex ];
+
+    if (subMesh.vertices == nullptr)
     {
-        for (int faceIndex = 0; faceIndex < faceCount / 3; ++faceIndex)
-        {
-            const auto& face = subMesh.indices[ faceIndex ];
-            outTriangles[ faceIndex * 3 + 0 ] = subMesh.verticesPTNTC.at( face.a ).position;
-            outTriangles[ faceIndex * 3 + 1 ] = subMesh.verticesPTNTC.at( face.b ).position;
-            outTriangles[ faceIndex * 3 + 2 ] = subMesh.verticesPTNTC.at( face.c ).position;
-        }
+        System::Print("Empty vertex data in subMesh!\n");
+        return;
     }
-    else if (!subMesh.verticesPTN.empty())
+
+    // Position is the first member in all vertex formats.
+    const unsigned char* vertices = static_cast< const unsigned char* >( subMesh.vertices );
+    const std::size_t stride = subMesh.vertexFormat == VertexBuffer::VertexFormat::PTN ? sizeof( VertexBuffer::VertexPTN ) :
+                               subMesh.vertexFormat == VertexBuffer::VertexFormat::PTNTC ? sizeof( VertexBuffer::VertexPTNTC ) : sizeof( VertexBuffer::VertexPTNTC_Skinned );
+    outTriangles.Allocate( subMesh.faceCount * 3 );
+
+    for (unsigned i = 0; i < subMesh.faceCount * 3; ++i)
     {
-        for (int faceIndex = 0; faceIndex < faceCount / 3; ++faceIndex)
-        {
-            const auto& face = subMesh.indices[ faceIndex ];
-            outTriangles[ faceIndex * 3 + 0 ] = subMesh.verticesPTN.at( face.a ).position;
-            outTriangles[ faceIndex * 3 + 1 ] = subMesh.verticesPTN.at( face.b ).position;
-            outTriangles[ faceIndex * 3 + 2 ] = subMesh.verticesPTN.at( face.c ).position;
-        }
+        const unsigned index = subMesh.indexType == VertexBuffer::IndexType::UInt32 ? static_cast< const std::uint32_t* >( subMesh.indices )[ i ] :
+                                                                                     static_cast< const std::uint16_t* >( subMesh.indices )[ i ];
+        const float* position = reinterpret_cast< const float* >( vertices + index * stride );
+        outTriangles[ i ] = Vec3( position[ 0 ], position[ 1 ], position[ 2 ] );
     }
-    else
+}
+
+const TriangleBVH& ae3d::Mesh::GetRaycastHierarchy( unsigned subMeshIndex ) const
+{
+    std::atomic< TriangleBVH* >& hierarchy = m().data->raycastHierarchies[ subMeshIndex ];
+    TriangleBVH* builtHierarchy = hierarchy.load( std::memory_order_acquire );
+
+    if (builtHierarchy != nullptr)
     {
-        System::Print("Empty vertex data in subMesh!\n");
+        return *builtHierarchy;
     }
+
+    // Not built under a lock, because Build waits for JobSystem jobs and meanwhile the thread can run a job that raycasts
+    // this mesh. Threads that build the same hierarchy at the same time keep the first one that is finished.
+    Array< Vec3 > triangles;
+    GetSubMeshFlattenedTriangles( subMeshIndex, triangles );
+    std::unique_ptr< TriangleBVH > newHierarchy( new TriangleBVH() );
+    newHierarchy->Build( triangles.elements, triangles.count / 3 );
+
+    if (hierarchy.compare_exchange_strong( builtHierarchy, newHierarchy.get(), std::memory_order_acq_rel, std::memory_order_acquire ))
+    {
+        return *newHierarchy.release();
+    }
+
+    return *builtHierarchy;
+}
+
+void ae3d::Mesh::BuildRaycastHierarchies() const
+{
+    for (unsigned subMeshIndex = 0; subMeshIndex < GetSubMeshCount(); ++subMeshIndex)
+    {
+        GetRaycastHierarchy( subMeshIndex );
+    }
+}
+
+bool ae3d::Mesh::Raycast( const Vec3& origin, const Vec3& direction, float maxDistance, RaycastHit& outHit ) const
+{
+    bool isHit = false;
+
+    for (unsigned subMeshIndex = 0; subMeshIndex < GetSubMeshCount(); ++subMeshIndex)
+    {
+        // Submeshes that the ray misses don't need their hierarchy.
+        const SubMesh& subMesh = m().data->subMeshes[ subMeshIndex ];
+        const Vec3 extent = (subMesh.aabbMax - subMesh.aabbMin) * 0.5f;
+        const Vec3 toCenter = (subMesh.aabbMin + subMesh.aabbMax) * 0.5f - origin;
+        const Vec3 cross = Vec3::Cross( direction, toCenter );
+        const Vec3 absDirection( std::fabs( direction.x ), std::fabs( direction.y ), std::fabs( direction.z ) );
+
+        // Separating axes of a ray's line and a box: the cross products of the line with the box axes.
+        if (std::fabs( cross.x ) > extent.y * absDirection.z + extent.z * absDirection.y ||
+            std::fabs( cross.y ) > extent.x * absDirection.z + extent.z * absDirection.x ||
+            std::fabs( cross.z ) > extent.x * absDirection.y + extent.y * absDirection.x)
+        {
+            continue;
+        }
+
+        float distance;
+        unsigned triangle;
+
+        if (GetRaycastHierarchy( subMeshIndex ).Raycast( origin, direction, maxDistance, distance, triangle ))
+        {
+            maxDistance = distance;
+            outHit.distance = distance;
+            outHit.subMeshIndex = subMeshIndex;
+            outHit.triangleIndex = triangle;
+            isHit = true;
+        }
+    }
+
+    return isHit;
 }
 
 unsigned ae3d::Mesh::GetSubMeshCount() const
 {
-    return (unsigned)m().subMeshes.size();
+    return (unsigned)m().data->subMeshes.size();
 }
 
-ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& meshData )
+namespace
 {
-    for (const auto& entry : gMeshCache)
+    std::shared_ptr< MeshData > LoadFromCache( const std::string& path )
+    {
+        for (const auto& entry : gMeshCache)
+        {
+            if (entry->path == path)
+            {
+                return entry;
+            }
+        }
+
+        return std::shared_ptr< MeshData >();
+    }
+
+    bool ToVertexFormat( std::uint32_t fileFormat, VertexBuffer::VertexFormat& outFormat )
+    {
+        switch (fileFormat)
+        {
+            case MeshFormat::VertexFormat::PTNTC: outFormat = VertexBuffer::VertexFormat::PTNTC; return true;
+            case MeshFormat::VertexFormat::PTN: outFormat = VertexBuffer::VertexFormat::PTN; return true;
+            case MeshFormat::VertexFormat::PTNTC_Skinned: outFormat = VertexBuffer::VertexFormat::PTNTC_Skinned; return true;
+            default: return false;
+        }
+    }
+
+    bool IsVersion2( const unsigned char* data, std::size_t size )
+    {
+        return size >= sizeof( MeshFormat::Magic ) && std::memcmp( data, MeshFormat::Magic, sizeof( MeshFormat::Magic ) ) == 0;
+    }
+
+    // True if count elements at offset are inside the file and aligned like MeshFormat requires.
+    bool IsValidSection( std::uint64_t offset, std::uint64_t count, std::uint64_t elementSize, std::size_t fileSize )
+    {
+        return offset % MeshFormat::DataAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+    }
+
+    bool IsValidName( const unsigned char* data, std::size_t size, std::uint64_t offset, std::uint32_t length )
+    {
+        return offset < size && length < size - offset && data[ offset + length ] == 0;
+    }
+
+    template< typename Index >
+    bool AreIndicesValid( const void* indices, unsigned faceCount, unsigned vertexCount )
+    {
+        const Index* const indexArray = static_cast< const Index* >( indices );
+
+        for (unsigned i = 0; i < faceCount * 3; ++i)
+        {
+            if (indexArray[ i ] >= vertexCount)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Reads version 1 files field by field.
+    struct Reader
+    {
+        bool Read( void* outData, std::size_t count )
+        {
+            if (count > size - offset)
+            {
+                offset = size;
+                isValid = false;
+                return false;
+            }
+
+            std::memcpy( outData, data + offset, count );
+            offset += count;
+            return true;
+        }
+
+        // Appends count bytes to outData at a MeshFormat::DataAlignment boundary and returns the offset in outData.
+        std::size_t Append( std::vector< unsigned char >& outData, std::size_t count )
+        {
+            const std::size_t alignedSize = (outData.size() + MeshFormat::DataAlignment - 1) / MeshFormat::DataAlignment * MeshFormat::DataAlignment;
+            outData.resize( alignedSize );
+
+            if (count > size - offset)
+            {
+                offset = size;
+                isValid = false;
+                return alignedSize;
+            }
+
+            outData.insert( std::end( outData ), data + offset, data + offset + count );
+            offset += count;
+            return alignedSize;
+        }
+
+        const unsigned char* data;
+        std::size_t size;
+        std::size_t offset;
+        bool isValid;
+    };
+
+    // Version 1 has 16-bit counts and indices, and data is not aligned, so vertices and indices are copied to outMesh.ownedData.
+    Mesh::LoadResult ParseV1( const unsigned char* data, std::size_t size, MeshData& outMesh )
+    {
+        Reader reader = { data, size, 0, true };
+        std::uint8_t magic[ 2 ] = {};
+        reader.Read( magic, sizeof( magic ) );
+
+        if (magic[ 0 ] != 'a' || magic[ 1 ] != '9')
+        {
+            System::Print( "%s is corrupted or old format: Wrong magic number!\n", outMesh.path.c_str() );
+            return Mesh::LoadResult::Corrupted;
+        }
+
+        reader.Read( &outMesh.aabbMin, sizeof( outMesh.aabbMin ) );
+        reader.Read( &outMesh.aabbMax, sizeof( outMesh.aabbMax ) );
+
+        const auto& aabbMin = outMesh.aabbMin;
+        const auto& aabbMax = outMesh.aabbMax;
+
+        if (aabbMin.x > aabbMax.x || aabbMin.y > aabbMax.y || aabbMin.z > aabbMax.z)
+        {
+            return Mesh::LoadResult::Corrupted;
+        }
+
+        std::uint16_t meshCount = 0;
+        reader.Read( &meshCount, sizeof( meshCount ) );
+
+        // Reserved up front so that ownedData is not reallocated and can be pointed to while parsing.
+        try
+        {
+            outMesh.ResizeSubMeshes( meshCount );
+            outMesh.ownedData.reserve( size + meshCount * 2 * MeshFormat::DataAlignment );
+        }
+        catch (std::bad_alloc&)
+        {
+            return Mesh::LoadResult::OutOfMemory;
+        }
+
+        for (auto& subMesh : outMesh.subMeshes)
+        {
+            reader.Read( &subMesh.aabbMin, sizeof( subMesh.aabbMin ) );
+            reader.Read( &subMesh.aabbMax, sizeof( subMesh.aabbMax ) );
+
+            std::uint16_t nameLength = 0;
+            reader.Read( &nameLength, sizeof( nameLength ) );
+
+            std::vector< char > meshName( nameLength + 1 );
+            reader.Read( &meshName[ 0 ], nameLength );
+            subMesh.name = std::string( meshName.data(), meshName.size() - 1 );
+
+            std::uint16_t vertexCount = 0;
+            reader.Read( &vertexCount, sizeof( vertexCount ) );
+
+            std::uint8_t vertexFormat = 0;
+            reader.Read( &vertexFormat, sizeof( vertexFormat ) );
+
+            if (!ToVertexFormat( vertexFormat, subMesh.vertexFormat ))
+            {
+                System::Print( "Mesh %s submesh %s has invalid vertex format %d. Only 0, 1 and 2 are valid!\n", outMesh.path.c_str(), subMesh.name.c_str(), vertexFormat );
+                return Mesh::LoadResult::Corrupted;
+            }
+
+            const std::size_t verticesOffset = reader.Append( outMesh.ownedData, vertexCount * MeshFormat::VertexSizes[ vertexFormat ] );
+            subMesh.vertices = outMesh.ownedData.data() + verticesOffset;
+            subMesh.vertexCount = vertexCount;
+
+            std::uint16_t faceCount = 0;
+            reader.Read( &faceCount, sizeof( faceCount ) );
+
+            const std::size_t indicesOffset = reader.Append( outMesh.ownedData, faceCount * sizeof( VertexBuffer::Face ) );
+            subMesh.indices = outMesh.ownedData.data() + indicesOffset;
+            subMesh.indexType = VertexBuffer::IndexType::UInt16;
+            subMesh.faceCount = faceCount;
+
+            if (vertexFormat == MeshFormat::VertexFormat::PTNTC_Skinned)
+            {
+                std::uint16_t jointCount = 0;
+                reader.Read( &jointCount, sizeof( jointCount ) );
+
+                System::Assert( jointCount < 80, "Joint array in PerObjectUboStruct is too small!" );
+
+                subMesh.joints.resize( jointCount );
+
+                for (auto& joint : subMesh.joints)
+                {
+                    reader.Read( &joint.globalBindposeInverse, sizeof( ae3d::Matrix44 ) );
+                    reader.Read( &joint.parentIndex, 4 );
+                    int jointNameLength = 0;
+                    reader.Read( &jointNameLength, sizeof( int ) );
+
+                    if (jointNameLength < 0 || jointNameLength >= (int)sizeof( joint.name ))
+                    {
+                        System::Print( "Mesh %s has a joint with too long name, max is 127.\n", outMesh.path.c_str() );
+                        return Mesh::LoadResult::Corrupted;
+                    }
+
+                    reader.Read( joint.name, jointNameLength );
+                    joint.name[ jointNameLength ] = 0;
+                    int animLength = 0;
+                    reader.Read( &animLength, sizeof( int ) );
+
+                    if (animLength < 0 || static_cast< std::size_t >( animLength ) > (size - reader.offset) / sizeof( ae3d::Matrix44 ))
+                    {
+                        return Mesh::LoadResult::Corrupted;
+                    }
+
+                    joint.animTransforms.resize( animLength );
+                    reader.Read( joint.animTransforms.data(), joint.animTransforms.size() * sizeof( ae3d::Matrix44 ) );
+                }
+            }
+
+            if (!reader.isValid)
+            {
+                return Mesh::LoadResult::Corrupted;
+            }
+        }
+
+        std::uint8_t terminator = 0;
+        reader.Read( &terminator, sizeof( terminator ) );
+
+        if (terminator != 100)
+        {
+            return Mesh::LoadResult::Corrupted;
+        }
+
+        return Mesh::LoadResult::Success;
+    }
+
+    // Version 2 vertices and indices are used in place, so data must stay valid as long as outMesh.
+    Mesh::LoadResult ParseV2( const unsigned char* data, std::size_t size, MeshData& outMesh )
+    {
+        MeshFormat::Header header;
+
+        if (size < sizeof( header ))
+        {
+            return Mesh::LoadResult::Corrupted;
+        }
+
+        std::memcpy( &header, data, sizeof( header ) );
+
+        if (header.version != MeshFormat::Version)
+        {
+            System::Print( "%s has unsupported version %u. Convert it again.\n", outMesh.path.c_str(), header.version );
+            return Mesh::LoadResult::Corrupted;
+        }
+
+        outMesh.aabbMin = Vec3( header.aabbMin[ 0 ], header.aabbMin[ 1 ], header.aabbMin[ 2 ] );
+        outMesh.aabbMax = Vec3( header.aabbMax[ 0 ], header.aabbMax[ 1 ], header.aabbMax[ 2 ] );
+
+        const auto& aabbMin = outMesh.aabbMin;
+        const auto& aabbMax = outMesh.aabbMax;
+
+        if (header.fileSize > size || aabbMin.x > aabbMax.x || aabbMin.y > aabbMax.y || aabbMin.z > aabbMax.z ||
+            !IsValidSection( header.subMeshesOffset, header.subMeshCount, sizeof( MeshFormat::SubMesh ), size ))
+        {
+            return Mesh::LoadResult::Corrupted;
+        }
+
+        try
+        {
+            outMesh.ResizeSubMeshes( header.subMeshCount );
+        }
+        catch (std::bad_alloc&)
+        {
+            return Mesh::LoadResult::OutOfMemory;
+        }
+
+        // Vertex buffers take sizes in bytes as int.
+        const std::uint64_t maxBufferSize = static_cast< std::uint64_t >( std::numeric_limits< int >::max() );
+
+        for (std::size_t s = 0; s < outMesh.subMeshes.size(); ++s)
+        {
+            MeshFormat::SubMesh fileSubMesh;
+            std::memcpy( &fileSubMesh, data + header.subMeshesOffset + s * sizeof( fileSubMesh ), sizeof( fileSubMesh ) );
+
+            SubMesh& subMesh = outMesh.subMeshes[ s ];
+            subMesh.aabbMin = Vec3( fileSubMesh.aabbMin[ 0 ], fileSubMesh.aabbMin[ 1 ], fileSubMesh.aabbMin[ 2 ] );
+            subMesh.aabbMax = Vec3( fileSubMesh.aabbMax[ 0 ], fileSubMesh.aabbMax[ 1 ], fileSubMesh.aabbMax[ 2 ] );
+
+            if (!IsValidName( data, size, fileSubMesh.nameOffset, fileSubMesh.nameLength ))
+            {
+                return Mesh::LoadResult::Corrupted;
+            }
+
+            subMesh.name = std::string( reinterpret_cast< const char* >( data + fileSubMesh.nameOffset ), fileSubMesh.nameLength );
+
+            if (!ToVertexFormat( fileSubMesh.vertexFormat, subMesh.vertexFormat ))
+            {
+                System::Print( "Mesh %s submesh %s has invalid vertex format %u. Only 0, 1 and 2 are valid!\n", outMesh.path.c_str(), subMesh.name.c_str(), fileSubMesh.vertexFormat );
+                return Mesh::LoadResult::Corrupted;
+            }
+
+            const std::uint64_t vertexSize = MeshFormat::VertexSizes[ fileSubMesh.vertexFormat ];
+            const std::uint64_t faceSize = fileSubMesh.indexSize * 3ull;
+
+            if ((fileSubMesh.indexSize != 2 && fileSubMesh.indexSize != 4) ||
+                !IsValidSection( fileSubMesh.verticesOffset, fileSubMesh.vertexCount, vertexSize, size ) ||
+                !IsValidSection( fileSubMesh.indicesOffset, fileSubMesh.faceCount, faceSize, size ) ||
+                fileSubMesh.vertexCount * vertexSize > maxBufferSize || fileSubMesh.faceCount * faceSize > maxBufferSize)
+            {
+                return Mesh::LoadResult::Corrupted;
+            }
+
+            subMesh.vertices = data + fileSubMesh.verticesOffset;
+            subMesh.vertexCount = fileSubMesh.vertexCount;
+            subMesh.indices = data + fileSubMesh.indicesOffset;
+            subMesh.indexType = fileSubMesh.indexSize == 4 ? VertexBuffer::IndexType::UInt32 : VertexBuffer::IndexType::UInt16;
+            subMesh.faceCount = fileSubMesh.faceCount;
+
+            // Also reads the indices into memory here instead of on the main thread when the mesh is uploaded.
+            const bool areIndicesValid = subMesh.indexType == VertexBuffer::IndexType::UInt32 ?
+                                         AreIndicesValid< std::uint32_t >( subMesh.indices, subMesh.faceCount, subMesh.vertexCount ) :
+                                         AreIndicesValid< std::uint16_t >( subMesh.indices, subMesh.faceCount, subMesh.vertexCount );
+
+            if (!areIndicesValid)
+            {
+                System::Print( "Mesh %s submesh %s has an index that is out of range.\n", outMesh.path.c_str(), subMesh.name.c_str() );
+                return Mesh::LoadResult::Corrupted;
+            }
+
+            if (fileSubMesh.jointCount > 0 && (fileSubMesh.vertexFormat != MeshFormat::VertexFormat::PTNTC_Skinned ||
+                                               !IsValidSection( fileSubMesh.jointsOffset, fileSubMesh.jointCount, sizeof( MeshFormat::Joint ), size )))
+            {
+                return Mesh::LoadResult::Corrupted;
+            }
+
+            System::Assert( fileSubMesh.jointCount < 80, "Joint array in PerObjectUboStruct is too small!" );
+
+            // Joints are small, so they are copied.
+            subMesh.joints.resize( fileSubMesh.jointCount );
+
+            for (std::size_t j = 0; j < subMesh.joints.size(); ++j)
+            {
+                MeshFormat::Joint fileJoint;
+                std::memcpy( &fileJoint, data + fileSubMesh.jointsOffset + j * sizeof( fileJoint ), sizeof( fileJoint ) );
+
+                Joint& joint = subMesh.joints[ j ];
+
+                if (!IsValidName( data, size, fileJoint.nameOffset, fileJoint.nameLength ) || fileJoint.nameLength >= sizeof( joint.name ) ||
+                    !IsValidSection( fileJoint.animTransformsOffset, fileJoint.animTransformCount, sizeof( ae3d::Matrix44 ), size ))
+                {
+                    System::Print( "Mesh %s has a corrupted joint or a joint with too long name, max is 127.\n", outMesh.path.c_str() );
+                    return Mesh::LoadResult::Corrupted;
+                }
+
+                joint.globalBindposeInverse.InitFrom( fileJoint.globalBindposeInverse );
+                joint.parentIndex = fileJoint.parentIndex;
+                std::memcpy( joint.name, data + fileJoint.nameOffset, fileJoint.nameLength + 1 );
+                joint.animTransforms.resize( fileJoint.animTransformCount );
+
+                for (std::size_t t = 0; t < joint.animTransforms.size(); ++t)
+                {
+                    joint.animTransforms[ t ].InitFrom( reinterpret_cast< const float* >( data + fileJoint.animTransformsOffset ) + t * 16 );
+                }
+            }
+        }
+
+        return Mesh::LoadResult::Success;
+    }
+
+    // Parses data without keeping a reference to it.
+    Mesh::LoadResult ParseCopy( const unsigned char* data, std::size_t size, MeshData& outMesh )
     {
-        if (entry.path == meshData.path)
+        if (!IsVersion2( data, size ))
         {
-            m().aabbMin = entry.aabbMin;
-            m().aabbMax = entry.aabbMax;
-            m().subMeshes = entry.subMeshes;
-            m().path = entry.path;
-
-            AddUniqueInstance( this );
-            
-            return LoadResult::Success;
+            return ParseV1( data, size, outMesh );
         }
+
+        try
+        {
+            outMesh.ownedData.assign( data, data + size );
+        }
+        catch (std::bad_alloc&)
+        {
+            return Mesh::LoadResult::OutOfMemory;
+        }
+
+        return ParseV2( outMesh.ownedData.data(), outMesh.ownedData.size(), outMesh );
+    }
+}
+
+ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& meshData )
+{
+    std::shared_ptr< MeshData > cachedData = LoadFromCache( meshData.path );
+
+    if (cachedData)
+    {
+        m().data = cachedData;
+        AddUniqueInstance( this );
+
+        return LoadResult::Success;
     }
     
     if (!meshData.isLoaded)
@@ -258,8 +726,9 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
             { 2, 0, 1 }
         };
         
-        m().subMeshes.resize( 1 );
-        auto& firstSubMesh = m().subMeshes[ 0 ];
+        m().data = std::make_shared< MeshData >();
+        m().data->ResizeSubMeshes( 1 );
+        auto& firstSubMesh = m().data->subMeshes[ 0 ];
         firstSubMesh.vertexBuffer.Generate( indices, 12, vertices, 8, VertexBuffer::Storage::GPU );
         firstSubMesh.vertexBuffer.SetDebugName( "default mesh" );
         firstSubMesh.aabbMin = {-s, -s, -s};
@@ -267,179 +736,166 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
         return LoadResult::FileNotFound;
     }
     
-    uint8_t magic[ 2 ];
+    Mesh decodedMesh;
+    const LoadResult result = decodedMesh.Decode( meshData );
+
+    if (result != LoadResult::Success)
+    {
+        return result;
+    }
+
+    return LoadDecoded( decodedMesh );
+}
+
+ae3d::Mesh::LoadResult ae3d::Mesh::Load( const char* path )
+{
+    std::shared_ptr< MeshData > cachedData = LoadFromCache( FileSystem::GetFullPath( path == nullptr ? "" : path ) );
 
-    imemstream is( (const char*)meshData.data.data(), meshData.data.size() );
-    is.read( (char*)&magic[ 0 ], sizeof( magic ) );
+    if (cachedData)
+    {
+        m().data = cachedData;
+        AddUniqueInstance( this );
+
+        return LoadResult::Success;
+    }
 
-    if (magic[ 0 ] != 'a' || magic[ 1 ] != '9')
+    Mesh decodedMesh;
+    const LoadResult result = decodedMesh.Decode( path );
+
+    if (result == LoadResult::FileNotFound)
+    {
+        // Creates the default mesh.
+        return Load( FileSystem::FileContentsData() );
+    }
+    else if (result != LoadResult::Success)
     {
-        System::Print( "%s is corrupted or old format: Wrong magic number!\n", meshData.path.c_str() );
-        return LoadResult::Corrupted;
+        return result;
     }
 
-    is.read( (char*)&m().aabbMin, sizeof( m().aabbMin ) );
-    is.read( (char*)&m().aabbMax, sizeof( m().aabbMax ) );
+    return LoadDecoded( decodedMesh );
+}
 
-    const auto& aabbMin = m().aabbMin;
-    const auto& aabbMax = m().aabbMax;
+ae3d::Mesh::LoadResult ae3d::Mesh::Decode( const FileSystem::FileContentsData& meshData )
+{
+    if (!meshData.isLoaded)
+    {
+        return LoadResult::FileNotFound;
+    }
+
+    std::shared_ptr< MeshData > data = std::make_shared< MeshData >();
+    data->path = meshData.path;
+
+    const LoadResult result = ParseCopy( meshData.data.data(), meshData.data.size(), *data );
 
-    if (aabbMin.x > aabbMax.x || aabbMin.y > aabbMax.y || aabbMin.z > aabbMax.z)
+    if (result == LoadResult::Success)
     {
-        return LoadResult::Corrupted;
+        m().data = data;
     }
-    
-    uint16_t meshCount;
-    is.read( (char*)&meshCount, sizeof( meshCount ) );
 
-    m().subMeshes.clear();
-    m().subMeshes.resize( meshCount );
+    return result;
+}
+
+ae3d::Mesh::LoadResult ae3d::Mesh::Decode( const char* path )
+{
+    std::shared_ptr< MeshData > data = std::make_shared< MeshData >();
+    data->mapping = FileSystem::MapFile( path );
+    data->path = data->mapping.path;
 
-    for (auto& subMesh : m().subMeshes)
+    if (data->mapping.data == nullptr)
     {
-        is.read( (char*)&subMesh.aabbMin, sizeof( subMesh.aabbMin ) );
-        is.read( (char*)&subMesh.aabbMax, sizeof( subMesh.aabbMax ) );
+        return LoadResult::FileNotFound;
+    }
 
-        uint16_t nameLength = 0;
-        is.read( (char*)&nameLength, sizeof( nameLength ) );
+    LoadResult result;
 
-        std::vector< char > meshName( nameLength + 1 );
-        is.read( &meshName[ 0 ], nameLength );
-        subMesh.name = std::string( meshName.data(), meshName.size() - 1 );
+    // The mapping stays valid while the mesh is used, also if it's a view into a .pak file that is unloaded.
+    if (IsVersion2( data->mapping.data, data->mapping.size ))
+    {
+        result = ParseV2( data->mapping.data, data->mapping.size, *data );
+    }
+    else
+    {
+        result = ParseCopy( data->mapping.data, data->mapping.size, *data );
+        FileSystem::UnmapFile( data->mapping );
+    }
+
+    if (result == LoadResult::Success)
+    {
+        m().data = data;
+    }
 
-        uint16_t vertexCount = 0;
-        is.read( (char*)&vertexCount, sizeof( vertexCount ) );
+    return result;
+}
 
-        uint8_t vertexFormat = 0;
-        is.read( (char*)&vertexFormat, sizeof( vertexFormat ) );
-        
-        if (vertexFormat == 0) // PTNTC
+ae3d::Mesh::LoadResult ae3d::Mesh::LoadDecoded( Mesh& decodedMesh )
+{
+    std::shared_ptr< MeshData > data = decodedMesh.m().data;
+    decodedMesh.m().data = GetEmptyMeshData();
+
+    // Another load of the same file may have finished after decodedMesh was decoded.
+    std::shared_ptr< MeshData > cachedData = LoadFromCache( data->path );
+
+    if (cachedData)
+    {
+        m().data = cachedData;
+        AddUniqueInstance( this );
+
+        return LoadResult::Success;
+    }
+
+    const std::size_t pos = data->path.find_last_of( '/' );
+    const std::string shortPath = pos != std::string::npos ? data->path.substr( pos ) : data->path;
+
+    for (auto& subMesh : data->subMeshes)
+    {
+        const int faceCount = static_cast< int >( subMesh.faceCount );
+        const int vertexCount = static_cast< int >( subMesh.vertexCount );
+
+        if (subMesh.indexType == VertexBuffer::IndexType::UInt32)
         {
-            try { subMesh.verticesPTNTC.resize( vertexCount ); }
-            catch (std::bad_alloc&)
+            const VertexBuffer::Face32* faces = static_cast< const VertexBuffer::Face32* >( subMesh.indices );
+
+            if (subMesh.vertexFormat == VertexBuffer::VertexFormat::PTNTC)
             {
-                return LoadResult::OutOfMemory;
+                subMesh.vertexBuffer.Generate( faces, faceCount, static_cast< const VertexBuffer::VertexPTNTC* >( subMesh.vertices ), vertexCount );
             }
-        
-            is.read( (char*)&subMesh.verticesPTNTC[ 0 ].position.x, vertexCount * sizeof( VertexBuffer::VertexPTNTC ) );
-        }
-        else if (vertexFormat == 1) // PTN
-        {
-            try { subMesh.verticesPTN.resize( vertexCount ); }
-            catch (std::bad_alloc&)
+            else if (subMesh.vertexFormat == VertexBuffer::VertexFormat::PTN)
             {
-                return LoadResult::OutOfMemory;
+                subMesh.vertexBuffer.Generate( faces, faceCount, static_cast< const VertexBuffer::VertexPTN* >( subMesh.vertices ), vertexCount );
             }
-            
-            is.read( (char*)&subMesh.verticesPTN[ 0 ].position.x, vertexCount * sizeof( VertexBuffer::VertexPTN ) );
-        }
-        else if (vertexFormat == 2) // PTNTC_Skinned
-        {
-            try { subMesh.verticesPTNTC_Skinned.resize( vertexCount ); }
-            catch (std::bad_alloc&)
+            else
             {
-                return LoadResult::OutOfMemory;
+                subMesh.vertexBuffer.Generate( faces, faceCount, static_cast< const VertexBuffer::VertexPTNTC_Skinned* >( subMesh.vertices ), vertexCount );
             }
-            
-            is.read( (char*)&subMesh.verticesPTNTC_Skinned[ 0 ].position.x, vertexCount * sizeof( VertexBuffer::VertexPTNTC_Skinned ) );
         }
         else
         {
-            System::Print( "Mesh %s submesh %s has invalid vertex format %d. Only 0, 1 and 2 are valid!\n", meshData.path.c_str(), subMesh.name.c_str(), vertexFormat );
-            return LoadResult::Corrupted;
-        }
-
-        uint16_t faceCount = 0;
-        is.read( (char*)&faceCount, sizeof( faceCount ) );
-
-        try { subMesh.indices.resize( faceCount ); }
-        catch (std::bad_alloc&)
-        {
-            return LoadResult::OutOfMemory;
-        }
+            const VertexBuffer::Face* faces = static_cast< const VertexBuffer::Face* >( subMesh.indices );
 
-        is.read( (char*)&subMesh.indices[ 0 ], faceCount * sizeof( VertexBuffer::Face ) );
-
-        if (vertexFormat == 0)
-        {
-            subMesh.vertexBuffer.Generate( subMesh.indices.data(), static_cast< int >( subMesh.indices.size() ), subMesh.verticesPTNTC.data(), static_cast< int >( subMesh.verticesPTNTC.size() ) );
-        }
-        else if (vertexFormat == 1)
-        {
-            subMesh.vertexBuffer.Generate( subMesh.indices.data(), static_cast< int >( subMesh.indices.size() ), subMesh.verticesPTN.data(), static_cast< int >( subMesh.verticesPTN.size() ) );
-        }
-        else if (vertexFormat == 2)
-        {
-            subMesh.vertexBuffer.Generate( subMesh.indices.data(), static_cast< int >( subMesh.indices.size() ), subMesh.verticesPTNTC_Skinned.data(), static_cast< int >( subMesh.verticesPTNTC_Skinned.size() ) );
-        }
-        else
-        {
-            ae3d::System::Assert( false, "unhandled vertex format" );
-        }
-
-        if (vertexFormat == 2)
-        {
-            uint16_t jointCount = 0;
-            is.read( (char*)&jointCount, sizeof( jointCount ) );
-
-            System::Assert( jointCount < 80, "Joint array in PerObjectUboStruct is too small!" );
-
-            subMesh.joints.resize( jointCount );
-            
-            for (size_t j = 0; j < subMesh.joints.size(); ++j)
+            if (subMesh.vertexFormat == VertexBuffer::VertexFormat::PTNTC)
             {
-                is.read( (char*)&subMesh.joints[ j ].globalBindposeInverse, sizeof( ae3d::Matrix44 ) );
-                is.read( (char*)&subMesh.joints[ j ].parentIndex, 4 );
-                int jointNameLength;
-                is.read( (char*)&jointNameLength, sizeof( int ) );
-                
-                if (jointNameLength > 128)
-                {
-                    System::Print( "Mesh %s has a joint with too long name, max is 128.\n", meshData.path.c_str() );
-                    return LoadResult::Corrupted;
-                }
-
-                is.read( subMesh.joints[ j ].name, jointNameLength );
-                subMesh.joints[ j ].name[ jointNameLength ] = 0;
-                int animLength;
-                is.read( (char*)&animLength, sizeof( int ) );
-                subMesh.joints[ j ].animTransforms.resize( animLength );
-                is.read( (char*)subMesh.joints[ j ].animTransforms.data(), subMesh.joints[ j ].animTransforms.size() * sizeof( ae3d::Matrix44 ) );
+                subMesh.vertexBuffer.Generate( faces, faceCount, static_cast< const VertexBuffer::VertexPTNTC* >( subMesh.vertices ), vertexCount );
+            }
+            else if (subMesh.vertexFormat == VertexBuffer::VertexFormat::PTN)
+            {
+                subMesh.vertexBuffer.Generate( faces, faceCount, static_cast< const VertexBuffer::VertexPTN* >( subMesh.vertices ), vertexCount );
+            }
+            else
+            {
+                subMesh.vertexBuffer.Generate( faces, faceCount, static_cast< const VertexBuffer::VertexPTNTC_Skinned* >( subMesh.vertices ), vertexCount );
             }
-        }
-        
-        const std::size_t pos = meshData.path.find_last_of( '/' );
-        std::string shortPath = meshData.path;
-        
-        if (pos != std::string::npos)
-        {
-            shortPath = meshData.path.substr( pos );
         }
 
-        std::string subMeshDebugName = shortPath + std::string( ":" ) + subMesh.name;
+        const std::string subMeshDebugName = shortPath + std::string( ":" ) + subMesh.name;
         subMesh.vertexBuffer.SetDebugName( subMeshDebugName.c_str() );
     }
-    
-    uint8_t terminator = 0;
-    is.read( (char*)&terminator, sizeof( terminator ) );
 
-    if (terminator != 100)
-    {
-        return LoadResult::Corrupted;
-    }
-
-    MeshCacheEntry cacheEntry;
-    cacheEntry.path = meshData.path;
-    cacheEntry.aabbMin = m().aabbMin;
-    cacheEntry.aabbMax = m().aabbMax;
-    cacheEntry.subMeshes = m().subMeshes;
-    gMeshCache.push_back( cacheEntry );
+    gMeshCache.push_back( data );
+    m().data = data;
 
     AddUniqueInstance( this );
 
-    fileWatcher.AddFile( meshData.path, MeshReload );
-    
-    m().path = meshData.path;
+    fileWatcher.AddFile( data->path, MeshReload );
     
     return LoadResult::Success;
 }
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ae3d
+{
+    /**
+      .ae3d mesh file format version 2, written by the converters in Tools and read by Mesh::Load.
+
+      A file starts with Header, which is followed by the SubMesh array at Header::subMeshesOffset. Each submesh
+      points to its name, vertices, indices and, for skinned submeshes, its Joint array. A joint points to its name and
+      its animation transforms (Matrix44 per frame). Offsets are from the beginning of the file and vertices, indices,
+      submesh and joint arrays and animation transforms are aligned to DataAlignment bytes, so vertices and indices can
+      be used in place from a memory mapping without parsing. Names are null-terminated, nameLength doesn't include the
+      null terminator. Everything is little-endian.
+
+      Vertices are in the engine's VertexBuffer::VertexPTNTC, VertexPTN or VertexPTNTC_Skinned layout, selected by
+      SubMesh::vertexFormat. Indices are 16-bit if SubMesh::indexSize is 2 and 32-bit if it's 4, three per face.
+
+      Version 1 files start with magic "a9" and have 16-bit counts and indices. Mesh::Load still reads them by copying.
+
+      Increment Version when the layout changes.
+     */
+    namespace MeshFormat
+    {
+        const char Magic[ 4 ] = { 'a', 'e', '3', 'm' };
+        const std::uint32_t Version = 2;
+        const std::uint64_t DataAlignment = 16;
+
+        namespace VertexFormat
+        {
+            const std::uint32_t PTNTC = 0;
+            const std::uint32_t PTN = 1;
+            const std::uint32_t PTNTC_Skinned = 2;
+        }
+
+        /// Vertex size in bytes for each VertexFormat.
+        constexpr std::uint32_t VertexSizes[ 3 ] = { 64, 32, 96 };
+
+        struct Header
+        {
+            char magic[ 4 ];
+            std::uint32_t version;
+            float aabbMin[ 3 ];
+            float aabbMax[ 3 ];
+            std::uint32_t subMeshCount;
+            std::uint32_t reserved;
+            std::uint64_t subMeshesOffset;
+            std::uint64_t fileSize;
+        };
+
+        struct SubMesh
+        {
+            float aabbMin[ 3 ];
+            float aabbMax[ 3 ];
+            std::uint32_t vertexFormat; // VertexFormat.
+            std::uint32_t indexSize; // 2 or 4.
+            std::uint32_t vertexCount;
+            std::uint32_t faceCount;
+            std::uint64_t verticesOffset;
+            std::uint64_t indicesOffset;
+            std::uint64_t nameOffset;
+            std::uint32_t nameLength;
+            std::uint32_t jointCount; // 0 unless vertexFormat is PTNTC_Skinned.
+            std::uint64_t jointsOffset;
+        };
+
+        struct Joint
+        {
+            float globalBindposeInverse[ 16 ];
+            std::int32_t parentIndex; // -1 for the root.
+            std::uint32_t nameLength;
+            std::uint64_t nameOffset;
+            std::uint64_t animTransformsOffset;
+            std::uint32_t animTransformCount;
+            std::uint32_t reserved;
+        };
+
+        static_assert( sizeof( Header ) == 56 && sizeof( SubMesh ) == 80 && sizeof( Joint ) == 96, "Mesh structures must not have padding" );
+    }
+}
@@ -0,0 +1,385 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "OcclusionCuller.hpp"
+#include <algorithm>
+#include <cstring>
+#if SIMD_SSE3
+#include <pmmintrin.h>
+#endif
+
+using namespace ae3d;
+
+namespace
+{
+    const int TilesX = OcclusionCuller::Width / OcclusionCuller::TileSize;
+    const int TilesY = OcclusionCuller::Height / OcclusionCuller::TileSize;
+
+    static_assert( OcclusionCuller::Width % OcclusionCuller::TileSize == 0 && OcclusionCuller::Height % OcclusionCuller::TileSize == 0,
+                   "Depth buffer must be a whole number of tiles" );
+    static_assert( OcclusionCuller::Width % 4 == 0 && OcclusionCuller::TileSize % 4 == 0, "Rows are processed 4 pixels at a time" );
+
+    // A box is hidden only if occluders are nearer than it by this factor, so an occluder doesn't hide its own bounds
+    // because of interpolation error.
+    const float DepthBias = 1.0001f;
+
+    // Triangles with a smaller doubled screen-space area don't cover any pixel centers.
+    const float MinArea = 1.0e-6f;
+
+    void GetClipPosition( const float* position, const Matrix44& localToClip, float& outX, float& outY, float& outW )
+    {
+        const float* m = localToClip.m;
+        outX = m[ 0 ] * position[ 0 ] + m[ 4 ] * position[ 1 ] + m[  8 ] * position[ 2 ] + m[ 12 ];
+        outY = m[ 1 ] * position[ 0 ] + m[ 5 ] * position[ 1 ] + m[  9 ] * position[ 2 ] + m[ 13 ];
+        outW = m[ 3 ] * position[ 0 ] + m[ 7 ] * position[ 1 ] + m[ 11 ] * position[ 2 ] + m[ 15 ];
+    }
+
+    // Screen coordinate to pixel index in [0, maxIndex]. Coordinates can be far outside the screen after near plane clipping.
+    int ToPixel( float coordinate, int maxIndex )
+    {
+        return !(coordinate > 0) ? 0 : (coordinate >= maxIndex ? maxIndex : static_cast< int >( coordinate ));
+    }
+
+    unsigned GetIndex( const void* indices, unsigned indexSize, unsigned i )
+    {
+        return indexSize == 2 ? static_cast< const unsigned short* >( indices )[ i ] : static_cast< const unsigned* >( indices )[ i ];
+    }
+
+    // Edge function coefficients: e(x, y) = a * x + b * y + c, positive on the inner side of edge p0 -> p1
+    // of a counter-clockwise triangle.
+    struct Edge
+    {
+        Edge( float x0, float y0, float x1, float y1 )
+        : a( y0 - y1 )
+        , b( x1 - x0 )
+        , c( -(y0 - y1) * x0 - (x1 - x0) * y0 )
+        {}
+
+        float a, b, c;
+    };
+}
+
+void OcclusionCuller::Begin( const Matrix44& aWorldToClip, float nearDepth )
+{
+    worldToClip = aWorldToClip;
+    nearW = nearDepth;
+    rasterizedTriangleCount = 0;
+    depth.assign( Width * Height, 0.0f );
+    tileFarthest.assign( TilesX * TilesY, 0.0f );
+}
+
+void OcclusionCuller::RasterizeTriangles( const void* vertices, unsigned vertexStride, unsigned vertexCount, const void* indices, unsigned indexSize,
+                                          unsigned triangleCount, const Matrix44& localToWorld )
+{
+    if (vertices == nullptr || indices == nullptr || depth.empty() || (indexSize != 2 && indexSize != 4))
+    {
+        return;
+    }
+
+    Matrix44 localToClip;
+    Matrix44::Multiply( localToWorld, worldToClip, localToClip );
+
+    clipVertices.resize( vertexCount );
+    const unsigned char* vertexBytes = static_cast< const unsigned char* >( vertices );
+
+    for (unsigned v = 0; v < vertexCount; ++v)
+    {
+        float position[ 3 ];
+        std::memcpy( position, vertexBytes + v * vertexStride, sizeof( position ) );
+        GetClipPosition( position, localToClip, clipVertices[ v ].x, clipVertices[ v ].y, clipVertices[ v ].w );
+    }
+
+    for (unsigned t = 0; t < triangleCount; ++t)
+    {
+        const unsigned i0 = GetIndex( indices, indexSize, t * 3 + 0 );
+        const unsigned i1 = GetIndex( indices, indexSize, t * 3 + 1 );
+        const unsigned i2 = GetIndex( indices, indexSize, t * 3 + 2 );
+
+        if (i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount)
+        {
+            continue;
+        }
+
+        const ClipVertex& v0 = clipVertices[ i0 ];
+        const ClipVertex& v1 = clipVertices[ i1 ];
+        const ClipVertex& v2 = clipVertices[ i2 ];
+
+        const int inFrontCount = (v0.w >= nearW ? 1 : 0) + (v1.w >= nearW ? 1 : 0) + (v2.w >= nearW ? 1 : 0);
+
+        if (inFrontCount == 0)
+        {
+            continue;
+        }
+
+        if (inFrontCount < 3)
+        {
+            RasterizeClipped( v0, v1, v2 );
+            continue;
+        }
+
+        // Outside one of the side planes.
+        if ((v0.x >  v0.w && v1.x >  v1.w && v2.x >  v2.w) || (v0.y >  v0.w && v1.y >  v1.w && v2.y >  v2.w) ||
+            (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) || (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w))
+        {
+            continue;
+        }
+
+        RasterizeTriangle( v0, v1, v2 );
+    }
+}
+
+void OcclusionCuller::RasterizeClipped( const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2 )
+{
+    // Clips the triangle against the near plane, which leaves at most a quad.
+    const ClipVertex in[ 3 ] = { v0, v1, v2 };
+    ClipVertex out[ 4 ];
+    int outCount = 0;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const ClipVertex& a = in[ i ];
+        const ClipVertex& b = in[ (i + 1) % 3 ];
+        const bool aInFront = a.w >= nearW;
+
+        if (aInFront)
+        {
+            out[ outCount++ ] = a;
+        }
+
+        if (aInFront != (b.w >= nearW))
+        {
+            const float t = (nearW - a.w) / (b.w - a.w);
+            out[ outCount++ ] = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, nearW };
+        }
+    }
+
+    for (int i = 2; i < outCount; ++i)
+    {
+        RasterizeTriangle( out[ 0 ], out[ i - 1 ], out[ i ] );
+    }
+}
+
+void OcclusionCuller::RasterizeTriangle( const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2 )
+{
+    const float invW[ 3 ] = { 1.0f / v0.w, 1.0f / v1.w, 1.0f / v2.w };
+    float x[ 3 ] = { (v0.x * invW[ 0 ] * 0.5f + 0.5f) * Width, (v1.x * invW[ 1 ] * 0.5f + 0.5f) * Width, (v2.x * invW[ 2 ] * 0.5f + 0.5f) * Width };
+    float y[ 3 ] = { (v0.y * invW[ 0 ] * 0.5f + 0.5f) * Height, (v1.y * invW[ 1 ] * 0.5f + 0.5f) * Height, (v2.y * invW[ 2 ] * 0.5f + 0.5f) * Height };
+    float z[ 3 ] = { invW[ 0 ], invW[ 1 ], invW[ 2 ] };
+
+    float area = (x[ 1 ] - x[ 0 ]) * (y[ 2 ] - y[ 0 ]) - (x[ 2 ] - x[ 0 ]) * (y[ 1 ] - y[ 0 ]);
+
+    // Both windings are rasterized, so clockwise triangles are made counter-clockwise.
+    if (area < 0)
+    {
+        std::swap( x[ 1 ], x[ 2 ] );
+        std::swap( y[ 1 ], y[ 2 ] );
+        std::swap( z[ 1 ], z[ 2 ] );
+        area = -area;
+    }
+
+    if (!(area > MinArea))
+    {
+        return;
+    }
+
+    const float triangleMinX = std::min( { x[ 0 ], x[ 1 ], x[ 2 ] } );
+    const float triangleMinY = std::min( { y[ 0 ], y[ 1 ], y[ 2 ] } );
+    const float triangleMaxX = std::max( { x[ 0 ], x[ 1 ], x[ 2 ] } );
+    const float triangleMaxY = std::max( { y[ 0 ], y[ 1 ], y[ 2 ] } );
+
+    if (triangleMaxX < 0 || triangleMaxY < 0 || triangleMinX >= Width || triangleMinY >= Height)
+    {
+        return;
+    }
+
+    // Rows start at a multiple of 4 pixels, so 4 pixels can always be read, because Width is a multiple of 4.
+    const int minX = ToPixel( triangleMinX, Width - 1 ) & ~3;
+    const int maxX = ToPixel( triangleMaxX, Width - 1 );
+    const int minY = ToPixel( triangleMinY, Height - 1 );
+    const int maxY = ToPixel( triangleMaxY, Height - 1 );
+
+    ++rasterizedTriangleCount;
+
+    // Edge k is opposite to vertex k, so its edge function is the barycentric weight of vertex k times area.
+    const Edge edges[ 3 ] = { Edge( x[ 1 ], y[ 1 ], x[ 2 ], y[ 2 ] ), Edge( x[ 2 ], y[ 2 ], x[ 0 ], y[ 0 ] ), Edge( x[ 0 ], y[ 0 ], x[ 1 ], y[ 1 ] ) };
+    const float invArea = 1.0f / area;
+    const float za = (edges[ 0 ].a * z[ 0 ] + edges[ 1 ].a * z[ 1 ] + edges[ 2 ].a * z[ 2 ]) * invArea;
+    const float zb = (edges[ 0 ].b * z[ 0 ] + edges[ 1 ].b * z[ 1 ] + edges[ 2 ].b * z[ 2 ]) * invArea;
+    const float zc = (edges[ 0 ].c * z[ 0 ] + edges[ 1 ].c * z[ 1 ] + edges[ 2 ].c * z[ 2 ]) * invArea;
+
+#if SIMD_SSE3
+    const float startX = minX + 0.5f;
+    const __m128 pixelOffsets = _mm_setr_ps( 0, 1, 2, 3 );
+    const __m128 zero = _mm_setzero_ps();
+    __m128 edgeDx[ 3 ];
+    __m128 edgeStep[ 3 ];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        edgeDx[ k ] = _mm_mul_ps( _mm_set1_ps( edges[ k ].a ), pixelOffsets );
+        edgeStep[ k ] = _mm_set1_ps( edges[ k ].a * 4 );
+    }
+
+    const __m128 zDx = _mm_mul_ps( _mm_set1_ps( za ), pixelOffsets );
+    const __m128 zStep = _mm_set1_ps( za * 4 );
+
+    for (int py = minY; py <= maxY; ++py)
+    {
+        const float centerY = py + 0.5f;
+        __m128 e0 = _mm_add_ps( _mm_set1_ps( edges[ 0 ].a * startX + edges[ 0 ].b * centerY + edges[ 0 ].c ), edgeDx[ 0 ] );
+        __m128 e1 = _mm_add_ps( _mm_set1_ps( edges[ 1 ].a * startX + edges[ 1 ].b * centerY + edges[ 1 ].c ), edgeDx[ 1 ] );
+        __m128 e2 = _mm_add_ps( _mm_set1_ps( edges[ 2 ].a * startX + edges[ 2 ].b * centerY + edges[ 2 ].c ), edgeDx[ 2 ] );
+        __m128 pixelZ = _mm_add_ps( _mm_set1_ps( za * startX + zb * centerY + zc ), zDx );
+        float* row = &depth[ py * Width ];
+
+        for (int px = minX; px <= maxX; px += 4)
+        {
+            const __m128 inside = _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( e0, zero ), _mm_cmpge_ps( e1, zero ) ), _mm_cmpge_ps( e2, zero ) );
+
+            if (_mm_movemask_ps( inside ) != 0)
+            {
+                const __m128 oldZ = _mm_loadu_ps( row + px );
+                const __m128 newZ = _mm_max_ps( oldZ, pixelZ );
+                _mm_storeu_ps( row + px, _mm_or_ps( _mm_and_ps( inside, newZ ), _mm_andnot_ps( inside, oldZ ) ) );
+            }
+
+            e0 = _mm_add_ps( e0, edgeStep[ 0 ] );
+            e1 = _mm_add_ps( e1, edgeStep[ 1 ] );
+            e2 = _mm_add_ps( e2, edgeStep[ 2 ] );
+            pixelZ = _mm_add_ps( pixelZ, zStep );
+        }
+    }
+#else
+    for (int py = minY; py <= maxY; ++py)
+    {
+        const float centerY = py + 0.5f;
+        float* row = &depth[ py * Width ];
+
+        for (int px = minX; px <= maxX; ++px)
+        {
+            const float centerX = px + 0.5f;
+
+            if (edges[ 0 ].a * centerX + edges[ 0 ].b * centerY + edges[ 0 ].c >= 0 &&
+                edges[ 1 ].a * centerX + edges[ 1 ].b * centerY + edges[ 1 ].c >= 0 &&
+                edges[ 2 ].a * centerX + edges[ 2 ].b * centerY + edges[ 2 ].c >= 0)
+            {
+                row[ px ] = std::max( row[ px ], za * centerX + zb * centerY + zc );
+            }
+        }
+    }
+#endif
+}
+
+void OcclusionCuller::EndOccluders()
+{
+    if (depth.empty())
+    {
+        return;
+    }
+
+    for (int ty = 0; ty < TilesY; ++ty)
+    {
+        for (int tx = 0; tx < TilesX; ++tx)
+        {
+            const float* tile = &depth[ ty * TileSize * Width + tx * TileSize ];
+#if SIMD_SSE3
+            __m128 farthest = _mm_loadu_ps( tile );
+
+            for (int py = 0; py < TileSize; ++py)
+            {
+                for (int px = 0; px < TileSize; px += 4)
+                {
+                    farthest = _mm_min_ps( farthest, _mm_loadu_ps( tile + py * Width + px ) );
+                }
+            }
+
+            farthest = _mm_min_ps( farthest, _mm_shuffle_ps( farthest, farthest, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+            farthest = _mm_min_ps( farthest, _mm_shuffle_ps( farthest, farthest, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+            tileFarthest[ ty * TilesX + tx ] = _mm_cvtss_f32( farthest );
+#else
+            float farthest = tile[ 0 ];
+
+            for (int py = 0; py < TileSize; ++py)
+            {
+                for (int px = 0; px < TileSize; ++px)
+                {
+                    farthest = std::min( farthest, tile[ py * Width + px ] );
+                }
+            }
+
+            tileFarthest[ ty * TilesX + tx ] = farthest;
+#endif
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible( const Vec3& aabbMin, const Vec3& aabbMax ) const
+{
+    if (depth.empty())
+    {
+        return true;
+    }
+
+    float minX = 1.0e30f, minY = 1.0e30f;
+    float maxX = -1.0e30f, maxY = -1.0e30f;
+    float nearestZ = 0;
+
+    for (int c = 0; c < 8; ++c)
+    {
+        const float corner[ 3 ] = { (c & 1) ? aabbMax.x : aabbMin.x, (c & 2) ? aabbMax.y : aabbMin.y, (c & 4) ? aabbMax.z : aabbMin.z };
+        float x, y, w;
+        GetClipPosition( corner, worldToClip, x, y, w );
+
+        // w is linear in world space, so the corners bound the whole box.
+        if (!(w >= nearW))
+        {
+            return true;
+        }
+
+        const float invW = 1.0f / w;
+        const float screenX = (x * invW * 0.5f + 0.5f) * Width;
+        const float screenY = (y * invW * 0.5f + 0.5f) * Height;
+        minX = std::min( minX, screenX );
+        maxX = std::max( maxX, screenX );
+        minY = std::min( minY, screenY );
+        maxY = std::max( maxY, screenY );
+        nearestZ = std::max( nearestZ, invW );
+    }
+
+    if (maxX < 0 || maxY < 0 || minX >= Width || minY >= Height)
+    {
+        return true;
+    }
+
+    const float hiddenZ = nearestZ * DepthBias;
+    const int x0 = ToPixel( minX, Width - 1 );
+    const int y0 = ToPixel( minY, Height - 1 );
+    const int x1 = ToPixel( maxX, Width - 1 );
+    const int y1 = ToPixel( maxY, Height - 1 );
+
+    for (int ty = y0 / TileSize; ty <= y1 / TileSize; ++ty)
+    {
+        for (int tx = x0 / TileSize; tx <= x1 / TileSize; ++tx)
+        {
+            if (tileFarthest[ ty * TilesX + tx ] > hiddenZ)
+            {
+                continue;
+            }
+
+            const int tileY1 = std::min( y1, ty * TileSize + TileSize - 1 );
+            const int tileX1 = std::min( x1, tx * TileSize + TileSize - 1 );
+
+            for (int py = std::max( y0, ty * TileSize ); py <= tileY1; ++py)
+            {
+                for (int px = std::max( x0, tx * TileSize ); px <= tileX1; ++px)
+                {
+                    if (depth[ py * Width + px ] <= hiddenZ)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include "Matrix.hpp"
+#include "Vec3.hpp"
+
+namespace ae3d
+{
+    /**
+      Software occlusion culler. Occluder triangles are rasterized on the CPU into a low-resolution depth buffer and
+      boxes are tested against it, so hidden objects can be dropped before they are rendered. Doesn't need a graphics
+      device.
+
+      Depth is stored as 1 / w, which doesn't depend on the projection's depth range and is linear in screen space.
+      Larger is nearer and 0 is empty. The buffer has a second level of TileSize * TileSize pixel tiles that store the
+      farthest depth in the tile, so most boxes are accepted or rejected without reading pixels.
+
+      Usage: Begin(), RasterizeTriangles() for each occluder, EndOccluders(), then IsVisible() for each box.
+      Only perspective projections are supported.
+     */
+    class OcclusionCuller
+    {
+      public:
+        /// Depth buffer width in pixels.
+        static const int Width = 256;
+        /// Depth buffer height in pixels.
+        static const int Height = 128;
+        /// Tile width and height in pixels.
+        static const int TileSize = 8;
+
+        /**
+          Clears the depth buffer.
+
+          \param worldToClip View-projection matrix.
+          \param nearDepth Near clip plane distance. Occluders are clipped to it.
+         */
+        void Begin( const Matrix44& worldToClip, float nearDepth );
+
+        /**
+          Rasterizes occluder triangles. Both windings are rasterized.
+
+          \param vertices Vertices. Position must be the first member.
+          \param vertexStride Vertex size in bytes.
+          \param vertexCount Vertex count.
+          \param indices 16-bit or 32-bit indices, three per triangle.
+          \param indexSize Index size in bytes, 2 or 4.
+          \param triangleCount Triangle count.
+          \param localToWorld Occluder's local-to-world matrix.
+         */
+        void RasterizeTriangles( const void* vertices, unsigned vertexStride, unsigned vertexCount, const void* indices, unsigned indexSize,
+                                 unsigned triangleCount, const Matrix44& localToWorld );
+
+        /// Updates the tile level. Must be called after occluders have been rasterized and before IsVisible().
+        void EndOccluders();
+
+        /**
+          Tests a box against the occluders. Boxes that intersect the near plane or are outside the screen are visible.
+
+          \param aabbMin Box minimum in world space.
+          \param aabbMax Box maximum in world space.
+          \return False, if the box is completely hidden by the occluders.
+         */
+        bool IsVisible( const Vec3& aabbMin, const Vec3& aabbMax ) const;
+
+        /// \return Depth (1 / w) at a pixel. 0 if nothing was rasterized there.
+        float GetDepth( int x, int y ) const { return depth.empty() ? 0 : depth[ y * Width + x ]; }
+
+        /// \return Number of triangles rasterized since Begin(), after clipping.
+        unsigned GetRasterizedTriangleCount() const { return rasterizedTriangleCount; }
+
+      private:
+        struct ClipVertex
+        {
+            float x, y, w;
+        };
+
+        void RasterizeTriangle( const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2 );
+        void RasterizeClipped( const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2 );
+
+        Matrix44 worldToClip;
+        float nearW = 0.1f;
+        unsigned rasterizedTriangleCount = 0;
+        std::vector< float > depth; // Width * Height.
+        std::vector< float > tileFarthest; // Farthest depth in each tile.
+        std::vector< ClipVertex > clipVertices; // Scratch for RasterizeTriangles.
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ae3d
+{
+    /**
+      .pak file format written by Tools/CombineFiles and read by FileSystem::LoadPakFile.
+
+      A file starts with Header, which is followed by the table of contents (Entry array), a hash table, entry paths
+      and entry contents. The hash table has a power-of-two number of buckets that contain an entry index + 1, or 0 for
+      an empty bucket. An entry is found by probing linearly from bucket (HashPath( path ) & (bucketCount - 1)), so the
+      lookup doesn't depend on the number of entries. Paths are null-terminated and use '/' as a separator.
+      Entry contents are aligned to DataAlignment bytes. Everything is little-endian, and the file is used in place from
+      a memory mapping without parsing.
+
+      Contents of an entry that has EntryFlags::Compressed are split into blocks of CompressionBlockSize uncompressed bytes
+      (the last block may be smaller). The contents start with the stored size of each block as uint32, followed by the
+      blocks. A block is compressed with Lz4 unless its stored size equals its uncompressed size, in which case it's stored
+      as is. Blocks are independent, so they can be decompressed in parallel.
+
+      Increment Version when the layout changes.
+     */
+    namespace PakFormat
+    {
+        const char Magic[ 4 ] = { 'a', 'e', '3', 'p' };
+        const std::uint32_t Version = 3;
+        const std::uint64_t DataAlignment = 16;
+        const std::uint64_t CompressionBlockSize = 256 * 1024;
+
+        namespace EntryFlags
+        {
+            const std::uint32_t Compressed = 1 << 0;
+        }
+
+        struct Header
+        {
+            char magic[ 4 ];
+            std::uint32_t version;
+            std::uint32_t entryCount;
+            std::uint32_t bucketCount;
+            std::uint64_t entriesOffset;
+            std::uint64_t bucketsOffset;
+            std::uint64_t pathsOffset;
+            std::uint64_t pathsSize;
+        };
+
+        struct Entry
+        {
+            std::uint64_t pathHash;
+            std::uint64_t dataOffset;
+            std::uint64_t dataSize; // Stored size.
+            std::uint64_t uncompressedSize; // Equals dataSize if the entry is not compressed.
+            std::uint32_t pathOffset; // Offset from Header::pathsOffset.
+            std::uint32_t pathLength; // Not including the null terminator.
+            std::uint32_t flags; // EntryFlags.
+            std::uint32_t reserved;
+        };
+
+        /// \return 64-bit FNV-1a hash of the path.
+        inline std::uint64_t HashPath( const char* path, std::size_t length )
+        {
+            std::uint64_t hash = 14695981039346656037ull;
+
+            for (std::size_t i = 0; i < length; ++i)
+            {
+                hash ^= static_cast< unsigned char >( path[ i ] );
+                hash *= 1099511628211ull;
+            }
+
+            return hash;
+        }
+
+        static_assert( sizeof( Header ) == 48 && sizeof( Entry ) == 48, "Pak structures must not have padding" );
+    }
+}
@@ -0,0 +1,187 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "RenderQueue.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace ae3d;
+
+namespace
+{
+    // Key layout from the most significant bit:
+    //   Opaque:      pass (1), shader (10), material (12), mesh (12), submesh (5), depth (24)
+    //   Transparent: pass (1), inverted depth (24), shader (10), material (12), mesh (12), submesh (5)
+    // Submeshes of an object have the same depth, so without the submesh index above the depth, the same submesh of
+    // different objects would not be consecutive, and Scene could not merge them into instanced draws.
+    const unsigned ShaderBits = 10;
+    const unsigned MaterialBits = 12;
+    const unsigned MeshBits = 12;
+    const unsigned SubMeshBits = 5;
+    const unsigned DepthBits = 24;
+    const std::uint64_t MaxDepth = (1u << DepthBits) - 1;
+
+    std::uint64_t QuantizeDepth( float viewDepth, float depthScale )
+    {
+        // Written so that NaN ends up at 0.
+        const float scaled = viewDepth * depthScale;
+        return scaled >= static_cast< float >( MaxDepth ) ? MaxDepth : (scaled > 0 ? static_cast< std::uint64_t >( scaled ) : 0);
+    }
+}
+
+void RenderQueue::IdTable::Clear()
+{
+    std::fill( std::begin( keys ), std::end( keys ), nullptr );
+    count = 0;
+}
+
+unsigned RenderQueue::IdTable::GetId( const void* pointer, unsigned maxId )
+{
+    // Open addressing with linear probing. Grows at 50 % load, so probe sequences stay short.
+    if ((count + 1) * 2 > keys.size())
+    {
+        FrameVector< const void* > oldKeys( keys.size() < 64 ? 64 : keys.size() * 2, nullptr );
+        FrameVector< unsigned > oldIds( oldKeys.size() );
+        oldKeys.swap( keys );
+        oldIds.swap( ids );
+
+        for (std::size_t i = 0; i < oldKeys.size(); ++i)
+        {
+            if (oldKeys[ i ] != nullptr)
+            {
+                std::size_t slot = (reinterpret_cast< std::uintptr_t >( oldKeys[ i ] ) >> 4) * 0x9E3779B97F4A7C15ull & (keys.size() - 1);
+
+                while (keys[ slot ] != nullptr)
+                {
+                    slot = (slot + 1) & (keys.size() - 1);
+                }
+
+                keys[ slot ] = oldKeys[ i ];
+                ids[ slot ] = oldIds[ i ];
+            }
+        }
+    }
+
+    std::size_t slot = (reinterpret_cast< std::uintptr_t >( pointer ) >> 4) * 0x9E3779B97F4A7C15ull & (keys.size() - 1);
+
+    while (keys[ slot ] != nullptr)
+    {
+        if (keys[ slot ] == pointer)
+        {
+            return ids[ slot ];
+        }
+
+        slot = (slot + 1) & (keys.size() - 1);
+    }
+
+    keys[ slot ] = pointer;
+    ids[ slot ] = count & maxId;
+    ++count;
+    return ids[ slot ];
+}
+
+void RenderQueue::Clear( float farDepth )
+{
+    items.clear();
+    shaderIds.Clear();
+    materialIds.Clear();
+    meshIds.Clear();
+    depthScale = farDepth > 0 ? MaxDepth / farDepth : 0;
+}
+
+void RenderQueue::Add( Pass pass, const void* shader, const void* material, const void* mesh, float viewDepth, unsigned object, unsigned subMesh )
+{
+    // Null marks empty slots in the tables, so null pointers share id 0 with the first pointer seen.
+    const std::uint64_t shaderId = shader ? shaderIds.GetId( shader, (1u << ShaderBits) - 1 ) : 0;
+    const std::uint64_t materialId = material ? materialIds.GetId( material, (1u << MaterialBits) - 1 ) : 0;
+    const std::uint64_t meshId = mesh ? meshIds.GetId( mesh, (1u << MeshBits) - 1 ) : 0;
+    const std::uint64_t subMeshId = subMesh & ((1u << SubMeshBits) - 1);
+    const std::uint64_t depth = QuantizeDepth( viewDepth, depthScale );
+    const std::uint64_t state = (shaderId << (MaterialBits + MeshBits + SubMeshBits)) | (materialId << (MeshBits + SubMeshBits)) | (meshId << SubMeshBits) | subMeshId;
+
+    Item item;
+    item.object = object;
+    item.subMesh = subMesh;
+
+    if (pass == Pass::Opaque)
+    {
+        item.key = (state << DepthBits) | depth;
+    }
+    else
+    {
+        item.key = (1ull << 63) | ((MaxDepth - depth) << (ShaderBits + MaterialBits + MeshBits + SubMeshBits)) | state;
+    }
+
+    items.push_back( item );
+}
+
+void RenderQueue::Sort()
+{
+    RadixSort( items, scratch );
+}
+
+template< typename Vector > void RenderQueue::RadixSortItems( Vector& items, Vector& scratch )
+{
+    if (items.size() < 2)
+    {
+        return;
+    }
+
+    // Least significant digit first, 8 bits per pass. All histograms are counted in one read of the keys.
+    const unsigned PassCount = 8;
+    unsigned histograms[ PassCount ][ 256 ];
+    std::memset( histograms, 0, sizeof( histograms ) );
+
+    for (const auto& item : items)
+    {
+        for (unsigned p = 0; p < PassCount; ++p)
+        {
+            ++histograms[ p ][ (item.key >> (p * 8)) & 0xFF ];
+        }
+    }
+
+    scratch.resize( items.size() );
+    Item* source = items.data();
+    Item* destination = scratch.data();
+
+    for (unsigned p = 0; p < PassCount; ++p)
+    {
+        unsigned* histogram = histograms[ p ];
+
+        // Bits that are the same in every key don't change the order. Keys share many of them, for example unused ids and the pass.
+        if (histogram[ (source[ 0 ].key >> (p * 8)) & 0xFF ] == items.size())
+        {
+            continue;
+        }
+
+        unsigned offset = 0;
+
+        for (unsigned digit = 0; digit < 256; ++digit)
+        {
+            const unsigned digitCount = histogram[ digit ];
+            histogram[ digit ] = offset;
+            offset += digitCount;
+        }
+
+        for (std::size_t i = 0; i < items.size(); ++i)
+        {
+            destination[ histogram[ (source[ i ].key >> (p * 8)) & 0xFF ]++ ] = source[ i ];
+        }
+
+        std::swap( source, destination );
+    }
+
+    if (source != items.data())
+    {
+        items.swap( scratch );
+    }
+}
+
+void RenderQueue::RadixSort( std::vector< Item >& items, std::vector< Item >& scratch )
+{
+    RadixSortItems( items, scratch );
+}
+
+void RenderQueue::RadixSort( FrameVector< Item >& items, FrameVector< Item >& scratch )
+{
+    RadixSortItems( items, scratch );
+}
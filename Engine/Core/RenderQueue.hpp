@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "FrameArena.hpp"
+
+namespace ae3d
+{
+    /**
+      Orders draws before they are submitted. Each draw gets a 64-bit key and the keys are radix sorted.
+
+      Opaque draws come first, grouped by shader, material, mesh and submesh, so the same pipeline state and resources
+      are bound for consecutive draws, and front to back inside a group, so early depth testing rejects more pixels.
+      Transparent draws come after them, back to front, so they blend correctly.
+
+      Shaders, materials and meshes are identified by small ids that are assigned in the order they are first seen
+      after Clear(). If there are more of them, or more submeshes, than fit in the key, ids are shared, which only
+      makes grouping worse.
+
+      Items and id tables are in the frame arena of the thread that adds them, so a queue must be destroyed before the
+      frame ends. Scene creates one for each camera pass.
+     */
+    class RenderQueue
+    {
+      public:
+        enum class Pass { Opaque, Transparent };
+
+        /// Draw to submit.
+        struct Item
+        {
+            std::uint64_t key = 0;
+            unsigned object = 0; ///< Caller-defined object index.
+            unsigned subMesh = 0; ///< Submesh index.
+        };
+
+        /**
+          Removes all items.
+
+          \param farDepth Depths are quantized between 0 and this. Farther draws are treated as if they were at this depth.
+         */
+        void Clear( float farDepth );
+
+        /**
+          Adds a draw.
+
+          \param pass Pass.
+          \param shader Shader used by the draw.
+          \param material Material used by the draw.
+          \param mesh Mesh used by the draw.
+          \param viewDepth Distance from the camera along its view direction.
+          \param object Caller-defined object index, returned in Item::object.
+          \param subMesh Submesh index, returned in Item::subMesh.
+         */
+        void Add( Pass pass, const void* shader, const void* material, const void* mesh, float viewDepth, unsigned object, unsigned subMesh );
+
+        /// Sorts the items by key.
+        void Sort();
+
+        /// \return Items in the order they were added, or in draw order after Sort().
+        const FrameVector< Item >& GetItems() const { return items; }
+
+        /// \return Pass that the item was added to.
+        static Pass GetPass( const Item& item ) { return (item.key >> 63) != 0 ? Pass::Transparent : Pass::Opaque; }
+
+        /// Sorts items by key in ascending order. Items with equal keys keep their order.
+        /// \param items Items.
+        /// \param scratch Temporary storage. Resized to items' size.
+        static void RadixSort( std::vector< Item >& items, std::vector< Item >& scratch );
+
+        /// Like RadixSort above, but for items in the frame arena.
+        static void RadixSort( FrameVector< Item >& items, FrameVector< Item >& scratch );
+
+      private:
+        template< typename Vector > static void RadixSortItems( Vector& items, Vector& scratch );
+
+        // Maps pointers to small ids.
+        class IdTable
+        {
+          public:
+            void Clear();
+            unsigned GetId( const void* pointer, unsigned maxId );
+
+          private:
+            FrameVector< const void* > keys;
+            FrameVector< unsigned > ids;
+            unsigned count = 0;
+        };
+
+        FrameVector< Item > items;
+        FrameVector< Item > scratch;
+        IdTable shaderIds;
+        IdTable materialIds;
+        IdTable meshIds;
+        float depthScale = 0;
+    };
+}
@@ -3,9 +3,10 @@
 #include "Scene.hpp"
 #include <algorithm>
 #include <chrono>
-#include <locale>
+#include <cstring>
+#include <memory>
 #include <string>
-#include <sstream>
+#include <unordered_map>
 #include <vector>
 #include "AudioSourceComponent.hpp"
 #include "AudioSystem.hpp"
@@ -13,19 +14,26 @@
 #include "DecalRendererComponent.hpp"
 #include "DirectionalLightComponent.hpp"
 #include "FileSystem.hpp"
+#include "FrameArena.hpp"
 #include "Frustum.hpp"
 #include "GameObject.hpp"
 #include "GfxDevice.hpp"
+#include "JobSystem.hpp"
 #include "LightTiler.hpp"
 #include "LineRendererComponent.hpp"
 #include "Matrix.hpp"
 #include "Material.hpp"
 #include "Mesh.hpp"
 #include "MeshRendererComponent.hpp"
+#include "OcclusionCuller.hpp"
 #include "ParticleSystemComponent.hpp"
 #include "PointLightComponent.hpp"
 #include "RenderTexture.hpp"
 #include "Renderer.hpp"
+#include "RenderQueue.hpp"
+#include "SceneFormat.hpp"
+#include "SceneTokenizer.hpp"
+#include "ShadowCache.hpp"
 #include "SpriteRendererComponent.hpp"
 #include "SpotLightComponent.hpp"
 #include "Statistics.hpp"
@@ -70,6 +78,7 @@ namespace GfxDeviceGlobal
 namespace MathUtil
 {
     void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax );
+    void GetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] );
     bool IsNaN( float f );
 }
 
@@ -83,16 +92,184 @@ namespace VRGlobal
     extern int eye;
 }
 
+namespace ae3d
+{
+    // Mesh renderer in a camera view. Matrices, LOD and culling are per view, so views don't overwrite each other's.
+    struct VisibleObject
+    {
+        Matrix44 localToView;
+        Matrix44 localToClip;
+        MeshRendererComponent* meshRenderer = nullptr;
+        const Mesh* lodMesh = nullptr;
+        unsigned lod = 0;
+        unsigned firstMask = 0; // Submesh i is visible if bit i % 32 of subMeshMasks[ firstMask + i / 32 ] is set.
+        bool isCulled = true;
+    };
+
+    // Visible mesh renderers of a camera, a cube map face or a shadow map face. Made for each frame in CullViews, so its arrays are frame scratch.
+    struct VisibleSet
+    {
+        const GameObject* camera = nullptr; // Eye camera for shadow map faces.
+        const GameObject* light = nullptr; // Null if this is not a shadow map face.
+        int cubeMapFace = 0;
+        unsigned layerMask = ~0u;
+        Frustum frustum;
+        FrameVector< unsigned > gameObjects; // Indices into Scene's game objects, sorted by mesh.
+        FrameVector< RenderQueue::Item > meshSortItems; // Scratch for sorting gameObjects.
+        FrameVector< RenderQueue::Item > meshSortScratch;
+
+        // Occlusion culling of camera views.
+        bool isOcclusionCulled = false;
+        Matrix44 worldToClip;
+        Vec3 cameraPosition;
+        float nearDepth = 0;
+        OcclusionCuller* occlusionCuller = nullptr; // One of SceneGlobal::occlusionCullers.
+        FrameVector< std::pair< float, unsigned > > occluders;
+        unsigned occlusionCulledCount = 0;
+        float occlusionCullTimeMS = 0;
+
+        // Record of the view, made once per frame in CullViews and used by all its passes.
+        CameraComponent* cameraComponent = nullptr; // Null for shadow map faces.
+        const CameraComponent* lodCamera = nullptr; // Keeps the view's LODs for hysteresis. The shadow camera for shadow map faces.
+        float lodBias = 1;
+        Matrix44 worldToView;
+        Matrix44 viewToClip;
+        FrameVector< VisibleObject > objects; // Parallel to gameObjects.
+        FrameVector< unsigned > subMeshMasks;
+        float frustumCullTimeMS = 0;
+
+        bool IsSubMeshVisible( const VisibleObject& object, unsigned subMeshIndex ) const
+        {
+            return (subMeshMasks[ object.firstMask + subMeshIndex / 32 ] & (1u << (subMeshIndex % 32))) != 0;
+        }
+    };
+}
+
+namespace
+{
+    // Shadow map or point light cube map face and what was rendered into it.
+    struct ShadowCache
+    {
+        const RenderTexture* shadowMap = nullptr;
+        int cubeMapFace = 0;
+        ShadowCacheState state;
+        RenderTexture* staticShadowMap = nullptr; // Static casters. Only used when there are also dynamic casters.
+        bool isUsed = false; // Caches that are not used in a frame are removed.
+    };
+
+    // Scene bounds without mesh renderers are inverted, so adding bounds to them gives those bounds.
+    const float EmptyBoundsValue = 99999999.0f;
+
+    void AddToBounds( const Vec3& min, const Vec3& max, Vec3& ioMin, Vec3& ioMax )
+    {
+        ioMin.x = min.x < ioMin.x ? min.x : ioMin.x;
+        ioMin.y = min.y < ioMin.y ? min.y : ioMin.y;
+        ioMin.z = min.z < ioMin.z ? min.z : ioMin.z;
+        ioMax.x = max.x > ioMax.x ? max.x : ioMax.x;
+        ioMax.y = max.y > ioMax.y ? max.y : ioMax.y;
+        ioMax.z = max.z > ioMax.z ? max.z : ioMax.z;
+    }
+
+    // Scene bounds come from object bounds, so an object that touches them has a coordinate that is exactly equal.
+    bool IsOnBounds( const Vec3& min, const Vec3& max, const Vec3& boundsMin, const Vec3& boundsMax )
+    {
+        return min.x == boundsMin.x || min.y == boundsMin.y || min.z == boundsMin.z ||
+               max.x == boundsMax.x || max.y == boundsMax.y || max.z == boundsMax.z;
+    }
+
+    // Objects are occluders if their bounding sphere's radius divided by distance is at least this, roughly 6 degrees.
+    const float MinOccluderSize = 0.1f;
+
+    // Limits the CPU time spent rasterizing occluders in each view.
+    const unsigned MaxOccluderTriangles = 16384;
+}
+
 namespace SceneGlobal
 {
     GameObject shadowCamera;
     bool isShadowCameraCreated = false;
     Matrix44 shadowCameraViewMatrix;
     Matrix44 shadowCameraProjectionMatrix;
+    FrameVector< VisibleSet >* visibleSets = nullptr; // Views of the frame. Set only during Render, because they are frame scratch.
+    std::vector< std::unique_ptr< OcclusionCuller > > occlusionCullers; // Used by occlusion culled views in order. Kept between frames because of their depth buffers.
+    std::vector< ShadowCache > shadowCaches;
+    std::vector< std::unique_ptr< RenderTexture > > staticShadowMaps; // Owns static shadow maps. Unused ones are in freeStaticShadowMaps.
+    std::vector< RenderTexture* > freeStaticShadowMaps;
 }
 
 bool someLightCastsShadow = false;
 
+void MakeViewMatrix( const ae3d::TransformComponent& transform, Matrix44& outView )
+{
+    transform.GetWorldRotation().GetMatrix( outView );
+    Matrix44 translation;
+    translation.SetTranslation( -transform.GetWorldPosition() );
+    Matrix44::Multiply( translation, outView, outView );
+}
+
+void MakeFrustum( const ae3d::CameraComponent& camera, float fovDegrees, const Vec3& position, const Matrix44& view, Frustum& outFrustum )
+{
+    if (camera.GetProjectionType() == ae3d::CameraComponent::ProjectionType::Perspective)
+    {
+        outFrustum.SetProjection( fovDegrees, camera.GetAspect(), camera.GetNear(), camera.GetFar() );
+    }
+    else
+    {
+        outFrustum.SetProjection( camera.GetLeft(), camera.GetRight(), camera.GetBottom(), camera.GetTop(), camera.GetNear(), camera.GetFar() );
+    }
+
+    const Vec3 viewDir = Vec3( view.m[ 2 ], view.m[ 6 ], view.m[ 10 ] ).Normalized();
+    outFrustum.Update( position, viewDir );
+}
+
+// Adding components can move other components, so this is called before component pointers are taken.
+void CreateShadowCamera()
+{
+    if (!SceneGlobal::isShadowCameraCreated)
+    {
+        SceneGlobal::shadowCamera.AddComponent< CameraComponent >();
+        SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetClearFlag( ae3d::CameraComponent::ClearFlag::DepthAndColor );
+        SceneGlobal::shadowCamera.AddComponent< TransformComponent >();
+        SceneGlobal::isShadowCameraCreated = true;
+    }
+}
+
+VisibleSet& AddVisibleSet( const GameObject* camera, const GameObject* light, int cubeMapFace )
+{
+    SceneGlobal::visibleSets->push_back( VisibleSet() );
+    VisibleSet& set = SceneGlobal::visibleSets->back();
+    set.camera = camera;
+    set.light = light;
+    set.cubeMapFace = cubeMapFace;
+    return set;
+}
+
+void AddShadowVisibleSet( const GameObject* eyeCamera, const GameObject* light, int cubeMapFace, float lodBias,
+                          const ae3d::CameraComponent& shadowCamera, ae3d::TransformComponent& shadowCameraTransform )
+{
+    VisibleSet& set = AddVisibleSet( eyeCamera, light, cubeMapFace );
+    set.lodCamera = SceneGlobal::shadowCamera.GetComponent< CameraComponent >();
+    set.lodBias = lodBias;
+    set.viewToClip = shadowCamera.GetProjection();
+    shadowCameraTransform.UpdateLocalAndGlobalMatrix();
+    MakeViewMatrix( shadowCameraTransform, set.worldToView );
+    MakeFrustum( shadowCamera, shadowCamera.GetFovDegrees(), shadowCameraTransform.GetWorldPosition(), set.worldToView, set.frustum );
+}
+
+const VisibleSet& FindVisibleSet( const GameObject* camera, const GameObject* light, int cubeMapFace )
+{
+    for (const auto& set : *SceneGlobal::visibleSets)
+    {
+        if (set.camera == camera && set.light == light && set.cubeMapFace == cubeMapFace)
+        {
+            return set;
+        }
+    }
+
+    System::Assert( false, "View was not culled in CullViews" );
+    return SceneGlobal::visibleSets->front();
+}
+
 void SetupCameraForSpotShadowCasting( const Vec3& lightPosition, const Vec3& lightDirection, float coneAngleDegrees, ae3d::CameraComponent& outCamera,
                                      ae3d::TransformComponent& outCameraTransform )
 {
@@ -181,85 +358,404 @@ void SetupCameraForDirectionalShadowCasting( const Vec3& lightDirection, const F
 
 void ae3d::Scene::Add( GameObject* gameObject )
 {
-    for (const auto& go : gameObjects)
+    if (gameObject == nullptr || Contains( gameObject ))
     {
-        if (go == gameObject)
-        {
-            return;
-        }
+        return;
     }
 
-    if (nextFreeGameObject >= gameObjects.size())
+    gameObject->sceneIndex = static_cast< unsigned >( gameObjects.size() );
+    gameObjects.push_back( gameObject );
+    bvhEntries.push_back( BVHEntry() );
+}
+
+void ae3d::Scene::AddRange( GameObject* const* aGameObjects, unsigned count )
+{
+    gameObjects.reserve( gameObjects.size() + count );
+    bvhEntries.reserve( bvhEntries.size() + count );
+
+    for (unsigned i = 0; i < count; ++i)
     {
-        gameObjects.resize( gameObjects.size() + 10 );
+        Add( aGameObjects[ i ] );
     }
+}
 
-    gameObjects[ nextFreeGameObject++ ] = gameObject;
+bool ae3d::Scene::Contains( const GameObject* gameObject ) const
+{
+    // A copy or a game object in another scene can have the same index, so the slot is checked too.
+    return gameObject != nullptr && gameObject->sceneIndex < gameObjects.size() && gameObjects[ gameObject->sceneIndex ] == gameObject;
 }
 
 void ae3d::Scene::Remove( GameObject* gameObject )
 {
-    for (std::size_t i = 0; i < gameObjects.size(); ++i)
+    if (Contains( gameObject ))
+    {
+        RemoveAt( gameObject->sceneIndex );
+        CompactGameObjects();
+    }
+}
+
+void ae3d::Scene::RemoveRange( GameObject* const* aGameObjects, unsigned count )
+{
+    for (unsigned i = 0; i < count; ++i)
     {
-        if (gameObject == gameObjects[ i ])
+        if (Contains( aGameObjects[ i ] ))
         {
-            gameObjects.erase( std::begin( gameObjects ) + i );
-            return;
+            RemoveAt( aGameObjects[ i ]->sceneIndex );
         }
     }
+
+    CompactGameObjects();
 }
 
-void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >& cameras )
+void ae3d::Scene::RemoveAt( unsigned index )
 {
-    Statistics::BeginDepthNormalsProfiling();
+    if (bvhEntries[ index ].proxy != AABBTree::NullNode)
+    {
+        isAABBDirty = isAABBDirty || IsOnBounds( bvhEntries[ index ].aabbMinWorld, bvhEntries[ index ].aabbMaxWorld, aabbMin, aabbMax );
+        bvh.Remove( bvhEntries[ index ].proxy );
+    }
 
-    for (auto camera : cameras)
+    gameObjects[ index ]->sceneIndex = GameObject::InvalidComponentIndex;
+    gameObjects[ index ] = nullptr;
+    bvhEntries[ index ] = BVHEntry();
+    ++removedGameObjectCount;
+}
+
+void ae3d::Scene::CompactGameObjects()
+{
+    if (removedGameObjectCount * 2 <= gameObjects.size())
     {
-        CameraComponent* cameraComponent = camera->GetComponent< CameraComponent >();
+        return;
+    }
 
-        if (cameraComponent->GetDepthNormalsTexture().GetID() != 0)
+    unsigned count = 0;
+
+    for (std::size_t i = 0; i < gameObjects.size(); ++i)
+    {
+        if (gameObjects[ i ] == nullptr)
         {
-            std::vector< unsigned > gameObjectsWithMeshRenderer;
-            gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-            int i = -1;
+            continue;
+        }
 
-            for (auto gameObject : gameObjects)
-            {
-                ++i;
+        if (i != count)
+        {
+            gameObjects[ count ] = gameObjects[ i ];
+            bvhEntries[ count ] = bvhEntries[ i ];
+            gameObjects[ count ]->sceneIndex = count;
 
-                if (gameObject == nullptr || (gameObject->GetLayer() & cameraComponent->GetLayerMask()) == 0 || !gameObject->IsEnabled())
-                {
-                    continue;
-                }
+            if (bvhEntries[ count ].proxy != AABBTree::NullNode)
+            {
+                bvh.SetUserData( bvhEntries[ count ].proxy, count );
+            }
+        }
 
-                auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+        ++count;
+    }
 
-                if (meshRenderer)
-                {
-                    gameObjectsWithMeshRenderer.push_back( i );
-                }
-            }
+    gameObjects.resize( count );
+    bvhEntries.resize( count );
+    removedGameObjectCount = 0;
+}
 
-            Frustum frustum;
+void ae3d::Scene::UpdateBVH()
+{
+    for (std::size_t i = 0; i < gameObjects.size(); ++i)
+    {
+        GameObject* gameObject = gameObjects[ i ];
+        BVHEntry& entry = bvhEntries[ i ];
+        MeshRendererComponent* meshRenderer = gameObject ? gameObject->GetComponent< MeshRendererComponent >() : nullptr;
+        Mesh* mesh = meshRenderer ? meshRenderer->GetMesh() : nullptr;
 
-            if (cameraComponent->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
-            {
-                frustum.SetProjection( cameraComponent->GetFovDegrees(), cameraComponent->GetAspect(), cameraComponent->GetNear(), cameraComponent->GetFar() );
-            }
-            else
+        if (mesh == nullptr)
+        {
+            if (entry.proxy != AABBTree::NullNode)
             {
-                frustum.SetProjection( cameraComponent->GetLeft(), cameraComponent->GetRight(), cameraComponent->GetBottom(),
-                                       cameraComponent->GetTop(), cameraComponent->GetNear(), cameraComponent->GetFar() );
+                isAABBDirty = isAABBDirty || IsOnBounds( entry.aabbMinWorld, entry.aabbMaxWorld, aabbMin, aabbMax );
+                bvh.Remove( entry.proxy );
+                entry.proxy = AABBTree::NullNode;
             }
 
-            auto cameraTransform = camera->GetComponent< TransformComponent >();
-            // TODO: world position
-            Vec3 position = cameraTransform ? cameraTransform->GetLocalPosition() : Vec3( 0, 0, 0 );
-            const Matrix44& view = cameraComponent->GetView();
-            const Vec3 viewDir = Vec3( view.m[ 2 ], view.m[ 6 ], view.m[ 10 ] ).Normalized();
-            frustum.Update( position, viewDir );
+            continue;
+        }
+
+        TransformComponent* transform = gameObject->GetComponent< TransformComponent >();
+        const unsigned transformVersion = transform ? transform->version : 0;
+
+        if (entry.proxy != AABBTree::NullNode && entry.transformVersion == transformVersion &&
+            entry.localAabbMin.IsAlmost( mesh->GetAABBMin() ) && entry.localAabbMax.IsAlmost( mesh->GetAABBMax() ))
+        {
+            continue;
+        }
+
+        Vec3 aabbWorld[ 8 ];
+        MathUtil::GetCorners( mesh->GetAABBMin(), mesh->GetAABBMax(), aabbWorld );
+
+        const Matrix44& localToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+
+        for (int v = 0; v < 8; ++v)
+        {
+            Matrix44::TransformPoint( aabbWorld[ v ], localToWorld, &aabbWorld[ v ] );
+        }
+
+        Vec3 aabbMinWorld, aabbMaxWorld;
+        MathUtil::GetMinMax( aabbWorld, 8, aabbMinWorld, aabbMaxWorld );
+
+        if (entry.proxy == AABBTree::NullNode)
+        {
+            entry.proxy = bvh.Insert( aabbMinWorld, aabbMaxWorld, static_cast< unsigned >( i ) );
+        }
+        else
+        {
+            isAABBDirty = isAABBDirty || IsOnBounds( entry.aabbMinWorld, entry.aabbMaxWorld, aabbMin, aabbMax );
+            bvh.Move( entry.proxy, aabbMinWorld, aabbMaxWorld );
+        }
+
+        // Growing is exact, shrinking needs UpdateAABB to go through all bounds.
+        AddToBounds( aabbMinWorld, aabbMaxWorld, aabbMin, aabbMax );
+
+        entry.localAabbMin = mesh->GetAABBMin();
+        entry.localAabbMax = mesh->GetAABBMax();
+        entry.aabbMinWorld = aabbMinWorld;
+        entry.aabbMaxWorld = aabbMaxWorld;
+        entry.transformVersion = transformVersion;
+    }
+}
+
+void ae3d::Scene::UpdateAABB()
+{
+    if (!isAABBDirty)
+    {
+        return;
+    }
+
+    aabbMin = Vec3( EmptyBoundsValue, EmptyBoundsValue, EmptyBoundsValue );
+    aabbMax = Vec3( -EmptyBoundsValue, -EmptyBoundsValue, -EmptyBoundsValue );
+
+    for (const auto& entry : bvhEntries)
+    {
+        if (entry.proxy != AABBTree::NullNode)
+        {
+            AddToBounds( entry.aabbMinWorld, entry.aabbMaxWorld, aabbMin, aabbMax );
+        }
+    }
+
+    isAABBDirty = false;
+}
+
+void ae3d::Scene::UpdateSpatialIndex()
+{
+    TransformComponent::UpdateLocalMatrices();
+    Statistics::BeginSceneAABB();
+    UpdateBVH();
+    UpdateAABB();
+    Statistics::EndSceneAABB();
+}
+
+bool ae3d::Scene::IsQueryable( unsigned index, unsigned layerMask ) const
+{
+    const GameObject* gameObject = gameObjects[ index ];
+    return gameObject->IsEnabled() && (gameObject->GetLayer() & layerMask) != 0;
+}
+
+bool ae3d::Scene::Raycast( const Vec3& origin, const Vec3& direction, float maxDistance, unsigned layerMask, RaycastHit& outHit ) const
+{
+    const float length = direction.Length();
+
+    if (length == 0)
+    {
+        return false;
+    }
+
+    const Vec3 unitDirection = direction / length;
+    std::vector< unsigned > candidates;
+    bvh.QueryRay( origin, unitDirection, maxDistance, candidates );
+
+    bool isHit = false;
+
+    for (auto index : candidates)
+    {
+        if (!IsQueryable( index, layerMask ))
+        {
+            continue;
+        }
+
+        // Ray is transformed into the mesh's local space. Distances along the transformed direction are the same as in world space.
+        TransformComponent* transform = gameObjects[ index ]->GetComponent< TransformComponent >();
+        Matrix44 worldToLocal;
+        Matrix44::Invert( transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity, worldToLocal );
+        Vec3 localOrigin, localDirection;
+        Matrix44::TransformPoint( origin, worldToLocal, &localOrigin );
+        Matrix44::TransformDirection( unitDirection, worldToLocal, &localDirection );
+
+        Mesh::RaycastHit meshHit;
+
+        if (gameObjects[ index ]->GetComponent< MeshRendererComponent >()->GetMesh()->Raycast( localOrigin, localDirection, maxDistance, meshHit ))
+        {
+            maxDistance = meshHit.distance;
+            outHit.gameObject = gameObjects[ index ];
+            outHit.distance = meshHit.distance;
+            outHit.subMeshIndex = meshHit.subMeshIndex;
+            outHit.triangleIndex = meshHit.triangleIndex;
+            isHit = true;
+        }
+    }
+
+    return isHit;
+}
+
+void ae3d::Scene::OverlapSphere( const Vec3& center, float radius, unsigned layerMask, std::vector< GameObject* >& outGameObjects ) const
+{
+    outGameObjects.clear();
+    std::vector< unsigned > candidates;
+    bvh.QuerySphere( center, radius, candidates );
+
+    for (auto index : candidates)
+    {
+        const Vec3 closest = Vec3::Min2( Vec3::Max2( center, bvhEntries[ index ].aabbMinWorld ), bvhEntries[ index ].aabbMaxWorld );
+
+        if (IsQueryable( index, layerMask ) && (closest - center).Length() <= radius)
+        {
+            outGameObjects.push_back( gameObjects[ index ] );
+        }
+    }
+}
+
+void ae3d::Scene::OverlapBox( const Vec3& boxMin, const Vec3& boxMax, unsigned layerMask, std::vector< GameObject* >& outGameObjects ) const
+{
+    outGameObjects.clear();
+    std::vector< unsigned > candidates;
+    bvh.Query( boxMin, boxMax, candidates );
+
+    for (auto index : candidates)
+    {
+        const BVHEntry& entry = bvhEntries[ index ];
+
+        if (IsQueryable( index, layerMask ) &&
+            entry.aabbMinWorld.x <= boxMax.x && entry.aabbMaxWorld.x >= boxMin.x &&
+            entry.aabbMinWorld.y <= boxMax.y && entry.aabbMaxWorld.y >= boxMin.y &&
+            entry.aabbMinWorld.z <= boxMax.z && entry.aabbMaxWorld.z >= boxMin.z)
+        {
+            outGameObjects.push_back( gameObjects[ index ] );
+        }
+    }
+}
+
+void ae3d::Scene::FindNearest( const Vec3& point, unsigned count, float maxDistance, unsigned layerMask, std::vector< GameObject* >& outGameObjects ) const
+{
+    std::vector< std::pair< float, unsigned > > nearest;
+    bvh.QueryNearest( point, count, maxDistance, [ & ]( unsigned index )
+    {
+        const Vec3 closest = Vec3::Min2( Vec3::Max2( point, bvhEntries[ index ].aabbMinWorld ), bvhEntries[ index ].aabbMaxWorld );
+        return IsQueryable( index, layerMask ) ? (closest - point).Length() : -1.0f;
+    }, nearest );
+
+    outGameObjects.clear();
+
+    for (const auto& leaf : nearest)
+    {
+        outGameObjects.push_back( gameObjects[ leaf.second ] );
+    }
+}
+
+void ae3d::Scene::GetVisibleMeshRenderers( const Frustum& frustum, unsigned layerMask, bool shadowCastersOnly, FrameVector< unsigned >& outGameObjects ) const
+{
+    outGameObjects.clear();
+    bvh.Query( frustum, outGameObjects );
+
+    std::size_t visibleCount = 0;
+
+    for (auto index : outGameObjects)
+    {
+        GameObject* gameObject = gameObjects[ index ];
+
+        if ((gameObject->GetLayer() & layerMask) == 0 || !gameObject->IsEnabled())
+        {
+            continue;
+        }
+
+        if (shadowCastersOnly && !gameObject->GetComponent< MeshRendererComponent >()->CastsShadow())
+        {
+            continue;
+        }
+
+        outGameObjects[ visibleCount++ ] = index;
+    }
+
+    outGameObjects.resize( visibleCount );
+}
+
+unsigned ae3d::Scene::CullOccluded( const Matrix44& worldToClip, const Vec3& cameraPosition, float nearDepth, OcclusionCuller& culler,
+                                    FrameVector< std::pair< float, unsigned > >& occluders, FrameVector< unsigned >& inOutGameObjects ) const
+{
+    occluders.clear();
+
+    for (auto index : inOutGameObjects)
+    {
+        if (!gameObjects[ index ]->GetComponent< MeshRendererComponent >()->IsOccluder())
+        {
+            continue;
+        }
+
+        const BVHEntry& entry = bvhEntries[ index ];
+        const Vec3 center = (entry.aabbMinWorld + entry.aabbMaxWorld) * 0.5f;
+        const float radius = (entry.aabbMaxWorld - entry.aabbMinWorld).Length() * 0.5f;
+        const float size = radius / std::max( (center - cameraPosition).Length(), nearDepth );
+
+        if (size >= MinOccluderSize)
+        {
+            occluders.push_back( std::make_pair( size, index ) );
+        }
+    }
+
+    if (occluders.empty())
+    {
+        return 0;
+    }
+
+    // Largest first, so they get the triangle budget.
+    std::sort( std::begin( occluders ), std::end( occluders ), []( const std::pair< float, unsigned >& a, const std::pair< float, unsigned >& b ) { return a.first > b.first; } );
+
+    culler.Begin( worldToClip, nearDepth );
+    unsigned triangleBudget = MaxOccluderTriangles;
+
+    for (const auto& occluder : occluders)
+    {
+        TransformComponent* transform = gameObjects[ occluder.second ]->GetComponent< TransformComponent >();
+        const Matrix44& localToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        triangleBudget -= gameObjects[ occluder.second ]->GetComponent< MeshRendererComponent >()->RasterizeOccluder( culler, localToWorld, triangleBudget );
+    }
+
+    culler.EndOccluders();
+
+    std::size_t visibleCount = 0;
+
+    for (auto index : inOutGameObjects)
+    {
+        if (culler.IsVisible( bvhEntries[ index ].aabbMinWorld, bvhEntries[ index ].aabbMaxWorld ))
+        {
+            inOutGameObjects[ visibleCount++ ] = index;
+        }
+    }
+
+    const unsigned culledCount = static_cast< unsigned >( inOutGameObjects.size() - visibleCount );
+    inOutGameObjects.resize( visibleCount );
+    return culledCount;
+}
+
+void ae3d::Scene::RenderDepthAndNormalsForAllCameras( const FrameVector< GameObject* >& cameras )
+{
+    Statistics::BeginDepthNormalsProfiling();
+
+    for (auto camera : cameras)
+    {
+        CameraComponent* cameraComponent = camera->GetComponent< CameraComponent >();
+
+        if (cameraComponent->GetDepthNormalsTexture().GetID() != 0)
+        {
+            const VisibleSet& visibleSet = FindVisibleSet( camera, nullptr, 0 );
+            const Matrix44& view = visibleSet.worldToView;
 
-            RenderDepthAndNormals( cameraComponent, view, gameObjectsWithMeshRenderer, 0, frustum );
+            RenderDepthAndNormals( cameraComponent, visibleSet, 0 );
 
             GfxDeviceGlobal::lightTiler.ClearLightCount();
 
@@ -330,7 +826,7 @@ void ae3d::Scene::SetAmbient( const Vec3& color )
     ambientColor = color;
 }
 
-void ae3d::Scene::RenderRTCameras( std::vector< GameObject* >& rtCameras )
+void ae3d::Scene::RenderRTCameras( const FrameVector< GameObject* >& rtCameras )
 {
     for (auto rtCamera : rtCameras)
     {
@@ -361,7 +857,8 @@ void ae3d::Scene::RenderRTCameras( std::vector< GameObject* >& rtCameras )
                 }
             }
             
-            RenderWithCamera( rtCamera, 0, rtCamera->GetName() );
+            const VisibleSet& visibleSet = FindVisibleSet( rtCamera, nullptr, 0 );
+            RenderWithCamera( rtCamera, 0, rtCamera->GetName(), visibleSet );
         }
         else if (transform && rtCamera->GetComponent< CameraComponent >()->GetTargetTexture()->IsCube())
         {
@@ -371,14 +868,20 @@ void ae3d::Scene::RenderRTCameras( std::vector< GameObject* >& rtCameras )
             {
                 transform->LookAt( cameraPos, cameraPos + directions[ cubeMapFace ], ups[ cubeMapFace ] );
                 transform->UpdateLocalAndGlobalMatrix();
-                RenderWithCamera( rtCamera, cubeMapFace, "Cube Map RT" );
+                const VisibleSet& visibleSet = FindVisibleSet( rtCamera, nullptr, cubeMapFace );
+                RenderWithCamera( rtCamera, cubeMapFace, "Cube Map RT", visibleSet );
             }
         }
     }
 }
 
-void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
+void ae3d::Scene::RenderShadowMaps( const FrameVector< GameObject* >& cameras )
 {
+    for (auto& cache : SceneGlobal::shadowCaches)
+    {
+        cache.isUsed = false;
+    }
+
     for (auto camera : cameras)
     {
         if (camera == nullptr || !camera->GetComponent<TransformComponent>())
@@ -419,33 +922,14 @@ void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
                 Statistics::BeginShadowMapProfiling();
                 
                 Frustum eyeFrustum;
-                
-                auto cameraComponent = camera->GetComponent< CameraComponent >();
-                
-                if (cameraComponent->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
-                {
-                    eyeFrustum.SetProjection( cameraComponent->GetFovDegrees(), cameraComponent->GetAspect(), cameraComponent->GetNear(), cameraComponent->GetFar() );
-                }
-                else
-                {
-                    eyeFrustum.SetProjection( cameraComponent->GetLeft(), cameraComponent->GetRight(), cameraComponent->GetBottom(), cameraComponent->GetTop(), cameraComponent->GetNear(), cameraComponent->GetFar() );
-                }
-                
                 Matrix44 eyeView;
-                cameraTransform->GetWorldRotation().GetMatrix( eyeView );
-                Matrix44 translation;
-                translation.SetTranslation( -cameraTransform->GetWorldPosition() );
-                Matrix44::Multiply( translation, eyeView, eyeView );
-                
-                const Vec3 eyeViewDir = Vec3( eyeView.m[2], eyeView.m[6], eyeView.m[10] ).Normalized();
-                eyeFrustum.Update( cameraTransform->GetWorldPosition(), eyeViewDir );
+                MakeViewMatrix( *cameraTransform, eyeView );
+                const CameraComponent* cameraComponent = camera->GetComponent< CameraComponent >();
+                MakeFrustum( *cameraComponent, cameraComponent->GetFovDegrees(), cameraTransform->GetWorldPosition(), eyeView, eyeFrustum );
                 
                 if (!SceneGlobal::isShadowCameraCreated)
                 {
-                    SceneGlobal::shadowCamera.AddComponent< CameraComponent >();
-                    SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetClearFlag( ae3d::CameraComponent::ClearFlag::DepthAndColor );
-                    SceneGlobal::shadowCamera.AddComponent< TransformComponent >();
-                    SceneGlobal::isShadowCameraCreated = true;
+                    CreateShadowCamera();
                     // Component adding can invalidate lightTransform pointer.
                     lightTransform = go->GetComponent<TransformComponent>();
                 }
@@ -454,16 +938,18 @@ void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
                 {
                     SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetTargetTexture( &go->GetComponent<DirectionalLightComponent>()->shadowMap );
                     SetupCameraForDirectionalShadowCasting( lightTransform->GetViewDirection(), eyeFrustum, aabbMin, aabbMax, *SceneGlobal::shadowCamera.GetComponent< CameraComponent >(), *SceneGlobal::shadowCamera.GetComponent< TransformComponent >() );
+                    SceneGlobal::shadowCamera.GetComponent< TransformComponent >()->UpdateLocalAndGlobalMatrix();
                     GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Dir;
-                    RenderShadowsWithCamera( &SceneGlobal::shadowCamera, 0 );
+                    RenderCachedShadowMap( camera, go, 0 );
                     Material::SetGlobalRenderTexture( &go->GetComponent<DirectionalLightComponent>()->shadowMap );
                 }
                 else if (spotLight)
                 {
                     SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetTargetTexture( &go->GetComponent<SpotLightComponent>()->shadowMap );
                     SetupCameraForSpotShadowCasting( lightTransform->GetWorldPosition(), lightTransform->GetViewDirection(), go->GetComponent<SpotLightComponent>()->GetConeAngle(), *SceneGlobal::shadowCamera.GetComponent< CameraComponent >(), *SceneGlobal::shadowCamera.GetComponent< TransformComponent >() );
+                    SceneGlobal::shadowCamera.GetComponent< TransformComponent >()->UpdateLocalAndGlobalMatrix();
                     GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Spot;
-                    RenderShadowsWithCamera( &SceneGlobal::shadowCamera, 0 );
+                    RenderCachedShadowMap( camera, go, 0 );
                     Material::SetGlobalRenderTexture( &go->GetComponent<SpotLightComponent>()->shadowMap );
                 }
                 else if (pointLight)
@@ -477,7 +963,7 @@ void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
                         lightTransform->UpdateLocalAndGlobalMatrix();
                         SetupCameraForSpotShadowCasting( lightTransform->GetWorldPosition(), lightTransform->GetViewDirection(), 45, *SceneGlobal::shadowCamera.GetComponent< CameraComponent >(), *SceneGlobal::shadowCamera.GetComponent< TransformComponent >() );
                         SceneGlobal::shadowCamera.GetComponent< TransformComponent >()->UpdateLocalAndGlobalMatrix();
-                        RenderShadowsWithCamera( &SceneGlobal::shadowCamera, cubeMapFace );
+                        RenderCachedShadowMap( camera, go, cubeMapFace );
                     }
                     
                     Material::SetGlobalRenderTexture( &go->GetComponent<PointLightComponent>()->shadowMap );
@@ -487,6 +973,367 @@ void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
             }
         }
     }
+
+    // Removed lights and lights that stopped casting shadows.
+    for (std::size_t i = 0; i < SceneGlobal::shadowCaches.size();)
+    {
+        if (SceneGlobal::shadowCaches[ i ].isUsed)
+        {
+            ++i;
+            continue;
+        }
+
+        if (SceneGlobal::shadowCaches[ i ].staticShadowMap != nullptr)
+        {
+            SceneGlobal::freeStaticShadowMaps.push_back( SceneGlobal::shadowCaches[ i ].staticShadowMap );
+        }
+
+        SceneGlobal::shadowCaches[ i ] = SceneGlobal::shadowCaches.back();
+        SceneGlobal::shadowCaches.pop_back();
+    }
+}
+
+void ae3d::Scene::RenderCachedShadowMap( GameObject* eyeCamera, GameObject* light, int cubeMapFace )
+{
+    const VisibleSet& visibleSet = FindVisibleSet( eyeCamera, light, cubeMapFace );
+
+    if (!isShadowCachingEnabled)
+    {
+        RenderShadowsWithCamera( &SceneGlobal::shadowCamera, cubeMapFace, visibleSet, ShadowCasters::All, nullptr );
+        return;
+    }
+
+    CameraComponent* shadowCamera = SceneGlobal::shadowCamera.GetComponent< CameraComponent >();
+    RenderTexture* shadowMap = shadowCamera->GetTargetTexture();
+
+    Matrix44 view;
+    MakeViewMatrix( *SceneGlobal::shadowCamera.GetComponent< TransformComponent >(), view );
+    Matrix44 worldToClip;
+    Matrix44::Multiply( view, shadowCamera->GetProjection(), worldToClip );
+
+    // Casters are hashed with the state that their shadows depend on, except materials.
+    unsigned staticCasterCount = 0;
+    unsigned dynamicCasterCount = 0;
+    std::uint64_t lodBiasBits = 0;
+    std::memcpy( &lodBiasBits, &shadowLodBias, sizeof( shadowLodBias ) );
+    std::uint64_t staticHash = ShadowCacheState::HashCombine( 0, lodBiasBits );
+    std::uint64_t dynamicHash = staticHash;
+
+    for (auto j : visibleSet.gameObjects)
+    {
+        const TransformComponent* transform = gameObjects[ j ]->GetComponent< TransformComponent >();
+        const MeshRendererComponent* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
+        const bool isStatic = meshRenderer->IsStaticShadowCaster();
+        std::uint64_t& hash = isStatic ? staticHash : dynamicHash;
+
+        hash = ShadowCacheState::HashCombine( hash, reinterpret_cast< std::uintptr_t >( gameObjects[ j ] ) );
+        hash = ShadowCacheState::HashCombine( hash, transform ? transform->version : 0 );
+        hash = ShadowCacheState::HashCombine( hash, reinterpret_cast< std::uintptr_t >( meshRenderer->mesh ) );
+        hash = ShadowCacheState::HashCombine( hash, (static_cast< std::uint64_t >( static_cast< unsigned >( meshRenderer->animFrame ) ) << 2) |
+                                  (meshRenderer->isEnabled ? 1 : 0) | (meshRenderer->isWireframe ? 2 : 0) );
+        ++(isStatic ? staticCasterCount : dynamicCasterCount);
+    }
+
+    ShadowCache* cache = nullptr;
+
+    for (auto& candidate : SceneGlobal::shadowCaches)
+    {
+        if (candidate.shadowMap == shadowMap && candidate.cubeMapFace == cubeMapFace)
+        {
+            cache = &candidate;
+            break;
+        }
+    }
+
+    if (cache == nullptr)
+    {
+        SceneGlobal::shadowCaches.push_back( ShadowCache() );
+        cache = &SceneGlobal::shadowCaches.back();
+        cache->shadowMap = shadowMap;
+        cache->cubeMapFace = cubeMapFace;
+    }
+
+    const int width = shadowMap->GetWidth();
+    const bool hasStaticShadowMap = cache->staticShadowMap != nullptr && cache->staticShadowMap->GetWidth() == width;
+    const ShadowCacheState::Action action = cache->state.Update( width, worldToClip, staticHash, dynamicHash, staticCasterCount > 0, dynamicCasterCount > 0, hasStaticShadowMap );
+    cache->isUsed = true;
+
+    if (action == ShadowCacheState::Action::None)
+    {
+        Statistics::IncCachedShadowMaps();
+        return;
+    }
+
+    if (cache->staticShadowMap != nullptr && (action == ShadowCacheState::Action::AllCasters || !hasStaticShadowMap))
+    {
+        SceneGlobal::freeStaticShadowMaps.push_back( cache->staticShadowMap );
+        cache->staticShadowMap = nullptr;
+    }
+
+    if (action == ShadowCacheState::Action::AllCasters)
+    {
+        RenderShadowsWithCamera( &SceneGlobal::shadowCamera, cubeMapFace, visibleSet, ShadowCasters::All, nullptr );
+        return;
+    }
+
+    if (cache->staticShadowMap == nullptr)
+    {
+        auto freeMap = std::find_if( std::begin( SceneGlobal::freeStaticShadowMaps ), std::end( SceneGlobal::freeStaticShadowMaps ),
+                                     [width]( const RenderTexture* map ) { return map->GetWidth() == width; } );
+
+        if (freeMap != std::end( SceneGlobal::freeStaticShadowMaps ))
+        {
+            cache->staticShadowMap = *freeMap;
+            SceneGlobal::freeStaticShadowMaps.erase( freeMap );
+        }
+        else
+        {
+            SceneGlobal::staticShadowMaps.push_back( std::unique_ptr< RenderTexture >( new RenderTexture() ) );
+            cache->staticShadowMap = SceneGlobal::staticShadowMaps.back().get();
+            cache->staticShadowMap->Create2D( width, shadowMap->GetHeight(), DataType::R32G32, TextureWrap::Clamp, TextureFilter::Linear,
+                                              "static shadow casters", false, RenderTexture::UavFlag::Disabled );
+        }
+    }
+
+    if (action == ShadowCacheState::Action::StaticAndDynamicCasters)
+    {
+        shadowCamera->SetTargetTexture( cache->staticShadowMap );
+        RenderShadowsWithCamera( &SceneGlobal::shadowCamera, 0, visibleSet, ShadowCasters::Static, nullptr );
+        shadowCamera->SetTargetTexture( shadowMap );
+    }
+
+    RenderShadowsWithCamera( &SceneGlobal::shadowCamera, cubeMapFace, visibleSet, ShadowCasters::Dynamic, cache->staticShadowMap );
+}
+
+void ae3d::Scene::InvalidateShadowMaps()
+{
+    for (auto& cache : SceneGlobal::shadowCaches)
+    {
+        cache.state.Invalidate();
+    }
+}
+
+void ae3d::Scene::CullViews( const FrameVector< GameObject* >& rtCameras, const FrameVector< GameObject* >& cameras )
+{
+    FrameVector< VisibleSet >& visibleSets = *SceneGlobal::visibleSets;
+    unsigned occlusionCullerCount = 0;
+
+    if (someLightCastsShadow)
+    {
+        CreateShadowCamera();
+    }
+
+    // Shadow map faces in the same order as RenderShadowMaps.
+    for (auto camera : rtCameras)
+    {
+        const TransformComponent* cameraTransform = camera->GetComponent< TransformComponent >();
+        const CameraComponent* cameraComponent = camera->GetComponent< CameraComponent >();
+
+        if (!someLightCastsShadow || cameraTransform == nullptr || cameraComponent->GetProjectionType() != CameraComponent::ProjectionType::Perspective)
+        {
+            continue;
+        }
+
+        Frustum eyeFrustum;
+        Matrix44 eyeView;
+        MakeViewMatrix( *cameraTransform, eyeView );
+        MakeFrustum( *cameraComponent, cameraComponent->GetFovDegrees(), cameraTransform->GetWorldPosition(), eyeView, eyeFrustum );
+
+        for (auto go : gameObjects)
+        {
+            if (!go || !go->IsEnabled() || !go->GetComponent< TransformComponent >())
+            {
+                continue;
+            }
+
+            const TransformComponent* lightTransform = go->GetComponent< TransformComponent >();
+            auto dirLight = go->GetComponent< DirectionalLightComponent >();
+            auto spotLight = go->GetComponent< SpotLightComponent >();
+            auto pointLight = go->GetComponent< PointLightComponent >();
+
+            if (!((dirLight && dirLight->CastsShadow()) || (spotLight && spotLight->CastsShadow()) || (pointLight && pointLight->CastsShadow())))
+            {
+                continue;
+            }
+
+            // Shadow cameras are set up like in RenderShadowMaps but into temporaries, so the real shadow camera is not touched.
+            CameraComponent shadowCamera;
+            TransformComponent shadowCameraTransform;
+
+            if (dirLight && dirLight->shadowMap.IsCreated())
+            {
+                shadowCamera.SetTargetTexture( &dirLight->shadowMap );
+                SetupCameraForDirectionalShadowCasting( lightTransform->GetViewDirection(), eyeFrustum, aabbMin, aabbMax, shadowCamera, shadowCameraTransform );
+                AddShadowVisibleSet( camera, go, 0, shadowLodBias, shadowCamera, shadowCameraTransform );
+            }
+            else if (spotLight)
+            {
+                SetupCameraForSpotShadowCasting( lightTransform->GetWorldPosition(), lightTransform->GetViewDirection(), spotLight->GetConeAngle(), shadowCamera, shadowCameraTransform );
+                AddShadowVisibleSet( camera, go, 0, shadowLodBias, shadowCamera, shadowCameraTransform );
+            }
+            else if (pointLight)
+            {
+                for (int cubeMapFace = 0; cubeMapFace < 6; ++cubeMapFace)
+                {
+                    TransformComponent faceTransform = *lightTransform;
+                    faceTransform.LookAt( faceTransform.GetLocalPosition(), faceTransform.GetLocalPosition() + directions[ cubeMapFace ], ups[ cubeMapFace ] );
+                    faceTransform.UpdateLocalAndGlobalMatrix();
+                    SetupCameraForSpotShadowCasting( faceTransform.GetWorldPosition(), faceTransform.GetViewDirection(), 45, shadowCamera, shadowCameraTransform );
+                    AddShadowVisibleSet( camera, go, cubeMapFace, shadowLodBias, shadowCamera, shadowCameraTransform );
+                }
+            }
+        }
+    }
+
+    // Camera views. Cube map cameras have a view for each face, oriented like in RenderRTCameras.
+    for (auto cameraList : { &rtCameras, &cameras })
+    {
+        for (auto camera : *cameraList)
+        {
+            const TransformComponent* cameraTransform = camera->GetComponent< TransformComponent >();
+            CameraComponent* cameraComponent = camera->GetComponent< CameraComponent >();
+            const bool isCube = cameraComponent->GetTargetTexture() && cameraComponent->GetTargetTexture()->IsCube();
+
+            for (int cubeMapFace = 0; cubeMapFace < (isCube ? 6 : 1); ++cubeMapFace)
+            {
+                VisibleSet& set = AddVisibleSet( camera, nullptr, cubeMapFace );
+                set.layerMask = cameraComponent->GetLayerMask();
+                set.cameraComponent = cameraComponent;
+                set.lodCamera = cameraComponent;
+                set.lodBias = lodBias;
+                set.viewToClip = cameraComponent->GetProjection();
+
+                TransformComponent faceTransform = *cameraTransform;
+
+                if (isCube)
+                {
+                    const Vec3 cameraPos = faceTransform.GetLocalPosition();
+                    faceTransform.LookAt( cameraPos, cameraPos + directions[ cubeMapFace ], ups[ cubeMapFace ] );
+                    faceTransform.UpdateLocalAndGlobalMatrix();
+                }
+
+                Matrix44 view;
+#if defined( AE3D_OPENVR )
+                view = faceTransform.GetVrView();
+                MakeFrustum( *cameraComponent, GetVRFov(), Global::vrEyePosition, view, set.frustum );
+#else
+                MakeViewMatrix( faceTransform, view );
+                MakeFrustum( *cameraComponent, cameraComponent->GetFovDegrees(), faceTransform.GetWorldPosition(), view, set.frustum );
+
+                // Cube map faces' projection is not the camera's.
+                if (!isCube)
+                {
+                    // Planes from the projection match what is rendered, also for off-center and orthographic cameras.
+                    Matrix44::Multiply( view, cameraComponent->GetProjection(), set.worldToClip );
+                    set.frustum.SetFromViewProjection( set.worldToClip );
+                }
+
+                if (isOcclusionCullingEnabled && !isCube && cameraComponent->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
+                {
+                    if (occlusionCullerCount == SceneGlobal::occlusionCullers.size())
+                    {
+                        SceneGlobal::occlusionCullers.emplace_back( new OcclusionCuller() );
+                    }
+
+                    set.occlusionCuller = SceneGlobal::occlusionCullers[ occlusionCullerCount++ ].get();
+                    set.isOcclusionCulled = true;
+                    set.cameraPosition = faceTransform.GetWorldPosition();
+                    set.nearDepth = cameraComponent->GetNear();
+                }
+#endif
+                set.worldToView = view;
+            }
+        }
+    }
+
+    JobSystem::ParallelFor( static_cast< unsigned >( visibleSets.size() ), 1, [&]( unsigned first, unsigned last )
+    {
+        for (unsigned i = first; i < last; ++i)
+        {
+            VisibleSet& set = visibleSets[ i ];
+            GetVisibleMeshRenderers( set.frustum, set.layerMask, set.light != nullptr, set.gameObjects );
+
+            if (set.isOcclusionCulled)
+            {
+                const auto startTime = std::chrono::steady_clock::now();
+                set.occlusionCulledCount = CullOccluded( set.worldToClip, set.cameraPosition, set.nearDepth, *set.occlusionCuller, set.occluders, set.gameObjects );
+                set.occlusionCullTimeMS = static_cast< float >( std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count() );
+            }
+
+            // Mesh pointers are looked up once, not in every comparison.
+            set.meshSortItems.resize( set.gameObjects.size() );
+
+            for (std::size_t g = 0; g < set.gameObjects.size(); ++g)
+            {
+                set.meshSortItems[ g ].key = reinterpret_cast< std::uintptr_t >( gameObjects[ set.gameObjects[ g ] ]->GetComponent< MeshRendererComponent >()->GetMesh() );
+                set.meshSortItems[ g ].object = set.gameObjects[ g ];
+            }
+
+            RenderQueue::RadixSort( set.meshSortItems, set.meshSortScratch );
+
+            for (std::size_t g = 0; g < set.gameObjects.size(); ++g)
+            {
+                set.gameObjects[ g ] = set.meshSortItems[ g ].object;
+            }
+
+            set.objects.resize( set.gameObjects.size() );
+
+            for (std::size_t g = 0; g < set.gameObjects.size(); ++g)
+            {
+                GameObject* gameObject = gameObjects[ set.gameObjects[ g ] ];
+                TransformComponent* transform = gameObject->GetComponent< TransformComponent >();
+                VisibleObject& object = set.objects[ g ];
+                Matrix44::Multiply( transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity, set.worldToView, object.localToView );
+                Matrix44::Multiply( object.localToView, set.viewToClip, object.localToClip );
+                object.meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+            }
+        }
+    } );
+
+    // LODs keep per-camera state for hysteresis in the mesh renderers, so they are selected here instead of in the jobs.
+    for (auto& set : visibleSets)
+    {
+        unsigned maskCount = 0;
+
+        for (auto& object : set.objects)
+        {
+            object.meshRenderer->SelectLod( object.localToView, set.viewToClip, set.lodBias, set.lodCamera );
+            object.lod = object.meshRenderer->GetCurrentLod();
+            object.lodMesh = object.meshRenderer->lodMesh;
+            object.firstMask = maskCount;
+            maskCount += object.lodMesh ? (object.lodMesh->GetSubMeshCount() + 31) / 32 : 0;
+        }
+
+        set.subMeshMasks.resize( maskCount );
+    }
+
+    JobSystem::ParallelFor( static_cast< unsigned >( visibleSets.size() ), 1, [&]( unsigned first, unsigned last )
+    {
+        for (unsigned i = first; i < last; ++i)
+        {
+            VisibleSet& set = visibleSets[ i ];
+            const auto startTime = std::chrono::steady_clock::now();
+
+            for (std::size_t g = 0; g < set.objects.size(); ++g)
+            {
+                VisibleObject& object = set.objects[ g ];
+                TransformComponent* transform = gameObjects[ set.gameObjects[ g ] ]->GetComponent< TransformComponent >();
+                const Matrix44& localToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+                object.isCulled = !object.meshRenderer->IsEnabled() || object.lodMesh == nullptr ||
+                                  !object.meshRenderer->CullSubMeshes( object.lodMesh, set.frustum, localToWorld, set.subMeshMasks.data() + object.firstMask );
+            }
+
+            set.frustumCullTimeMS = static_cast< float >( std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count() );
+        }
+    } );
+
+    // Statistics are not thread-safe, so they are updated after the jobs.
+    for (const auto& set : visibleSets)
+    {
+        Statistics::IncOcclusionCulledCount( static_cast< int >( set.occlusionCulledCount ) );
+        Statistics::IncOcclusionCullTime( set.occlusionCullTimeMS );
+        Statistics::IncFrustumCullTime( set.frustumCullTimeMS );
+    }
 }
 
 void BubbleSort( GameObject** gos, int count )
@@ -511,22 +1358,20 @@ void ae3d::Scene::Render()
 #if RENDERER_VULKAN && !AE3D_OPENVR
     GfxDevice::BeginFrame();
 #endif
-    GenerateAABB();
 #if RENDERER_D3D12
     GfxDevice::ResetCommandList();
 #endif
     Statistics::ResetFrameStatistics();
-    TransformComponent::UpdateLocalMatrices();
+    UpdateSpatialIndex();
 
     GfxDeviceGlobal::perObjectUboStruct.particleCount = 1000;//65535 * 2;
     GfxDeviceGlobal::perObjectUboStruct.timeStamp = System::SecondsSinceStartup();
     //printf("time: %f\n", GfxDeviceGlobal::perObjectUboStruct.timeStamp );
 
-    std::vector< GameObject* > rtCameras;
-    rtCameras.reserve( gameObjects.size() / 4 );
-    std::vector< GameObject* > cameras;
-    cameras.reserve( gameObjects.size() / 4 );
-    
+    // Render-loop scratch is in the frame arena, so frames don't allocate from the heap.
+    FrameVector< GameObject* > rtCameras;
+    FrameVector< GameObject* > cameras;
+
     for (auto gameObject : gameObjects)
     {
         if (gameObject == nullptr || !gameObject->IsEnabled())
@@ -555,6 +1400,10 @@ void ae3d::Scene::Render()
 
     BubbleSort( cameras.data(), (int)cameras.size() );
     BubbleSort( rtCameras.data(), (int)rtCameras.size() );
+
+    FrameVector< VisibleSet > visibleSets;
+    SceneGlobal::visibleSets = &visibleSets;
+    CullViews( rtCameras, cameras );
     
     if (someLightCastsShadow)
     {
@@ -581,13 +1430,15 @@ void ae3d::Scene::Render()
         AudioSystem::SetListenerPosition( cameraPos.x, cameraPos.y, cameraPos.z );
         AudioSystem::SetListenerOrientation( cameraDir.x, cameraDir.y, cameraDir.z );
 
-        RenderWithCamera( camera, 0, "Primary Pass" );
+        const VisibleSet& visibleSet = FindVisibleSet( camera, nullptr, 0 );
+        RenderWithCamera( camera, 0, "Primary Pass", visibleSet );
     }
     
     GfxDevice::SetRenderTarget( nullptr, 0 );
 #if RENDERER_D3D12
     GfxDevice::ClearScreen( GfxDevice::ClearFlags::Depth );
 #endif
+    SceneGlobal::visibleSets = nullptr;
 }
 
 void ae3d::Scene::EndFrame()
@@ -599,9 +1450,10 @@ void ae3d::Scene::EndFrame()
     GfxDevice::EndBackBufferEncoding();
     Statistics::EndFrameTimeProfiling();
 #endif
+    FrameArena::Reset();
 }
 
-void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const char* debugGroupName )
+void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const char* debugGroupName, const VisibleSet& visibleSet )
 {
     ae3d::System::Assert( 0 <= cubeMapFace && cubeMapFace < 6, "invalid cube map face" );
 
@@ -667,43 +1519,11 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
         renderer.RenderSkybox( skybox, *camera );
     }
     
-    float fovDegrees;
-    Vec3 position;
-
     // TODO: Maybe add a VR flag into camera to select between HMD and normal pose.
-#if defined( AE3D_OPENVR )
-    view = cameraGo->GetComponent< TransformComponent >()->GetVrView();
-    position = Global::vrEyePosition;
-    fovDegrees = GetVRFov();
-#else
-    auto cameraTransform = cameraGo->GetComponent< TransformComponent >();
-    position = cameraTransform->GetWorldPosition();
-    fovDegrees = camera->GetFovDegrees();
-    cameraTransform->GetWorldRotation().GetMatrix( view );
-    Matrix44 translation;
-    translation.SetTranslation( -cameraTransform->GetWorldPosition() );
-    Matrix44::Multiply( translation, view, view );
-    camera->SetView( view );
+#if !defined( AE3D_OPENVR )
+    camera->SetView( visibleSet.worldToView );
 #endif
-    
-    Frustum frustum;
-    
-    if (camera->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
-    {
-        frustum.SetProjection( fovDegrees, camera->GetAspect(), camera->GetNear(), camera->GetFar() );
-    }
-    else
-    {
-        frustum.SetProjection( camera->GetLeft(), camera->GetRight(), camera->GetBottom(), camera->GetTop(), camera->GetNear(), camera->GetFar() );
-    }
-    
-    const Vec3 viewDir = Vec3( view.m[2], view.m[6], view.m[10] ).Normalized();
-    frustum.Update( position, viewDir );
 
-    std::vector< unsigned > gameObjectsWithMeshRenderer;
-    gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-    int gameObjectIndex = -1;
-    
     GfxDeviceGlobal::perObjectUboStruct.lightColor = Vec4( 0, 0, 0, 1 );
     GfxDeviceGlobal::perObjectUboStruct.minAmbient = ambientColor.x;
     GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Empty;
@@ -711,8 +1531,6 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     
     for (auto gameObject : gameObjects)
     {
-        ++gameObjectIndex;
-        
         if (gameObject == nullptr || (gameObject->GetLayer() & camera->GetLayerMask()) == 0 || !gameObject->IsEnabled())
         {
             continue;
@@ -780,53 +1598,88 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
             Window::GetSize( width, height );
             System::DrawLines( lineRenderer->lineHandle, camera->GetView(), camera->GetProjection(), (int)(width * screenScale), (int)(height * screenScale) );
         }
-        
-        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+    }
 
-        if (meshRenderer)
+    const FrameVector< VisibleObject >& objects = visibleSet.objects;
+    RenderQueue renderQueue;
+    renderQueue.Clear( camera->GetFar() );
+
+    for (unsigned i = 0; i < objects.size(); ++i)
+    {
+        const VisibleObject& object = objects[ i ];
+
+        if (!object.isCulled)
         {
-            gameObjectsWithMeshRenderer.push_back( gameObjectIndex );
+            MeshRendererComponent* meshRenderer = object.meshRenderer;
+            meshRenderer->UseLod( object.lod );
+            const Mesh* mesh = object.lodMesh;
+            const float* m = object.localToView.m;
+
+            for (unsigned subMeshIndex = 0; subMeshIndex < mesh->GetSubMeshCount(); ++subMeshIndex)
+            {
+                if (!visibleSet.IsSubMeshVisible( object, subMeshIndex ))
+                {
+                    continue;
+                }
+
+                // The camera looks towards -z in view space.
+                const Vec3 center = (mesh->GetSubMeshAABBMin( subMeshIndex ) + mesh->GetSubMeshAABBMax( subMeshIndex )) * 0.5f;
+                const float viewDepth = -(center.x * m[ 2 ] + center.y * m[ 6 ] + center.z * m[ 10 ] + m[ 14 ]);
+                Material* material = meshRenderer->materials[ subMeshIndex ];
+                const RenderQueue::Pass pass = material->GetBlendingMode() == Material::BlendingMode::Off ? RenderQueue::Pass::Opaque : RenderQueue::Pass::Transparent;
+                renderQueue.Add( pass, material->GetShader(), material, mesh, viewDepth, i, subMeshIndex );
+            }
         }
     }
 
-    auto meshSorterByMesh = [&](unsigned j, unsigned k)
-    {
-        return gameObjects[ j ]->GetComponent< MeshRendererComponent >()->GetMesh() <
-               gameObjects[ k ]->GetComponent< MeshRendererComponent >()->GetMesh();
-    };
+    renderQueue.Sort();
+    const FrameVector< RenderQueue::Item >& items = renderQueue.GetItems();
 
-    std::sort( std::begin( gameObjectsWithMeshRenderer ), std::end( gameObjectsWithMeshRenderer ), meshSorterByMesh );
-    
-    Array< Matrix44 > localToViews( (int)gameObjectsWithMeshRenderer.size() );
-    Array< Matrix44 > localToClips( (int)gameObjectsWithMeshRenderer.size() );
-    
-    int i = 0;
-    
-    for (auto j : gameObjectsWithMeshRenderer)
+    for (std::size_t itemIndex = 0; itemIndex < items.size(); ++itemIndex)
     {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        const RenderQueue::Item& item = items[ itemIndex ];
+#if RENDERER_VULKAN
+        // Sorting puts opaque draws of the same submesh and material next to each other. Runs of them are merged into an instanced draw.
+        MeshRendererComponent* meshRenderer = objects[ item.object ].meshRenderer;
+        const int subMeshIndex = static_cast< int >( item.subMesh );
+        std::size_t runEnd = itemIndex + 1;
 
-        Matrix44::Multiply( meshLocalToWorld, view, localToViews[ i ] );
-        Matrix44::Multiply( localToViews[ i ], camera->GetProjection(), localToClips[ i ] );
+        if (isInstancingEnabled && RenderQueue::GetPass( item ) == RenderQueue::Pass::Opaque && meshRenderer->IsSubMeshInstanceable( subMeshIndex ))
+        {
+            while (runEnd < items.size() && runEnd - itemIndex < GfxDevice::MaxInstancesPerDraw && RenderQueue::GetPass( items[ runEnd ] ) == RenderQueue::Pass::Opaque &&
+                   items[ runEnd ].subMesh == item.subMesh && objects[ items[ runEnd ].object ].lodMesh == objects[ item.object ].lodMesh &&
+                   objects[ items[ runEnd ].object ].meshRenderer->materials[ subMeshIndex ] == meshRenderer->materials[ subMeshIndex ] &&
+                   objects[ items[ runEnd ].object ].meshRenderer->IsSubMeshInstanceable( subMeshIndex ))
+            {
+                ++runEnd;
+            }
+        }
 
-        auto* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
-        meshRenderer->Cull( frustum, meshLocalToWorld );
-        meshRenderer->Render( localToViews[ i ], localToClips[ i ], meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, nullptr, MeshRendererComponent::RenderType::Opaque );
-        
-        ++i;
-    }
+        if (runEnd - itemIndex > 1)
+        {
+            FrameArray< GfxDevice::InstanceData > instances( static_cast< unsigned >( runEnd - itemIndex ) );
 
-    i = 0;
-    
-    for (auto j : gameObjectsWithMeshRenderer)
-    {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
-        
-        gameObjects[ j ]->GetComponent< MeshRendererComponent >()->Render( localToViews[ i ], localToClips[ i ], meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, nullptr, MeshRendererComponent::RenderType::Transparent );
-        
-        ++i;
+            for (std::size_t runIndex = itemIndex; runIndex < runEnd; ++runIndex)
+            {
+                auto transform = gameObjects[ visibleSet.gameObjects[ items[ runIndex ].object ] ]->GetComponent< TransformComponent >();
+                GfxDevice::InstanceData& instance = instances[ static_cast< unsigned >( runIndex - itemIndex ) ];
+                instance.localToClip = objects[ items[ runIndex ].object ].localToClip;
+                instance.localToView = objects[ items[ runIndex ].object ].localToView;
+                instance.localToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+            }
+
+            meshRenderer->RenderSubMeshInstances( subMeshIndex, instances.elements, instances.count,
+                                                  SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix );
+            itemIndex = runEnd - 1;
+            continue;
+        }
+#endif
+        auto transform = gameObjects[ visibleSet.gameObjects[ item.object ] ]->GetComponent< TransformComponent >();
+        const Matrix44& meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        const VisibleObject& object = objects[ item.object ];
+
+        object.meshRenderer->RenderSubMesh( static_cast< int >( item.subMesh ), object.localToView, object.localToClip, meshLocalToWorld,
+                                                     SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, nullptr );
     }
 
     GfxDevice::PopGroupMarker();
@@ -869,8 +1722,7 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     }
 }
 
-void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44& worldToView, std::vector< unsigned > gameObjectsWithMeshRenderer,
-                                         int cubeMapFace, const Frustum& frustum )
+void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const VisibleSet& visibleSet, int cubeMapFace )
 {
 #if RENDERER_METAL
     GfxDevice::SetViewport( camera->GetViewport() );
@@ -889,22 +1741,33 @@ void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44
 
     GfxDeviceGlobal::perObjectUboStruct.cameraParams = Vec4( camera->GetFovDegrees() * 3.14159265f / 180.0f, camera->GetAspect(), camera->GetNear(), camera->GetFar() );
 
-    for (auto j : gameObjectsWithMeshRenderer)
-    {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
-        
-        Matrix44 localToView;
-        Matrix44 localToClip;
-        Matrix44::Multiply( meshLocalToWorld, worldToView, localToView );
-        Matrix44::Multiply( localToView, camera->GetProjection(), localToClip );
-        
-        auto meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
+    for (std::size_t i = 0; i < visibleSet.objects.size(); ++i)
+    {
+        const VisibleObject& object = visibleSet.objects[ i ];
+
+        if (object.isCulled)
+        {
+            continue;
+        }
+
+        auto transform = gameObjects[ visibleSet.gameObjects[ i ] ]->GetComponent< TransformComponent >();
+        const Matrix44& meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        MeshRendererComponent* meshRenderer = object.meshRenderer;
+        meshRenderer->UseLod( object.lod );
 
-        meshRenderer->Cull( frustum, meshLocalToWorld );
-        meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader, &renderer.builtinShaders.depthNormalsSkinShader, nullptr, MeshRendererComponent::RenderType::Opaque );
-        meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader,
-                             &renderer.builtinShaders.depthNormalsSkinShader, nullptr, MeshRendererComponent::RenderType::Transparent );
+        // Opaque submeshes first, like in the camera's render queue.
+        for (const bool isTransparent : { false, true })
+        {
+            for (unsigned subMeshIndex = 0; subMeshIndex < object.lodMesh->GetSubMeshCount(); ++subMeshIndex)
+            {
+                if (visibleSet.IsSubMeshVisible( object, subMeshIndex ) &&
+                    (meshRenderer->materials[ subMeshIndex ]->GetBlendingMode() != Material::BlendingMode::Off) == isTransparent)
+                {
+                    meshRenderer->RenderSubMesh( static_cast< int >( subMeshIndex ), object.localToView, object.localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix,
+                                                 SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader, &renderer.builtinShaders.depthNormalsSkinShader, nullptr );
+                }
+            }
+        }
     }
 
     GfxDevice::PopGroupMarker();
@@ -915,7 +1778,7 @@ void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44
 #endif
 }
 
-void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace )
+void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace, const VisibleSet& visibleSet, ShadowCasters casters, RenderTexture* staticShadowMap )
 {
     CameraComponent* camera = cameraGo->GetComponent< CameraComponent >();
 
@@ -946,76 +1809,51 @@ void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace
 
     GfxDevice::PushGroupMarker( "Shadow maps" );
 
-    Matrix44 view;
-    auto cameraTransform = cameraGo->GetComponent< TransformComponent >();
-    cameraTransform->GetWorldRotation().GetMatrix( view );
-    Matrix44 translation;
-    translation.SetTranslation( -cameraTransform->GetWorldPosition() );
-    Matrix44::Multiply( translation, view, view );
-    
-    SceneGlobal::shadowCameraViewMatrix = view;
-    SceneGlobal::shadowCameraProjectionMatrix = camera->GetProjection();
-    
-    Frustum frustum;
-    
-    if (camera->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
+    if (staticShadowMap != nullptr)
     {
-        frustum.SetProjection( camera->GetFovDegrees(), camera->GetAspect(), camera->GetNear(), camera->GetFar() );
+        // The shader writes the moments' depth, so the casters below are depth tested against the static ones.
+        Matrix44 quadToClip;
+        quadToClip.MakeProjection( 0, 1, 1, 0, -1, 1 );
+        GfxDeviceGlobal::perObjectUboStruct.localToClip = quadToClip;
+
+        renderer.builtinShaders.shadowCacheShader.Use();
+        renderer.builtinShaders.shadowCacheShader.SetRenderTexture( staticShadowMap, 0 );
+        GfxDevice::Draw( renderer.GetQuadBuffer(), 0, 2, renderer.builtinShaders.shadowCacheShader, GfxDevice::BlendMode::Off,
+                         GfxDevice::DepthFunc::LessOrEqualWriteOn, GfxDevice::CullMode::Off, GfxDevice::FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
     }
-    else
-    {
-        frustum.SetProjection( camera->GetLeft(), camera->GetRight(), camera->GetBottom(), camera->GetTop(), camera->GetNear(), camera->GetFar() );
-    }
-    
-    const Vec3 viewDir = Vec3( view.m[2], view.m[6], view.m[10] ).Normalized();
-    frustum.Update( cameraTransform->GetWorldPosition(), viewDir );
+
+    // Lighting passes sample the shadow map with the matrices that it was rendered with.
+    SceneGlobal::shadowCameraViewMatrix = visibleSet.worldToView;
+    SceneGlobal::shadowCameraProjectionMatrix = visibleSet.viewToClip;
 
     GfxDeviceGlobal::perObjectUboStruct.cameraParams = Vec4( camera->GetFovDegrees() * 3.14159265f / 180.0f, camera->GetAspect(), camera->GetNear(), camera->GetFar() );
 
-    std::vector< unsigned > gameObjectsWithMeshRenderer;
-    gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-    int gameObjectIndex = -1;
-    
-    for (auto gameObject : gameObjects)
+    // Matrices, LODs and culling are from the face's record, so casters are not processed again for each pass into the face.
+    for (unsigned i = 0; i < visibleSet.objects.size(); ++i)
     {
-        ++gameObjectIndex;
-        
-        if (gameObject == nullptr || !gameObject->IsEnabled())
+        const VisibleObject& object = visibleSet.objects[ i ];
+        MeshRendererComponent* meshRenderer = object.meshRenderer;
+
+        if (object.isCulled || (casters == ShadowCasters::Static && !meshRenderer->IsStaticShadowCaster()) ||
+            (casters == ShadowCasters::Dynamic && meshRenderer->IsStaticShadowCaster()))
         {
             continue;
         }
-        
-        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
-        
-        if (meshRenderer && meshRenderer->CastsShadow())
+
+        auto transform = gameObjects[ visibleSet.gameObjects[ i ] ]->GetComponent< TransformComponent >();
+        const Matrix44& meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        meshRenderer->UseLod( object.lod );
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < object.lodMesh->GetSubMeshCount(); ++subMeshIndex)
         {
-            gameObjectsWithMeshRenderer.push_back( gameObjectIndex );
+            if (visibleSet.IsSubMeshVisible( object, subMeshIndex ) && meshRenderer->materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Off)
+            {
+                meshRenderer->RenderSubMesh( static_cast< int >( subMeshIndex ), object.localToView, object.localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix,
+                                             SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.momentsShader, &renderer.builtinShaders.momentsSkinShader,
+                                             &renderer.builtinShaders.momentsAlphaTestShader );
+            }
         }
     }
-    
-    auto meshSorterByMesh = [&](unsigned j, unsigned k)
-    {
-        return gameObjects[ j ]->GetComponent< MeshRendererComponent >()->GetMesh() <
-               gameObjects[ k ]->GetComponent< MeshRendererComponent >()->GetMesh();
-    };
-    std::sort( std::begin( gameObjectsWithMeshRenderer ), std::end( gameObjectsWithMeshRenderer ), meshSorterByMesh );
-    
-    for (auto j : gameObjectsWithMeshRenderer)
-    {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
-        
-        Matrix44 localToView;
-        Matrix44 localToClip;
-        Matrix44::Multiply( meshLocalToWorld, view, localToView );
-        Matrix44::Multiply( localToView, camera->GetProjection(), localToClip );
-
-        auto* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
-        
-        meshRenderer->Cull( frustum, meshLocalToWorld );
-        meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.momentsShader,
-                             &renderer.builtinShaders.momentsSkinShader, &renderer.builtinShaders.momentsAlphaTestShader, MeshRendererComponent::RenderType::Opaque );
-    }
 
     GfxDevice::PopGroupMarker();
 
@@ -1032,6 +1870,113 @@ void ae3d::Scene::SetSkybox( TextureCube* skyTexture )
     skybox = skyTexture;
 }
 
+namespace
+{
+    // FIXME: These ensure that the mesh is rendered. A proper fix would be to serialize materials.
+    Material* CreateTempMaterial( std::map< std::string, Material* >& outMaterials )
+    {
+        static Shader tempShader;
+        tempShader.Load( "unlit_vertex", "unlit_fragment",
+            FileSystem::FileContents( "shaders/unlit_vert.obj" ), FileSystem::FileContents( "shaders/unlit_frag.obj" ),
+            FileSystem::FileContents( "shaders/unlit_vert.spv" ), FileSystem::FileContents( "shaders/unlit_frag.spv" ) );
+
+        Material* tempMaterial = new Material();
+        tempMaterial->SetShader( &tempShader );
+        tempMaterial->SetTexture( Texture2D::GetDefaultTexture(), 0 );
+        tempMaterial->SetBackFaceCulling( true );
+        outMaterials[ "temp material" ] = tempMaterial;
+
+        return tempMaterial;
+    }
+
+    // \return True, if the token describes a part of a game object.
+    bool RequiresGameObject( SceneToken token )
+    {
+        switch (token)
+        {
+        case SceneToken::Unknown:
+        case SceneToken::GameObject:
+        case SceneToken::Texture2D:
+        case SceneToken::Material:
+        case SceneToken::ParamTexture:
+        case SceneToken::ConeAngle:
+        case SceneToken::Radius:
+        case SceneToken::Color:
+        case SceneToken::Shaders:
+        case SceneToken::MetalShaders:
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    // Collects records and deduplicated strings of the binary scene format.
+    struct SceneBinaryWriter
+    {
+        template< class T > void AddRecord( SceneFormat::RecordType type, T& record )
+        {
+            record.header.type = type;
+            record.header.size = static_cast< std::uint16_t >( sizeof( T ) );
+            const unsigned char* bytes = reinterpret_cast< const unsigned char* >( &record );
+            records.insert( std::end( records ), bytes, bytes + sizeof( T ) );
+            ++recordCount;
+        }
+
+        SceneFormat::StringRef AddString( const std::string& str )
+        {
+            auto it = stringToRef.find( str );
+
+            if (it != std::end( stringToRef ))
+            {
+                return it->second;
+            }
+
+            const SceneFormat::StringRef ref = { static_cast< std::uint32_t >( strings.size() ), static_cast< std::uint32_t >( str.size() ) };
+            strings.insert( std::end( strings ), std::begin( str ), std::end( str ) );
+            strings.push_back( '\0' );
+            stringToRef[ str ] = ref;
+
+            return ref;
+        }
+
+        std::vector< unsigned char > records;
+        std::vector< char > strings;
+        std::unordered_map< std::string, SceneFormat::StringRef > stringToRef;
+        unsigned recordCount = 0;
+    };
+
+    // \return Size of a record type or 0 if the type is unknown.
+    std::size_t GetRecordSize( SceneFormat::RecordType type )
+    {
+        switch (type)
+        {
+        case SceneFormat::RecordType::GameObject: return sizeof( SceneFormat::GameObjectRecord );
+        case SceneFormat::RecordType::Transform: return sizeof( SceneFormat::TransformRecord );
+        case SceneFormat::RecordType::Camera: return sizeof( SceneFormat::CameraRecord );
+        case SceneFormat::RecordType::MeshRenderer: return sizeof( SceneFormat::MeshRendererRecord );
+        case SceneFormat::RecordType::SpriteRenderer: return sizeof( SceneFormat::SpriteRendererRecord );
+        case SceneFormat::RecordType::Sprite: return sizeof( SceneFormat::SpriteRecord );
+        case SceneFormat::RecordType::DirectionalLight: return sizeof( SceneFormat::DirectionalLightRecord );
+        case SceneFormat::RecordType::SpotLight: return sizeof( SceneFormat::SpotLightRecord );
+        case SceneFormat::RecordType::PointLight: return sizeof( SceneFormat::PointLightRecord );
+        case SceneFormat::RecordType::ParticleSystem: return sizeof( SceneFormat::ParticleSystemRecord );
+        case SceneFormat::RecordType::DecalRenderer: return sizeof( SceneFormat::DecalRendererRecord );
+        case SceneFormat::RecordType::AudioSource: return sizeof( SceneFormat::AudioSourceRecord );
+        case SceneFormat::RecordType::MeshRendererLod: return sizeof( SceneFormat::MeshRendererLodRecord );
+        }
+
+        return 0;
+    }
+
+    // Records are copied out because a file written on another platform is not guaranteed to be aligned for T.
+    template< class T > T ReadRecord( const unsigned char* record )
+    {
+        T outRecord;
+        std::memcpy( &outRecord, record, sizeof( T ) );
+        return outRecord;
+    }
+}
+
 std::string ae3d::Scene::GetSerialized() const
 {
     std::string outSerialized;
@@ -1093,103 +2038,279 @@ std::string ae3d::Scene::GetSerialized() const
     return outSerialized;
 }
 
+std::vector< unsigned char > ae3d::Scene::GetSerializedBinary() const
+{
+    SceneBinaryWriter writer;
+    unsigned gameObjectCount = 0;
+
+    for (auto gameObject : gameObjects)
+    {
+        if (gameObject == nullptr)
+        {
+            continue;
+        }
+
+        ++gameObjectCount;
+
+        SceneFormat::GameObjectRecord goRecord = {};
+        goRecord.name = writer.AddString( gameObject->name );
+        goRecord.layer = gameObject->GetLayer();
+        goRecord.enabled = gameObject->isEnabled ? 1 : 0;
+        writer.AddRecord( SceneFormat::RecordType::GameObject, goRecord );
+
+        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+
+        if (meshRenderer)
+        {
+            SceneFormat::MeshRendererRecord record = {};
+            record.meshPath = writer.AddString( meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetPath() : "" );
+            record.castShadow = meshRenderer->CastsShadow() ? 1 : 0;
+            record.enabled = meshRenderer->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::MeshRenderer, record );
+
+            for (unsigned i = 0; i < meshRenderer->GetLodCount(); ++i)
+            {
+                SceneFormat::MeshRendererLodRecord lodRecord = {};
+                lodRecord.meshPath = writer.AddString( meshRenderer->GetLodMesh( i )->GetPath() );
+                lodRecord.screenSize = meshRenderer->GetLodScreenSize( i );
+                lodRecord.hysteresis = meshRenderer->GetLodHysteresis();
+                writer.AddRecord( SceneFormat::RecordType::MeshRendererLod, lodRecord );
+            }
+        }
+
+        auto transform = gameObject->GetComponent< TransformComponent >();
+
+        if (transform)
+        {
+            const Vec3& position = transform->GetLocalPosition();
+            const Quaternion& rotation = transform->GetLocalRotation();
+
+            SceneFormat::TransformRecord record = {};
+            record.position[ 0 ] = position.x;
+            record.position[ 1 ] = position.y;
+            record.position[ 2 ] = position.z;
+            record.rotation[ 0 ] = rotation.x;
+            record.rotation[ 1 ] = rotation.y;
+            record.rotation[ 2 ] = rotation.z;
+            record.rotation[ 3 ] = rotation.w;
+            record.scale = transform->GetLocalScale();
+            record.enabled = transform->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::Transform, record );
+        }
+
+        auto camera = gameObject->GetComponent< CameraComponent >();
+
+        if (camera)
+        {
+            SceneFormat::CameraRecord record = {};
+            record.orthoLeft = camera->GetLeft();
+            record.orthoRight = camera->GetRight();
+            record.orthoBottom = camera->GetBottom();
+            record.orthoTop = camera->GetTop();
+            record.fovDegrees = camera->GetFovDegrees();
+            record.aspect = camera->GetAspect();
+            record.nearp = camera->GetNear();
+            record.farp = camera->GetFar();
+            record.isPerspective = camera->GetProjectionType() == CameraComponent::ProjectionType::Perspective ? 1 : 0;
+            record.layerMask = camera->GetLayerMask();
+            record.renderOrder = camera->GetRenderOrder();
+
+            for (int i = 0; i < 4; ++i)
+            {
+                record.viewport[ i ] = camera->GetViewport()[ i ];
+            }
+
+            record.clearColor[ 0 ] = camera->GetClearColor().x;
+            record.clearColor[ 1 ] = camera->GetClearColor().y;
+            record.clearColor[ 2 ] = camera->GetClearColor().z;
+            record.enabled = camera->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::Camera, record );
+        }
+
+        auto spriteRenderer = gameObject->GetComponent< SpriteRendererComponent >();
+
+        if (spriteRenderer)
+        {
+            SceneFormat::SpriteRendererRecord record = {};
+            record.enabled = spriteRenderer->isEnabled ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::SpriteRenderer, record );
+
+            for (unsigned spriteIndex = 0; spriteIndex < spriteRenderer->GetSpriteCount(); ++spriteIndex)
+            {
+                const SpriteInfo info = spriteRenderer->GetSpriteInfo( static_cast< int >( spriteIndex ) );
+
+                SceneFormat::SpriteRecord spriteRecord = {};
+                spriteRecord.path = writer.AddString( info.path );
+                spriteRecord.x = info.x;
+                spriteRecord.y = info.y;
+                spriteRecord.width = info.width;
+                spriteRecord.height = info.height;
+                writer.AddRecord( SceneFormat::RecordType::Sprite, spriteRecord );
+            }
+        }
+
+        auto audioSource = gameObject->GetComponent< AudioSourceComponent >();
+
+        if (audioSource)
+        {
+            SceneFormat::AudioSourceRecord record = {};
+            record.is3D = audioSource->Is3D() ? 1 : 0;
+            record.enabled = audioSource->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::AudioSource, record );
+        }
+
+        auto dirLight = gameObject->GetComponent< DirectionalLightComponent >();
+
+        if (dirLight)
+        {
+            SceneFormat::DirectionalLightRecord record = {};
+            record.color[ 0 ] = dirLight->GetColor().x;
+            record.color[ 1 ] = dirLight->GetColor().y;
+            record.color[ 2 ] = dirLight->GetColor().z;
+            record.castShadow = dirLight->CastsShadow() ? 1 : 0;
+            record.enabled = dirLight->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::DirectionalLight, record );
+        }
+
+        auto spotLight = gameObject->GetComponent< SpotLightComponent >();
+
+        if (spotLight)
+        {
+            SceneFormat::SpotLightRecord record = {};
+            record.color[ 0 ] = spotLight->GetColor().x;
+            record.color[ 1 ] = spotLight->GetColor().y;
+            record.color[ 2 ] = spotLight->GetColor().z;
+            record.coneAngleDegrees = spotLight->GetConeAngle();
+            record.radius = spotLight->GetRadius();
+            record.castShadow = spotLight->CastsShadow() ? 1 : 0;
+            record.enabled = spotLight->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::SpotLight, record );
+        }
+
+        auto pointLight = gameObject->GetComponent< PointLightComponent >();
+
+        if (pointLight)
+        {
+            SceneFormat::PointLightRecord record = {};
+            record.color[ 0 ] = pointLight->GetColor().x;
+            record.color[ 1 ] = pointLight->GetColor().y;
+            record.color[ 2 ] = pointLight->GetColor().z;
+            record.radius = pointLight->GetRadius();
+            record.castShadow = pointLight->CastsShadow() ? 1 : 0;
+            record.enabled = pointLight->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::PointLight, record );
+        }
+
+        auto particleSystem = gameObject->GetComponent< ParticleSystemComponent >();
+
+        if (particleSystem)
+        {
+            SceneFormat::ParticleSystemRecord record = {};
+            particleSystem->GetColor( record.color[ 0 ], record.color[ 1 ], record.color[ 2 ] );
+            record.enabled = particleSystem->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::ParticleSystem, record );
+        }
+
+        auto decalRenderer = gameObject->GetComponent< DecalRendererComponent >();
+
+        if (decalRenderer)
+        {
+            SceneFormat::DecalRendererRecord record = {};
+            record.enabled = decalRenderer->IsEnabled() ? 1 : 0;
+            writer.AddRecord( SceneFormat::RecordType::DecalRenderer, record );
+        }
+    }
+
+    SceneFormat::FileHeader header = {};
+    std::memcpy( header.magic, SceneFormat::Magic, sizeof( header.magic ) );
+    header.version = SceneFormat::Version;
+    header.gameObjectCount = gameObjectCount;
+    header.recordCount = writer.recordCount;
+    header.recordsOffset = sizeof( header );
+    header.stringTableOffset = static_cast< std::uint32_t >( header.recordsOffset + writer.records.size() );
+    header.stringTableSize = static_cast< std::uint32_t >( writer.strings.size() );
+
+    std::vector< unsigned char > outSerialized( sizeof( header ) );
+    std::memcpy( outSerialized.data(), &header, sizeof( header ) );
+    outSerialized.insert( std::end( outSerialized ), std::begin( writer.records ), std::end( writer.records ) );
+    outSerialized.insert( std::end( outSerialized ), std::begin( writer.strings ), std::end( writer.strings ) );
+
+    return outSerialized;
+}
+
 ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileContentsData& serialized, std::vector< GameObject >& outGameObjects,
                                                         std::map< std::string, Texture2D* >& outTexture2Ds,
                                                         std::map< std::string, Material* >& outMaterials,
                                                         Array< Mesh* >& outMeshes ) const
 {
+    if (serialized.data.size() >= sizeof( SceneFormat::Magic ) && std::memcmp( serialized.data.data(), SceneFormat::Magic, sizeof( SceneFormat::Magic ) ) == 0)
+    {
+        return DeserializeBinary( serialized.data.data(), serialized.data.size(), serialized.path.c_str(), outGameObjects, outTexture2Ds, outMaterials, outMeshes );
+    }
+
     // TODO: It would be better to store the token strings into somewhere accessible to GetSerialized() to prevent typos etc.
 
     outGameObjects.clear();
 
-    std::stringstream stream( std::string( std::begin( serialized.data ), std::end( serialized.data ) ) );
-    std::string line;
-    
+    SceneTokenizer tokenizer( serialized.data.data(), serialized.data.size() );
     std::string currentMaterialName;
-    
+
     enum class CurrentLightType { Directional, Spot, Point, None };
     CurrentLightType currentLightType = CurrentLightType::None;
-    
-    // FIXME: These ensure that the mesh is rendered. A proper fix would be to serialize materials.
-    static Shader tempShader;
-    tempShader.Load( "unlit_vertex", "unlit_fragment",
-        FileSystem::FileContents( "shaders/unlit_vert.obj" ), FileSystem::FileContents( "shaders/unlit_frag.obj" ),
-        FileSystem::FileContents( "shaders/unlit_vert.spv" ), FileSystem::FileContents( "shaders/unlit_frag.spv" ) );
 
-    Material* tempMaterial = new Material();
-    tempMaterial->SetShader( &tempShader );
-    tempMaterial->SetTexture( Texture2D::GetDefaultTexture(), 0 );
-    tempMaterial->SetBackFaceCulling( true );
-    outMaterials[ "temp material" ] = tempMaterial;
+    Material* tempMaterial = CreateTempMaterial( outMaterials );
 
     int textureUnit = 0;
-    int lineNo = 0;
-    while (!stream.eof())
-    {
-        std::getline( stream, line );
-        std::stringstream lineStream( line );
-        std::locale c_locale( "C" );
-        lineStream.imbue( c_locale );
-        std::string token;
-        lineStream >> token;
-        
-        ++lineNo;
-        
-        if (token == "gameobject")
+
+    while (tokenizer.NextLine())
+    {
+        TokenView tokenView;
+
+        if (!tokenizer.NextToken( tokenView ))
         {
-            outGameObjects.push_back( GameObject() );
+            continue;
         }
-        else if (token.empty())
+
+        const int lineNo = tokenizer.GetLineNumber();
+        const SceneToken token = LookupSceneToken( tokenView );
+
+        if (outGameObjects.empty() && RequiresGameObject( token ))
         {
+            System::Print( "Failed to parse %s at line %d: found \"%s\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo, tokenView.ToString().c_str() );
+            return DeserializeResult::ParseError;
         }
-        else if (token == "name")
-        {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"name\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            std::string name;
-            std::getline( lineStream, name );
-            name = name.substr( 1, name.length() );
 
-            outGameObjects.back().SetName( name.c_str() );
+        switch (token)
+        {
+        case SceneToken::GameObject:
+        {
+            outGameObjects.push_back( GameObject() );
+            currentLightType = CurrentLightType::None;
+            break;
         }
-        else if (token == "layer")
+        case SceneToken::Name:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"layer\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int layer;
-            lineStream >> layer;
+            outGameObjects.back().SetName( tokenizer.GetRestOfLine().ToString().c_str() );
+            break;
+        }
+        case SceneToken::Layer:
+        {
+            int layer = 0;
+            tokenizer.NextInt( layer );
             outGameObjects.back().SetLayer( layer );
+            break;
         }
-        else if (token == "enabled")
+        case SceneToken::Enabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
             outGameObjects.back().SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "meshrenderer_enabled")
+        case SceneToken::MeshRendererEnabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"meshrenderer_enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             auto meshRenderer = outGameObjects.back().GetComponent< MeshRendererComponent >();
 
@@ -1200,38 +2321,28 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             }
 
             meshRenderer->SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "particlesystem_enabled")
+        case SceneToken::ParticleSystemEnabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"particlesystem_enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             auto particleSystem = outGameObjects.back().GetComponent< ParticleSystemComponent >();
 
-            if ( particleSystem == nullptr)
+            if (particleSystem == nullptr)
             {
                 System::Print( "Failed to parse %s at line %d: found \"particlesystem_enabled\" but the game object doesn't have a particle system component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
             particleSystem->SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "decalrenderer_enabled")
+        case SceneToken::DecalRendererEnabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"decalrenderer_enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             auto decalRenderer = outGameObjects.back().GetComponent< DecalRendererComponent >();
 
@@ -1242,17 +2353,12 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             }
 
             decalRenderer->SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "transform_enabled")
+        case SceneToken::TransformEnabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"transform_enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             auto transform = outGameObjects.back().GetComponent< TransformComponent >();
 
@@ -1263,17 +2369,12 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             }
 
             transform->SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "camera_enabled")
+        case SceneToken::CameraEnabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"camera_enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             auto camera = outGameObjects.back().GetComponent< CameraComponent >();
 
@@ -1284,82 +2385,53 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             }
 
             camera->SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "dirlight")
+        case SceneToken::DirLight:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found dirlight but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-            
             currentLightType = CurrentLightType::Directional;
             outGameObjects.back().AddComponent< DirectionalLightComponent >();
-            
+
+            // Old scenes have "shadow <0|1>" on the same line.
+            TokenView shadowToken;
             int castsShadow = 0;
-            std::string shadowStr;
-            lineStream >> shadowStr;
-            lineStream >> castsShadow;
+            tokenizer.NextToken( shadowToken );
+            tokenizer.NextInt( castsShadow );
             outGameObjects.back().GetComponent< DirectionalLightComponent >()->SetCastShadow( castsShadow != 0, 512 );
+            break;
         }
-        else if (token == "particlesystem")
+        case SceneToken::ParticleSystem:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found particlesystem but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-            
             outGameObjects.back().AddComponent< ParticleSystemComponent >();
 
-            float r, g, b;
-            lineStream >> r >> g >> b;
+            float r = 0, g = 0, b = 0;
+            tokenizer.NextFloat( r );
+            tokenizer.NextFloat( g );
+            tokenizer.NextFloat( b );
             outGameObjects.back().GetComponent< ParticleSystemComponent >()->SetColor( r, g, b );
+            break;
         }
-        else if (token == "decalrenderer")
+        case SceneToken::DecalRenderer:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found decalrenderer but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-            
             outGameObjects.back().AddComponent< DecalRendererComponent >();
+            break;
         }
-        else if (token == "spotlight")
+        case SceneToken::SpotLight:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found spotlight but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-            
             currentLightType = CurrentLightType::Spot;
-            GameObject& go = outGameObjects.back();
-            go.AddComponent< SpotLightComponent >();            
+            outGameObjects.back().AddComponent< SpotLightComponent >();
+            break;
         }
-        else if (token == "pointlight")
+        case SceneToken::PointLight:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found pointlight but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-            
             currentLightType = CurrentLightType::Point;
-            GameObject& go  = outGameObjects.back();
-            go.AddComponent< PointLightComponent >();            
+            outGameObjects.back().AddComponent< PointLightComponent >();
+            break;
         }
-        else if (token == "dirlight_enabled")
+        case SceneToken::DirLightEnabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"dirlight_enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             auto dirLight = outGameObjects.back().GetComponent< DirectionalLightComponent >();
 
@@ -1370,17 +2442,12 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             }
 
             dirLight->SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "spotlight_enabled")
+        case SceneToken::SpotLightEnabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"spotlight_enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             auto spotLight = outGameObjects.back().GetComponent< SpotLightComponent >();
 
@@ -1391,38 +2458,28 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             }
 
             spotLight->SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "pointlight_enabled")
+        case SceneToken::PointLightEnabled:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found \"pointlight_enabled\" but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             auto pointLight = outGameObjects.back().GetComponent< PointLightComponent >();
 
             if (pointLight == nullptr)
             {
-                System::Print( "Failed to parse %s at line %d: found \"spotlight_enabled\" but the game object doesn't have a spot light component.\n", serialized.path.c_str(), lineNo );
+                System::Print( "Failed to parse %s at line %d: found \"pointlight_enabled\" but the game object doesn't have a point light component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
             pointLight->SetEnabled( enabled != 0 );
+            break;
         }
-        else if (token == "shadow")
+        case SceneToken::Shadow:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found shadow but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            int enabled;
-            lineStream >> enabled;
+            int enabled = 0;
+            tokenizer.NextInt( enabled );
 
             if (currentLightType == CurrentLightType::Directional)
             {
@@ -1436,52 +2493,40 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             {
                 outGameObjects.back().GetComponent< PointLightComponent >()->SetCastShadow( enabled != 0, 1024 );
             }
-        }
-        else if (token == "camera")
-        {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found camera but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
+            break;
+        }
+        case SceneToken::Camera:
+        {
             outGameObjects.back().AddComponent< CameraComponent >();
+            break;
         }
-        else if (token == "ortho")
+        case SceneToken::Ortho:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found ortho but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            float x, y, width, height, nearp, farp;
-            lineStream >> x >> y >> width >> height >> nearp >> farp;
+            float x = 0, y = 0, width = 0, height = 0, nearp = 0, farp = 0;
+            tokenizer.NextFloat( x );
+            tokenizer.NextFloat( y );
+            tokenizer.NextFloat( width );
+            tokenizer.NextFloat( height );
+            tokenizer.NextFloat( nearp );
+            tokenizer.NextFloat( farp );
             outGameObjects.back().GetComponent< CameraComponent >()->SetProjection( x, y, width, height, nearp, farp );
+            break;
         }
-        else if (token == "persp")
+        case SceneToken::Persp:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found persp but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            float fov, aspect, nearp, farp;
-            lineStream >> fov >> aspect >> nearp >> farp;
+            float fov = 0, aspect = 0, nearp = 0, farp = 0;
+            tokenizer.NextFloat( fov );
+            tokenizer.NextFloat( aspect );
+            tokenizer.NextFloat( nearp );
+            tokenizer.NextFloat( farp );
             outGameObjects.back().GetComponent< CameraComponent >()->SetProjection( fov, aspect, nearp, farp );
+            break;
         }
-        else if (token == "projection")
+        case SceneToken::Projection:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found projection but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
+            TokenView type;
+            tokenizer.NextToken( type );
 
-            std::string type;
-            lineStream >> type;
-            
             if (type == "orthographic")
             {
                 outGameObjects.back().GetComponent< CameraComponent >()->SetProjectionType( ae3d::CameraComponent::ProjectionType::Orthographic );
@@ -1492,76 +2537,51 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             }
             else
             {
-                System::Print( "Camera has unknown projection type %s\n", type.c_str() );
+                System::Print( "Camera has unknown projection type %s\n", type.ToString().c_str() );
                 return DeserializeResult::ParseError;
             }
+            break;
         }
-        else if (token == "clearcolor")
+        case SceneToken::ClearColor:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found clearcolor but there are no game objects defined before this line.\n", serialized.path.c_str() , lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            float red, green, blue;
-            lineStream >> red >> green >> blue;
+            float red = 0, green = 0, blue = 0;
+            tokenizer.NextFloat( red );
+            tokenizer.NextFloat( green );
+            tokenizer.NextFloat( blue );
             outGameObjects.back().GetComponent< CameraComponent >()->SetClearColor( { red, green, blue } );
+            break;
         }
-        else if (token == "layermask")
+        case SceneToken::LayerMask:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found layermask but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            unsigned layerMask;
-            lineStream >> layerMask;
+            unsigned layerMask = 0;
+            tokenizer.NextUnsigned( layerMask );
             outGameObjects.back().GetComponent< CameraComponent >()->SetLayerMask( layerMask );
+            break;
         }
-        else if (token == "viewport")
+        case SceneToken::Viewport:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found viewport but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
-            unsigned x, y, w, h;
-            lineStream >> x >> y >> w >> h;
+            unsigned x = 0, y = 0, w = 0, h = 0;
+            tokenizer.NextUnsigned( x );
+            tokenizer.NextUnsigned( y );
+            tokenizer.NextUnsigned( w );
+            tokenizer.NextUnsigned( h );
             outGameObjects.back().GetComponent< CameraComponent >()->SetViewport( x, y, w, h );
+            break;
         }
-        else if (token == "order")
+        case SceneToken::Order:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found order but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
             unsigned order = 0;
-            lineStream >> order;
+            tokenizer.NextUnsigned( order );
             outGameObjects.back().GetComponent< CameraComponent >()->SetRenderOrder( order );
+            break;
         }
-        else if (token == "transform")
+        case SceneToken::Transform:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found transform but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
             outGameObjects.back().AddComponent< TransformComponent >();
+            break;
         }
-        else if (token == "meshrenderer_cast_shadow")
+        case SceneToken::MeshRendererCastShadow:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found meshrenderer_cast_shadow but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
             auto meshRenderer = outGameObjects.back().GetComponent< MeshRendererComponent >();
 
             if (meshRenderer == nullptr)
@@ -1570,28 +2590,18 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
                 return DeserializeResult::ParseError;
             }
 
-            std::string str;
-            lineStream >> str;
-            meshRenderer->SetCastShadow( str == std::string( "1" ) );
+            TokenView castShadow;
+            tokenizer.NextToken( castShadow );
+            meshRenderer->SetCastShadow( castShadow == "1" );
+            break;
         }
-        else if (token == "meshrenderer")
+        case SceneToken::MeshRenderer:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found meshrenderer but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
             outGameObjects.back().AddComponent< MeshRendererComponent >();
+            break;
         }
-        else if (token == "meshpath")
+        case SceneToken::MeshPath:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found meshFile but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
             auto meshRenderer = outGameObjects.back().GetComponent< MeshRendererComponent >();
 
             if (!meshRenderer)
@@ -1600,183 +2610,181 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
                 return DeserializeResult::ParseError;
             }
 
-            std::string meshFile;
-            lineStream >> meshFile;
+            TokenView meshFile;
+            tokenizer.NextToken( meshFile );
 
             Mesh* mesh = new Mesh();
             outMeshes.Add( mesh );
 
-            outMeshes[ outMeshes.count - 1 ]->Load( FileSystem::FileContents( meshFile.c_str() ) );
-			meshRenderer->SetMesh( outMeshes[ outMeshes.count - 1 ] );
+            mesh->Load( FileSystem::FileContents( meshFile.ToString().c_str() ) );
+            meshRenderer->SetMesh( mesh );
 
             for (unsigned i = 0; i < mesh->GetSubMeshCount(); ++i)
             {
                 meshRenderer->SetMaterial( tempMaterial, i );
             }
+            break;
         }
-        else if (token == "spriterenderer")
+        case SceneToken::MeshRendererLod:
         {
-            if (outGameObjects.empty())
+            auto meshRenderer = outGameObjects.back().GetComponent< MeshRendererComponent >();
+
+            if (meshRenderer == nullptr || meshRenderer->GetMesh() == nullptr)
             {
-                System::Print( "Failed to parse %s at line %d: found spriterenderer but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
+                System::Print( "Failed to parse %s at line %d: found meshrenderer_lod but the game object doesn't have a mesh renderer component with a mesh.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
-            outGameObjects.back().AddComponent< SpriteRendererComponent >();
+            TokenView meshFile;
+            float screenSize = 0;
+            tokenizer.NextToken( meshFile );
+            tokenizer.NextFloat( screenSize );
+
+            Mesh* mesh = new Mesh();
+            outMeshes.Add( mesh );
+
+            mesh->Load( FileSystem::FileContents( meshFile.ToString().c_str() ) );
+            meshRenderer->AddLod( mesh, screenSize );
+            break;
         }
-        else if (token == "sprite")
+        case SceneToken::MeshRendererLodHysteresis:
         {
-            if (outGameObjects.empty())
+            auto meshRenderer = outGameObjects.back().GetComponent< MeshRendererComponent >();
+
+            if (meshRenderer == nullptr)
             {
-                System::Print( "Failed to parse %s at line %d: found sprite but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
+                System::Print( "Failed to parse %s at line %d: found meshrenderer_lod_hysteresis but the game object doesn't have a mesh renderer component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
+            float hysteresis = 0;
+            tokenizer.NextFloat( hysteresis );
+            meshRenderer->SetLodHysteresis( hysteresis );
+            break;
+        }
+        case SceneToken::SpriteRenderer:
+        {
+            outGameObjects.back().AddComponent< SpriteRendererComponent >();
+            break;
+        }
+        case SceneToken::Sprite:
+        {
             if (!outGameObjects.back().GetComponent< SpriteRendererComponent >())
             {
                 System::Print( "Failed to parse %s at line %d: found sprite but the game object doesn't have a sprite renderer component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
-            std::string spritePath;
-            float x, y, width, height;
-            lineStream >> spritePath >> x >> y >> width >> height;
+            TokenView spritePathToken;
+            float x = 0, y = 0, width = 0, height = 0;
+            tokenizer.NextToken( spritePathToken );
+            tokenizer.NextFloat( x );
+            tokenizer.NextFloat( y );
+            tokenizer.NextFloat( width );
+            tokenizer.NextFloat( height );
 
+            const std::string spritePath = spritePathToken.ToString();
             outTexture2Ds[ spritePath ] = new Texture2D();
             outTexture2Ds[ spritePath ]->Load( FileSystem::FileContents( spritePath.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
 
             outGameObjects.back().GetComponent< SpriteRendererComponent >()->SetTexture( outTexture2Ds[ spritePath ], Vec3( x, y, 0 ), Vec3( x, y, 1 ), Vec4( 1, 1, 1, 1 ) );
+            break;
         }
-        else if (token == "position")
+        case SceneToken::Position:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found position but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
             if (!outGameObjects.back().GetComponent< TransformComponent >())
             {
                 System::Print( "Failed to parse %s at line %d: found position but the game object doesn't have a transform component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
-            float x, y, z;
-            lineStream >> x >> y >> z;
+            float x = 0, y = 0, z = 0;
+            tokenizer.NextFloat( x );
+            tokenizer.NextFloat( y );
+            tokenizer.NextFloat( z );
             outGameObjects.back().GetComponent< TransformComponent >()->SetLocalPosition( { x, y, z } );
+            break;
         }
-        else if (token == "rotation")
+        case SceneToken::Rotation:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found rotation but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
             if (!outGameObjects.back().GetComponent< TransformComponent >())
             {
                 System::Print( "Failed to parse %s at line %d: found rotation but the game object doesn't have a transform component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
-            float x, y, z, s;
-            lineStream >> x >> y >> z >> s;
+            float x = 0, y = 0, z = 0, s = 0;
+            tokenizer.NextFloat( x );
+            tokenizer.NextFloat( y );
+            tokenizer.NextFloat( z );
+            tokenizer.NextFloat( s );
             outGameObjects.back().GetComponent< TransformComponent >()->SetLocalRotation( { { x, y, z }, s } );
+            break;
         }
-        else if (token == "scale")
+        case SceneToken::Scale:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found scale but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-            
             if (!outGameObjects.back().GetComponent< TransformComponent >())
             {
                 System::Print( "Failed to parse %s at line %d: found scale but the game object doesn't have a transform component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
-            float objScale;
-            lineStream >> objScale;
+            float objScale = 0;
+            tokenizer.NextFloat( objScale );
             outGameObjects.back().GetComponent< TransformComponent >()->SetLocalScale( objScale );
+            break;
         }
-        else if (token == "texture2d")
+        case SceneToken::Texture2D:
         {
-            std::string name;
-            std::string path;
-            
-            lineStream >> name >> path;
-            
-            if (!lineStream.eof())
-            {
-                std::string compressedTexturePath;
-                lineStream >> compressedTexturePath;
-                
+            TokenView name;
+            TokenView path;
+            tokenizer.NextToken( name );
+            tokenizer.NextToken( path );
+
 #if !TARGET_OS_IPHONE
-                if (compressedTexturePath.find( ".dds" ) != std::string::npos)
-                {
-                    path = compressedTexturePath;
-                }
-                else if (!lineStream.eof())
-                {
-                    lineStream >> compressedTexturePath;
-                    
-                    if (compressedTexturePath.find( ".dds" ) != std::string::npos)
-                    {
-                        path = compressedTexturePath;
-                    }
-                }
-#endif
-#if TARGET_OS_IPHONE
-                // FIXME: Temporarily disabled because sponza.scene refers non-existing files.
-                /*if (compressedTexturePath.find( ".astc" ) != std::string::npos)
+            // Up to two compressed versions of the texture can follow the path.
+            TokenView compressedTexturePath;
+
+            for (int i = 0; i < 2 && tokenizer.NextToken( compressedTexturePath ); ++i)
+            {
+                if (compressedTexturePath.ToString().find( ".dds" ) != std::string::npos)
                 {
                     path = compressedTexturePath;
+                    break;
                 }
-                else if (!lineStream.eof())
-                {
-                    lineStream >> compressedTexturePath;
-                    
-                    if (compressedTexturePath.find( ".astc" ) != std::string::npos)
-                    {
-                        path = compressedTexturePath;
-                    }
-                }*/
-#endif
             }
+#endif
+            // FIXME: .astc versions are not used on iOS because sponza.scene refers non-existing files.
 
-            outTexture2Ds[ name ] = new Texture2D();
+            const std::string nameStr = name.ToString();
+            const std::string pathStr = path.ToString();
+            outTexture2Ds[ nameStr ] = new Texture2D();
 
-            if (path.find( "_n." ) != std::string::npos)
+            if (pathStr.find( "_n." ) != std::string::npos)
             {
-                outTexture2Ds[ name ]->Load( FileSystem::FileContents( path.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::Linear, Anisotropy::k1 );
+                outTexture2Ds[ nameStr ]->Load( FileSystem::FileContents( pathStr.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::Linear, Anisotropy::k1 );
             }
             else
             {
-                outTexture2Ds[ name ]->Load( FileSystem::FileContents( path.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
+                outTexture2Ds[ nameStr ]->Load( FileSystem::FileContents( pathStr.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
             }
+            break;
         }
-        else if (token == "material")
+        case SceneToken::Material:
         {
             textureUnit = 0;
-            
-            std::string materialName;
-            lineStream >> materialName;
-            currentMaterialName = materialName;
-            
-            outMaterials[ materialName ] = new Material();
-            outMaterials[ materialName ]->SetTexture( Texture2D::GetDefaultTexture(), 0 );
-            outMaterials[ materialName ]->SetTexture( Texture2D::GetDefaultTexture(), 1 ); // This should really be a normal map.
+
+            TokenView materialName;
+            tokenizer.NextToken( materialName );
+            currentMaterialName = materialName.ToString();
+
+            outMaterials[ currentMaterialName ] = new Material();
+            outMaterials[ currentMaterialName ]->SetTexture( Texture2D::GetDefaultTexture(), 0 );
+            outMaterials[ currentMaterialName ]->SetTexture( Texture2D::GetDefaultTexture(), 1 ); // This should really be a normal map.
+            break;
         }
-        else if (token == "mesh_material")
+        case SceneToken::MeshMaterial:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found mesh_material but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-            
             auto mr = outGameObjects.back().GetComponent< MeshRendererComponent >();
 
             if (!mr)
@@ -1784,35 +2792,38 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
                 System::Print( "Failed to parse %s at line %d: found mesh_material but the last defined game object doesn't have a mesh renderer component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
-            
+
             if (!mr->GetMesh())
             {
                 System::Print( "Failed to parse %s at line %d: found mesh_material but the last defined game object's mesh renderer doesn't have a mesh.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
-            
-            std::string meshName;
-            std::string materialName;
-            lineStream >> meshName >> materialName;
-            
+
+            TokenView meshName;
+            TokenView materialName;
+            tokenizer.NextToken( meshName );
+            tokenizer.NextToken( materialName );
+
+            Material* material = outMaterials[ materialName.ToString() ];
             const unsigned subMeshCount = mr->GetMesh()->GetSubMeshCount();
-            
+
             for (unsigned i = 0; i < subMeshCount; ++i)
             {
-                if (mr->GetMesh()->GetSubMeshName( i ) == meshName)
+                if (meshName == mr->GetMesh()->GetSubMeshName( i ))
                 {
-                    mr->SetMaterial( outMaterials[ materialName ], i );
+                    mr->SetMaterial( material, i );
                 }
             }
+            break;
         }
-        else if (token == "param_texture")
+        case SceneToken::ParamTexture:
         {
-            std::string uniformName;
-            std::string textureName;
-            
-            lineStream >> uniformName >> textureName;
-            
-            outMaterials[ currentMaterialName ]->SetTexture( outTexture2Ds[ textureName ], textureUnit );
+            TokenView uniformName;
+            TokenView textureName;
+            tokenizer.NextToken( uniformName );
+            tokenizer.NextToken( textureName );
+
+            outMaterials[ currentMaterialName ]->SetTexture( outTexture2Ds[ textureName.ToString() ], textureUnit );
             ++textureUnit;
 
             if (textureUnit > 12)
@@ -1820,21 +2831,17 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
                 System::Print( "Material %s uses too many textures! Max number is 13.\n", currentMaterialName.c_str() );
                 textureUnit = 0;
             }
+            break;
         }
-        else if (token == "audiosource")
+        case SceneToken::AudioSource:
         {
-            if (outGameObjects.empty())
-            {
-                System::Print( "Failed to parse %s at line %d: found audiosource but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
-                return DeserializeResult::ParseError;
-            }
-
             outGameObjects.back().AddComponent< AudioSourceComponent >();
+            break;
         }
-        else if (token == "coneangle")
+        case SceneToken::ConeAngle:
         {
-            float coneAngleDegrees;
-            lineStream >> coneAngleDegrees;
+            float coneAngleDegrees = 0;
+            tokenizer.NextFloat( coneAngleDegrees );
 
             if (currentLightType == CurrentLightType::Spot)
             {
@@ -1844,12 +2851,13 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             {
                 System::Print( "Found 'coneangle' at line %d but no spotlight is defined before this line.\n", lineNo );
             }
+            break;
         }
-        else if (token == "radius")
+        case SceneToken::Radius:
         {
-            float radius;
-            lineStream >> radius;
-            
+            float radius = 0;
+            tokenizer.NextFloat( radius );
+
             if (currentLightType == CurrentLightType::Point)
             {
                 outGameObjects.back().GetComponent< PointLightComponent >()->SetRadius( radius );
@@ -1862,12 +2870,14 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             {
                 System::Print( "Found 'radius' but no spotlight or point light is defined before this line.\n" );
             }
+            break;
         }
-        else if (token == "color")
+        case SceneToken::Color:
         {
             Vec3 color;
-
-            lineStream >> color.x >> color.y >> color.z;
+            tokenizer.NextFloat( color.x );
+            tokenizer.NextFloat( color.y );
+            tokenizer.NextFloat( color.z );
 
             if (currentLightType == CurrentLightType::Spot)
             {
@@ -1885,53 +2895,62 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             {
                 System::Print( "Found \"color\" at line %d but there is no light before this line!\n", lineNo );
             }
+            break;
         }
-        else if (token == "shaders")
+        case SceneToken::Shaders:
         {
             if (currentMaterialName.empty())
             {
-                System::Print( "Failed to parse %s at line %d: found 'metal_shaders' but there are no materials defined before this line.\n", serialized.path.c_str(), lineNo );
+                System::Print( "Failed to parse %s at line %d: found 'shaders' but there are no materials defined before this line.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
-            
-            std::string vertexShaderName, fragmentShaderName;
-            lineStream >> vertexShaderName >> fragmentShaderName;
 
-            std::string hlslVert = vertexShaderName + std::string( ".obj" );
-            std::string hlslFrag = fragmentShaderName + std::string( ".obj" );
-            std::string spvVert = vertexShaderName + std::string( "_vert.spv" );
-            std::string spvFrag = fragmentShaderName + std::string( "_frag.spv" );
-            
+            TokenView vertexShaderToken, fragmentShaderToken;
+            tokenizer.NextToken( vertexShaderToken );
+            tokenizer.NextToken( fragmentShaderToken );
+
+            const std::string vertexShaderName = vertexShaderToken.ToString();
+            const std::string fragmentShaderName = fragmentShaderToken.ToString();
+            const std::string hlslVert = vertexShaderName + std::string( ".obj" );
+            const std::string hlslFrag = fragmentShaderName + std::string( ".obj" );
+            const std::string spvVert = vertexShaderName + std::string( "_vert.spv" );
+            const std::string spvFrag = fragmentShaderName + std::string( "_frag.spv" );
+
             Shader* shader = new Shader();
             shader->Load( vertexShaderName.c_str(), fragmentShaderName.c_str(),
                           FileSystem::FileContents( hlslVert.c_str() ), FileSystem::FileContents( hlslFrag.c_str() ),
                           FileSystem::FileContents( spvVert.c_str() ), FileSystem::FileContents( spvFrag.c_str() ) );
 
             outMaterials[ currentMaterialName ]->SetShader( shader );
+            break;
         }
-        else if (token == "metal_shaders")
+        case SceneToken::MetalShaders:
         {
 #if RENDERER_METAL
-            if (currentMaterialName == "")
+            if (currentMaterialName.empty())
             {
                 System::Print( "Failed to parse %s at line %d: found 'metal_shaders' but there are no materials defined before this line.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
-            
-            std::string vertexShaderName, fragmentShaderName;
-            lineStream >> vertexShaderName >> fragmentShaderName;
+
+            TokenView vertexShaderName, fragmentShaderName;
+            tokenizer.NextToken( vertexShaderName );
+            tokenizer.NextToken( fragmentShaderName );
 
             Shader* shader = new Shader();
-            shader->Load(   vertexShaderName.c_str(), fragmentShaderName.c_str(),
+            shader->Load(   vertexShaderName.ToString().c_str(), fragmentShaderName.ToString().c_str(),
                             FileSystem::FileContents( "unlit.hlsl" ), FileSystem::FileContents( "unlit.hlsl" ),
                             FileSystem::FileContents( "unlit_vert.spv" ), FileSystem::FileContents( "unlit_frag.spv" ) );
 
             outMaterials[ currentMaterialName ]->SetShader( shader );
 #endif
+            break;
         }
-        else
+        case SceneToken::Unknown:
         {
-            System::Print( "Scene parser: Unhandled token '%s' at line %d\n", token.c_str(), lineNo );
+            System::Print( "Scene parser: Unhandled token '%s' at line %d\n", tokenView.ToString().c_str(), lineNo );
+            break;
+        }
         }
     }
 
@@ -1942,7 +2961,7 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
         if (mr)
         {
             const unsigned subMeshCount = mr->GetMesh()->GetSubMeshCount();
-            
+
             for (unsigned i = 0; i < subMeshCount; ++i)
             {
                 if (!mr->GetMaterial( i ))
@@ -1952,69 +2971,325 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             }
         }
     }
-    
+
     return DeserializeResult::Success;
 }
 
-void ae3d::Scene::GenerateAABB()
+ae3d::Scene::DeserializeResult ae3d::Scene::DeserializeBinary( const unsigned char* data, std::size_t size, const char* path, std::vector< GameObject >& outGameObjects,
+                                                              std::map< std::string, Texture2D* >& outTexture2Ds,
+                                                              std::map< std::string, Material* >& outMaterials,
+                                                              Array< Mesh* >& outMeshes ) const
 {
-    Statistics::BeginSceneAABB();
-    
-    const float maxValue = 99999999.0f;
-    aabbMin = {  maxValue,  maxValue,  maxValue };
-    aabbMax = { -maxValue, -maxValue, -maxValue };
-    
-    for (auto& o : gameObjects)
+    outGameObjects.clear();
+
+    SceneFormat::FileHeader header;
+
+    if (data == nullptr || size < sizeof( header ))
+    {
+        System::Print( "Failed to parse %s: contents are too small for a binary scene.\n", path );
+        return DeserializeResult::ParseError;
+    }
+
+    std::memcpy( &header, data, sizeof( header ) );
+
+    if (std::memcmp( header.magic, SceneFormat::Magic, sizeof( header.magic ) ) != 0)
+    {
+        System::Print( "Failed to parse %s: contents are not a binary scene.\n", path );
+        return DeserializeResult::ParseError;
+    }
+
+    if (header.version != SceneFormat::Version)
+    {
+        System::Print( "Failed to parse %s: binary scene version is %u but only version %u is supported.\n", path, header.version, SceneFormat::Version );
+        return DeserializeResult::ParseError;
+    }
+
+    if (header.recordsOffset < sizeof( header ) || header.recordsOffset > header.stringTableOffset || header.stringTableOffset > size ||
+        header.stringTableSize > size - header.stringTableOffset)
+    {
+        System::Print( "Failed to parse %s: binary scene header has invalid offsets.\n", path );
+        return DeserializeResult::ParseError;
+    }
+
+    // Every game object is a record, and every record has at least a header, so the counts can't be larger than this.
+    if (header.gameObjectCount > header.recordCount ||
+        header.recordCount > (header.stringTableOffset - header.recordsOffset) / sizeof( SceneFormat::RecordHeader ))
+    {
+        System::Print( "Failed to parse %s: binary scene header has invalid counts.\n", path );
+        return DeserializeResult::ParseError;
+    }
+
+    const char* strings = reinterpret_cast< const char* >( data + header.stringTableOffset );
+
+    auto getString = [ strings, &header ]( const SceneFormat::StringRef& ref ) -> const char*
     {
-        if (!o)
+        if (ref.offset >= header.stringTableSize || ref.length >= header.stringTableSize - ref.offset || strings[ ref.offset + ref.length ] != '\0')
         {
-            continue;
+            return nullptr;
+        }
+
+        return strings + ref.offset;
+    };
+
+    Material* tempMaterial = CreateTempMaterial( outMaterials );
+
+    // Strings are deduplicated by the writer, so renderers that share a mesh path share its string offset.
+    std::unordered_map< std::uint32_t, Mesh* > meshPathOffsetToMesh;
+
+    // Prevents copying game objects when the vector grows. Copying would give them new components.
+    outGameObjects.reserve( outGameObjects.size() + header.gameObjectCount );
+    unsigned gameObjectCount = 0;
+
+    const unsigned char* cursor = data + header.recordsOffset;
+    const unsigned char* const recordsEnd = data + header.stringTableOffset;
+
+    for (unsigned recordIndex = 0; recordIndex < header.recordCount; ++recordIndex)
+    {
+        SceneFormat::RecordHeader recordHeader;
+
+        if (static_cast< std::size_t >( recordsEnd - cursor ) < sizeof( recordHeader ))
+        {
+            System::Print( "Failed to parse %s: record %u is past the end of records.\n", path, recordIndex );
+            return DeserializeResult::ParseError;
+        }
+
+        std::memcpy( &recordHeader, cursor, sizeof( recordHeader ) );
+
+        if (recordHeader.size < sizeof( recordHeader ) || recordHeader.size > static_cast< std::size_t >( recordsEnd - cursor ) ||
+            recordHeader.size < GetRecordSize( recordHeader.type ))
+        {
+            System::Print( "Failed to parse %s: record %u has invalid size %u.\n", path, recordIndex, recordHeader.size );
+            return DeserializeResult::ParseError;
         }
 
-        auto meshRenderer = o->GetComponent< ae3d::MeshRendererComponent >();
-        auto meshTransform = o->GetComponent< ae3d::TransformComponent >();
+        const unsigned char* const record = cursor;
+        cursor += recordHeader.size;
 
-        if (meshRenderer == nullptr || meshTransform == nullptr)
+        if (recordHeader.type == SceneFormat::RecordType::GameObject)
         {
+            const auto goRecord = ReadRecord< SceneFormat::GameObjectRecord >( record );
+            const char* name = getString( goRecord.name );
+
+            if (name == nullptr)
+            {
+                System::Print( "Failed to parse %s: record %u has an invalid name.\n", path, recordIndex );
+                return DeserializeResult::ParseError;
+            }
+
+            if (gameObjectCount == header.gameObjectCount)
+            {
+                System::Print( "Failed to parse %s: record %u is past the header's %u game objects.\n", path, recordIndex, header.gameObjectCount );
+                return DeserializeResult::ParseError;
+            }
+
+            ++gameObjectCount;
+            outGameObjects.push_back( GameObject() );
+            outGameObjects.back().SetName( name );
+            outGameObjects.back().SetLayer( goRecord.layer );
+            outGameObjects.back().SetEnabled( goRecord.enabled != 0 );
             continue;
         }
-        
-        Vec3 oAABBmin = meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetAABBMin() : Vec3( -1, -1, -1 );
-        Vec3 oAABBmax = meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetAABBMax() : Vec3(  1,  1,  1 );
-        
-        Matrix44::TransformPoint( oAABBmin, meshTransform->GetLocalToWorldMatrix(), &oAABBmin );
-        Matrix44::TransformPoint( oAABBmax, meshTransform->GetLocalToWorldMatrix(), &oAABBmax );
-        
-        if (oAABBmin.x < aabbMin.x)
+
+        if (outGameObjects.empty())
         {
-            aabbMin.x = oAABBmin.x;
+            System::Print( "Failed to parse %s: found component record %u but there are no game objects defined before it.\n", path, recordIndex );
+            return DeserializeResult::ParseError;
         }
-        
-        if (oAABBmin.y < aabbMin.y)
+
+        GameObject& go = outGameObjects.back();
+
+        switch (recordHeader.type)
+        {
+        case SceneFormat::RecordType::Transform:
         {
-            aabbMin.y = oAABBmin.y;
+            const auto transformRecord = ReadRecord< SceneFormat::TransformRecord >( record );
+            go.AddComponent< TransformComponent >();
+            TransformComponent* transform = go.GetComponent< TransformComponent >();
+            transform->SetLocalPosition( { transformRecord.position[ 0 ], transformRecord.position[ 1 ], transformRecord.position[ 2 ] } );
+            transform->SetLocalRotation( { { transformRecord.rotation[ 0 ], transformRecord.rotation[ 1 ], transformRecord.rotation[ 2 ] }, transformRecord.rotation[ 3 ] } );
+            transform->SetLocalScale( transformRecord.scale );
+            transform->SetEnabled( transformRecord.enabled != 0 );
+            break;
         }
-        
-        if (oAABBmin.z < aabbMin.z)
+        case SceneFormat::RecordType::Camera:
         {
-            aabbMin.z = oAABBmin.z;
+            const auto cameraRecord = ReadRecord< SceneFormat::CameraRecord >( record );
+            go.AddComponent< CameraComponent >();
+            CameraComponent* camera = go.GetComponent< CameraComponent >();
+
+            // Both projections are restored so that switching the type later works. The active one is set last.
+            if (cameraRecord.isPerspective != 0)
+            {
+                camera->SetProjection( cameraRecord.orthoLeft, cameraRecord.orthoRight, cameraRecord.orthoBottom, cameraRecord.orthoTop, cameraRecord.nearp, cameraRecord.farp );
+                camera->SetProjection( cameraRecord.fovDegrees, cameraRecord.aspect, cameraRecord.nearp, cameraRecord.farp );
+                camera->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+            }
+            else
+            {
+                camera->SetProjection( cameraRecord.fovDegrees, cameraRecord.aspect, cameraRecord.nearp, cameraRecord.farp );
+                camera->SetProjection( cameraRecord.orthoLeft, cameraRecord.orthoRight, cameraRecord.orthoBottom, cameraRecord.orthoTop, cameraRecord.nearp, cameraRecord.farp );
+                camera->SetProjectionType( CameraComponent::ProjectionType::Orthographic );
+            }
+
+            camera->SetLayerMask( cameraRecord.layerMask );
+            camera->SetRenderOrder( cameraRecord.renderOrder );
+            camera->SetViewport( cameraRecord.viewport[ 0 ], cameraRecord.viewport[ 1 ], cameraRecord.viewport[ 2 ], cameraRecord.viewport[ 3 ] );
+            camera->SetClearColor( { cameraRecord.clearColor[ 0 ], cameraRecord.clearColor[ 1 ], cameraRecord.clearColor[ 2 ] } );
+            camera->SetEnabled( cameraRecord.enabled != 0 );
+            break;
         }
-        
-        if (oAABBmax.x > aabbMax.x)
+        case SceneFormat::RecordType::MeshRenderer:
         {
-            aabbMax.x = oAABBmax.x;
+            const auto meshRendererRecord = ReadRecord< SceneFormat::MeshRendererRecord >( record );
+            const char* meshPath = getString( meshRendererRecord.meshPath );
+
+            if (meshPath == nullptr)
+            {
+                System::Print( "Failed to parse %s: record %u has an invalid mesh path.\n", path, recordIndex );
+                return DeserializeResult::ParseError;
+            }
+
+            go.AddComponent< MeshRendererComponent >();
+            MeshRendererComponent* meshRenderer = go.GetComponent< MeshRendererComponent >();
+
+            if (meshRendererRecord.meshPath.length > 0)
+            {
+                Mesh*& mesh = meshPathOffsetToMesh[ meshRendererRecord.meshPath.offset ];
+
+                if (mesh == nullptr)
+                {
+                    mesh = new Mesh();
+                    mesh->Load( FileSystem::FileContents( meshPath ) );
+                    outMeshes.Add( mesh );
+                }
+
+                meshRenderer->SetMesh( mesh );
+
+                for (unsigned i = 0; i < mesh->GetSubMeshCount(); ++i)
+                {
+                    meshRenderer->SetMaterial( tempMaterial, i );
+                }
+            }
+
+            meshRenderer->SetCastShadow( meshRendererRecord.castShadow != 0 );
+            meshRenderer->SetEnabled( meshRendererRecord.enabled != 0 );
+            break;
         }
-        
-        if (oAABBmax.y > aabbMax.y)
+        case SceneFormat::RecordType::MeshRendererLod:
+        {
+            const auto lodRecord = ReadRecord< SceneFormat::MeshRendererLodRecord >( record );
+            const char* meshPath = getString( lodRecord.meshPath );
+            MeshRendererComponent* meshRenderer = go.GetComponent< MeshRendererComponent >();
+
+            if (meshPath == nullptr || lodRecord.meshPath.length == 0 || meshRenderer == nullptr || meshRenderer->GetMesh() == nullptr)
+            {
+                System::Print( "Failed to parse %s: LOD record %u has an invalid mesh path or its game object doesn't have a mesh renderer component with a mesh.\n", path, recordIndex );
+                return DeserializeResult::ParseError;
+            }
+
+            Mesh*& mesh = meshPathOffsetToMesh[ lodRecord.meshPath.offset ];
+
+            if (mesh == nullptr)
+            {
+                mesh = new Mesh();
+                mesh->Load( FileSystem::FileContents( meshPath ) );
+                outMeshes.Add( mesh );
+            }
+
+            meshRenderer->AddLod( mesh, lodRecord.screenSize );
+            meshRenderer->SetLodHysteresis( lodRecord.hysteresis );
+            break;
+        }
+        case SceneFormat::RecordType::SpriteRenderer:
         {
-            aabbMax.y = oAABBmax.y;
+            const auto spriteRendererRecord = ReadRecord< SceneFormat::SpriteRendererRecord >( record );
+            go.AddComponent< SpriteRendererComponent >();
+            go.GetComponent< SpriteRendererComponent >()->SetEnabled( spriteRendererRecord.enabled != 0 );
+            break;
         }
-        
-        if (oAABBmax.z > aabbMax.z)
+        case SceneFormat::RecordType::Sprite:
+        {
+            const auto spriteRecord = ReadRecord< SceneFormat::SpriteRecord >( record );
+            const char* spritePath = getString( spriteRecord.path );
+
+            if (spritePath == nullptr || !go.GetComponent< SpriteRendererComponent >())
+            {
+                System::Print( "Failed to parse %s: sprite record %u has an invalid path or its game object doesn't have a sprite renderer component.\n", path, recordIndex );
+                return DeserializeResult::ParseError;
+            }
+
+            Texture2D*& texture = outTexture2Ds[ spritePath ];
+
+            if (texture == nullptr)
+            {
+                texture = new Texture2D();
+                texture->Load( FileSystem::FileContents( spritePath ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
+            }
+
+            go.GetComponent< SpriteRendererComponent >()->SetTexture( texture, Vec3( spriteRecord.x, spriteRecord.y, 0 ), Vec3( spriteRecord.width, spriteRecord.height, 1 ), Vec4( 1, 1, 1, 1 ) );
+            break;
+        }
+        case SceneFormat::RecordType::DirectionalLight:
+        {
+            const auto lightRecord = ReadRecord< SceneFormat::DirectionalLightRecord >( record );
+            go.AddComponent< DirectionalLightComponent >();
+            DirectionalLightComponent* light = go.GetComponent< DirectionalLightComponent >();
+            light->SetColor( { lightRecord.color[ 0 ], lightRecord.color[ 1 ], lightRecord.color[ 2 ] } );
+            light->SetCastShadow( lightRecord.castShadow != 0, 1024 );
+            light->SetEnabled( lightRecord.enabled != 0 );
+            break;
+        }
+        case SceneFormat::RecordType::SpotLight:
+        {
+            const auto lightRecord = ReadRecord< SceneFormat::SpotLightRecord >( record );
+            go.AddComponent< SpotLightComponent >();
+            SpotLightComponent* light = go.GetComponent< SpotLightComponent >();
+            light->SetColor( { lightRecord.color[ 0 ], lightRecord.color[ 1 ], lightRecord.color[ 2 ] } );
+            light->SetConeAngle( lightRecord.coneAngleDegrees );
+            light->SetRadius( lightRecord.radius );
+            light->SetCastShadow( lightRecord.castShadow != 0, 1024 );
+            light->SetEnabled( lightRecord.enabled != 0 );
+            break;
+        }
+        case SceneFormat::RecordType::PointLight:
+        {
+            const auto lightRecord = ReadRecord< SceneFormat::PointLightRecord >( record );
+            go.AddComponent< PointLightComponent >();
+            PointLightComponent* light = go.GetComponent< PointLightComponent >();
+            light->SetColor( { lightRecord.color[ 0 ], lightRecord.color[ 1 ], lightRecord.color[ 2 ] } );
+            light->SetRadius( lightRecord.radius );
+            light->SetCastShadow( lightRecord.castShadow != 0, 1024 );
+            light->SetEnabled( lightRecord.enabled != 0 );
+            break;
+        }
+        case SceneFormat::RecordType::ParticleSystem:
+        {
+            const auto particleRecord = ReadRecord< SceneFormat::ParticleSystemRecord >( record );
+            go.AddComponent< ParticleSystemComponent >();
+            go.GetComponent< ParticleSystemComponent >()->SetColor( particleRecord.color[ 0 ], particleRecord.color[ 1 ], particleRecord.color[ 2 ] );
+            go.GetComponent< ParticleSystemComponent >()->SetEnabled( particleRecord.enabled != 0 );
+            break;
+        }
+        case SceneFormat::RecordType::DecalRenderer:
+        {
+            const auto decalRecord = ReadRecord< SceneFormat::DecalRendererRecord >( record );
+            go.AddComponent< DecalRendererComponent >();
+            go.GetComponent< DecalRendererComponent >()->SetEnabled( decalRecord.enabled != 0 );
+            break;
+        }
+        case SceneFormat::RecordType::AudioSource:
         {
-            aabbMax.z = oAABBmax.z;
+            const auto audioRecord = ReadRecord< SceneFormat::AudioSourceRecord >( record );
+            go.AddComponent< AudioSourceComponent >();
+            go.GetComponent< AudioSourceComponent >()->Set3D( audioRecord.is3D != 0 );
+            go.GetComponent< AudioSourceComponent >()->SetEnabled( audioRecord.enabled != 0 );
+            break;
+        }
+        default:
+            // Written by a newer version.
+            break;
         }
     }
-    
-    Statistics::EndSceneAABB();
+
+    return DeserializeResult::Success;
 }
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ae3d
+{
+    /**
+      Binary scene format written by Scene::GetSerializedBinary and read by Scene::DeserializeBinary.
+
+      A file starts with FileHeader, which is followed by records and a string table. Every record starts with
+      RecordHeader and has a fixed layout determined by its type, so the file can be read in place from a memory-mapped
+      file in one pass. Component records belong to the closest preceding GameObject record and Sprite records to the
+      closest preceding SpriteRenderer record and MeshRendererLod records to the closest preceding MeshRenderer record. Strings are null-terminated and referenced by their offset in the string
+      table. All values are little-endian and records are 4-byte aligned.
+
+      Increment Version when an existing record's layout changes. New record types don't need a new version, because
+      readers skip records they don't recognize using RecordHeader::size.
+     */
+    namespace SceneFormat
+    {
+        const char Magic[ 4 ] = { 'a', 'e', '3', 's' };
+        const std::uint32_t Version = 1;
+
+        struct FileHeader
+        {
+            char magic[ 4 ];
+            std::uint32_t version;
+            std::uint32_t gameObjectCount;
+            std::uint32_t recordCount;
+            std::uint32_t recordsOffset;
+            std::uint32_t stringTableOffset;
+            std::uint32_t stringTableSize;
+        };
+
+        enum class RecordType : std::uint16_t
+        {
+            GameObject, Transform, Camera, MeshRenderer, SpriteRenderer, Sprite,
+            DirectionalLight, SpotLight, PointLight, ParticleSystem, DecalRenderer, AudioSource, MeshRendererLod
+        };
+
+        struct RecordHeader
+        {
+            RecordType type;
+            std::uint16_t size; // Including the header.
+        };
+
+        struct StringRef
+        {
+            std::uint32_t offset;
+            std::uint32_t length; // Not including the null terminator.
+        };
+
+        struct GameObjectRecord
+        {
+            RecordHeader header;
+            StringRef name;
+            std::uint32_t layer;
+            std::uint32_t enabled;
+        };
+
+        struct TransformRecord
+        {
+            RecordHeader header;
+            float position[ 3 ];
+            float rotation[ 4 ]; // x, y, z, w
+            float scale;
+            std::uint32_t enabled;
+        };
+
+        struct CameraRecord
+        {
+            RecordHeader header;
+            float orthoLeft;
+            float orthoRight;
+            float orthoBottom;
+            float orthoTop;
+            float fovDegrees;
+            float aspect;
+            float nearp;
+            float farp;
+            std::uint32_t isPerspective;
+            std::uint32_t layerMask;
+            std::uint32_t renderOrder;
+            std::int32_t viewport[ 4 ];
+            float clearColor[ 3 ];
+            std::uint32_t enabled;
+        };
+
+        struct MeshRendererRecord
+        {
+            RecordHeader header;
+            StringRef meshPath; // Empty if the renderer has no mesh.
+            std::uint32_t castShadow;
+            std::uint32_t enabled;
+        };
+
+        // One per LOD added with MeshRendererComponent::AddLod, in LOD order.
+        struct MeshRendererLodRecord
+        {
+            RecordHeader header;
+            StringRef meshPath;
+            float screenSize;
+            float hysteresis; // Same in all records of a renderer.
+        };
+
+        struct SpriteRendererRecord
+        {
+            RecordHeader header;
+            std::uint32_t enabled;
+        };
+
+        struct SpriteRecord
+        {
+            RecordHeader header;
+            StringRef path;
+            float x;
+            float y;
+            float width;
+            float height;
+        };
+
+        struct DirectionalLightRecord
+        {
+            RecordHeader header;
+            float color[ 3 ];
+            std::uint32_t castShadow;
+            std::uint32_t enabled;
+        };
+
+        struct SpotLightRecord
+        {
+            RecordHeader header;
+            float color[ 3 ];
+            float coneAngleDegrees;
+            float radius;
+            std::uint32_t castShadow;
+            std::uint32_t enabled;
+        };
+
+        struct PointLightRecord
+        {
+            RecordHeader header;
+            float color[ 3 ];
+            float radius;
+            std::uint32_t castShadow;
+            std::uint32_t enabled;
+        };
+
+        struct ParticleSystemRecord
+        {
+            RecordHeader header;
+            float color[ 3 ];
+            std::uint32_t enabled;
+        };
+
+        struct DecalRendererRecord
+        {
+            RecordHeader header;
+            std::uint32_t enabled;
+        };
+
+        struct AudioSourceRecord
+        {
+            RecordHeader header;
+            std::uint32_t is3D;
+            std::uint32_t enabled;
+        };
+
+        static_assert( sizeof( FileHeader ) % 4 == 0, "Records must be 4-byte aligned" );
+        static_assert( sizeof( GameObjectRecord ) % 4 == 0 && sizeof( TransformRecord ) % 4 == 0 && sizeof( CameraRecord ) % 4 == 0 &&
+                       sizeof( MeshRendererRecord ) % 4 == 0 && sizeof( SpriteRendererRecord ) % 4 == 0 && sizeof( SpriteRecord ) % 4 == 0 &&
+                       sizeof( DirectionalLightRecord ) % 4 == 0 && sizeof( SpotLightRecord ) % 4 == 0 && sizeof( PointLightRecord ) % 4 == 0 &&
+                       sizeof( ParticleSystemRecord ) % 4 == 0 && sizeof( DecalRendererRecord ) % 4 == 0 && sizeof( AudioSourceRecord ) % 4 == 0 &&
+                       sizeof( MeshRendererLodRecord ) % 4 == 0,
+                       "Records must be 4-byte aligned" );
+    }
+}
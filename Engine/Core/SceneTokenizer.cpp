@@ -0,0 +1,384 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "SceneTokenizer.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "System.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    struct TokenEntry
+    {
+        const char* text;
+        SceneToken token;
+    };
+
+    const TokenEntry tokenEntries[] =
+    {
+        { "gameobject", SceneToken::GameObject },
+        { "name", SceneToken::Name },
+        { "layer", SceneToken::Layer },
+        { "enabled", SceneToken::Enabled },
+        { "meshrenderer_enabled", SceneToken::MeshRendererEnabled },
+        { "particlesystem_enabled", SceneToken::ParticleSystemEnabled },
+        { "decalrenderer_enabled", SceneToken::DecalRendererEnabled },
+        { "transform_enabled", SceneToken::TransformEnabled },
+        { "camera_enabled", SceneToken::CameraEnabled },
+        { "dirlight", SceneToken::DirLight },
+        { "particlesystem", SceneToken::ParticleSystem },
+        { "decalrenderer", SceneToken::DecalRenderer },
+        { "spotlight", SceneToken::SpotLight },
+        { "pointlight", SceneToken::PointLight },
+        { "dirlight_enabled", SceneToken::DirLightEnabled },
+        { "spotlight_enabled", SceneToken::SpotLightEnabled },
+        { "pointlight_enabled", SceneToken::PointLightEnabled },
+        { "shadow", SceneToken::Shadow },
+        { "camera", SceneToken::Camera },
+        { "ortho", SceneToken::Ortho },
+        { "persp", SceneToken::Persp },
+        { "projection", SceneToken::Projection },
+        { "clearcolor", SceneToken::ClearColor },
+        { "layermask", SceneToken::LayerMask },
+        { "viewport", SceneToken::Viewport },
+        { "order", SceneToken::Order },
+        { "transform", SceneToken::Transform },
+        { "meshrenderer_cast_shadow", SceneToken::MeshRendererCastShadow },
+        { "meshrenderer", SceneToken::MeshRenderer },
+        { "meshpath", SceneToken::MeshPath },
+        { "spriterenderer", SceneToken::SpriteRenderer },
+        { "sprite", SceneToken::Sprite },
+        { "position", SceneToken::Position },
+        { "rotation", SceneToken::Rotation },
+        { "scale", SceneToken::Scale },
+        { "texture2d", SceneToken::Texture2D },
+        { "material", SceneToken::Material },
+        { "mesh_material", SceneToken::MeshMaterial },
+        { "param_texture", SceneToken::ParamTexture },
+        { "audiosource", SceneToken::AudioSource },
+        { "coneangle", SceneToken::ConeAngle },
+        { "radius", SceneToken::Radius },
+        { "color", SceneToken::Color },
+        { "shaders", SceneToken::Shaders },
+        { "metal_shaders", SceneToken::MetalShaders },
+        { "meshrenderer_lod", SceneToken::MeshRendererLod },
+        { "meshrenderer_lod_hysteresis", SceneToken::MeshRendererLodHysteresis },
+    };
+
+    const unsigned HashTableSize = 128;
+
+    // The multipliers were searched so that the hash has no collisions for tokenEntries. TokenHashTable asserts that it stays that way.
+    unsigned HashToken( const char* str, std::size_t length )
+    {
+        return (static_cast< unsigned >( length ) * 22 + static_cast< unsigned char >( str[ 0 ] ) + static_cast< unsigned char >( str[ length - 1 ] ) * 47) & (HashTableSize - 1);
+    }
+
+    struct TokenHashTable
+    {
+        TokenHashTable()
+        {
+            for (unsigned i = 0; i < HashTableSize; ++i)
+            {
+                entryIndices[ i ] = -1;
+            }
+
+            for (unsigned i = 0; i < sizeof( tokenEntries ) / sizeof( tokenEntries[ 0 ] ); ++i)
+            {
+                const unsigned hash = HashToken( tokenEntries[ i ].text, std::strlen( tokenEntries[ i ].text ) );
+                System::Assert( entryIndices[ hash ] == -1, "Scene token hash collision! Change HashToken's multipliers." );
+                entryIndices[ hash ] = static_cast< int >( i );
+            }
+        }
+
+        int entryIndices[ HashTableSize ];
+    };
+
+    bool IsWhitespace( char c )
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    bool IsDigit( char c )
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // Like std::from_chars, but the whole token must be a number.
+    bool ParseFloat( const TokenView& token, float& outValue )
+    {
+        const char* str = token.data;
+        const char* const strEnd = token.data + token.length;
+
+        bool isNegative = false;
+
+        if (str != strEnd && (*str == '-' || *str == '+'))
+        {
+            isNegative = *str == '-';
+            ++str;
+        }
+
+        // Digits after the 19th don't fit into the mantissa and are below float's precision anyway.
+        std::uint64_t mantissa = 0;
+        int significantDigits = 0;
+        int exponent = 0;
+        bool hasDigits = false;
+
+        for (; str != strEnd && IsDigit( *str ); ++str)
+        {
+            hasDigits = true;
+
+            if (significantDigits < 19)
+            {
+                mantissa = mantissa * 10 + static_cast< unsigned >( *str - '0' );
+                significantDigits += mantissa != 0 ? 1 : 0;
+            }
+            else
+            {
+                ++exponent;
+            }
+        }
+
+        if (str != strEnd && *str == '.')
+        {
+            ++str;
+
+            for (; str != strEnd && IsDigit( *str ); ++str)
+            {
+                hasDigits = true;
+
+                if (significantDigits < 19)
+                {
+                    mantissa = mantissa * 10 + static_cast< unsigned >( *str - '0' );
+                    significantDigits += mantissa != 0 ? 1 : 0;
+                    --exponent;
+                }
+            }
+        }
+
+        if (!hasDigits)
+        {
+            return false;
+        }
+
+        if (str != strEnd && (*str == 'e' || *str == 'E'))
+        {
+            ++str;
+            bool isExponentNegative = false;
+
+            if (str != strEnd && (*str == '-' || *str == '+'))
+            {
+                isExponentNegative = *str == '-';
+                ++str;
+            }
+
+            if (str == strEnd)
+            {
+                return false;
+            }
+
+            int exponentValue = 0;
+
+            for (; str != strEnd && IsDigit( *str ); ++str)
+            {
+                exponentValue = exponentValue < 1000 ? exponentValue * 10 + (*str - '0') : exponentValue;
+            }
+
+            exponent += isExponentNegative ? -exponentValue : exponentValue;
+        }
+
+        if (str != strEnd)
+        {
+            return false;
+        }
+
+        // Powers up to 10^22 are exact in double, so typical values are rounded only once before the conversion to float.
+        static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                             1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        double value = static_cast< double >( mantissa );
+
+        if (exponent < 0)
+        {
+            value = -exponent <= 22 ? value / powersOf10[ -exponent ] : value * std::pow( 10.0, exponent );
+        }
+        else if (exponent > 0)
+        {
+            value = exponent <= 22 ? value * powersOf10[ exponent ] : value * std::pow( 10.0, exponent );
+        }
+
+        outValue = static_cast< float >( isNegative ? -value : value );
+        return true;
+    }
+
+    bool ParseUnsigned( const char* str, const char* strEnd, std::uint64_t maxValue, std::uint64_t& outValue )
+    {
+        if (str == strEnd)
+        {
+            return false;
+        }
+
+        std::uint64_t value = 0;
+
+        for (; str != strEnd; ++str)
+        {
+            if (!IsDigit( *str ))
+            {
+                return false;
+            }
+
+            value = value * 10 + static_cast< unsigned >( *str - '0' );
+
+            if (value > maxValue)
+            {
+                return false;
+            }
+        }
+
+        outValue = value;
+        return true;
+    }
+}
+
+bool ae3d::TokenView::operator==( const char* str ) const
+{
+    return std::strncmp( data, str, length ) == 0 && str[ length ] == '\0';
+}
+
+ae3d::SceneToken ae3d::LookupSceneToken( const TokenView& token )
+{
+    static const TokenHashTable hashTable;
+
+    if (token.length == 0)
+    {
+        return SceneToken::Unknown;
+    }
+
+    const int entryIndex = hashTable.entryIndices[ HashToken( token.data, token.length ) ];
+
+    if (entryIndex == -1 || !(token == tokenEntries[ entryIndex ].text))
+    {
+        return SceneToken::Unknown;
+    }
+
+    return tokenEntries[ entryIndex ].token;
+}
+
+ae3d::SceneTokenizer::SceneTokenizer( const unsigned char* data, std::size_t size )
+    : cursor( reinterpret_cast< const char* >( data ) )
+    , lineEnd( cursor )
+    , nextLine( cursor )
+    , end( cursor + size )
+{
+}
+
+bool ae3d::SceneTokenizer::NextLine()
+{
+    if (nextLine == end)
+    {
+        return false;
+    }
+
+    cursor = nextLine;
+    lineEnd = static_cast< const char* >( std::memchr( cursor, '\n', static_cast< std::size_t >( end - cursor ) ) );
+
+    if (lineEnd == nullptr)
+    {
+        lineEnd = end;
+        nextLine = end;
+    }
+    else
+    {
+        nextLine = lineEnd + 1;
+    }
+
+    ++lineNumber;
+    return true;
+}
+
+bool ae3d::SceneTokenizer::NextToken( TokenView& outToken )
+{
+    while (cursor != lineEnd && IsWhitespace( *cursor ))
+    {
+        ++cursor;
+    }
+
+    if (cursor == lineEnd)
+    {
+        return false;
+    }
+
+    outToken.data = cursor;
+
+    while (cursor != lineEnd && !IsWhitespace( *cursor ))
+    {
+        ++cursor;
+    }
+
+    outToken.length = static_cast< std::size_t >( cursor - outToken.data );
+    return true;
+}
+
+bool ae3d::SceneTokenizer::NextFloat( float& outValue )
+{
+    TokenView token;
+    return NextToken( token ) && ParseFloat( token, outValue );
+}
+
+bool ae3d::SceneTokenizer::NextInt( int& outValue )
+{
+    TokenView token;
+
+    if (!NextToken( token ))
+    {
+        return false;
+    }
+
+    const bool isNegative = token.data[ 0 ] == '-';
+    const char* digits = (isNegative || token.data[ 0 ] == '+') ? token.data + 1 : token.data;
+    std::uint64_t value = 0;
+
+    if (!ParseUnsigned( digits, token.data + token.length, isNegative ? 2147483648u : 2147483647u, value ))
+    {
+        return false;
+    }
+
+    outValue = isNegative ? static_cast< int >( -static_cast< std::int64_t >( value ) ) : static_cast< int >( value );
+    return true;
+}
+
+bool ae3d::SceneTokenizer::NextUnsigned( unsigned& outValue )
+{
+    TokenView token;
+    std::uint64_t value = 0;
+
+    if (!NextToken( token ) || !ParseUnsigned( token.data, token.data + token.length, 4294967295u, value ))
+    {
+        return false;
+    }
+
+    outValue = static_cast< unsigned >( value );
+    return true;
+}
+
+ae3d::TokenView ae3d::SceneTokenizer::GetRestOfLine()
+{
+    while (cursor != lineEnd && IsWhitespace( *cursor ))
+    {
+        ++cursor;
+    }
+
+    TokenView outRest;
+    outRest.data = cursor;
+    const char* restEnd = lineEnd;
+
+    while (restEnd != cursor && IsWhitespace( restEnd[ -1 ] ))
+    {
+        --restEnd;
+    }
+
+    outRest.length = static_cast< std::size_t >( restEnd - cursor );
+    cursor = lineEnd;
+
+    return outRest;
+}
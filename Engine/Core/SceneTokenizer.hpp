@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace ae3d
+{
+    /// Characters inside a buffer. Not null-terminated.
+    struct TokenView
+    {
+        /// \param str Null-terminated string.
+        /// \return True, if str has the same characters as this token.
+        bool operator==( const char* str ) const;
+
+        /// \return Copy of the characters.
+        std::string ToString() const { return std::string( data, length ); }
+
+        /// First character.
+        const char* data = nullptr;
+        /// Number of characters.
+        std::size_t length = 0;
+    };
+
+    /// Tokens of the textual scene format.
+    enum class SceneToken
+    {
+        Unknown, GameObject, Name, Layer, Enabled, MeshRendererEnabled, ParticleSystemEnabled, DecalRendererEnabled, TransformEnabled,
+        CameraEnabled, DirLight, ParticleSystem, DecalRenderer, SpotLight, PointLight, DirLightEnabled, SpotLightEnabled, PointLightEnabled,
+        Shadow, Camera, Ortho, Persp, Projection, ClearColor, LayerMask, Viewport, Order, Transform, MeshRendererCastShadow, MeshRenderer,
+        MeshPath, SpriteRenderer, Sprite, Position, Rotation, Scale, Texture2D, Material, MeshMaterial, ParamTexture, AudioSource,
+        ConeAngle, Radius, Color, Shaders, MetalShaders, MeshRendererLod, MeshRendererLodHysteresis
+    };
+
+    /// \param token Token.
+    /// \return Scene token or SceneToken::Unknown. Uses a perfect hash, so only one string comparison is made.
+    SceneToken LookupSceneToken( const TokenView& token );
+
+    /**
+      Splits textual scene contents into lines and whitespace-separated tokens.
+
+      Works directly on the contents without copying or allocating. Numbers are parsed without locale, so the results
+      are the same as with the "C" locale. A token must be a number as a whole to be parsed as a number.
+     */
+    class SceneTokenizer
+    {
+    public:
+        /// \param data Contents. Must outlive the tokenizer.
+        /// \param size Size of data in bytes.
+        SceneTokenizer( const unsigned char* data, std::size_t size );
+
+        /// Moves to the next line.
+        /// \return False, if there are no more lines.
+        bool NextLine();
+
+        /// \return Number of the current line, starting from 1.
+        int GetLineNumber() const { return lineNumber; }
+
+        /// \param outToken Receives the next token on the current line.
+        /// \return False, if the line has no more tokens.
+        bool NextToken( TokenView& outToken );
+
+        /// \param outValue Receives the next token as a number. Not modified on failure.
+        /// \return False, if the line has no more tokens or the token is not a number.
+        bool NextFloat( float& outValue );
+
+        /// \param outValue Receives the next token as a number. Not modified on failure.
+        /// \return False, if the line has no more tokens or the token is not an integer.
+        bool NextInt( int& outValue );
+
+        /// \param outValue Receives the next token as a number. Not modified on failure.
+        /// \return False, if the line has no more tokens or the token is not an unsigned integer.
+        bool NextUnsigned( unsigned& outValue );
+
+        /// \return Rest of the current line without leading and trailing whitespace.
+        TokenView GetRestOfLine();
+
+    private:
+        const char* cursor;
+        const char* lineEnd;
+        const char* nextLine;
+        const char* end;
+        int lineNumber = 0;
+    };
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "Matrix.hpp"
+
+namespace ae3d
+{
+    /**
+      Remembers what was rendered into a shadow map or a point light cube map face, so that Scene re-renders it only
+      when the shadow camera or the casters change.
+
+      Casters are split into static and dynamic ones, which are hashed separately. When a face has both, the static
+      casters are rendered into their own map, which is copied into the shadow map before the dynamic casters are drawn,
+      so moving dynamic casters don't re-render the static ones.
+     */
+    class ShadowCacheState
+    {
+      public:
+        /// What has to be rendered into the face.
+        enum class Action
+        {
+            None, ///< Nothing changed, the shadow map is up to date.
+            AllCasters, ///< Render all casters into the shadow map. The static casters' map is not needed.
+            DynamicCasters, ///< Copy the static casters' map and render the dynamic casters on top.
+            StaticAndDynamicCasters ///< Render the static casters' map, then do what DynamicCasters does.
+        };
+
+        /// \return hash combined with value.
+        static std::uint64_t HashCombine( std::uint64_t hash, std::uint64_t value )
+        {
+            return hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
+        }
+
+        /**
+          Stores the face's current state and returns what has to be rendered.
+
+          \param width Shadow map width. Detects recreated shadow maps.
+          \param worldToClip Shadow camera's world-to-clip matrix.
+          \param staticHash Hash of static casters' state.
+          \param dynamicHash Hash of dynamic casters' state.
+          \param hasStaticCasters True, if the face has static casters.
+          \param hasDynamicCasters True, if the face has dynamic casters.
+          \param hasStaticShadowMap True, if the static casters' map from the previous Update still exists and has this width.
+         */
+        Action Update( int width, const Matrix44& worldToClip, std::uint64_t staticHash, std::uint64_t dynamicHash,
+                       bool hasStaticCasters, bool hasDynamicCasters, bool hasStaticShadowMap )
+        {
+            const bool isLightChanged = !isValid || cachedWidth != width || std::memcmp( cachedWorldToClip.m, worldToClip.m, sizeof( worldToClip.m ) ) != 0;
+            const bool isStaticChanged = isLightChanged || cachedStaticHash != staticHash;
+            const bool isDynamicChanged = isLightChanged || cachedDynamicHash != dynamicHash;
+
+            isValid = true;
+            cachedWidth = width;
+            cachedWorldToClip = worldToClip;
+            cachedStaticHash = staticHash;
+            cachedDynamicHash = dynamicHash;
+
+            if (!isStaticChanged && !isDynamicChanged)
+            {
+                return Action::None;
+            }
+
+            // With only static or only dynamic casters, the shadow map itself is the cache.
+            if (!hasStaticCasters || !hasDynamicCasters)
+            {
+                return Action::AllCasters;
+            }
+
+            // A map that was just taken into use may have other casters.
+            return (isStaticChanged || !hasStaticShadowMap) ? Action::StaticAndDynamicCasters : Action::DynamicCasters;
+        }
+
+        /// Makes the next Update re-render the face.
+        void Invalidate() { isValid = false; }
+
+      private:
+        Matrix44 cachedWorldToClip;
+        std::uint64_t cachedStaticHash = 0;
+        std::uint64_t cachedDynamicHash = 0;
+        int cachedWidth = 0;
+        bool isValid = false;
+    };
+}
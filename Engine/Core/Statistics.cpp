@@ -5,6 +5,8 @@
 namespace Statistics
 {
     int drawCalls = 0;
+    int instancedDrawCalls = 0;
+    int cachedShadowMaps = 0;
     int barrierCalls = 0;
     int fenceCalls = 0;
     int shaderBinds = 0;
@@ -15,6 +17,8 @@ namespace Statistics
     int triangleCount = 0;
     int psoBindCount = 0;
     int queueSubmitCalls = 0;
+    int uniformUploadBytes = 0;
+    int unsplitUniformUploadBytes = 0;
     float depthNormalsTimeMS = 0;
     float depthNormalsTimeGpuMS = 0;
     float shadowMapTimeMS = 0;
@@ -28,6 +32,8 @@ namespace Statistics
     float bloomGpuTimeMs = 0;
     float queueWaitTimeMs = 0;
     float frustumCullTimeMS = 0;
+    float occlusionCullTimeMS = 0;
+    int occlusionCulledCount = 0;
     float waitForPreviousFrameTimeMS = 0;
     float lightUpdateTimeMS = 0;
     float acquireNextImageTimeMS = 0;
@@ -165,6 +171,16 @@ void Statistics::IncFrustumCullTime( float ms )
     frustumCullTimeMS += ms;
 }
 
+void Statistics::IncOcclusionCullTime( float ms )
+{
+    occlusionCullTimeMS += ms;
+}
+
+void Statistics::IncOcclusionCulledCount( int count )
+{
+    occlusionCulledCount += count;
+}
+
 void Statistics::BeginLightCullerProfiling()
 {
     ae3d::GfxDevice::BeginLightCullerGpuQuery();
@@ -308,6 +324,32 @@ void Statistics::IncDrawCalls()
     ++Statistics::drawCalls;
 }
 
+void Statistics::IncInstancedDrawCalls()
+{
+    ++Statistics::instancedDrawCalls;
+}
+
+void Statistics::IncCachedShadowMaps()
+{
+    ++Statistics::cachedShadowMaps;
+}
+
+void Statistics::IncUniformUploadBytes( int uploadedBytes, int unsplitBytes )
+{
+    Statistics::uniformUploadBytes += uploadedBytes;
+    Statistics::unsplitUniformUploadBytes += unsplitBytes;
+}
+
+int Statistics::GetUniformUploadBytes()
+{
+    return Statistics::uniformUploadBytes;
+}
+
+int Statistics::GetUnsplitUniformUploadBytes()
+{
+    return Statistics::unsplitUniformUploadBytes;
+}
+
 float Statistics::GetFrameTimeMS()
 {
     return Statistics::frameTimeMS;
@@ -338,6 +380,16 @@ int Statistics::GetDrawCalls()
     return Statistics::drawCalls;
 }
 
+int Statistics::GetInstancedDrawCalls()
+{
+    return Statistics::instancedDrawCalls;
+}
+
+int Statistics::GetCachedShadowMaps()
+{
+    return Statistics::cachedShadowMaps;
+}
+
 int Statistics::GetRenderTargetBinds()
 {
     return Statistics::renderTargetBinds;
@@ -356,6 +408,8 @@ void Statistics::IncBarrierCalls()
 void Statistics::ResetFrameStatistics()
 {
     drawCalls = 0;
+    instancedDrawCalls = 0;
+    cachedShadowMaps = 0;
     barrierCalls = 0;
     fenceCalls = 0;
     shaderBinds = 0;
@@ -365,8 +419,12 @@ void Statistics::ResetFrameStatistics()
     triangleCount = 0;
     psoBindCount = 0;
     queueSubmitCalls = 0;
+    uniformUploadBytes = 0;
+    unsplitUniformUploadBytes = 0;
     queueWaitTimeMs = 0;
     frustumCullTimeMS = 0;
+    occlusionCullTimeMS = 0;
+    occlusionCulledCount = 0;
     waitForPreviousFrameTimeMS = 0;
     lightUpdateTimeMS = 0;
 
@@ -388,6 +446,16 @@ float Statistics::GetFrustumCullTimeMS()
     return frustumCullTimeMS;
 }
 
+float Statistics::GetOcclusionCullTimeMS()
+{
+    return occlusionCullTimeMS;
+}
+
+int Statistics::GetOcclusionCulledCount()
+{
+    return occlusionCulledCount;
+}
+
 void Statistics::BeginSceneAABB()
 {
     Statistics::startSceneAABBPoint = std::chrono::steady_clock::now();
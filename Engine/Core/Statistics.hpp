@@ -47,6 +47,10 @@ namespace Statistics
 
     float GetFrustumCullTimeMS();
     void IncFrustumCullTime( float ms );
+    float GetOcclusionCullTimeMS();
+    void IncOcclusionCullTime( float ms );
+    int GetOcclusionCulledCount();
+    void IncOcclusionCulledCount( int count );
     void IncQueueWaitTime( float ms );
     float GetQueueWaitTimeMS();
     void SetBloomTime( float cpuMs, float gpuMs );
@@ -56,6 +60,10 @@ namespace Statistics
     int GetCreateConstantBufferCalls();
     void IncDrawCalls();
     int GetDrawCalls();
+    void IncInstancedDrawCalls();
+    int GetInstancedDrawCalls();
+    void IncCachedShadowMaps();
+    int GetCachedShadowMaps();
     void IncRenderTargetBinds();
     int GetRenderTargetBinds();
     void ResetFrameStatistics();
@@ -73,6 +81,11 @@ namespace Statistics
     int GetPSOBindCalls();
     void IncQueueSubmitCalls();
     int GetQueueSubmitCalls();
+    /// \param uploadedBytes Bytes written into uniform buffers.
+    /// \param unsplitBytes Bytes that the same draws and dispatches would have written with one uniform block that holds all uniforms.
+    void IncUniformUploadBytes( int uploadedBytes, int unsplitBytes );
+    int GetUniformUploadBytes();
+    int GetUnsplitUniformUploadBytes();
     void SetDepthNormalsGpuTime( float timeMS );
     void SetShadowMapGpuTime( float timeMS );
     void SetLightCullerGpuTime( float timeMS );
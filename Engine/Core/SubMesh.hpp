@@ -21,10 +21,13 @@ namespace ae3d
         Vec3 aabbMax;
         VertexBuffer vertexBuffer;
         std::string name;
-        std::vector< VertexBuffer::VertexPTNTC > verticesPTNTC;
-        std::vector< VertexBuffer::VertexPTNTC_Skinned > verticesPTNTC_Skinned;
-        std::vector< VertexBuffer::VertexPTN > verticesPTN;
-        std::vector< VertexBuffer::Face > indices;
+        // Vertices and indices point into the mesh file contents, which are shared by all meshes that load the file.
+        VertexBuffer::VertexFormat vertexFormat = VertexBuffer::VertexFormat::Empty; // PTNTC, PTN or PTNTC_Skinned.
+        const void* vertices = nullptr;
+        unsigned vertexCount = 0;
+        VertexBuffer::IndexType indexType = VertexBuffer::IndexType::UInt16; // Face or Face32.
+        const void* indices = nullptr;
+        unsigned faceCount = 0;
         std::vector< Joint > joints;
     };
 }
@@ -11,9 +11,11 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <chrono>
+#include "AssetLoader.hpp"
 #include "AudioSystem.hpp"
 #include "GfxDevice.hpp"
 #include "FileWatcher.hpp"
+#include "JobSystem.hpp"
 #include "Matrix.hpp"
 #include "Renderer.hpp"
 #include "Shader.hpp"
@@ -94,8 +96,19 @@ float ae3d::System::SecondsSinceStartup()
 
 void ae3d::System::Deinit()
 {
+    AssetLoader::Deinit();
     GfxDevice::ReleaseGPUObjects();
     AudioSystem::Deinit();
+    JobSystem::Deinit();
+}
+
+unsigned ae3d::System::PrewarmPipelines()
+{
+#if RENDERER_VULKAN
+    return GfxDevice::PrewarmPSOs();
+#else
+    return 0;
+#endif
 }
 
 void ae3d::System::MapUIVertexBuffer( int vertexSize, int indexSize, void** outMappedVertices, void** outMappedIndices )
@@ -160,6 +173,7 @@ void ae3d::System::LoadBuiltinAssets()
     renderer.GenerateQuadBuffer();
     renderer.GenerateSkybox();
     renderer.GenerateTextures();
+    JobSystem::Init();
     
     startTimeStamp = (long double)std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::system_clock::now().time_since_epoch() ).count();
 }
@@ -302,6 +316,16 @@ int ae3d::System::Statistics::GetDrawCallCount()
     return ::Statistics::GetDrawCalls();
 }
 
+int ae3d::System::Statistics::GetInstancedDrawCallCount()
+{
+    return ::Statistics::GetInstancedDrawCalls();
+}
+
+int ae3d::System::Statistics::GetCachedShadowMapCount()
+{
+    return ::Statistics::GetCachedShadowMaps();
+}
+
 int ae3d::System::Statistics::GetRenderTargetBindCount()
 {
     return ::Statistics::GetRenderTargetBinds();
@@ -327,6 +351,11 @@ int ae3d::System::Statistics::GetFenceCallCount()
     return ::Statistics::GetFenceCalls();
 }
 
+int ae3d::System::Statistics::GetOcclusionCulledCount()
+{
+    return ::Statistics::GetOcclusionCulledCount();
+}
+
 void ae3d::System::RunUnitTests()
 {
     const bool isPowerOfTwo2 = MathUtil::IsPowerOfTwo( 2 );
@@ -0,0 +1,454 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "TriangleBVH.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "JobSystem.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    const unsigned BinCount = 16;
+    const unsigned MaxLeafTriangles = 8; // Leaves at MaxDepth can have more.
+    const unsigned MaxDepth = 64; // Limits the traversal stack size.
+    const unsigned ParallelMinTriangles = 32 * 1024; // Subtrees with fewer triangles are built on one thread.
+    const float NoHit = std::numeric_limits< float >::max();
+
+    struct Bounds
+    {
+        Vec3 min = Vec3( NoHit, NoHit, NoHit );
+        Vec3 max = Vec3( -NoHit, -NoHit, -NoHit );
+
+        void Add( const Vec3& point )
+        {
+            min = Vec3::Min2( min, point );
+            max = Vec3::Max2( max, point );
+        }
+
+        void Add( const Bounds& bounds )
+        {
+            min = Vec3::Min2( min, bounds.min );
+            max = Vec3::Max2( max, bounds.max );
+        }
+
+        // Half of the surface area, which is enough for comparing split costs.
+        float GetHalfArea() const
+        {
+            const Vec3 size = max - min;
+            return size.x < 0 ? 0 : size.x * size.y + size.y * size.z + size.z * size.x;
+        }
+    };
+
+    float GetAxis( const Vec3& v, unsigned axis )
+    {
+        return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    }
+
+    // Compared as floats, so large values don't overflow the cast.
+    unsigned GetBin( float value, float axisMin, float binScale )
+    {
+        const float bin = (value - axisMin) * binScale;
+        return bin < BinCount - 1 ? static_cast< unsigned >( bin ) : BinCount - 1;
+    }
+
+    // Distance to the box or NoHit. Zero direction components were replaced with tiny ones, so there are no NaNs.
+    float IntersectBox( const Vec3& aabbMin, const Vec3& aabbMax, const Vec3& origin, const Vec3& inverseDirection, float maxDistance )
+    {
+        const float tx1 = (aabbMin.x - origin.x) * inverseDirection.x;
+        const float tx2 = (aabbMax.x - origin.x) * inverseDirection.x;
+        const float ty1 = (aabbMin.y - origin.y) * inverseDirection.y;
+        const float ty2 = (aabbMax.y - origin.y) * inverseDirection.y;
+        const float tz1 = (aabbMin.z - origin.z) * inverseDirection.z;
+        const float tz2 = (aabbMax.z - origin.z) * inverseDirection.z;
+
+        const float tMin = std::max( std::max( std::min( tx1, tx2 ), std::min( ty1, ty2 ) ), std::max( std::min( tz1, tz2 ), 0.0f ) );
+        const float tMax = std::min( std::min( std::max( tx1, tx2 ), std::max( ty1, ty2 ) ), std::min( std::max( tz1, tz2 ), maxDistance ) );
+
+        return tMin <= tMax ? tMin : NoHit;
+    }
+
+    // Möller-Trumbore. Returns the distance or NoHit.
+    float IntersectTriangle( const Vec3* vertices, const Vec3& origin, const Vec3& direction )
+    {
+        const Vec3 e1 = vertices[ 1 ] - vertices[ 0 ];
+        const Vec3 e2 = vertices[ 2 ] - vertices[ 0 ];
+        const Vec3 h = Vec3::Cross( direction, e2 );
+        const float a = Vec3::Dot( e1, h );
+
+        if (a == 0)
+        {
+            return NoHit;
+        }
+
+        const float f = 1.0f / a;
+        const Vec3 s = origin - vertices[ 0 ];
+        const float u = f * Vec3::Dot( s, h );
+
+        if (u < 0 || u > 1)
+        {
+            return NoHit;
+        }
+
+        const Vec3 q = Vec3::Cross( s, e1 );
+        const float v = f * Vec3::Dot( direction, q );
+
+        if (v < 0 || u + v > 1)
+        {
+            return NoHit;
+        }
+
+        const float t = f * Vec3::Dot( e2, q );
+        return t >= 0 ? t : NoHit;
+    }
+}
+
+struct TriangleBVH::BuildContext
+{
+    const Bounds* triangleBounds;
+    const Vec3* centroids;
+    unsigned* indices; // Partitioned in place. Subtrees built on different threads use different ranges.
+};
+
+void TriangleBVH::Build( const Vec3* aTriangles, unsigned triangleCount )
+{
+    nodes.clear();
+    triangles.clear();
+    triangleIndices.resize( triangleCount );
+
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    std::vector< Bounds > triangleBounds( triangleCount );
+    std::vector< Vec3 > centroids( triangleCount );
+
+    auto computeBounds = [ & ]( unsigned first, unsigned last )
+    {
+        for (unsigned i = first; i < last; ++i)
+        {
+            for (unsigned v = 0; v < 3; ++v)
+            {
+                triangleBounds[ i ].Add( aTriangles[ i * 3 + v ] );
+            }
+
+            centroids[ i ] = (triangleBounds[ i ].min + triangleBounds[ i ].max) * 0.5f;
+            triangleIndices[ i ] = i;
+        }
+    };
+
+    if (triangleCount >= ParallelMinTriangles)
+    {
+        JobSystem::ParallelFor( triangleCount, ParallelMinTriangles / 4, computeBounds );
+    }
+    else
+    {
+        computeBounds( 0, triangleCount );
+    }
+
+    BuildContext context;
+    context.triangleBounds = triangleBounds.data();
+    context.centroids = centroids.data();
+    context.indices = triangleIndices.data();
+
+    nodes.reserve( triangleCount / 2 );
+    nodes.resize( 1 );
+    Subdivide( context, nodes, 0, 0, triangleCount, 0 );
+    nodes.shrink_to_fit();
+
+    triangles.resize( triangleCount * 3 );
+
+    for (unsigned i = 0; i < triangleCount; ++i)
+    {
+        for (unsigned v = 0; v < 3; ++v)
+        {
+            triangles[ i * 3 + v ] = aTriangles[ triangleIndices[ i ] * 3 + v ];
+        }
+    }
+}
+
+void TriangleBVH::Subdivide( const BuildContext& context, std::vector< Node >& outNodes, unsigned nodeIndex, unsigned first, unsigned count, unsigned depth )
+{
+    Bounds bounds;
+    Bounds centroidBounds;
+
+    for (unsigned i = first; i < first + count; ++i)
+    {
+        bounds.Add( context.triangleBounds[ context.indices[ i ] ] );
+        centroidBounds.Add( context.centroids[ context.indices[ i ] ] );
+    }
+
+    outNodes[ nodeIndex ].aabbMin = bounds.min;
+    outNodes[ nodeIndex ].aabbMax = bounds.max;
+    outNodes[ nodeIndex ].firstOrChild = first;
+    outNodes[ nodeIndex ].triangleCount = count;
+
+    if (count <= 2 || depth + 1 >= MaxDepth)
+    {
+        return;
+    }
+
+    // Bins triangles by centroid on each axis and finds the split with the lowest surface area heuristic cost.
+    // Costs are relative to the node's area, with the cost of a triangle test as the unit.
+    float bestCost = NoHit;
+    unsigned bestAxis = 0;
+    unsigned bestSplit = 0;
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        const float axisMin = GetAxis( centroidBounds.min, axis );
+        const float axisExtent = GetAxis( centroidBounds.max, axis ) - axisMin;
+
+        if (axisExtent <= 0)
+        {
+            continue;
+        }
+
+        Bounds binBounds[ BinCount ];
+        unsigned binCounts[ BinCount ] = {};
+        const float binScale = BinCount / axisExtent;
+
+        for (unsigned i = first; i < first + count; ++i)
+        {
+            const unsigned triangle = context.indices[ i ];
+            const unsigned bin = GetBin( GetAxis( context.centroids[ triangle ], axis ), axisMin, binScale );
+            binBounds[ bin ].Add( context.triangleBounds[ triangle ] );
+            ++binCounts[ bin ];
+        }
+
+        // Sweeps from the right to get the area and count right of each split, then from the left to evaluate them.
+        float rightAreas[ BinCount ];
+        unsigned rightCounts[ BinCount ];
+        Bounds rightBounds;
+        unsigned rightCount = 0;
+
+        for (unsigned bin = BinCount - 1; bin > 0; --bin)
+        {
+            rightBounds.Add( binBounds[ bin ] );
+            rightCount += binCounts[ bin ];
+            rightAreas[ bin ] = rightBounds.GetHalfArea();
+            rightCounts[ bin ] = rightCount;
+        }
+
+        Bounds leftBounds;
+        unsigned leftCount = 0;
+        const float inverseArea = 1.0f / std::max( bounds.GetHalfArea(), std::numeric_limits< float >::min() );
+
+        for (unsigned split = 1; split < BinCount; ++split)
+        {
+            leftBounds.Add( binBounds[ split - 1 ] );
+            leftCount += binCounts[ split - 1 ];
+
+            if (leftCount == 0 || rightCounts[ split ] == 0)
+            {
+                continue;
+            }
+
+            const float cost = 1 + (leftBounds.GetHalfArea() * leftCount + rightAreas[ split ] * rightCounts[ split ]) * inverseArea;
+
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    unsigned leftCount = 0;
+
+    // Leaves are made when they are cheaper than the best split, unless they would be too big.
+    if (bestSplit != 0 && (bestCost < count || count > MaxLeafTriangles))
+    {
+        const float axisMin = GetAxis( centroidBounds.min, bestAxis );
+        const float binScale = BinCount / (GetAxis( centroidBounds.max, bestAxis ) - axisMin);
+        const Vec3* centroids = context.centroids;
+
+        unsigned* middle = std::partition( context.indices + first, context.indices + first + count, [ & ]( unsigned triangle )
+        {
+            return GetBin( GetAxis( centroids[ triangle ], bestAxis ), axisMin, binScale ) < bestSplit;
+        } );
+
+        leftCount = static_cast< unsigned >( middle - (context.indices + first) );
+    }
+    else if (bestSplit == 0 && count > MaxLeafTriangles)
+    {
+        // All centroids are at the same point, so any split is as good.
+        leftCount = count / 2;
+    }
+
+    if (leftCount == 0 || leftCount == count)
+    {
+        return;
+    }
+
+    outNodes[ nodeIndex ].triangleCount = 0;
+
+    if (count < ParallelMinTriangles)
+    {
+        const unsigned child = static_cast< unsigned >( outNodes.size() );
+        outNodes[ nodeIndex ].firstOrChild = child;
+        outNodes.resize( outNodes.size() + 2 );
+        Subdivide( context, outNodes, child, first, leftCount, depth + 1 );
+        Subdivide( context, outNodes, child + 1, first + leftCount, count - leftCount, depth + 1 );
+        return;
+    }
+
+    // Children are built on two threads into their own arrays, then appended. Child indices in a subtree are
+    // relative to its array, where the subtree's root is the first node.
+    std::vector< Node > subtrees[ 2 ];
+
+    JobSystem::ParallelFor( 2, 1, [ & ]( unsigned firstChild, unsigned lastChild )
+    {
+        for (unsigned c = firstChild; c < lastChild; ++c)
+        {
+            subtrees[ c ].reserve( (c == 0 ? leftCount : count - leftCount) / 2 );
+            subtrees[ c ].resize( 1 );
+            Subdivide( context, subtrees[ c ], 0, c == 0 ? first : first + leftCount, c == 0 ? leftCount : count - leftCount, depth + 1 );
+        }
+    } );
+
+    const unsigned child = static_cast< unsigned >( outNodes.size() );
+    outNodes[ nodeIndex ].firstOrChild = child;
+    outNodes.resize( outNodes.size() + 2 );
+
+    for (unsigned c = 0; c < 2; ++c)
+    {
+        const unsigned base = static_cast< unsigned >( outNodes.size() ) - 1;
+
+        for (std::size_t i = 0; i < subtrees[ c ].size(); ++i)
+        {
+            Node node = subtrees[ c ][ i ];
+
+            if (node.triangleCount == 0)
+            {
+                node.firstOrChild += base;
+            }
+
+            if (i == 0)
+            {
+                outNodes[ child + c ] = node;
+            }
+            else
+            {
+                outNodes.push_back( node );
+            }
+        }
+    }
+}
+
+bool TriangleBVH::Raycast( const Vec3& origin, const Vec3& direction, float maxDistance, float& outDistance, unsigned& outTriangle ) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const float MinComponent = 1e-20f;
+    const Vec3 inverseDirection( 1.0f / (std::fabs( direction.x ) > MinComponent ? direction.x : std::copysign( MinComponent, direction.x )),
+                                 1.0f / (std::fabs( direction.y ) > MinComponent ? direction.y : std::copysign( MinComponent, direction.y )),
+                                 1.0f / (std::fabs( direction.z ) > MinComponent ? direction.z : std::copysign( MinComponent, direction.z )) );
+
+    struct StackEntry
+    {
+        unsigned node;
+        float distance;
+    };
+
+    StackEntry stack[ MaxDepth + 1 ];
+    unsigned stackSize = 0;
+    float closest = maxDistance;
+    unsigned closestTriangle = 0;
+    bool isHit = false;
+
+    const float rootDistance = IntersectBox( nodes[ 0 ].aabbMin, nodes[ 0 ].aabbMax, origin, inverseDirection, closest );
+
+    if (rootDistance != NoHit)
+    {
+        stack[ stackSize++ ] = { 0, rootDistance };
+    }
+
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[ --stackSize ];
+
+        if (entry.distance > closest)
+        {
+            continue;
+        }
+
+        const Node& node = nodes[ entry.node ];
+
+        if (node.triangleCount > 0)
+        {
+            for (unsigned i = node.firstOrChild; i < node.firstOrChild + node.triangleCount; ++i)
+            {
+                const float distance = IntersectTriangle( &triangles[ i * 3 ], origin, direction );
+
+                if (distance <= closest)
+                {
+                    closest = distance;
+                    closestTriangle = i;
+                    isHit = true;
+                }
+            }
+
+            continue;
+        }
+
+        // The nearer child is pushed last, so it's visited first and can make the other one unnecessary.
+        const Node& child0 = nodes[ node.firstOrChild ];
+        const Node& child1 = nodes[ node.firstOrChild + 1 ];
+        const float distance0 = IntersectBox( child0.aabbMin, child0.aabbMax, origin, inverseDirection, closest );
+        const float distance1 = IntersectBox( child1.aabbMin, child1.aabbMax, origin, inverseDirection, closest );
+        const bool isFirstNearer = distance0 <= distance1;
+        const StackEntry nearEntry = { isFirstNearer ? node.firstOrChild : node.firstOrChild + 1, isFirstNearer ? distance0 : distance1 };
+        const StackEntry farEntry = { isFirstNearer ? node.firstOrChild + 1 : node.firstOrChild, isFirstNearer ? distance1 : distance0 };
+
+        if (farEntry.distance != NoHit)
+        {
+            stack[ stackSize++ ] = farEntry;
+        }
+
+        if (nearEntry.distance != NoHit)
+        {
+            stack[ stackSize++ ] = nearEntry;
+        }
+    }
+
+    if (isHit)
+    {
+        outDistance = closest;
+        outTriangle = triangleIndices[ closestTriangle ];
+    }
+
+    return isHit;
+}
+
+unsigned TriangleBVH::GetHeight() const
+{
+    if (nodes.empty())
+    {
+        return 0;
+    }
+
+    std::vector< std::pair< unsigned, unsigned > > stack( 1, std::make_pair( 0u, 0u ) );
+    unsigned height = 0;
+
+    while (!stack.empty())
+    {
+        const std::pair< unsigned, unsigned > entry = stack.back();
+        stack.pop_back();
+        height = std::max( height, entry.second );
+
+        if (nodes[ entry.first ].triangleCount == 0)
+        {
+            stack.push_back( std::make_pair( nodes[ entry.first ].firstOrChild, entry.second + 1 ) );
+            stack.push_back( std::make_pair( nodes[ entry.first ].firstOrChild + 1, entry.second + 1 ) );
+        }
+    }
+
+    return height;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include "Vec3.hpp"
+
+namespace ae3d
+{
+    /**
+      Static bounding volume hierarchy of a triangle list, used by Mesh::Raycast.
+
+      Built top-down with binned surface area heuristic splits. Nodes are 32 bytes and siblings are next to each
+      other, and triangles are stored in leaf order, so a ray touches little memory. Large inputs are built on
+      JobSystem's workers.
+     */
+    class TriangleBVH
+    {
+      public:
+        /**
+          Builds the hierarchy, replacing the old one.
+
+          \param triangles Triangle vertices, 3 for each triangle. Copied.
+          \param triangleCount Number of triangles.
+         */
+        void Build( const Vec3* triangles, unsigned triangleCount );
+
+        /**
+          Finds the closest triangle that a ray hits. Both sides of triangles are hit.
+
+          \param origin Ray origin.
+          \param direction Ray direction. Doesn't need to be normalized.
+          \param maxDistance Hits farther than this are ignored.
+          \param outDistance Hit distance in units of direction's length. Not modified if nothing was hit.
+          \param outTriangle Index of the hit triangle in the array given to Build. Not modified if nothing was hit.
+          \return True, if the ray hit a triangle.
+         */
+        bool Raycast( const Vec3& origin, const Vec3& direction, float maxDistance, float& outDistance, unsigned& outTriangle ) const;
+
+        /// \return Number of nodes, 0 if the hierarchy is empty.
+        unsigned GetNodeCount() const { return static_cast< unsigned >( nodes.size() ); }
+
+        /// \return Height of the tree, 0 if it has only one node.
+        unsigned GetHeight() const;
+
+      private:
+        struct Node
+        {
+            Vec3 aabbMin;
+            unsigned firstOrChild = 0; // First triangle for leaves, first child for inner nodes. The second child is after it.
+            Vec3 aabbMax;
+            unsigned triangleCount = 0; // 0 for inner nodes.
+        };
+
+        struct BuildContext;
+
+        static void Subdivide( const BuildContext& context, std::vector< Node >& nodes, unsigned nodeIndex, unsigned first, unsigned count, unsigned depth );
+
+        std::vector< Node > nodes; // Root is the first.
+        std::vector< Vec3 > triangles; // In leaf order.
+        std::vector< unsigned > triangleIndices; // Index given to Build for each triangle in leaf order.
+    };
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+#include "Vec3.hpp"
+
+namespace ae3d
+{
+    template< typename T > struct FrameAllocator;
+
+    /**
+     Dynamic bounding volume hierarchy of axis-aligned boxes.
+
+     Leaves store a slightly enlarged box so that small movements don't need a reinsertion.
+     The tree is kept balanced using rotations, so queries are O(log N + hits). Used by Scene for culling.
+     */
+    class AABBTree
+    {
+    public:
+        /// Invalid proxy/node index.
+        static const int NullNode = -1;
+
+        /// Inserts a box into the tree.
+        /// \param aabbMin Box minimum in world space.
+        /// \param aabbMax Box maximum in world space.
+        /// \param userData User data that is returned by queries.
+        /// \return Proxy that identifies the leaf. Used with Move and Remove.
+        int Insert( const Vec3& aabbMin, const Vec3& aabbMax, unsigned userData );
+
+        /// \param proxy Proxy returned by Insert. Becomes invalid after this call.
+        void Remove( int proxy );
+
+        /// Updates leaf's box. Does nothing if the new box is still inside the leaf's enlarged box.
+        /// \param proxy Proxy returned by Insert.
+        /// \param aabbMin New box minimum in world space.
+        /// \param aabbMax New box maximum in world space.
+        /// \return True, if the leaf was reinserted.
+        bool Move( int proxy, const Vec3& aabbMin, const Vec3& aabbMax );
+
+        /// \param proxy Proxy returned by Insert.
+        /// \return User data that was given in Insert or SetUserData.
+        unsigned GetUserData( int proxy ) const;
+
+        /// \param proxy Proxy returned by Insert.
+        /// \param userData User data that is returned by queries.
+        void SetUserData( int proxy, unsigned userData );
+
+        /// Appends user data of leaves whose box intersects the frustum.
+        /// \param frustum Frustum in world space.
+        /// \param outUserData Receives leaves' user data.
+        void Query( const class Frustum& frustum, std::vector< unsigned >& outUserData ) const;
+
+        /// Like Query above, but for scratch in the frame arena, see Core/FrameArena.hpp.
+        void Query( const class Frustum& frustum, std::vector< unsigned, FrameAllocator< unsigned > >& outUserData ) const;
+
+        /// Appends user data of leaves whose box overlaps the given box.
+        /// \param aabbMin Box minimum in world space.
+        /// \param aabbMax Box maximum in world space.
+        /// \param outUserData Receives leaves' user data.
+        void Query( const Vec3& aabbMin, const Vec3& aabbMax, std::vector< unsigned >& outUserData ) const;
+
+        /// Appends user data of leaves whose box is hit by a ray.
+        /// \param origin Ray origin in world space.
+        /// \param direction Ray direction. Doesn't need to be normalized.
+        /// \param maxDistance Boxes farther than this, in units of direction's length, are skipped.
+        /// \param outUserData Receives leaves' user data.
+        void QueryRay( const Vec3& origin, const Vec3& direction, float maxDistance, std::vector< unsigned >& outUserData ) const;
+
+        /// Appends user data of leaves whose box overlaps a sphere.
+        /// \param center Sphere center in world space.
+        /// \param radius Sphere radius.
+        /// \param outUserData Receives leaves' user data.
+        void QuerySphere( const Vec3& center, float radius, std::vector< unsigned >& outUserData ) const;
+
+        /**
+          Finds the leaves nearest to a point, nearest first. Nodes are visited in order of their distance, so only
+          leaves near the point are measured.
+
+          \param point Point in world space.
+          \param count Maximum number of leaves to find.
+          \param maxDistance Leaves farther than this are skipped.
+          \param leafDistance Returns the distance from the point to a leaf's object, given the leaf's user data, or a
+                 negative value to skip the leaf. Must not be less than the distance to the box given in Insert or Move.
+          \param outLeaves Receives distance and user data of found leaves. Cleared first.
+         */
+        void QueryNearest( const Vec3& point, unsigned count, float maxDistance, const std::function< float( unsigned userData ) >& leafDistance,
+                           std::vector< std::pair< float, unsigned > >& outLeaves ) const;
+
+        /// \return Height of the tree. 0 if the tree is empty or has only one leaf.
+        int GetHeight() const;
+
+        /// Removes all leaves.
+        void Clear();
+
+    private:
+        struct Node
+        {
+            bool IsLeaf() const { return child1 == NullNode; }
+
+            Vec3 aabbMin;
+            Vec3 aabbMax;
+            int parent = NullNode; // Also next free node when the node is in the free list.
+            int child1 = NullNode;
+            int child2 = NullNode;
+            int height = -1; // Leaf is 0, free node is -1.
+            unsigned userData = 0;
+        };
+
+        template< typename Vector > void QueryFrustum( const class Frustum& frustum, Vector& outUserData ) const;
+        int AllocateNode();
+        void FreeNode( int node );
+        void InsertLeaf( int leaf );
+        void RemoveLeaf( int leaf );
+        int Balance( int node );
+        void FixUpwards( int node );
+
+        std::vector< Node > nodes;
+        int root = NullNode;
+        int freeList = NullNode;
+    };
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include "TextureBase.hpp"
+
+namespace ae3d
+{
+    class AudioClip;
+    class Font;
+    class Mesh;
+    class Texture2D;
+
+    /**
+      Loads assets in the background. File reading and decoding happen on loader threads and the GPU/audio upload
+      happens in Update(), which must be called on the main thread, for example once per frame. Assets that are being
+      loaded keep their previous contents until they are finished, so they can be rendered while loading.
+
+      Loaded objects must stay alive until their load has finished or has been cancelled. .pak files must not be
+      loaded or unloaded while loads are pending.
+     */
+    namespace AssetLoader
+    {
+        /// State of a load.
+        enum class LoadState
+        {
+            Queued,    ///< Waiting for a loader thread.
+            Decoding,  ///< A loader thread is reading and decoding the file.
+            Decoded,   ///< Waiting for Update() to upload it.
+            Finished,  ///< Uploaded and ready to use.
+            Failed,    ///< File could not be read or decoded. The loaded object was not modified.
+            Cancelled  ///< Cancelled before it was finished. The loaded object was not modified.
+        };
+
+        /// Called from Update() on the main thread when a load has finished, failed or was cancelled.
+        using CompletionCallback = std::function< void( LoadState state ) >;
+
+        struct LoadRequest;
+
+        /// Handle to a load. Can be copied and outlive the load.
+        class LoadHandle
+        {
+          public:
+            /// \return State of the load. Invalid handles return Cancelled.
+            LoadState GetState() const;
+
+            /// \return True, if the load has finished, failed or was cancelled.
+            bool IsDone() const;
+
+            /// Cancels the load unless it has already finished. Callback is still called from Update(). Must be called on the main thread.
+            void Cancel();
+
+            /// \param aRequest Request.
+            explicit LoadHandle( const std::shared_ptr< LoadRequest >& aRequest = std::shared_ptr< LoadRequest >() ) : request( aRequest ) {}
+
+          private:
+            std::shared_ptr< LoadRequest > request;
+        };
+
+        /**
+          Loads a texture in the background. Only png, tga, jpg, bmp and gif are decoded on loader threads, other formats
+          are read on loader threads and parsed in Update().
+
+          \param texture Texture that receives the image. See Texture2D::Load for other parameters.
+          \param path Texture path.
+          \param callback Called when the load is done. Can be empty.
+          \return Handle to the load.
+         */
+        LoadHandle LoadTexture2D( Texture2D* texture, const char* path, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps,
+                                  ColorSpace colorSpace, Anisotropy anisotropy, const CompletionCallback& callback = CompletionCallback() );
+
+        /**
+          \param mesh Mesh that receives the .ae3d mesh.
+          \param path Mesh path.
+          \param callback Called when the load is done. Can be empty.
+          \return Handle to the load.
+         */
+        LoadHandle LoadMesh( Mesh* mesh, const char* path, const CompletionCallback& callback = CompletionCallback() );
+
+        /**
+          \param audioClip Audio clip that receives the .wav or .ogg clip.
+          \param path Clip path.
+          \param callback Called when the load is done. Can be empty.
+          \return Handle to the load.
+         */
+        LoadHandle LoadAudioClip( AudioClip* audioClip, const char* path, const CompletionCallback& callback = CompletionCallback() );
+
+        /**
+          Metadata is read on loader threads and parsed in Update(). The font texture can be loaded with LoadTexture2D.
+
+          \param font Font that receives the BMFont.
+          \param fontTexture Font texture.
+          \param metaPath Path to BMFont metadata.
+          \param callback Called when the load is done. Can be empty.
+          \return Handle to the load.
+         */
+        LoadHandle LoadBMFont( Font* font, Texture2D* fontTexture, const char* metaPath, const CompletionCallback& callback = CompletionCallback() );
+
+        /**
+          Uploads decoded assets and calls completion callbacks. Must be called on the main thread.
+
+          \param maxFinishCount Maximum number of loads to finish in this call, to limit the time spent in one frame.
+         */
+        void Update( unsigned maxFinishCount = ~0u );
+
+        /// \return Ratio of finished loads to all loads started since the loader was last idle, in range 0-1.
+        float GetProgress();
+
+        /// \return Number of loads that are not done.
+        unsigned GetPendingCount();
+
+        /// Cancels all loads that are not done. Must be called on the main thread.
+        void CancelAll();
+
+        /// Blocks until loader threads have nothing to decode. Update() must still be called to finish the loads.
+        void WaitForDecoding();
+
+        /// Stops loader threads and drops pending loads without calling their callbacks. Called by System::Deinit.
+        void Deinit();
+    }
+}
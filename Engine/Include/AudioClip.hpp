@@ -7,6 +7,11 @@ namespace ae3d
         struct FileContentsData;
     }
 
+    namespace AudioSystem
+    {
+        struct DecodedClip;
+    }
+
     /// Audio clip.
     class AudioClip
     {
@@ -14,6 +19,9 @@ namespace ae3d
         /// \param clipData Clip data from .wav or .ogg file.
         void Load( const FileSystem::FileContentsData& clipData );
 
+        /// \param clip Clip decoded by AudioSystem::DecodeClip. Must be called from the main thread.
+        void LoadDecoded( const AudioSystem::DecodedClip& clip );
+
         /// \return Clip's handle. 0 means that the clip is empty/not pointing to any audio clip.
         unsigned GetId() const { return handle; }
 
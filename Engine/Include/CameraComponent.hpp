@@ -158,8 +158,11 @@ namespace ae3d
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static CameraComponent* Get( unsigned index );
+        /// \return Component or null if the handle is invalid.
+        static CameraComponent* Get( unsigned handle );
+
+        /// Destroys the component. Its handle becomes invalid.
+        static void Delete( unsigned handle );
 
         Matrix44 viewToClip;
         Matrix44 worldToView;
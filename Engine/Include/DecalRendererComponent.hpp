@@ -42,8 +42,11 @@ namespace ae3d
         /* \return Component handle that uniquely identifies the instance. */
         static unsigned New();
         
-        /* \return Component at index or null if index is invalid. */
-        static DecalRendererComponent* Get( unsigned index );
+        /* \return Component or null if the handle is invalid. */
+        static DecalRendererComponent* Get( unsigned handle );
+
+        /* Destroys the component. Its handle becomes invalid. */
+        static void Delete( unsigned handle );
                 
         GameObject* gameObject = nullptr;
         Texture2D* texture = nullptr;
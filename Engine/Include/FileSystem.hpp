@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -23,17 +25,54 @@ namespace ae3d
             bool isLoaded = false;
         };
 
+        /** Read-only view of a file's contents that are mapped into memory instead of being copied. */
+        struct MappedFileData
+        {
+            /// File content bytes. Null if the file could not be mapped.
+            const unsigned char* data = nullptr;
+            /// Size of data in bytes.
+            std::size_t size = 0;
+            /// File path.
+            std::string path;
+            /// Platform-specific mapping handle. Null if the contents are inside a .pak file or the file could not be mapped.
+            void* handle = nullptr;
+            /// Keeps data valid if the file is inside a .pak file: owns a compressed entry's decompressed contents, or keeps
+            /// the .pak file mapped after UnloadPakFile. Shared by copies.
+            std::shared_ptr< const void > owner;
+        };
+
         /**
-        Reads file contents.
+        Reads file contents. Compressed .pak entries are decompressed on worker threads if they are large.
 
         \param path Path.
         */
         FileContentsData FileContents( const char* path );
 
-        /// \param path .pak file path. After this call FileContents() searches first in all loaded .pak files and if the file is not found, it's loaded without .pak file.
+        /**
+        Maps file contents into memory. Files inside loaded .pak files are returned as a view into the .pak file's
+        mapping without copying, except compressed entries, which are decompressed into memory owned by the result.
+        The contents are valid until UnmapFile is called, also if the .pak file is unloaded before that.
+
+        \param path Path.
+        */
+        MappedFileData MapFile( const char* path );
+
+        /// \param file File returned by MapFile. Its data is null after this call.
+        void UnmapFile( MappedFileData& file );
+
+        /// \param path Path.
+        /// \return Path as it's stored in FileContentsData::path and MappedFileData::path.
+        std::string GetFullPath( const char* path );
+
+        /**
+        Maps a .pak file made by CombineFiles. After this call FileContents() and MapFile() search first in all loaded .pak files
+        in load order and if the file is not found, it's loaded without .pak file. Lookup time doesn't depend on the number of files in a .pak file.
+
+        \param path .pak file path. Loading an already loaded .pak file does nothing.
+        */
         void LoadPakFile( const char* path );
 
-        /// \param path .pak file. If it was loaded, it's unloaded and FileContents() does not search files inside it.
+        /// \param path .pak file. If it was loaded, FileContents() and MapFile() don't search files inside it anymore. It's unmapped when MapFile() views into it have been unmapped.
         void UnloadPakFile( const char* path );
     }
 }
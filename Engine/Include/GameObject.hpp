@@ -11,46 +11,45 @@ namespace ae3d
         /// Invalid component index.
         static const unsigned InvalidComponentIndex = 99999999;
 
-        /// Adds a component into the game object. There can be multiple components of the same type.
+        /**
+          Adds a component into the game object. A game object can have one component of each type. Adding a component
+          whose type the game object already has keeps the existing component and prints a warning. Earlier versions
+          added another component, but GetComponent and RemoveComponent only ever reached the first one.
+         */
         template< class T > void AddComponent()
         {
-            const unsigned index = GetNextComponentIndex();
-            
-            if (index != InvalidComponentIndex)
+            ComponentEntry& component = components[ T::Type() ];
+
+            if (component.type == -1)
             {
-                components[ index ].handle = T::New();
-                components[ index ].type = T::Type();
+                component.handle = T::New();
+                component.type = T::Type();
                 GetComponent< T >()->gameObject = this;
-            }            
+            }
+            else
+            {
+                WarnDuplicateComponent( T::Type() );
+            }
         }
 
-        /// Remove a component from the game object.
+        /// Removes a component from the game object and destroys it.
         template< class T > void RemoveComponent()
         {
-            for (unsigned i = 0; i < nextFreeComponentIndex; ++i)
+            ComponentEntry& component = components[ T::Type() ];
+
+            if (component.type != -1)
             {
-                if (components[ i ].type == T::Type())
-                {
-                    GetComponent< T >()->gameObject = nullptr;
-                    components[ i ].handle = 0;
-                    components[ i ].type = -1;
-                    return;
-                }
+                T::Delete( component.handle );
+                component.handle = 0;
+                component.type = -1;
             }
         }
 
-        /// \return The first component of type T or null if there is no such component.
+        /// \return The component of type T or null if there is no such component.
         template< class T > T* GetComponent() const
         {
-            for (const auto& component : components)
-            {
-                if (T::Type() == component.type)
-                {
-                    return T::Get( component.handle );
-                }
-            }
-
-            return nullptr;
+            const ComponentEntry& component = components[ T::Type() ];
+            return component.type == -1 ? nullptr : T::Get( component.handle );
         }
 
         /// Constructor.
@@ -87,19 +86,21 @@ namespace ae3d
         std::string GetSerialized() const;
 
     private:
+        friend class Scene;
+
         struct ComponentEntry
         {
             int type = -1;
             unsigned handle = 0;
         };
 
-        unsigned GetNextComponentIndex();
+        void WarnDuplicateComponent( int type ) const;
 
-        static const int MaxComponents = 10;
-        unsigned nextFreeComponentIndex = 0;
-        ComponentEntry components[ MaxComponents ];
+        static const int MaxComponentTypes = 13;
+        ComponentEntry components[ MaxComponentTypes ]; // Indexed by component type.
         std::string name;
         unsigned layer = 1;
+        unsigned sceneIndex = InvalidComponentIndex; // Index in Scene::gameObjects, not copied.
         bool isEnabled = true;
     };
 }
@@ -12,6 +12,7 @@ namespace ae3d
 
     struct SubMesh;
     struct Vec3;
+    class TriangleBVH;
     
     /// Contains a mesh. Can contain submeshes.
     class Mesh
@@ -20,6 +21,14 @@ namespace ae3d
         /// Result of loading the mesh.
         enum class LoadResult { Success, Corrupted, OutOfMemory, FileNotFound };
 
+        /// Closest triangle hit by Raycast.
+        struct RaycastHit
+        {
+            float distance = 0; ///< Distance from the ray origin in units of the direction's length.
+            unsigned subMeshIndex = 0; ///< Submesh that was hit.
+            unsigned triangleIndex = 0; ///< Triangle in the submesh, in the order of GetSubMeshFlattenedTriangles.
+        };
+
         /// Constructor.
         Mesh();
 
@@ -38,6 +47,42 @@ namespace ae3d
         /// \param meshData Data from .ae3d mesh file.
         /// \return Load result.
         LoadResult Load( const FileSystem::FileContentsData& meshData );
+
+        /**
+          Loads a mesh by mapping the file into memory. Vertices and indices of version 2 .ae3d files are used in place
+          from the mapping, so the file stays mapped while a mesh uses it. Meshes that are loaded from the same path
+          share their CPU data. On Windows a mapped file can't be overwritten, so use the FileContentsData overload
+          for files that are hot-reloaded.
+
+          \param path Path to .ae3d mesh file.
+          \return Load result.
+         */
+        LoadResult Load( const char* path );
+
+        /**
+          Parses a mesh without creating GPU resources. Can be called from any thread, so a mesh can be decoded on a
+          worker and uploaded later on the main thread with LoadDecoded(). The decoded mesh can't be rendered.
+
+          \param meshData Data from .ae3d mesh file.
+          \return Load result.
+         */
+        LoadResult Decode( const FileSystem::FileContentsData& meshData );
+
+        /**
+          Like Decode( const FileSystem::FileContentsData& ), but maps the file like Load( const char* ).
+
+          \param path Path to .ae3d mesh file.
+          \return Load result.
+         */
+        LoadResult Decode( const char* path );
+
+        /**
+          Creates GPU resources for a mesh parsed by Decode(). Must be called from the main thread.
+
+          \param decodedMesh Mesh returned by Decode(). Its data is moved into this mesh.
+          \return Load result.
+         */
+        LoadResult LoadDecoded( Mesh& decodedMesh );
         
         /// \return Axis-aligned bounding box minimum in local coordinates.
         const Vec3& GetAABBMin() const;
@@ -58,6 +103,23 @@ namespace ae3d
         /// \param outTriangles Triangles are returned in this array.
         void GetSubMeshFlattenedTriangles( unsigned subMeshIndex, Array< Vec3 >& outTriangles ) const;
         
+        /**
+          Finds the closest triangle that a ray hits. Each submesh that the ray passes near gets a triangle bounding
+          volume hierarchy on first use. It's cached and shared by meshes that are loaded from the same file, so later
+          raycasts take microseconds even on meshes with millions of triangles. Can be called from multiple threads.
+
+          \param origin Ray origin in local coordinates.
+          \param direction Ray direction in local coordinates. Doesn't need to be normalized.
+          \param maxDistance Hits farther than this are ignored.
+          \param outHit Closest hit. Not modified if nothing was hit.
+          \return True, if the ray hit a triangle.
+         */
+        bool Raycast( const Vec3& origin, const Vec3& direction, float maxDistance, RaycastHit& outHit ) const;
+
+        /// Builds the hierarchies that Raycast uses for all submeshes, so the first raycast doesn't stall. Large
+        /// submeshes are built on JobSystem's workers, which are started if needed, so call this from the main thread.
+        void BuildRaycastHierarchies() const;
+
         /// \return Submesh count.
         unsigned GetSubMeshCount() const;
         
@@ -72,11 +134,12 @@ namespace ae3d
         Impl& m() { return reinterpret_cast<Impl&>(_storage); }
         Impl const& m() const { return reinterpret_cast<Impl const&>(_storage); }
         
-        static const std::size_t StorageSize = 1384;
+        static const std::size_t StorageSize = 16;
         static const std::size_t StorageAlign = 16;
         
         std::aligned_storage<StorageSize, StorageAlign>::type _storage = {};
         
         SubMesh* GetSubMeshes( int& outCount );
+        const TriangleBVH& GetRaycastHierarchy( unsigned subMeshIndex ) const;
     };
 }
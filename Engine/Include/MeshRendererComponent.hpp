@@ -4,6 +4,13 @@
 
 namespace ae3d
 {
+#if RENDERER_VULKAN
+    namespace GfxDevice
+    {
+        struct InstanceData;
+    }
+
+#endif
     /// Contains a Mesh. The game object must also contain a TransformComponent to be able to render the mesh.
     class MeshRendererComponent
     {
@@ -17,6 +24,13 @@ namespace ae3d
         /// \param enabled True, if the object casts shadow.
         void SetCastShadow( bool enabled ) { castShadow = enabled; }
 
+        /// \return True, if the object is a static shadow caster.
+        bool IsStaticShadowCaster() const { return isStaticShadowCaster; }
+
+        /// \param enable True, if the object rarely moves or changes. Static casters are rendered into a cached shadow map that is reused
+        ///               while they and the light don't change, and only dynamic casters are rendered on top of it. Defaults to false.
+        void SetStaticShadowCaster( bool enable ) { isStaticShadowCaster = enable; }
+
         /// \return True, if the component is enabled.
         bool IsEnabled() const { return isEnabled; }
         
@@ -51,30 +65,96 @@ namespace ae3d
 
         /// \param enable True, if the mesh will be rendered as a wireframe.
         void EnableWireframe( bool enable ) { isWireframe = enable; }
+
+        /// \return True, if the mesh can hide other meshes when the scene's occlusion culling is enabled.
+        bool IsOccluder() const { return isOccluder; }
+
+        /// \param enable True, if the mesh can hide other meshes when the scene's occlusion culling is enabled. Only opaque, non-skinned submeshes hide. Defaults to true.
+        void SetOccluder( bool enable ) { isOccluder = enable; }
+
+        /**
+          Adds a level of detail. The mesh set with SetMesh() is LOD 0 and each call adds the next, coarser LOD.
+          LODs are selected per camera from the screen size of the LOD 0 bounding sphere. LODs use the materials
+          of the same submesh indices, so a LOD must not have more submeshes than LOD 0.
+
+          \param lodMesh Mesh that is rendered below the screen size.
+          \param screenSize Height of the bounding sphere on screen as a fraction of the viewport height, below which lodMesh is used.
+                            Must be smaller than the previous LOD's.
+         */
+        void AddLod( Mesh* lodMesh, float screenSize );
+
+        /// Removes LODs added with AddLod(). LOD 0 is always used after this.
+        void ClearLods();
+
+        /// \return Number of LODs added with AddLod().
+        unsigned GetLodCount() const { return lodMeshes.count; }
+
+        /// \param index Index of a LOD added with AddLod(). Index 0 is LOD 1.
+        /// \return LOD's mesh.
+        Mesh* GetLodMesh( unsigned index ) { return index < lodMeshes.count ? lodMeshes[ index ] : nullptr; }
+
+        /// \param index Index of a LOD added with AddLod(). Index 0 is LOD 1.
+        /// \return Screen size below which the LOD is used.
+        float GetLodScreenSize( unsigned index ) const { return index < lodScreenSizes.count ? lodScreenSizes[ index ] : 0; }
+
+        /// \return LOD hysteresis.
+        float GetLodHysteresis() const { return lodHysteresis; }
+
+        /// \param hysteresis Fraction of a threshold screen size that an object must move past before it changes LOD. Avoids popping when
+        ///                   an object stays near a threshold. Defaults to 0.
+        void SetLodHysteresis( float hysteresis ) { lodHysteresis = hysteresis; }
+
+        /// \return LOD that was selected for the camera that rendered the mesh last. 0 is the mesh set with SetMesh().
+        unsigned GetCurrentLod() const { return currentLod; }
         
     private:
         friend class GameObject;
         friend class Scene;
         
-        enum class RenderType { Opaque, Transparent };
-        
         /// \return Component's type code. Must be unique for each component type.
         static int Type() { return 5; }
         
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static MeshRendererComponent* Get( unsigned index );
+        /// \return Component or null if the handle is invalid.
+        static MeshRendererComponent* Get( unsigned handle );
+
+        /// Destroys the component. Its handle becomes invalid.
+        static void Delete( unsigned handle );
+
+        /// Selects the LOD that rendering uses until the next call.
+        /// \param localToView Model-view matrix.
+        /// \param projection Camera's projection matrix.
+        /// \param lodBias Screen size is multiplied by this. Values below 1 select coarser LODs.
+        /// \param camera Camera that keeps its own LOD for hysteresis.
+        void SelectLod( const struct Matrix44& localToView, const Matrix44& projection, float lodBias, const class CameraComponent* camera );
         
         /// Applies skin
         /// \param subMeshIndex Submesh index
         void ApplySkin( unsigned subMeshIndex );
         
+        /// Makes rendering use a LOD that SelectLod() selected earlier, so a camera's passes can reuse its selection.
+        /// \param lod LOD. 0 is the mesh set with SetMesh().
+        void UseLod( unsigned lod );
+
+        /// Culls submeshes against a view's frustum. Writes the result into outVisibleMasks, so views can be culled at the same time.
+        /// \param aLodMesh Mesh whose submeshes are culled.
         /// \param cameraFrustum cameraFrustum
         /// \param localToWorld Local-to-World matrix
-        void Cull( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld );
+        /// \param outVisibleMasks Bit i % 32 of element i / 32 is set if submesh i is in the frustum and has a valid material.
+        ///                        Must have (submesh count + 31) / 32 elements.
+        /// \return True, if some submesh is visible.
+        bool CullSubMeshes( const Mesh* aLodMesh, const class Frustum& cameraFrustum, const Matrix44& localToWorld, unsigned* outVisibleMasks ) const;
+
+        /// \param culler Occlusion culler that receives opaque submeshes' triangles.
+        /// \param localToWorld Local-to-World matrix
+        /// \param maxTriangles Nothing is rasterized if the submeshes have more triangles than this.
+        /// \return Number of triangles given to the culler.
+        unsigned RasterizeOccluder( class OcclusionCuller& culler, const Matrix44& localToWorld, unsigned maxTriangles ) const;
         
+        /// Renders one submesh without culling or blending mode checks. Scene culls with CullSubMeshes() and calls this for visible submeshes.
+        /// \param subMeshIndex Submesh index.
         /// \param localToView Model-view matrix.
         /// \param localToClip Model-view-projection matrix.
         /// \param localToWorld Transforms mesh AABB from mesh-local space into world-space.
@@ -83,21 +163,47 @@ namespace ae3d
         /// \param overrideShader Override shader. Used for shadow pass.
         /// \param overrideSkinShader Override shader for skinned meshes. Used for shadow pass.
         /// \param overrideAlphaTestShader Override shader that does alpha testing. Used for shadow pass.
-        /// \param renderType Renderer type.
-        void Render( const struct Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
-                     const Matrix44& shadowView, const Matrix44& shadowProjection, class Shader* overrideShader,
-                     Shader* overrideSkinShader, Shader* overrideAlphaTestShader, RenderType renderType );
+        void RenderSubMesh( int subMeshIndex, const struct Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
+                            const Matrix44& shadowView, const Matrix44& shadowProjection, class Shader* overrideShader,
+                            Shader* overrideSkinShader, Shader* overrideAlphaTestShader );
+#if RENDERER_VULKAN
+        /// \param subMeshIndex Submesh index.
+        /// \return True, if the submesh can be rendered in an instanced draw with other renderers' same submesh and material.
+        bool IsSubMeshInstanceable( int subMeshIndex ) const;
+
+        /// Renders one submesh in an instanced draw. Used by Scene's render queue.
+        /// \param subMeshIndex Submesh index. Must be instanceable in all renderers of the instances.
+        /// \param instances Instances. Their localToShadowClip matrices are calculated here.
+        /// \param instanceCount Instance count, at most GfxDevice::MaxInstancesPerDraw.
+        /// \param shadowView Shadow camera view matrix.
+        /// \param shadowProjection Shadow camera projection matrix.
+        void RenderSubMeshInstances( int subMeshIndex, GfxDevice::InstanceData* instances, unsigned instanceCount, const Matrix44& shadowView, const Matrix44& shadowProjection );
+#endif
+
+        // LOD selected for a camera. A few cameras, like the main camera and the shadow cameras, are remembered.
+        struct CameraLod
+        {
+            const CameraComponent* camera = nullptr;
+            unsigned lod = 0;
+        };
 
         Mesh* mesh = nullptr;
+        Mesh* lodMesh = nullptr; // Selected LOD's mesh.
+        Array< Mesh* > lodMeshes;
+        Array< float > lodScreenSizes;
+        CameraLod cameraLods[ 4 ];
+        unsigned nextCameraLod = 0;
+        unsigned currentLod = 0;
+        float lodHysteresis = 0;
         Array< Material* > materials;
-        Array< bool > isSubMeshCulled;
         GameObject* gameObject = nullptr;
         int animFrame = 0;
-        bool isCulled = false;
         bool isWireframe = false;
         bool isEnabled = true;
         bool castShadow = true;
+        bool isStaticShadowCaster = false;
         bool isAabbDrawingEnabled = false;
+        bool isOccluder = true;
         int aabbLineHandle = -1;
     };
 }
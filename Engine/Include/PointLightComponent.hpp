@@ -54,8 +54,11 @@ namespace ae3d
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static PointLightComponent* Get( unsigned index );
+        /// \return Component or null if the handle is invalid.
+        static PointLightComponent* Get( unsigned handle );
+
+        /// Destroys the component. Its handle becomes invalid.
+        static void Delete( unsigned handle );
         
         RenderTexture shadowMap;
         Vec3 color{ 1, 1, 1 };
@@ -79,6 +79,9 @@ namespace ae3d
         /// \return render pass.
         VkRenderPass GetRenderPass() { return renderPass; }
 
+        /// \return Color format.
+        VkFormat GetColorFormat() const { return colorFormat; }
+
         /// \return Color image.
         VkImage GetColorImage() { return color.image; }
 
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <map>
 #include <string>
+#include "AABBTree.hpp"
 #include "Array.hpp"
 #include "Vec3.hpp"
 
@@ -12,6 +14,8 @@ namespace ae3d
     {
         struct FileContentsData;
     }
+
+    template< typename T > struct FrameAllocator;
     
     /// Contains game objects in a transform hierarchy.
     class Scene
@@ -20,14 +24,33 @@ namespace ae3d
         /// Result of GetSerialized.
         enum class DeserializeResult { Success, ParseError };
         
-        /// Adds a game object into the scene if it does not exist there already.
+        /// Adds a game object into the scene if it does not exist there already. A game object can be in one scene at a time.
         void Add( class GameObject* gameObject );
+
+        /**
+          Adds game objects into the scene. Faster than calling Add for each of them, because storage grows only once.
+
+          \param gameObjects Game objects to add. Null pointers and game objects that are already in the scene are skipped.
+          \param count Number of elements in gameObjects.
+         */
+        void AddRange( GameObject* const* gameObjects, unsigned count );
+
+        /// \return True, if gameObject is in the scene.
+        bool Contains( const GameObject* gameObject ) const;
         
         /// Ends the rendering. Called after scene.Render() and UI/line rendering etc.
         void EndFrame();
         
         /// \param gameObject Game object to remove. Does nothing if it is null or doesn't exist in the scene.
         void Remove( GameObject* gameObject );
+
+        /**
+          Removes game objects from the scene. Faster than calling Remove for each of them, because storage is compacted only once.
+
+          \param gameObjects Game objects to remove. Null pointers and game objects that are not in the scene are skipped.
+          \param count Number of elements in gameObjects.
+         */
+        void RemoveRange( GameObject* const* gameObjects, unsigned count );
         
         /// Renders the scene.
         void Render();
@@ -37,11 +60,127 @@ namespace ae3d
         
         /// \param skyTexture Skybox texture.
         void SetSkybox( class TextureCube* skyTexture );
+
+        /**
+          Hides mesh renderers that are behind the largest meshes on screen before they are rendered. The occluders are
+          rasterized on the CPU for each perspective camera, so this pays off when a lot of objects are hidden, like in
+          a city. Hidden counts are in System::Statistics. See MeshRendererComponent::SetOccluder.
+
+          \param enable True, if occlusion culling is enabled. Defaults to false.
+         */
+        void EnableOcclusionCulling( bool enable ) { isOcclusionCullingEnabled = enable; }
+
+        /// \return True, if occlusion culling is enabled.
+        bool IsOcclusionCullingEnabled() const { return isOcclusionCullingEnabled; }
+
+        /**
+          Draws opaque submeshes that share a mesh and a material with one instanced draw call. Only used with Vulkan
+          and shaders that read instance data, like the built-in Standard and unlit shaders. Skinned, wireframe and
+          bounding-box-drawing mesh renderers are drawn one by one. Instanced draw counts are in System::Statistics.
+
+          \param enable True, if instancing is enabled. Defaults to true.
+         */
+        void EnableInstancing( bool enable ) { isInstancingEnabled = enable; }
+
+        /// \return True, if instancing is enabled.
+        bool IsInstancingEnabled() const { return isInstancingEnabled; }
+
+        /// \param bias Mesh renderers' screen sizes are multiplied by this when selecting LODs for cameras. Values below 1 select coarser LODs. Defaults to 1.
+        void SetLodBias( float bias ) { lodBias = bias; }
+
+        /// \return LOD bias for cameras.
+        float GetLodBias() const { return lodBias; }
+
+        /// \param bias Like SetLodBias(), but for shadow maps, which can often use coarser LODs than cameras. Defaults to 1.
+        void SetShadowLodBias( float bias ) { shadowLodBias = bias; }
+
+        /// \return LOD bias for shadow maps.
+        float GetShadowLodBias() const { return shadowLodBias; }
+
+        /**
+          Shadow maps and point light cube map faces are only rendered when their light or a caster in them changed since
+          they were last rendered. Casters that are set as static with MeshRendererComponent::SetStaticShadowCaster() are
+          also cached separately, so when only dynamic casters change, the static ones are copied and the dynamic ones
+          rendered on top. Changes are detected from transforms, meshes and mesh renderer state. Call InvalidateShadowMaps()
+          after changing something else that affects shadows, like a caster's material.
+
+          \param enable True, if shadow maps are cached. Defaults to true.
+         */
+        void EnableShadowCaching( bool enable ) { isShadowCachingEnabled = enable; }
+
+        /// \return True, if shadow maps are cached.
+        bool IsShadowCachingEnabled() const { return isShadowCachingEnabled; }
+
+        /// Renders all shadow maps on the next frame.
+        void InvalidateShadowMaps();
+
+        /// Closest mesh triangle hit by Raycast.
+        struct RaycastHit
+        {
+            GameObject* gameObject = nullptr; ///< Game object whose mesh was hit.
+            float distance = 0; ///< World-space distance from the ray origin.
+            unsigned subMeshIndex = 0; ///< Submesh that was hit.
+            unsigned triangleIndex = 0; ///< Triangle in the submesh, see Mesh::RaycastHit.
+        };
+
+        /**
+          Updates the world-space bounds that spatial queries use from transforms that changed since the last update.
+          Render() calls this, so it's needed only when queries must see objects that moved after the last frame.
+
+          Spatial queries (Raycast, OverlapSphere, OverlapBox and FindNearest) find enabled game objects that have a
+          mesh renderer with a mesh. They can run on multiple threads at the same time, but not while the scene is
+          changed, updated or rendered.
+         */
+        void UpdateSpatialIndex();
+
+        /// Gets the world-space bounds of mesh renderers as of the last UpdateSpatialIndex or Render. Directional light shadows cover them.
+        /// \param outMin Bounds minimum. Greater than outMax if the scene has no mesh renderers.
+        /// \param outMax Bounds maximum.
+        void GetAABB( Vec3& outMin, Vec3& outMax ) const { outMin = aabbMin; outMax = aabbMax; }
+
+        /**
+          Finds the closest mesh triangle that a ray hits. Meshes build their triangle hierarchy when they are first
+          hit, see Mesh::BuildRaycastHierarchies.
+
+          \param origin Ray origin in world space.
+          \param direction Ray direction in world space. Doesn't need to be normalized.
+          \param maxDistance Hits farther than this are ignored.
+          \param layerMask Only game objects whose layer is in this mask are hit, like in CameraComponent::SetLayerMask.
+          \param outHit Closest hit. Not modified if nothing was hit.
+          \return True, if the ray hit a mesh.
+         */
+        bool Raycast( const Vec3& origin, const Vec3& direction, float maxDistance, unsigned layerMask, RaycastHit& outHit ) const;
+
+        /// Finds game objects whose world-space bounds overlap a sphere.
+        /// \param center Sphere center in world space.
+        /// \param radius Sphere radius.
+        /// \param layerMask Only game objects whose layer is in this mask are found.
+        /// \param outGameObjects Receives the game objects. Cleared first.
+        void OverlapSphere( const Vec3& center, float radius, unsigned layerMask, std::vector< GameObject* >& outGameObjects ) const;
+
+        /// Finds game objects whose world-space bounds overlap a box.
+        /// \param boxMin Box minimum in world space.
+        /// \param boxMax Box maximum in world space.
+        /// \param layerMask Only game objects whose layer is in this mask are found.
+        /// \param outGameObjects Receives the game objects. Cleared first.
+        void OverlapBox( const Vec3& boxMin, const Vec3& boxMax, unsigned layerMask, std::vector< GameObject* >& outGameObjects ) const;
+
+        /// Finds game objects whose world-space bounds are nearest to a point, nearest first.
+        /// \param point Point in world space.
+        /// \param count Maximum number of game objects to find.
+        /// \param maxDistance Game objects whose bounds are farther than this are not found.
+        /// \param layerMask Only game objects whose layer is in this mask are found.
+        /// \param outGameObjects Receives the game objects. Cleared first.
+        void FindNearest( const Vec3& point, unsigned count, float maxDistance, unsigned layerMask, std::vector< GameObject* >& outGameObjects ) const;
         
         /// \return Scene's contents in a textual format that can be saved into file etc.
         std::string GetSerialized() const;
 
+        /// \return Scene's contents in a binary format that loads faster than the textual format. See Core/SceneFormat.hpp.
+        std::vector< unsigned char > GetSerializedBinary() const;
+
         /// Deserializes a scene additively from file contents. Must be called after renderer is initialized.
+        /// Binary contents written by GetSerializedBinary are detected and passed to DeserializeBinary.
         /// \param serialized Serialized scene contents.
         /// \param outGameObjects Returns game objects that were created from serialized scene contents.
         /// \param outTexture2Ds Returns texture 2Ds that were created from serialized scene contents. Caller is responsible for freeing the memory.
@@ -52,22 +191,80 @@ namespace ae3d
                                        std::map< std::string, class Texture2D* >& outTexture2Ds,
                                        std::map< std::string, class Material* >& outMaterials,
                                        Array< class Mesh* >& outMeshes ) const;
+
+        /// Deserializes a scene additively from contents written by GetSerializedBinary. Must be called after renderer is initialized.
+        /// The contents are read in place, so they can come directly from FileSystem::MapFile.
+        /// \param data Serialized scene contents.
+        /// \param size Size of data in bytes.
+        /// \param path Path of the contents for error messages.
+        /// \param outGameObjects Returns game objects that were created from serialized scene contents.
+        /// \param outTexture2Ds Returns texture 2Ds that were created from serialized scene contents. Caller is responsible for freeing the memory.
+        /// \param outMaterials Returns materials that were created. Caller is responsible for freeing the memory.
+        /// \param outMeshes Returns meshes that were created. Caller is responsible for freeing the memory.
+        /// \return Result. Parsing stops on first error and successfully loaded game objects are returned.
+        DeserializeResult DeserializeBinary( const unsigned char* data, std::size_t size, const char* path, std::vector< GameObject >& outGameObjects,
+                                             std::map< std::string, class Texture2D* >& outTexture2Ds,
+                                             std::map< std::string, class Material* >& outMaterials,
+                                             Array< class Mesh* >& outMeshes ) const;
         
     private:
-        void RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const char* debugGroupName );
-        void RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace );
-        void RenderShadowMaps( std::vector< GameObject* >& cameras );
-        void RenderRTCameras( std::vector< GameObject* >& rtCameras );
-        void RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >& cameras );
-        void RenderDepthAndNormals( class CameraComponent* camera, const struct Matrix44& view, std::vector< unsigned > gameObjectsWithMeshRenderer,
-                                    int cubeMapFace, const class Frustum& frustum );
-        void GenerateAABB();
+        /// Scratch that is freed when the frame ends, see Core/FrameArena.hpp.
+        template< typename T > using FrameVector = std::vector< T, FrameAllocator< T > >;
+
+        /// Renders a camera view with the matrices, LODs and culling that CullViews recorded for it.
+        void RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const char* debugGroupName, const struct VisibleSet& visibleSet );
+        /// Casters of a shadow map face.
+        enum class ShadowCasters { All, Static, Dynamic };
+        /// Renders a shadow map face with the matrices, LODs and culling that CullViews recorded for it, like RenderWithCamera.
+        /// \param casters Casters of the face that are rendered.
+        /// \param staticShadowMap If not null, copied into the target before rendering, so the casters are rendered on top of it.
+        void RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace, const VisibleSet& visibleSet, ShadowCasters casters, class RenderTexture* staticShadowMap );
+        void RenderShadowMaps( const FrameVector< GameObject* >& cameras );
+        /// Renders the shadow camera's target for a light's shadow map face, unless the light and its casters didn't change.
+        void RenderCachedShadowMap( GameObject* eyeCamera, GameObject* light, int cubeMapFace );
+        void RenderRTCameras( const FrameVector< GameObject* >& rtCameras );
+        void RenderDepthAndNormalsForAllCameras( const FrameVector< GameObject* >& cameras );
+        void RenderDepthAndNormals( class CameraComponent* camera, const VisibleSet& visibleSet, int cubeMapFace );
+        /// \return True, if the game object at index is enabled and in layerMask. Used by spatial queries.
+        bool IsQueryable( unsigned index, unsigned layerMask ) const;
+        /// Recomputes aabbMin and aabbMax from the BVH entries if an object on their boundary moved or was removed. UpdateBVH grows them.
+        void UpdateAABB();
+        /// Leaves a null slot in gameObjects, so the others keep their indices and order.
+        void RemoveAt( unsigned index );
+        /// Removes null slots from gameObjects if they are over half of it. Keeps the order, which is the sprite and text drawing order.
+        void CompactGameObjects();
+        void UpdateBVH();
+        void GetVisibleMeshRenderers( const class Frustum& frustum, unsigned layerMask, bool shadowCastersOnly, FrameVector< unsigned >& outGameObjects ) const;
+        /// Culls the views of the frame and records per-view matrices, LODs and visible submeshes for camera views.
+        void CullViews( const FrameVector< GameObject* >& rtCameras, const FrameVector< GameObject* >& cameras );
+        /// Removes game objects that are hidden behind occluders chosen from them. Occluders is scratch space. \return Removed count.
+        unsigned CullOccluded( const struct Matrix44& worldToClip, const Vec3& cameraPosition, float nearDepth, class OcclusionCuller& culler,
+                               FrameVector< std::pair< float, unsigned > >& occluders, FrameVector< unsigned >& inOutGameObjects ) const;
+
+        /// Mesh renderer's world-space bounds in the BVH.
+        struct BVHEntry
+        {
+            int proxy = AABBTree::NullNode;
+            Vec3 localAabbMin;
+            Vec3 localAabbMax;
+            Vec3 aabbMinWorld; // Exact bounds, the BVH's are enlarged.
+            Vec3 aabbMaxWorld;
+            unsigned transformVersion = 0;
+        };
 
         std::vector< GameObject* > gameObjects;
-        unsigned nextFreeGameObject = 0;
+        std::vector< BVHEntry > bvhEntries; // Parallel to gameObjects.
+        AABBTree bvh; // User data is an index into gameObjects.
+        unsigned removedGameObjectCount = 0; // Null slots in gameObjects, compacted when they are half of it.
         TextureCube* skybox = nullptr;
-        Vec3 aabbMin;
+        Vec3 aabbMin; // World-space bounds of mesh renderers.
         Vec3 aabbMax;
+        bool isAABBDirty = true;
         Vec3 ambientColor = Vec3( 0.1f, 0.1f, 0.1f );
+        bool isOcclusionCullingEnabled = false;
+        bool isInstancingEnabled = true;
+        float lodBias = 1;
+        float shadowLodBias = 1;
+        bool isShadowCachingEnabled = true;
     };
 }
@@ -36,6 +36,9 @@ namespace ae3d
         void LoadSPIRV( const FileSystem::FileContentsData& vertexData, const FileSystem::FileContentsData& fragmentData );
         VkPipelineShaderStageCreateInfo& GetVertexInfo() { return vertexInfo; }
         VkPipelineShaderStageCreateInfo& GetFragmentInfo() { return fragmentInfo; }
+
+        /// \return True, if the vertex shader reads per-instance matrices from the instance buffer, so the shader can be used in instanced draws.
+        bool IsInstancingSupported() const { return isInstancingSupported; }
 #endif
         /// \param metalVertexShaderName Vertex shader name for Metal renderer. Must be referenced by the application's Xcode project.
         /// \param metalFragmentShaderName Fragment shader name for Metal renderer. Must be referenced by the application's Xcode project.
@@ -70,6 +73,9 @@ namespace ae3d
         /// \return Vertex shader path.
         const std::string& GetVertexShaderPath() const { return vertexPath; }
 
+        /// \return Fragment shader path.
+        const std::string& GetFragmentShaderPath() const { return fragmentPath; }
+
 #if RENDERER_D3D12
         bool IsValid() const { return blobShaderVertex != nullptr; }
         ID3DBlob* blobShaderVertex = nullptr;
@@ -108,6 +114,7 @@ namespace ae3d
 #if RENDERER_VULKAN
         VkPipelineShaderStageCreateInfo vertexInfo = {};
         VkPipelineShaderStageCreateInfo fragmentInfo = {};
+        bool isInstancingSupported = false;
 #endif
 #if RENDERER_METAL
         std::string metalVertexShaderName;
@@ -67,8 +67,11 @@ namespace ae3d
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static SpotLightComponent* Get( unsigned index );
+        /// \return Component or null if the handle is invalid.
+        static SpotLightComponent* Get( unsigned handle );
+
+        /// Destroys the component. Its handle becomes invalid.
+        static void Delete( unsigned handle );
         
         RenderTexture shadowMap;
         GameObject* gameObject = nullptr;
@@ -53,6 +53,9 @@ namespace ae3d
         /// \return Sprite info for index.
         SpriteInfo GetSpriteInfo( int index ) const;
 
+        /// \return Number of sprites added using SetTexture.
+        unsigned GetSpriteCount() const;
+
         /**
           Adds a texture to be rendered. The same texture can be added multiple
           times.
@@ -74,8 +77,11 @@ namespace ae3d
         /* \return Component handle that uniquely identifies the instance. */
         static unsigned New();
         
-        /* \return Component at index or null if index is invalid. */
-        static SpriteRendererComponent* Get( unsigned index );
+        /* \return Component or null if the handle is invalid. */
+        static SpriteRendererComponent* Get( unsigned handle );
+
+        /* Destroys the component. Its handle becomes invalid. */
+        static void Delete( unsigned handle );
 
         /* \param localToClip Transforms coordinates to clip space. */
         void Render( const float* localToClip );
@@ -186,8 +186,13 @@ namespace ae3d
         /// Enables memory leak detection on DEBUG builds on Visual Studio.
         void EnableWindowsMemleakDetection();
 
-        /// Loads built-in assets and shaders.
+        /// Loads built-in assets and shaders, and starts the job system's worker threads. Call from the main thread.
         void LoadBuiltinAssets();
+
+        /// Creates graphics pipelines that the previous run drew with on worker threads, so their first draws don't stall.
+        /// Call while loading, after loading shaders and creating render textures. Only the Vulkan renderer saves the pipelines, others return 0.
+        /// \return Number of created pipelines.
+        unsigned PrewarmPipelines();
         
 #if RENDERER_METAL
         void InitMetal( id< MTLDevice > metalDevice, MTKView* view, int sampleCount, int uiVBSize, int uiIBSize );
@@ -224,10 +229,16 @@ namespace ae3d
 			/// \param outStr Caller must allocate at least 512 bytes for the output.
             void GetStatistics( char* outStr );
             int GetDrawCallCount();
+            /// \return Number of draw calls that drew several instances in the last frame. They are included in GetDrawCallCount().
+            int GetInstancedDrawCallCount();
+            /// \return Number of shadow maps and cube map faces that were not rendered in the last frame, because their light and casters didn't change.
+            int GetCachedShadowMapCount();
             int GetShaderBindCount();
             int GetRenderTargetBindCount();
             int GetBarrierCallCount();
             int GetFenceCallCount();
+            /// \return Number of mesh renderers that were hidden by occluders in the last frame. See Scene::EnableOcclusionCulling.
+            int GetOcclusionCulledCount();
             void GetGpuMemoryUsage( unsigned& outUsedMBytes, unsigned& outBudgetMBytes );
             void SetBloomTime( float cpuMs, float gpuMs );
         }
@@ -62,8 +62,11 @@ namespace ae3d
         /** \return Component handle that uniquely identifies the instance. */
         static unsigned New();
         
-        /** \return Component at index or null if index is invalid. */
-        static TextRendererComponent* Get( unsigned index );
+        /** \return Component or null if the handle is invalid. */
+        static TextRendererComponent* Get( unsigned handle );
+
+        /** Destroys the component. Its handle becomes invalid. */
+        static void Delete( unsigned handle );
 
         /** \param localToClip Transforms screen-space coordinates to clip space. */
         void Render( const float* localToClip );
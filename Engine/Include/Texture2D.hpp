@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vector>
 #include "TextureBase.hpp"
 
 namespace DDSLoader
@@ -18,6 +19,28 @@ namespace ae3d
     class Texture2D : public TextureBase
     {
     public:
+        /// Image decoded into RGBA8 pixels by Decode.
+        struct DecodedImage
+        {
+            /// RGBA8 pixels, width * height * 4 bytes.
+            std::vector< unsigned char > pixels;
+            /// Width in pixels.
+            int width = 0;
+            /// Height in pixels.
+            int height = 0;
+            /// True, if the image has no alpha channel.
+            bool opaque = true;
+        };
+
+        /**
+          Decodes png, tga, jpg, bmp or gif data into pixels. Doesn't use the graphics API, so it can be called on any thread.
+
+          \param textureData Texture image data.
+          \param outImage Receives the pixels.
+          \return False, if the format is not decoded ahead of loading (for example dds) or decoding failed.
+         */
+        static bool Decode( const FileSystem::FileContentsData& textureData, DecodedImage& outImage );
+
         /// Gets a default texture that is always available after System::LoadBuiltinAssets().
         static Texture2D* GetDefaultTexture();
 
@@ -47,6 +70,16 @@ namespace ae3d
         /// \param colorSpace Color space.
         /// \param anisotropy Anisotropy. Value range is 1-16 depending on support. On Metal the value is bucketed into 1, 2, 4, 8 and 16.
         void Load( const FileSystem::FileContentsData& textureData, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps, ColorSpace colorSpace, Anisotropy anisotropy );
+
+        /// Same as Load, but uses pixels that were decoded earlier with Decode, possibly on another thread.
+        /// \param textureData Texture image data.
+        /// \param image Decoded image. If it has no pixels, textureData is decoded like in Load.
+        /// \param wrap Wrap mode.
+        /// \param filter Filter mode.
+        /// \param mipmaps Mipmaps.
+        /// \param colorSpace Color space.
+        /// \param anisotropy Anisotropy.
+        void LoadDecoded( const FileSystem::FileContentsData& textureData, const DecodedImage& image, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps, ColorSpace colorSpace, Anisotropy anisotropy );
         
         /// \param atlasTextureData Atlas texture image data. File format must be dds, png, tga, jpg or bmp.
         /// \param atlasMetaData Atlas metadata. Format is Ogre/CEGUI. Example atlas tool: Texture Packer.
@@ -80,8 +113,9 @@ namespace ae3d
           Loads texture from stb_image.c supported formats.
 
           \param textureData Texture data.
+          \param image Decoded image. If it has no pixels, textureData is decoded.
           */
-        void LoadSTB( const FileSystem::FileContentsData& textureData );
+        void LoadSTB( const FileSystem::FileContentsData& textureData, const DecodedImage& image );
 #if RENDERER_METAL
         void LoadPVRv2( const char* path );
         void LoadPVRv3( const char* path );
@@ -13,17 +13,17 @@ namespace ae3d
         /// \return Local position.
         const Vec3& GetLocalPosition() const { return localPosition; }
 
-        /// \return Local position.
-        Vec3& GetLocalPosition() { return localPosition; }
+        /// \return Local position. Marks the transform as changed.
+        Vec3& GetLocalPosition() { isDirty = true; return localPosition; }
 
         /// \return Local rotation.
         const Quaternion& GetLocalRotation() const { return localRotation; }
 
-        /// \return Local rotation.
-        Quaternion& GetLocalRotation() { return localRotation; }
+        /// \return Local rotation. Marks the transform as changed.
+        Quaternion& GetLocalRotation() { isDirty = true; return localRotation; }
 
-        /// \return Local scale.
-        float& GetLocalScale() { return localScale; }
+        /// \return Local scale. Marks the transform as changed.
+        float& GetLocalScale() { isDirty = true; return localScale; }
 
         /// \return Local scale.
         float GetLocalScale() const { return localScale; }
@@ -97,7 +97,7 @@ namespace ae3d
         /// \return Parent transform or null if there is no parent.
         TransformComponent* GetParent() const;
 
-        /// Updates local and global matrix.
+        /// Updates local and global matrix. Uses parent's world matrix from the last update.
         void UpdateLocalAndGlobalMatrix();
         
     private:
@@ -110,12 +110,18 @@ namespace ae3d
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static TransformComponent* Get( unsigned index );
+        /// \return Component or null if the handle is invalid.
+        static TransformComponent* Get( unsigned handle );
 
-        /// Updates matrices.
+        /// Destroys the component and detaches its children. Its handle becomes invalid.
+        static void Delete( unsigned handle );
+
+        /// Updates matrices of changed transforms and their children. Parents are updated before children.
         static void UpdateLocalMatrices();
 
+        /// Sorts transforms so that parents come before children and each hierarchy is contiguous.
+        static void SortHierarchy();
+
         void SolveLocalMatrix();
 
         Matrix44 localMatrix;
@@ -126,10 +132,13 @@ namespace ae3d
         float localScale = 1;
         Vec3 globalPosition;
         int parent = -1;
+        unsigned version = 0; // Incremented when localToWorldMatrix changes. Used by Scene to detect moved objects.
 #if defined( AE3D_OPENVR )
         Matrix44 hmdView; // For VR
 #endif
         GameObject* gameObject = nullptr;
         bool isEnabled = true;
+        bool isDirty = true; // Local position, rotation or scale has changed since the last update.
+        bool hasWorldChanged = true; // Set in UpdateLocalMatrices, tells children they need an update.
     };
 }
@@ -93,6 +93,17 @@ bool TestAddition()
         return false;
     }
 
+    // A game object has one component of each type, adding another keeps the existing one.
+    go1.GetComponent< TransformComponent >()->SetLocalPosition( Vec3( 1, 2, 3 ) );
+    TransformComponent* transform = go1.GetComponent< TransformComponent >();
+    go1.AddComponent< TransformComponent >();
+
+    if (go1.GetComponent< TransformComponent >() != transform || !transform->GetLocalPosition().IsAlmost( Vec3( 1, 2, 3 ) ))
+    {
+        System::Print( "AddComponent replaced an existing component!\n" );
+        return false;
+    }
+
     return true;
 }
 
@@ -260,6 +271,49 @@ bool TestGameObjectEnabling()
     return true;
 }
 
+bool TestRemoval()
+{
+    GameObject go;
+    go.AddComponent< TransformComponent >();
+    TransformComponent* transform = go.GetComponent< TransformComponent >();
+
+    // Grows the pool. Existing components must not move.
+    const int instanceCount = 1000;
+    GameObject* gos = new GameObject[ instanceCount ];
+
+    for (int i = 0; i < instanceCount; ++i)
+    {
+        gos[ i ].AddComponent< TransformComponent >();
+    }
+
+    bool success = go.GetComponent< TransformComponent >() == transform;
+    delete[] gos;
+
+    if (!success)
+    {
+        System::Print( "component moved when adding components\n" );
+        return false;
+    }
+
+    go.RemoveComponent< TransformComponent >();
+
+    if (go.GetComponent< TransformComponent >() != nullptr)
+    {
+        System::Print( "removed component still exists\n" );
+        return false;
+    }
+
+    go.AddComponent< TransformComponent >();
+
+    if (go.GetComponent< TransformComponent >() == nullptr)
+    {
+        System::Print( "could not add a component after removing\n" );
+        return false;
+    }
+
+    return true;
+}
+
 int main()
 {
     Window::Create( 512, 512, WindowCreateFlags::Empty );
@@ -276,6 +330,7 @@ int main()
     success &= TestAddition();
     success &= TestGameObjectCopying();
     success &= TestGameObjectEnabling();
+    success &= TestRemoval();
     TestMissingFiles();
 
     return success ? 0 : 1;
@@ -0,0 +1,181 @@
+// Compares loading times of textual and binary scenes.
+// Usage: 05_SceneLoading [scene]
+// Without a scene argument a scene with lights, cameras and transforms is generated.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <vector>
+#include "Array.hpp"
+#include "CameraComponent.hpp"
+#include "DirectionalLightComponent.hpp"
+#include "FileSystem.hpp"
+#include "GameObject.hpp"
+#include "Material.hpp"
+#include "Mesh.hpp"
+#include "PointLightComponent.hpp"
+#include "Scene.hpp"
+#include "SpotLightComponent.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TransformComponent.hpp"
+#include "Vec3.hpp"
+#include "Window.hpp"
+
+using namespace ae3d;
+
+const unsigned GeneratedGameObjectCount = 50000;
+const int Iterations = 5;
+
+void GenerateGameObjects( std::vector< GameObject >& outGameObjects )
+{
+    outGameObjects.resize( GeneratedGameObjectCount );
+
+    for (unsigned i = 0; i < GeneratedGameObjectCount; ++i)
+    {
+        GameObject& go = outGameObjects[ i ];
+        go.SetName( "generated game object" );
+        go.SetLayer( 1u << (i % 4) );
+        go.AddComponent< TransformComponent >();
+        go.GetComponent< TransformComponent >()->SetLocalPosition( Vec3( static_cast< float >( i % 100 ), static_cast< float >( i / 100 ), 0.5f ) );
+        go.GetComponent< TransformComponent >()->SetLocalScale( 1.5f );
+
+        if (i % 10 == 1)
+        {
+            go.AddComponent< PointLightComponent >();
+            go.GetComponent< PointLightComponent >()->SetRadius( 10 );
+            go.GetComponent< PointLightComponent >()->SetColor( Vec3( 1, 0.5f, 0.25f ) );
+        }
+        else if (i % 10 == 2)
+        {
+            go.AddComponent< SpotLightComponent >();
+            go.GetComponent< SpotLightComponent >()->SetConeAngle( 30 );
+        }
+        else if (i % 1000 == 3)
+        {
+            go.AddComponent< CameraComponent >();
+            go.GetComponent< CameraComponent >()->SetProjection( 45, 1.5f, 1, 200 );
+            go.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+        }
+        else if (i == 4)
+        {
+            go.AddComponent< DirectionalLightComponent >();
+        }
+    }
+}
+
+bool WriteFile( const char* path, const void* data, std::size_t size )
+{
+    std::ofstream ofs( path, std::ios::out | std::ios::binary );
+    ofs.write( static_cast< const char* >( data ), size );
+    return ofs.good();
+}
+
+void DeleteAssets( std::map< std::string, Texture2D* >& textures, std::map< std::string, Material* >& materials, Array< Mesh* >& meshes )
+{
+    for (auto& texture : textures)
+    {
+        delete texture.second;
+    }
+
+    for (auto& material : materials)
+    {
+        delete material.second;
+    }
+
+    textures.clear();
+    materials.clear();
+
+    for (unsigned i = 0; i < meshes.count; ++i)
+    {
+        delete meshes[ i ];
+    }
+
+    meshes.Allocate( 0 );
+}
+
+int main( int argCount, char* args[] )
+{
+    Window::Create( 512, 512, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+
+    std::vector< GameObject > gameObjects;
+    std::map< std::string, Texture2D* > textures;
+    std::map< std::string, Material* > materials;
+    Array< Mesh* > meshes;
+
+    if (argCount > 1)
+    {
+        if (Scene().Deserialize( FileSystem::FileContents( args[ 1 ] ), gameObjects, textures, materials, meshes ) != Scene::DeserializeResult::Success)
+        {
+            System::Print( "Could not load %s\n", args[ 1 ] );
+            return 1;
+        }
+    }
+    else
+    {
+        GenerateGameObjects( gameObjects );
+    }
+
+    Scene scene;
+
+    for (auto& go : gameObjects)
+    {
+        scene.Add( &go );
+    }
+
+    const std::string text = scene.GetSerialized();
+    const std::vector< unsigned char > binary = scene.GetSerializedBinary();
+
+    if (!WriteFile( "scene_loading.scene", text.data(), text.size() ) || !WriteFile( "scene_loading.scene_bin", binary.data(), binary.size() ))
+    {
+        System::Print( "Could not write benchmark scenes\n" );
+        return 1;
+    }
+
+    double bestTextMs = 1e9;
+    double bestBinaryMs = 1e9;
+    std::size_t textGameObjectCount = 0;
+    std::size_t binaryGameObjectCount = 0;
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        std::vector< GameObject > loadedGameObjects;
+
+        auto startTime = std::chrono::steady_clock::now();
+        const auto textResult = scene.Deserialize( FileSystem::FileContents( "scene_loading.scene" ), loadedGameObjects, textures, materials, meshes );
+        auto endTime = std::chrono::steady_clock::now();
+        bestTextMs = std::min( bestTextMs, std::chrono::duration< double, std::milli >( endTime - startTime ).count() );
+        textGameObjectCount = loadedGameObjects.size();
+        DeleteAssets( textures, materials, meshes );
+
+        startTime = std::chrono::steady_clock::now();
+        FileSystem::MappedFileData mappedFile = FileSystem::MapFile( "scene_loading.scene_bin" );
+        const auto binaryResult = scene.DeserializeBinary( mappedFile.data, mappedFile.size, mappedFile.path.c_str(), loadedGameObjects, textures, materials, meshes );
+        FileSystem::UnmapFile( mappedFile );
+        endTime = std::chrono::steady_clock::now();
+        bestBinaryMs = std::min( bestBinaryMs, std::chrono::duration< double, std::milli >( endTime - startTime ).count() );
+        binaryGameObjectCount = loadedGameObjects.size();
+        DeleteAssets( textures, materials, meshes );
+
+        if (textResult != Scene::DeserializeResult::Success || binaryResult != Scene::DeserializeResult::Success)
+        {
+            System::Print( "Scene loading failed!\n" );
+            return 1;
+        }
+    }
+
+    if (textGameObjectCount != gameObjects.size() || binaryGameObjectCount != gameObjects.size())
+    {
+        System::Print( "Loaded %zu game objects from text and %zu from binary, expected %zu\n", textGameObjectCount, binaryGameObjectCount, gameObjects.size() );
+        return 1;
+    }
+
+    std::printf( "%zu game objects, best of %d iterations\n", gameObjects.size(), Iterations );
+    std::printf( "text:   %8.2f ms, %8zu bytes\n", bestTextMs, text.size() );
+    std::printf( "binary: %8.2f ms, %8zu bytes\n", bestBinaryMs, binary.size() );
+    std::printf( "speedup: %.1fx\n", bestTextMs / bestBinaryMs );
+
+    return 0;
+}
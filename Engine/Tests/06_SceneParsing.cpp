@@ -0,0 +1,165 @@
+// Compares the scene tokenizer with the std::stringstream-based parsing that Scene::Deserialize used before.
+// Usage: 06_SceneParsing [scene]
+// The scene (default: scene.scene) is repeated until it has at least 100 000 lines. Doesn't need a window.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "FileSystem.hpp"
+#include "SceneTokenizer.hpp"
+
+using namespace ae3d;
+
+const std::size_t MinLineCount = 100000;
+const int Iterations = 5;
+
+// Tokens in the order of the if-chain that was used before the tokenizer.
+const char* const chainTokens[] =
+{
+    "gameobject", "name", "layer", "enabled", "meshrenderer_enabled", "particlesystem_enabled", "decalrenderer_enabled",
+    "transform_enabled", "camera_enabled", "dirlight", "particlesystem", "decalrenderer", "spotlight", "pointlight",
+    "dirlight_enabled", "spotlight_enabled", "pointlight_enabled", "shadow", "camera", "ortho", "persp", "projection",
+    "clearcolor", "layermask", "viewport", "order", "transform", "meshrenderer_cast_shadow", "meshrenderer", "meshpath",
+    "spriterenderer", "sprite", "position", "rotation", "scale", "texture2d", "material", "mesh_material", "param_texture",
+    "audiosource", "coneangle", "radius", "color", "shaders", "metal_shaders", "meshrenderer_lod", "meshrenderer_lod_hysteresis"
+};
+
+struct ParseResult
+{
+    unsigned tokenSum = 0;
+    double floatSum = 0;
+};
+
+ParseResult ParseWithStringStream( const std::vector< unsigned char >& contents )
+{
+    ParseResult result;
+    std::stringstream stream( std::string( std::begin( contents ), std::end( contents ) ) );
+    std::string line;
+
+    while (!stream.eof())
+    {
+        std::getline( stream, line );
+        std::stringstream lineStream( line );
+        std::locale c_locale( "C" );
+        lineStream.imbue( c_locale );
+        std::string token;
+        lineStream >> token;
+
+        if (token.empty())
+        {
+            continue;
+        }
+
+        for (unsigned i = 0; i < sizeof( chainTokens ) / sizeof( chainTokens[ 0 ] ); ++i)
+        {
+            if (token == chainTokens[ i ])
+            {
+                result.tokenSum += i + 1;
+                break;
+            }
+        }
+
+        float value;
+
+        while (lineStream >> value)
+        {
+            result.floatSum += value;
+        }
+    }
+
+    return result;
+}
+
+ParseResult ParseWithTokenizer( const std::vector< unsigned char >& contents )
+{
+    ParseResult result;
+    SceneTokenizer tokenizer( contents.data(), contents.size() );
+
+    while (tokenizer.NextLine())
+    {
+        TokenView token;
+
+        if (!tokenizer.NextToken( token ))
+        {
+            continue;
+        }
+
+        const SceneToken sceneToken = LookupSceneToken( token );
+
+        // SceneToken's values are in the same order as chainTokens.
+        result.tokenSum += static_cast< unsigned >( sceneToken );
+
+        float value;
+
+        while (tokenizer.NextFloat( value ))
+        {
+            result.floatSum += value;
+        }
+    }
+
+    return result;
+}
+
+template< class Function > double MeasureBestMs( Function function, ParseResult& outResult )
+{
+    double bestMs = 1e9;
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        outResult = function();
+        const auto endTime = std::chrono::steady_clock::now();
+        bestMs = std::min( bestMs, std::chrono::duration< double, std::milli >( endTime - startTime ).count() );
+    }
+
+    return bestMs;
+}
+
+int main( int argCount, char* args[] )
+{
+    const FileSystem::FileContentsData scene = FileSystem::FileContents( argCount > 1 ? args[ 1 ] : "scene.scene" );
+
+    if (!scene.isLoaded || scene.data.empty())
+    {
+        std::printf( "Could not load %s\n", scene.path.c_str() );
+        return 1;
+    }
+
+    std::vector< unsigned char > contents = scene.data;
+
+    if (contents.back() != '\n')
+    {
+        contents.push_back( '\n' );
+    }
+
+    const std::size_t sceneLineCount = static_cast< std::size_t >( std::count( std::begin( contents ), std::end( contents ), '\n' ) );
+    const std::vector< unsigned char > sceneContents = contents;
+    std::size_t lineCount = sceneLineCount;
+
+    while (lineCount < MinLineCount)
+    {
+        contents.insert( std::end( contents ), std::begin( sceneContents ), std::end( sceneContents ) );
+        lineCount += sceneLineCount;
+    }
+
+    ParseResult streamResult;
+    ParseResult tokenizerResult;
+    const double streamMs = MeasureBestMs( [ &contents ]{ return ParseWithStringStream( contents ); }, streamResult );
+    const double tokenizerMs = MeasureBestMs( [ &contents ]{ return ParseWithTokenizer( contents ); }, tokenizerResult );
+
+    std::printf( "%zu lines, %zu bytes, best of %d iterations\n", lineCount, contents.size(), Iterations );
+    std::printf( "stringstream: %8.2f ms\n", streamMs );
+    std::printf( "tokenizer:    %8.2f ms\n", tokenizerMs );
+    std::printf( "speedup: %.1fx\n", streamMs / tokenizerMs );
+
+    if (streamResult.tokenSum != tokenizerResult.tokenSum || streamResult.floatSum != tokenizerResult.floatSum)
+    {
+        std::printf( "Results differ! Token sums: %u, %u. Float sums: %f, %f\n", streamResult.tokenSum, tokenizerResult.tokenSum, streamResult.floatSum, tokenizerResult.floatSum );
+        return 1;
+    }
+
+    return 0;
+}
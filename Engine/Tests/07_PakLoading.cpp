@@ -0,0 +1,181 @@
+// Measures loading all files from an uncompressed and a compressed .pak file.
+// Usage: 07_PakLoading uncompressed.pak compressed.pak
+// Make the .pak files from the same file list:
+//   CombineFiles -nocompress files.txt uncompressed.pak
+//   CombineFiles files.txt compressed.pak
+// Throughput is reported in uncompressed MB/s. On POSIX systems the .pak file is also evicted from the page cache
+// before each iteration to measure loading from disk. Doesn't need a window.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#if !_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "FileSystem.hpp"
+#include "PakFormat.hpp"
+
+using namespace ae3d;
+
+const int Iterations = 5;
+
+struct PakInfo
+{
+    std::vector< std::string > paths;
+    std::size_t fileSize = 0;
+    std::size_t uncompressedSize = 0;
+    unsigned compressedEntryCount = 0;
+};
+
+bool ReadPakInfo( const char* path, PakInfo& outInfo )
+{
+    FileSystem::MappedFileData pak = FileSystem::MapFile( path );
+    PakFormat::Header header;
+
+    if (pak.data == nullptr || pak.size < sizeof( header ))
+    {
+        return false;
+    }
+
+    std::memcpy( &header, pak.data, sizeof( header ) );
+
+    if (std::memcmp( header.magic, PakFormat::Magic, sizeof( PakFormat::Magic ) ) != 0 || header.version != PakFormat::Version)
+    {
+        FileSystem::UnmapFile( pak );
+        return false;
+    }
+
+    outInfo.fileSize = pak.size;
+
+    for (std::uint32_t i = 0; i < header.entryCount; ++i)
+    {
+        PakFormat::Entry entry;
+        std::memcpy( &entry, pak.data + header.entriesOffset + i * sizeof( entry ), sizeof( entry ) );
+        outInfo.paths.push_back( std::string( reinterpret_cast< const char* >( pak.data + header.pathsOffset + entry.pathOffset ), entry.pathLength ) );
+        outInfo.uncompressedSize += static_cast< std::size_t >( entry.uncompressedSize );
+        outInfo.compressedEntryCount += (entry.flags & PakFormat::EntryFlags::Compressed) != 0 ? 1 : 0;
+    }
+
+    FileSystem::UnmapFile( pak );
+    return true;
+}
+
+void EvictFromPageCache( const char* path )
+{
+#if !_WIN32
+    const int file = open( path, O_RDONLY );
+
+    if (file != -1)
+    {
+        fdatasync( file );
+        posix_fadvise( file, 0, 0, POSIX_FADV_DONTNEED );
+        close( file );
+    }
+#else
+    (void)path;
+#endif
+}
+
+// Sums the contents so that the loads can't be optimized away and the .pak files can be compared.
+std::uint64_t LoadAll( const PakInfo& info )
+{
+    std::uint64_t checksum = 0;
+
+    for (const auto& path : info.paths)
+    {
+        const FileSystem::FileContentsData contents = FileSystem::FileContents( path.c_str() );
+
+        for (std::size_t i = 0; i < contents.data.size(); i += 64)
+        {
+            checksum = checksum * 31 + contents.data[ i ];
+        }
+
+        checksum += contents.data.size();
+    }
+
+    return checksum;
+}
+
+double MeasureBestMs( const char* pakPath, const PakInfo& info, bool evict, std::uint64_t& outChecksum )
+{
+    double bestMs = 1e9;
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        if (evict)
+        {
+            EvictFromPageCache( pakPath );
+        }
+
+        const auto startTime = std::chrono::steady_clock::now();
+        FileSystem::LoadPakFile( pakPath );
+        outChecksum = LoadAll( info );
+        FileSystem::UnloadPakFile( pakPath );
+        const auto endTime = std::chrono::steady_clock::now();
+        bestMs = std::min( bestMs, std::chrono::duration< double, std::milli >( endTime - startTime ).count() );
+    }
+
+    return bestMs;
+}
+
+int main( int argCount, char* args[] )
+{
+    if (argCount != 3)
+    {
+        std::printf( "Usage: 07_PakLoading uncompressed.pak compressed.pak\n" );
+        return 1;
+    }
+
+    PakInfo infos[ 2 ];
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (!ReadPakInfo( args[ i + 1 ], infos[ i ] ))
+        {
+            std::printf( "Could not read %s. Make it with the current CombineFiles.\n", args[ i + 1 ] );
+            return 1;
+        }
+    }
+
+    if (infos[ 0 ].paths.size() != infos[ 1 ].paths.size() || infos[ 0 ].uncompressedSize != infos[ 1 ].uncompressedSize)
+    {
+        std::printf( "The .pak files must be made from the same file list.\n" );
+        return 1;
+    }
+
+    const double megabytes = infos[ 0 ].uncompressedSize / (1024.0 * 1024.0);
+    std::printf( "%zu files, %.1f MB, best of %d iterations\n", infos[ 0 ].paths.size(), megabytes, Iterations );
+
+    std::uint64_t checksums[ 2 ][ 2 ] = {};
+#if _WIN32
+    const int modeCount = 1;
+#else
+    const int modeCount = 2;
+#endif
+
+    for (int mode = 0; mode < modeCount; ++mode)
+    {
+        std::printf( mode == 0 ? "Cached:\n" : "Evicted from page cache:\n" );
+
+        for (int i = 0; i < 2; ++i)
+        {
+            const double ms = MeasureBestMs( args[ i + 1 ], infos[ i ], mode == 1, checksums[ mode ][ i ] );
+            std::printf( "  %-12s %6.1f MB on disk, %3u compressed files: %8.2f ms, %8.1f MB/s\n", i == 0 ? "uncompressed" : "compressed",
+                         infos[ i ].fileSize / (1024.0 * 1024.0), infos[ i ].compressedEntryCount, ms, megabytes / (ms / 1000.0) );
+        }
+    }
+
+    for (int mode = 0; mode < modeCount; ++mode)
+    {
+        if (checksums[ mode ][ 0 ] != checksums[ mode ][ 1 ])
+        {
+            std::printf( "Contents differ!\n" );
+            return 1;
+        }
+    }
+
+    return 0;
+}
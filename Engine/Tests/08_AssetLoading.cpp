@@ -0,0 +1,201 @@
+// Measures decoding assets on AssetLoader threads against decoding them one by one on the calling thread,
+// and checks load states, progress and cancellation.
+// Usage: 08_AssetLoading file [file ...]
+// Files can be .ae3d meshes, png/tga/jpg/bmp/gif textures and .wav/.ogg clips. Doesn't need a window: all loads are
+// cancelled before AssetLoader::Update() would upload them.
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "AssetLoader.hpp"
+#include "AudioClip.hpp"
+#include "AudioSystem.hpp"
+#include "FileSystem.hpp"
+#include "Mesh.hpp"
+#include "Texture2D.hpp"
+
+using namespace ae3d;
+
+enum class AssetType { Mesh, Texture, AudioClip };
+
+bool EndsWith( const std::string& str, const char* suffix )
+{
+    const std::string suffixStr( suffix );
+    return str.size() >= suffixStr.size() && str.compare( str.size() - suffixStr.size(), suffixStr.size(), suffixStr ) == 0;
+}
+
+bool GetAssetType( const std::string& path, AssetType& outType )
+{
+    if (EndsWith( path, ".ae3d" ))
+    {
+        outType = AssetType::Mesh;
+    }
+    else if (EndsWith( path, ".wav" ) || EndsWith( path, ".ogg" ))
+    {
+        outType = AssetType::AudioClip;
+    }
+    else if (EndsWith( path, ".png" ) || EndsWith( path, ".tga" ) || EndsWith( path, ".jpg" ) || EndsWith( path, ".bmp" ) || EndsWith( path, ".gif" ))
+    {
+        outType = AssetType::Texture;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// Same work as a loader thread does for one file.
+bool DecodeOnCallingThread( const std::string& path, AssetType type )
+{
+    if (type == AssetType::Mesh)
+    {
+        Mesh mesh;
+        return mesh.Decode( path.c_str() ) == Mesh::LoadResult::Success;
+    }
+
+    const FileSystem::FileContentsData contents = FileSystem::FileContents( path.c_str() );
+
+    if (type == AssetType::AudioClip)
+    {
+        AudioSystem::DecodedClip clip;
+        return AudioSystem::DecodeClip( contents, clip );
+    }
+
+    Texture2D::DecodedImage image;
+    return Texture2D::Decode( contents, image );
+}
+
+double ElapsedMs( const std::chrono::steady_clock::time_point& startTime )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+int main( int argCount, char* args[] )
+{
+    if (argCount < 2)
+    {
+        std::printf( "Usage: 08_AssetLoading file [file ...]\n" );
+        return 1;
+    }
+
+    std::vector< std::string > paths;
+    std::vector< AssetType > types;
+
+    for (int i = 1; i < argCount; ++i)
+    {
+        AssetType type;
+
+        if (!GetAssetType( args[ i ], type ))
+        {
+            std::printf( "Skipping %s: unsupported file type.\n", args[ i ] );
+            continue;
+        }
+
+        paths.push_back( args[ i ] );
+        types.push_back( type );
+    }
+
+    int failureCount = 0;
+
+    // A missing file fails without touching the loaded object.
+    {
+        Mesh mesh;
+        AssetLoader::LoadState callbackState = AssetLoader::LoadState::Queued;
+        AssetLoader::LoadHandle handle = AssetLoader::LoadMesh( &mesh, "this file does not exist.ae3d", [ &callbackState ]( AssetLoader::LoadState state ) { callbackState = state; } );
+        AssetLoader::WaitForDecoding();
+        AssetLoader::Update();
+
+        if (handle.GetState() != AssetLoader::LoadState::Failed || callbackState != AssetLoader::LoadState::Failed || mesh.GetSubMeshCount() != 0)
+        {
+            std::printf( "Loading a missing file did not fail.\n" );
+            ++failureCount;
+        }
+    }
+
+    const auto syncStartTime = std::chrono::steady_clock::now();
+    unsigned decodedCount = 0;
+
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        decodedCount += DecodeOnCallingThread( paths[ i ], types[ i ] ) ? 1 : 0;
+    }
+
+    const double syncMs = ElapsedMs( syncStartTime );
+
+    // Objects must outlive their loads, so they are allocated up front.
+    std::vector< Mesh > meshes( paths.size() );
+    std::vector< Texture2D > textures( paths.size() );
+    std::vector< AudioClip > audioClips( paths.size() );
+    std::vector< AssetLoader::LoadHandle > handles;
+    std::vector< AssetLoader::LoadState > callbackStates( paths.size(), AssetLoader::LoadState::Queued );
+
+    const auto asyncStartTime = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        AssetLoader::LoadState* callbackState = &callbackStates[ i ];
+        const AssetLoader::CompletionCallback callback = [ callbackState ]( AssetLoader::LoadState state ) { *callbackState = state; };
+
+        if (types[ i ] == AssetType::Mesh)
+        {
+            handles.push_back( AssetLoader::LoadMesh( &meshes[ i ], paths[ i ].c_str(), callback ) );
+        }
+        else if (types[ i ] == AssetType::AudioClip)
+        {
+            handles.push_back( AssetLoader::LoadAudioClip( &audioClips[ i ], paths[ i ].c_str(), callback ) );
+        }
+        else
+        {
+            handles.push_back( AssetLoader::LoadTexture2D( &textures[ i ], paths[ i ].c_str(), TextureWrap::Repeat, TextureFilter::Linear,
+                                                           Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1, callback ) );
+        }
+    }
+
+    const double enqueueMs = ElapsedMs( asyncStartTime );
+    AssetLoader::WaitForDecoding();
+    const double asyncMs = ElapsedMs( asyncStartTime );
+
+    std::printf( "%zu files, %u decoded\n", paths.size(), decodedCount );
+    std::printf( "  calling thread: %8.2f ms\n", syncMs );
+    std::printf( "  AssetLoader:    %8.2f ms, calling thread blocked for %.3f ms to enqueue\n", asyncMs, enqueueMs );
+
+    if (AssetLoader::GetPendingCount() != paths.size() || AssetLoader::GetProgress() != 0)
+    {
+        std::printf( "Decoded loads must stay pending until Update().\n" );
+        ++failureCount;
+    }
+
+    for (const auto& handle : handles)
+    {
+        if (handle.GetState() != AssetLoader::LoadState::Decoded)
+        {
+            std::printf( "Load was not decoded.\n" );
+            ++failureCount;
+        }
+    }
+
+    // Cancelling before Update() means nothing is uploaded, so this runs without a graphics device.
+    AssetLoader::CancelAll();
+    AssetLoader::Update();
+
+    for (std::size_t i = 0; i < handles.size(); ++i)
+    {
+        if (handles[ i ].GetState() != AssetLoader::LoadState::Cancelled || callbackStates[ i ] != AssetLoader::LoadState::Cancelled)
+        {
+            std::printf( "%s was not cancelled.\n", paths[ i ].c_str() );
+            ++failureCount;
+        }
+    }
+
+    if (AssetLoader::GetPendingCount() != 0 || AssetLoader::GetProgress() != 1)
+    {
+        std::printf( "Loads are still pending after Update().\n" );
+        ++failureCount;
+    }
+
+    AssetLoader::Deinit();
+
+    return failureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+// Checks OcclusionCuller's visibility results and measures culling a city-like grid of buildings.
+// Usage: 09_OcclusionCulling
+// Doesn't need a window. The camera is at the origin looking towards -Z, so world-to-clip is the projection matrix.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include "Matrix.hpp"
+#include "OcclusionCuller.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+const float NearDepth = 0.1f;
+const int GridSize = 60; // Buildings per side.
+const float BlockSize = 20;
+const int Iterations = 100;
+
+// Box corners and 12 triangles, some of them clockwise, which doesn't matter to the culler.
+struct BoxMesh
+{
+    explicit BoxMesh( const Vec3& aabbMin, const Vec3& aabbMax )
+    {
+        for (int c = 0; c < 8; ++c)
+        {
+            vertices[ c ] = Vec3( (c & 1) ? aabbMax.x : aabbMin.x, (c & 2) ? aabbMax.y : aabbMin.y, (c & 4) ? aabbMax.z : aabbMin.z );
+        }
+    }
+
+    Vec3 vertices[ 8 ];
+    static const unsigned short indices[ 36 ];
+};
+
+const unsigned short BoxMesh::indices[ 36 ] =
+{
+    0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,  0, 4, 5, 0, 5, 1,
+    2, 3, 7, 2, 7, 6,  0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3
+};
+
+void AddBox( OcclusionCuller& culler, const Vec3& aabbMin, const Vec3& aabbMax )
+{
+    const BoxMesh box( aabbMin, aabbMax );
+    culler.RasterizeTriangles( box.vertices, sizeof( Vec3 ), 8, BoxMesh::indices, 2, 12, Matrix44::identity );
+}
+
+bool TestVisibility( const Matrix44& projection )
+{
+    OcclusionCuller culler;
+    culler.Begin( projection, NearDepth );
+    culler.EndOccluders();
+
+    if (!culler.IsVisible( Vec3( -1, -1, -32 ), Vec3( 1, 1, -30 ) ))
+    {
+        std::cerr << "OcclusionCuller hid a box without occluders!" << std::endl;
+        return false;
+    }
+
+    // Wall at z = -20, covering x and y in [-10, 10].
+    const Vec3 wall[ 4 ] = { Vec3( -10, -10, -20 ), Vec3( 10, -10, -20 ), Vec3( 10, 10, -20 ), Vec3( -10, 10, -20 ) };
+    const unsigned wallIndices[ 6 ] = { 0, 1, 2, 0, 2, 3 };
+    const unsigned wallIndicesClockwise[ 6 ] = { 0, 2, 1, 0, 3, 2 };
+
+    for (int winding = 0; winding < 2; ++winding)
+    {
+        culler.Begin( projection, NearDepth );
+        culler.RasterizeTriangles( wall, sizeof( Vec3 ), 4, winding == 0 ? wallIndices : wallIndicesClockwise, 4, 2, Matrix44::identity );
+        culler.EndOccluders();
+
+        if (culler.GetRasterizedTriangleCount() != 2)
+        {
+            std::cerr << "OcclusionCuller didn't rasterize the wall's triangles!" << std::endl;
+            return false;
+        }
+
+        if (culler.IsVisible( Vec3( -1, -1, -32 ), Vec3( 1, 1, -30 ) ))
+        {
+            std::cerr << "OcclusionCuller didn't hide a box behind the wall!" << std::endl;
+            return false;
+        }
+
+        if (!culler.IsVisible( Vec3( -1, -1, -12 ), Vec3( 1, 1, -10 ) ))
+        {
+            std::cerr << "OcclusionCuller hid a box in front of the wall!" << std::endl;
+            return false;
+        }
+
+        if (!culler.IsVisible( Vec3( 20, -1, -32 ), Vec3( 22, 1, -30 ) ))
+        {
+            std::cerr << "OcclusionCuller hid a box beside the wall!" << std::endl;
+            return false;
+        }
+
+        if (!culler.IsVisible( Vec3( 5, -1, -32 ), Vec3( 20, 1, -30 ) ))
+        {
+            std::cerr << "OcclusionCuller hid a box that is partly behind the wall!" << std::endl;
+            return false;
+        }
+
+        if (!culler.IsVisible( Vec3( -1, -1, -21 ), Vec3( 1, 1, -19 ) ))
+        {
+            std::cerr << "OcclusionCuller hid a box that intersects the wall!" << std::endl;
+            return false;
+        }
+
+        if (!culler.IsVisible( Vec3( -10, -10, -20 ), Vec3( 10, 10, -20 ) ))
+        {
+            std::cerr << "OcclusionCuller hid the wall's own bounds!" << std::endl;
+            return false;
+        }
+
+        if (!culler.IsVisible( Vec3( -1, -1, -5 ), Vec3( 1, 1, 1 ) ))
+        {
+            std::cerr << "OcclusionCuller hid a box that intersects the near plane!" << std::endl;
+            return false;
+        }
+    }
+
+    // Translated occluder and the same wall as 16-bit indices.
+    Matrix44 translation;
+    translation.SetTranslation( Vec3( 0, 0, -10 ) );
+    const unsigned short wallIndices16[ 6 ] = { 0, 1, 2, 0, 2, 3 };
+    culler.Begin( projection, NearDepth );
+    culler.RasterizeTriangles( wall, sizeof( Vec3 ), 4, wallIndices16, 2, 2, translation );
+    culler.EndOccluders();
+
+    if (!culler.IsVisible( Vec3( -1, -1, -29 ), Vec3( 1, 1, -25 ) ))
+    {
+        std::cerr << "OcclusionCuller hid a box in front of a translated wall!" << std::endl;
+        return false;
+    }
+
+    if (culler.IsVisible( Vec3( -1, -1, -42 ), Vec3( 1, 1, -40 ) ))
+    {
+        std::cerr << "OcclusionCuller didn't hide a box behind a translated wall!" << std::endl;
+        return false;
+    }
+
+    // Ground that starts behind the camera, so it must be clipped to the near plane.
+    const Vec3 ground[ 4 ] = { Vec3( -100, -1, 50 ), Vec3( 100, -1, 50 ), Vec3( 100, -1, -100 ), Vec3( -100, -1, -100 ) };
+    culler.Begin( projection, NearDepth );
+    culler.RasterizeTriangles( ground, sizeof( Vec3 ), 4, wallIndices, 4, 2, Matrix44::identity );
+    culler.EndOccluders();
+
+    if (culler.IsVisible( Vec3( -1, -5, -32 ), Vec3( 1, -3, -30 ) ))
+    {
+        std::cerr << "OcclusionCuller didn't hide a box under the ground!" << std::endl;
+        return false;
+    }
+
+    if (!culler.IsVisible( Vec3( -1, 0, -32 ), Vec3( 1, 2, -30 ) ))
+    {
+        std::cerr << "OcclusionCuller hid a box on the ground!" << std::endl;
+        return false;
+    }
+
+    // Occluders behind the camera don't hide anything.
+    culler.Begin( projection, NearDepth );
+    AddBox( culler, Vec3( -10, -10, 5 ), Vec3( 10, 10, 6 ) );
+    culler.EndOccluders();
+
+    if (culler.GetRasterizedTriangleCount() != 0)
+    {
+        std::cerr << "OcclusionCuller rasterized an occluder behind the camera!" << std::endl;
+        return false;
+    }
+
+    if (!culler.IsVisible( Vec3( -1, -1, -32 ), Vec3( 1, 1, -30 ) ))
+    {
+        std::cerr << "OcclusionCuller hid a box with an occluder behind the camera!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+double ElapsedMs( const std::chrono::steady_clock::time_point& startTime )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+struct Building
+{
+    Vec3 aabbMin;
+    Vec3 aabbMax;
+    float size = 0; // Size on screen, used to choose occluders.
+};
+
+bool MeasureCity( const Matrix44& projection, int occluderCount )
+{
+    // Buildings are on both sides of the camera, which is at street level looking along a street.
+    std::vector< Building > buildings;
+    unsigned seed = 1;
+
+    for (int row = 0; row < GridSize; ++row)
+    {
+        for (int column = 0; column < GridSize; ++column)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            const float height = 10 + (seed >> 24) / 8.0f;
+            Building building;
+            building.aabbMin = Vec3( (column - GridSize / 2) * BlockSize + 3, -2, -row * BlockSize - 3 );
+            building.aabbMax = Vec3( building.aabbMin.x + BlockSize - 6, height, building.aabbMin.z - BlockSize + 6 );
+            std::swap( building.aabbMin.z, building.aabbMax.z );
+            const Vec3 center = (building.aabbMin + building.aabbMax) * 0.5f;
+            building.size = (building.aabbMax - building.aabbMin).Length() / std::max( center.Length(), NearDepth );
+            buildings.push_back( building );
+        }
+    }
+
+    std::vector< const Building* > occluders;
+
+    for (const auto& building : buildings)
+    {
+        occluders.push_back( &building );
+    }
+
+    std::sort( std::begin( occluders ), std::end( occluders ), []( const Building* a, const Building* b ) { return a->size > b->size; } );
+    occluders.resize( std::min( occluders.size(), static_cast< std::size_t >( occluderCount ) ) );
+
+    OcclusionCuller culler;
+    double rasterizeMs = 1e9;
+    double testMs = 1e9;
+    unsigned hiddenCount = 0;
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        const auto rasterizeStartTime = std::chrono::steady_clock::now();
+        culler.Begin( projection, NearDepth );
+
+        for (auto occluder : occluders)
+        {
+            AddBox( culler, occluder->aabbMin, occluder->aabbMax );
+        }
+
+        culler.EndOccluders();
+        rasterizeMs = std::min( rasterizeMs, ElapsedMs( rasterizeStartTime ) );
+
+        const auto testStartTime = std::chrono::steady_clock::now();
+        hiddenCount = 0;
+
+        for (const auto& building : buildings)
+        {
+            hiddenCount += culler.IsVisible( building.aabbMin, building.aabbMax ) ? 0 : 1;
+        }
+
+        testMs = std::min( testMs, ElapsedMs( testStartTime ) );
+    }
+
+    std::printf( "%3zu occluders, %5u triangles: rasterize %6.3f ms, test %zu boxes %6.3f ms, hidden %u (%.0f %%)\n",
+                 occluders.size(), culler.GetRasterizedTriangleCount(), rasterizeMs, buildings.size(), testMs, hiddenCount,
+                 100.0 * hiddenCount / buildings.size() );
+
+    if (occluderCount != 0 && hiddenCount == 0)
+    {
+        std::cerr << "City occluders didn't hide any buildings!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+
+    Matrix44 projection;
+    projection.MakeProjection( 60, 16.0f / 9.0f, NearDepth, 2000 );
+
+    result &= TestVisibility( projection );
+
+    std::printf( "%d x %d buildings, best of %d iterations, %dx%d depth buffer\n", GridSize, GridSize, Iterations,
+                 OcclusionCuller::Width, OcclusionCuller::Height );
+
+    for (int occluderCount : { 0, 16, 64, 256 })
+    {
+        result &= MeasureCity( projection, occluderCount );
+    }
+
+    std::cout << (result ? "All OcclusionCuller tests passed." : "OcclusionCuller tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
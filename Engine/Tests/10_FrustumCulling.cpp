@@ -0,0 +1,296 @@
+// Checks Frustum::CullBoxes and SetFromViewProjection against BoxInFrustum and Update, and measures culling boxes
+// one by one against culling them in batches.
+// Usage: 10_FrustumCulling
+// Doesn't need a window. Build with -mavx to measure the AVX path.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include "Frustum.hpp"
+#include "Matrix.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+namespace MathUtil
+{
+    void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax );
+    void GetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] );
+    void GetTransformedCenterAndExtent( const Vec3& min, const Vec3& max, const Matrix44& matrix, Vec3& outCenter, Vec3& outExtent );
+}
+
+const float NearDepth = 0.5f;
+const float FarDepth = 500;
+const float FovDegrees = 60;
+const float Aspect = 16.0f / 9.0f;
+const unsigned BoxCount = 20000;
+const int Iterations = 100;
+
+struct Object
+{
+    Vec3 aabbMin; // Local space.
+    Vec3 aabbMax;
+    Matrix44 localToWorld;
+};
+
+float Random( unsigned& seed, float min, float max )
+{
+    seed = seed * 1664525u + 1013904223u;
+    return min + (max - min) * (seed >> 8) / 16777216.0f;
+}
+
+std::vector< Object > MakeObjects()
+{
+    std::vector< Object > objects( BoxCount );
+    unsigned seed = 1;
+
+    for (auto& object : objects)
+    {
+        const Vec3 size( Random( seed, 0.1f, 10 ), Random( seed, 0.1f, 10 ), Random( seed, 0.1f, 10 ) );
+        object.aabbMin = -size * 0.5f;
+        object.aabbMax = size * 0.5f;
+
+        Matrix44 rotation;
+        rotation.MakeRotationXYZ( Random( seed, 0, 3 ), Random( seed, 0, 3 ), Random( seed, 0, 3 ) );
+        Matrix44 translation;
+        translation.SetTranslation( Vec3( Random( seed, -600, 600 ), Random( seed, -100, 100 ), Random( seed, -600, 600 ) ) );
+        Matrix44::Multiply( rotation, translation, object.localToWorld );
+    }
+
+    return objects;
+}
+
+// What MeshRendererComponent::Cull did for each object before batching.
+bool IsObjectVisible( const Frustum& frustum, const Object& object )
+{
+    Vec3 corners[ 8 ];
+    MathUtil::GetCorners( object.aabbMin, object.aabbMax, corners );
+
+    for (int c = 0; c < 8; ++c)
+    {
+        Matrix44::TransformPoint( corners[ c ], object.localToWorld, &corners[ c ] );
+    }
+
+    Vec3 aabbMinWorld;
+    Vec3 aabbMaxWorld;
+    MathUtil::GetMinMax( corners, 8, aabbMinWorld, aabbMaxWorld );
+    return frustum.BoxInFrustum( aabbMinWorld, aabbMaxWorld );
+}
+
+struct BoxBounds
+{
+    explicit BoxBounds( std::size_t count ) : values( 6, std::vector< float >( count ) ) {}
+
+    Frustum::BoxArrays GetArrays() const
+    {
+        Frustum::BoxArrays boxes;
+        boxes.centerX = values[ 0 ].data();
+        boxes.centerY = values[ 1 ].data();
+        boxes.centerZ = values[ 2 ].data();
+        boxes.extentX = values[ 3 ].data();
+        boxes.extentY = values[ 4 ].data();
+        boxes.extentZ = values[ 5 ].data();
+        boxes.count = static_cast< unsigned >( values[ 0 ].size() );
+        return boxes;
+    }
+
+    void Set( std::size_t index, const Vec3& center, const Vec3& extent )
+    {
+        values[ 0 ][ index ] = center.x;
+        values[ 1 ][ index ] = center.y;
+        values[ 2 ][ index ] = center.z;
+        values[ 3 ][ index ] = extent.x;
+        values[ 4 ][ index ] = extent.y;
+        values[ 5 ][ index ] = extent.z;
+    }
+
+    std::vector< std::vector< float > > values;
+};
+
+bool IsSet( const std::vector< unsigned >& mask, std::size_t index )
+{
+    return (mask[ index / 32 ] & (1u << (index % 32))) != 0;
+}
+
+bool TestCullBoxes( const Frustum& frustum, const std::vector< Object >& objects )
+{
+    // Odd counts also exercise the scalar tail after the SIMD loops.
+    for (std::size_t count : { std::size_t( 1 ), std::size_t( 7 ), std::size_t( 13 ), objects.size() })
+    {
+        BoxBounds bounds( count );
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Vec3 center, extent;
+            MathUtil::GetTransformedCenterAndExtent( objects[ i ].aabbMin, objects[ i ].aabbMax, objects[ i ].localToWorld, center, extent );
+            bounds.Set( i, center, extent );
+        }
+
+        std::vector< unsigned > mask( (count + 31) / 32, 0xDEADBEEF );
+        frustum.CullBoxes( bounds.GetArrays(), mask.data() );
+        unsigned mismatchCount = 0;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // Transformed center and extent give the same box as the transformed corners, up to rounding.
+            const Vec3 center( bounds.values[ 0 ][ i ], bounds.values[ 1 ][ i ], bounds.values[ 2 ][ i ] );
+            const Vec3 extent( bounds.values[ 3 ][ i ], bounds.values[ 4 ][ i ], bounds.values[ 5 ][ i ] );
+            const Vec3 margin( 0.01f, 0.01f, 0.01f );
+            const bool isOnBoundary = frustum.BoxInFrustum( center - extent - margin, center + extent + margin ) !=
+                                      frustum.BoxInFrustum( center - extent + margin, center + extent - margin );
+
+            if (!isOnBoundary && IsSet( mask, i ) != IsObjectVisible( frustum, objects[ i ] ))
+            {
+                ++mismatchCount;
+            }
+        }
+
+        if (mismatchCount != 0)
+        {
+            std::cerr << "Frustum::CullBoxes doesn't match BoxInFrustum!" << std::endl;
+            return false;
+        }
+
+        if (count % 32 != 0 && (mask.back() >> (count % 32)) != 0)
+        {
+            std::cerr << "Frustum::CullBoxes didn't clear unused mask bits!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Planes from the projection matrix must agree with planes from Update() everywhere but close to the near plane,
+// which is nearer the camera with a [0, w] depth range.
+bool TestViewProjectionPlanes( const Frustum& frustum, const Matrix44& worldToClip, const Vec3& cameraPosition, const Vec3& cameraForward )
+{
+    Frustum projectionFrustum = frustum;
+    projectionFrustum.SetFromViewProjection( worldToClip );
+    unsigned seed = 2;
+    unsigned mismatchCount = 0;
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        const Vec3 point( Random( seed, -600, 600 ), Random( seed, -400, 400 ), Random( seed, -600, 600 ) );
+        const float depth = Vec3::Dot( point - cameraPosition, cameraForward );
+
+        if (std::fabs( depth - NearDepth ) < 0.5f || std::fabs( depth - FarDepth ) < 0.5f)
+        {
+            continue;
+        }
+
+        // Boxes around the point allow for rounding, because planes are calculated differently.
+        const Vec3 margin( 0.1f, 0.1f, 0.1f );
+
+        if ((frustum.BoxInFrustum( point, point ) && !projectionFrustum.BoxInFrustum( point - margin, point + margin )) ||
+            (projectionFrustum.BoxInFrustum( point, point ) && !frustum.BoxInFrustum( point - margin, point + margin )))
+        {
+            ++mismatchCount;
+        }
+    }
+
+    if (mismatchCount != 0)
+    {
+        std::cerr << "Frustum::SetFromViewProjection planes don't match Update planes!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+double ElapsedMs( const std::chrono::steady_clock::time_point& startTime )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+void Measure( const Frustum& frustum, const std::vector< Object >& objects )
+{
+    double perObjectMs = 1e9;
+    double batchMs = 1e9;
+    unsigned perObjectVisibleCount = 0;
+    unsigned batchVisibleCount = 0;
+    BoxBounds bounds( objects.size() );
+    std::vector< unsigned > mask( (objects.size() + 31) / 32 );
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        const auto perObjectStartTime = std::chrono::steady_clock::now();
+        perObjectVisibleCount = 0;
+
+        for (const auto& object : objects)
+        {
+            perObjectVisibleCount += IsObjectVisible( frustum, object ) ? 1 : 0;
+        }
+
+        perObjectMs = std::min( perObjectMs, ElapsedMs( perObjectStartTime ) );
+
+        // Includes transforming the bounds, because they change when objects move.
+        const auto batchStartTime = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            Vec3 center, extent;
+            MathUtil::GetTransformedCenterAndExtent( objects[ i ].aabbMin, objects[ i ].aabbMax, objects[ i ].localToWorld, center, extent );
+            bounds.Set( i, center, extent );
+        }
+
+        frustum.CullBoxes( bounds.GetArrays(), mask.data() );
+        batchVisibleCount = 0;
+
+        for (unsigned word : mask)
+        {
+            for (; word != 0; word &= word - 1)
+            {
+                ++batchVisibleCount;
+            }
+        }
+
+        batchMs = std::min( batchMs, ElapsedMs( batchStartTime ) );
+    }
+
+    std::printf( "%zu boxes, best of %d iterations\n", objects.size(), Iterations );
+    std::printf( "  corners + BoxInFrustum: %7.3f ms, %u visible\n", perObjectMs, perObjectVisibleCount );
+    std::printf( "  center/extent + CullBoxes: %7.3f ms, %u visible\n", batchMs, batchVisibleCount );
+}
+
+int main()
+{
+    bool result = true;
+
+    const Vec3 cameraPosition( 10, 5, 20 );
+    const Vec3 cameraForward = Vec3( 0.3f, -0.2f, -1 ).Normalized();
+
+    // Row-vector view matrix like the engine's. The view's z axis points backwards.
+    const Vec3 zAxis = -cameraForward;
+    const Vec3 xAxis = Vec3::Cross( Vec3( 0, 1, 0 ), zAxis ).Normalized();
+    const Vec3 yAxis = Vec3::Cross( zAxis, xAxis ).Normalized();
+    const float viewValues[ 16 ] =
+    {
+        xAxis.x, yAxis.x, zAxis.x, 0,
+        xAxis.y, yAxis.y, zAxis.y, 0,
+        xAxis.z, yAxis.z, zAxis.z, 0,
+        -Vec3::Dot( xAxis, cameraPosition ), -Vec3::Dot( yAxis, cameraPosition ), -Vec3::Dot( zAxis, cameraPosition ), 1
+    };
+    Matrix44 view;
+    view.InitFrom( viewValues );
+    Matrix44 projection;
+    projection.MakeProjection( FovDegrees, Aspect, NearDepth, FarDepth );
+    Matrix44 worldToClip;
+    Matrix44::Multiply( view, projection, worldToClip );
+
+    Frustum frustum;
+    frustum.SetProjection( FovDegrees, Aspect, NearDepth, FarDepth );
+    frustum.Update( cameraPosition, Vec3( view.m[ 2 ], view.m[ 6 ], view.m[ 10 ] ).Normalized() );
+
+    const std::vector< Object > objects = MakeObjects();
+
+    result &= TestCullBoxes( frustum, objects );
+    result &= TestViewProjectionPlanes( frustum, worldToClip, cameraPosition, cameraForward );
+    Measure( frustum, objects );
+
+    std::cout << (result ? "All Frustum tests passed." : "Frustum tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
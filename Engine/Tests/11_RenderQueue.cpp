@@ -0,0 +1,311 @@
+// Checks RenderQueue's draw order and measures sorting and state changes against the old order, where draws were
+// sorted by mesh only.
+// Usage: 11_RenderQueue
+// Doesn't need a window. Shaders, materials and meshes are stand-in objects, only their addresses are used.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include "RenderQueue.hpp"
+
+using namespace ae3d;
+
+const unsigned ShaderCount = 8;
+const unsigned MaterialCount = 64;
+const unsigned MeshCount = 300;
+const unsigned DrawCount = 20000;
+const float FarDepth = 1000;
+const int Iterations = 50;
+
+struct Draw
+{
+    unsigned shader = 0;
+    unsigned material = 0;
+    unsigned mesh = 0;
+    float depth = 0;
+    bool isTransparent = false;
+};
+
+unsigned Random( unsigned& seed )
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+std::vector< Draw > MakeDraws()
+{
+    std::vector< Draw > draws( DrawCount );
+    unsigned seed = 1;
+
+    for (auto& draw : draws)
+    {
+        draw.material = Random( seed ) % MaterialCount;
+        draw.shader = draw.material % ShaderCount; // Materials use one shader each, like in the engine.
+        draw.mesh = Random( seed ) % MeshCount;
+        draw.depth = (Random( seed ) % 100000) / 100000.0f * FarDepth;
+        draw.isTransparent = Random( seed ) % 10 == 0;
+    }
+
+    return draws;
+}
+
+void Fill( RenderQueue& queue, const std::vector< Draw >& draws, const char* shaders, const char* materials, const char* meshes )
+{
+    queue.Clear( FarDepth );
+
+    for (unsigned i = 0; i < draws.size(); ++i)
+    {
+        const Draw& draw = draws[ i ];
+        queue.Add( draw.isTransparent ? RenderQueue::Pass::Transparent : RenderQueue::Pass::Opaque,
+                   shaders + draw.shader, materials + draw.material, meshes + draw.mesh, draw.depth, i, 0 );
+    }
+}
+
+// Counts changes between consecutive draws, like GfxDevice does for pipeline states.
+void CountChanges( const std::vector< Draw >& draws, const std::vector< unsigned >& order, unsigned& outShaderChanges, unsigned& outMaterialChanges )
+{
+    outShaderChanges = 0;
+    outMaterialChanges = 0;
+
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        outShaderChanges += (i == 0 || draws[ order[ i ] ].shader != draws[ order[ i - 1 ] ].shader) ? 1 : 0;
+        outMaterialChanges += (i == 0 || draws[ order[ i ] ].material != draws[ order[ i - 1 ] ].material) ? 1 : 0;
+    }
+}
+
+bool TestOrder( const std::vector< Draw >& draws, const RenderQueue& queue )
+{
+    const auto& items = queue.GetItems();
+
+    if (items.size() != draws.size())
+    {
+        std::cerr << "RenderQueue doesn't have all draws!" << std::endl;
+        return false;
+    }
+
+    bool isTransparentSeen = false;
+    bool isOrderValid = true;
+
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        const Draw& draw = draws[ items[ i ].object ];
+
+        if ((RenderQueue::GetPass( items[ i ] ) == RenderQueue::Pass::Transparent) != draw.isTransparent)
+        {
+            std::cerr << "RenderQueue item doesn't have its draw's pass!" << std::endl;
+            return false;
+        }
+
+        isOrderValid = isOrderValid && !(isTransparentSeen && !draw.isTransparent);
+        isTransparentSeen = isTransparentSeen || draw.isTransparent;
+
+        if (i == 0)
+        {
+            continue;
+        }
+
+        const Draw& previous = draws[ items[ i - 1 ].object ];
+
+        if (draw.isTransparent && previous.isTransparent)
+        {
+            // Depth is quantized, so equal depths can be in any order.
+            isOrderValid = isOrderValid && previous.depth >= draw.depth - FarDepth / (1 << 23);
+        }
+        else if (!draw.isTransparent && !previous.isTransparent && previous.material == draw.material && previous.mesh == draw.mesh)
+        {
+            isOrderValid = isOrderValid && previous.depth <= draw.depth + FarDepth / (1 << 23);
+        }
+    }
+
+    if (!isOrderValid)
+    {
+        std::cerr << "RenderQueue order is wrong! Opaque draws must be before transparent ones, front to back within a state, and transparent ones back to front." << std::endl;
+        return false;
+    }
+
+    // Each material's opaque draws are consecutive.
+    std::vector< unsigned > runCounts( MaterialCount, 0 );
+
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        const Draw& draw = draws[ items[ i ].object ];
+
+        if (!draw.isTransparent && (i == 0 || draws[ items[ i - 1 ].object ].material != draw.material))
+        {
+            ++runCounts[ draw.material ];
+        }
+    }
+
+    if (*std::max_element( std::begin( runCounts ), std::end( runCounts ) ) != 1)
+    {
+        std::cerr << "RenderQueue didn't group opaque draws by material!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestRadixSort()
+{
+    // Keys that differ in every byte, with duplicates to check stability.
+    std::vector< RenderQueue::Item > items( 5000 );
+    unsigned seed = 3;
+
+    for (unsigned i = 0; i < items.size(); ++i)
+    {
+        items[ i ].key = (static_cast< std::uint64_t >( Random( seed ) % 50 ) << 56) | (static_cast< std::uint64_t >( Random( seed ) ) << 24) | (Random( seed ) % 4);
+        items[ i ].object = i;
+    }
+
+    std::vector< RenderQueue::Item > expected = items;
+    std::stable_sort( std::begin( expected ), std::end( expected ), []( const RenderQueue::Item& a, const RenderQueue::Item& b ) { return a.key < b.key; } );
+
+    std::vector< RenderQueue::Item > scratch;
+    RenderQueue::RadixSort( items, scratch );
+    bool isEqual = true;
+
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        isEqual = isEqual && items[ i ].key == expected[ i ].key && items[ i ].object == expected[ i ].object;
+    }
+
+    if (!isEqual)
+    {
+        std::cerr << "RenderQueue::RadixSort doesn't match std::stable_sort!" << std::endl;
+        return false;
+    }
+
+    std::vector< RenderQueue::Item > empty;
+    RenderQueue::RadixSort( empty, scratch );
+
+    if (!empty.empty())
+    {
+        std::cerr << "RenderQueue::RadixSort failed with no items!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Scene instances runs of the same submesh, so objects' submeshes, which have the same depth, must be grouped by submesh.
+bool TestSubMeshGrouping()
+{
+    static char shader, material, mesh;
+    const unsigned ObjectCount = 4;
+    const unsigned SubMeshCount = 3;
+    RenderQueue queue;
+    queue.Clear( FarDepth );
+
+    for (unsigned object = 0; object < ObjectCount; ++object)
+    {
+        for (unsigned subMesh = 0; subMesh < SubMeshCount; ++subMesh)
+        {
+            queue.Add( RenderQueue::Pass::Opaque, &shader, &material, &mesh, 10.0f + object, object, subMesh );
+        }
+    }
+
+    queue.Sort();
+    const auto& items = queue.GetItems();
+
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        if (items[ i ].subMesh != i / ObjectCount || items[ i ].object != i % ObjectCount)
+        {
+            std::cerr << "RenderQueue didn't group opaque draws by submesh, front to back within a submesh!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+double ElapsedMs( const std::chrono::steady_clock::time_point& startTime )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+int main()
+{
+    bool result = true;
+
+    // Addresses of these stand in for shaders, materials and meshes.
+    static char shaders[ ShaderCount ];
+    static char materials[ MaterialCount ];
+    static char meshes[ MeshCount ];
+
+    const std::vector< Draw > draws = MakeDraws();
+    RenderQueue queue;
+
+    result &= TestRadixSort();
+    result &= TestSubMeshGrouping();
+    Fill( queue, draws, shaders, materials, meshes );
+    queue.Sort();
+    result &= TestOrder( draws, queue );
+
+    // Old order: opaque and transparent passes over objects sorted by mesh pointer.
+    double meshSortMs = 1e9;
+    std::vector< unsigned > meshOrder;
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        std::vector< unsigned > sorted( draws.size() );
+
+        for (unsigned i = 0; i < sorted.size(); ++i)
+        {
+            sorted[ i ] = i;
+        }
+
+        std::sort( std::begin( sorted ), std::end( sorted ), [&]( unsigned a, unsigned b ) { return meshes + draws[ a ].mesh < meshes + draws[ b ].mesh; } );
+        meshOrder.clear();
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (unsigned i : sorted)
+            {
+                if (draws[ i ].isTransparent == (pass == 1))
+                {
+                    meshOrder.push_back( i );
+                }
+            }
+        }
+
+        meshSortMs = std::min( meshSortMs, ElapsedMs( startTime ) );
+    }
+
+    double queueMs = 1e9;
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        Fill( queue, draws, shaders, materials, meshes );
+        queue.Sort();
+        queueMs = std::min( queueMs, ElapsedMs( startTime ) );
+    }
+
+    std::vector< unsigned > queueOrder;
+
+    for (const auto& item : queue.GetItems())
+    {
+        queueOrder.push_back( item.object );
+    }
+
+    unsigned meshShaderChanges, meshMaterialChanges, queueShaderChanges, queueMaterialChanges;
+    CountChanges( draws, meshOrder, meshShaderChanges, meshMaterialChanges );
+    CountChanges( draws, queueOrder, queueShaderChanges, queueMaterialChanges );
+
+    std::printf( "%u draws, %u shaders, %u materials, %u meshes, best of %d iterations\n", DrawCount, ShaderCount, MaterialCount, MeshCount, Iterations );
+    std::printf( "  sorted by mesh:  %6.3f ms, %5u shader changes, %5u material changes\n", meshSortMs, meshShaderChanges, meshMaterialChanges );
+    std::printf( "  render queue:    %6.3f ms, %5u shader changes, %5u material changes\n", queueMs, queueShaderChanges, queueMaterialChanges );
+
+    if (queueShaderChanges >= meshShaderChanges || queueMaterialChanges >= meshMaterialChanges)
+    {
+        std::cerr << "RenderQueue didn't change state less often than sorting by mesh!" << std::endl;
+        result = false;
+    }
+
+    std::cout << (result ? "All RenderQueue tests passed." : "RenderQueue tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+// Checks the screen size and LOD selection that MeshRendererComponent uses for LOD groups.
+// Usage: 12_LodSelection
+// Doesn't need a window.
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include "Matrix.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+namespace MathUtil
+{
+    float GetScreenSize( const Vec3& centerView, float radius, const Matrix44& projection );
+    unsigned SelectLod( float screenSize, const float* screenSizes, unsigned count, unsigned currentLod, float hysteresis );
+}
+
+bool IsNear( float a, float b )
+{
+    return std::fabs( a - b ) < 0.0001f;
+}
+
+bool TestScreenSize()
+{
+    Matrix44 perspective;
+    perspective.MakeProjection( 90, 16.0f / 9.0f, 0.1f, 1000 );
+
+    // With a 90 degree field of view, the viewport is 2 * distance high at distance.
+
+    if (!IsNear( MathUtil::GetScreenSize( Vec3( 0, 0, -10 ), 1, perspective ), 0.1f ))
+    {
+        std::cerr << "Perspective screen size isn't radius / distance with a 90 degree fov!" << std::endl;
+        return false;
+    }
+
+    if (!IsNear( MathUtil::GetScreenSize( Vec3( 0, 0, -20 ), 1, perspective ), 0.05f ))
+    {
+        std::cerr << "Perspective screen size didn't halve when distance doubled!" << std::endl;
+        return false;
+    }
+
+    if (!IsNear( MathUtil::GetScreenSize( Vec3( 6, 0, -8 ), 1, perspective ), 0.1f ))
+    {
+        std::cerr << "Perspective screen size depends on the direction!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::GetScreenSize( Vec3( 0, 0, -0.5f ), 1, perspective ) < 1)
+    {
+        std::cerr << "Camera inside the sphere didn't give the largest screen size!" << std::endl;
+        return false;
+    }
+
+    Matrix44 orthographic;
+    orthographic.MakeProjection( 0, 100, 0, 50, 0.1f, 1000 );
+    const float nearSize = MathUtil::GetScreenSize( Vec3( 0, 0, -10 ), 5, orthographic );
+
+    if (!IsNear( nearSize, 0.2f ))
+    {
+        std::cerr << "Orthographic screen size isn't diameter / height!" << std::endl;
+        return false;
+    }
+
+    if (!IsNear( nearSize, MathUtil::GetScreenSize( Vec3( 0, 0, -500 ), 5, orthographic ) ))
+    {
+        std::cerr << "Orthographic screen size depends on the distance!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestSelection()
+{
+    const float screenSizes[ 3 ] = { 0.5f, 0.2f, 0.05f };
+
+    if (MathUtil::SelectLod( 0.8f, screenSizes, 3, 0, 0 ) != 0)
+    {
+        std::cerr << "Large object didn't use LOD 0!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.3f, screenSizes, 3, 0, 0 ) != 1)
+    {
+        std::cerr << "LOD 1 wasn't used below the first threshold!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.1f, screenSizes, 3, 0, 0 ) != 2)
+    {
+        std::cerr << "LOD 2 wasn't used below the second threshold!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.01f, screenSizes, 3, 0, 0 ) != 3)
+    {
+        std::cerr << "The last LOD wasn't used below the last threshold!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.5f, screenSizes, 3, 0, 0 ) != 0)
+    {
+        std::cerr << "Screen size equal to the threshold didn't keep the finer LOD!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.01f, screenSizes, 0, 0, 0 ) != 0)
+    {
+        std::cerr << "LOD 0 wasn't used without LODs!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestHysteresis()
+{
+    const float screenSizes[ 2 ] = { 0.5f, 0.2f };
+    const float hysteresis = 0.1f;
+
+    // Inside the band around a threshold the current LOD is kept, whichever side the object came from.
+
+    if (MathUtil::SelectLod( 0.48f, screenSizes, 2, 0, hysteresis ) != 0)
+    {
+        std::cerr << "Finer LOD wasn't kept just below a threshold!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.52f, screenSizes, 2, 1, hysteresis ) != 1)
+    {
+        std::cerr << "Coarser LOD wasn't kept just above a threshold!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.44f, screenSizes, 2, 0, hysteresis ) != 1)
+    {
+        std::cerr << "LOD didn't change to coarser past the hysteresis band!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.56f, screenSizes, 2, 1, hysteresis ) != 0)
+    {
+        std::cerr << "LOD didn't change to finer past the hysteresis band!" << std::endl;
+        return false;
+    }
+
+    if (MathUtil::SelectLod( 0.01f, screenSizes, 2, 0, hysteresis ) != 2)
+    {
+        std::cerr << "Large screen size change didn't skip LODs!" << std::endl;
+        return false;
+    }
+
+    // An object that oscillates around a threshold changes LOD only once.
+    unsigned lod = 0;
+    unsigned changeCount = 0;
+
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        const float screenSize = 0.5f + 0.03f * std::sin( frame * 0.7f ) - (frame == 0 ? 0.1f : 0);
+        const unsigned newLod = MathUtil::SelectLod( screenSize, screenSizes, 2, lod, hysteresis );
+        changeCount += newLod != lod ? 1 : 0;
+        lod = newLod;
+    }
+
+    if (changeCount != 1)
+    {
+        std::cerr << "Hysteresis didn't stop popping near a threshold!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+    result &= TestScreenSize();
+    result &= TestSelection();
+    result &= TestHysteresis();
+
+    std::cout << (result ? "All LOD selection tests passed." : "LOD selection tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
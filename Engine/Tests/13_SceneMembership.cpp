@@ -0,0 +1,253 @@
+// Checks Scene's Add, Remove, AddRange and RemoveRange and measures them against the old membership code, which
+// searched the scene on every add and remove and erased removed objects from the middle of the array.
+// Usage: 13_SceneMembership
+// Doesn't need a window.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "GameObject.hpp"
+#include "Scene.hpp"
+
+using namespace ae3d;
+
+const unsigned ObjectCount = 20000;
+const int Iterations = 5;
+
+unsigned Random( unsigned& seed )
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+// Membership code that Scene used before.
+struct OldScene
+{
+    void Add( GameObject* gameObject )
+    {
+        for (const auto& go : gameObjects)
+        {
+            if (go == gameObject)
+            {
+                return;
+            }
+        }
+
+        gameObjects.push_back( gameObject );
+    }
+
+    void Remove( GameObject* gameObject )
+    {
+        for (std::size_t i = 0; i < gameObjects.size(); ++i)
+        {
+            if (gameObject == gameObjects[ i ])
+            {
+                gameObjects.erase( std::begin( gameObjects ) + i );
+                return;
+            }
+        }
+    }
+
+    std::vector< GameObject* > gameObjects;
+};
+
+// Game object names in the scene's order. Names are numbers.
+std::vector< int > GetNames( const Scene& scene )
+{
+    const std::string serialized = scene.GetSerialized();
+    std::vector< int > names;
+    std::size_t position = 0;
+
+    while ((position = serialized.find( "name ", position )) != std::string::npos)
+    {
+        position += 5;
+        names.push_back( std::atoi( serialized.c_str() + position ) );
+    }
+
+    return names;
+}
+
+bool TestMembership( std::vector< GameObject >& objects, const std::vector< GameObject* >& removeOrder )
+{
+    Scene scene;
+
+    for (auto& go : objects)
+    {
+        scene.Add( &go );
+    }
+
+    scene.Add( &objects[ 0 ] );
+    scene.Add( nullptr );
+
+    if (GetNames( scene ).size() != objects.size())
+    {
+        std::cerr << "Adding an object twice or null changed the scene!" << std::endl;
+        return false;
+    }
+
+    GameObject copy = objects[ 1 ];
+
+    if (!scene.Contains( &objects[ 1 ] ) || scene.Contains( &copy ))
+    {
+        std::cerr << "Copy of a game object is in the scene!" << std::endl;
+        return false;
+    }
+
+    Scene otherScene;
+
+    if (otherScene.Contains( &objects[ 1 ] ))
+    {
+        std::cerr << "Game object is in another scene!" << std::endl;
+        return false;
+    }
+
+    // Removing an object leaves a null slot until half of them are removed, so this checks both paths.
+    const std::size_t removeCount = removeOrder.size() * 3 / 4;
+    bool isContainedCorrectly = true;
+
+    for (std::size_t i = 0; i < removeCount; ++i)
+    {
+        scene.Remove( removeOrder[ i ] );
+        scene.Remove( removeOrder[ i ] );
+        isContainedCorrectly = isContainedCorrectly && !scene.Contains( removeOrder[ i ] );
+    }
+
+    for (std::size_t i = removeCount; i < removeOrder.size(); ++i)
+    {
+        isContainedCorrectly = isContainedCorrectly && scene.Contains( removeOrder[ i ] );
+    }
+
+    if (!isContainedCorrectly)
+    {
+        std::cerr << "Scene lost objects that were not removed!" << std::endl;
+        return false;
+    }
+
+    const std::vector< int > names = GetNames( scene );
+
+    if (names.size() != objects.size() - removeCount)
+    {
+        std::cerr << "Scene doesn't have the objects that were not removed!" << std::endl;
+        return false;
+    }
+
+    if (!std::is_sorted( std::begin( names ), std::end( names ) ))
+    {
+        std::cerr << "Removing changed the order of the other objects!" << std::endl;
+        return false;
+    }
+
+    scene.RemoveRange( removeOrder.data() + removeCount, static_cast< unsigned >( removeOrder.size() - removeCount ) );
+
+    if (!GetNames( scene ).empty())
+    {
+        std::cerr << "RemoveRange didn't remove all objects!" << std::endl;
+        return false;
+    }
+
+    std::vector< GameObject* > pointers;
+
+    for (auto& go : objects)
+    {
+        pointers.push_back( &go );
+    }
+
+    pointers.push_back( nullptr );
+    pointers.push_back( pointers[ 0 ] );
+    scene.AddRange( pointers.data(), static_cast< unsigned >( pointers.size() ) );
+
+    if (GetNames( scene ).size() != objects.size())
+    {
+        std::cerr << "AddRange didn't skip null and duplicate objects!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+double ElapsedMs( const std::chrono::steady_clock::time_point& startTime )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+int main()
+{
+    bool result = true;
+
+    std::vector< GameObject > objects( ObjectCount );
+
+    for (unsigned i = 0; i < ObjectCount; ++i)
+    {
+        objects[ i ].SetName( std::to_string( i ).c_str() );
+    }
+
+    std::vector< GameObject* > removeOrder;
+
+    for (auto& go : objects)
+    {
+        removeOrder.push_back( &go );
+    }
+
+    unsigned seed = 1;
+
+    for (std::size_t i = removeOrder.size() - 1; i > 0; --i)
+    {
+        std::swap( removeOrder[ i ], removeOrder[ Random( seed ) % (i + 1) ] );
+    }
+
+    result &= TestMembership( objects, removeOrder );
+
+    double oldMs = 1e9;
+    double sceneMs = 1e9;
+    double rangeMs = 1e9;
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        OldScene oldScene;
+
+        for (auto& go : objects)
+        {
+            oldScene.Add( &go );
+        }
+
+        for (auto go : removeOrder)
+        {
+            oldScene.Remove( go );
+        }
+
+        oldMs = std::min( oldMs, ElapsedMs( startTime ) );
+
+        startTime = std::chrono::steady_clock::now();
+        Scene scene;
+
+        for (auto& go : objects)
+        {
+            scene.Add( &go );
+        }
+
+        for (auto go : removeOrder)
+        {
+            scene.Remove( go );
+        }
+
+        sceneMs = std::min( sceneMs, ElapsedMs( startTime ) );
+
+        startTime = std::chrono::steady_clock::now();
+        Scene rangeScene;
+        rangeScene.AddRange( removeOrder.data(), ObjectCount );
+        rangeScene.RemoveRange( removeOrder.data(), ObjectCount );
+        rangeMs = std::min( rangeMs, ElapsedMs( startTime ) );
+    }
+
+    std::printf( "%u game objects added and removed in random order, best of %d iterations\n", ObjectCount, Iterations );
+    std::printf( "  old Add/Remove:        %8.3f ms\n", oldMs );
+    std::printf( "  Add/Remove:            %8.3f ms\n", sceneMs );
+    std::printf( "  AddRange/RemoveRange:  %8.3f ms\n", rangeMs );
+
+    std::cout << (result ? "All Scene membership tests passed." : "Scene membership tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
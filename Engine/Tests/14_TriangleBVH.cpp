@@ -0,0 +1,237 @@
+// Checks TriangleBVH's raycasts against a linear loop over all triangles and measures both, and the build time.
+// Usage: 14_TriangleBVH
+// Doesn't need a window.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include "JobSystem.hpp"
+#include "TriangleBVH.hpp"
+
+using namespace ae3d;
+
+const unsigned GridSize = 708; // 2 * 708 * 708 is about a million triangles.
+const unsigned RayCount = 2000;
+const unsigned LinearRayCount = 50; // The linear loop is slow, so it's measured with fewer rays.
+
+float Random( unsigned& seed )
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) / static_cast< float >( 1 << 24 );
+}
+
+// Bumpy terrain, like a scanned or sculpted mesh.
+std::vector< Vec3 > MakeTerrain()
+{
+    std::vector< Vec3 > triangles;
+    triangles.reserve( GridSize * GridSize * 6 );
+
+    auto height = []( unsigned x, unsigned z ) { return std::sin( x * 0.05f ) * std::cos( z * 0.07f ) * 20 + std::sin( x * 0.9f + z * 0.4f ); };
+
+    for (unsigned z = 0; z < GridSize; ++z)
+    {
+        for (unsigned x = 0; x < GridSize; ++x)
+        {
+            const Vec3 v00( (float)x, height( x, z ), (float)z );
+            const Vec3 v10( (float)x + 1, height( x + 1, z ), (float)z );
+            const Vec3 v01( (float)x, height( x, z + 1 ), (float)z + 1 );
+            const Vec3 v11( (float)x + 1, height( x + 1, z + 1 ), (float)z + 1 );
+
+            triangles.push_back( v00 ); triangles.push_back( v10 ); triangles.push_back( v11 );
+            triangles.push_back( v00 ); triangles.push_back( v11 ); triangles.push_back( v01 );
+        }
+    }
+
+    return triangles;
+}
+
+// Same test as TriangleBVH, so distances can be compared exactly.
+bool RaycastLinear( const std::vector< Vec3 >& triangles, const Vec3& origin, const Vec3& direction, float& outDistance, unsigned& outTriangle )
+{
+    float closest = 1e30f;
+    bool isHit = false;
+
+    for (unsigned i = 0; i < triangles.size() / 3; ++i)
+    {
+        const Vec3 e1 = triangles[ i * 3 + 1 ] - triangles[ i * 3 ];
+        const Vec3 e2 = triangles[ i * 3 + 2 ] - triangles[ i * 3 ];
+        const Vec3 h = Vec3::Cross( direction, e2 );
+        const float a = Vec3::Dot( e1, h );
+
+        if (a == 0)
+        {
+            continue;
+        }
+
+        const float f = 1.0f / a;
+        const Vec3 s = origin - triangles[ i * 3 ];
+        const float u = f * Vec3::Dot( s, h );
+        const Vec3 q = Vec3::Cross( s, e1 );
+        const float v = f * Vec3::Dot( direction, q );
+        const float t = f * Vec3::Dot( e2, q );
+
+        if (u >= 0 && u <= 1 && v >= 0 && u + v <= 1 && t >= 0 && t < closest)
+        {
+            closest = t;
+            outTriangle = i;
+            isHit = true;
+        }
+    }
+
+    outDistance = closest;
+    return isHit;
+}
+
+void MakeRay( unsigned& seed, Vec3& outOrigin, Vec3& outDirection )
+{
+    // From above the terrain towards a point on it, like picking with a tilted camera.
+    outOrigin = Vec3( Random( seed ) * GridSize, 60, Random( seed ) * GridSize );
+    const Vec3 target( Random( seed ) * GridSize, 0, Random( seed ) * GridSize );
+    outDirection = (target - outOrigin).Normalized();
+}
+
+double ElapsedMs( const std::chrono::steady_clock::time_point& startTime )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+bool TestSmallInputs()
+{
+    TriangleBVH bvh;
+    float distance = -1;
+    unsigned triangle = 99;
+
+    bvh.Build( nullptr, 0 );
+
+    if (bvh.Raycast( Vec3( 0, 0, 0 ), Vec3( 0, 0, 1 ), 100, distance, triangle ))
+    {
+        std::cerr << "Empty TriangleBVH was hit!" << std::endl;
+        return false;
+    }
+
+    const Vec3 triangles[ 6 ] = { Vec3( -1, -1, 5 ), Vec3( 1, -1, 5 ), Vec3( 0, 1, 5 ), Vec3( -1, -1, 3 ), Vec3( 1, -1, 3 ), Vec3( 0, 1, 3 ) };
+    bvh.Build( triangles, 2 );
+
+    if (!bvh.Raycast( Vec3( 0, 0, 0 ), Vec3( 0, 0, 2 ), 100, distance, triangle ) || triangle != 1 || std::fabs( distance - 1.5f ) >= 0.0001f)
+    {
+        std::cerr << "TriangleBVH didn't hit the closest triangle at a distance in direction's units!" << std::endl;
+        return false;
+    }
+
+    if (!bvh.Raycast( Vec3( 0, 0, 10 ), Vec3( 0, 0, -1 ), 100, distance, triangle ) || triangle != 0)
+    {
+        std::cerr << "TriangleBVH didn't hit a back side!" << std::endl;
+        return false;
+    }
+
+    if (bvh.Raycast( Vec3( 0, 0, 0 ), Vec3( 0, 0, 1 ), 2, distance, triangle ))
+    {
+        std::cerr << "TriangleBVH hit beyond maxDistance!" << std::endl;
+        return false;
+    }
+
+    if (bvh.Raycast( Vec3( 0, 0, 0 ), Vec3( 0, 0, -1 ), 100, distance, triangle ))
+    {
+        std::cerr << "TriangleBVH hit a triangle behind the origin!" << std::endl;
+        return false;
+    }
+
+    // All triangles at the same place can't be separated, but leaves still have to be split.
+    std::vector< Vec3 > stacked;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        stacked.insert( std::end( stacked ), triangles, triangles + 3 );
+    }
+
+    bvh.Build( stacked.data(), 1000 );
+
+    if (!bvh.Raycast( Vec3( 0, 0, 0 ), Vec3( 0, 0, 1 ), 100, distance, triangle ) || bvh.GetHeight() >= 64)
+    {
+        std::cerr << "TriangleBVH didn't split identical triangles!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+    result &= TestSmallInputs();
+
+    const std::vector< Vec3 > triangles = MakeTerrain();
+    const unsigned triangleCount = static_cast< unsigned >( triangles.size() / 3 );
+    TriangleBVH bvh;
+
+    JobSystem::Init();
+
+    // The first build warms up caches, so it's not measured.
+    bvh.Build( triangles.data(), triangleCount );
+    auto startTime = std::chrono::steady_clock::now();
+    bvh.Build( triangles.data(), triangleCount );
+    const double buildMs = ElapsedMs( startTime );
+
+    unsigned seed = 1;
+    unsigned mismatchCount = 0;
+    unsigned hitCount = 0;
+    double linearMs = 0;
+
+    for (unsigned r = 0; r < LinearRayCount; ++r)
+    {
+        Vec3 origin, direction;
+        MakeRay( seed, origin, direction );
+
+        float linearDistance = 0, bvhDistance = 0;
+        unsigned linearTriangle = 0, bvhTriangle = 0;
+
+        startTime = std::chrono::steady_clock::now();
+        const bool isLinearHit = RaycastLinear( triangles, origin, direction, linearDistance, linearTriangle );
+        linearMs += ElapsedMs( startTime );
+
+        const bool isBvhHit = bvh.Raycast( origin, direction, 1e30f, bvhDistance, bvhTriangle );
+        hitCount += isBvhHit ? 1 : 0;
+
+        // Rays through a shared edge can hit either triangle.
+        if (isLinearHit != isBvhHit || (isLinearHit && std::fabs( linearDistance - bvhDistance ) > 0.001f))
+        {
+            ++mismatchCount;
+        }
+    }
+
+    if (mismatchCount != 0)
+    {
+        std::cerr << "TriangleBVH hits don't match the linear loop!" << std::endl;
+        result = false;
+    }
+
+    if (hitCount != LinearRayCount)
+    {
+        std::cerr << "Rays towards the terrain didn't hit it!" << std::endl;
+        result = false;
+    }
+
+    startTime = std::chrono::steady_clock::now();
+
+    for (unsigned r = 0; r < RayCount; ++r)
+    {
+        Vec3 origin, direction;
+        MakeRay( seed, origin, direction );
+        float distance;
+        unsigned triangle;
+        hitCount += bvh.Raycast( origin, direction, 1e30f, distance, triangle ) ? 1 : 0;
+    }
+
+    const double bvhMs = ElapsedMs( startTime );
+
+    std::printf( "%u triangles, %u nodes, height %u, %u worker threads\n", triangleCount, bvh.GetNodeCount(), bvh.GetHeight(), JobSystem::GetWorkerCount() );
+    std::printf( "  build:          %8.2f ms\n", buildMs );
+    std::printf( "  linear raycast: %8.4f ms per ray\n", linearMs / LinearRayCount );
+    std::printf( "  BVH raycast:    %8.4f ms per ray\n", bvhMs / RayCount );
+
+    JobSystem::Deinit();
+    std::cout << (result ? "All TriangleBVH tests passed." : "TriangleBVH tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
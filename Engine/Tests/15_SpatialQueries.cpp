@@ -0,0 +1,234 @@
+// Checks AABBTree's ray, sphere and nearest queries that Scene's spatial queries use against loops over all boxes,
+// and measures queries from several threads at the same time.
+// Usage: 15_SpatialQueries
+// Doesn't need a window.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "AABBTree.hpp"
+
+using namespace ae3d;
+
+const unsigned BoxCount = 20000;
+const float WorldSize = 1000;
+const unsigned QueryCount = 5000;
+const unsigned ThreadCount = 4;
+const unsigned NearestCount = 8;
+
+float Random( unsigned& seed )
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) / static_cast< float >( 1 << 24 );
+}
+
+struct Box
+{
+    Vec3 min;
+    Vec3 max;
+};
+
+Vec3 RandomPoint( unsigned& seed )
+{
+    return Vec3( Random( seed ) * WorldSize, Random( seed ) * WorldSize * 0.1f, Random( seed ) * WorldSize );
+}
+
+float GetDistance( const Vec3& point, const Box& box )
+{
+    const Vec3 closest = Vec3::Min2( Vec3::Max2( point, box.min ), box.max );
+    return (closest - point).Length();
+}
+
+bool IntersectsRay( const Box& box, const Vec3& origin, const Vec3& direction, float maxDistance )
+{
+    float tMin = 0;
+    float tMax = maxDistance;
+    const float o[ 3 ] = { origin.x, origin.y, origin.z };
+    const float d[ 3 ] = { direction.x, direction.y, direction.z };
+    const float bMin[ 3 ] = { box.min.x, box.min.y, box.min.z };
+    const float bMax[ 3 ] = { box.max.x, box.max.y, box.max.z };
+
+    for (int a = 0; a < 3; ++a)
+    {
+        if (d[ a ] == 0)
+        {
+            if (o[ a ] < bMin[ a ] || o[ a ] > bMax[ a ])
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        const float t1 = (bMin[ a ] - o[ a ]) / d[ a ];
+        const float t2 = (bMax[ a ] - o[ a ]) / d[ a ];
+        tMin = std::max( tMin, std::min( t1, t2 ) );
+        tMax = std::min( tMax, std::max( t1, t2 ) );
+    }
+
+    return tMin <= tMax;
+}
+
+bool ContainsAll( std::vector< unsigned > found, const std::vector< unsigned >& expected )
+{
+    std::sort( std::begin( found ), std::end( found ) );
+    return std::all_of( std::begin( expected ), std::end( expected ), [ &found ]( unsigned i ) { return std::binary_search( std::begin( found ), std::end( found ), i ); } );
+}
+
+double ElapsedMs( const std::chrono::steady_clock::time_point& startTime )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+int main()
+{
+    bool result = true;
+
+    std::vector< Box > boxes( BoxCount );
+    AABBTree tree;
+    unsigned seed = 1;
+
+    for (unsigned i = 0; i < BoxCount; ++i)
+    {
+        boxes[ i ].min = RandomPoint( seed );
+        boxes[ i ].max = boxes[ i ].min + Vec3( 1 + Random( seed ) * 5, 1 + Random( seed ) * 5, 1 + Random( seed ) * 5 );
+        tree.Insert( boxes[ i ].min, boxes[ i ].max, i );
+    }
+
+    bool isRayCorrect = true;
+    bool isSphereCorrect = true;
+    bool isNearestCorrect = true;
+    std::vector< unsigned > found;
+    std::vector< unsigned > expected;
+    std::vector< std::pair< float, unsigned > > nearest;
+    auto boxDistance = [ &boxes ]( const Vec3& point ) { return [ &boxes, point ]( unsigned i ) { return GetDistance( point, boxes[ i ] ); }; };
+
+    for (unsigned q = 0; q < 200; ++q)
+    {
+        const Vec3 origin = RandomPoint( seed );
+        const Vec3 direction = (RandomPoint( seed ) - origin).Normalized();
+        const float radius = Random( seed ) * 30;
+
+        // The tree's boxes are enlarged, so it can find more than the loops.
+        found.clear();
+        expected.clear();
+        tree.QueryRay( origin, direction, 300, found );
+
+        for (unsigned i = 0; i < BoxCount; ++i)
+        {
+            if (IntersectsRay( boxes[ i ], origin, direction, 300 ))
+            {
+                expected.push_back( i );
+            }
+        }
+
+        isRayCorrect = isRayCorrect && ContainsAll( found, expected );
+
+        found.clear();
+        expected.clear();
+        tree.QuerySphere( origin, radius, found );
+
+        for (unsigned i = 0; i < BoxCount; ++i)
+        {
+            if (GetDistance( origin, boxes[ i ] ) <= radius)
+            {
+                expected.push_back( i );
+            }
+        }
+
+        isSphereCorrect = isSphereCorrect && ContainsAll( found, expected );
+
+        // Nearest leaves are measured with the exact boxes, so the result is exact.
+        tree.QueryNearest( origin, NearestCount, 1e30f, boxDistance( origin ), nearest );
+        std::vector< float > distances( BoxCount );
+
+        for (unsigned i = 0; i < BoxCount; ++i)
+        {
+            distances[ i ] = GetDistance( origin, boxes[ i ] );
+        }
+
+        std::partial_sort( std::begin( distances ), std::begin( distances ) + NearestCount, std::end( distances ) );
+        isNearestCorrect = isNearestCorrect && nearest.size() == NearestCount;
+
+        for (unsigned i = 0; i < nearest.size() && i < NearestCount; ++i)
+        {
+            isNearestCorrect = isNearestCorrect && nearest[ i ].first == distances[ i ] && GetDistance( origin, boxes[ nearest[ i ].second ] ) == distances[ i ];
+        }
+    }
+
+    if (!isRayCorrect)
+    {
+        std::cerr << "AABBTree ray query didn't find all boxes that the ray hits!" << std::endl;
+        result = false;
+    }
+
+    if (!isSphereCorrect)
+    {
+        std::cerr << "AABBTree sphere query didn't find all boxes that overlap the sphere!" << std::endl;
+        result = false;
+    }
+
+    if (!isNearestCorrect)
+    {
+        std::cerr << "AABBTree nearest query didn't find the nearest boxes in order!" << std::endl;
+        result = false;
+    }
+
+    tree.QueryNearest( Vec3( 0, 0, 0 ), NearestCount, 0.001f, boxDistance( Vec3( -100, 0, 0 ) ), nearest );
+
+    if (!nearest.empty())
+    {
+        std::cerr << "AABBTree nearest query found boxes beyond maxDistance!" << std::endl;
+        result = false;
+    }
+
+    tree.QueryNearest( Vec3( 0, 0, 0 ), NearestCount, 1e30f, []( unsigned i ) { return i % 2 == 0 ? -1.0f : 0.0f; }, nearest );
+
+    if (nearest.size() != NearestCount || std::any_of( std::begin( nearest ), std::end( nearest ), []( const std::pair< float, unsigned >& leaf ) { return leaf.second % 2 == 0; } ))
+    {
+        std::cerr << "AABBTree nearest query found leaves with negative distance!" << std::endl;
+        result = false;
+    }
+
+    // Each thread runs a mix of queries, like gameplay code asking what is near its objects.
+    std::vector< std::thread > threads;
+    std::vector< unsigned > resultCounts( ThreadCount );
+    const auto startTime = std::chrono::steady_clock::now();
+
+    for (unsigned t = 0; t < ThreadCount; ++t)
+    {
+        threads.emplace_back( [ &, t ]()
+        {
+            unsigned threadSeed = t + 100;
+            std::vector< unsigned > results;
+            std::vector< std::pair< float, unsigned > > nearestResults;
+
+            for (unsigned q = 0; q < QueryCount; ++q)
+            {
+                const Vec3 point = RandomPoint( threadSeed );
+                results.clear();
+                tree.QueryRay( point, (RandomPoint( threadSeed ) - point).Normalized(), 100, results );
+                tree.QuerySphere( point, 10, results );
+                tree.QueryNearest( point, NearestCount, 1e30f, boxDistance( point ), nearestResults );
+                resultCounts[ t ] += static_cast< unsigned >( results.size() + nearestResults.size() );
+            }
+        } );
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    const double threadedMs = ElapsedMs( startTime );
+    const unsigned totalQueries = ThreadCount * QueryCount * 3;
+
+    std::printf( "%u boxes, tree height %d\n", BoxCount, tree.GetHeight() );
+    std::printf( "  %u ray, sphere and nearest queries on %u threads: %.2f ms, %.2f us per query\n", totalQueries, ThreadCount, threadedMs, threadedMs * 1000 / totalQueries );
+
+    std::cout << (result ? "All AABBTree spatial query tests passed." : "AABBTree spatial query tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
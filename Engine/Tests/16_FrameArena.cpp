@@ -0,0 +1,226 @@
+// Checks that FrameArena stops allocating from the heap after the first frames, also with worker threads,
+// and that render-loop-like scratch code doesn't call operator new at all in a steady-state frame.
+// Usage: 16_FrameArena
+// Doesn't need a window.
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+#include "FrameArena.hpp"
+
+using namespace ae3d;
+
+const unsigned FrameCount = 50;
+const unsigned ThreadCount = 4;
+
+std::atomic< unsigned > operatorNewCount( 0 );
+
+void* operator new( std::size_t size )
+{
+    ++operatorNewCount;
+    void* memory = std::malloc( size == 0 ? 1 : size );
+
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void operator delete( void* memory ) noexcept
+{
+    std::free( memory );
+}
+
+void operator delete( void* memory, std::size_t ) noexcept
+{
+    std::free( memory );
+}
+
+struct Matrix
+{
+    float m[ 16 ];
+};
+
+// Like a camera pass in the render loop: per-object arrays and a growing list, sizes vary between frames.
+float SimulateCamera( unsigned objectCount )
+{
+    FrameArray< Matrix > localToViews( objectCount );
+    FrameArray< Matrix* > pointers( objectCount );
+    FrameVector< unsigned > visible;
+    float sum = 0;
+
+    for (unsigned i = 0; i < objectCount; ++i)
+    {
+        localToViews[ i ].m[ 0 ] = static_cast< float >( i );
+        pointers[ i ] = &localToViews[ i ];
+
+        if (i % 3 != 0)
+        {
+            visible.push_back( i );
+        }
+    }
+
+    for (unsigned i : visible)
+    {
+        sum += pointers[ i ]->m[ 0 ];
+    }
+
+    return sum;
+}
+
+float SimulateFrame( unsigned frame )
+{
+    float sum = 0;
+
+    for (unsigned camera = 0; camera < 3; ++camera)
+    {
+        sum += SimulateCamera( 1000 + (frame * 37 + camera * 101) % 3000 );
+    }
+
+    // Scratch that lives until the end of the frame, like data handed to a command buffer.
+    FrameArena::Allocate( 20000, 256 );
+    return sum;
+}
+
+bool TestAlignmentAndReuse()
+{
+    for (std::size_t alignment = 1; alignment <= 4096; alignment *= 2)
+    {
+        FrameArena::Allocate( 3, 1 );
+        const void* memory = FrameArena::Allocate( 10, alignment );
+
+        if (reinterpret_cast< std::uintptr_t >( memory ) % alignment != 0)
+        {
+            std::cerr << "FrameArena allocation is not aligned!" << std::endl;
+            return false;
+        }
+    }
+
+    void* first = FrameArena::Allocate( 100, 16 );
+    FrameArena::Free( first, 100 );
+
+    if (FrameArena::Allocate( 100, 16 ) != first)
+    {
+        std::cerr << "Freeing the latest FrameArena allocation didn't give its memory back!" << std::endl;
+        return false;
+    }
+
+    void* older = FrameArena::Allocate( 100, 16 );
+    void* newer = FrameArena::Allocate( 100, 16 );
+    FrameArena::Free( older, 100 );
+
+    if (FrameArena::Allocate( 100, 16 ) == older || newer == older)
+    {
+        std::cerr << "Freeing an older FrameArena allocation gave its memory back!" << std::endl;
+        return false;
+    }
+
+    FrameArena::Reset();
+
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+    result &= TestAlignmentAndReuse();
+
+    // Main thread only.
+    float sum = 0;
+    unsigned warmUpHeapAllocations = 0;
+
+    for (unsigned frame = 0; frame < FrameCount; ++frame)
+    {
+        if (frame == FrameCount / 2)
+        {
+            warmUpHeapAllocations = FrameArena::GetHeapAllocationCount();
+        }
+
+        sum += SimulateFrame( frame );
+        FrameArena::Reset();
+    }
+
+    if (FrameArena::GetHeapAllocationCount() != warmUpHeapAllocations)
+    {
+        std::cerr << "FrameArena allocated after warm-up frames!" << std::endl;
+        result = false;
+    }
+
+    const unsigned newCountBefore = operatorNewCount;
+    sum += SimulateFrame( 7 );
+    FrameArena::Reset();
+
+    if (operatorNewCount != newCountBefore)
+    {
+        std::cerr << "Steady-state frame called operator new!" << std::endl;
+        result = false;
+    }
+
+    // Workers allocate from their own arenas, the main thread resets between frames like Scene::EndFrame.
+    std::vector< std::thread > threads;
+    std::atomic< unsigned > finishedFrame( 0 );
+    std::atomic< unsigned > nextFrame( 0 );
+    unsigned steadyNewCount = 0;
+
+    for (unsigned t = 0; t < ThreadCount; ++t)
+    {
+        threads.emplace_back( [ &, t ]()
+        {
+            for (unsigned frame = 0; frame < FrameCount; ++frame)
+            {
+                while (nextFrame < frame + 1)
+                {
+                    std::this_thread::yield();
+                }
+
+                SimulateFrame( frame + t );
+                ++finishedFrame;
+            }
+        } );
+    }
+
+    for (unsigned frame = 0; frame < FrameCount; ++frame)
+    {
+        if (frame == FrameCount / 2)
+        {
+            warmUpHeapAllocations = FrameArena::GetHeapAllocationCount();
+            steadyNewCount = operatorNewCount;
+        }
+
+        ++nextFrame;
+
+        while (finishedFrame < (frame + 1) * ThreadCount)
+        {
+            std::this_thread::yield();
+        }
+
+        FrameArena::Reset();
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (FrameArena::GetHeapAllocationCount() != warmUpHeapAllocations)
+    {
+        std::cerr << "Worker FrameArenas allocated after warm-up frames!" << std::endl;
+        result = false;
+    }
+
+    if (operatorNewCount != steadyNewCount)
+    {
+        std::cerr << "Steady-state frames on workers called operator new!" << std::endl;
+        result = false;
+    }
+
+    std::printf( "%u frames, %u heap blocks in total, checksum %.0f\n", FrameCount, FrameArena::GetHeapAllocationCount(), sum );
+    std::cout << (result ? "All FrameArena tests passed." : "FrameArena tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+// Checks AABBTree's box and frustum queries against loops over all boxes while boxes are inserted, moved and removed.
+// Usage: 17_AABBTree
+// Doesn't need a window.
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "AABBTree.hpp"
+#include "Frustum.hpp"
+
+using namespace ae3d;
+
+const unsigned BoxCount = 5000;
+const float WorldSize = 500;
+
+struct Box
+{
+    Vec3 min;
+    Vec3 max;
+    int proxy = AABBTree::NullNode; // NullNode when the box is not in the tree.
+};
+
+float Random( unsigned& seed )
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) / static_cast< float >( 1 << 24 );
+}
+
+void MakeBox( unsigned& seed, Box& box )
+{
+    box.min = Vec3( Random( seed ) * WorldSize, Random( seed ) * WorldSize * 0.2f, Random( seed ) * WorldSize );
+    box.max = box.min + Vec3( 0.5f + Random( seed ) * 4, 0.5f + Random( seed ) * 4, 0.5f + Random( seed ) * 4 );
+}
+
+bool Overlaps( const Box& box, const Vec3& min, const Vec3& max )
+{
+    return box.min.x <= max.x && box.max.x >= min.x && box.min.y <= max.y && box.max.y >= min.y && box.min.z <= max.z && box.max.z >= min.z;
+}
+
+// The tree's boxes are enlarged, so it can find more than the loop, but it must find every overlapping box,
+// only boxes that are in the tree, and each of them once.
+bool IsValidResult( std::vector< unsigned > found, const std::vector< unsigned >& expected, const std::vector< Box >& boxes )
+{
+    std::sort( std::begin( found ), std::end( found ) );
+
+    if (std::adjacent_find( std::begin( found ), std::end( found ) ) != std::end( found ))
+    {
+        return false;
+    }
+
+    for (unsigned i : found)
+    {
+        if (i >= boxes.size() || boxes[ i ].proxy == AABBTree::NullNode)
+        {
+            return false;
+        }
+    }
+
+    return std::all_of( std::begin( expected ), std::end( expected ), [ &found ]( unsigned i ) { return std::binary_search( std::begin( found ), std::end( found ), i ); } );
+}
+
+bool CheckQueries( const AABBTree& tree, const std::vector< Box >& boxes, unsigned& seed )
+{
+    std::vector< unsigned > found;
+    std::vector< unsigned > expected;
+
+    for (int q = 0; q < 100; ++q)
+    {
+        Box query;
+        MakeBox( seed, query );
+        query.max = query.max + Vec3( Random( seed ) * 40, Random( seed ) * 40, Random( seed ) * 40 );
+
+        found.clear();
+        expected.clear();
+        tree.Query( query.min, query.max, found );
+
+        for (unsigned i = 0; i < boxes.size(); ++i)
+        {
+            if (boxes[ i ].proxy != AABBTree::NullNode && Overlaps( boxes[ i ], query.min, query.max ))
+            {
+                expected.push_back( i );
+            }
+        }
+
+        if (!IsValidResult( found, expected, boxes ))
+        {
+            std::cerr << "AABBTree box query doesn't match the loop!" << std::endl;
+            return false;
+        }
+    }
+
+    Frustum frustum;
+    frustum.SetProjection( 60, 16.0f / 9.0f, 0.5f, 200 );
+
+    for (int q = 0; q < 20; ++q)
+    {
+        const Vec3 position( Random( seed ) * WorldSize, 20, Random( seed ) * WorldSize );
+        frustum.Update( position, Vec3( Random( seed ) - 0.5f, -0.2f, Random( seed ) - 0.5f ).Normalized() );
+
+        found.clear();
+        expected.clear();
+        tree.Query( frustum, found );
+
+        for (unsigned i = 0; i < boxes.size(); ++i)
+        {
+            if (boxes[ i ].proxy != AABBTree::NullNode && frustum.BoxInFrustum( boxes[ i ].min, boxes[ i ].max ))
+            {
+                expected.push_back( i );
+            }
+        }
+
+        if (!IsValidResult( found, expected, boxes ))
+        {
+            std::cerr << "AABBTree frustum query doesn't match the loop!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool IsHeightLogarithmic( const AABBTree& tree, unsigned leafCount )
+{
+    if (tree.GetHeight() > 2 * static_cast< int >( std::log2( static_cast< float >( leafCount ) ) ) + 2)
+    {
+        std::cerr << "AABBTree height " << tree.GetHeight() << " is too big for " << leafCount << " leaves!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestInsertMoveRemove()
+{
+    AABBTree tree;
+    std::vector< Box > boxes( BoxCount );
+    unsigned seed = 1;
+
+    for (unsigned i = 0; i < BoxCount; ++i)
+    {
+        MakeBox( seed, boxes[ i ] );
+        boxes[ i ].proxy = tree.Insert( boxes[ i ].min, boxes[ i ].max, i );
+    }
+
+    if (!CheckQueries( tree, boxes, seed ) || !IsHeightLogarithmic( tree, BoxCount ))
+    {
+        return false;
+    }
+
+    // Small moves stay inside the enlarged boxes, large ones reinsert.
+    unsigned reinsertCount = 0;
+
+    for (unsigned i = 0; i < BoxCount; ++i)
+    {
+        const Vec3 offset = i % 4 == 0 ? Vec3( Random( seed ) * 100 - 50, 0, Random( seed ) * 100 - 50 ) : Vec3( 0.01f, 0, 0 );
+        boxes[ i ].min = boxes[ i ].min + offset;
+        boxes[ i ].max = boxes[ i ].max + offset;
+        reinsertCount += tree.Move( boxes[ i ].proxy, boxes[ i ].min, boxes[ i ].max ) ? 1 : 0;
+    }
+
+    if (reinsertCount != BoxCount / 4)
+    {
+        std::cerr << "AABBTree Move reinserted " << reinsertCount << " leaves, expected " << BoxCount / 4 << "!" << std::endl;
+        return false;
+    }
+
+    if (!CheckQueries( tree, boxes, seed ))
+    {
+        return false;
+    }
+
+    // Removes every third box, then reinserts half of those in new places, so freed nodes are reused.
+    unsigned leafCount = BoxCount;
+
+    for (unsigned i = 0; i < BoxCount; i += 3)
+    {
+        tree.Remove( boxes[ i ].proxy );
+        boxes[ i ].proxy = AABBTree::NullNode;
+        --leafCount;
+    }
+
+    if (!CheckQueries( tree, boxes, seed ))
+    {
+        return false;
+    }
+
+    for (unsigned i = 0; i < BoxCount; i += 6)
+    {
+        MakeBox( seed, boxes[ i ] );
+        boxes[ i ].proxy = tree.Insert( boxes[ i ].min, boxes[ i ].max, i );
+        ++leafCount;
+    }
+
+    return CheckQueries( tree, boxes, seed ) && IsHeightLogarithmic( tree, leafCount );
+}
+
+bool TestMoveAway()
+{
+    AABBTree tree;
+    const int proxy = tree.Insert( Vec3( 0, 0, 0 ), Vec3( 1, 1, 1 ), 7 );
+    std::vector< unsigned > found;
+
+    if (tree.Move( proxy, Vec3( 0.01f, 0, 0 ), Vec3( 1.01f, 1, 1 ) ))
+    {
+        std::cerr << "AABBTree Move reinserted a leaf that stayed inside its enlarged box!" << std::endl;
+        return false;
+    }
+
+    if (!tree.Move( proxy, Vec3( 100, 0, 0 ), Vec3( 101, 1, 1 ) ))
+    {
+        std::cerr << "AABBTree Move didn't reinsert a leaf that left its enlarged box!" << std::endl;
+        return false;
+    }
+
+    tree.Query( Vec3( -1, -1, -1 ), Vec3( 2, 2, 2 ), found );
+
+    if (!found.empty())
+    {
+        std::cerr << "AABBTree query found a leaf at its old place!" << std::endl;
+        return false;
+    }
+
+    tree.Query( Vec3( 99, 0, 0 ), Vec3( 102, 2, 2 ), found );
+
+    if (found.size() != 1 || found[ 0 ] != 7)
+    {
+        std::cerr << "AABBTree query didn't find a moved leaf!" << std::endl;
+        return false;
+    }
+
+    tree.SetUserData( proxy, 8 );
+    tree.Remove( proxy );
+    found.clear();
+    tree.Query( Vec3( -1000, -1000, -1000 ), Vec3( 1000, 1000, 1000 ), found );
+
+    if (!found.empty() || tree.GetHeight() != 0)
+    {
+        std::cerr << "AABBTree is not empty after removing its only leaf!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestClear()
+{
+    AABBTree tree;
+    std::vector< unsigned > found;
+
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        tree.Insert( Vec3( (float)i, 0, 0 ), Vec3( (float)i + 1, 1, 1 ), i );
+    }
+
+    tree.Clear();
+    tree.Query( Vec3( -1000, -1000, -1000 ), Vec3( 1000, 1000, 1000 ), found );
+
+    if (!found.empty() || tree.GetHeight() != 0)
+    {
+        std::cerr << "AABBTree is not empty after Clear!" << std::endl;
+        return false;
+    }
+
+    tree.Insert( Vec3( 0, 0, 0 ), Vec3( 1, 1, 1 ), 3 );
+    tree.Query( Vec3( 0, 0, 0 ), Vec3( 1, 1, 1 ), found );
+
+    if (found.size() != 1 || found[ 0 ] != 3)
+    {
+        std::cerr << "AABBTree insert after Clear failed!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+
+    result &= TestInsertMoveRemove();
+    result &= TestMoveAway();
+    result &= TestClear();
+
+    std::cout << (result ? "All AABBTree tests passed." : "AABBTree tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+// Checks that JobSystem::ParallelFor runs every item once, also for empty ranges, nested calls and several calling threads.
+// Usage: 18_JobSystem
+// Doesn't need a window.
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "JobSystem.hpp"
+
+using namespace ae3d;
+
+// Runs ParallelFor and checks that each item in [0, count) was visited once, in batches of at most batchSize items.
+bool RunsEachItemOnce( unsigned count, unsigned batchSize )
+{
+    std::unique_ptr< std::atomic< unsigned >[] > visitCounts( new std::atomic< unsigned >[ count + 1 ] );
+    std::atomic< bool > isBatchValid( true );
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        visitCounts[ i ] = 0;
+    }
+
+    JobSystem::ParallelFor( count, batchSize, [ & ]( unsigned first, unsigned last )
+    {
+        if (first >= last || last > count || last - first > (batchSize > 0 ? batchSize : 1))
+        {
+            isBatchValid = false;
+            return;
+        }
+
+        for (unsigned i = first; i < last; ++i)
+        {
+            ++visitCounts[ i ];
+        }
+    } );
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (visitCounts[ i ] != 1)
+        {
+            return false;
+        }
+    }
+
+    return isBatchValid;
+}
+
+bool TestBeforeInit()
+{
+    const std::thread::id callingThread = std::this_thread::get_id();
+    bool isOnCallingThread = true;
+
+    JobSystem::ParallelFor( 1000, 10, [ & ]( unsigned, unsigned )
+    {
+        isOnCallingThread = isOnCallingThread && std::this_thread::get_id() == callingThread;
+    } );
+
+    if (!isOnCallingThread || JobSystem::GetWorkerCount() != 0)
+    {
+        std::cerr << "ParallelFor started worker threads before Init!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestEmptyRange()
+{
+    bool isCalled = false;
+    JobSystem::ParallelFor( 0, 16, [ &isCalled ]( unsigned, unsigned ) { isCalled = true; } );
+
+    if (isCalled)
+    {
+        std::cerr << "ParallelFor called the job for an empty range!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestCoverage()
+{
+    const unsigned counts[] = { 1, 2, 7, 64, 1000, 100003 };
+    const unsigned batchSizes[] = { 0, 1, 3, 64, 5000, 200000 };
+
+    for (unsigned count : counts)
+    {
+        for (unsigned batchSize : batchSizes)
+        {
+            if (!RunsEachItemOnce( count, batchSize ))
+            {
+                std::cerr << "ParallelFor didn't run each of " << count << " items once with batch size " << batchSize << "!" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool TestNested()
+{
+    const unsigned outerCount = 64;
+    const unsigned innerCount = 1000;
+    std::atomic< unsigned > validInnerCount( 0 );
+
+    JobSystem::ParallelFor( outerCount, 1, [ & ]( unsigned first, unsigned last )
+    {
+        for (unsigned i = first; i < last; ++i)
+        {
+            validInnerCount += RunsEachItemOnce( innerCount, 16 ) ? 1 : 0;
+        }
+    } );
+
+    if (validInnerCount != outerCount)
+    {
+        std::cerr << "Nested ParallelFor didn't run each item once!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Threads that are not workers share a queue, so their batches can be run by each other.
+bool TestSeveralCallers()
+{
+    const unsigned threadCount = 4;
+    std::vector< std::thread > threads;
+    std::atomic< unsigned > validCount( 0 );
+
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back( [ &validCount ]()
+        {
+            for (int i = 0; i < 50; ++i)
+            {
+                validCount += RunsEachItemOnce( 5000, 32 ) ? 1 : 0;
+            }
+        } );
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (validCount != threadCount * 50)
+    {
+        std::cerr << "ParallelFor from several threads didn't run each item once!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestRestart()
+{
+    const unsigned workerCount = JobSystem::GetWorkerCount();
+    JobSystem::Init();
+
+    if (JobSystem::GetWorkerCount() != workerCount)
+    {
+        std::cerr << "JobSystem::Init started workers twice!" << std::endl;
+        return false;
+    }
+
+    JobSystem::Deinit();
+
+    if (JobSystem::GetWorkerCount() != 0 || !RunsEachItemOnce( 1000, 10 ))
+    {
+        std::cerr << "ParallelFor failed after Deinit!" << std::endl;
+        return false;
+    }
+
+    JobSystem::Init();
+
+    if (JobSystem::GetWorkerCount() != workerCount || !RunsEachItemOnce( 1000, 10 ))
+    {
+        std::cerr << "ParallelFor failed after restarting JobSystem!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+
+    result &= TestBeforeInit();
+    JobSystem::Init();
+    result &= TestEmptyRange();
+    result &= TestCoverage();
+    result &= TestNested();
+    result &= TestSeveralCallers();
+    result &= TestRestart();
+    JobSystem::Deinit();
+
+    std::cout << (result ? "All JobSystem tests passed." : "JobSystem tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
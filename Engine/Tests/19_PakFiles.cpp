@@ -0,0 +1,362 @@
+// Writes .pak files and checks that FileSystem finds their files and that MapFile views stay valid after UnloadPakFile.
+// Also checks Lz4 round trips and compressed entries' block tables, including corrupted ones.
+// Usage: 19_PakFiles
+// Doesn't need a window. Writes test_*.pak into the working directory.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "FileSystem.hpp"
+#include "Lz4.hpp"
+#include "PakFormat.hpp"
+
+using namespace ae3d;
+
+struct PakFileDesc
+{
+    std::string path;
+    std::vector< unsigned char > storedData; // Block table and blocks if flags has EntryFlags::Compressed.
+    std::uint64_t uncompressedSize = 0;
+    std::uint32_t flags = 0;
+};
+
+// Writes the layout that Tools/CombineFiles writes.
+void WritePak( const char* path, const std::vector< PakFileDesc >& files )
+{
+    std::uint32_t bucketCount = 1;
+
+    while (bucketCount < files.size() * 2 + 1)
+    {
+        bucketCount *= 2;
+    }
+
+    PakFormat::Header header;
+    std::memcpy( header.magic, PakFormat::Magic, sizeof( header.magic ) );
+    header.version = PakFormat::Version;
+    header.entryCount = static_cast< std::uint32_t >( files.size() );
+    header.bucketCount = bucketCount;
+    header.entriesOffset = sizeof( header );
+    header.bucketsOffset = header.entriesOffset + files.size() * sizeof( PakFormat::Entry );
+    header.pathsOffset = header.bucketsOffset + bucketCount * sizeof( std::uint32_t );
+
+    std::vector< PakFormat::Entry > entries( files.size() );
+    std::vector< std::uint32_t > buckets( bucketCount, 0 );
+    std::string paths;
+
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        entries[ i ] = PakFormat::Entry();
+        entries[ i ].pathHash = PakFormat::HashPath( files[ i ].path.c_str(), files[ i ].path.size() );
+        entries[ i ].pathOffset = static_cast< std::uint32_t >( paths.size() );
+        entries[ i ].pathLength = static_cast< std::uint32_t >( files[ i ].path.size() );
+        entries[ i ].dataSize = files[ i ].storedData.size();
+        entries[ i ].uncompressedSize = files[ i ].uncompressedSize;
+        entries[ i ].flags = files[ i ].flags;
+        paths += files[ i ].path;
+        paths += '\0';
+
+        std::uint32_t bucket = static_cast< std::uint32_t >( entries[ i ].pathHash ) & (bucketCount - 1);
+
+        while (buckets[ bucket ] != 0)
+        {
+            bucket = (bucket + 1) & (bucketCount - 1);
+        }
+
+        buckets[ bucket ] = static_cast< std::uint32_t >( i + 1 );
+    }
+
+    header.pathsSize = paths.size();
+
+    std::vector< unsigned char > contents;
+    std::uint64_t offset = header.pathsOffset + paths.size();
+
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        const std::uint64_t alignedOffset = (offset + PakFormat::DataAlignment - 1) / PakFormat::DataAlignment * PakFormat::DataAlignment;
+        contents.resize( contents.size() + alignedOffset - offset );
+        entries[ i ].dataOffset = alignedOffset;
+        contents.insert( std::end( contents ), std::begin( files[ i ].storedData ), std::end( files[ i ].storedData ) );
+        offset = alignedOffset + files[ i ].storedData.size();
+    }
+
+    std::ofstream ofs( path, std::ios::binary );
+    ofs.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+    ofs.write( reinterpret_cast< const char* >( entries.data() ), entries.size() * sizeof( PakFormat::Entry ) );
+    ofs.write( reinterpret_cast< const char* >( buckets.data() ), buckets.size() * sizeof( std::uint32_t ) );
+    ofs.write( paths.data(), paths.size() );
+    ofs.write( reinterpret_cast< const char* >( contents.data() ), contents.size() );
+}
+
+PakFileDesc MakeUncompressedFile( const char* path, std::size_t size, unsigned seed )
+{
+    PakFileDesc file;
+    file.path = path;
+    file.storedData.resize( size );
+
+    for (auto& byte : file.storedData)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        byte = static_cast< unsigned char >( seed >> 24 );
+    }
+
+    file.uncompressedSize = size;
+    return file;
+}
+
+std::vector< unsigned char > MakeData( std::size_t size, unsigned seed, int randomPercent )
+{
+    std::vector< unsigned char > data( size );
+    const char text[] = "Compressible text that repeats. ";
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        data[ i ] = static_cast< int >( (seed >> 8) % 100 ) < randomPercent ? static_cast< unsigned char >( seed >> 24 ) : static_cast< unsigned char >( text[ i % (sizeof( text ) - 1) ] );
+    }
+
+    return data;
+}
+
+// Like Tools/CombineFiles, but also compresses entries that don't get smaller.
+PakFileDesc MakeCompressedFile( const char* path, const std::vector< unsigned char >& data )
+{
+    const std::size_t blockSize = static_cast< std::size_t >( PakFormat::CompressionBlockSize );
+    const std::size_t blockCount = (data.size() + blockSize - 1) / blockSize;
+    std::vector< unsigned char > compressedBlock( Lz4::GetCompressBound( blockSize ) );
+
+    PakFileDesc file;
+    file.path = path;
+    file.uncompressedSize = data.size();
+    file.flags = PakFormat::EntryFlags::Compressed;
+    file.storedData.resize( blockCount * sizeof( std::uint32_t ) );
+
+    for (std::size_t b = 0; b < blockCount; ++b)
+    {
+        const unsigned char* const block = data.data() + b * blockSize;
+        const std::size_t size = std::min( blockSize, data.size() - b * blockSize );
+        const std::size_t compressedSize = Lz4::Compress( block, size, compressedBlock.data(), compressedBlock.size() );
+        const bool isStored = compressedSize == 0 || compressedSize >= size;
+        const std::uint32_t storedSize = static_cast< std::uint32_t >( isStored ? size : compressedSize );
+
+        std::memcpy( file.storedData.data() + b * sizeof( std::uint32_t ), &storedSize, sizeof( storedSize ) );
+        file.storedData.insert( std::end( file.storedData ), isStored ? block : compressedBlock.data(), (isStored ? block : compressedBlock.data()) + storedSize );
+    }
+
+    return file;
+}
+
+bool TestLz4RoundTrip()
+{
+    const std::size_t sizes[] = { 0, 1, 4, 5, 12, 13, 64, 1000, 65535, 65536, 65537, 300000 };
+    const int randomPercents[] = { 0, 10, 100 };
+
+    for (std::size_t size : sizes)
+    {
+        for (int randomPercent : randomPercents)
+        {
+            const std::vector< unsigned char > data = MakeData( size, static_cast< unsigned >( size ), randomPercent );
+            std::vector< unsigned char > compressed( Lz4::GetCompressBound( size ) );
+            const std::size_t compressedSize = Lz4::Compress( data.data(), size, compressed.data(), compressed.size() );
+            std::vector< unsigned char > decompressed( size + 1 );
+
+            if ((compressedSize == 0 && size > 0) || !Lz4::Decompress( compressed.data(), compressedSize, decompressed.data(), size ) ||
+                !std::equal( std::begin( data ), std::end( data ), std::begin( decompressed ) ))
+            {
+                std::cerr << "Lz4 round trip failed for " << size << " bytes with " << randomPercent << "% random bytes!" << std::endl;
+                return false;
+            }
+
+            if (size > 0 && (Lz4::Decompress( compressed.data(), compressedSize, decompressed.data(), size + 1 ) ||
+                             Lz4::Decompress( compressed.data(), compressedSize, decompressed.data(), size - 1 )))
+            {
+                std::cerr << "Lz4::Decompress accepted a wrong uncompressed size for " << size << " bytes!" << std::endl;
+                return false;
+            }
+
+            if (size > 0 && Lz4::Compress( data.data(), size, compressed.data(), compressedSize - 1 ) != 0)
+            {
+                std::cerr << "Lz4::Compress wrote past its destination capacity!" << std::endl;
+                return false;
+            }
+
+            // Truncated input must be rejected without reading or writing out of bounds.
+            if (compressedSize > 1 && Lz4::Decompress( compressed.data(), compressedSize / 2, decompressed.data(), size ))
+            {
+                std::cerr << "Lz4::Decompress accepted truncated input for " << size << " bytes!" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool TestCompressedEntries()
+{
+    const std::size_t blockSize = static_cast< std::size_t >( PakFormat::CompressionBlockSize );
+    // Partial, exactly one and one byte over a block, many blocks, and blocks that are stored as is because they don't compress.
+    const std::vector< std::vector< unsigned char > > contents = { MakeData( 100, 1, 0 ), MakeData( blockSize, 2, 10 ), MakeData( blockSize + 1, 3, 10 ),
+                                                                   MakeData( blockSize * 5 + 7, 4, 10 ), MakeData( blockSize * 3, 5, 100 ), MakeData( 1, 6, 100 ) };
+    std::vector< PakFileDesc > files;
+
+    for (std::size_t i = 0; i < contents.size(); ++i)
+    {
+        files.push_back( MakeCompressedFile( ("compressed" + std::to_string( i )).c_str(), contents[ i ] ) );
+    }
+
+    WritePak( "test_compressed.pak", files );
+    FileSystem::LoadPakFile( "test_compressed.pak" );
+    bool result = true;
+
+    for (std::size_t i = 0; i < contents.size(); ++i)
+    {
+        const FileSystem::FileContentsData fileContents = FileSystem::FileContents( files[ i ].path.c_str() );
+        FileSystem::MappedFileData mapped = FileSystem::MapFile( files[ i ].path.c_str() );
+
+        if (!fileContents.isLoaded || fileContents.data != contents[ i ] || mapped.size != contents[ i ].size() ||
+            !std::equal( std::begin( contents[ i ] ), std::end( contents[ i ] ), mapped.data ))
+        {
+            std::cerr << "Compressed .pak entry of " << contents[ i ].size() << " bytes didn't decompress into its contents!" << std::endl;
+            result = false;
+        }
+
+        FileSystem::UnmapFile( mapped );
+    }
+
+    FileSystem::UnloadPakFile( "test_compressed.pak" );
+    std::remove( "test_compressed.pak" );
+    return result;
+}
+
+// Corrupted entries must fail to load, not read out of bounds.
+bool TestCorruptedBlockTables()
+{
+    const std::vector< unsigned char > data = MakeData( PakFormat::CompressionBlockSize * 2 + 100, 7, 10 );
+    std::vector< PakFileDesc > files;
+
+    // More blocks than the stored data has room for sizes.
+    PakFileDesc tooManyBlocks = MakeCompressedFile( "too_many_blocks", data );
+    tooManyBlocks.storedData.resize( 8 );
+    files.push_back( tooManyBlocks );
+
+    // Block sizes that point past the entry.
+    PakFileDesc blockPastEnd = MakeCompressedFile( "block_past_end", data );
+    const std::uint32_t hugeBlock = 0x7FFFFFFF;
+    std::memcpy( blockPastEnd.storedData.data() + sizeof( std::uint32_t ), &hugeBlock, sizeof( hugeBlock ) );
+    files.push_back( blockPastEnd );
+
+    // Compressed block bytes that are not valid Lz4.
+    PakFileDesc garbageBlock = MakeCompressedFile( "garbage_block", data );
+
+    for (std::size_t i = 3 * sizeof( std::uint32_t ); i < garbageBlock.storedData.size(); ++i)
+    {
+        garbageBlock.storedData[ i ] = 0xFF;
+    }
+
+    files.push_back( garbageBlock );
+
+    WritePak( "test_corrupted.pak", files );
+    FileSystem::LoadPakFile( "test_corrupted.pak" );
+    bool result = true;
+
+    for (const auto& file : files)
+    {
+        FileSystem::MappedFileData mapped = FileSystem::MapFile( file.path.c_str() );
+
+        if (FileSystem::FileContents( file.path.c_str() ).isLoaded || mapped.data != nullptr)
+        {
+            std::cerr << "Corrupted .pak entry " << file.path << " was loaded!" << std::endl;
+            result = false;
+        }
+    }
+
+    FileSystem::UnloadPakFile( "test_corrupted.pak" );
+    std::remove( "test_corrupted.pak" );
+    return result;
+}
+
+bool TestLookup()
+{
+    std::vector< PakFileDesc > files;
+
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        files.push_back( MakeUncompressedFile( ("dir/file" + std::to_string( i ) + ".bin").c_str(), i * 37, i ) );
+    }
+
+    WritePak( "test_lookup.pak", files );
+    FileSystem::LoadPakFile( "test_lookup.pak" );
+
+    for (const auto& file : files)
+    {
+        // Backslashes are converted, so both separators find the file.
+        std::string windowsPath = file.path;
+        windowsPath[ 3 ] = '\\';
+        const FileSystem::FileContentsData contents = FileSystem::FileContents( windowsPath.c_str() );
+
+        if (!contents.isLoaded || contents.data != file.storedData)
+        {
+            std::cerr << "FileContents returned wrong contents for " << file.path << " in a .pak file!" << std::endl;
+            FileSystem::UnloadPakFile( "test_lookup.pak" );
+            return false;
+        }
+    }
+
+    FileSystem::UnloadPakFile( "test_lookup.pak" );
+    std::remove( "test_lookup.pak" );
+    return true;
+}
+
+bool TestViewOutlivesUnload()
+{
+    const std::vector< PakFileDesc > files = { MakeUncompressedFile( "view.bin", 100000, 1 ), MakeUncompressedFile( "other.bin", 10, 2 ) };
+    WritePak( "test_view.pak", files );
+    FileSystem::LoadPakFile( "test_view.pak" );
+
+    FileSystem::MappedFileData view = FileSystem::MapFile( "view.bin" );
+    FileSystem::MappedFileData copy = view;
+    FileSystem::UnloadPakFile( "test_view.pak" );
+
+    if (view.data == nullptr || view.size != files[ 0 ].storedData.size() || std::memcmp( view.data, files[ 0 ].storedData.data(), view.size ) != 0)
+    {
+        std::cerr << "MapFile view into a .pak file is not valid after UnloadPakFile!" << std::endl;
+        return false;
+    }
+
+    FileSystem::UnmapFile( view );
+
+    if (view.data != nullptr || std::memcmp( copy.data, files[ 0 ].storedData.data(), copy.size ) != 0)
+    {
+        std::cerr << "Copy of a MapFile view is not valid after the original was unmapped!" << std::endl;
+        return false;
+    }
+
+    FileSystem::UnmapFile( copy );
+
+    if (FileSystem::FileContents( "other.bin" ).isLoaded)
+    {
+        std::cerr << "FileContents found a file in an unloaded .pak file!" << std::endl;
+        return false;
+    }
+
+    std::remove( "test_view.pak" );
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+
+    result &= TestLookup();
+    result &= TestViewOutlivesUnload();
+    result &= TestLz4RoundTrip();
+    result &= TestCompressedEntries();
+    result &= TestCorruptedBlockTables();
+
+    std::cout << (result ? "All .pak file tests passed." : ".pak file tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
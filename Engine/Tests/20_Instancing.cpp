@@ -0,0 +1,196 @@
+// Renders a grid of cubes that share a mesh and a material with and without instancing, and checks that the instanced
+// frame has fewer draw calls and the same image. Then does the same with a mesh that has two submeshes, whose draws
+// must be instanced per submesh.
+// Usage: 20_Instancing
+// Needs a window and a Vulkan device, but renders into a render texture, so nothing is shown. Run from a directory with
+// textured_cube.ae3d, pnt_quads_2_meshes.ae3d, textures/glider.png and compiled shaders/unlit_*.spv.
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "CameraComponent.hpp"
+#include "FileSystem.hpp"
+#include "GameObject.hpp"
+#include "Material.hpp"
+#include "Mesh.hpp"
+#include "MeshRendererComponent.hpp"
+#include "RenderTexture.hpp"
+#include "Scene.hpp"
+#include "Shader.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TransformComponent.hpp"
+#include "Vec3.hpp"
+#include "Window.hpp"
+
+using namespace ae3d;
+
+const int Width = 256;
+const int Height = 256;
+const int GridSize = 10; // Cubes per side.
+
+struct Frame
+{
+    int drawCallCount = 0;
+    int instancedDrawCallCount = 0;
+    std::vector< unsigned char > pixels;
+};
+
+Frame RenderFrame( Scene& scene, RenderTexture& target, bool isInstancingEnabled )
+{
+    scene.EnableInstancing( isInstancingEnabled );
+    scene.Render();
+
+    Frame frame;
+    frame.drawCallCount = System::Statistics::GetDrawCallCount();
+    frame.instancedDrawCallCount = System::Statistics::GetInstancedDrawCallCount();
+
+    scene.EndFrame();
+    Window::SwapBuffers();
+
+    // UByte render textures have 4 bytes per pixel.
+    frame.pixels.resize( Width * Height * 4 );
+    std::memcpy( frame.pixels.data(), target.Map(), frame.pixels.size() );
+    target.Unmap();
+
+    return frame;
+}
+
+// Instanced draws read their matrices from a storage buffer instead of the uniform buffer, which can round differently.
+bool IsSameImage( const std::vector< unsigned char >& a, const std::vector< unsigned char >& b )
+{
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        if (std::abs( a[ i ] - b[ i ] ) > 2)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TestInstancedFrame( Scene& scene, RenderTexture& target, const char* meshName )
+{
+    // The first frames create pipelines and fill caches, so they are not compared.
+    RenderFrame( scene, target, false );
+    RenderFrame( scene, target, true );
+
+    const Frame drawnOneByOne = RenderFrame( scene, target, false );
+    const Frame instanced = RenderFrame( scene, target, true );
+
+    if (drawnOneByOne.instancedDrawCallCount != 0)
+    {
+        std::cerr << "Scene issued instanced draws of " << meshName << " with instancing disabled!" << std::endl;
+        return false;
+    }
+
+    if (instanced.instancedDrawCallCount == 0 || instanced.drawCallCount >= drawnOneByOne.drawCallCount)
+    {
+        std::cerr << "Instancing didn't reduce draw calls of " << meshName << "! " << drawnOneByOne.drawCallCount << " draw calls without instancing, "
+                  << instanced.drawCallCount << " with it." << std::endl;
+        return false;
+    }
+
+    if (!IsSameImage( drawnOneByOne.pixels, instanced.pixels ))
+    {
+        std::cerr << "Instanced frame of " << meshName << " doesn't match the frame drawn without instancing!" << std::endl;
+        return false;
+    }
+
+    std::cout << meshName << ": " << drawnOneByOne.drawCallCount << " draw calls without instancing, " << instanced.drawCallCount << " with it." << std::endl;
+    return true;
+}
+
+int main()
+{
+    Window::Create( Width, Height, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+
+    RenderTexture target;
+    target.Create2D( Width, Height, DataType::UByte, TextureWrap::Clamp, TextureFilter::Nearest, "instancing target", false, RenderTexture::UavFlag::Disabled );
+    target.MakeCpuReadable( "instancing target" );
+
+    GameObject camera;
+    camera.AddComponent< CameraComponent >();
+    camera.GetComponent< CameraComponent >()->SetClearColor( Vec3( 0.2f, 0.2f, 0.2f ) );
+    camera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    camera.GetComponent< CameraComponent >()->SetProjection( 45, (float)Width / (float)Height, 1, 200 );
+    camera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    camera.GetComponent< CameraComponent >()->SetTargetTexture( &target );
+    camera.AddComponent< TransformComponent >();
+    camera.GetComponent< TransformComponent >()->LookAt( { 0, 20, 0 }, { 0, 0, -40 }, { 0, 1, 0 } );
+
+    Shader shader;
+    shader.Load( "unlitVert", "unlitFrag",
+                 FileSystem::FileContents( "shaders/unlit_vert.obj" ), FileSystem::FileContents( "shaders/unlit_frag.obj" ),
+                 FileSystem::FileContents( "shaders/unlit_vert.spv" ), FileSystem::FileContents( "shaders/unlit_frag.spv" ) );
+
+    if (!shader.IsInstancingSupported())
+    {
+        std::cerr << "unlit_vert.spv doesn't read the instance buffer. Rebuild the shaders with compile_shaders.sh." << std::endl;
+        System::Deinit();
+        return 1;
+    }
+
+    Texture2D texture;
+    texture.Load( FileSystem::FileContents( "textures/glider.png" ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
+
+    Material material;
+    material.SetShader( &shader );
+    material.SetTexture( &texture, 0 );
+
+    Mesh cubeMesh;
+    cubeMesh.Load( FileSystem::FileContents( "textured_cube.ae3d" ) );
+
+    Mesh twoSubMeshMesh;
+    twoSubMeshMesh.Load( FileSystem::FileContents( "pnt_quads_2_meshes.ae3d" ) );
+
+    if (twoSubMeshMesh.GetSubMeshCount() < 2)
+    {
+        std::cerr << "pnt_quads_2_meshes.ae3d doesn't have two submeshes!" << std::endl;
+        System::Deinit();
+        return 1;
+    }
+
+    Scene scene;
+    scene.Add( &camera );
+
+    std::vector< GameObject > cubes( GridSize * GridSize );
+    std::vector< GameObject > twoSubMeshObjects( GridSize * GridSize );
+
+    for (int i = 0; i < GridSize * GridSize; ++i)
+    {
+        cubes[ i ].AddComponent< MeshRendererComponent >();
+        cubes[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+        cubes[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        cubes[ i ].AddComponent< TransformComponent >();
+        cubes[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { (i % GridSize - GridSize / 2) * 4.0f, 0, -20 - (i / GridSize) * 4.0f } );
+        scene.Add( &cubes[ i ] );
+
+        twoSubMeshObjects[ i ].AddComponent< MeshRendererComponent >();
+        twoSubMeshObjects[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &twoSubMeshMesh );
+        twoSubMeshObjects[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        twoSubMeshObjects[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( &material, 1 );
+        twoSubMeshObjects[ i ].AddComponent< TransformComponent >();
+        twoSubMeshObjects[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { (i % GridSize - GridSize / 2) * 4.0f, 0, -20 - (i / GridSize) * 4.0f } );
+    }
+
+    bool result = true;
+
+    result &= TestInstancedFrame( scene, target, "textured_cube.ae3d" );
+
+    // Submeshes of an object have the same depth, so they are only instanced if draws are grouped by submesh.
+    for (int i = 0; i < GridSize * GridSize; ++i)
+    {
+        scene.Remove( &cubes[ i ] );
+        scene.Add( &twoSubMeshObjects[ i ] );
+    }
+
+    result &= TestInstancedFrame( scene, target, "pnt_quads_2_meshes.ae3d" );
+
+    System::Deinit();
+
+    std::cout << (result ? "All instancing tests passed." : "Instancing tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
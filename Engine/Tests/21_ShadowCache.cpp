@@ -0,0 +1,175 @@
+// Checks when Scene re-renders cached shadow maps: after changes to the shadow camera, the shadow map size or the casters,
+// and only the dynamic casters when only they change.
+// Usage: 21_ShadowCache
+// Doesn't need a window.
+#include <iostream>
+#include "Matrix.hpp"
+#include "ShadowCache.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+typedef ShadowCacheState::Action Action;
+
+const int Width = 1024;
+
+Matrix44 MakeWorldToClip( float x )
+{
+    Matrix44 worldToClip;
+    worldToClip.MakeProjection( 45, 1, 1, 200 );
+    Matrix44 translation;
+    translation.SetTranslation( Vec3( x, 0, 0 ) );
+    Matrix44::Multiply( translation, worldToClip, worldToClip );
+    return worldToClip;
+}
+
+bool TestOnlyDynamicCasters()
+{
+    ShadowCacheState cache;
+    const Matrix44 worldToClip = MakeWorldToClip( 0 );
+
+    if (cache.Update( Width, worldToClip, 0, 1, false, true, false ) != Action::AllCasters)
+    {
+        std::cerr << "Shadow cache didn't render a new face!" << std::endl;
+        return false;
+    }
+
+    if (cache.Update( Width, worldToClip, 0, 1, false, true, false ) != Action::None)
+    {
+        std::cerr << "Shadow cache re-rendered a face that didn't change!" << std::endl;
+        return false;
+    }
+
+    // The shadow map itself is the cache, so the static casters' map is not used.
+    if (cache.Update( Width, worldToClip, 0, 2, false, true, false ) != Action::AllCasters)
+    {
+        std::cerr << "Shadow cache didn't re-render a face whose casters moved!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestOnlyStaticCasters()
+{
+    ShadowCacheState cache;
+    const Matrix44 worldToClip = MakeWorldToClip( 0 );
+    cache.Update( Width, worldToClip, 1, 0, true, false, false );
+
+    if (cache.Update( Width, worldToClip, 1, 0, true, false, false ) != Action::None)
+    {
+        std::cerr << "Shadow cache re-rendered static casters that didn't change!" << std::endl;
+        return false;
+    }
+
+    if (cache.Update( Width, worldToClip, 2, 0, true, false, false ) != Action::AllCasters)
+    {
+        std::cerr << "Shadow cache didn't re-render changed static casters!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestStaticAndDynamicCasters()
+{
+    ShadowCacheState cache;
+    const Matrix44 worldToClip = MakeWorldToClip( 0 );
+
+    if (cache.Update( Width, worldToClip, 1, 1, true, true, false ) != Action::StaticAndDynamicCasters)
+    {
+        std::cerr << "Shadow cache didn't render the static casters' map for a new face!" << std::endl;
+        return false;
+    }
+
+    if (cache.Update( Width, worldToClip, 1, 1, true, true, true ) != Action::None)
+    {
+        std::cerr << "Shadow cache re-rendered a face with static and dynamic casters that didn't change!" << std::endl;
+        return false;
+    }
+
+    if (cache.Update( Width, worldToClip, 1, 2, true, true, true ) != Action::DynamicCasters)
+    {
+        std::cerr << "Shadow cache re-rendered static casters when only dynamic casters moved!" << std::endl;
+        return false;
+    }
+
+    if (cache.Update( Width, worldToClip, 2, 2, true, true, true ) != Action::StaticAndDynamicCasters)
+    {
+        std::cerr << "Shadow cache didn't re-render changed static casters!" << std::endl;
+        return false;
+    }
+
+    // A static casters' map that was given to another face or recreated must be rendered again.
+    if (cache.Update( Width, worldToClip, 2, 3, true, true, false ) != Action::StaticAndDynamicCasters)
+    {
+        std::cerr << "Shadow cache didn't render a static casters' map that was taken into use!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestLightAndShadowMapChanges()
+{
+    ShadowCacheState cache;
+    cache.Update( Width, MakeWorldToClip( 0 ), 1, 1, true, true, false );
+
+    if (cache.Update( Width, MakeWorldToClip( 0.001f ), 1, 1, true, true, true ) != Action::StaticAndDynamicCasters)
+    {
+        std::cerr << "Shadow cache didn't re-render after the shadow camera moved!" << std::endl;
+        return false;
+    }
+
+    if (cache.Update( Width * 2, MakeWorldToClip( 0.001f ), 1, 1, true, true, true ) != Action::StaticAndDynamicCasters)
+    {
+        std::cerr << "Shadow cache didn't re-render a recreated shadow map!" << std::endl;
+        return false;
+    }
+
+    cache.Invalidate();
+
+    if (cache.Update( Width * 2, MakeWorldToClip( 0.001f ), 1, 1, true, true, true ) != Action::StaticAndDynamicCasters)
+    {
+        std::cerr << "Shadow cache didn't re-render after Invalidate!" << std::endl;
+        return false;
+    }
+
+    if (cache.Update( Width * 2, MakeWorldToClip( 0.001f ), 1, 1, true, true, true ) != Action::None)
+    {
+        std::cerr << "Shadow cache kept re-rendering after Invalidate!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Scene hashes casters in visible set order, so swapping two casters' states must change the hash.
+bool TestHashCombine()
+{
+    const std::uint64_t ab = ShadowCacheState::HashCombine( ShadowCacheState::HashCombine( 0, 1 ), 2 );
+    const std::uint64_t ba = ShadowCacheState::HashCombine( ShadowCacheState::HashCombine( 0, 2 ), 1 );
+    const std::uint64_t aa = ShadowCacheState::HashCombine( ShadowCacheState::HashCombine( 0, 1 ), 1 );
+
+    if (ab == ba || ab == aa || ShadowCacheState::HashCombine( 0, 0 ) == 0)
+    {
+        std::cerr << "ShadowCacheState::HashCombine doesn't tell casters apart!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+
+    result &= TestOnlyDynamicCasters();
+    result &= TestOnlyStaticCasters();
+    result &= TestStaticAndDynamicCasters();
+    result &= TestLightAndShadowMapChanges();
+    result &= TestHashCombine();
+
+    std::cout << (result ? "All shadow cache tests passed." : "Shadow cache tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
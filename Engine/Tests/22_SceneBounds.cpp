@@ -0,0 +1,267 @@
+// Checks that Scene's bounds, which are grown incrementally and recomputed only when an object on them changes, match
+// bounds computed from all mesh renderers after objects are added, moved, rotated, removed and given other meshes.
+// Usage: 22_SceneBounds
+// Doesn't need a window. Meshes are decoded on the CPU from files that have only bounds.
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "FileSystem.hpp"
+#include "GameObject.hpp"
+#include "Matrix.hpp"
+#include "Mesh.hpp"
+#include "MeshFormat.hpp"
+#include "MeshRendererComponent.hpp"
+#include "Scene.hpp"
+#include "TransformComponent.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+const int ObjectCount = 200;
+const int MeshCount = 3;
+const int Iterations = 300;
+
+float Random( unsigned& seed )
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) / static_cast< float >( 1 << 24 );
+}
+
+// .ae3d file with bounds and no submeshes. Scene reads only the mesh's bounds.
+bool MakeMesh( const Vec3& aabbMin, const Vec3& aabbMax, Mesh& outMesh )
+{
+    MeshFormat::Header header = {};
+    std::memcpy( header.magic, MeshFormat::Magic, sizeof( header.magic ) );
+    header.version = MeshFormat::Version;
+    header.aabbMin[ 0 ] = aabbMin.x;
+    header.aabbMin[ 1 ] = aabbMin.y;
+    header.aabbMin[ 2 ] = aabbMin.z;
+    header.aabbMax[ 0 ] = aabbMax.x;
+    header.aabbMax[ 1 ] = aabbMax.y;
+    header.aabbMax[ 2 ] = aabbMax.z;
+    header.fileSize = sizeof( header );
+
+    FileSystem::FileContentsData contents;
+    contents.data.resize( sizeof( header ) );
+    std::memcpy( contents.data.data(), &header, sizeof( header ) );
+    contents.isLoaded = true;
+
+    return outMesh.Decode( contents ) == Mesh::LoadResult::Success;
+}
+
+bool IsSame( const Vec3& a, const Vec3& b )
+{
+    return std::abs( a.x - b.x ) < 0.0001f && std::abs( a.y - b.y ) < 0.0001f && std::abs( a.z - b.z ) < 0.0001f;
+}
+
+// Updates the scene and compares its bounds to bounds of all objects that are in it and have a mesh.
+bool HasExactBounds( Scene& scene, const std::vector< GameObject >& objects, const std::vector< bool >& isInScene )
+{
+    scene.UpdateSpatialIndex();
+
+    Vec3 expectedMin( 99999999.0f, 99999999.0f, 99999999.0f );
+    Vec3 expectedMax( -99999999.0f, -99999999.0f, -99999999.0f );
+    bool hasMeshes = false;
+
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        Mesh* mesh = objects[ i ].GetComponent< MeshRendererComponent >()->GetMesh();
+
+        if (!isInScene[ i ] || mesh == nullptr)
+        {
+            continue;
+        }
+
+        const Vec3& localMin = mesh->GetAABBMin();
+        const Vec3& localMax = mesh->GetAABBMax();
+
+        for (int c = 0; c < 8; ++c)
+        {
+            const Vec3 corner( (c & 1) ? localMax.x : localMin.x, (c & 2) ? localMax.y : localMin.y, (c & 4) ? localMax.z : localMin.z );
+            Vec3 worldCorner;
+            Matrix44::TransformPoint( corner, objects[ i ].GetComponent< TransformComponent >()->GetLocalToWorldMatrix(), &worldCorner );
+            expectedMin = Vec3::Min2( expectedMin, worldCorner );
+            expectedMax = Vec3::Max2( expectedMax, worldCorner );
+        }
+
+        hasMeshes = true;
+    }
+
+    Vec3 aabbMin, aabbMax;
+    scene.GetAABB( aabbMin, aabbMax );
+
+    if (!hasMeshes)
+    {
+        return aabbMin.x > aabbMax.x && aabbMin.y > aabbMax.y && aabbMin.z > aabbMax.z;
+    }
+
+    return IsSame( aabbMin, expectedMin ) && IsSame( aabbMax, expectedMax );
+}
+
+// Shrinking needs a recompute, so changes to the objects that define the bounds are tested one by one.
+bool TestBoundaryObjects( std::vector< GameObject >& objects, Mesh* meshes )
+{
+    Scene scene;
+    std::vector< bool > isInScene( objects.size(), false );
+
+    if (!HasExactBounds( scene, objects, isInScene ))
+    {
+        std::cerr << "Empty scene has bounds!" << std::endl;
+        return false;
+    }
+
+    // A row of unit cubes along X, so the first and last define the bounds.
+    for (int i = 0; i < 4; ++i)
+    {
+        objects[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &meshes[ 0 ] );
+        objects[ i ].GetComponent< TransformComponent >()->SetLocalPosition( Vec3( i * 10.0f, 0, 0 ) );
+        objects[ i ].GetComponent< TransformComponent >()->SetLocalRotation( Quaternion() );
+        scene.Add( &objects[ i ] );
+        isInScene[ i ] = true;
+    }
+
+    if (!HasExactBounds( scene, objects, isInScene ))
+    {
+        std::cerr << "Scene bounds don't cover added objects!" << std::endl;
+        return false;
+    }
+
+    objects[ 3 ].GetComponent< TransformComponent >()->SetLocalPosition( Vec3( 15, 0, 0 ) );
+
+    if (!HasExactBounds( scene, objects, isInScene ))
+    {
+        std::cerr << "Scene bounds didn't shrink when the object on them moved inwards!" << std::endl;
+        return false;
+    }
+
+    objects[ 0 ].GetComponent< TransformComponent >()->SetLocalRotation( Quaternion::CreateFromAxisAngle( Vec3( 0, 0, 1 ), 45 ) );
+
+    if (!HasExactBounds( scene, objects, isInScene ))
+    {
+        std::cerr << "Scene bounds don't match a rotated object!" << std::endl;
+        return false;
+    }
+
+    scene.Remove( &objects[ 3 ] );
+    isInScene[ 3 ] = false;
+
+    if (!HasExactBounds( scene, objects, isInScene ))
+    {
+        std::cerr << "Scene bounds didn't shrink when the object on them was removed!" << std::endl;
+        return false;
+    }
+
+    objects[ 2 ].GetComponent< MeshRendererComponent >()->SetMesh( nullptr );
+
+    if (!HasExactBounds( scene, objects, isInScene ))
+    {
+        std::cerr << "Scene bounds didn't shrink when the object on them lost its mesh!" << std::endl;
+        return false;
+    }
+
+    objects[ 1 ].GetComponent< MeshRendererComponent >()->SetMesh( &meshes[ 1 ] );
+
+    if (!HasExactBounds( scene, objects, isInScene ))
+    {
+        std::cerr << "Scene bounds don't match an object whose mesh changed!" << std::endl;
+        return false;
+    }
+
+    scene.Remove( &objects[ 0 ] );
+    scene.Remove( &objects[ 1 ] );
+    scene.Remove( &objects[ 2 ] );
+    isInScene[ 0 ] = isInScene[ 1 ] = isInScene[ 2 ] = false;
+
+    if (!HasExactBounds( scene, objects, isInScene ))
+    {
+        std::cerr << "Scene has bounds after all objects were removed!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestRandomChanges( std::vector< GameObject >& objects, Mesh* meshes )
+{
+    Scene scene;
+    std::vector< bool > isInScene( objects.size(), false );
+    unsigned seed = 1;
+
+    for (int iteration = 0; iteration < Iterations; ++iteration)
+    {
+        // Few changes per update, like in a frame, so most updates don't recompute the bounds.
+        for (int change = 0; change < 4; ++change)
+        {
+            const std::size_t i = static_cast< std::size_t >( Random( seed ) * ObjectCount );
+            const float action = Random( seed );
+            TransformComponent* transform = objects[ i ].GetComponent< TransformComponent >();
+            MeshRendererComponent* meshRenderer = objects[ i ].GetComponent< MeshRendererComponent >();
+
+            if (action < 0.4f)
+            {
+                transform->SetLocalPosition( Vec3( Random( seed ) * 200 - 100, Random( seed ) * 50, Random( seed ) * 200 - 100 ) );
+            }
+            else if (action < 0.55f)
+            {
+                transform->SetLocalRotation( Quaternion::CreateFromAxisAngle( Vec3( Random( seed ), Random( seed ), 1 ).Normalized(), Random( seed ) * 360 ) );
+            }
+            else if (action < 0.65f)
+            {
+                transform->SetLocalScale( 0.5f + Random( seed ) * 2 );
+            }
+            else if (action < 0.75f)
+            {
+                const int meshIndex = static_cast< int >( Random( seed ) * (MeshCount + 1) );
+                meshRenderer->SetMesh( meshIndex < MeshCount ? &meshes[ meshIndex ] : nullptr );
+            }
+            else if (isInScene[ i ])
+            {
+                scene.Remove( &objects[ i ] );
+                isInScene[ i ] = false;
+            }
+            else
+            {
+                scene.Add( &objects[ i ] );
+                isInScene[ i ] = true;
+            }
+        }
+
+        if (!HasExactBounds( scene, objects, isInScene ))
+        {
+            std::cerr << "Scene bounds don't match its objects after update " << iteration << "!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    Mesh meshes[ MeshCount ];
+
+    if (!MakeMesh( Vec3( -1, -1, -1 ), Vec3( 1, 1, 1 ), meshes[ 0 ] ) ||
+        !MakeMesh( Vec3( -5, 0, -2 ), Vec3( 5, 20, 2 ), meshes[ 1 ] ) ||
+        !MakeMesh( Vec3( 0, -3, 0 ), Vec3( 1, 3, 30 ), meshes[ 2 ] ))
+    {
+        std::cerr << "Could not decode the test meshes!" << std::endl;
+        return 1;
+    }
+
+    std::vector< GameObject > objects( ObjectCount );
+
+    for (auto& go : objects)
+    {
+        go.AddComponent< MeshRendererComponent >();
+        go.AddComponent< TransformComponent >();
+    }
+
+    bool result = true;
+
+    result &= TestBoundaryObjects( objects, meshes );
+    result &= TestRandomChanges( objects, meshes );
+
+    std::cout << (result ? "All scene bounds tests passed." : "Scene bounds tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
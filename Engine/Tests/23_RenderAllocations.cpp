@@ -0,0 +1,172 @@
+// Checks that Scene::Render doesn't call operator new in a steady-state frame, so render-loop scratch like the cameras,
+// visible sets, render queues and instance arrays comes from the frame arena.
+// Usage: 23_RenderAllocations
+// Needs a window and a Vulkan device, but renders into a render texture, so nothing is shown. Run from a directory with
+// textured_cube.ae3d, textures/glider.png and compiled shaders/unlit_*.spv.
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+#include "CameraComponent.hpp"
+#include "FileSystem.hpp"
+#include "FrameArena.hpp"
+#include "GameObject.hpp"
+#include "Material.hpp"
+#include "Mesh.hpp"
+#include "MeshRendererComponent.hpp"
+#include "RenderTexture.hpp"
+#include "Scene.hpp"
+#include "Shader.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TransformComponent.hpp"
+#include "Vec3.hpp"
+#include "Window.hpp"
+
+using namespace ae3d;
+
+const int Width = 256;
+const int Height = 256;
+const int GridSize = 10; // Cubes per side.
+const int WarmUpFrameCount = 10;
+const int FrameCount = 50;
+
+std::atomic< unsigned > operatorNewCount( 0 );
+
+void* operator new( std::size_t size )
+{
+    ++operatorNewCount;
+    void* memory = std::malloc( size == 0 ? 1 : size );
+
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void operator delete( void* memory ) noexcept
+{
+    std::free( memory );
+}
+
+void operator delete( void* memory, std::size_t ) noexcept
+{
+    std::free( memory );
+}
+
+// Moves the grid sideways, so the number of visible cubes changes between frames like in a game.
+void MoveCubes( std::vector< GameObject >& cubes, int frame )
+{
+    const float offset = static_cast< float >( frame % 20 ) * 2.0f - 20.0f;
+
+    for (int i = 0; i < GridSize * GridSize; ++i)
+    {
+        cubes[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { (i % GridSize - GridSize / 2) * 4.0f + offset, 0, -20 - (i / GridSize) * 4.0f } );
+    }
+}
+
+// Returns the number of operator new calls made by Scene::Render.
+unsigned RenderFrame( Scene& scene, std::vector< GameObject >& cubes, int frame )
+{
+    MoveCubes( cubes, frame );
+    scene.EnableInstancing( frame % 2 == 0 );
+
+    const unsigned countBefore = operatorNewCount;
+    scene.Render();
+    const unsigned count = operatorNewCount - countBefore;
+
+    scene.EndFrame();
+    Window::SwapBuffers();
+
+    return count;
+}
+
+bool TestSteadyStateFrames( Scene& scene, std::vector< GameObject >& cubes )
+{
+    // The first frames create pipelines, fill caches and grow the arenas and job queues.
+    for (int frame = 0; frame < WarmUpFrameCount; ++frame)
+    {
+        RenderFrame( scene, cubes, frame );
+    }
+
+    const unsigned arenaBlockCount = FrameArena::GetHeapAllocationCount();
+
+    for (int frame = WarmUpFrameCount; frame < WarmUpFrameCount + FrameCount; ++frame)
+    {
+        const unsigned count = RenderFrame( scene, cubes, frame );
+
+        if (count != 0)
+        {
+            std::cerr << "Scene::Render called operator new " << count << " times in frame " << frame << "!" << std::endl;
+            return false;
+        }
+    }
+
+    if (FrameArena::GetHeapAllocationCount() != arenaBlockCount)
+    {
+        std::cerr << "Frame arenas kept allocating blocks after the warm-up frames!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    Window::Create( Width, Height, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+
+    RenderTexture target;
+    target.Create2D( Width, Height, DataType::UByte, TextureWrap::Clamp, TextureFilter::Nearest, "allocations target", false, RenderTexture::UavFlag::Disabled );
+
+    GameObject camera;
+    camera.AddComponent< CameraComponent >();
+    camera.GetComponent< CameraComponent >()->SetClearColor( Vec3( 0.2f, 0.2f, 0.2f ) );
+    camera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    camera.GetComponent< CameraComponent >()->SetProjection( 45, (float)Width / (float)Height, 1, 200 );
+    camera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    camera.GetComponent< CameraComponent >()->SetTargetTexture( &target );
+    camera.AddComponent< TransformComponent >();
+    camera.GetComponent< TransformComponent >()->LookAt( { 0, 20, 0 }, { 0, 0, -40 }, { 0, 1, 0 } );
+
+    Shader shader;
+    shader.Load( "unlitVert", "unlitFrag",
+                 FileSystem::FileContents( "shaders/unlit_vert.obj" ), FileSystem::FileContents( "shaders/unlit_frag.obj" ),
+                 FileSystem::FileContents( "shaders/unlit_vert.spv" ), FileSystem::FileContents( "shaders/unlit_frag.spv" ) );
+
+    Texture2D texture;
+    texture.Load( FileSystem::FileContents( "textures/glider.png" ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
+
+    Material material;
+    material.SetShader( &shader );
+    material.SetTexture( &texture, 0 );
+
+    Mesh cubeMesh;
+    cubeMesh.Load( FileSystem::FileContents( "textured_cube.ae3d" ) );
+
+    Scene scene;
+    scene.Add( &camera );
+
+    std::vector< GameObject > cubes( GridSize * GridSize );
+
+    for (int i = 0; i < GridSize * GridSize; ++i)
+    {
+        cubes[ i ].AddComponent< MeshRendererComponent >();
+        cubes[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+        cubes[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        cubes[ i ].AddComponent< TransformComponent >();
+        scene.Add( &cubes[ i ] );
+    }
+
+    bool result = true;
+
+    result &= TestSteadyStateFrames( scene, cubes );
+
+    System::Deinit();
+
+    std::cout << (result ? "All render allocation tests passed." : "Render allocation tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
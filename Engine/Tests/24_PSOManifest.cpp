@@ -0,0 +1,140 @@
+// Checks that PSO manifest lines survive a write and parse, and that lines with malformed or out-of-range values,
+// which an older version or a damaged file can have, are rejected instead of creating invalid PSOs.
+// Usage: 24_PSOManifest
+// Doesn't need a window.
+#include <iostream>
+#include <string>
+#include <vector>
+#include "PSOManifest.hpp"
+
+using namespace ae3d;
+
+PSODesc MakeDesc()
+{
+    PSODesc desc;
+    desc.vertexShaderPath = "shaders/unlit_vert.spv";
+    desc.fragmentShaderPath = "shaders/unlit_frag.spv";
+    desc.vertexFormat = (unsigned)VertexBuffer::VertexFormat::PTNTC_Skinned;
+    desc.blendMode = (unsigned)GfxDevice::BlendMode::Off;
+    desc.depthFunc = (unsigned)GfxDevice::DepthFunc::NoneWriteOff;
+    desc.cullMode = (unsigned)GfxDevice::CullMode::Off;
+    desc.fillMode = (unsigned)GfxDevice::FillMode::Wireframe;
+    desc.topology = (unsigned)GfxDevice::PrimitiveTopology::Lines;
+    desc.colorFormat = 37; // VK_FORMAT_R8G8B8A8_UNORM
+    desc.sampleCount = 4;
+    return desc;
+}
+
+bool IsSame( const PSODesc& a, const PSODesc& b )
+{
+    return a.vertexShaderPath == b.vertexShaderPath && a.fragmentShaderPath == b.fragmentShaderPath && a.vertexFormat == b.vertexFormat &&
+           a.blendMode == b.blendMode && a.depthFunc == b.depthFunc && a.cullMode == b.cullMode && a.fillMode == b.fillMode &&
+           a.topology == b.topology && a.colorFormat == b.colorFormat && a.sampleCount == b.sampleCount;
+}
+
+bool TestRoundTrip()
+{
+    const PSODesc desc = MakeDesc();
+    PSODesc parsed;
+
+    if (!ParsePSOManifestLine( GetPSOManifestLine( desc ), parsed ) || !IsSame( desc, parsed ))
+    {
+        std::cerr << "PSO manifest line didn't parse back into the same state!" << std::endl;
+        return false;
+    }
+
+    // Swapchain PSOs have no color format, and paths can have spaces.
+    PSODesc swapchainDesc;
+    swapchainDesc.vertexShaderPath = "my shaders/standard_vert.spv";
+    swapchainDesc.fragmentShaderPath = "my shaders/standard_frag.spv";
+
+    if (!ParsePSOManifestLine( GetPSOManifestLine( swapchainDesc ), parsed ) || !IsSame( swapchainDesc, parsed ))
+    {
+        std::cerr << "PSO manifest line of the default state didn't parse back into the same state!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TestOutOfRangeValues()
+{
+    std::vector< PSODesc > invalidDescs( 8, MakeDesc() );
+    invalidDescs[ 0 ].vertexFormat = (unsigned)VertexBuffer::VertexFormat::Empty;
+    invalidDescs[ 1 ].blendMode = (unsigned)GfxDevice::BlendMode::Off + 1;
+    invalidDescs[ 2 ].depthFunc = (unsigned)GfxDevice::DepthFunc::NoneWriteOff + 1;
+    invalidDescs[ 3 ].cullMode = (unsigned)GfxDevice::CullMode::Off + 1;
+    invalidDescs[ 4 ].fillMode = (unsigned)GfxDevice::FillMode::Wireframe + 1;
+    invalidDescs[ 5 ].topology = (unsigned)GfxDevice::PrimitiveTopology::Lines + 1;
+    invalidDescs[ 6 ].sampleCount = 0;
+    invalidDescs[ 7 ].sampleCount = 3;
+
+    for (std::size_t i = 0; i < invalidDescs.size(); ++i)
+    {
+        PSODesc parsed;
+
+        if (ParsePSOManifestLine( GetPSOManifestLine( invalidDescs[ i ] ), parsed ))
+        {
+            std::cerr << "PSO manifest line with an out-of-range value was accepted: " << GetPSOManifestLine( invalidDescs[ i ] ) << std::endl;
+            return false;
+        }
+    }
+
+    const char* const malformedLines[] =
+    {
+        "",
+        "shaders/unlit_vert.spv",
+        "shaders/unlit_vert.spv\tshaders/unlit_frag.spv",
+        "shaders/unlit_vert.spv\tshaders/unlit_frag.spv\t0 0 0 0 0 0 0",
+        "shaders/unlit_vert.spv\tshaders/unlit_frag.spv\t0 0 -1 0 0 0 0 1",
+        "shaders/unlit_vert.spv\tshaders/unlit_frag.spv\tx 0 0 0 0 0 0 1"
+    };
+
+    for (const char* line : malformedLines)
+    {
+        PSODesc parsed;
+
+        if (ParsePSOManifestLine( line, parsed ))
+        {
+            std::cerr << "Malformed PSO manifest line was accepted: " << line << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TestManifest()
+{
+    PSODesc second = MakeDesc();
+    second.colorFormat = 0;
+    second.sampleCount = 1;
+
+    PSODesc invalid = MakeDesc();
+    invalid.blendMode = 100;
+
+    // Like a saved manifest with a line of an older version in the middle and no newline at the end.
+    const std::string text = GetPSOManifestLine( MakeDesc() ) + "\n" + GetPSOManifestLine( invalid ) + "\n\n" + GetPSOManifestLine( second );
+    std::vector< PSODesc > descs;
+    ParsePSOManifest( text, descs );
+
+    if (descs.size() != 2 || !IsSame( descs[ 0 ], MakeDesc() ) || !IsSame( descs[ 1 ], second ))
+    {
+        std::cerr << "PSO manifest didn't parse into its valid lines!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool result = true;
+
+    result &= TestRoundTrip();
+    result &= TestOutOfRangeValues();
+    result &= TestManifest();
+
+    std::cout << (result ? "All PSO manifest tests passed." : "PSO manifest tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+// Checks that the CPU doesn't wait for the GPU while it records a frame that culls lights with a compute shader and updates
+// a dynamic line buffer, so it records frame N+1 while the GPU executes frame N. The only wait is in Scene::Render's BeginFrame,
+// which waits for the frame that used the same frame slot before, frame N-1.
+// Usage: 25_FramesInFlight
+// Needs a window and a Vulkan device, but renders into a render texture, so nothing is shown. Run from a directory with
+// textured_cube.ae3d, textures/glider.png and compiled shaders/unlit_*.spv.
+#include <iostream>
+#include <vector>
+#include "CameraComponent.hpp"
+#include "FileSystem.hpp"
+#include "GameObject.hpp"
+#include "Material.hpp"
+#include "Matrix.hpp"
+#include "Mesh.hpp"
+#include "MeshRendererComponent.hpp"
+#include "PointLightComponent.hpp"
+#include "RenderTexture.hpp"
+#include "Scene.hpp"
+#include "Shader.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TransformComponent.hpp"
+#include "Vec3.hpp"
+#include "Window.hpp"
+
+using namespace ae3d;
+
+const int Width = 256;
+const int Height = 256;
+const int LightCount = 20;
+const int WarmUpFrameCount = 10;
+const int FrameCount = 100;
+
+// Returns the number of times the CPU waited for the GPU between BeginFrame and the end of the frame.
+int RenderFrame( Scene& scene, std::vector< GameObject >& lights, int lineHandle, const Matrix44& view, const Matrix44& projection, int frame )
+{
+    // Moves the lights, so the light buffers change every frame.
+    for (int i = 0; i < LightCount; ++i)
+    {
+        lights[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { (i - LightCount / 2) * 2.0f + (frame % 10) * 0.5f, 2, -20 } );
+    }
+
+    scene.Render();
+
+    // Updates the line buffer in the frame, like a debug line renderer does.
+    const Vec3 lines[ 2 ] = { Vec3( -10, 0, -20 ), Vec3( 10, (float)(frame % 10), -20 ) };
+    System::UpdateLineBuffer( lineHandle, lines, 2, Vec3( 1, 0, 0 ) );
+    System::DrawLines( lineHandle, view, projection, Width, Height );
+
+    scene.EndFrame();
+    const int fenceCallCount = System::Statistics::GetFenceCallCount();
+    Window::SwapBuffers();
+
+    return fenceCallCount;
+}
+
+bool TestFrameRecordingDoesntWait( Scene& scene, std::vector< GameObject >& lights, int lineHandle, const Matrix44& view, const Matrix44& projection )
+{
+    // The first frames create pipelines and command buffers.
+    for (int frame = 0; frame < WarmUpFrameCount; ++frame)
+    {
+        RenderFrame( scene, lights, lineHandle, view, projection, frame );
+    }
+
+    for (int frame = WarmUpFrameCount; frame < WarmUpFrameCount + FrameCount; ++frame)
+    {
+        const int count = RenderFrame( scene, lights, lineHandle, view, projection, frame );
+
+        if (count != 0)
+        {
+            std::cerr << "CPU waited for the GPU " << count << " times while recording frame " << frame << "!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    Window::Create( Width, Height, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+
+    RenderTexture target;
+    target.Create2D( Width, Height, DataType::UByte, TextureWrap::Clamp, TextureFilter::Nearest, "frames in flight target", false, RenderTexture::UavFlag::Disabled );
+
+    GameObject camera;
+    camera.AddComponent< CameraComponent >();
+    camera.GetComponent< CameraComponent >()->SetClearColor( Vec3( 0.2f, 0.2f, 0.2f ) );
+    camera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    camera.GetComponent< CameraComponent >()->SetProjection( 45, (float)Width / (float)Height, 1, 200 );
+    camera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    camera.GetComponent< CameraComponent >()->SetTargetTexture( &target );
+    // Depth and normals make Scene::Render cull the lights with a compute shader.
+    camera.GetComponent< CameraComponent >()->GetDepthNormalsTexture().Create2D( Width, Height, DataType::Float, TextureWrap::Clamp, TextureFilter::Nearest, "depthnormals", false, RenderTexture::UavFlag::Disabled );
+    camera.AddComponent< TransformComponent >();
+    camera.GetComponent< TransformComponent >()->LookAt( { 0, 5, 0 }, { 0, 0, -20 }, { 0, 1, 0 } );
+
+    Shader shader;
+    shader.Load( "unlitVert", "unlitFrag",
+                 FileSystem::FileContents( "shaders/unlit_vert.obj" ), FileSystem::FileContents( "shaders/unlit_frag.obj" ),
+                 FileSystem::FileContents( "shaders/unlit_vert.spv" ), FileSystem::FileContents( "shaders/unlit_frag.spv" ) );
+
+    Texture2D texture;
+    texture.Load( FileSystem::FileContents( "textures/glider.png" ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
+
+    Material material;
+    material.SetShader( &shader );
+    material.SetTexture( &texture, 0 );
+
+    Mesh cubeMesh;
+    cubeMesh.Load( FileSystem::FileContents( "textured_cube.ae3d" ) );
+
+    GameObject cube;
+    cube.AddComponent< MeshRendererComponent >();
+    cube.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+    cube.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+    cube.AddComponent< TransformComponent >();
+    cube.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -20 } );
+
+    Scene scene;
+    scene.Add( &camera );
+    scene.Add( &cube );
+
+    std::vector< GameObject > lights( LightCount );
+
+    for (int i = 0; i < LightCount; ++i)
+    {
+        lights[ i ].AddComponent< PointLightComponent >();
+        lights[ i ].GetComponent< PointLightComponent >()->SetRadius( 5 );
+        lights[ i ].GetComponent< PointLightComponent >()->SetColor( Vec3( 1, 1, 1 ) );
+        lights[ i ].AddComponent< TransformComponent >();
+        scene.Add( &lights[ i ] );
+    }
+
+    const Vec3 lines[ 2 ] = { Vec3( -10, 0, -20 ), Vec3( 10, 0, -20 ) };
+    const int lineHandle = System::CreateLineBuffer( lines, 2, Vec3( 1, 0, 0 ) );
+
+    Matrix44 view;
+    view.MakeLookAt( { 0, 5, 0 }, { 0, 0, -20 }, { 0, 1, 0 } );
+    Matrix44 projection;
+    projection.MakeProjection( 45, (float)Width / (float)Height, 1, 200 );
+
+    bool result = true;
+
+    result &= TestFrameRecordingDoesntWait( scene, lights, lineHandle, view, projection );
+
+    System::Deinit();
+
+    std::cout << (result ? "All frames in flight tests passed." : "Frames in flight tests failed!") << std::endl;
+    return result ? 0 : 1;
+}
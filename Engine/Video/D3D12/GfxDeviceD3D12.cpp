@@ -61,10 +61,11 @@ namespace ae3d
                 stm << "light culler time GPU: " << ::Statistics::GetLightCullerTimeGpuMS() << "ms\n";
                 stm << "light update time CPU: " << ::Statistics::GetLightUpdateTimeMS() << "ms\n";
                 stm << "bloom time CPU: " << ::Statistics::GetBloomCpuTimeMS() << "ms\n";
+                stm << "occlusion cull: " << ::Statistics::GetOcclusionCullTimeMS() << "ms, " << ::Statistics::GetOcclusionCulledCount() << " hidden\n";
                 stm << "draw calls: " << ::Statistics::GetDrawCalls() << "\n";
                 stm << "barrier calls: " << ::Statistics::GetBarrierCalls() << "\n";
                 stm << "triangles: " << ::Statistics::GetTriangleCount() << "\n";
-                stm << "PSO binds: " << ::Statistics::GetPSOBindCalls() << "\n";
+                stm << "PSO binds: " << ::Statistics::GetPSOBindCalls() << ", shader binds: " << ::Statistics::GetShaderBinds() << "\n";
 
 				std::strcpy( outStr, stm.str().c_str() );
 	    }
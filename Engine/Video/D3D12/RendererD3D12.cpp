@@ -12,6 +12,7 @@ void ae3d::BuiltinShaders::Load()
     momentsShader.Load( "", "", FileSystem::FileContents( "shaders/moments_vert.obj" ), FileSystem::FileContents( "shaders/moments_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     momentsAlphaTestShader.Load( "", "", FileSystem::FileContents( "shaders/moments_vert.obj" ), FileSystem::FileContents( "shaders/moments_alphatest_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     momentsSkinShader.Load( "", "", FileSystem::FileContents( "shaders/moments_skin_vert.obj" ), FileSystem::FileContents( "shaders/moments_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
+    shadowCacheShader.Load( "", "", FileSystem::FileContents( "shaders/sprite_vert.obj" ), FileSystem::FileContents( "shaders/shadow_cache_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     depthNormalsShader.Load( "", "", FileSystem::FileContents( "shaders/depthnormals_vert.obj" ), FileSystem::FileContents( "shaders/depthnormals_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     depthNormalsSkinShader.Load( "", "", FileSystem::FileContents( "shaders/depthnormals_skin_vert.obj" ), FileSystem::FileContents( "shaders/depthnormals_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     uiShader.Load( "", "", FileSystem::FileContents( "shaders/sprite_vert.obj" ), FileSystem::FileContents( "shaders/sprite_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
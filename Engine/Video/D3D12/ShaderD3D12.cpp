@@ -13,6 +13,7 @@
 #include "TextureCube.hpp"
 #include "RenderTexture.hpp"
 #include "Macros.hpp"
+#include "Statistics.hpp"
 
 extern int AE3D_CB_SIZE;
 
@@ -57,6 +58,7 @@ namespace
     };
 
     std::vector< ShaderCacheEntry > cacheEntries;
+    const ae3d::Shader* lastUsedShader = nullptr; // Counts shader changes for Statistics.
 }
 
 void ClearPSOCache();
@@ -261,6 +263,12 @@ void ae3d::Shader::Use()
 {
     System::Assert( IsValid(), "Shader not loaded" );
     GfxDevice::GetNewUniformBuffer();
+
+    if (lastUsedShader != this)
+    {
+        lastUsedShader = this;
+        Statistics::IncShaderBinds();
+    }
 }
 
 void ae3d::Shader::SetUniform( int offset, void* data, int dataBytes )
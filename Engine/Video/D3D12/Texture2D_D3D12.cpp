@@ -444,6 +444,11 @@ int GetTextureMemoryUsageBytes( int width, int height, DXGI_FORMAT format, bool
 }
 
 void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+{
+    LoadDecoded( fileContents, DecodedImage(), aWrap, aFilter, aMipmaps, aColorSpace, aAnisotropy );
+}
+
+void ae3d::Texture2D::LoadDecoded( const FileSystem::FileContentsData& fileContents, const DecodedImage& image, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
 {
     filter = aFilter;
     wrap = aWrap;
@@ -478,7 +483,7 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
     
     if (HasStbExtension( fileContents.path ))
     {
-        LoadSTB( fileContents );
+        LoadSTB( fileContents, image );
     }
     else if (isDDS)
     {
@@ -630,20 +635,26 @@ void ae3d::Texture2D::LoadDDS( const char* aPath )
     InitializeTexture( gpuResource, texResources.data(), mipLevelCount );
 }
 
-void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents, const DecodedImage& image )
 {
-    int components;
-    unsigned char* data = stbi_load_from_memory( fileContents.data.data(), static_cast<int>(fileContents.data.size()), &width, &height, &components, 4 );
-    System::Assert( width > 0 && height > 0, "Invalid texture dimension" );
+    DecodedImage decodedImage;
+    const DecodedImage* source = &image;
 
-    if (data == nullptr)
+    if (image.pixels.empty())
     {
-        const std::string reason( stbi_failure_reason() );
-        System::Print( "%s failed to load. stb_image's reason: %s\n", fileContents.path.c_str(), reason.c_str() );
-        return;
+        if (!Decode( fileContents, decodedImage ))
+        {
+            return;
+        }
+
+        source = &decodedImage;
     }
 
-    opaque = (components == 3 || components == 1);
+    width = source->width;
+    height = source->height;
+    const unsigned char* data = source->pixels.data();
+
+    opaque = source->opaque;
     mipLevelCount = mipmaps == Mipmaps::Generate ? MathUtil::GetMipmapCount( width, height ) : 1;
     dxgiFormat = colorSpace == ColorSpace::Linear ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
 
@@ -734,6 +745,4 @@ void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents
 
         InitializeTexture( gpuResource, texResources.data(), mipLevelCount );
     }
-
-    stbi_image_free( data );
 }
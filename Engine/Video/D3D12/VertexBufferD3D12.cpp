@@ -33,7 +33,7 @@ void ae3d::VertexBuffer::DestroyBuffers()
 
 unsigned ae3d::VertexBuffer::GetIBSize() const
 {
-    return elementCount * 2;
+    return elementCount * GetIndexSize();
 }
 
 unsigned ae3d::VertexBuffer::GetStride() const
@@ -131,12 +131,13 @@ void ae3d::VertexBuffer::UploadVB( void* faces, void* vertices, unsigned ibSize
 
     indexBufferView.BufferLocation = vbUpload->GetGPUVirtualAddress() + GetIBOffset();
     indexBufferView.SizeInBytes = GetIBSize();
-    indexBufferView.Format = DXGI_FORMAT_R16_UINT;
+    indexBufferView.Format = indexType == IndexType::UInt32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
 }
 
 void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
 
     const int ibSize = elementCount * 2;
@@ -196,7 +197,7 @@ void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int vertexCount )
 
     indexBufferView.BufferLocation = vbUpload->GetGPUVirtualAddress() + GetIBOffset();
     indexBufferView.SizeInBytes = GetIBSize();
-    indexBufferView.Format = DXGI_FORMAT_R16_UINT;
+    indexBufferView.Format = indexType == IndexType::UInt32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
 }
 
 void ae3d::VertexBuffer::UpdateDynamic( const Face* faces, int /*faceCount*/, const VertexPTC* vertices, int vertexCount )
@@ -223,6 +224,7 @@ void ae3d::VertexBuffer::UpdateDynamic( const Face* faces, int /*faceCount*/, co
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTC* vertices, int vertexCount, Storage /*storage*/ )
 {
     vertexFormat = VertexFormat::PTNTC;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
 
     const int ibSize = elementCount * 2;
@@ -244,11 +246,23 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 }
 
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt16;
+    GeneratePTN( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt32;
+    GeneratePTN( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::GeneratePTN( const void* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC;
     elementCount = faceCount * 3;
 
-    const int ibSize = elementCount * 2;
+    const int ibSize = elementCount * GetIndexSize();
     ibOffset = sizeof( VertexPTNTC ) * vertexCount;
 
     std::vector< VertexPTNTC > verticesPTNTC( vertexCount );
@@ -269,6 +283,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
 
     const int ibSize = elementCount * 2;
@@ -277,9 +292,22 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     UploadVB( (void*)faces, (void*)vertices, ibSize );
 }
 
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    indexType = IndexType::UInt32;
+    elementCount = faceCount * 3;
+
+    const int ibSize = elementCount * 4;
+    ibOffset = sizeof( VertexPTNTC ) * vertexCount;
+
+    UploadVB( (void*)faces, (void*)vertices, ibSize );
+}
+
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC_Skinned;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
 
     const int ibSize = elementCount * 2;
@@ -288,6 +316,18 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     UploadVB( (void*)faces, (void*)vertices, ibSize );
 }
 
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC_Skinned;
+    indexType = IndexType::UInt32;
+    elementCount = faceCount * 3;
+
+    const int ibSize = elementCount * 4;
+    ibOffset = sizeof( VertexPTNTC_Skinned ) * vertexCount;
+
+    UploadVB( (void*)faces, (void*)vertices, ibSize );
+}
+
 void ae3d::VertexBuffer::Bind() const
 {
 }
@@ -43,6 +43,7 @@ struct PerObjectUboStruct
     float timeStamp; // In seconds.
     float roughness;
     float alphaThreshold;
+    int isInstanced = 0; // 1: Matrices are read from the instance buffer.
 };
 
 namespace ae3d
@@ -122,15 +123,43 @@ namespace ae3d
         void EndBackBufferEncoding();
 #endif
 #if RENDERER_VULKAN
+        /// Frame slots that the CPU cycles through, so it can record a frame while the GPU executes the previous one.
+        /// Buffers that the CPU writes during a frame have a copy for each slot.
+        const unsigned FramesInFlight = 2;
+
         void ResetPSOCache();
+
+        /// Creates the PSOs that the previous session drew with on worker threads, so their first draws don't stall on pipeline compilation.
+        /// Call while loading, after loading shaders and creating render textures. PSOs of shaders and render texture formats that don't exist yet are skipped.
+        /// \return Number of created PSOs.
+        unsigned PrewarmPSOs();
         void CreateUniformBuffers();
+        /// \return Current draw's cbPerDraw block (binding 7), GetCurrentUboBytes() bytes.
         std::uint8_t* GetCurrentUbo();
+        /// \return Size of the block that GetCurrentUbo() returns.
+        int GetCurrentUboBytes();
         void BeginRenderPassAndCommandBuffer();
         void BeginRenderPass();
         void EndRenderPassAndCommandBuffer();
         void EndRenderPass();
         void EndCommandBuffer();
         void BeginFrame();
+
+        /// Per-instance data of instanced draws. Must be kept in sync with ubo.h.
+        struct InstanceData
+        {
+            Matrix44 localToClip;
+            Matrix44 localToView;
+            Matrix44 localToWorld;
+            Matrix44 localToShadowClip;
+        };
+
+        /// Maximum instance count in one DrawInstanced() call.
+        static const unsigned MaxInstancesPerDraw = 1024;
+
+        /// Draws instanceCount instances of the vertex buffer in one draw call. The shader must support instancing.
+        void DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode,
+                            const InstanceData* instances, unsigned instanceCount );
 #endif
         void ClearScreen( unsigned clearFlags );
         void Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode, PrimitiveTopology topology );
@@ -5,6 +5,7 @@
 #endif
 #if RENDERER_VULKAN
 #include <vulkan/vulkan.h>
+#include "GfxDevice.hpp"
 #endif
 #include "Vec3.hpp"
 
@@ -48,15 +49,16 @@ namespace ae3d
         unsigned GetMaxNumLightsPerTile() const;
         
 #if RENDERER_VULKAN
+        // Light buffers have a range for each frame slot, so UpdateLightBuffers doesn't overwrite the lights of a frame that the GPU executes.
         VkBuffer GetPointLightBuffer() const { return pointLightCenterAndRadiusBuffer; }
-        VkBufferView* GetPointLightBufferView() { return &pointLightBufferView; }
+        VkBufferView* GetPointLightBufferView( unsigned frameSlot ) { return &pointLightBufferViews[ frameSlot ]; }
         VkBuffer GetPointLightColorBuffer() const { return pointLightColorBuffer; }
-        VkBufferView* GetPointLightColorBufferView() { return &pointLightColorView; }
+        VkBufferView* GetPointLightColorBufferView( unsigned frameSlot ) { return &pointLightColorViews[ frameSlot ]; }
         VkBuffer GetSpotLightBuffer() const { return spotLightCenterAndRadiusBuffer; }
         VkBuffer GetSpotLightColorBuffer() const { return spotLightColorBuffer; }
-        VkBufferView* GetSpotLightColorBufferView() { return &spotLightColorView; }
-        VkBufferView* GetSpotLightBufferView() { return &spotLightBufferView; }
-        VkBufferView* GetSpotLightParamsView() { return &spotLightParamsView; }
+        VkBufferView* GetSpotLightColorBufferView( unsigned frameSlot ) { return &spotLightColorViews[ frameSlot ]; }
+        VkBufferView* GetSpotLightBufferView( unsigned frameSlot ) { return &spotLightBufferViews[ frameSlot ]; }
+        VkBufferView* GetSpotLightParamsView( unsigned frameSlot ) { return &spotLightParamsViews[ frameSlot ]; }
         VkBufferView* GetLightIndexBufferView() { return &perTileLightIndexBufferView; }
 #endif
         unsigned GetNumTilesX() const;
@@ -84,27 +86,27 @@ namespace ae3d
         VkBuffer pointLightCenterAndRadiusBuffer = VK_NULL_HANDLE;
         VkDeviceMemory pointLightCenterAndRadiusMemory = VK_NULL_HANDLE;
         void* mappedPointLightCenterAndRadiusMemory = nullptr;
-        VkBufferView pointLightBufferView = VK_NULL_HANDLE;
+        VkBufferView pointLightBufferViews[ GfxDevice::FramesInFlight ] = {};
         
         VkBuffer pointLightColorBuffer = VK_NULL_HANDLE;
         VkDeviceMemory pointLightColorMemory = VK_NULL_HANDLE;
         void* mappedPointLightColorMemory = nullptr;
-        VkBufferView pointLightColorView = VK_NULL_HANDLE;
+        VkBufferView pointLightColorViews[ GfxDevice::FramesInFlight ] = {};
 
         VkBuffer spotLightColorBuffer = VK_NULL_HANDLE;
         VkDeviceMemory spotLightColorMemory = VK_NULL_HANDLE;
         void* mappedSpotLightColorMemory = nullptr;
-        VkBufferView spotLightColorView = VK_NULL_HANDLE;
+        VkBufferView spotLightColorViews[ GfxDevice::FramesInFlight ] = {};
 
         VkBuffer spotLightCenterAndRadiusBuffer = VK_NULL_HANDLE;
         VkDeviceMemory spotLightCenterAndRadiusMemory = VK_NULL_HANDLE;
         void* mappedSpotLightCenterAndRadiusMemory = nullptr;
-        VkBufferView spotLightBufferView = VK_NULL_HANDLE;
+        VkBufferView spotLightBufferViews[ GfxDevice::FramesInFlight ] = {};
 
         VkBuffer spotLightParamsBuffer = VK_NULL_HANDLE;
         VkDeviceMemory spotLightParamsMemory = VK_NULL_HANDLE;
         void* mappedSpotLightParamsMemory = nullptr;
-        VkBufferView spotLightParamsView = VK_NULL_HANDLE;
+        VkBufferView spotLightParamsViews[ GfxDevice::FramesInFlight ] = {};
         
         VkBuffer perTileLightIndexBuffer = VK_NULL_HANDLE;
         VkDeviceMemory perTileLightIndexBufferMemory = VK_NULL_HANDLE;
@@ -233,10 +233,17 @@ namespace ae3d
                 str += std::to_string( ::Statistics::GetBloomCpuTimeMS());
                 str += "\ndraw calls: ";
                 str += std::to_string( ::Statistics::GetDrawCalls() );
+                str += "\nshader binds: ";
+                str += std::to_string( ::Statistics::GetShaderBinds() );
                 str += "\nscene AABB: ";
                 str += std::to_string( ::Statistics::GetSceneAABBTimeMS() );
                 str += "\nfrustum cull: ";
                 str += std::to_string( ::Statistics::GetFrustumCullTimeMS() );
+                str += "\nocclusion cull: ";
+                str += std::to_string( ::Statistics::GetOcclusionCullTimeMS() );
+                str += " ms, ";
+                str += std::to_string( ::Statistics::GetOcclusionCulledCount() );
+                str += " hidden";
                 str += "\nmemory: ";
                 str += std::to_string([device currentAllocatedSize] / (1024 * 1024));
                 str += " MiB";
@@ -840,9 +847,9 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
     {
         [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
                                   indexCount:(endIndex - startIndex) * 3
-                               indexType:MTLIndexTypeUInt16
+                               indexType:vertexBuffer.GetIndexType() == VertexBuffer::IndexType::UInt32 ? MTLIndexTypeUInt32 : MTLIndexTypeUInt16
                              indexBuffer:vertexBuffer.GetIndexBuffer()
-                       indexBufferOffset:startIndex * 2 * 3];
+                       indexBufferOffset:startIndex * vertexBuffer.GetIndexSize() * 3];
     }
     else // MTLPrimitiveTypeLine
     {
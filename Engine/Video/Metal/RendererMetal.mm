@@ -16,6 +16,7 @@ void ae3d::BuiltinShaders::Load()
     momentsShader.LoadFromLibrary( "moments_vertex", "moments_fragment" );
     momentsSkinShader.LoadFromLibrary( "moments_skin_vertex", "moments_fragment" );
     momentsAlphaTestShader.LoadFromLibrary( "moments_vertex", "moments_alphatest_fragment" );
+    shadowCacheShader.LoadFromLibrary( "sprite_vertex", "shadow_cache_fragment" );
     depthNormalsShader.LoadFromLibrary( "depthnormals_vertex", "depthnormals_fragment" );
     depthNormalsSkinShader.LoadFromLibrary( "depthnormals_skin_vertex", "depthnormals_fragment" );
     lightCullShader.Load( "light_culler", FileSystem::FileContents(""), FileSystem::FileContents("") );
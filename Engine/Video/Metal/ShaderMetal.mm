@@ -5,10 +5,16 @@
 #include "Texture2D.hpp"
 #include "TextureCube.hpp"
 #include "RenderTexture.hpp"
+#include "Statistics.hpp"
 #include "System.hpp"
 
 extern id<MTLTexture> textures[ 13 ];
 
+namespace
+{
+    const ae3d::Shader* lastUsedShader = nullptr; // Counts shader changes for Statistics.
+}
+
 namespace GfxDeviceGlobal
 {
     void SetSampler( int textureUnit, ae3d::TextureFilter filter, ae3d::TextureWrap wrap, ae3d::Anisotropy anisotropy );
@@ -66,6 +72,12 @@ void ae3d::Shader::Use()
 {
     System::Assert( IsValid(), "Shader not loaded" );
     GfxDevice::GetNewUniformBuffer();
+
+    if (lastUsedShader != this)
+    {
+        lastUsedShader = this;
+        Statistics::IncShaderBinds();
+    }
 }
 
 void ae3d::Shader::LoadUniforms( MTLRenderPipelineReflection* reflection )
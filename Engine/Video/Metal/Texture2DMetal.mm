@@ -463,6 +463,11 @@ void ae3d::Texture2D::SetLayout( TextureLayout aLayout )
 }
 
 void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+{
+    LoadDecoded( fileContents, DecodedImage(), aWrap, aFilter, aMipmaps, aColorSpace, aAnisotropy );
+}
+
+void ae3d::Texture2D::LoadDecoded( const FileSystem::FileContentsData& fileContents, const DecodedImage& image, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
 {
     if (!fileContents.isLoaded)
     {
@@ -482,7 +487,7 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
 
     if (HasStbExtension( fileContents.path ))
     {
-        LoadSTB( fileContents );
+        LoadSTB( fileContents, image );
     }
     else if (isPVR)
     {
@@ -683,19 +688,26 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
     tex2dMemoryUsage += [metalTexture allocatedSize];
 }
 
-void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents, const DecodedImage& image )
 {
-    int components;
-    unsigned char* data = stbi_load_from_memory( &fileContents.data[ 0 ], static_cast<int>(fileContents.data.size()), &width, &height, &components, 4 );
-    
-    if (data == nullptr)
+    DecodedImage decodedImage;
+    const DecodedImage* source = &image;
+
+    if (image.pixels.empty())
     {
-        const std::string reason( stbi_failure_reason() );
-        System::Print( "%s failed to load. stb_image's reason: %s\n", fileContents.path.c_str(), reason.c_str() );
-        return;
+        if (!Decode( fileContents, decodedImage ))
+        {
+            return;
+        }
+
+        source = &decodedImage;
     }
 
-    opaque = (components == 3 || components == 1);
+    width = source->width;
+    height = source->height;
+    const unsigned char* data = source->pixels.data();
+
+    opaque = source->opaque;
 
     MTLTextureDescriptor* textureDescriptor =
     [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:colorSpace == ColorSpace::Linear ? MTLPixelFormatRGBA8Unorm : MTLPixelFormatRGBA8Unorm_sRGB
@@ -755,8 +767,6 @@ void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents
         [commandBuffer commit];
         [commandBuffer waitUntilCompleted];
     }
-
-    stbi_image_free( data );
 }
 
 void ae3d::Texture2D::LoadPVRv2( const char* path )
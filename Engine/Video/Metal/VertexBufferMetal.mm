@@ -23,6 +23,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     }
     
     vertexFormat = VertexFormat::PTC;
+    indexType = IndexType::UInt16;
     
     if (storage == Storage::GPU)
     {
@@ -217,6 +218,18 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 }
 
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt16;
+    GeneratePTN( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt32;
+    GeneratePTN( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::GeneratePTN( const void* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
 {
     if (faceCount == 0)
     {
@@ -303,7 +316,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     weightBuffer.label = @"Weight buffer";
     
     indexBuffer = [GfxDevice::GetMetalDevice() newBufferWithBytes:faces
-                      length:sizeof( Face ) * faceCount
+                      length:GetIndexSize() * 3 * faceCount
                      options:MTLResourceCPUCacheModeDefaultCache];
     indexBuffer.label = @"Index buffer";
     
@@ -320,6 +333,18 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 }
 
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt16;
+    GeneratePTNTC( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt32;
+    GeneratePTNTC( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::GeneratePTNTC( const void* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
 {
     if (faceCount == 0)
     {
@@ -434,7 +459,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     weightBuffer.label = @"Weight buffer";
     
     indexBuffer = [GfxDevice::GetMetalDevice() newBufferWithBytes:faces
-                      length:sizeof( Face ) * faceCount
+                      length:GetIndexSize() * 3 * faceCount
                      options:MTLResourceCPUCacheModeDefaultCache];
     indexBuffer.label = @"Index buffer";
     
@@ -451,6 +476,18 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 }
 
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt16;
+    GeneratePTNTC_Skinned( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt32;
+    GeneratePTNTC_Skinned( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::GeneratePTNTC_Skinned( const void* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount )
 {
     if (faceCount == 0)
     {
@@ -581,7 +618,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     boneBuffer.label = @"Bone buffer";
     
     indexBuffer = [GfxDevice::GetMetalDevice() newBufferWithBytes:faces
-                      length:sizeof( Face ) * faceCount
+                      length:GetIndexSize() * 3 * faceCount
                      options:MTLResourceCPUCacheModeDefaultCache];
     indexBuffer.label = @"Index buffer";
     
@@ -600,6 +637,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int vertexCount )
 {
     vertexFormat = VertexFormat::PTC;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
 
     vertexBuffer = [GfxDevice::GetMetalDevice() newBufferWithLength:sizeof( VertexPTC ) * vertexCount
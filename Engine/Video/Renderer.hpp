@@ -30,6 +30,7 @@ namespace ae3d
         Shader momentsShader;
         Shader momentsSkinShader;
         Shader momentsAlphaTestShader;
+        Shader shadowCacheShader;
         Shader depthNormalsShader;
         Shader depthNormalsSkinShader;
         Shader uiShader;
@@ -7,6 +7,7 @@
 #include "Texture2D.hpp"
 #include "System.hpp"
 #include "FileSystem.hpp"
+#include "stb_image.c"
 
 #if defined( RENDERER_METAL ) || defined( RENDERER_VULKAN )
 namespace Texture2DGlobal
@@ -35,6 +36,30 @@ bool HasStbExtension( const std::string& path )
     return false;
 }
 
+bool ae3d::Texture2D::Decode( const FileSystem::FileContentsData& textureData, DecodedImage& outImage )
+{
+    if (!textureData.isLoaded || !HasStbExtension( textureData.path ))
+    {
+        return false;
+    }
+
+    int components;
+    unsigned char* data = stbi_load_from_memory( textureData.data.data(), static_cast< int >( textureData.data.size() ), &outImage.width, &outImage.height, &components, 4 );
+
+    if (data == nullptr)
+    {
+        const std::string reason( stbi_failure_reason() );
+        System::Print( "%s failed to load. stb_image's reason: %s\n", textureData.path.c_str(), reason.c_str() );
+        return false;
+    }
+
+    outImage.pixels.assign( data, data + outImage.width * outImage.height * 4 );
+    outImage.opaque = (components == 3 || components == 1);
+    stbi_image_free( data );
+
+    return true;
+}
+
 void Tokenize( const std::string& str,
               std::vector< std::string >& tokens,
               const std::string& delimiters = " " )
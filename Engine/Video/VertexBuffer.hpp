@@ -8,18 +8,20 @@
 #endif
 #if RENDERER_VULKAN
 #include <vulkan/vulkan.h>
+#include "GfxDevice.hpp"
 #endif
 #include "Vec3.hpp"
 #include "Array.hpp"
 
 namespace ae3d
 {
-    /// Contains a vertex and index buffer. Indices are 16-bit.
+    /// Contains a vertex and index buffer. Indices are 16-bit, or 32-bit if the buffer is generated from Face32 faces.
     class VertexBuffer
     {
     public:
         enum class Storage { CPU, GPU };
         enum class VertexFormat { PTC, PTN, PTNTC, PTNTC_Skinned, Empty };
+        enum class IndexType { UInt16, UInt32 };
 
         /// Triangle of 3 vertices.
         struct Face
@@ -35,6 +37,20 @@ namespace ae3d
             unsigned short a, b, c;
         };
 
+        /// Triangle of 3 vertices with 32-bit indices, for meshes that have more than 65535 vertices.
+        struct Face32
+        {
+            Face32() noexcept : a(0), b(0), c(0) {}
+
+            Face32( unsigned fa, unsigned fb, unsigned fc )
+            : a( fa )
+            , b( fb )
+            , c( fc )
+            {}
+
+            unsigned a, b, c;
+        };
+
         /// Vertex with position, texture coordinate and color.
         struct VertexPTC
         {
@@ -112,6 +128,12 @@ namespace ae3d
 
         VertexFormat GetVertexFormat() const { return vertexFormat; }
 
+        /// \return Index type. UInt32 if the buffer was generated from Face32 faces.
+        IndexType GetIndexType() const { return indexType; }
+
+        /// \return Index size in bytes.
+        int GetIndexSize() const { return indexType == IndexType::UInt32 ? 4 : 2; }
+
         /// \return True if the buffer contains geometry ready for rendering.
         bool IsGenerated() const { return elementCount != 0; }
 
@@ -156,6 +178,27 @@ namespace ae3d
         /// \param vertexCount Vertex count.
         void Generate( const Face* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount );
 
+        /// Generates the buffer from supplied geometry with 32-bit indices.
+        /// \param faces Faces.
+        /// \param faceCount Face count.
+        /// \param vertices Vertices.
+        /// \param vertexCount Vertex count.
+        void Generate( const Face32* faces, int faceCount, const VertexPTN* vertices, int vertexCount );
+
+        /// Generates the buffer from supplied geometry with 32-bit indices.
+        /// \param faces Faces.
+        /// \param faceCount Face count.
+        /// \param vertices Vertices.
+        /// \param vertexCount Vertex count.
+        void Generate( const Face32* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount );
+
+        /// Generates the buffer from supplied geometry with 32-bit indices.
+        /// \param faces Faces.
+        /// \param faceCount Face count.
+        /// \param vertices Vertices.
+        /// \param vertexCount Vertex count.
+        void Generate( const Face32* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount );
+
         /// Sets a graphics API debug name for the buffer, visible in debugging tools. Must be called after Generate().
         /// \param name Name
         void SetDebugName( const char* name );
@@ -178,9 +221,16 @@ namespace ae3d
         static const unsigned VERTEX_BUFFER_BIND_ID = 0;
 
         VkPipelineVertexInputStateCreateInfo* GetInputState() { CreateInputState( bindingDescriptions.stride ); return &inputStateCreateInfo; }
+
+        /// Makes GetInputState() return the input state of a vertex format without creating buffers, so PSOs can be created before buffers are loaded.
+        void SetInputStateFormat( VertexFormat format );
         VkBuffer* GetVertexBuffer() { return &vertexBuffer; }
         VkBuffer* GetIndexBuffer() { return &indexBuffer; }
 
+        /// Makes a dynamic buffer's GetVertexBuffer() and GetIndexBuffer() return the frame slot's copy, and updates the copy
+        /// if UpdateDynamic() was called in another slot after it. Does nothing for other buffers. Call before binding the buffer.
+        /// \param frameSlot Frame slot that is being recorded, see GfxDevice::FramesInFlight.
+        void SelectFrameSlot( unsigned frameSlot );
 #endif
         /// Destroys graphics API objects.
         static void DestroyBuffers();
@@ -194,6 +244,8 @@ namespace ae3d
         static const int weightChannel = 6;
 
     private:
+        // faces are Face or Face32, depending on indexType.
+        void GeneratePTN( const void* faces, int faceCount, const VertexPTN* vertices, int vertexCount );
 
 #if RENDERER_D3D12
         void UploadVB( void* faces, void* vertices, unsigned ibSize );
@@ -207,7 +259,11 @@ namespace ae3d
 #endif
         int elementCount = 0;
         VertexFormat vertexFormat = VertexFormat::PTC;
+        IndexType indexType = IndexType::UInt16;
 #if RENDERER_METAL
+        void GeneratePTNTC( const void* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount );
+        void GeneratePTNTC_Skinned( const void* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount );
+
         id<MTLBuffer> vertexBuffer;
         id<MTLBuffer> indexBuffer;
 #endif
@@ -227,8 +283,8 @@ namespace ae3d
         struct Buffer
         {
             int size = 0;
-            VkDeviceMemory memory;
-            VkBuffer buffer;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkBuffer buffer = VK_NULL_HANDLE;
             void* mappedData = nullptr;
         };
 
@@ -236,11 +292,17 @@ namespace ae3d
         {
             Buffer vertices;
             Buffer indices;
-        } stagingBuffers;
+            unsigned version = 0; // dynamicVersion when the copy was last written.
+        } dynamicBuffers[ GfxDevice::FramesInFlight ]; // Dynamic buffer's copies, one for each frame slot.
 
         static Buffer globalStagingBuffer;
         
-        Array< VertexPTNTC > verticesPTNTC; // For dynamic buffer.
+        // Dynamic buffer's latest contents, so copies of other frame slots can be updated.
+        Array< VertexPTNTC > verticesPTNTC;
+        Array< Face > dynamicFaces;
+        int dynamicFaceCount = 0;
+        int dynamicVertexCount = 0;
+        unsigned dynamicVersion = 0; // Incremented by UpdateDynamic().
 #endif
     };
 }
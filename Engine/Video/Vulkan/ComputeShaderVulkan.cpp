@@ -15,12 +15,13 @@
 extern ae3d::FileWatcher fileWatcher;
 
 void BindComputeDescriptorSet();
-void UploadPerObjectUbo();
+void UploadPerObjectUbo( bool isSkinned );
+void BeginComputePass();
+void EndComputePass();
 
 namespace GfxDeviceGlobal
 {
     extern VkDevice device;
-    extern VkQueue computeQueue;
     extern VkCommandBuffer computeCmdBuffer;
     extern VkPipelineLayout pipelineLayout;
     extern VkPipelineCache pipelineCache;
@@ -189,37 +190,12 @@ void ae3d::ComputeShader::SetTexture2D( Texture2D* texture, unsigned slot )
 
 void ae3d::ComputeShader::Begin()
 {
-    VkCommandBufferBeginInfo cmdBufInfo = {};
-    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-    VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::computeCmdBuffer, &cmdBufInfo );
-    AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+    BeginComputePass();
 }
 
 void ae3d::ComputeShader::End()
 {
-    vkEndCommandBuffer( GfxDeviceGlobal::computeCmdBuffer );
-
-    VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pWaitDstStageMask = &pipelineStages;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = nullptr;
-    submitInfo.signalSemaphoreCount = 0;
-    submitInfo.pSignalSemaphores = nullptr;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::computeCmdBuffer;
-
-    VkResult err = vkQueueSubmit( GfxDeviceGlobal::computeQueue, 1, &submitInfo, VK_NULL_HANDLE );
-    AE3D_CHECK_VULKAN( err, "vkQueueSubmit compute" );
-    Statistics::IncQueueSubmitCalls();
-
-    System::BeginTimer();
-    err = vkQueueWaitIdle( GfxDeviceGlobal::computeQueue );
-    Statistics::IncQueueWaitTime( System::EndTimer() );
-    AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
+    EndComputePass();
 }
 
 void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY, unsigned groupCountZ, const char* debugName )
@@ -228,8 +204,10 @@ void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY,
 
     debug::BeginRegion( GfxDeviceGlobal::computeCmdBuffer, debugName, 0, 1, 0 );
     
+    // Uniform blocks are uploaded before binding, because the descriptor set points to the ranges that the upload allocates.
+    GfxDevice::GetNewUniformBuffer();
+    UploadPerObjectUbo( false );
     BindComputeDescriptorSet();
-    UploadPerObjectUbo();
 
     vkCmdBindPipeline( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pso );
     vkCmdDispatch( GfxDeviceGlobal::computeCmdBuffer, groupCountX, groupCountY, groupCountZ );
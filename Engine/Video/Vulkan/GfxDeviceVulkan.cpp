@@ -2,15 +2,20 @@
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "GfxDevice.hpp"
 #include <cstdint>
+#include <cstdio>
 #include <map>
+#include <set>
 #include <vector>
 #include <cstring>
 #include <string>
+#include <utility>
 #include <vulkan/vulkan.h>
 #include "Array.hpp"
 #include "FileSystem.hpp"
+#include "JobSystem.hpp"
 #include "LightTiler.hpp"
 #include "Macros.hpp"
+#include "PSOManifest.hpp"
 #include "RenderTexture.hpp"
 #include "Renderer.hpp"
 #include "System.hpp"
@@ -42,7 +47,14 @@ PFN_vkGetShaderInfoAMD getShaderInfoAMD;
 
 constexpr unsigned UI_VERTICE_COUNT = 512 * 1024;
 constexpr unsigned UI_FACE_COUNT = 128 * 1024;
-constexpr std::uint32_t descriptorSlotCount = 17;
+constexpr std::uint32_t descriptorSlotCount = 21;
+constexpr unsigned MaxInstancesPerFrame = 16 * 1024;
+constexpr unsigned FramesInFlight = ae3d::GfxDevice::FramesInFlight;
+constexpr VkDeviceSize UboBytesPerFrame = 12 * 1024 * 1024; // About 1800 draws that all change every uniform block.
+constexpr unsigned DescriptorSetsPerFrame = 5550;
+constexpr std::uint32_t TimestampQueriesPerFrame = 32; // Two for each timed offscreen pass.
+constexpr const char* PipelineCacheFileName = "pipeline_cache_vulkan.bin";
+constexpr const char* PSOManifestFileName = "pso_manifest_vulkan.txt";
 
 namespace Texture2DGlobal
 {
@@ -52,18 +64,114 @@ namespace Texture2DGlobal
 extern VkBuffer particleBuffer;
 extern VkDeviceMemory particleMemory;
 
+void GetLoadedShaders( const std::string& vertexPath, const std::string& fragmentPath, std::vector< ae3d::Shader* >& outShaders );
+VkRenderPass GetRenderPassForFormat( VkFormat colorFormat, int sampleCount );
+
+void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
+
 extern VkBuffer particleTileBuffer;
 extern VkDeviceMemory particleTileMemory;
 extern VkBufferView particleTileBufferView;
 
-struct Ubo
+// Uniform blocks in ubo.h's Vulkan branch. Blocks are gathered from PerObjectUboStruct and each one is uploaded only when it
+// has changed, so a draw usually uploads just its per-draw block instead of the whole PerObjectUboStruct.
+
+/// Binding 7, cbPerDraw.
+struct PerDrawUbo
 {
-    VkBuffer ubo = VK_NULL_HANDLE;
+    ae3d::Matrix44 localToClip;
+    ae3d::Matrix44 localToView;
+    ae3d::Matrix44 localToWorld;
+    ae3d::Matrix44 localToShadowClip;
+    ae3d::Vec4 tex0scaleOffset;
+    int isInstanced;
+    int padding[ 3 ];
+};
+
+/// Binding 18, cbPerFrame. Camera, light and post-process state that changes only a few times in a frame.
+struct PerFrameUbo
+{
+    ae3d::Matrix44 clipToView;
+    ae3d::Matrix44 viewToClip;
+    ae3d::Vec4 lightPosition;
+    ae3d::Vec4 lightDirection;
+    ae3d::Vec4 lightColor;
+    float lightConeAngleCos;
+    int lightType;
+    float minAmbient;
+    unsigned maxNumLightsPerTile;
+    unsigned windowWidth;
+    unsigned windowHeight;
+    unsigned numLights;
+    int particleCount;
+    ae3d::Vec4 tilesXY;
+    ae3d::Vec4 cameraParams;
+    ae3d::Vec4 particleColor;
+    int isVR;
+    int kernelSize;
+    float bloomThreshold;
+    float bloomIntensity;
+    int particleReset;
+    float timeStamp;
+    int padding[ 2 ];
+    ae3d::Vec4 kernelOffsets[ 16 ];
+};
+
+/// Binding 19, cbMaterial.
+struct MaterialUbo
+{
+    float f0;
+    float roughness;
+    float alphaThreshold;
+    int padding;
+};
+
+/// Binding 20, cbSkinning. Only uploaded for skinned meshes.
+struct SkinningUbo
+{
+    ae3d::Matrix44 boneMatrices[ 80 ];
+};
+
+/// Objects that one frame in flight uses. A slot is reused when its fence shows that the GPU has finished the frame that was last recorded into it.
+struct FrameResources
+{
+    VkFence fence = VK_NULL_HANDLE; // Signaled when the frame's draw commands have finished.
+    VkSemaphore imageAcquiredSemaphore = VK_NULL_HANDLE;
+    VkSemaphore renderCompleteSemaphore = VK_NULL_HANDLE;
+    VkCommandBuffer drawCmdBuffer = VK_NULL_HANDLE;
+    VkCommandBuffer prePresentCmdBuffer = VK_NULL_HANDLE;
+    VkCommandBuffer postPresentCmdBuffer = VK_NULL_HANDLE;
+    std::vector< VkCommandBuffer > offscreenCmdBuffers; // Grows to the largest offscreen pass count of a frame.
+    unsigned offscreenPassCount = 0;
+    std::vector< VkCommandBuffer > computeCmdBuffers; // Grows to the largest compute pass count of a frame.
+    unsigned computePassCount = 0;
+    int timedPassProfilerIndices[ TimestampQueriesPerFrame / 2 ];
+    unsigned timedPassCount = 0;
+    VkBuffer uboBuffer = VK_NULL_HANDLE; // UboBytesPerFrame of uniform blocks, allocated linearly during the frame.
     VkDeviceMemory uboMemory = VK_NULL_HANDLE;
-    VkDescriptorBufferInfo uboDesc = {};
-    std::uint8_t* uboData = nullptr;
+    std::uint8_t* uboData = nullptr; // Mapped uboBuffer.
+    std::vector< std::pair< std::uint64_t, VkObjectType > > releasedObjects; // Destroyed when the fence is signaled.
+};
+
+struct PSOCacheEntry
+{
+    VkPipeline pso = VK_NULL_HANDLE;
+    bool isInManifest = false; // Set when the PSO is prewarmed from the manifest or drawn with for the first time.
+};
+
+/// Header of the pipeline cache file. The cache is only used if it was saved with the same GPU and driver.
+struct PipelineCacheFileHeader
+{
+    std::uint32_t magic;
+    std::uint32_t dataSize;
+    std::uint32_t vendorID;
+    std::uint32_t deviceID;
+    std::uint32_t driverVersion;
+    std::uint8_t pipelineCacheUUID[ VK_UUID_SIZE ];
 };
 
+constexpr std::uint32_t PipelineCacheFileMagic = 0x50434541; // "AECP"
+
 namespace ae3d
 {
     namespace GfxDevice
@@ -105,12 +213,12 @@ namespace GfxDeviceGlobal
     VkPhysicalDeviceProperties properties;
     VkClearColorValue clearColor;
     
-    VkCommandBuffer drawCmdBuffers[ 4 ];
+    FrameResources frames[ FramesInFlight ];
+    unsigned frameIndex = 0; // Slot in frames that is being recorded.
+    std::vector< std::pair< std::uint64_t, VkObjectType > > releasedObjects; // Released after the last submitted frame, moved to the next submitted frame.
     VkCommandBuffer setupCmdBuffer = VK_NULL_HANDLE;
-    VkCommandBuffer prePresentCmdBuffer = VK_NULL_HANDLE;
-    VkCommandBuffer postPresentCmdBuffer = VK_NULL_HANDLE;
-    VkCommandBuffer computeCmdBuffer = VK_NULL_HANDLE;
-    VkCommandBuffer offscreenCmdBuffer = VK_NULL_HANDLE;
+    VkCommandBuffer computeCmdBuffer = VK_NULL_HANDLE; // Current compute pass's.
+    VkCommandBuffer offscreenCmdBuffer = VK_NULL_HANDLE; // Current offscreen pass's.
     VkCommandBuffer currentCmdBuffer = VK_NULL_HANDLE;
     VkCommandBuffer texCmdBuffer = VK_NULL_HANDLE;
     
@@ -123,19 +231,16 @@ namespace GfxDeviceGlobal
     VkColorSpaceKHR colorSpace;
     VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
-    VkQueue computeQueue = VK_NULL_HANDLE;
     std::uint32_t graphicsQueueIndex = 0;
     Array< SwapchainBuffer > swapchainBuffers;
     Array< VkFramebuffer > frameBuffers;
     VkPhysicalDeviceFeatures deviceFeatures;
-    VkSemaphore presentCompleteSemaphore = VK_NULL_HANDLE;
-    VkSemaphore renderCompleteSemaphore = VK_NULL_HANDLE;
     VkCommandPool cmdPool = VK_NULL_HANDLE;
-    VkQueryPool queryPool = VK_NULL_HANDLE;
-    float timings[ 3 ];
+    VkQueryPool queryPool = VK_NULL_HANDLE; // TimestampQueriesPerFrame for each frame in flight.
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
-    std::map< std::uint64_t, VkPipeline > psoCache;
+    std::map< std::uint64_t, PSOCacheEntry > psoCache;
+    std::set< std::string > psoManifest; // Lines of PSOs that have been drawn with during this session. Merged with the saved manifest when saving.
     VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
     Array< VkDescriptorSet > descriptorSets;
     unsigned descriptorSetIndex = 0;
@@ -146,10 +251,19 @@ namespace GfxDeviceGlobal
     VkImageView boundViews[ ae3d::ComputeShader::SLOT_COUNT ];
     VkSampler boundSamplers[ 2 ];
     VkSampler linearRepeat;
-    Array< VkBuffer > pendingFreeVBs;
-    Array< VkDeviceMemory > pendingFreeMemory;
-    Array< Ubo > ubos;
-    unsigned currentUbo = 0;
+    VkDeviceSize uboOffset = 0; // Next free byte in the current frame's uboBuffer.
+    VkDeviceSize uboAlignment = 256; // minUniformBufferOffsetAlignment.
+    std::uint8_t* perDrawUboData = nullptr; // Per-draw block of the next draw or dispatch.
+    VkDescriptorBufferInfo perDrawUboDesc = {};
+    VkDescriptorBufferInfo perFrameUboDesc = {};
+    VkDescriptorBufferInfo materialUboDesc = {};
+    VkDescriptorBufferInfo skinningUboDesc = {};
+    PerFrameUbo uploadedPerFrameUbo; // Contents of perFrameUboDesc.
+    MaterialUbo uploadedMaterialUbo; // Contents of materialUboDesc.
+    SkinningUbo uploadedSkinningUbo; // Contents of skinningUboDesc.
+    bool isPerFrameUboUploaded = false; // False until the block has been uploaded in the current frame.
+    bool isMaterialUboUploaded = false;
+    bool isSkinningUboUploaded = false;
     VkSampleCountFlagBits msaaSampleBits = VK_SAMPLE_COUNT_1_BIT;
     ae3d::LightTiler lightTiler;
     PerObjectUboStruct perObjectUboStruct;
@@ -159,6 +273,11 @@ namespace GfxDeviceGlobal
     std::vector< ae3d::VertexBuffer > lineBuffers;
     VkPipeline cachedPSO;
     bool supportsMemoryBudget = false;
+    VkBuffer instanceBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory instanceMemory = VK_NULL_HANDLE;
+    ae3d::GfxDevice::InstanceData* instanceData = nullptr; // Mapped instanceBuffer. Each frame in flight has its own range.
+    unsigned instanceCount = 0; // Instances written to the current frame's range.
+    VkDescriptorBufferInfo instanceDesc = {}; // Offset points to the current instanced draw's instances.
 }
 
 namespace ae3d
@@ -180,11 +299,14 @@ namespace ae3d
                 str += "bloom CPU: " + std::to_string( ::Statistics::GetBloomCpuTimeMS() ) + " ms\n";
                 //str += "bloom GPU: " + std::to_string( ::Statistics::GetBloomGpuTimeMS() ) + " ms\n";
                 str += "queue wait: " + std::to_string( ::Statistics::GetQueueWaitTimeMS() ) + " ms \n";
+                str += "wait previous frame: " + std::to_string( ::Statistics::GetWaitForPreviousFrameProfiling() ) + " ms \n";
                 str += "frustum cull: " + std::to_string( ::Statistics::GetFrustumCullTimeMS() ) + " ms \n";
-                str += "draw calls: " + std::to_string( ::Statistics::GetDrawCalls() ) + "\n";
+                str += "occlusion cull: " + std::to_string( ::Statistics::GetOcclusionCullTimeMS() ) + " ms, " + std::to_string( ::Statistics::GetOcclusionCulledCount() ) + " hidden\n";
+                str += "draw calls: " + std::to_string( ::Statistics::GetDrawCalls() ) + " (" + std::to_string( ::Statistics::GetInstancedDrawCalls() ) + " instanced)\n";
+                str += "uniform upload: " + std::to_string( ::Statistics::GetUniformUploadBytes() / 1024 ) + " KiB (" + std::to_string( ::Statistics::GetUnsplitUniformUploadBytes() / 1024 ) + " KiB unsplit)\n";
                 str += "barrier calls: " + std::to_string( ::Statistics::GetBarrierCalls() ) + "\n";
 				str += "fence calls: " + std::to_string( ::Statistics::GetFenceCalls() ) + "\n";
-				str += "pso changes: " + std::to_string( ::Statistics::GetPSOBindCalls() ) + "\n";
+				str += "pso changes: " + std::to_string( ::Statistics::GetPSOBindCalls() ) + ", shader changes: " + std::to_string( ::Statistics::GetShaderBinds() ) + "\n";
                 str += "queue submit calls: " + std::to_string( ::Statistics::GetQueueSubmitCalls() ) + "\n";
                 str += "mem alloc calls: " + std::to_string( ::Statistics::GetAllocCalls() ) + " (frame), " + std::to_string( ::Statistics::GetTotalAllocCalls() ) + " (total)\n";
                 str += "triangles: " + std::to_string( ::Statistics::GetTriangleCount() ) + "\n";
@@ -332,8 +454,9 @@ namespace ae3d
         AE3D_CHECK_VULKAN( err, "MSAA depth view" );
     }
 
-    void CreatePSO( VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode, ae3d::GfxDevice::DepthFunc depthFunc,
-                    ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, ae3d::GfxDevice::PrimitiveTopology topology, std::uint64_t hash )
+    // Can be called from worker threads, the pipeline cache is internally synchronized.
+    VkPipeline CreatePSO( const VkPipelineVertexInputStateCreateInfo* inputState, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode, ae3d::GfxDevice::DepthFunc depthFunc,
+                          ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, VkSampleCountFlagBits sampleCountBits, ae3d::GfxDevice::PrimitiveTopology topology )
     {
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
         inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -426,12 +549,7 @@ namespace ae3d
         VkPipelineMultisampleStateCreateInfo multisampleState = {};
         multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampleState.pSampleMask = nullptr;
-        multisampleState.rasterizationSamples = GfxDeviceGlobal::msaaSampleBits;
-        
-        if (GfxDeviceGlobal::renderTexture0 && GfxDeviceGlobal::renderTexture0->GetSampleCount() == 1)
-        {
-            multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-        }
+        multisampleState.rasterizationSamples = sampleCountBits;
 
         VkPipelineShaderStageCreateInfo shaderStages[ 2 ] = { shader.GetVertexInfo(), shader.GetFragmentInfo() };
 
@@ -445,7 +563,7 @@ namespace ae3d
         pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         pipelineCreateInfo.layout = GfxDeviceGlobal::pipelineLayout;
         pipelineCreateInfo.renderPass = renderPass != VK_NULL_HANDLE ? renderPass : GfxDeviceGlobal::renderPass;
-        pipelineCreateInfo.pVertexInputState = vertexBuffer.GetInputState();
+        pipelineCreateInfo.pVertexInputState = inputState;
         pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
         pipelineCreateInfo.pRasterizationState = &rasterizationState;
         pipelineCreateInfo.pColorBlendState = &colorBlendState;
@@ -463,7 +581,113 @@ namespace ae3d
         AE3D_CHECK_VULKAN( err, "vkCreateGraphicsPipelines" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pso, VK_OBJECT_TYPE_PIPELINE, "graphics pipeline" );
 
-        GfxDeviceGlobal::psoCache[ hash ] = pso;
+        return pso;
+    }
+
+    // Render textures with the same color format and sample count can share PSOs because their render passes are compatible.
+    std::uint64_t GetRenderPassKey( VkFormat colorFormat, int sampleCount )
+    {
+        return colorFormat == VK_FORMAT_UNDEFINED ? 0 : ((std::uint64_t)colorFormat << 8) | (std::uint64_t)sampleCount;
+    }
+
+    VkSampleCountFlagBits GetPSOSampleCountBits( int sampleCount )
+    {
+        return sampleCount == 1 ? VK_SAMPLE_COUNT_1_BIT : GfxDeviceGlobal::msaaSampleBits;
+    }
+
+    void SavePSOManifest()
+    {
+        if (GfxDeviceGlobal::psoManifest.empty())
+        {
+            return;
+        }
+
+        // PSOs of earlier sessions stay in the manifest, even if this session didn't draw with them.
+        const FileSystem::FileContentsData savedManifest = FileSystem::FileContents( PSOManifestFileName );
+
+        if (savedManifest.isLoaded)
+        {
+            std::vector< PSODesc > savedDescs;
+            ParsePSOManifest( std::string( savedManifest.data.begin(), savedManifest.data.end() ), savedDescs );
+
+            for (const auto& desc : savedDescs)
+            {
+                GfxDeviceGlobal::psoManifest.insert( GetPSOManifestLine( desc ) );
+            }
+        }
+
+        FILE* file = std::fopen( PSOManifestFileName, "wb" );
+
+        if (file == nullptr)
+        {
+            System::Print( "Could not write PSO manifest %s\n", PSOManifestFileName );
+            return;
+        }
+
+        for (const auto& line : GfxDeviceGlobal::psoManifest)
+        {
+            std::fprintf( file, "%s\n", line.c_str() );
+        }
+
+        std::fclose( file );
+    }
+
+    // Returns empty data if there is no cache or it was saved with another GPU or driver.
+    std::vector< unsigned char > LoadPipelineCacheData()
+    {
+        const FileSystem::FileContentsData contents = FileSystem::FileContents( PipelineCacheFileName );
+        std::vector< unsigned char > data;
+        PipelineCacheFileHeader header = {};
+
+        if (!contents.isLoaded || contents.data.size() < sizeof( header ))
+        {
+            return data;
+        }
+
+        std::memcpy( &header, contents.data.data(), sizeof( header ) );
+
+        if (header.magic != PipelineCacheFileMagic || header.dataSize != contents.data.size() - sizeof( header ) ||
+            header.vendorID != GfxDeviceGlobal::properties.vendorID || header.deviceID != GfxDeviceGlobal::properties.deviceID ||
+            header.driverVersion != GfxDeviceGlobal::properties.driverVersion ||
+            std::memcmp( header.pipelineCacheUUID, GfxDeviceGlobal::properties.pipelineCacheUUID, VK_UUID_SIZE ) != 0)
+        {
+            System::Print( "Pipeline cache %s was saved with another GPU or driver, starting with an empty cache.\n", PipelineCacheFileName );
+            return data;
+        }
+
+        data.assign( contents.data.begin() + sizeof( header ), contents.data.end() );
+        return data;
+    }
+
+    void SavePipelineCache()
+    {
+        std::size_t dataSize = 0;
+        VkResult err = vkGetPipelineCacheData( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineCache, &dataSize, nullptr );
+        AE3D_CHECK_VULKAN( err, "vkGetPipelineCacheData" );
+
+        std::vector< unsigned char > data( dataSize );
+        err = vkGetPipelineCacheData( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineCache, &dataSize, data.data() );
+        AE3D_CHECK_VULKAN( err, "vkGetPipelineCacheData" );
+
+        PipelineCacheFileHeader header = {};
+        header.magic = PipelineCacheFileMagic;
+        header.dataSize = (std::uint32_t)dataSize;
+        header.vendorID = GfxDeviceGlobal::properties.vendorID;
+        header.deviceID = GfxDeviceGlobal::properties.deviceID;
+        header.driverVersion = GfxDeviceGlobal::properties.driverVersion;
+        std::memcpy( header.pipelineCacheUUID, GfxDeviceGlobal::properties.pipelineCacheUUID, VK_UUID_SIZE );
+
+        FILE* file = std::fopen( PipelineCacheFileName, "wb" );
+
+        if (file == nullptr)
+        {
+            System::Print( "Could not write pipeline cache %s\n", PipelineCacheFileName );
+            return;
+        }
+
+        std::fwrite( &header, sizeof( header ), 1, file );
+        std::fwrite( data.data(), 1, dataSize, file );
+        std::fclose( file );
     }
 
     void AllocateCommandBuffers()
@@ -476,89 +700,135 @@ namespace ae3d
         commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         commandBufferAllocateInfo.commandPool = GfxDeviceGlobal::cmdPool;
         commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        commandBufferAllocateInfo.commandBufferCount = GfxDeviceGlobal::swapchainBuffers.count;
-
-        VkResult err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, GfxDeviceGlobal::drawCmdBuffers );
-        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
-
-        for (unsigned i = 0; i < GfxDeviceGlobal::swapchainBuffers.count; ++i)
-        {
-            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::drawCmdBuffers[ i ], VK_OBJECT_TYPE_COMMAND_BUFFER, "drawCmdBuffer" );
-        }
-        
         commandBufferAllocateInfo.commandBufferCount = 1;
 
-        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &GfxDeviceGlobal::postPresentCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::postPresentCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "postPresentCmdBuffer" );
-
-        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &GfxDeviceGlobal::prePresentCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::prePresentCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "prePresentCmdBuffer" );
+        VkResult err = VK_SUCCESS;
 
-        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &GfxDeviceGlobal::offscreenCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "Offscreen command buffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::offscreenCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "offscreenCmdBuffer" );
+        for (auto& frame : GfxDeviceGlobal::frames)
+        {
+            err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &frame.drawCmdBuffer );
+            AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
+            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)frame.drawCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "drawCmdBuffer" );
 
-        VkCommandBufferAllocateInfo computeBufAllocateInfo = {};
-        computeBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        computeBufAllocateInfo.commandPool = GfxDeviceGlobal::cmdPool;
-        computeBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        computeBufAllocateInfo.commandBufferCount = 1;
+            err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &frame.postPresentCmdBuffer );
+            AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
+            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)frame.postPresentCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "postPresentCmdBuffer" );
 
-        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &computeBufAllocateInfo, &GfxDeviceGlobal::computeCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::computeCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "computeCmdBuffer" );
+            err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &frame.prePresentCmdBuffer );
+            AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
+            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)frame.prePresentCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "prePresentCmdBuffer" );
+        }
     }
 
-    void SubmitPrePresentBarrier()
+    /// Records the barriers that are submitted before and after the frame's draw commands. Needs the acquired swapchain image.
+    void RecordPresentBarriers()
     {
+        FrameResources& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
         VkCommandBufferBeginInfo cmdBufInfo = {};
         cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-        VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::prePresentCmdBuffer, &cmdBufInfo );
+        VkResult err = vkBeginCommandBuffer( frame.postPresentCmdBuffer, &cmdBufInfo );
         AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
 
-        SetImageLayout( GfxDeviceGlobal::prePresentCmdBuffer, GfxDeviceGlobal::swapchainBuffers[ GfxDeviceGlobal::currentBuffer ].image, VK_IMAGE_ASPECT_COLOR_BIT,
+        SetImageLayout( frame.postPresentCmdBuffer, GfxDeviceGlobal::swapchainBuffers[ GfxDeviceGlobal::currentBuffer ].image, VK_IMAGE_ASPECT_COLOR_BIT,
+                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1, 0, 1 );
+
+        err = vkEndCommandBuffer( frame.postPresentCmdBuffer );
+        AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
+
+        err = vkBeginCommandBuffer( frame.prePresentCmdBuffer, &cmdBufInfo );
+        AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+
+        SetImageLayout( frame.prePresentCmdBuffer, GfxDeviceGlobal::swapchainBuffers[ GfxDeviceGlobal::currentBuffer ].image, VK_IMAGE_ASPECT_COLOR_BIT,
                         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 1, 0, 1 );
 
-        err = vkEndCommandBuffer( GfxDeviceGlobal::prePresentCmdBuffer );
+        err = vkEndCommandBuffer( frame.prePresentCmdBuffer );
         AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
+    }
 
-        VkSubmitInfo submitInfo = {};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &GfxDeviceGlobal::prePresentCmdBuffer;
+    void DestroyReleasedObjects( std::vector< std::pair< std::uint64_t, VkObjectType > >& objects )
+    {
+        for (const auto& object : objects)
+        {
+            switch (object.second)
+            {
+            case VK_OBJECT_TYPE_BUFFER:
+                vkDestroyBuffer( GfxDeviceGlobal::device, (VkBuffer)object.first, nullptr );
+                break;
+            case VK_OBJECT_TYPE_BUFFER_VIEW:
+                vkDestroyBufferView( GfxDeviceGlobal::device, (VkBufferView)object.first, nullptr );
+                break;
+            case VK_OBJECT_TYPE_IMAGE:
+                vkDestroyImage( GfxDeviceGlobal::device, (VkImage)object.first, nullptr );
+                break;
+            case VK_OBJECT_TYPE_IMAGE_VIEW:
+                vkDestroyImageView( GfxDeviceGlobal::device, (VkImageView)object.first, nullptr );
+                break;
+            case VK_OBJECT_TYPE_SAMPLER:
+                vkDestroySampler( GfxDeviceGlobal::device, (VkSampler)object.first, nullptr );
+                break;
+            case VK_OBJECT_TYPE_DEVICE_MEMORY:
+                vkFreeMemory( GfxDeviceGlobal::device, (VkDeviceMemory)object.first, nullptr );
+                break;
+            case VK_OBJECT_TYPE_PIPELINE:
+                vkDestroyPipeline( GfxDeviceGlobal::device, (VkPipeline)object.first, nullptr );
+                break;
+            case VK_OBJECT_TYPE_FRAMEBUFFER:
+                vkDestroyFramebuffer( GfxDeviceGlobal::device, (VkFramebuffer)object.first, nullptr );
+                break;
+            default:
+                System::Assert( false, "unhandled released object type" );
+            }
+        }
 
-        err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
-        AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
-        Statistics::IncQueueSubmitCalls();
+        objects.clear();
     }
 
-    void SubmitPostPresentBarrier()
+    /// Reads the timestamps of the offscreen passes that were recorded into the frame's slot earlier. The GPU must have finished the frame.
+    void ReadPassTimestamps( FrameResources& frame, unsigned frameSlot )
     {
-        VkCommandBufferBeginInfo cmdBufInfo = {};
-        cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+#ifndef DISABLE_TIMESTAMPS
+        if (frame.timedPassCount == 0)
+        {
+            return;
+        }
 
-        VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::postPresentCmdBuffer, &cmdBufInfo );
-        AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+        std::uint64_t timestamps[ TimestampQueriesPerFrame ] = {};
+        const VkResult err = vkGetQueryPoolResults( GfxDeviceGlobal::device, GfxDeviceGlobal::queryPool, frameSlot * TimestampQueriesPerFrame, frame.timedPassCount * 2,
+                                                    sizeof( timestamps ), timestamps, sizeof( std::uint64_t ), VK_QUERY_RESULT_64_BIT );
 
-        SetImageLayout( GfxDeviceGlobal::postPresentCmdBuffer, GfxDeviceGlobal::swapchainBuffers[ GfxDeviceGlobal::currentBuffer ].image, VK_IMAGE_ASPECT_COLOR_BIT,
-                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1, 0, 1 );
+        // Profiler indices: 0 = depth and normals, 1 = shadow maps, 2 = primary pass.
+        float passTimesMS[ 3 ] = {};
+        bool isPassTimed[ 3 ] = {};
 
-        err = vkEndCommandBuffer( GfxDeviceGlobal::postPresentCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
+        for (unsigned passIndex = 0; passIndex < frame.timedPassCount && err == VK_SUCCESS; ++passIndex)
+        {
+            const int profilerIndex = frame.timedPassProfilerIndices[ passIndex ];
+
+            if (profilerIndex >= 0 && profilerIndex < 3)
+            {
+                passTimesMS[ profilerIndex ] += (timestamps[ passIndex * 2 + 1 ] - timestamps[ passIndex * 2 ]) * GfxDeviceGlobal::properties.limits.timestampPeriod * 1e-6f;
+                isPassTimed[ profilerIndex ] = true;
+            }
+        }
 
-        VkSubmitInfo submitPostInfo = {};
-        submitPostInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitPostInfo.commandBufferCount = 1;
-        submitPostInfo.pCommandBuffers = &GfxDeviceGlobal::postPresentCmdBuffer;
+        if (isPassTimed[ 0 ])
+        {
+            Statistics::SetDepthNormalsGpuTime( passTimesMS[ 0 ] );
+        }
 
-        err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitPostInfo, VK_NULL_HANDLE );
-        AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
-        Statistics::IncQueueSubmitCalls();
+        if (isPassTimed[ 1 ])
+        {
+            Statistics::SetShadowMapGpuTime( passTimesMS[ 1 ] );
+        }
 
-        Statistics::EndFrameTimeProfiling();
+        if (isPassTimed[ 2 ])
+        {
+            Statistics::SetPrimaryPassGpuTime( passTimesMS[ 2 ] );
+        }
+#endif
+        frame.timedPassCount = 0;
     }
     
     void AllocateSetupCommandBuffer()
@@ -644,15 +914,9 @@ namespace ae3d
 
         std::uint32_t graphicsQueueNodeIndex = UINT32_MAX;
         std::uint32_t presentQueueNodeIndex = UINT32_MAX;
-        std::uint32_t computeQueueNodeIndex = UINT32_MAX;
 
         for (std::uint32_t i = 0; i < queueCount; ++i)
         {
-            if ((queueProps[ i ].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0 && computeQueueNodeIndex == UINT32_MAX)
-            {
-                computeQueueNodeIndex = i;
-            }
-            
             if ((queueProps[ i ].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0)
             {
                 if (graphicsQueueNodeIndex == UINT32_MAX)
@@ -693,13 +957,12 @@ namespace ae3d
             System::Assert( false, "graphics and present queues must have the same index" );
         }
 
-        if (computeQueueNodeIndex == UINT32_MAX)
+        // Compute passes are submitted to the graphics queue, so they are ordered with the frame's draws without waiting on the CPU.
+        if (graphicsQueueNodeIndex != UINT32_MAX && (queueProps[ graphicsQueueNodeIndex ].queueFlags & VK_QUEUE_COMPUTE_BIT) == 0)
         {
-            System::Assert( false, "compute queue not found" );
+            System::Assert( false, "graphics queue doesn't support compute" );
         }
 
-        vkGetDeviceQueue( GfxDeviceGlobal::device, computeQueueNodeIndex, 0, &GfxDeviceGlobal::computeQueue );
-
         GfxDeviceGlobal::queueNodeIndex = graphicsQueueNodeIndex;
 
         std::uint32_t formatCount;
@@ -1332,7 +1595,7 @@ namespace ae3d
 
     void CreateDescriptorPool()
     {
-        const int AE3D_DESCRIPTOR_SETS_COUNT = 5550;
+        const int AE3D_DESCRIPTOR_SETS_COUNT = DescriptorSetsPerFrame * FramesInFlight;
 
         const VkDescriptorPoolSize typeCounts[ descriptorSlotCount ] =
         {
@@ -1352,7 +1615,11 @@ namespace ae3d
             { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
             { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, AE3D_DESCRIPTOR_SETS_COUNT },
             { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT }
+            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT }
         };
 
         VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
@@ -1382,8 +1649,10 @@ namespace ae3d
 
     VkDescriptorSet AllocateDescriptorSet( const VkDescriptorBufferInfo& uboDesc, const VkImageView& view0, VkSampler sampler0, const VkImageView& view1, VkSampler sampler1, const VkImageView& view2, const VkImageView& view3, const VkImageView& view4, const VkImageView& view14 )
     {
+        // Sets of frames in flight are not rewritten, so the index wraps inside the current frame's range.
         VkDescriptorSet outDescriptorSet = GfxDeviceGlobal::descriptorSets[ GfxDeviceGlobal::descriptorSetIndex ];
-        GfxDeviceGlobal::descriptorSetIndex = (GfxDeviceGlobal::descriptorSetIndex + 1) % GfxDeviceGlobal::descriptorSets.count;
+        const unsigned frameStart = GfxDeviceGlobal::frameIndex * DescriptorSetsPerFrame;
+        GfxDeviceGlobal::descriptorSetIndex = frameStart + (GfxDeviceGlobal::descriptorSetIndex - frameStart + 1) % DescriptorSetsPerFrame;
 
         VkDescriptorImageInfo sampler0Desc = {};
         sampler0Desc.sampler = sampler0;
@@ -1481,7 +1750,7 @@ namespace ae3d
         sets[ 8 ].dstSet = outDescriptorSet;
         sets[ 8 ].descriptorCount = 1;
         sets[ 8 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        sets[ 8 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetPointLightBufferView();
+        sets[ 8 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetPointLightBufferView( GfxDeviceGlobal::frameIndex );
         sets[ 8 ].dstBinding = 8;
 
         // Binding 9 : Buffer (UAV)
@@ -1497,7 +1766,7 @@ namespace ae3d
         sets[ 10 ].dstSet = outDescriptorSet;
         sets[ 10 ].descriptorCount = 1;
         sets[ 10 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        sets[ 10 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetPointLightColorBufferView();
+        sets[ 10 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetPointLightColorBufferView( GfxDeviceGlobal::frameIndex );
         sets[ 10 ].dstBinding = 10;
 
         // Binding 11 : Buffer
@@ -1505,7 +1774,7 @@ namespace ae3d
         sets[ 11 ].dstSet = outDescriptorSet;
         sets[ 11 ].descriptorCount = 1;
         sets[ 11 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        sets[ 11 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightBufferView();
+        sets[ 11 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightBufferView( GfxDeviceGlobal::frameIndex );
         sets[ 11 ].dstBinding = 11;
 
 		// Binding 12 : Buffer
@@ -1513,7 +1782,7 @@ namespace ae3d
         sets[ 12 ].dstSet = outDescriptorSet;
         sets[ 12 ].descriptorCount = 1;
         sets[ 12 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        sets[ 12 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightParamsView();
+        sets[ 12 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightParamsView( GfxDeviceGlobal::frameIndex );
         sets[ 12 ].dstBinding = 12;
 
         // Binding 13 : Buffer
@@ -1521,7 +1790,7 @@ namespace ae3d
         sets[ 13 ].dstSet = outDescriptorSet;
         sets[ 13 ].descriptorCount = 1;
         sets[ 13 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        sets[ 13 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightColorBufferView();
+        sets[ 13 ].pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightColorBufferView( GfxDeviceGlobal::frameIndex );
         sets[ 13 ].dstBinding = 13;
 
         VkDescriptorImageInfo sampler14Desc = {};
@@ -1557,6 +1826,38 @@ namespace ae3d
         sets[ 16 ].pTexelBufferView = &particleTileBufferView;
         sets[ 16 ].dstBinding = 16;
 
+        // Binding 17 : Instance buffer.
+        sets[ 17 ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        sets[ 17 ].dstSet = outDescriptorSet;
+        sets[ 17 ].descriptorCount = 1;
+        sets[ 17 ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sets[ 17 ].pBufferInfo = &GfxDeviceGlobal::instanceDesc;
+        sets[ 17 ].dstBinding = 17;
+
+        // Binding 18 : Per-frame uniforms.
+        sets[ 18 ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        sets[ 18 ].dstSet = outDescriptorSet;
+        sets[ 18 ].descriptorCount = 1;
+        sets[ 18 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        sets[ 18 ].pBufferInfo = &GfxDeviceGlobal::perFrameUboDesc;
+        sets[ 18 ].dstBinding = 18;
+
+        // Binding 19 : Material uniforms.
+        sets[ 19 ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        sets[ 19 ].dstSet = outDescriptorSet;
+        sets[ 19 ].descriptorCount = 1;
+        sets[ 19 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        sets[ 19 ].pBufferInfo = &GfxDeviceGlobal::materialUboDesc;
+        sets[ 19 ].dstBinding = 19;
+
+        // Binding 20 : Skinning uniforms.
+        sets[ 20 ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        sets[ 20 ].dstSet = outDescriptorSet;
+        sets[ 20 ].descriptorCount = 1;
+        sets[ 20 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        sets[ 20 ].pBufferInfo = &GfxDeviceGlobal::skinningUboDesc;
+        sets[ 20 ].dstBinding = 20;
+
         vkUpdateDescriptorSets( GfxDeviceGlobal::device, descriptorSlotCount, sets, 0, nullptr );
 
         return outDescriptorSet;
@@ -1668,6 +1969,30 @@ namespace ae3d
         layoutBindings[ 16 ].descriptorCount = 1;
         layoutBindings[ 16 ].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+        // Binding 17 : Instance buffer
+        layoutBindings[ 17 ].binding = 17;
+        layoutBindings[ 17 ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[ 17 ].descriptorCount = 1;
+        layoutBindings[ 17 ].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        // Binding 18 : Per-frame uniforms
+        layoutBindings[ 18 ].binding = 18;
+        layoutBindings[ 18 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        layoutBindings[ 18 ].descriptorCount = 1;
+        layoutBindings[ 18 ].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        // Binding 19 : Material uniforms
+        layoutBindings[ 19 ].binding = 19;
+        layoutBindings[ 19 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        layoutBindings[ 19 ].descriptorCount = 1;
+        layoutBindings[ 19 ].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        // Binding 20 : Skinning uniforms
+        layoutBindings[ 20 ].binding = 20;
+        layoutBindings[ 20 ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        layoutBindings[ 20 ].descriptorCount = 1;
+        layoutBindings[ 20 ].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
         VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
         descriptorLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         descriptorLayout.bindingCount = descriptorSlotCount;
@@ -1685,16 +2010,28 @@ namespace ae3d
         AE3D_CHECK_VULKAN( err, "vkCreatePipelineLayout" );
     }
 
-    void CreateSemaphores()
+    void CreateSemaphoresAndFences()
     {
         VkSemaphoreCreateInfo semaphoreCreateInfo = {};
         semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkResult err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &GfxDeviceGlobal::presentCompleteSemaphore );
-        AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
+        // Signaled, so the first wait for each slot returns immediately.
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (auto& frame : GfxDeviceGlobal::frames)
+        {
+            VkResult err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &frame.imageAcquiredSemaphore );
+            AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
+
+            err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &frame.renderCompleteSemaphore );
+            AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
 
-        err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &GfxDeviceGlobal::renderCompleteSemaphore );
-        AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
+            err = vkCreateFence( GfxDeviceGlobal::device, &fenceCreateInfo, nullptr, &frame.fence );
+            AE3D_CHECK_VULKAN( err, "vkCreateFence" );
+            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)frame.fence, VK_OBJECT_TYPE_FENCE, "frame fence" );
+        }
     }
     
     void CreateRenderer( int samples, bool apiValidation )
@@ -1742,15 +2079,19 @@ namespace ae3d
             CreateFramebufferNonMSAA();
         }
 
+        const std::vector< unsigned char > pipelineCacheData = LoadPipelineCacheData();
+
         VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
         pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        pipelineCacheCreateInfo.initialDataSize = pipelineCacheData.size();
+        pipelineCacheCreateInfo.pInitialData = pipelineCacheData.empty() ? nullptr : pipelineCacheData.data();
         VkResult err = vkCreatePipelineCache( GfxDeviceGlobal::device, &pipelineCacheCreateInfo, nullptr, &GfxDeviceGlobal::pipelineCache );
         AE3D_CHECK_VULKAN( err, "vkCreatePipelineCache" );
 
         FlushSetupCommandBuffer();
         CreateDescriptorSetLayout();
         CreateDescriptorPool();
-        CreateSemaphores();        
+        CreateSemaphoresAndFences();
 
         GfxDevice::SetClearColor( 0, 0, 0 );
         GfxDevice::CreateUniformBuffers();
@@ -1758,7 +2099,7 @@ namespace ae3d
         VkQueryPoolCreateInfo queryPoolInfo = {};
         queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
         queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
-        queryPoolInfo.queryCount = 2;
+        queryPoolInfo.queryCount = TimestampQueriesPerFrame * FramesInFlight;
 
         err = vkCreateQueryPool( GfxDeviceGlobal::device, &queryPoolInfo, nullptr, &GfxDeviceGlobal::queryPool );
         AE3D_CHECK_VULKAN( err, "vkCreateQueryPool" );
@@ -1781,16 +2122,105 @@ namespace ae3d
 
 void BindComputeDescriptorSet()
 {
-    VkDescriptorSet descriptorSet = ae3d::AllocateDescriptorSet( GfxDeviceGlobal::ubos[ GfxDeviceGlobal::currentUbo ].uboDesc, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ],
+    VkDescriptorSet descriptorSet = ae3d::AllocateDescriptorSet( GfxDeviceGlobal::perDrawUboDesc, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ],
                                                                  GfxDeviceGlobal::boundViews[ 1 ], GfxDeviceGlobal::boundSamplers[ 1 ], GfxDeviceGlobal::boundViews[ 2 ], GfxDeviceGlobal::boundViews[ 3 ], GfxDeviceGlobal::boundViews[ 4 ], GfxDeviceGlobal::boundViews[ 14 ] );
 
     vkCmdBindDescriptorSets( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
                              GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, 0, nullptr );
 }
 
-void UploadPerObjectUbo()
+/// \return Mapped memory for a block in the current frame's uniform buffer. outDesc is set to its range.
+std::uint8_t* AllocateUbo( VkDeviceSize size, VkDescriptorBufferInfo& outDesc )
 {
-    std::memcpy( &ae3d::GfxDevice::GetCurrentUbo()[ 0 ], &GfxDeviceGlobal::perObjectUboStruct, sizeof( GfxDeviceGlobal::perObjectUboStruct ) );
+    FrameResources& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    // Blocks of frames in flight are not rewritten, so allocation wraps inside the current frame's buffer.
+    if (GfxDeviceGlobal::uboOffset + size > UboBytesPerFrame)
+    {
+        GfxDeviceGlobal::uboOffset = 0;
+        GfxDeviceGlobal::isPerFrameUboUploaded = false;
+        GfxDeviceGlobal::isMaterialUboUploaded = false;
+        GfxDeviceGlobal::isSkinningUboUploaded = false;
+    }
+
+    outDesc.buffer = frame.uboBuffer;
+    outDesc.offset = GfxDeviceGlobal::uboOffset;
+    outDesc.range = size;
+
+    const VkDeviceSize alignment = GfxDeviceGlobal::uboAlignment;
+    GfxDeviceGlobal::uboOffset = (GfxDeviceGlobal::uboOffset + size + alignment - 1) & ~(alignment - 1);
+
+    return frame.uboData + outDesc.offset;
+}
+
+/// Uploads a block if nothing has been uploaded into it in this frame, or if it differs from the block that was uploaded last.
+void UploadUboIfChanged( const void* block, VkDeviceSize size, void* uploadedBlock, bool& isUploaded, VkDescriptorBufferInfo& desc, int& uploadedBytes )
+{
+    if (isUploaded && std::memcmp( block, uploadedBlock, size ) == 0)
+    {
+        return;
+    }
+
+    std::memcpy( AllocateUbo( size, desc ), block, size );
+    std::memcpy( uploadedBlock, block, size );
+    isUploaded = true;
+    uploadedBytes += (int)size;
+}
+
+/// Writes perObjectUboStruct into the uniform blocks of the next draw or dispatch.
+/// \param isSkinned True if the draw reads bone matrices. Other draws keep the skinning block that was bound last.
+void UploadPerObjectUbo( bool isSkinned )
+{
+    const PerObjectUboStruct& ubo = GfxDeviceGlobal::perObjectUboStruct;
+
+    PerDrawUbo perDraw = {};
+    perDraw.localToClip = ubo.localToClip;
+    perDraw.localToView = ubo.localToView;
+    perDraw.localToWorld = ubo.localToWorld;
+    perDraw.localToShadowClip = ubo.localToShadowClip;
+    perDraw.tex0scaleOffset = ubo.tex0scaleOffset;
+    perDraw.isInstanced = ubo.isInstanced;
+    std::memcpy( GfxDeviceGlobal::perDrawUboData, &perDraw, sizeof( perDraw ) );
+    int uploadedBytes = (int)sizeof( perDraw );
+
+    PerFrameUbo perFrame = {};
+    perFrame.clipToView = ubo.clipToView;
+    perFrame.viewToClip = ubo.viewToClip;
+    perFrame.lightPosition = ubo.lightPosition;
+    perFrame.lightDirection = ubo.lightDirection;
+    perFrame.lightColor = ubo.lightColor;
+    perFrame.lightConeAngleCos = ubo.lightConeAngleCos;
+    perFrame.lightType = ubo.lightType;
+    perFrame.minAmbient = ubo.minAmbient;
+    perFrame.maxNumLightsPerTile = ubo.maxNumLightsPerTile;
+    perFrame.windowWidth = ubo.windowWidth;
+    perFrame.windowHeight = ubo.windowHeight;
+    perFrame.numLights = ubo.numLights;
+    perFrame.particleCount = ubo.particleCount;
+    perFrame.tilesXY = ubo.tilesXY;
+    perFrame.cameraParams = ubo.cameraParams;
+    perFrame.particleColor = ubo.particleColor;
+    perFrame.isVR = ubo.isVR;
+    perFrame.kernelSize = ubo.kernelSize;
+    perFrame.bloomThreshold = ubo.bloomThreshold;
+    perFrame.bloomIntensity = ubo.bloomIntensity;
+    perFrame.particleReset = ubo.particleReset;
+    perFrame.timeStamp = ubo.timeStamp;
+    std::memcpy( perFrame.kernelOffsets, ubo.kernelOffsets, sizeof( perFrame.kernelOffsets ) );
+    UploadUboIfChanged( &perFrame, sizeof( perFrame ), &GfxDeviceGlobal::uploadedPerFrameUbo, GfxDeviceGlobal::isPerFrameUboUploaded, GfxDeviceGlobal::perFrameUboDesc, uploadedBytes );
+
+    MaterialUbo material = {};
+    material.f0 = ubo.f0;
+    material.roughness = ubo.roughness;
+    material.alphaThreshold = ubo.alphaThreshold;
+    UploadUboIfChanged( &material, sizeof( material ), &GfxDeviceGlobal::uploadedMaterialUbo, GfxDeviceGlobal::isMaterialUboUploaded, GfxDeviceGlobal::materialUboDesc, uploadedBytes );
+
+    if (isSkinned)
+    {
+        UploadUboIfChanged( ubo.boneMatrices, sizeof( SkinningUbo ), &GfxDeviceGlobal::uploadedSkinningUbo, GfxDeviceGlobal::isSkinningUboUploaded, GfxDeviceGlobal::skinningUboDesc, uploadedBytes );
+    }
+
+    Statistics::IncUniformUploadBytes( uploadedBytes, (int)sizeof( PerObjectUboStruct ) );
 }
 
 void ae3d::GfxDevice::Init( int width, int height )
@@ -1813,9 +2243,104 @@ void ae3d::GfxDevice::DrawUI( int scX, int scY, int scWidth, int scHeight, int e
 
 void ae3d::GfxDevice::ResetPSOCache()
 {
+    for (auto pso : GfxDeviceGlobal::psoCache)
+    {
+        ReleaseAfterFrame( (std::uint64_t)pso.second.pso, VK_OBJECT_TYPE_PIPELINE );
+    }
+
     GfxDeviceGlobal::psoCache.clear();
 }
 
+unsigned ae3d::GfxDevice::PrewarmPSOs()
+{
+    const FileSystem::FileContentsData manifest = FileSystem::FileContents( PSOManifestFileName );
+
+    if (!manifest.isLoaded)
+    {
+        return 0;
+    }
+
+    struct PSOJob
+    {
+        std::uint64_t hash;
+        Shader* shader;
+        PSODesc desc;
+        VkRenderPass renderPass;
+        VkPipeline pso;
+    };
+
+    // Input states are created here because GetInputState() writes into the vertex buffer.
+    VertexBuffer formatBuffers[ (int)VertexBuffer::VertexFormat::Empty ];
+    const VkPipelineVertexInputStateCreateInfo* inputStates[ (int)VertexBuffer::VertexFormat::Empty ];
+
+    for (int format = 0; format < (int)VertexBuffer::VertexFormat::Empty; ++format)
+    {
+        formatBuffers[ format ].SetInputStateFormat( (VertexBuffer::VertexFormat)format );
+        inputStates[ format ] = formatBuffers[ format ].GetInputState();
+    }
+
+    std::vector< PSOJob > jobs;
+    std::vector< Shader* > shaders;
+    std::vector< PSODesc > descs;
+    ParsePSOManifest( std::string( manifest.data.begin(), manifest.data.end() ), descs );
+
+    for (const auto& desc : descs)
+    {
+        // Shaders and render textures that are not loaded yet, or an MSAA setting that differs from the saving session, get their PSOs when they are drawn.
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+
+        if (desc.colorFormat == VK_FORMAT_UNDEFINED)
+        {
+            if (desc.sampleCount != (unsigned)GfxDeviceGlobal::msaaSampleBits)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            renderPass = GetRenderPassForFormat( (VkFormat)desc.colorFormat, (int)desc.sampleCount );
+
+            if (renderPass == VK_NULL_HANDLE)
+            {
+                continue;
+            }
+        }
+
+        shaders.clear();
+        GetLoadedShaders( desc.vertexShaderPath, desc.fragmentShaderPath, shaders );
+
+        for (Shader* shader : shaders)
+        {
+            const std::uint64_t hash = GetPSOHash( formatBuffers[ desc.vertexFormat ], *shader, (BlendMode)desc.blendMode, (DepthFunc)desc.depthFunc, (CullMode)desc.cullMode,
+                                                   (FillMode)desc.fillMode, GetRenderPassKey( (VkFormat)desc.colorFormat, (int)desc.sampleCount ), (PrimitiveTopology)desc.topology );
+
+            if (GfxDeviceGlobal::psoCache.find( hash ) == std::end( GfxDeviceGlobal::psoCache ))
+            {
+                jobs.push_back( { hash, shader, desc, renderPass, VK_NULL_HANDLE } );
+            }
+        }
+    }
+
+    JobSystem::ParallelFor( (unsigned)jobs.size(), 1, [ &jobs, &inputStates ]( unsigned first, unsigned last )
+    {
+        for (unsigned i = first; i < last; ++i)
+        {
+            const PSODesc& desc = jobs[ i ].desc;
+            jobs[ i ].pso = CreatePSO( inputStates[ desc.vertexFormat ], *jobs[ i ].shader, (BlendMode)desc.blendMode, (DepthFunc)desc.depthFunc, (CullMode)desc.cullMode,
+                                       (FillMode)desc.fillMode, jobs[ i ].renderPass, GetPSOSampleCountBits( (int)desc.sampleCount ), (PrimitiveTopology)desc.topology );
+        }
+    } );
+
+    // Prewarmed PSOs are already in the manifest, so drawing with them doesn't add them again.
+    for (const auto& job : jobs)
+    {
+        GfxDeviceGlobal::psoCache[ job.hash ].pso = job.pso;
+        GfxDeviceGlobal::psoCache[ job.hash ].isInManifest = true;
+    }
+
+    return (unsigned)jobs.size();
+}
+
 void ae3d::GfxDevice::MapUIVertexBuffer( int /*vertexSize*/, int /*indexSize*/, void** outMappedVertices, void** outMappedIndices )
 {
     *outMappedVertices = GfxDeviceGlobal::uiVertices;
@@ -1952,7 +2477,7 @@ void ae3d::GfxDevice::BeginRenderPass()
 
 void ae3d::GfxDevice::EndRenderPass()
 {
-    vkCmdEndRenderPass( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ] );
+    vkCmdEndRenderPass( GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].drawCmdBuffer );
 }
 
 void ae3d::GfxDevice::EndCommandBuffer()
@@ -1963,7 +2488,7 @@ void ae3d::GfxDevice::EndCommandBuffer()
 
 void ae3d::GfxDevice::EndRenderPassAndCommandBuffer()
 {
-    vkCmdEndRenderPass( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ] );
+    vkCmdEndRenderPass( GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].drawCmdBuffer );
 
     VkResult err = vkEndCommandBuffer( GfxDeviceGlobal::currentCmdBuffer );
     AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
@@ -2058,143 +2583,219 @@ static void PrintShaderStatistics( VkPipeline pso )
     }
 }
 
-void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
-                            CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
+namespace ae3d
 {
-    System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
-    System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
-    System::Assert( GfxDeviceGlobal::currentBuffer < GfxDeviceGlobal::swapchainBuffers.count, "invalid draw buffer index" );
-
-    if (GfxDeviceGlobal::boundViews[ 0 ] == VK_NULL_HANDLE || GfxDeviceGlobal::boundSamplers[ 0 ] == VK_NULL_HANDLE)
+    // Draw() and DrawInstanced() set up the per-object UBO and instance buffer before calling this.
+    void DrawInstances( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, GfxDevice::BlendMode blendMode, GfxDevice::DepthFunc depthFunc,
+                        GfxDevice::CullMode cullMode, GfxDevice::FillMode fillMode, GfxDevice::PrimitiveTopology topology, std::uint32_t instanceCount )
     {
-        return;
-    }
+        System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
+        System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
+        System::Assert( GfxDeviceGlobal::currentBuffer < GfxDeviceGlobal::swapchainBuffers.count, "invalid draw buffer index" );
 
-    if (shader.GetVertexInfo().module == VK_NULL_HANDLE || shader.GetFragmentInfo().module == VK_NULL_HANDLE)
-    {
-        return;
-    }
+        if (GfxDeviceGlobal::boundViews[ 0 ] == VK_NULL_HANDLE || GfxDeviceGlobal::boundSamplers[ 0 ] == VK_NULL_HANDLE)
+        {
+            return;
+        }
 
-    if (Statistics::GetDrawCalls() >= (int)GfxDeviceGlobal::descriptorSets.count)
-    {
-        System::Print( "Skipping draw because draw call count %d exceeds descriptor set count %ld \n", Statistics::GetDrawCalls(), GfxDeviceGlobal::descriptorSets.count );
-        return;
-    }
+        if (shader.GetVertexInfo().module == VK_NULL_HANDLE || shader.GetFragmentInfo().module == VK_NULL_HANDLE)
+        {
+            return;
+        }
 
-    const std::uint64_t psoHash = GetPSOHash( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, GfxDeviceGlobal::renderTexture0 ? GfxDeviceGlobal::renderTexture0->GetRenderPass() : VK_NULL_HANDLE, topology );
+        if (Statistics::GetDrawCalls() >= (int)DescriptorSetsPerFrame)
+        {
+            System::Print( "Skipping draw because draw call count %d exceeds descriptor set count %u \n", Statistics::GetDrawCalls(), DescriptorSetsPerFrame );
+            return;
+        }
 
-    if (GfxDeviceGlobal::psoCache.find( psoHash ) == std::end( GfxDeviceGlobal::psoCache ))
-    {
-        CreatePSO( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, GfxDeviceGlobal::renderTexture0 ? GfxDeviceGlobal::renderTexture0->GetRenderPass() : VK_NULL_HANDLE, topology, psoHash );
-    }
+        RenderTexture* renderTexture = GfxDeviceGlobal::renderTexture0;
+        const VkFormat colorFormat = renderTexture ? renderTexture->GetColorFormat() : VK_FORMAT_UNDEFINED;
+        const int sampleCount = renderTexture ? renderTexture->GetSampleCount() : (int)GfxDeviceGlobal::msaaSampleBits;
+        const std::uint64_t psoHash = GetPSOHash( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, GetRenderPassKey( colorFormat, sampleCount ), topology );
+        PSOCacheEntry& psoEntry = GfxDeviceGlobal::psoCache[ psoHash ];
 
-    const unsigned activePointLights = GfxDeviceGlobal::lightTiler.GetPointLightCount();
-    const unsigned activeSpotLights = GfxDeviceGlobal::lightTiler.GetSpotLightCount();
-    const unsigned lightCount = ((activeSpotLights & 0xFFFFu) << 16) | (activePointLights & 0xFFFFu);
+        if (psoEntry.pso == VK_NULL_HANDLE)
+        {
+            psoEntry.pso = CreatePSO( vertexBuffer.GetInputState(), shader, blendMode, depthFunc, cullMode, fillMode, renderTexture ? renderTexture->GetRenderPass() : VK_NULL_HANDLE,
+                                      GetPSOSampleCountBits( sampleCount ), topology );
+        }
 
-    GfxDeviceGlobal::perObjectUboStruct.windowWidth = GfxDevice::backBufferWidth;
-    GfxDeviceGlobal::perObjectUboStruct.windowHeight = GfxDevice::backBufferHeight;
-    GfxDeviceGlobal::perObjectUboStruct.numLights = lightCount;
-    GfxDeviceGlobal::perObjectUboStruct.maxNumLightsPerTile = GfxDeviceGlobal::lightTiler.GetMaxNumLightsPerTile();
-    GfxDeviceGlobal::perObjectUboStruct.tilesXY.x = (float)GfxDeviceGlobal::lightTiler.GetNumTilesX();
-    GfxDeviceGlobal::perObjectUboStruct.tilesXY.y = (float)GfxDeviceGlobal::lightTiler.GetNumTilesY();
+        if (!psoEntry.isInManifest)
+        {
+            psoEntry.isInManifest = true;
+
+            PSODesc desc;
+            desc.vertexShaderPath = shader.GetVertexShaderPath();
+            desc.fragmentShaderPath = shader.GetFragmentShaderPath();
+            desc.vertexFormat = (unsigned)vertexBuffer.GetVertexFormat();
+            desc.blendMode = (unsigned)blendMode;
+            desc.depthFunc = (unsigned)depthFunc;
+            desc.cullMode = (unsigned)cullMode;
+            desc.fillMode = (unsigned)fillMode;
+            desc.topology = (unsigned)topology;
+            desc.colorFormat = (unsigned)colorFormat;
+            desc.sampleCount = (unsigned)sampleCount;
+            GfxDeviceGlobal::psoManifest.insert( GetPSOManifestLine( desc ) );
+        }
 
-    UploadPerObjectUbo();
+        const unsigned activePointLights = GfxDeviceGlobal::lightTiler.GetPointLightCount();
+        const unsigned activeSpotLights = GfxDeviceGlobal::lightTiler.GetSpotLightCount();
+        const unsigned lightCount = ((activeSpotLights & 0xFFFFu) << 16) | (activePointLights & 0xFFFFu);
 
-    VkDescriptorSet descriptorSet = AllocateDescriptorSet( GfxDeviceGlobal::ubos[ GfxDeviceGlobal::currentUbo ].uboDesc, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ], GfxDeviceGlobal::boundViews[ 1 ],
-                                                           GfxDeviceGlobal::boundSamplers[ 1 ], GfxDeviceGlobal::boundViews[ 2 ], GfxDeviceGlobal::boundViews[ 3 ], GfxDeviceGlobal::boundViews[ 4 ], GfxDeviceGlobal::boundViews[ 14 ] );
+        GfxDeviceGlobal::perObjectUboStruct.windowWidth = GfxDevice::backBufferWidth;
+        GfxDeviceGlobal::perObjectUboStruct.windowHeight = GfxDevice::backBufferHeight;
+        GfxDeviceGlobal::perObjectUboStruct.numLights = lightCount;
+        GfxDeviceGlobal::perObjectUboStruct.maxNumLightsPerTile = GfxDeviceGlobal::lightTiler.GetMaxNumLightsPerTile();
+        GfxDeviceGlobal::perObjectUboStruct.tilesXY.x = (float)GfxDeviceGlobal::lightTiler.GetNumTilesX();
+        GfxDeviceGlobal::perObjectUboStruct.tilesXY.y = (float)GfxDeviceGlobal::lightTiler.GetNumTilesY();
 
-    vkCmdBindDescriptorSets( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                             GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, 0, nullptr );
+        UploadPerObjectUbo( vertexBuffer.GetVertexFormat() == VertexBuffer::VertexFormat::PTNTC_Skinned );
 
-    VkPipeline pso = GfxDeviceGlobal::psoCache[ psoHash ];
-    
-    if (GfxDeviceGlobal::cachedPSO != pso)
-    {
-        GfxDeviceGlobal::cachedPSO = pso;
-        vkCmdBindPipeline( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pso );
-        Statistics::IncPSOBindCalls();
-    }
+        VkDescriptorSet descriptorSet = AllocateDescriptorSet( GfxDeviceGlobal::perDrawUboDesc, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ], GfxDeviceGlobal::boundViews[ 1 ],
+                                                               GfxDeviceGlobal::boundSamplers[ 1 ], GfxDeviceGlobal::boundViews[ 2 ], GfxDeviceGlobal::boundViews[ 3 ], GfxDeviceGlobal::boundViews[ 4 ], GfxDeviceGlobal::boundViews[ 14 ] );
 
-    VkDeviceSize offsets[ 1 ] = { 0 };
-    vkCmdBindVertexBuffers( GfxDeviceGlobal::currentCmdBuffer, VertexBuffer::VERTEX_BUFFER_BIND_ID, 1, vertexBuffer.GetVertexBuffer(), offsets );
+        vkCmdBindDescriptorSets( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, 0, nullptr );
 
-    if (topology == PrimitiveTopology::Triangles)
-    {
-        vkCmdBindIndexBuffer( GfxDeviceGlobal::currentCmdBuffer, *vertexBuffer.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT16 );
-        vkCmdDrawIndexed( GfxDeviceGlobal::currentCmdBuffer, (endIndex - startIndex) * 3, 1, startIndex * 3, 0, 0 );
+        VkPipeline pso = psoEntry.pso;
+
+        if (GfxDeviceGlobal::cachedPSO != pso)
+        {
+            GfxDeviceGlobal::cachedPSO = pso;
+            vkCmdBindPipeline( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pso );
+            Statistics::IncPSOBindCalls();
+        }
+
+        vertexBuffer.SelectFrameSlot( GfxDeviceGlobal::frameIndex );
+        VkDeviceSize offsets[ 1 ] = { 0 };
+        vkCmdBindVertexBuffers( GfxDeviceGlobal::currentCmdBuffer, VertexBuffer::VERTEX_BUFFER_BIND_ID, 1, vertexBuffer.GetVertexBuffer(), offsets );
+
+        if (topology == GfxDevice::PrimitiveTopology::Triangles)
+        {
+            vkCmdBindIndexBuffer( GfxDeviceGlobal::currentCmdBuffer, *vertexBuffer.GetIndexBuffer(), 0, vertexBuffer.GetIndexType() == VertexBuffer::IndexType::UInt32 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16 );
+            vkCmdDrawIndexed( GfxDeviceGlobal::currentCmdBuffer, (endIndex - startIndex) * 3, instanceCount, startIndex * 3, 0, 0 );
+        }
+        else if (topology == GfxDevice::PrimitiveTopology::Lines)
+        {
+            vkCmdDraw( GfxDeviceGlobal::currentCmdBuffer, (endIndex - startIndex) * 3, instanceCount, startIndex * 3, 0 );
+        }
+
+        Statistics::IncTriangleCount( (endIndex - startIndex) * (int)instanceCount );
+        Statistics::IncDrawCalls();
+
+        GfxDeviceGlobal::boundViews[ 4 ] = TextureCube::GetDefaultTexture()->GetView();
     }
-    else if (topology == PrimitiveTopology::Lines)
+}
+
+void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
+                            CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
+{
+    GfxDeviceGlobal::perObjectUboStruct.isInstanced = 0;
+    GfxDeviceGlobal::instanceDesc.offset = 0;
+    DrawInstances( vertexBuffer, startIndex, endIndex, shader, blendMode, depthFunc, cullMode, fillMode, topology, 1 );
+}
+
+void ae3d::GfxDevice::DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
+                                     CullMode cullMode, FillMode fillMode, const InstanceData* instances, unsigned instanceCount )
+{
+    System::Assert( shader.IsInstancingSupported(), "shader doesn't read instance data" );
+    System::Assert( instanceCount <= MaxInstancesPerDraw, "too many instances" );
+
+    if (GfxDeviceGlobal::instanceCount + instanceCount > MaxInstancesPerFrame)
     {
-        vkCmdDraw( GfxDeviceGlobal::currentCmdBuffer, (endIndex - startIndex) * 3, 1, startIndex * 3, 0 );
+        System::Print( "Skipping draw because instance count %u exceeds instance buffer size %u\n", GfxDeviceGlobal::instanceCount + instanceCount, MaxInstancesPerFrame );
+        return;
     }
 
-    Statistics::IncTriangleCount( endIndex - startIndex );
-    Statistics::IncDrawCalls();
-
-    GfxDeviceGlobal::boundViews[ 4 ] = TextureCube::GetDefaultTexture()->GetView();
+    // The instance buffer is only written by the CPU and a frame's range is not reused until the frame has finished, so the draw can read it without barriers.
+    // Offsets are multiples of sizeof( InstanceData ), which is 256 bytes, the largest minStorageBufferOffsetAlignment allowed.
+    const unsigned firstInstance = GfxDeviceGlobal::frameIndex * (MaxInstancesPerFrame + MaxInstancesPerDraw) + GfxDeviceGlobal::instanceCount;
+    std::memcpy( GfxDeviceGlobal::instanceData + firstInstance, instances, instanceCount * sizeof( InstanceData ) );
+    GfxDeviceGlobal::instanceDesc.offset = firstInstance * sizeof( InstanceData );
+    GfxDeviceGlobal::instanceCount += instanceCount;
+
+    // cbPerDraw's (binding 7) matrices are the first instance's, so shaders that don't read the instance buffer draw it like a non-instanced draw.
+    GfxDeviceGlobal::perObjectUboStruct.localToClip = instances[ 0 ].localToClip;
+    GfxDeviceGlobal::perObjectUboStruct.localToView = instances[ 0 ].localToView;
+    GfxDeviceGlobal::perObjectUboStruct.localToWorld = instances[ 0 ].localToWorld;
+    GfxDeviceGlobal::perObjectUboStruct.localToShadowClip = instances[ 0 ].localToShadowClip;
+    GfxDeviceGlobal::perObjectUboStruct.isInstanced = 1;
+
+    DrawInstances( vertexBuffer, startIndex, endIndex, shader, blendMode, depthFunc, cullMode, fillMode, PrimitiveTopology::Triangles, instanceCount );
+    Statistics::IncInstancedDrawCalls();
+
+    GfxDeviceGlobal::perObjectUboStruct.isInstanced = 0;
+    GfxDeviceGlobal::instanceDesc.offset = 0;
 }
 
 void ae3d::GfxDevice::GetNewUniformBuffer()
 {
-    GfxDeviceGlobal::currentUbo = (GfxDeviceGlobal::currentUbo + 1) % GfxDeviceGlobal::ubos.count;
+    GfxDeviceGlobal::perDrawUboData = AllocateUbo( sizeof( PerDrawUbo ), GfxDeviceGlobal::perDrawUboDesc );
 }
 
 void ae3d::GfxDevice::CreateUniformBuffers()
 {
-    GfxDeviceGlobal::ubos.Allocate( 1800 );
-
-    for (unsigned uboIndex = 0; uboIndex < GfxDeviceGlobal::ubos.count; ++uboIndex)
-    {
-        auto& ubo = GfxDeviceGlobal::ubos[ uboIndex ];
+    static_assert( sizeof( PerDrawUbo ) == 288 && sizeof( PerFrameUbo ) == 544 && sizeof( MaterialUbo ) == 16 && sizeof( SkinningUbo ) == 80 * 64,
+                   "Uniform block sizes must match ubo.h" );
 
-        const VkDeviceSize uboSize = 256 * 3 + 80 * 64 + 128 * 16;
-        static_assert( uboSize >= sizeof( PerObjectUboStruct ), "UBO size must be larger than UBO struct" );
+    GfxDeviceGlobal::uboAlignment = GfxDeviceGlobal::properties.limits.minUniformBufferOffsetAlignment;
 
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = uboSize;
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    // Each frame's uniform blocks are in one buffer, so they don't need an allocation each.
+    for (unsigned frameIndex = 0; frameIndex < FramesInFlight; ++frameIndex)
+    {
+        FrameResources& frame = GfxDeviceGlobal::frames[ frameIndex ];
+        CreateBuffer( frame.uboBuffer, (int)UboBytesPerFrame, frame.uboMemory, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "ubo" );
 
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &ubo.ubo );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer UBO" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)ubo.ubo, VK_OBJECT_TYPE_BUFFER, "ubo" );
+        VkResult err = vkMapMemory( GfxDeviceGlobal::device, frame.uboMemory, 0, UboBytesPerFrame, 0, (void **)&frame.uboData );
+        AE3D_CHECK_VULKAN( err, "vkMapMemory UBO" );
+    }
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, ubo.ubo, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &ubo.uboMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory UBO" );
-        Statistics::IncTotalAllocCalls();
-        Statistics::IncAllocCalls();
+    static_assert( sizeof( InstanceData ) == 256, "Instance data size must match ubo.h and be a multiple of minStorageBufferOffsetAlignment" );
 
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, ubo.ubo, ubo.uboMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory UBO" );
+    // Each frame in flight has a range that has room for a full draw after the last offset, so every draw can bind the same range size.
+    const VkDeviceSize instanceBufferSize = (MaxInstancesPerFrame + MaxInstancesPerDraw) * FramesInFlight * sizeof( InstanceData );
+    CreateBuffer( GfxDeviceGlobal::instanceBuffer, (int)instanceBufferSize, GfxDeviceGlobal::instanceMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "instanceBuffer" );
 
-        ubo.uboDesc.buffer = ubo.ubo;
-        ubo.uboDesc.offset = 0;
-        ubo.uboDesc.range = uboSize;
+    VkResult err = vkMapMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::instanceMemory, 0, instanceBufferSize, 0, (void **)&GfxDeviceGlobal::instanceData );
+    AE3D_CHECK_VULKAN( err, "vkMapMemory instance buffer" );
 
-        err = vkMapMemory( GfxDeviceGlobal::device, ubo.uboMemory, 0, uboSize, 0, (void **)&ubo.uboData );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory UBO" );
-    }
+    GfxDeviceGlobal::instanceDesc.buffer = GfxDeviceGlobal::instanceBuffer;
+    GfxDeviceGlobal::instanceDesc.offset = 0;
+    GfxDeviceGlobal::instanceDesc.range = MaxInstancesPerDraw * sizeof( InstanceData );
 }
 
 std::uint8_t* ae3d::GfxDevice::GetCurrentUbo()
 {
-    return GfxDeviceGlobal::ubos[ GfxDeviceGlobal::currentUbo ].uboData;
+    return GfxDeviceGlobal::perDrawUboData;
+}
+
+int ae3d::GfxDevice::GetCurrentUboBytes()
+{
+    return sizeof( PerDrawUbo );
 }
 
 void ae3d::GfxDevice::BeginFrame()
 {
     ae3d::System::Assert( acquireNextImageKHR != nullptr, "function pointers not loaded" );
     ae3d::System::Assert( GfxDeviceGlobal::swapChain != VK_NULL_HANDLE, "swap chain not initialized" );
-    
-    VkResult err = acquireNextImageKHR( GfxDeviceGlobal::device, GfxDeviceGlobal::swapChain, UINT64_MAX, GfxDeviceGlobal::presentCompleteSemaphore, (VkFence)nullptr, &GfxDeviceGlobal::currentBuffer );
+
+    FrameResources& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    // Waits for the frame that was recorded into this slot FramesInFlight frames ago, the later ones can still run on the GPU.
+    Statistics::BeginWaitForPreviousFrameProfiling();
+    VkResult err = vkWaitForFences( GfxDeviceGlobal::device, 1, &frame.fence, VK_TRUE, UINT64_MAX );
+    Statistics::EndWaitForPreviousFrameProfiling();
+    AE3D_CHECK_VULKAN( err, "vkWaitForFences" );
+
+    DestroyReleasedObjects( frame.releasedObjects );
+    ReadPassTimestamps( frame, GfxDeviceGlobal::frameIndex );
+    frame.offscreenPassCount = 0;
+    frame.computePassCount = 0;
+
+    err = acquireNextImageKHR( GfxDeviceGlobal::device, GfxDeviceGlobal::swapChain, UINT64_MAX, frame.imageAcquiredSemaphore, (VkFence)nullptr, &GfxDeviceGlobal::currentBuffer );
 
     if (err == VK_TIMEOUT)
     {
@@ -2203,10 +2804,20 @@ void ae3d::GfxDevice::BeginFrame()
 
     AE3D_CHECK_VULKAN( err, "acquireNextImage" );
 
-    GfxDeviceGlobal::currentCmdBuffer = GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ];
+    GfxDeviceGlobal::currentCmdBuffer = frame.drawCmdBuffer;
     GfxDeviceGlobal::cachedPSO = VK_NULL_HANDLE;
-    
-    SubmitPostPresentBarrier();
+    GfxDeviceGlobal::instanceCount = 0;
+    GfxDeviceGlobal::uboOffset = 0;
+    GfxDeviceGlobal::isPerFrameUboUploaded = false;
+    GfxDeviceGlobal::isMaterialUboUploaded = false;
+    GfxDeviceGlobal::isSkinningUboUploaded = false;
+    GetNewUniformBuffer();
+    // Draws that are not skinned still need a valid range at binding 20.
+    GfxDeviceGlobal::skinningUboDesc = { frame.uboBuffer, 0, sizeof( SkinningUbo ) };
+    GfxDeviceGlobal::descriptorSetIndex = GfxDeviceGlobal::frameIndex * DescriptorSetsPerFrame;
+
+    RecordPresentBarriers();
+    Statistics::EndFrameTimeProfiling();
 
     GfxDeviceGlobal::boundViews[ 0 ] = Texture2D::GetDefaultTexture()->GetView();
     GfxDeviceGlobal::boundViews[ 1 ] = Texture2D::GetDefaultTexture()->GetView();
@@ -2219,60 +2830,80 @@ void ae3d::GfxDevice::BeginFrame()
     GfxDeviceGlobal::boundSamplers[ 1 ] = GfxDeviceGlobal::linearRepeat;
 }
 
+// Submits the frame's draw commands between the present barriers. The frame's fence is signaled when they have finished.
 void SubmitQueue()
 {
-    VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    FrameResources& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+    const VkCommandBuffer commandBuffers[ 3 ] = { frame.postPresentCmdBuffer, frame.drawCmdBuffer, frame.prePresentCmdBuffer };
+    VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.pWaitDstStageMask = &pipelineStages;
     submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &GfxDeviceGlobal::presentCompleteSemaphore;
+    submitInfo.pWaitSemaphores = &frame.imageAcquiredSemaphore;
     submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &GfxDeviceGlobal::renderCompleteSemaphore;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ];
+    submitInfo.pSignalSemaphores = &frame.renderCompleteSemaphore;
+    submitInfo.commandBufferCount = 3;
+    submitInfo.pCommandBuffers = commandBuffers;
+
+    // Reset here instead of in BeginFrame, so a frame that was begun but not submitted doesn't leave the fence unsignaled.
+    VkResult err = vkResetFences( GfxDeviceGlobal::device, 1, &frame.fence );
+    AE3D_CHECK_VULKAN( err, "vkResetFences" );
 
-    VkResult err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
+    err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, frame.fence );
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
     Statistics::IncQueueSubmitCalls();
+
+    // Objects released since the previous submit can be used by this frame, so they are destroyed after it.
+    std::swap( frame.releasedObjects, GfxDeviceGlobal::releasedObjects );
+}
+
+/// Waits until the GPU has finished the frame that was last recorded into the current frame slot, so the slot's copies of
+/// CPU-written buffers can be rewritten. BeginFrame has already waited for it, so this only blocks when called between Present and BeginFrame.
+/// \return Current frame slot.
+unsigned WaitForFrameSlot()
+{
+    FrameResources& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    if (vkGetFenceStatus( GfxDeviceGlobal::device, frame.fence ) == VK_NOT_READY)
+    {
+        Statistics::IncFenceCalls();
+        ae3d::System::BeginTimer();
+        const VkResult err = vkWaitForFences( GfxDeviceGlobal::device, 1, &frame.fence, VK_TRUE, UINT64_MAX );
+        Statistics::IncQueueWaitTime( ae3d::System::EndTimer() );
+        AE3D_CHECK_VULKAN( err, "vkWaitForFences" );
+    }
+
+    return GfxDeviceGlobal::frameIndex;
+}
+
+void ae3d::ReleaseAfterFrame( std::uint64_t object, VkObjectType objectType )
+{
+    if (object != 0)
+    {
+        GfxDeviceGlobal::releasedObjects.push_back( std::make_pair( object, objectType ) );
+    }
 }
 
 void ae3d::GfxDevice::Present()
 {
     Statistics::BeginPresentTimeProfiling();
-    VkResult err = VK_SUCCESS;
 
 #if AE3D_OPENVR
     VR::SubmitFrame();
 #else
-    VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pWaitDstStageMask = &pipelineStages;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &GfxDeviceGlobal::presentCompleteSemaphore;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &GfxDeviceGlobal::renderCompleteSemaphore;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ];
-
-    err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
-    AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
-    Statistics::IncQueueSubmitCalls();
+    SubmitQueue();
 #endif
 
-    SubmitPrePresentBarrier();
-
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &GfxDeviceGlobal::swapChain;
     presentInfo.pImageIndices = &GfxDeviceGlobal::currentBuffer;
-    presentInfo.pWaitSemaphores = &GfxDeviceGlobal::renderCompleteSemaphore;
+    presentInfo.pWaitSemaphores = &GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].renderCompleteSemaphore;
     presentInfo.waitSemaphoreCount = 1;
-    err = queuePresentKHR( GfxDeviceGlobal::graphicsQueue, &presentInfo );
+    const VkResult err = queuePresentKHR( GfxDeviceGlobal::graphicsQueue, &presentInfo );
 
     if (err == VK_ERROR_OUT_OF_DATE_KHR)
     {
@@ -2281,26 +2912,8 @@ void ae3d::GfxDevice::Present()
 
     AE3D_CHECK_VULKAN( err, "queuePresent" );
 
-    // FIXME: This slows down rendering
-    
-    System::BeginTimer();
-    err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    Statistics::IncQueueWaitTime( System::EndTimer() );
-    AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
-
-    for (unsigned i = 0; i < GfxDeviceGlobal::pendingFreeVBs.count; ++i)
-    {
-        vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::pendingFreeVBs[ i ], nullptr );
-    }
-
-    GfxDeviceGlobal::pendingFreeVBs.Allocate( 0 );
-
-    for (unsigned i = 0; i < GfxDeviceGlobal::pendingFreeMemory.count; ++i)
-    {
-        vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::pendingFreeMemory[ i ], nullptr );
-    }
-    
-    GfxDeviceGlobal::pendingFreeMemory.Allocate( 0 );
+    // The next frame is recorded while the GPU executes this one. BeginFrame waits when the next slot is still in use.
+    GfxDeviceGlobal::frameIndex = (GfxDeviceGlobal::frameIndex + 1) % FramesInFlight;
     Statistics::EndPresentTimeProfiling();
 }
 
@@ -2345,12 +2958,15 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
     vkDestroyBufferView( GfxDeviceGlobal::device, particleTileBufferView, nullptr );
     vkDestroyBuffer( GfxDeviceGlobal::device, particleTileBuffer, nullptr );
 
-    for (unsigned i = 0; i < GfxDeviceGlobal::ubos.count; ++i)
+    for (auto& frame : GfxDeviceGlobal::frames)
     {
-        vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::ubos[ i ].uboMemory, nullptr );
-        vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::ubos[ i ].ubo, nullptr );
+        vkFreeMemory( GfxDeviceGlobal::device, frame.uboMemory, nullptr );
+        vkDestroyBuffer( GfxDeviceGlobal::device, frame.uboBuffer, nullptr );
     }
 
+    vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::instanceMemory, nullptr );
+    vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::instanceBuffer, nullptr );
+
     Shader::DestroyShaders();
     ComputeShader::DestroyShaders();
     Texture2D::DestroyTextures();
@@ -2361,11 +2977,22 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
 
     for (auto pso : GfxDeviceGlobal::psoCache)
     {
-        vkDestroyPipeline( GfxDeviceGlobal::device, pso.second, nullptr );
+        vkDestroyPipeline( GfxDeviceGlobal::device, pso.second.pso, nullptr );
+    }
+
+    DestroyReleasedObjects( GfxDeviceGlobal::releasedObjects );
+
+    for (auto& frame : GfxDeviceGlobal::frames)
+    {
+        DestroyReleasedObjects( frame.releasedObjects );
+        vkDestroySemaphore( GfxDeviceGlobal::device, frame.renderCompleteSemaphore, nullptr );
+        vkDestroySemaphore( GfxDeviceGlobal::device, frame.imageAcquiredSemaphore, nullptr );
+        vkDestroyFence( GfxDeviceGlobal::device, frame.fence, nullptr );
     }
 
-    vkDestroySemaphore( GfxDeviceGlobal::device, GfxDeviceGlobal::renderCompleteSemaphore, nullptr );
-    vkDestroySemaphore( GfxDeviceGlobal::device, GfxDeviceGlobal::presentCompleteSemaphore, nullptr );
+    SavePipelineCache();
+    SavePSOManifest();
+
     vkDestroyPipelineLayout( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineLayout, nullptr );
     vkDestroyPipelineCache( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineCache, nullptr );
     vkDestroySwapchainKHR( GfxDeviceGlobal::device, GfxDeviceGlobal::swapChain, nullptr );
@@ -2377,7 +3004,7 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
 
 void ae3d::GfxDevice::SetRenderTarget( RenderTexture* target, unsigned cubeMapFace )
 {
-    GfxDeviceGlobal::currentCmdBuffer = target ? GfxDeviceGlobal::offscreenCmdBuffer : GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ];
+    GfxDeviceGlobal::currentCmdBuffer = target ? GfxDeviceGlobal::offscreenCmdBuffer : GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].drawCmdBuffer;
     GfxDeviceGlobal::cachedPSO = VK_NULL_HANDLE;
     GfxDeviceGlobal::renderTexture0 = target;
 
@@ -2394,11 +3021,28 @@ void ae3d::GfxDevice::SetRenderTarget( RenderTexture* target, unsigned cubeMapFa
 void BeginOffscreen()
 {
     ae3d::System::Assert( GfxDeviceGlobal::renderTexture0 != nullptr, "Render texture must be set when beginning offscreen rendering" );
-    
-    // FIXME: Use fence instead of queue wait.
-    ae3d::System::BeginTimer();
-    vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    Statistics::IncQueueWaitTime( ae3d::System::EndTimer() );
+
+    // Each pass of the frame gets its own command buffer, so recording doesn't wait for the previous pass to finish.
+    FrameResources& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    if (frame.offscreenPassCount == frame.offscreenCmdBuffers.size())
+    {
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
+        cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufAllocateInfo.commandPool = GfxDeviceGlobal::cmdPool;
+        cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmdBufAllocateInfo.commandBufferCount = 1;
+
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkResult err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &cmdBufAllocateInfo, &cmdBuffer );
+        AE3D_CHECK_VULKAN( err, "Offscreen command buffer" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)cmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "offscreenCmdBuffer" );
+        frame.offscreenCmdBuffers.push_back( cmdBuffer );
+    }
+
+    GfxDeviceGlobal::offscreenCmdBuffer = frame.offscreenCmdBuffers[ frame.offscreenPassCount ];
+    GfxDeviceGlobal::currentCmdBuffer = GfxDeviceGlobal::offscreenCmdBuffer;
+    ++frame.offscreenPassCount;
 
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -2407,8 +3051,13 @@ void BeginOffscreen()
     AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
 
 #ifndef DISABLE_TIMESTAMPS
-    vkCmdResetQueryPool( GfxDeviceGlobal::offscreenCmdBuffer, GfxDeviceGlobal::queryPool, 0, 2 );
-    vkCmdWriteTimestamp( GfxDeviceGlobal::offscreenCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, 0 );
+    // Passes past the frame's query range are not timed. EndOffscreen records which profiler the timestamps belong to.
+    if (frame.timedPassCount < TimestampQueriesPerFrame / 2)
+    {
+        const std::uint32_t firstQuery = GfxDeviceGlobal::frameIndex * TimestampQueriesPerFrame + frame.timedPassCount * 2;
+        vkCmdResetQueryPool( GfxDeviceGlobal::offscreenCmdBuffer, GfxDeviceGlobal::queryPool, firstQuery, 2 );
+        vkCmdWriteTimestamp( GfxDeviceGlobal::offscreenCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, firstQuery );
+    }
 #endif
     
     VkClearValue clearValues[ 2 ];
@@ -2431,8 +3080,18 @@ void BeginOffscreen()
 
 void EndOffscreen( int profilerIndex, ae3d::RenderTexture* target )
 {
-#ifndef DISABLE_TIMESTAMPS    
-    vkCmdWriteTimestamp( GfxDeviceGlobal::offscreenCmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, 1 );
+    FrameResources& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+#ifndef DISABLE_TIMESTAMPS
+    if (frame.timedPassCount < TimestampQueriesPerFrame / 2)
+    {
+        const std::uint32_t firstQuery = GfxDeviceGlobal::frameIndex * TimestampQueriesPerFrame + frame.timedPassCount * 2;
+        vkCmdWriteTimestamp( GfxDeviceGlobal::offscreenCmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, firstQuery + 1 );
+        frame.timedPassProfilerIndices[ frame.timedPassCount ] = profilerIndex;
+        ++frame.timedPassCount;
+    }
+#else
+    (void)profilerIndex;
 #endif
     vkCmdEndRenderPass( GfxDeviceGlobal::offscreenCmdBuffer );
     
@@ -2451,33 +3110,85 @@ void EndOffscreen( int profilerIndex, ae3d::RenderTexture* target )
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &GfxDeviceGlobal::offscreenCmdBuffer;
 
+    // The frame's fence is signaled after the frame's draw commands, which are submitted later, so it covers this pass, too.
+    // Timestamps are read in BeginFrame when the slot is reused, so this doesn't wait for the GPU. The render texture's
+    // render pass has external dependencies that order this pass with the passes that sample the texture before and after it.
     err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
     Statistics::IncQueueSubmitCalls();
 
-#ifndef DISABLE_TIMESTAMPS
-    std::uint64_t timestamps[ 2 ] = {};
-    err = vkGetQueryPoolResults( GfxDeviceGlobal::device, GfxDeviceGlobal::queryPool, 0, 2, sizeof( std::uint64_t ) * 2, timestamps, sizeof( std::uint64_t ), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT );
-    //AE3D_CHECK_VULKAN( err, "vkGetQueryPoolResults" );
-    GfxDeviceGlobal::timings[0] = (timestamps[1] - timestamps[0]) * GfxDeviceGlobal::properties.limits.timestampPeriod * 1e-6f;
-#endif
-    
-    if (profilerIndex == 0)
-    {
-        Statistics::SetDepthNormalsGpuTime( GfxDeviceGlobal::timings[ 0 ] );
-    }
-    else if (profilerIndex == 1)
-    {
-        Statistics::SetShadowMapGpuTime( GfxDeviceGlobal::timings[ 0 ] );
-    }
-    else if (profilerIndex == 2)
+    if (target)
     {
-        Statistics::SetPrimaryPassGpuTime( GfxDeviceGlobal::timings[ 0 ] );
+        target->color.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
+}
 
-    if (target)
+
+void BeginComputePass()
+{
+    // Each compute pass of the frame gets its own command buffer, like offscreen passes, so recording doesn't wait for the previous pass to finish.
+    FrameResources& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    if (frame.computePassCount == frame.computeCmdBuffers.size())
     {
-        target->color.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
+        cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufAllocateInfo.commandPool = GfxDeviceGlobal::cmdPool;
+        cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmdBufAllocateInfo.commandBufferCount = 1;
+
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkResult err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &cmdBufAllocateInfo, &cmdBuffer );
+        AE3D_CHECK_VULKAN( err, "Compute command buffer" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)cmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "computeCmdBuffer" );
+        frame.computeCmdBuffers.push_back( cmdBuffer );
     }
+
+    GfxDeviceGlobal::computeCmdBuffer = frame.computeCmdBuffers[ frame.computePassCount ];
+    ++frame.computePassCount;
+
+    VkCommandBufferBeginInfo cmdBufInfo = {};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::computeCmdBuffer, &cmdBufInfo );
+    AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+
+    // Earlier shader reads and writes of the buffers and storage images that this pass writes, finish before it.
+    // Render texture passes order their attachment writes with this pass in their render pass dependencies.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr );
+    Statistics::IncBarrierCalls();
 }
 
+void EndComputePass()
+{
+    // The pass's writes are visible to the shaders of later passes and the frame's draws.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr );
+    Statistics::IncBarrierCalls();
+
+    VkResult err = vkEndCommandBuffer( GfxDeviceGlobal::computeCmdBuffer );
+    AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &GfxDeviceGlobal::computeCmdBuffer;
+
+    // Submitted to the graphics queue after the offscreen passes it reads, so the barriers order it with them and with the frame's draws.
+    // The frame's fence covers this pass like it covers offscreen passes, so this doesn't wait for the GPU.
+    err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
+    AE3D_CHECK_VULKAN( err, "vkQueueSubmit compute" );
+    Statistics::IncQueueSubmitCalls();
+}
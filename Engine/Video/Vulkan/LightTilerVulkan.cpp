@@ -25,12 +25,59 @@ namespace GfxDeviceGlobal
     extern PerObjectUboStruct perObjectUboStruct;
     extern VkCommandBuffer computeCmdBuffer;
     extern VkDescriptorSetLayout descriptorSetLayout;
-    extern VkQueue computeQueue;
     extern VkImageView boundViews[ ae3d::ComputeShader::SLOT_COUNT ];
     extern VkSampler boundSamplers[ 2 ];
 }
 
-void UploadPerObjectUbo();
+void UploadPerObjectUbo( bool isSkinned );
+unsigned WaitForFrameSlot();
+
+constexpr VkDeviceSize LightBufferBytes = ae3d::LightTiler::MaxLights * 4 * sizeof( float ); // One frame slot's range.
+
+// Creates a mapped buffer that has a range of LightBufferBytes and a view for each frame slot.
+static void CreateLightBuffer( const char* name, VkBuffer& outBuffer, VkDeviceMemory& outMemory, void*& outMappedMemory, VkBufferView* outViews )
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = LightBufferBytes * ae3d::GfxDevice::FramesInFlight;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
+    VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &outBuffer );
+    AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
+    debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)outBuffer, VK_OBJECT_TYPE_BUFFER, name );
+
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, outBuffer, &memReqs );
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memReqs.size;
+    allocInfo.memoryTypeIndex = ae3d::GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+    err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &outMemory );
+    AE3D_CHECK_VULKAN( err, "vkAllocateMemory light buffer" );
+    debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)outMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, name );
+
+    err = vkBindBufferMemory( GfxDeviceGlobal::device, outBuffer, outMemory, 0 );
+    AE3D_CHECK_VULKAN( err, "vkBindBufferMemory light buffer" );
+
+    err = vkMapMemory( GfxDeviceGlobal::device, outMemory, 0, bufferInfo.size, 0, &outMappedMemory );
+    AE3D_CHECK_VULKAN( err, "vkMapMemory light buffer" );
+
+    // LightBufferBytes is a multiple of every device's minTexelBufferOffsetAlignment, which is at most 256.
+    for (unsigned frameSlot = 0; frameSlot < ae3d::GfxDevice::FramesInFlight; ++frameSlot)
+    {
+        VkBufferViewCreateInfo bufferViewInfo = {};
+        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
+        bufferViewInfo.flags = 0;
+        bufferViewInfo.buffer = outBuffer;
+        bufferViewInfo.offset = LightBufferBytes * frameSlot;
+        bufferViewInfo.range = LightBufferBytes;
+        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+
+        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &outViews[ frameSlot ] );
+        AE3D_CHECK_VULKAN( err, "light buffer view" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)outViews[ frameSlot ], VK_OBJECT_TYPE_BUFFER_VIEW, name );
+    }
+}
 
 void ae3d::LightTiler::DestroyBuffers()
 {
@@ -41,11 +88,16 @@ void ae3d::LightTiler::DestroyBuffers()
     vkDestroyBuffer( GfxDeviceGlobal::device, spotLightCenterAndRadiusBuffer, nullptr );
     vkDestroyBuffer( GfxDeviceGlobal::device, spotLightParamsBuffer, nullptr );
     vkDestroyBufferView( GfxDeviceGlobal::device, perTileLightIndexBufferView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, pointLightBufferView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, pointLightColorView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, spotLightColorView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, spotLightBufferView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, spotLightParamsView, nullptr );
+
+    for (unsigned frameSlot = 0; frameSlot < GfxDevice::FramesInFlight; ++frameSlot)
+    {
+        vkDestroyBufferView( GfxDeviceGlobal::device, pointLightBufferViews[ frameSlot ], nullptr );
+        vkDestroyBufferView( GfxDeviceGlobal::device, pointLightColorViews[ frameSlot ], nullptr );
+        vkDestroyBufferView( GfxDeviceGlobal::device, spotLightColorViews[ frameSlot ], nullptr );
+        vkDestroyBufferView( GfxDeviceGlobal::device, spotLightBufferViews[ frameSlot ], nullptr );
+        vkDestroyBufferView( GfxDeviceGlobal::device, spotLightParamsViews[ frameSlot ], nullptr );
+    }
+
     vkFreeMemory( GfxDeviceGlobal::device, perTileLightIndexBufferMemory, nullptr );
     vkFreeMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusMemory, nullptr );
     vkFreeMemory( GfxDeviceGlobal::device, pointLightColorMemory, nullptr );
@@ -96,213 +148,23 @@ void ae3d::LightTiler::Init()
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)perTileLightIndexBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "perTileLightIndexBufferView" );
     }
 
-    // Point light center/radius buffer
-    {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &pointLightCenterAndRadiusBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightCenterAndRadiusBuffer, VK_OBJECT_TYPE_BUFFER, "pointLightCenterAndRadiusBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, pointLightCenterAndRadiusBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &pointLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory pointLightCenterAndRadiusMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightCenterAndRadiusMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "pointLightCenterAndRadiusMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusBuffer, pointLightCenterAndRadiusMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory pointLightCenterAndRadiusBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusMemory, 0, bufferInfo.size, 0, &mappedPointLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory point lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = pointLightCenterAndRadiusBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &pointLightBufferView );
-        AE3D_CHECK_VULKAN( err, "point light buffer view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "pointLightBufferView" );
-    }
-
-    // Point light color buffer
-    {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &pointLightColorBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightColorBuffer, VK_OBJECT_TYPE_BUFFER, "pointLightColorBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, pointLightColorBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &pointLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory pointLightColorMemory" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightColorMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "pointLightColorMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, pointLightColorBuffer, pointLightColorMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory pointLightColorBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, pointLightColorMemory, 0, bufferInfo.size, 0, &mappedPointLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory point lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = pointLightColorBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &pointLightColorView );
-        AE3D_CHECK_VULKAN( err, "point light color view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightColorView, VK_OBJECT_TYPE_BUFFER_VIEW, "pointLightColorView" );
-    }
-
-    // Spot light buffer
-    {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &spotLightCenterAndRadiusBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightCenterAndRadiusBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightCenterAndRadiusBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightCenterAndRadiusBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightCenterAndRadiusMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightCenterAndRadiusMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "spotLightCenterAndRadiusMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightCenterAndRadiusBuffer, spotLightCenterAndRadiusMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightCenterAndRadiusBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightCenterAndRadiusMemory, 0, bufferInfo.size, 0, &mappedSpotLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = spotLightCenterAndRadiusBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &spotLightBufferView );
-        AE3D_CHECK_VULKAN( err, "spot light buffer view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "spotLightBufferView" );
-    }
-
-    // Spot light params buffer
-    {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &spotLightParamsBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightParamsBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightParamsBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightParamsBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightParamsMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightParamsMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightParamsMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "spotLightParamsMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightParamsBuffer, spotLightParamsMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightParamsBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightParamsMemory, 0, bufferInfo.size, 0, &mappedSpotLightParamsMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = spotLightParamsBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &spotLightParamsView );
-        AE3D_CHECK_VULKAN( err, "spot light params buffer view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightParamsView, VK_OBJECT_TYPE_BUFFER_VIEW, "spotLightParamsBufferView" );
-    }
-
-    // Spot light color buffer
-    {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &spotLightColorBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightColorBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightColorBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightColorBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightColorMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightColorMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "spotLightColorMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightColorBuffer, spotLightColorMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightColorBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightColorMemory, 0, bufferInfo.size, 0, &mappedSpotLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = spotLightColorBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &spotLightColorView );
-        AE3D_CHECK_VULKAN( err, "spot light color view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightColorView, VK_OBJECT_TYPE_BUFFER_VIEW, "spotLightColorView" );
-    }
+    CreateLightBuffer( "pointLightCenterAndRadiusBuffer", pointLightCenterAndRadiusBuffer, pointLightCenterAndRadiusMemory, mappedPointLightCenterAndRadiusMemory, pointLightBufferViews );
+    CreateLightBuffer( "pointLightColorBuffer", pointLightColorBuffer, pointLightColorMemory, mappedPointLightColorMemory, pointLightColorViews );
+    CreateLightBuffer( "spotLightCenterAndRadiusBuffer", spotLightCenterAndRadiusBuffer, spotLightCenterAndRadiusMemory, mappedSpotLightCenterAndRadiusMemory, spotLightBufferViews );
+    CreateLightBuffer( "spotLightParamsBuffer", spotLightParamsBuffer, spotLightParamsMemory, mappedSpotLightParamsMemory, spotLightParamsViews );
+    CreateLightBuffer( "spotLightColorBuffer", spotLightColorBuffer, spotLightColorMemory, mappedSpotLightColorMemory, spotLightColorViews );
 }
 
 void ae3d::LightTiler::UpdateLightBuffers()
 {
-    std::memcpy( mappedPointLightCenterAndRadiusMemory, &pointLightCenterAndRadius[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedPointLightColorMemory, &pointLightColors[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightCenterAndRadiusMemory, &spotLightCenterAndRadius[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightParamsMemory, &spotLightParams[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightColorMemory, &spotLightColors[ 0 ], MaxLights * 4 * sizeof( float ) );
+    // Writes the current frame slot's range. Frames in other slots can still read theirs.
+    const VkDeviceSize offset = LightBufferBytes * WaitForFrameSlot();
+
+    std::memcpy( (std::uint8_t*)mappedPointLightCenterAndRadiusMemory + offset, &pointLightCenterAndRadius[ 0 ], LightBufferBytes );
+    std::memcpy( (std::uint8_t*)mappedPointLightColorMemory + offset, &pointLightColors[ 0 ], LightBufferBytes );
+    std::memcpy( (std::uint8_t*)mappedSpotLightCenterAndRadiusMemory + offset, &spotLightCenterAndRadius[ 0 ], LightBufferBytes );
+    std::memcpy( (std::uint8_t*)mappedSpotLightParamsMemory + offset, &spotLightParams[ 0 ], LightBufferBytes );
+    std::memcpy( (std::uint8_t*)mappedSpotLightColorMemory + offset, &spotLightColors[ 0 ], LightBufferBytes );
 }
 
 unsigned ae3d::LightTiler::GetNumTilesX() const
@@ -335,16 +197,17 @@ void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projec
     const unsigned numTiles = GetNumTilesX() * GetNumTilesY();
     const unsigned maxNumLightsPerTile = GetMaxNumLightsPerTile();
 
+    // The previous frame's draws can still read the light indices on the GPU, so they finish before the culler overwrites them.
     VkBufferMemoryBarrier lightIndexToCompute = {};
     lightIndexToCompute.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-    lightIndexToCompute.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+    lightIndexToCompute.srcAccessMask = 0;
     lightIndexToCompute.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
     lightIndexToCompute.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     lightIndexToCompute.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     lightIndexToCompute.buffer = perTileLightIndexBuffer;
     lightIndexToCompute.size = maxNumLightsPerTile * numTiles * sizeof( unsigned );
 
-    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_HOST_BIT,
+    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
                                      nullptr, 1, &lightIndexToCompute, 0, nullptr );
     
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "GfxDevice.hpp"
+#include "VertexBuffer.hpp"
+
+namespace ae3d
+{
+    /// PSO state that stays the same between sessions, so the PSO manifest can refer to it.
+    struct PSODesc
+    {
+        std::string vertexShaderPath;
+        std::string fragmentShaderPath;
+        unsigned vertexFormat = 0;
+        unsigned blendMode = 0;
+        unsigned depthFunc = 0;
+        unsigned cullMode = 0;
+        unsigned fillMode = 0;
+        unsigned topology = 0;
+        unsigned colorFormat = 0; // VK_FORMAT_UNDEFINED means the swapchain's render pass.
+        unsigned sampleCount = 1;
+    };
+
+    /// \return Manifest line of desc, without a newline.
+    inline std::string GetPSOManifestLine( const PSODesc& desc )
+    {
+        char state[ 128 ];
+        std::snprintf( state, sizeof( state ), "%u %u %u %u %u %u %u %u", desc.vertexFormat, desc.blendMode, desc.depthFunc, desc.cullMode,
+                       desc.fillMode, desc.topology, desc.colorFormat, desc.sampleCount );
+        return desc.vertexShaderPath + "\t" + desc.fragmentShaderPath + "\t" + state;
+    }
+
+    /// \param line Line written by GetPSOManifestLine, without a newline.
+    /// \param outDesc Parsed state.
+    /// \return False, if the line is malformed or has a value that is not a valid enum or sample count. A manifest from an older version can have those.
+    inline bool ParsePSOManifestLine( const std::string& line, PSODesc& outDesc )
+    {
+        const std::size_t firstTab = line.find( '\t' );
+        const std::size_t secondTab = firstTab == std::string::npos ? std::string::npos : line.find( '\t', firstTab + 1 );
+
+        if (secondTab == std::string::npos)
+        {
+            return false;
+        }
+
+        outDesc.vertexShaderPath = line.substr( 0, firstTab );
+        outDesc.fragmentShaderPath = line.substr( firstTab + 1, secondTab - firstTab - 1 );
+
+        // Sample counts are VkSampleCountFlagBits, which are powers of two up to 64.
+        return std::sscanf( line.c_str() + secondTab + 1, "%u %u %u %u %u %u %u %u", &outDesc.vertexFormat, &outDesc.blendMode, &outDesc.depthFunc,
+                            &outDesc.cullMode, &outDesc.fillMode, &outDesc.topology, &outDesc.colorFormat, &outDesc.sampleCount ) == 8 &&
+               outDesc.vertexFormat < (unsigned)VertexBuffer::VertexFormat::Empty && outDesc.blendMode <= (unsigned)GfxDevice::BlendMode::Off &&
+               outDesc.depthFunc <= (unsigned)GfxDevice::DepthFunc::NoneWriteOff && outDesc.cullMode <= (unsigned)GfxDevice::CullMode::Off &&
+               outDesc.fillMode <= (unsigned)GfxDevice::FillMode::Wireframe && outDesc.topology <= (unsigned)GfxDevice::PrimitiveTopology::Lines &&
+               outDesc.sampleCount != 0 && outDesc.sampleCount <= 64 && (outDesc.sampleCount & (outDesc.sampleCount - 1)) == 0;
+    }
+
+    /// \param text Manifest file's contents.
+    /// \param outDescs Receives the valid lines' state. Malformed lines are skipped.
+    inline void ParsePSOManifest( const std::string& text, std::vector< PSODesc >& outDescs )
+    {
+        std::size_t lineStart = 0;
+
+        while (lineStart < text.size())
+        {
+            std::size_t lineEnd = text.find( '\n', lineStart );
+            lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd;
+            PSODesc desc;
+
+            if (ParsePSOManifestLine( text.substr( lineStart, lineEnd - lineStart ), desc ))
+            {
+                outDescs.push_back( desc );
+            }
+
+            lineStart = lineEnd + 1;
+        }
+    }
+}
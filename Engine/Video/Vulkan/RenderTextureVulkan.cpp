@@ -22,6 +22,7 @@ namespace GfxDeviceGlobal
     extern VkFormat colorFormat;
     extern VkFormat depthFormat;
     extern VkCommandBuffer currentCmdBuffer;
+    extern VkCommandBuffer texCmdBuffer;
     extern VkSampleCountFlagBits msaaSampleBits;
     extern VkQueue graphicsQueue;
     extern VkPhysicalDevice physicalDevice;
@@ -35,6 +36,29 @@ namespace RenderTextureGlobal
     std::vector< VkDeviceMemory > memoryToReleaseAtExit;
     std::vector< VkFramebuffer > fbsToReleaseAtExit;
     std::vector< VkRenderPass > renderPassesToReleaseAtExit;
+
+    struct RenderPassFormat
+    {
+        VkFormat colorFormat;
+        int sampleCount;
+        VkRenderPass renderPass;
+    };
+
+    std::vector< RenderPassFormat > renderPassFormats;
+}
+
+// Render passes of render textures only differ by color format and sample count, so they are compatible if those match.
+VkRenderPass GetRenderPassForFormat( VkFormat colorFormat, int sampleCount )
+{
+    for (const auto& renderPassFormat : RenderTextureGlobal::renderPassFormats)
+    {
+        if (renderPassFormat.colorFormat == colorFormat && renderPassFormat.sampleCount == sampleCount)
+        {
+            return renderPassFormat.renderPass;
+        }
+    }
+
+    return VK_NULL_HANDLE;
 }
 
 void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
@@ -138,36 +162,40 @@ void* ae3d::RenderTexture::Map()
     region.imageSubresource.layerCount = 1;
     region.imageExtent = { (unsigned)width, (unsigned)height, 1 };
 
+    // The frame that rendered into the texture can still be running, and its command buffers can't be reused until it has finished.
+    vkDeviceWaitIdle( GfxDeviceGlobal::device );
+
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     cmdBufInfo.pInheritanceInfo = nullptr;
     cmdBufInfo.flags = 0;
 
-    VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::currentCmdBuffer, &cmdBufInfo );
+    VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::texCmdBuffer, &cmdBufInfo );
     AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer in RenderTexture::Map()" );
 
-    SetColorImageLayout( VK_IMAGE_LAYOUT_GENERAL, GfxDeviceGlobal::currentCmdBuffer );
-    vkCmdCopyImageToBuffer( GfxDeviceGlobal::currentCmdBuffer, color.image, VK_IMAGE_LAYOUT_GENERAL, pixelBuffer, 1, &region );
-    SetColorImageLayout( VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, GfxDeviceGlobal::currentCmdBuffer );
+    const VkImageLayout oldLayout = color.layout;
+    SetColorImageLayout( VK_IMAGE_LAYOUT_GENERAL, GfxDeviceGlobal::texCmdBuffer );
+    vkCmdCopyImageToBuffer( GfxDeviceGlobal::texCmdBuffer, color.image, VK_IMAGE_LAYOUT_GENERAL, pixelBuffer, 1, &region );
+    SetColorImageLayout( oldLayout, GfxDeviceGlobal::texCmdBuffer );
 
     VkBufferMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-    barrier.srcAccessMask = VK_ACCESS_HOST_READ_BIT;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
     barrier.size = VK_WHOLE_SIZE;
     barrier.buffer = pixelBuffer;
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    vkCmdPipelineBarrier( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, nullptr, 1, &barrier, 0, nullptr );
-    vkEndCommandBuffer( GfxDeviceGlobal::currentCmdBuffer );
+    vkCmdPipelineBarrier( GfxDeviceGlobal::texCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+    vkEndCommandBuffer( GfxDeviceGlobal::texCmdBuffer );
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::currentCmdBuffer;
+    submitInfo.pCommandBuffers = &GfxDeviceGlobal::texCmdBuffer;
 
     err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
-    AE3D_CHECK_VULKAN( err, "vkQueueSubmit in Texture2D" );
+    AE3D_CHECK_VULKAN( err, "vkQueueSubmit in RenderTexture::Map()" );
 
     vkDeviceWaitIdle( GfxDeviceGlobal::device );
 
@@ -711,13 +739,37 @@ void ae3d::RenderTexture::CreateRenderPass()
     subpass.preserveAttachmentCount = 0;
     subpass.pPreserveAttachments = nullptr;
 
+    // Offscreen passes are submitted without waiting for the GPU, so these order them with the passes that read their textures.
+    VkSubpassDependency dependencies[ 2 ];
+
+    // Earlier reads of the texture in shaders and earlier passes into it finish before the attachments are written.
+    dependencies[ 0 ].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[ 0 ].dstSubpass = 0;
+    dependencies[ 0 ].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[ 0 ].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[ 0 ].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[ 0 ].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[ 0 ].dependencyFlags = 0;
+
+    // Attachment writes are visible to later passes that sample the texture.
+    dependencies[ 1 ].srcSubpass = 0;
+    dependencies[ 1 ].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[ 1 ].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[ 1 ].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[ 1 ].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[ 1 ].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[ 1 ].dependencyFlags = 0;
+
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount = 2;
     renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 0;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
 
     VkResult err = vkCreateRenderPass( GfxDeviceGlobal::device, &renderPassInfo, nullptr, &renderPass );
     AE3D_CHECK_VULKAN( err, "RenderTexture vkCreateRenderPass" );
@@ -725,4 +777,5 @@ void ae3d::RenderTexture::CreateRenderPass()
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)renderPass, VK_OBJECT_TYPE_RENDER_PASS, isCube ? "renderpass cube rt" : "renderpass 2d rt" );
 
     RenderTextureGlobal::renderPassesToReleaseAtExit.push_back( renderPass );
+    RenderTextureGlobal::renderPassFormats.push_back( { colorFormat, sampleCount, renderPass } );
 }
@@ -30,6 +30,7 @@ void ae3d::BuiltinShaders::Load()
     momentsShader.LoadSPIRV( FileSystem::FileContents( "shaders/moments_vert.spv" ), FileSystem::FileContents( "shaders/moments_frag.spv" ) );
     momentsAlphaTestShader.LoadSPIRV( FileSystem::FileContents( "shaders/moments_vert.spv" ), FileSystem::FileContents( "shaders/moments_alphatest_frag.spv" ) );
     momentsSkinShader.LoadSPIRV( FileSystem::FileContents( "shaders/moments_skin_vert.spv" ), FileSystem::FileContents( "shaders/moments_frag.spv" ) );
+    shadowCacheShader.LoadSPIRV( FileSystem::FileContents( "shaders/sprite_vert.spv" ), FileSystem::FileContents( "shaders/shadow_cache_frag.spv" ) );
     depthNormalsShader.LoadSPIRV( FileSystem::FileContents( "shaders/depthnormals_vert.spv" ), FileSystem::FileContents( "shaders/depthnormals_frag.spv" ) );
     depthNormalsSkinShader.LoadSPIRV( FileSystem::FileContents( "shaders/depthnormals_skin_vert.spv" ), FileSystem::FileContents( "shaders/depthnormals_frag.spv" ) );
     uiShader.LoadSPIRV( FileSystem::FileContents( "shaders/sprite_vert.spv" ), FileSystem::FileContents( "shaders/sprite_frag.spv" ) );
@@ -11,9 +11,11 @@
 #include "Texture2D.hpp"
 #include "TextureCube.hpp"
 #include "RenderTexture.hpp"
+#include "Statistics.hpp"
 #include "VulkanUtils.hpp"
 #include "Vec3.hpp"
 #include <cstring>
+#include <vector>
 
 extern ae3d::FileWatcher fileWatcher;
 
@@ -33,6 +35,7 @@ namespace ShaderGlobal
 {
     int moduleIndex = 0;
     VkShaderModule modulesToReleaseAtExit[ MaxModuleCount ];
+    const ae3d::Shader* lastUsedShader = nullptr; // Counts shader changes for Statistics.
 }
 
 struct ShaderCacheEntry
@@ -50,6 +53,49 @@ struct ShaderCacheEntry
 
 Array< ShaderCacheEntry > cacheEntries;
 
+// Returns true if the SPIR-V module decorates a resource with the instance buffer's binding, 17 in ubo.h.
+static bool UsesInstanceBuffer( const std::vector< unsigned char >& spirv )
+{
+    const std::uint32_t OpDecorate = 71;
+    const std::uint32_t DecorationBinding = 33;
+    const std::uint32_t InstanceBufferBinding = 17;
+    const std::size_t wordCount = spirv.size() / 4;
+    const std::size_t HeaderWordCount = 5;
+
+    for (std::size_t i = HeaderWordCount; i < wordCount; )
+    {
+        std::uint32_t words[ 4 ] = {};
+        std::memcpy( words, &spirv[ i * 4 ], 4 * (wordCount - i < 4 ? wordCount - i : 4) );
+        const std::uint32_t instructionWordCount = words[ 0 ] >> 16;
+
+        if (instructionWordCount == 0)
+        {
+            return false;
+        }
+
+        if ((words[ 0 ] & 0xFFFF) == OpDecorate && instructionWordCount == 4 && words[ 2 ] == DecorationBinding && words[ 3 ] == InstanceBufferBinding)
+        {
+            return true;
+        }
+
+        i += instructionWordCount;
+    }
+
+    return false;
+}
+
+// Used to find the shaders of PSOs in the PSO manifest.
+void GetLoadedShaders( const std::string& vertexPath, const std::string& fragmentPath, std::vector< ae3d::Shader* >& outShaders )
+{
+    for (unsigned i = 0; i < cacheEntries.count; ++i)
+    {
+        if (cacheEntries[ i ].vertexPath == vertexPath && cacheEntries[ i ].fragmentPath == fragmentPath)
+        {
+            outShaders.push_back( cacheEntries[ i ].shader );
+        }
+    }
+}
+
 void ShaderReload( const std::string& path )
 {
     ae3d::System::Print("Reloading shader %s\n", path.c_str());
@@ -121,6 +167,8 @@ void ae3d::Shader::LoadSPIRV( const FileSystem::FileContentsData& vertexData, co
         vertexInfo.pSpecializationInfo = nullptr;
 
         System::Assert( vertexInfo.module != VK_NULL_HANDLE, "vertex shader module not created" );
+
+        isInstancingSupported = UsesInstanceBuffer( vertexData.data );
     }
 
     // Fragment shader
@@ -177,11 +225,18 @@ void ae3d::Shader::Use()
 {
     System::Assert( IsValid(), "no valid shader" );
     GfxDevice::GetNewUniformBuffer();
+
+    if (ShaderGlobal::lastUsedShader != this)
+    {
+        ShaderGlobal::lastUsedShader = this;
+        Statistics::IncShaderBinds();
+    }
 }
 
 void ae3d::Shader::SetUniform( int offset, void* data, int dataBytes )
 {
     System::Assert( GfxDevice::GetCurrentUbo() != nullptr, "null ubo" );
+    System::Assert( offset >= 0 && offset + dataBytes <= GfxDevice::GetCurrentUboBytes(), "uniform is outside cbPerDraw" );
     std::memcpy( &GfxDevice::GetCurrentUbo()[ offset ], data, dataBytes );
 }
 
@@ -1,6 +1,7 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Texture2D.hpp"
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <cstdint>
@@ -45,6 +46,24 @@ namespace Texture2DGlobal
     std::vector< VkDeviceMemory > memoryToReleaseAtExit;
 }
 
+// Called when a texture is loaded again. Frames in flight can still sample the old objects.
+void ReleaseReplacedObjects( VkImage& image, VkImageView& view, VkDeviceMemory& memory )
+{
+    auto& images = Texture2DGlobal::imagesToReleaseAtExit;
+    auto& views = Texture2DGlobal::imageViewsToReleaseAtExit;
+    auto& memories = Texture2DGlobal::memoryToReleaseAtExit;
+    images.erase( std::remove( std::begin( images ), std::end( images ), image ), std::end( images ) );
+    views.erase( std::remove( std::begin( views ), std::end( views ), view ), std::end( views ) );
+    memories.erase( std::remove( std::begin( memories ), std::end( memories ), memory ), std::end( memories ) );
+
+    ae3d::ReleaseAfterFrame( (std::uint64_t)view, VK_OBJECT_TYPE_IMAGE_VIEW );
+    ae3d::ReleaseAfterFrame( (std::uint64_t)image, VK_OBJECT_TYPE_IMAGE );
+    ae3d::ReleaseAfterFrame( (std::uint64_t)memory, VK_OBJECT_TYPE_DEVICE_MEMORY );
+    image = VK_NULL_HANDLE;
+    view = VK_NULL_HANDLE;
+    memory = VK_NULL_HANDLE;
+}
+
 void ae3d::Texture2D::DestroyTextures()
 {
     for (std::size_t samplerIndex = 0; samplerIndex < Texture2DGlobal::samplersToReleaseAtExit.size(); ++samplerIndex)
@@ -104,6 +123,11 @@ void ae3d::Texture2D::LoadFromData( const void* imageData, int aWidth, int aHeig
 }
 
 void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+{
+    LoadDecoded( fileContents, DecodedImage(), aWrap, aFilter, aMipmaps, aColorSpace, aAnisotropy );
+}
+
+void ae3d::Texture2D::LoadDecoded( const FileSystem::FileContentsData& fileContents, const DecodedImage& image, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
 {
     filter = aFilter;
     wrap = aWrap;
@@ -132,7 +156,7 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
 
     if (HasStbExtension( fileContents.path ))
     {
-        LoadSTB( fileContents );
+        LoadSTB( fileContents, image );
     }
     else if (isDDS && GfxDeviceGlobal::deviceFeatures.textureCompressionBC)
     {
@@ -149,6 +173,11 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
 
 void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, VkFormat format )
 {
+    if (image != VK_NULL_HANDLE)
+    {
+        ReleaseReplacedObjects( image, view, deviceMemory );
+    }
+
     VkImageCreateInfo imageCreateInfo = {};
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -465,6 +494,11 @@ void ae3d::Texture2D::SetLayout( TextureLayout aLayout )
 
 void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkFormat format, VkImageUsageFlags usageFlags )
 {
+    if (image != VK_NULL_HANDLE)
+    {
+        ReleaseReplacedObjects( image, view, deviceMemory );
+    }
+
     if (!MathUtil::IsPowerOfTwo( width ) || !MathUtil::IsPowerOfTwo( height ))
     {
         if (mipmaps == Mipmaps::Generate)
@@ -824,23 +858,29 @@ void ae3d::Texture2D::LoadDDS( const char* aPath )
     CreateVulkanObjects( ddsOutput, format );
 }
 
-void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents, const DecodedImage& image )
 {
     System::Assert( GfxDeviceGlobal::graphicsQueue != VK_NULL_HANDLE, "queue not initialized" );
     System::Assert( GfxDeviceGlobal::device != VK_NULL_HANDLE, "device not initialized" );
 
-    int components;
-    unsigned char* data = stbi_load_from_memory( fileContents.data.data(), static_cast<int>(fileContents.data.size()), &width, &height, &components, 4 );
+    DecodedImage decodedImage;
+    const DecodedImage* source = &image;
 
-    if (data == nullptr)
+    if (image.pixels.empty())
     {
-        const std::string reason( stbi_failure_reason() );
-        System::Print( "%s failed to load. stb_image's reason: %s\n", fileContents.path.c_str(), reason.c_str() );
-        GetDefaultTexture();
-        *this = Texture2DGlobal::defaultTexture;
-        return;
+        if (!Decode( fileContents, decodedImage ))
+        {
+            GetDefaultTexture();
+            *this = Texture2DGlobal::defaultTexture;
+            return;
+        }
+
+        source = &decodedImage;
     }
 
+    width = source->width;
+    height = source->height;
+
     if (static_cast< int >( GfxDeviceGlobal::properties.limits.maxImageDimension2D ) < width ||
         static_cast< int >( GfxDeviceGlobal::properties.limits.maxImageDimension2D ) < height)
     {
@@ -850,11 +890,9 @@ void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents
         height = GfxDeviceGlobal::properties.limits.maxImageDimension2D;
     }
 
-    opaque = (components == 3 || components == 1);
-
-    CreateVulkanObjects( data, 4, colorSpace == ColorSpace::Linear ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT );
+    opaque = source->opaque;
 
-    stbi_image_free( data );
+    CreateVulkanObjects( const_cast< unsigned char* >( source->pixels.data() ), 4, colorSpace == ColorSpace::Linear ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT );
 }
 
 void ae3d::Texture2D::SetLayouts( Texture2D* textures[], TextureLayout layouts[], int count )
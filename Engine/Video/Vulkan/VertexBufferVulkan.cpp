@@ -13,8 +13,6 @@
 namespace GfxDeviceGlobal
 {
     extern VkDevice device;
-    extern Array< VkBuffer > pendingFreeVBs;
-    extern Array< VkDeviceMemory > pendingFreeMemory;
     extern VkCommandPool cmdPool;
     extern VkQueue graphicsQueue;
 }
@@ -27,6 +25,8 @@ namespace VertexBufferGlobal
 
 ae3d::VertexBuffer::Buffer ae3d::VertexBuffer::globalStagingBuffer;
 
+unsigned WaitForFrameSlot();
+
 void ae3d::VertexBuffer::DestroyBuffers()
 {
     for (std::size_t bufferIndex = 0; bufferIndex < VertexBufferGlobal::buffersToReleaseAtExit.size(); ++bufferIndex)
@@ -153,10 +153,10 @@ void MarkForFreeing( VkBuffer vertexBuffer, VkDeviceMemory vertexMem, VkBuffer i
         }
     }
 
-    GfxDeviceGlobal::pendingFreeMemory.Add( vertexMem );
-    GfxDeviceGlobal::pendingFreeMemory.Add( indexMem );
-    GfxDeviceGlobal::pendingFreeVBs.Add( vertexBuffer );
-    GfxDeviceGlobal::pendingFreeVBs.Add( indexBuffer );
+    ae3d::ReleaseAfterFrame( (std::uint64_t)vertexBuffer, VK_OBJECT_TYPE_BUFFER );
+    ae3d::ReleaseAfterFrame( (std::uint64_t)indexBuffer, VK_OBJECT_TYPE_BUFFER );
+    ae3d::ReleaseAfterFrame( (std::uint64_t)vertexMem, VK_OBJECT_TYPE_DEVICE_MEMORY );
+    ae3d::ReleaseAfterFrame( (std::uint64_t)indexMem, VK_OBJECT_TYPE_DEVICE_MEMORY );
 }
 
 void ae3d::VertexBuffer::GenerateVertexBuffer( const void* vertexData, int vertexBufferSize, int vertexStride, const void* indexData, int indexBufferSize )
@@ -358,41 +358,67 @@ void ae3d::VertexBuffer::CreateInputState( int vertexStride )
     inputStateCreateInfo.pVertexAttributeDescriptions = &attributeDescriptions[ 0 ];
 }
 
+void ae3d::VertexBuffer::SetInputStateFormat( VertexFormat format )
+{
+    vertexFormat = format;
+
+    if (format == VertexFormat::PTC)
+    {
+        CreateInputState( sizeof( VertexPTC ) );
+    }
+    else if (format == VertexFormat::PTN)
+    {
+        CreateInputState( sizeof( VertexPTN ) );
+    }
+    else if (format == VertexFormat::PTNTC)
+    {
+        CreateInputState( sizeof( VertexPTNTC ) );
+    }
+    else
+    {
+        CreateInputState( sizeof( VertexPTNTC_Skinned ) );
+    }
+}
+
 void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
 
-    CreateBuffer( stagingBuffers.vertices.buffer, vertexCount * sizeof( VertexPTNTC ), stagingBuffers.vertices.memory, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic vertex buffer" );
-    stagingBuffers.vertices.size = vertexCount * sizeof( VertexPTNTC );
+    for (auto& dynamicBuffer : dynamicBuffers)
+    {
+        CreateBuffer( dynamicBuffer.vertices.buffer, vertexCount * sizeof( VertexPTNTC ), dynamicBuffer.vertices.memory, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic vertex buffer" );
+        dynamicBuffer.vertices.size = vertexCount * sizeof( VertexPTNTC );
 
-    VkResult err = vkMapMemory( GfxDeviceGlobal::device, stagingBuffers.vertices.memory, 0, stagingBuffers.vertices.size, 0, &stagingBuffers.vertices.mappedData );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory GenerateDynamic" );
+        VkResult err = vkMapMemory( GfxDeviceGlobal::device, dynamicBuffer.vertices.memory, 0, dynamicBuffer.vertices.size, 0, &dynamicBuffer.vertices.mappedData );
+        AE3D_CHECK_VULKAN( err, "vkMapMemory GenerateDynamic" );
 
-    CreateBuffer( stagingBuffers.indices.buffer, elementCount * 2, stagingBuffers.indices.memory, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic index buffer" );
-    stagingBuffers.indices.size = elementCount * 2;
+        CreateBuffer( dynamicBuffer.indices.buffer, elementCount * 2, dynamicBuffer.indices.memory, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic index buffer" );
+        dynamicBuffer.indices.size = elementCount * 2;
 
-    err = vkMapMemory( GfxDeviceGlobal::device, stagingBuffers.indices.memory, 0, stagingBuffers.indices.size, 0, &stagingBuffers.indices.mappedData );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory GenerateDynamic" );
+        err = vkMapMemory( GfxDeviceGlobal::device, dynamicBuffer.indices.memory, 0, dynamicBuffer.indices.size, 0, &dynamicBuffer.indices.mappedData );
+        AE3D_CHECK_VULKAN( err, "vkMapMemory GenerateDynamic" );
+    }
 
-    vertexBuffer = stagingBuffers.vertices.buffer;
-    indexBuffer = stagingBuffers.indices.buffer;
+    vertexBuffer = dynamicBuffers[ 0 ].vertices.buffer;
+    indexBuffer = dynamicBuffers[ 0 ].indices.buffer;
 
     verticesPTNTC.Allocate( vertexCount );
+    dynamicFaces.Allocate( faceCount );
 
     CreateInputState( sizeof( VertexPTNTC ) );
 }
 
 void ae3d::VertexBuffer::UpdateDynamic( const Face* faces, int faceCount, const VertexPTC* vertices, int vertexCount )
 {
-    System::Assert( stagingBuffers.indices.mappedData != nullptr, "Index buffer not initialized!" );
-    System::Assert( stagingBuffers.indices.buffer != VK_NULL_HANDLE, "Index buffer not initialized!" );
-    System::Assert( stagingBuffers.indices.size >= faceCount * 3 * 2, "Index buffer too small!" );
-    System::Assert( (std::size_t)stagingBuffers.vertices.size >= vertexCount * sizeof( VertexPTNTC ), "Vertex buffer too small!" );
+    System::Assert( dynamicBuffers[ 0 ].indices.mappedData != nullptr, "Index buffer not initialized!" );
+    System::Assert( dynamicFaces.count >= (unsigned)faceCount, "Index buffer too small!" );
+    System::Assert( verticesPTNTC.count >= (unsigned)vertexCount, "Vertex buffer too small!" );
 
-    std::memcpy( stagingBuffers.indices.mappedData, faces, faceCount * 3 * 2 );
+    std::memcpy( dynamicFaces.elements, faces, faceCount * sizeof( Face ) );
 
-    for (unsigned vertexInd = 0; vertexInd < verticesPTNTC.count; ++vertexInd)
+    for (int vertexInd = 0; vertexInd < vertexCount; ++vertexInd)
     {
         verticesPTNTC[ vertexInd ].position = vertices[ vertexInd ].position;
         verticesPTNTC[ vertexInd ].u = vertices[ vertexInd ].u;
@@ -402,12 +428,39 @@ void ae3d::VertexBuffer::UpdateDynamic( const Face* faces, int faceCount, const
         verticesPTNTC[ vertexInd ].color = vertices[ vertexInd ].color;
     }
 
-    std::memcpy( stagingBuffers.vertices.mappedData, verticesPTNTC.elements, vertexCount * sizeof( VertexPTNTC ) );
+    dynamicFaceCount = faceCount;
+    dynamicVertexCount = vertexCount;
+    ++dynamicVersion;
+
+    // Only the current frame slot's copy is written, frames in other slots can still read theirs.
+    SelectFrameSlot( WaitForFrameSlot() );
+}
+
+void ae3d::VertexBuffer::SelectFrameSlot( unsigned frameSlot )
+{
+    if (dynamicBuffers[ 0 ].vertices.buffer == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    auto& dynamicBuffer = dynamicBuffers[ frameSlot ];
+
+    // The copy is only read by frames of its slot, and BeginFrame waited for the previous one.
+    if (dynamicBuffer.version != dynamicVersion)
+    {
+        std::memcpy( dynamicBuffer.indices.mappedData, dynamicFaces.elements, dynamicFaceCount * sizeof( Face ) );
+        std::memcpy( dynamicBuffer.vertices.mappedData, verticesPTNTC.elements, dynamicVertexCount * sizeof( VertexPTNTC ) );
+        dynamicBuffer.version = dynamicVersion;
+    }
+
+    vertexBuffer = dynamicBuffer.vertices.buffer;
+    indexBuffer = dynamicBuffer.indices.buffer;
 }
 
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTC* vertices, int vertexCount, Storage /*storage*/ )
 {
     vertexFormat = VertexFormat::PTNTC;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
 
     Array< VertexPTNTC > verticesPTNTC2;
@@ -427,6 +480,18 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 }
 
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt16;
+    GeneratePTN( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
+{
+    indexType = IndexType::UInt32;
+    GeneratePTN( faces, faceCount, vertices, vertexCount );
+}
+
+void ae3d::VertexBuffer::GeneratePTN( const void* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC;
     elementCount = faceCount * 3;
@@ -444,19 +509,37 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
         verticesPTNTC2[ vertexInd ].color = Vec4( 1, 1, 1, 1 );
     }
 
-    GenerateVertexBuffer( static_cast< const void*>( verticesPTNTC2.elements ), vertexCount * sizeof( VertexPTNTC ), sizeof( VertexPTNTC ), static_cast< const void* >( faces ), elementCount * 2 );
+    GenerateVertexBuffer( static_cast< const void*>( verticesPTNTC2.elements ), vertexCount * sizeof( VertexPTNTC ), sizeof( VertexPTNTC ), faces, elementCount * GetIndexSize() );
 }
 
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
     GenerateVertexBuffer( static_cast< const void*>( vertices ), vertexCount * sizeof( VertexPTNTC ), sizeof( VertexPTNTC ), static_cast< const void*>( faces ), elementCount * 2 );
 }
 
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    indexType = IndexType::UInt32;
+    elementCount = faceCount * 3;
+    GenerateVertexBuffer( static_cast< const void*>( vertices ), vertexCount * sizeof( VertexPTNTC ), sizeof( VertexPTNTC ), static_cast< const void*>( faces ), elementCount * 4 );
+}
+
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC_Skinned;
+    indexType = IndexType::UInt16;
     elementCount = faceCount * 3;
     GenerateVertexBuffer( static_cast< const void*>( vertices ), vertexCount * sizeof( VertexPTNTC_Skinned ), sizeof( VertexPTNTC_Skinned ), static_cast< const void*>( faces ), elementCount * 2 );
 }
+
+void ae3d::VertexBuffer::Generate( const Face32* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC_Skinned;
+    indexType = IndexType::UInt32;
+    elementCount = faceCount * 3;
+    GenerateVertexBuffer( static_cast< const void*>( vertices ), vertexCount * sizeof( VertexPTNTC_Skinned ), sizeof( VertexPTNTC_Skinned ), static_cast< const void*>( faces ), elementCount * 4 );
+}
@@ -198,16 +198,19 @@ namespace debug
 namespace ae3d
 {
     std::uint64_t GetPSOHash( ae3d::VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode,
-        ae3d::GfxDevice::DepthFunc depthFunc, ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, ae3d::GfxDevice::PrimitiveTopology topology )
+        ae3d::GfxDevice::DepthFunc depthFunc, ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, std::uint64_t renderPassKey, ae3d::GfxDevice::PrimitiveTopology topology )
     {
-        std::uint64_t outResult = (std::uint64_t)vertexBuffer.GetVertexFormat();
-        outResult += (ptrdiff_t)&shader;
-        outResult += (unsigned)blendMode;
-        outResult += ((unsigned)depthFunc) * 2;
-        outResult += ((unsigned)cullMode) * 4;
-        outResult += ((unsigned)fillMode) * 8;
-        outResult += ((ptrdiff_t)renderPass) * 16;
-        outResult += ((unsigned)topology) * 32;
+        // Each state gets its own bits, so different states can't add up to the same hash.
+        std::uint64_t state = (std::uint64_t)vertexBuffer.GetVertexFormat();
+        state |= ((std::uint64_t)blendMode) << 3;
+        state |= ((std::uint64_t)depthFunc) << 5;
+        state |= ((std::uint64_t)cullMode) << 7;
+        state |= ((std::uint64_t)fillMode) << 9;
+        state |= ((std::uint64_t)topology) << 10;
+
+        std::uint64_t outResult = (std::uint64_t)(ptrdiff_t)&shader;
+        outResult = (outResult ^ state) * 1099511628211ull;
+        outResult = (outResult ^ renderPassKey) * 1099511628211ull;
 
         return outResult;
     }
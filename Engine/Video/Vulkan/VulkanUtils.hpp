@@ -24,11 +24,15 @@ namespace ae3d
                             VkImageLayout newImageLayout, unsigned layerCount, unsigned mipLevel, unsigned mipLevelCount,
                             VkImageMemoryBarrier& outBarrier, VkPipelineStageFlags& outSrcStageFlags, VkPipelineStageFlags& outDstStageFlags );
 
+    /// \param renderPassKey 0 for the swapchain's render pass, otherwise identifies compatible render texture render passes.
     std::uint64_t GetPSOHash( ae3d::VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode,
-        ae3d::GfxDevice::DepthFunc depthFunc, ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, ae3d::GfxDevice::PrimitiveTopology topology );
+        ae3d::GfxDevice::DepthFunc depthFunc, ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, std::uint64_t renderPassKey, ae3d::GfxDevice::PrimitiveTopology topology );
 
     void CreateInstance( VkInstance* outInstance );
     std::uint32_t GetMemoryType( std::uint32_t typeBits, VkFlags properties );
+
+    /// Destroys a buffer, buffer view, image, image view, sampler, memory, pipeline or framebuffer after the GPU has finished all frames that can use it.
+    void ReleaseAfterFrame( std::uint64_t object, VkObjectType objectType );
 }
 
 namespace debug
@@ -970,6 +970,8 @@ int main()
     cube.GetComponent<AudioSourceComponent>()->Set3D( true );
     //cube.GetComponent<AudioSourceComponent>()->Play();
 
+    System::Print( "Prewarmed %u pipelines\n", System::PrewarmPipelines() );
+
     bool quit = false;
     
     int lastMouseX = 0;
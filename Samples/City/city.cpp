@@ -29,6 +29,7 @@
 
 // This sample demonstrates a big number of draw calls, good for profiling CPU load. GPU usage should also be quite big.
 // The scene in its default camera position has 2000 point lights, 0.6 M triangles, ~3000 draw calls.
+// Most buildings are hidden behind other buildings, so occlusion culling is enabled. Toggle it with O.
 // Assets for this sample will be added before 0.8.7 release.
 
 using namespace ae3d;
@@ -215,6 +216,7 @@ int main()
     dirLight.GetComponent<TransformComponent>()->LookAt( { 0, 0, 0 }, Vec3( 0.2f, -1, 0.05f ).Normalized(), { 0, 1, 0 } );
 
     scene.SetAmbient( { 0.1f, 0.1f, 0.1f } );
+    scene.EnableOcclusionCulling( true );
     
     TextureCube skybox;
     skybox.Load( FileSystem::FileContents( "skybox/left.jpg" ), FileSystem::FileContents( "skybox/right.jpg" ),
@@ -425,6 +427,14 @@ int main()
                 {
                     reload = true;
                 }
+                else if (keyCode == KeyCode::O)
+                {
+                    scene.EnableOcclusionCulling( !scene.IsOcclusionCullingEnabled() );
+                }
+                else if (keyCode == KeyCode::I)
+                {
+                    scene.EnableInstancing( !scene.IsInstancingEnabled() );
+                }
             }
             else if (event.type == WindowEventType::MouseMove)
             {
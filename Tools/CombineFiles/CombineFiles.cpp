@@ -1,84 +1,214 @@
 /**
-  Combines files listed in input text file into one.
-  
-  Usage: CombineFiles input.txt output
-
-  Input file contains one path per line.
-  
-  Output file's first 4 bytes is the block count. After it blocks are followed where data is ordered like below:
-  offset      data
-      0       file name
-    128       file length
-    132       file contents
+  Combines files listed in input text file into one .pak file.
+
+  Usage: CombineFiles [-nocompress] input.txt output
+
+  Input file contains one path per line. Backslashes are converted to slashes and duplicate paths are skipped.
+  Files are compressed with Lz4 unless -nocompress is given or the file doesn't get smaller.
+
+  Output file is in the format described in Engine/Core/PakFormat.hpp: a header, a table of contents with a
+  hash table for lookups, paths and file contents aligned to PakFormat::DataAlignment.
 */
 #include <iostream>
 #include <fstream>
-#include <sstream>
-#include <list>
+#include <algorithm>
 #include <string>
+#include <unordered_set>
 #include <vector>
-#include <cstring>
+#include <cstdint>
+#include "../../Engine/Core/Lz4.hpp"
+#include "../../Engine/Core/PakFormat.hpp"
+
+using namespace ae3d;
 
 struct FileMetaBlock
 {
     std::string path;
-    unsigned dataSize;
+    PakFormat::Entry entry;
 };
 
+std::uint64_t Align( std::uint64_t offset, std::uint64_t alignment )
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Compresses data in independent blocks. Returns an empty vector if the result would not be smaller than data.
+std::vector< unsigned char > CompressEntry( const std::vector< unsigned char >& data )
+{
+    const std::size_t blockCount = static_cast< std::size_t >( (data.size() + PakFormat::CompressionBlockSize - 1) / PakFormat::CompressionBlockSize );
+    std::vector< std::uint32_t > blockSizes( blockCount );
+    std::vector< unsigned char > blocks;
+    std::vector< unsigned char > compressedBlock( Lz4::GetCompressBound( static_cast< std::size_t >( PakFormat::CompressionBlockSize ) ) );
+
+    for (std::size_t b = 0; b < blockCount; ++b)
+    {
+        const unsigned char* const block = data.data() + b * PakFormat::CompressionBlockSize;
+        const std::size_t blockSize = std::min( static_cast< std::size_t >( PakFormat::CompressionBlockSize ), data.size() - b * PakFormat::CompressionBlockSize );
+        const std::size_t compressedSize = Lz4::Compress( block, blockSize, compressedBlock.data(), compressedBlock.size() );
+
+        // A block that doesn't get smaller is stored as is. The reader recognizes it by its size.
+        if (compressedSize == 0 || compressedSize >= blockSize)
+        {
+            blocks.insert( std::end( blocks ), block, block + blockSize );
+            blockSizes[ b ] = static_cast< std::uint32_t >( blockSize );
+        }
+        else
+        {
+            blocks.insert( std::end( blocks ), compressedBlock.data(), compressedBlock.data() + compressedSize );
+            blockSizes[ b ] = static_cast< std::uint32_t >( compressedSize );
+        }
+    }
+
+    std::vector< unsigned char > result( blockCount * sizeof( std::uint32_t ) + blocks.size() );
+
+    if (result.size() >= data.size())
+    {
+        return std::vector< unsigned char >();
+    }
+
+    std::copy( (const unsigned char*)blockSizes.data(), (const unsigned char*)(blockSizes.data() + blockCount), result.data() );
+    std::copy( std::begin( blocks ), std::end( blocks ), result.data() + blockCount * sizeof( std::uint32_t ) );
+    return result;
+}
+
+// count must be less than PakFormat::DataAlignment.
+void WritePadding( std::ofstream& ofs, std::uint64_t count )
+{
+    const char zeros[ PakFormat::DataAlignment ] = {};
+    ofs.write( zeros, static_cast< std::streamsize >( count ) );
+}
+
 int main( int argCount, char* args[] )
 {
-    if (argCount != 3)
+    const bool compress = !(argCount == 4 && std::string( args[ 1 ] ) == "-nocompress");
+
+    if (argCount != 3 && compress)
     {
-        std::cout << "Usage: CombineFiles indexFile.txt outputfile" << std::endl;
+        std::cout << "Usage: CombineFiles [-nocompress] indexFile.txt outputfile" << std::endl;
         return 1;
     }
 
-    std::ifstream fileListFile( args[ 1 ] );
+    const char* const fileListPath = args[ argCount - 2 ];
+    const char* const outputPath = args[ argCount - 1 ];
+
+    std::ifstream fileListFile( fileListPath );
     if (!fileListFile.is_open())
     {
-        std::cout << "Could not open " << args[ 1 ] << std::endl;
+        std::cout << "Could not open " << fileListPath << std::endl;
         return 1;
     }
 
-    std::list< FileMetaBlock > fileList;
+    std::vector< FileMetaBlock > fileList;
+    std::unordered_set< std::string > addedPaths;
     std::string line;
-    const unsigned MaxPathLength = 128;
 
     while (std::getline( fileListFile, line ))
     {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        std::replace( std::begin( line ), std::end( line ), '\\', '/' );
+
+        if (line.empty() || !addedPaths.insert( line ).second)
+        {
+            continue;
+        }
+
         fileList.push_back( FileMetaBlock() );
         fileList.back().path = line;
-        
-        if (line.length() > MaxPathLength)
+    }
+
+    // Hash table is at most half full to keep probe sequences short.
+    std::uint32_t bucketCount = 1;
+
+    while (bucketCount < fileList.size() * 2 + 1)
+    {
+        bucketCount *= 2;
+    }
+
+    PakFormat::Header header = {};
+    std::copy( std::begin( PakFormat::Magic ), std::end( PakFormat::Magic ), header.magic );
+    header.version = PakFormat::Version;
+    header.entryCount = static_cast< std::uint32_t >( fileList.size() );
+    header.bucketCount = bucketCount;
+    header.entriesOffset = sizeof( PakFormat::Header );
+    header.bucketsOffset = header.entriesOffset + fileList.size() * sizeof( PakFormat::Entry );
+    header.pathsOffset = header.bucketsOffset + bucketCount * sizeof( std::uint32_t );
+
+    // Table of contents is written last because stored sizes are known only after compression.
+    std::vector< std::uint32_t > buckets( bucketCount, 0 );
+    std::string paths;
+
+    for (std::size_t i = 0; i < fileList.size(); ++i)
+    {
+        FileMetaBlock& file = fileList[ i ];
+        file.entry.pathHash = PakFormat::HashPath( file.path.c_str(), file.path.size() );
+        file.entry.pathOffset = static_cast< std::uint32_t >( paths.size() );
+        file.entry.pathLength = static_cast< std::uint32_t >( file.path.size() );
+        paths.append( file.path.c_str(), file.path.size() + 1 );
+
+        std::uint32_t bucket = static_cast< std::uint32_t >( file.entry.pathHash ) & (bucketCount - 1);
+
+        while (buckets[ bucket ] != 0)
         {
-            std::cout << "Too long path in " << line << ". Max length is " << MaxPathLength << std::endl;
-            return 1;
+            bucket = (bucket + 1) & (bucketCount - 1);
         }
+
+        buckets[ bucket ] = static_cast< std::uint32_t >( i + 1 );
     }
 
-    // 1st pass: Determine file sizes.    
+    header.pathsSize = paths.size();
+
+    std::ofstream ofs( outputPath, std::ios::out | std::ios::binary );
+    std::uint64_t writtenSize = header.pathsOffset + header.pathsSize;
+    std::uint64_t uncompressedSize = 0;
+    ofs.seekp( static_cast< std::streamoff >( writtenSize ) );
+
     for (auto& file : fileList)
     {
-        std::ifstream ifs( file.path );
-        ifs.seekg( 0, std::ios::end );
-        file.dataSize = static_cast< unsigned >( ifs.tellg() );
+        std::ifstream ifs( file.path, std::ios::binary );
+
+        if (!ifs.is_open())
+        {
+            std::cout << "Could not open " << file.path << std::endl;
+            return 1;
+        }
+
+        const std::vector< unsigned char > data( (std::istreambuf_iterator< char >( ifs )), std::istreambuf_iterator< char >() );
+        const std::vector< unsigned char > compressedData = compress ? CompressEntry( data ) : std::vector< unsigned char >();
+        const std::vector< unsigned char >& storedData = compressedData.empty() ? data : compressedData;
+
+        file.entry.dataOffset = Align( writtenSize, PakFormat::DataAlignment );
+        file.entry.dataSize = storedData.size();
+        file.entry.uncompressedSize = data.size();
+        file.entry.flags = compressedData.empty() ? 0 : PakFormat::EntryFlags::Compressed;
+        file.entry.reserved = 0;
+
+        WritePadding( ofs, file.entry.dataOffset - writtenSize );
+        ofs.write( (const char*)storedData.data(), storedData.size() );
+        writtenSize = file.entry.dataOffset + file.entry.dataSize;
+        uncompressedSize += data.size();
     }
-    
-    std::ofstream ofs( args[ 2 ], std::ios::out | std::ios::binary );
-    const unsigned listLength = static_cast< unsigned >( fileList.size() );
-    ofs.write( (char*)&listLength, 4 );
+
+    ofs.seekp( 0 );
+    ofs.write( (char*)&header, sizeof( header ) );
 
     for (const auto& file : fileList)
     {
-        char path[ MaxPathLength ] = { 0 };
-        std::strcpy( path, file.path.c_str() );
-        ofs.write( (char*)path, MaxPathLength );
-        ofs.write( (char*)&file.dataSize, 4 );
-        std::vector< unsigned char > data;
-        std::ifstream ifs( file.path );
-        data.assign( std::istreambuf_iterator< char >( ifs ), std::istreambuf_iterator< char >() );
-        ofs.write( (char*)data.data(), data.size() );
+        ofs.write( (char*)&file.entry, sizeof( file.entry ) );
+    }
+
+    ofs.write( (char*)buckets.data(), buckets.size() * sizeof( std::uint32_t ) );
+    ofs.write( paths.data(), paths.size() );
+
+    if (!ofs)
+    {
+        std::cout << "Could not write " << outputPath << std::endl;
+        return 1;
     }
 
+    std::cout << "Wrote " << fileList.size() << " files, " << uncompressedSize << " bytes into " << writtenSize << " bytes." << std::endl;
     return 0;
 }
@@ -171,11 +171,6 @@ static float Max2( float a, float b )
     return a < b ? b : a;
 }
 
-bool AlmostEquals( float f, float v )
-{
-    return abs( f - v ) < 0.0001f;
-}
-
 float IntersectRayAABB( const Vec3& origin, const Vec3& target, const Vec3& min, const Vec3& max )
 {
     const Vec3 dir = (target - origin).Normalized();
@@ -206,55 +201,6 @@ float IntersectRayAABB( const Vec3& origin, const Vec3& target, const Vec3& min,
     return tmin;
 }
 
-float IntersectRayTriangles( const Vec3& origin, const Vec3& target, const Vec3* vertices, unsigned vertexCount )
-{
-    for (unsigned ve = 0; ve < vertexCount / 3; ve += 3)
-    {
-        const Vec3& v0 = vertices[ ve * 3 + 0 ];
-        const Vec3& v1 = vertices[ ve * 3 + 1 ];
-        const Vec3& v2 = vertices[ ve * 3 + 2 ];
-
-        const Vec3 e1 = v1 - v0;
-        const Vec3 e2 = v2 - v0;
-
-        const Vec3 d = (target - origin).Normalized();
-
-        const Vec3 h = Vec3::Cross( d, e2 );
-        const float a = Vec3::Dot( e1, h );
-
-        if (AlmostEquals( a, 0 ))
-        {
-            continue;
-        }
-
-        const float f = 1.0f / a;
-        const Vec3 s = origin - v0;
-        const float u = f * Vec3::Dot( s, h );
-
-        if (u < 0 || u > 1)
-        {
-            continue;
-        }
-
-        const Vec3 q = Vec3::Cross( s, e1 );
-        const float v = f * Vec3::Dot( d, q );
-
-        if (v < 0 || u + v > 1)
-        {
-            continue;
-        }
-
-        const float t = f * Vec3::Dot( e2, q );
-
-        if (t > 0.0001f)
-        {
-            return t;
-        }
-    }
-
-    return -1;
-}
-
 static void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax )
 {
     outMin = aPoints[ 0 ];
@@ -350,6 +296,29 @@ void GetColliders( GameObject& camera, CollisionFilter filter, int screenX, int
             collisionInfo.subMeshIndex = -1;
             collisionInfo.gameObjectIndex = i;
 
+            if (collisionTest == CollisionTest::Triangles)
+            {
+                // The mesh is raycast in its local space, so its triangles are not transformed.
+                Matrix44 worldToMeshLocal;
+                Matrix44::Invert( meshLocalToWorld, worldToMeshLocal );
+                Vec3 localOrigin, localDirection;
+                Matrix44::TransformPoint( rayOrigin, worldToMeshLocal, &localOrigin );
+                Matrix44::TransformDirection( (rayTarget - rayOrigin).Normalized(), worldToMeshLocal, &localDirection );
+
+                Mesh::RaycastHit hit;
+
+                if (meshRenderer->GetMesh()->Raycast( localOrigin, localDirection, 99999, hit ))
+                {
+                    Vec3 worldHit;
+                    Matrix44::TransformPoint( localOrigin + localDirection * hit.distance, meshLocalToWorld, &worldHit );
+                    collisionInfo.subMeshIndex = hit.subMeshIndex;
+                    collisionInfo.meshDistance = (worldHit - rayOrigin).Length();
+                    outColliders.Add( collisionInfo );
+                }
+
+                continue;
+            }
+
             for (unsigned subMeshIndex = 0; subMeshIndex < meshRenderer->GetMesh()->GetSubMeshCount(); ++subMeshIndex)
             {
                 Vec3 subMeshMin, subMeshMax;
@@ -364,16 +333,7 @@ void GetColliders( GameObject& camera, CollisionFilter filter, int screenX, int
 
                 GetMinMax( mAABB, 8, subMeshMin, subMeshMax );
 
-                Array< Vec3 > triangles;
-                meshRenderer->GetMesh()->GetSubMeshFlattenedTriangles( subMeshIndex, triangles );
-                
-                for (unsigned v = 0; v < triangles.count; ++v)
-                {
-                    Matrix44::TransformPoint( triangles[ v ], meshLocalToWorld, &triangles[ v ] );
-                }
-
-                const float subMeshDistance = collisionTest == CollisionTest::AABB ? IntersectRayAABB( rayOrigin, rayTarget, subMeshMin, subMeshMax )
-                                                                                   : IntersectRayTriangles( rayOrigin, rayTarget, triangles.elements, triangles.count );
+                const float subMeshDistance = IntersectRayAABB( rayOrigin, rayTarget, subMeshMin, subMeshMax );
 
                 //System::Print("distance to submesh %d: %f. rayOrigin: %.2f, %.2f, %.2f, rayTarget: %.2f, %.2f, %.2f\n", subMeshIndex, subMeshDistance, rayOrigin.x, rayOrigin.y, rayOrigin.z, rayTarget.x, rayTarget.y, rayTarget.z);
                 if (0 < subMeshDistance && subMeshDistance < collisionInfo.meshDistance)
@@ -393,10 +393,10 @@ void ImportMeshNodes( FbxNode* node )
                 gMeshes.back().tcoord.push_back( uv[ j ] );
                 gMeshes.back().nonInterleavedTangents.push_back( tangent[ j ] );
 
-                face.vInd[ j ] = (unsigned short)vertexIndex;
-                face.vnInd[ j ] = (unsigned short)vertexCounter;
-                face.uvInd[ j ] = (unsigned short)vertexCounter;
-                face.tInd[ j ] = (unsigned short)vertexCounter;
+                face.vInd[ j ] = (unsigned)vertexIndex;
+                face.vnInd[ j ] = (unsigned)vertexCounter;
+                face.uvInd[ j ] = (unsigned)vertexCounter;
+                face.tInd[ j ] = (unsigned)vertexCounter;
                 ++vertexCounter;
             }
             
@@ -34,13 +34,6 @@ void ConvertIndices()
     {
         auto& face = gMeshes.back().face[ f ];
 
-        if (vertGlobalLocal[ face.vInd[ 0 ] ] > 65535 ||
-            vertGlobalLocal[ face.vInd[ 1 ] ] > 65535 ||
-            vertGlobalLocal[ face.vInd[ 2 ] ] > 65535)
-        {
-            std::cerr << "More than 65535 vertices in a mesh, overflow!" << std::endl;
-        }
-        
         face.vInd[ 0 ] = vertGlobalLocal[ face.vInd[ 0 ] ];
         face.vInd[ 1 ] = vertGlobalLocal[ face.vInd[ 1 ] ];
         face.vInd[ 2 ] = vertGlobalLocal[ face.vInd[ 2 ] ];
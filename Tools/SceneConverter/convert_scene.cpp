@@ -0,0 +1,75 @@
+/**
+  Converts a textual .scene file into the binary scene format (Engine/Core/SceneFormat.hpp).
+  Binary scenes are loaded with Scene::Deserialize like textual scenes, or with Scene::DeserializeBinary directly from a memory-mapped file.
+
+  Usage: ConvertScene input.scene output.scene_bin
+
+  Paths in the scene are resolved relative to the working directory, like in the game, because the meshes are loaded during conversion.
+  Material definitions are not converted, because the binary format only contains what Scene::GetSerialized writes.
+*/
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "Array.hpp"
+#include "FileSystem.hpp"
+#include "GameObject.hpp"
+#include "Scene.hpp"
+#include "System.hpp"
+#include "Window.hpp"
+
+using namespace ae3d;
+
+int main( int argCount, char* args[] )
+{
+    if (argCount != 3)
+    {
+        std::cout << "Usage: ConvertScene input.scene output.scene_bin" << std::endl;
+        return 1;
+    }
+
+    Window::Create( 512, 512, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+
+    const auto contents = FileSystem::FileContents( args[ 1 ] );
+
+    if (!contents.isLoaded)
+    {
+        std::cout << "Could not open " << args[ 1 ] << std::endl;
+        return 1;
+    }
+
+    std::vector< GameObject > gameObjects;
+    std::map< std::string, class Texture2D* > textures;
+    std::map< std::string, class Material* > materials;
+    Array< class Mesh* > meshes;
+    Scene scene;
+
+    if (scene.Deserialize( contents, gameObjects, textures, materials, meshes ) != Scene::DeserializeResult::Success)
+    {
+        std::cout << "Could not parse " << args[ 1 ] << std::endl;
+        return 1;
+    }
+
+    for (auto& go : gameObjects)
+    {
+        scene.Add( &go );
+    }
+
+    const std::vector< unsigned char > binary = scene.GetSerializedBinary();
+
+    std::ofstream ofs( args[ 2 ], std::ios::out | std::ios::binary );
+    ofs.write( reinterpret_cast< const char* >( binary.data() ), binary.size() );
+
+    if (!ofs.good())
+    {
+        std::cout << "Could not write " << args[ 2 ] << std::endl;
+        return 1;
+    }
+
+    std::cout << "Converted " << gameObjects.size() << " game objects from " << args[ 1 ] << " (" << contents.data.size() << " bytes) into "
+              << args[ 2 ] << " (" << binary.size() << " bytes)" << std::endl;
+
+    return 0;
+}
@@ -15,6 +15,7 @@
 #include <vector>
 #include "Matrix.hpp"
 #include "Vec3.hpp"
+#include "../Engine/Core/MeshFormat.hpp"
 
 // Cache optimization code adapted from http://gameangst.com/wp-content/uploads/2009/03/forsythtriangleorderoptimizer.cpp
 
@@ -69,7 +70,7 @@ struct Face
 // a, b and c are indices to Mesh::interleavedVertices.
 struct VertexInd
 {
-    unsigned short a, b, c;
+    unsigned a, b, c;
 };
 
 enum class VertexFormat { PTNTC_Skinned, PTNTC, PTN };
@@ -356,7 +357,7 @@ void Mesh::OptimizeFaces()
     // fill out face list per vertex
     for (unsigned i = 0; i < static_cast< unsigned >( indices.size() ); ++i)
     {
-        unsigned short index = indices[ i ].a;
+        unsigned index = indices[ i ].a;
         VertexPTNTCWithData& vertexDataA = verticesWithCachedata[ index ];
         activeFaceList[ vertexDataA.data.activeFaceListStart + vertexDataA.data.activeFaceListSize ] = i;
         ++vertexDataA.data.activeFaceListSize;
@@ -375,9 +376,9 @@ void Mesh::OptimizeFaces()
     std::vector<std::uint8_t> processedFaceList;
     processedFaceList.resize( indices.size() );
 
-    unsigned short vertexCacheBuffer[ (MaxVertexCacheSize + 3) * 2 ];
-    unsigned short* cache0 = vertexCacheBuffer;
-    unsigned short* cache1 = vertexCacheBuffer + (MaxVertexCacheSize + 3);
+    unsigned vertexCacheBuffer[ (MaxVertexCacheSize + 3) * 2 ];
+    unsigned* cache0 = vertexCacheBuffer;
+    unsigned* cache1 = vertexCacheBuffer + (MaxVertexCacheSize + 3);
     unsigned short entriesInCache0 = 0;
 
     unsigned bestFace = 0;
@@ -400,19 +401,19 @@ void Mesh::OptimizeFaces()
                     unsigned fface = j;
                     float faceScore = 0.f;
                    
-                    unsigned short indexA = indices[ fface ].a;
+                    unsigned indexA = indices[ fface ].a;
                     VertexPTNTCWithData& vertexDataA = verticesWithCachedata[ indexA ];
                     assert( vertexDataA.data.activeFaceListSize > 0 );
                     assert( vertexDataA.data.cachePos0 >= lruCacheSize );
                     faceScore += vertexDataA.data.score;
 
-                    unsigned short indexB = indices[ fface ].b;
+                    unsigned indexB = indices[ fface ].b;
                     VertexPTNTCWithData& vertexDataB = verticesWithCachedata[ indexB ];
                     assert( vertexDataB.data.activeFaceListSize > 0 );
                     assert( vertexDataB.data.cachePos0 >= lruCacheSize );
                     faceScore += vertexDataB.data.score;
 
-                    unsigned short indexC = indices[ fface ].c;
+                    unsigned indexC = indices[ fface ].c;
                     VertexPTNTCWithData& vertexDataC = verticesWithCachedata[ indexC ];
                     assert( vertexDataC.data.activeFaceListSize > 0 );
                     assert( vertexDataC.data.cachePos0 >= lruCacheSize );
@@ -439,7 +440,7 @@ void Mesh::OptimizeFaces()
 
         // add bestFace to LRU cache and to newIndexList
         {
-            unsigned short indexA = indices[ bestFace ].a;
+            unsigned indexA = indices[ bestFace ].a;
             newIndexList[ i ].a = indexA;
 
             VertexPTNTCWithData& vertexData = verticesWithCachedata[ indexA ];
@@ -471,7 +472,7 @@ void Mesh::OptimizeFaces()
         }
 
         {
-            unsigned short indexB = indices[ bestFace ].b;
+            unsigned indexB = indices[ bestFace ].b;
             newIndexList[ i ].b = indexB;
 
             VertexPTNTCWithData& vertexData = verticesWithCachedata[ indexB ];
@@ -503,7 +504,7 @@ void Mesh::OptimizeFaces()
         }
 
         {
-            unsigned short indexC = indices[ bestFace ].c;
+            unsigned indexC = indices[ bestFace ].c;
             newIndexList[ i ].c = indexC;
 
             VertexPTNTCWithData& vertexData = verticesWithCachedata[ indexC ];
@@ -536,7 +537,7 @@ void Mesh::OptimizeFaces()
         // move the rest of the old verts in the cache down and compute their new scores
         for (unsigned c0 = 0; c0 < entriesInCache0; ++c0)
         {
-            unsigned short index = cache0[ c0 ];
+            unsigned index = cache0[ c0 ];
             VertexPTNTCWithData& vertexData = verticesWithCachedata[ index ];
 
             if (vertexData.data.cachePos1 >= entriesInCache1)
@@ -551,7 +552,7 @@ void Mesh::OptimizeFaces()
         bestScore = -1.f;
         for (unsigned c1 = 0; c1 < entriesInCache1; ++c1)
         {
-            unsigned short index = cache1[ c1 ];
+            unsigned index = cache1[ c1 ];
             VertexPTNTCWithData& vertexData = verticesWithCachedata[ index ];
             vertexData.data.cachePos0 = vertexData.data.cachePos1;
             vertexData.data.cachePos1 = kEvictedCacheIndex;
@@ -560,15 +561,15 @@ void Mesh::OptimizeFaces()
                 unsigned fface = activeFaceList[ vertexData.data.activeFaceListStart + j ];
                 float faceScore = 0.f;
                     
-                unsigned short faceIndexA = indices[ fface ].a;
+                unsigned faceIndexA = indices[ fface ].a;
                 VertexPTNTCWithData& faceVertexDataA = verticesWithCachedata[ faceIndexA ];
                 faceScore += faceVertexDataA.data.score;
 
-                unsigned short faceIndexB = indices[ fface ].b;
+                unsigned faceIndexB = indices[ fface ].b;
                 VertexPTNTCWithData& faceVertexDataB = verticesWithCachedata[ faceIndexB ];
                 faceScore += faceVertexDataB.data.score;
 
-                unsigned short faceIndexC = indices[ fface ].c;
+                unsigned faceIndexC = indices[ fface ].c;
                 VertexPTNTCWithData& faceVertexDataC = verticesWithCachedata[ faceIndexC ];
                 faceScore += faceVertexDataC.data.score;
 
@@ -621,9 +622,9 @@ void Mesh::SolveFaceNormals()
 
     for (std::size_t faceInd = 0; faceInd < indices.size(); ++faceInd)
     {
-        const unsigned short& faceA = indices[ faceInd ].a;
-        const unsigned short& faceB = indices[ faceInd ].b;
-        const unsigned short& faceC = indices[ faceInd ].c;
+        const unsigned& faceA = indices[ faceInd ].a;
+        const unsigned& faceB = indices[ faceInd ].b;
+        const unsigned& faceC = indices[ faceInd ].c;
 
         const ae3d::Vec3 va = interleavedVertices[ faceA ].position;
         ae3d::Vec3 vb = interleavedVertices[ faceB ].position;
@@ -838,7 +839,7 @@ void Mesh::Interleave()
             
             interleavedVertices.push_back( newVertex );
             
-            newFace.a = (unsigned short)(interleavedVertices.size() - 1);
+            newFace.a = (unsigned)(interleavedVertices.size() - 1);
         }
 
         // vertind 1
@@ -889,7 +890,7 @@ void Mesh::Interleave()
             
             interleavedVertices.push_back( newVertex );
 
-            newFace.b = (unsigned short)(interleavedVertices.size() - 1);
+            newFace.b = (unsigned)(interleavedVertices.size() - 1);
         }
 
         // vertind 2
@@ -939,7 +940,7 @@ void Mesh::Interleave()
             
             interleavedVertices.push_back( newVertex );
 
-            newFace.c = (unsigned short)(interleavedVertices.size() - 1);
+            newFace.c = (unsigned)(interleavedVertices.size() - 1);
         }
 
         indices.push_back( newFace );
@@ -976,30 +977,25 @@ bool Mesh::AlmostEquals( const TexCoord& t1, const TexCoord& t2 ) const
     return true;
 }
 
-/**
- bytes  data
- (2)    magic number, e.g. "a7"
- (4*6)  Object's AABB min, AABB max.
- (2)    # of meshes
- (4*6)      Mesh's AABB min, AABB max.
- (2)        mesh name length in bytes.
- (*)        mesh name (1 character = 1 byte)
- (2)        # of vertices.
- (*)        Vertex data array of type Vertex.
- (2)        # of faces
- (*)        faces
- (2)        # of joints if magic number is >= a8
- (*)        joints
- (1)    terminator byte: 100
- */
+// Appends size bytes to file at a multiple of alignment and returns their offset.
+std::uint64_t AppendAligned( std::vector< char >& file, const void* data, std::size_t size, std::uint64_t alignment )
+{
+    file.resize( static_cast< std::size_t >( (file.size() + alignment - 1) / alignment * alignment ) );
+    const std::uint64_t offset = file.size();
+    file.insert( std::end( file ), static_cast< const char* >( data ), static_cast< const char* >( data ) + size );
+    return offset;
+}
 
-/// Writes a .ae3d model to a file.
+/// Writes a .ae3d model to a file in the format described in Engine/Core/MeshFormat.hpp.
 /// \param aOutFile File name to save the model into.
 void WriteAe3d( const std::string& aOutFile, VertexFormat vertexFormat )
 {
-    static_assert( sizeof( VertexPTNTC) == 64, "" );
+    static_assert( sizeof( VertexPTNTC ) == ae3d::MeshFormat::VertexSizes[ ae3d::MeshFormat::VertexFormat::PTNTC ], "" );
+    static_assert( sizeof( VertexPTN ) == ae3d::MeshFormat::VertexSizes[ ae3d::MeshFormat::VertexFormat::PTN ], "" );
+    static_assert( sizeof( VertexPTNTC_Skinned ) == ae3d::MeshFormat::VertexSizes[ ae3d::MeshFormat::VertexFormat::PTNTC_Skinned ], "" );
     static_assert( sizeof( ae3d::Vec3 ) == 12, "" );
-    static_assert( sizeof( VertexInd  ) ==  6, "" );
+    static_assert( sizeof( VertexInd  ) == 12, "" );
+    static_assert( sizeof( ae3d::Matrix44 ) == 64, "" );
 
     if (gMeshes.empty())
     {
@@ -1047,99 +1043,117 @@ void WriteAe3d( const std::string& aOutFile, VertexFormat vertexFormat )
         aabbMax = ae3d::Vec3::Max2( aabbMax, gMeshes[ m ].aabbMax );
     }
 
-    // The file starts with identification bytes.
-    const char* gAe3dVersion = "a9";
-    ofs.write( gAe3dVersion, 2 );
+    // Contents are collected to memory, because the header and submeshes contain offsets to data that follows them.
+    std::vector< char > file( sizeof( ae3d::MeshFormat::Header ) );
+    std::vector< ae3d::MeshFormat::SubMesh > subMeshes( gMeshes.size() );
+    const std::uint64_t subMeshesOffset = AppendAligned( file, subMeshes.data(), subMeshes.size() * sizeof( ae3d::MeshFormat::SubMesh ), ae3d::MeshFormat::DataAlignment );
 
-    ofs.write( reinterpret_cast< char* >( &aabbMin.x ), 3 * 4 );
-    ofs.write( reinterpret_cast< char* >( &aabbMax.x ), 3 * 4 );
+    for (std::size_t m = 0; m < gMeshes.size(); ++m)
+    {
+        Mesh& mesh = gMeshes[ m ];
+        ae3d::MeshFormat::SubMesh& subMesh = subMeshes[ m ];
 
-    const std::size_t meshes = gMeshes.size();
-    // # of meshes.
-    ofs.write( reinterpret_cast< const char* >( &meshes ), 2 );
+        assert( mesh.fnormal.size() == mesh.indices.size() );
 
-    for (std::size_t m = 0; m < meshes; ++m)
-    {
-        assert( gMeshes[ m ].fnormal.size() == gMeshes[ m ].indices.size() );
-
-        // AABB.
-        ofs.write( reinterpret_cast< char* >( &gMeshes[ m ].aabbMin.x ), 3 * 4 );
-        ofs.write( reinterpret_cast< char* >( &gMeshes[ m ].aabbMax.x ), 3 * 4 );
-
-        // Writes name's length.
-        const unsigned short nameLength = (unsigned short)gMeshes[ m ].name.length();
-        ofs.write( reinterpret_cast< char* >((char*)&nameLength ), 2 );
-        // Writes name.
-        ofs.write(reinterpret_cast<char*>((char*)gMeshes[m].name.data()),
-                  nameLength);
-        
-        // Writes # of vertices.
-        const unsigned short nVertices = (unsigned short)gMeshes[ m ].interleavedVertices.size();
-        ofs.write( reinterpret_cast< char* >((char*)&nVertices), 2 );
+        subMesh.aabbMin[ 0 ] = mesh.aabbMin.x;
+        subMesh.aabbMin[ 1 ] = mesh.aabbMin.y;
+        subMesh.aabbMin[ 2 ] = mesh.aabbMin.z;
+        subMesh.aabbMax[ 0 ] = mesh.aabbMax.x;
+        subMesh.aabbMax[ 1 ] = mesh.aabbMax.y;
+        subMesh.aabbMax[ 2 ] = mesh.aabbMax.z;
 
-        // Writes vertex data.
-        if (vertexFormat == VertexFormat::PTNTC_Skinned || !gMeshes[ m ].joints.empty())
-        {
-            const unsigned char format = 2;
-            ofs.write( (char*)&format, 1 );
+        subMesh.nameOffset = AppendAligned( file, mesh.name.c_str(), mesh.name.length() + 1, 1 );
+        subMesh.nameLength = (std::uint32_t)mesh.name.length();
+
+        const bool isSkinned = vertexFormat == VertexFormat::PTNTC_Skinned || !mesh.joints.empty();
+        const std::uint32_t vertexCount = (std::uint32_t)mesh.interleavedVertices.size();
 
-            ofs.write( (char*)&gMeshes[ m ].interleavedVertices[ 0 ], gMeshes[ m ].interleavedVertices.size() * sizeof( VertexPTNTC_Skinned ) );
+        if (isSkinned)
+        {
+            subMesh.vertexFormat = ae3d::MeshFormat::VertexFormat::PTNTC_Skinned;
+            subMesh.verticesOffset = AppendAligned( file, mesh.interleavedVertices.data(), vertexCount * sizeof( VertexPTNTC_Skinned ), ae3d::MeshFormat::DataAlignment );
         }
         else if (vertexFormat == VertexFormat::PTNTC)
         {
-            gMeshes[ m ].CopyInterleavedVerticesToPTNTC();
-            
-            const unsigned char format = 0;
-            ofs.write( (char*)&format, 1 );
-            
-            ofs.write( (char*)&gMeshes[ m ].interleavedVerticesPTNTC[ 0 ], gMeshes[ m ].interleavedVerticesPTNTC.size() * sizeof( VertexPTNTC ) );
+            mesh.CopyInterleavedVerticesToPTNTC();
+            subMesh.vertexFormat = ae3d::MeshFormat::VertexFormat::PTNTC;
+            subMesh.verticesOffset = AppendAligned( file, mesh.interleavedVerticesPTNTC.data(), vertexCount * sizeof( VertexPTNTC ), ae3d::MeshFormat::DataAlignment );
         }
         else if (vertexFormat == VertexFormat::PTN)
         {
-            gMeshes[ m ].CopyInterleavedVerticesToPTN();
-
-            const unsigned char format = 1;
-            ofs.write( (char*)&format, 1 );
-        
-            ofs.write( (char*)&gMeshes[m].interleavedVerticesPTN[ 0 ], gMeshes[ m ].interleavedVerticesPTN.size() * sizeof( VertexPTN ) );
+            mesh.CopyInterleavedVerticesToPTN();
+            subMesh.vertexFormat = ae3d::MeshFormat::VertexFormat::PTN;
+            subMesh.verticesOffset = AppendAligned( file, mesh.interleavedVerticesPTN.data(), vertexCount * sizeof( VertexPTN ), ae3d::MeshFormat::DataAlignment );
         }
         else
         {
             std::cerr << "WriteAe3d: Unhandled Vertex format!" << std::endl;
             exit( 1 );
         }
-        
-        // Writes # of indices.
-        const unsigned short indexCount = (unsigned short)gMeshes[m].indices.size();
-        ofs.write( reinterpret_cast< char* >((char*)&indexCount), 2 );
 
-        // Writes indices.
-        ofs.write( (char*)&gMeshes[m].indices[ 0 ], gMeshes[m].indices.size() * sizeof( VertexInd ) );
+        subMesh.vertexCount = vertexCount;
+        subMesh.faceCount = (std::uint32_t)mesh.indices.size();
 
-        if (vertexFormat == VertexFormat::PTNTC_Skinned || !gMeshes[ m ].joints.empty())
+        // 16-bit indices are used when they are enough, because they halve the index buffer size.
+        if (vertexCount <= 65536)
         {
-            // Writes # of joints.
-            const unsigned short jointCount = (unsigned short)gMeshes[ m ].joints.size();
-            ofs.write( reinterpret_cast< char* >((char*)&jointCount), 2 );
-        
-            // Writes joints.
-            for (size_t j = 0; j < gMeshes[ m ].joints.size(); ++j)
+            std::vector< unsigned short > indices16( mesh.indices.size() * 3 );
+
+            for (std::size_t f = 0; f < mesh.indices.size(); ++f)
+            {
+                indices16[ f * 3 + 0 ] = (unsigned short)mesh.indices[ f ].a;
+                indices16[ f * 3 + 1 ] = (unsigned short)mesh.indices[ f ].b;
+                indices16[ f * 3 + 2 ] = (unsigned short)mesh.indices[ f ].c;
+            }
+
+            subMesh.indexSize = 2;
+            subMesh.indicesOffset = AppendAligned( file, indices16.data(), indices16.size() * sizeof( unsigned short ), ae3d::MeshFormat::DataAlignment );
+        }
+        else
+        {
+            subMesh.indexSize = 4;
+            subMesh.indicesOffset = AppendAligned( file, mesh.indices.data(), mesh.indices.size() * sizeof( VertexInd ), ae3d::MeshFormat::DataAlignment );
+        }
+
+        if (isSkinned)
+        {
+            // Joint array is written again after names and animation transforms are appended.
+            std::vector< ae3d::MeshFormat::Joint > joints( mesh.joints.size() );
+            subMesh.jointCount = (std::uint32_t)joints.size();
+            subMesh.jointsOffset = AppendAligned( file, joints.data(), joints.size() * sizeof( ae3d::MeshFormat::Joint ), ae3d::MeshFormat::DataAlignment );
+
+            for (std::size_t j = 0; j < joints.size(); ++j)
             {
-                ofs.write( (char*)&gMeshes[ m ].joints[ j ].globalBindposeInverse, sizeof( ae3d::Matrix44 ) );
-                ofs.write( (char*)&gMeshes[ m ].joints[ j ].parentIndex, 4 );
-                const int jointNameLength = (int)gMeshes[ m ].joints[ j ].name.length();
-                ofs.write( (char*)&jointNameLength, sizeof( int ) );
-                ofs.write( reinterpret_cast<char*>((char*)gMeshes[m].joints[ j ].name.data()), jointNameLength );
-                const int animLength = (int)gMeshes[ m ].joints[ j ].animTransforms.size();
-                ofs.write( (char*)&animLength, sizeof( int ) );
-                ofs.write( (char*)&gMeshes[ m ].joints[ j ].animTransforms[ 0 ].m[ 0 ], gMeshes[ m ].joints[ j ].animTransforms.size() * sizeof( ae3d::Matrix44 ) );
+                const Joint& joint = mesh.joints[ j ];
+                std::copy( joint.globalBindposeInverse.m, joint.globalBindposeInverse.m + 16, joints[ j ].globalBindposeInverse );
+                joints[ j ].parentIndex = joint.parentIndex;
+                joints[ j ].nameOffset = AppendAligned( file, joint.name.c_str(), joint.name.length() + 1, 1 );
+                joints[ j ].nameLength = (std::uint32_t)joint.name.length();
+                joints[ j ].animTransformsOffset = AppendAligned( file, joint.animTransforms.data(), joint.animTransforms.size() * sizeof( ae3d::Matrix44 ), ae3d::MeshFormat::DataAlignment );
+                joints[ j ].animTransformCount = (std::uint32_t)joint.animTransforms.size();
             }
+
+            std::copy( (const char*)joints.data(), (const char*)(joints.data() + joints.size()), file.data() + subMesh.jointsOffset );
         }
     }
 
-    // Terminator.
-    const unsigned char byte = 100;
-    ofs.write( (char*)&byte, 1 );
+    ae3d::MeshFormat::Header header = {};
+    std::copy( std::begin( ae3d::MeshFormat::Magic ), std::end( ae3d::MeshFormat::Magic ), header.magic );
+    header.version = ae3d::MeshFormat::Version;
+    header.aabbMin[ 0 ] = aabbMin.x;
+    header.aabbMin[ 1 ] = aabbMin.y;
+    header.aabbMin[ 2 ] = aabbMin.z;
+    header.aabbMax[ 0 ] = aabbMax.x;
+    header.aabbMax[ 1 ] = aabbMax.y;
+    header.aabbMax[ 2 ] = aabbMax.z;
+    header.subMeshCount = (std::uint32_t)subMeshes.size();
+    header.subMeshesOffset = subMeshesOffset;
+    header.fileSize = file.size();
+
+    std::copy( (const char*)&header, (const char*)(&header + 1), file.data() );
+    std::copy( (const char*)subMeshes.data(), (const char*)(subMeshes.data() + subMeshes.size()), file.data() + subMeshesOffset );
+
+    ofs.write( file.data(), (std::streamsize)file.size() );
 
     std::cout << "Wrote " << aOutFile << std::endl;
 }